@@ -1439,6 +1439,68 @@ dds_get_topic_filter_extended (
   dds_entity_t topic,
   struct dds_topic_filter *filter);
 
+/** Content filter class function: evaluates expression with parameters for a
+    sample; no guarantee of backwards compatibility */
+typedef bool (*dds_content_filter_fn) (const void *sample, const char *expression, uint32_t nparams, const char * const *params, void *arg);
+
+/**
+ * @brief Registers a named content filter class with the domain of an entity.
+ *
+ * A function can't be sent over the network, but a class name, an expression and
+ * parameters can. Readers created on a topic with a content filter advertise these
+ * in discovery, and writers in domains where a class of the same name is registered
+ * evaluate the filter for them and don't send samples their readers would discard.
+ * Remote readers discovered before the class is registered are not filtered by the
+ * writer. No guarantee of backwards compatibility.
+ *
+ * @param[in]  entity        An entity in the domain for which to register the class.
+ * @param[in]  filter_class  Name of the filter class.
+ * @param[in]  fn            Filter function.
+ * @param[in]  arg           Argument passed to the filter function.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK  Filter class registered successfully
+ * @retval DDS_RETCODE_BAD_PARAMETER  The entity handle is invalid or filter_class or fn is a null pointer
+ * @retval DDS_RETCODE_PRECONDITION_NOT_MET  A class of this name has already been registered
+ */
+DDS_EXPORT dds_return_t
+dds_register_content_filter (
+  dds_entity_t entity,
+  const char *filter_class,
+  dds_content_filter_fn fn,
+  void *arg);
+
+/**
+ * @brief Sets a content filter of a registered class on a topic. To be replaced by
+ * proper filtering on readers, no guarantee that this will be maintained for backwards
+ * compatibility.
+ *
+ * The filter is applied locally like a filter set with @ref dds_set_topic_filter_and_arg,
+ * and readers subsequently created on the topic advertise it so that writers that know
+ * the filter class can drop samples at the source. The content filter can be set only
+ * once for a topic.
+ *
+ * @param[in]  topic         The topic on which the content filter is set.
+ * @param[in]  filter_class  Name of a registered filter class.
+ * @param[in]  expression    Filter expression passed to the filter function.
+ * @param[in]  nparams       Number of expression parameters.
+ * @param[in]  params        Expression parameters (may be NULL if nparams = 0).
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK  Filter set successfully
+ * @retval DDS_RETCODE_BAD_PARAMETER  The topic handle is invalid or an argument is a null pointer
+ * @retval DDS_RETCODE_PRECONDITION_NOT_MET  The filter class is unknown or the topic already has a content filter
+ */
+DDS_EXPORT dds_return_t
+dds_set_topic_content_filter (
+  dds_entity_t topic,
+  const char *filter_class,
+  const char *expression,
+  uint32_t nparams,
+  const char * const *params);
+
 /**
  * @brief Creates a new instance of a DDS subscriber
  *
@@ -2221,6 +2283,41 @@ dds_create_querycondition(
   uint32_t mask,
   dds_querycondition_filter_fn filter);
 
+/**
+ * @brief Creates a querycondition for a single instance associated to the given reader.
+ *
+ * The querycondition matches the samples of the instance identified by the key
+ * fields in keydata that have states matching the mask. It is equivalent to a
+ * querycondition with a filter comparing the key fields with those in keydata,
+ * but the reader indexes these conditions on the instance, so that the cost of
+ * storing a sample does not grow with the number of such conditions. Reading or
+ * taking through this condition is restricted to the instance.
+ *
+ * The instance need not be known yet when the condition is created.
+ *
+ * @param[in]  reader  Reader to associate the condition to.
+ * @param[in]  mask    Interest (dds_sample_state_t|dds_view_state_t|dds_instance_state_t).
+ * @param[in]  keydata Sample containing the key of the instance of interest.
+ *
+ * @returns A valid condition handle or an error code
+ *
+ * @retval >=0
+ *             A valid condition handle.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             The keydata is NULL or can't be converted to a key.
+ * @retval DDS_RETCODE_ERROR
+ *             An internal error has occurred.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ */
+DDS_EXPORT dds_entity_t
+dds_create_querycondition_key(
+  dds_entity_t reader,
+  uint32_t mask,
+  const void *keydata);
+
 /**
  * @brief Creates a guardcondition.
  *
@@ -3250,6 +3347,95 @@ dds_takecdr_instance (
     dds_instance_handle_t handle,
     uint32_t mask);
 
+/**
+ * @brief Description of a column for \ref dds_read_columns and \ref dds_take_columns
+ *
+ * A column selects a member of primitive type of the reader's data type, the value of
+ * that member in the i-th sample read is stored at buf + i * size.
+ */
+typedef struct dds_column {
+  uint32_t offset; /**< Offset of the member in the sample (i.e., offsetof) */
+  uint32_t size;   /**< Size of the member in bytes: 1, 2, 4 or 8 */
+  void *buf;       /**< Column buffer, with room for maxs values */
+} dds_column_t;
+
+/**
+ * @brief Read selected members of a batch of samples into column buffers
+ *
+ * This operation implements the same functionality as dds_read_mask, except that
+ * rather than deserializing complete samples, only the members described by cols
+ * are extracted, and these are stored in arrays with one array per member ("struct
+ * of arrays"). For types consisting of top-level members only, the members are read
+ * directly from the serialized data, avoiding the cost of deserializing the other
+ * members. Returned samples are marked as READ.
+ *
+ * The column values for samples without valid data (see valid_data in the sample
+ * info) are set to 0.
+ *
+ * @param[in]  reader Reader entity.
+ * @param[in]  cols Array of column descriptors.
+ * @param[in]  ncols Number of columns.
+ * @param[out] si Pointer to an array of \ref dds_sample_info_t returned for each data value.
+ * @param[in]  maxs Maximum number of samples to read.
+ * @param[in]  mask Filter the data based on dds_sample_state_t|dds_view_state_t|dds_instance_state_t.
+ *
+ * @returns A dds_return_t with the number of samples read or an error code.
+ *
+ * @retval >=0
+ *             Number of samples read.
+ * @retval DDS_RETCODE_ERROR
+ *             An internal error has occurred.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             One of the given arguments is not valid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ */
+DDS_EXPORT dds_return_t
+dds_read_columns (
+  dds_entity_t reader,
+  const dds_column_t *cols,
+  uint32_t ncols,
+  dds_sample_info_t *si,
+  uint32_t maxs,
+  uint32_t mask);
+
+/**
+ * @brief Take selected members of a batch of samples into column buffers
+ *
+ * This operation implements the same functionality as \ref dds_read_columns, except
+ * that the samples are removed from the reader.
+ *
+ * @param[in]  reader Reader entity.
+ * @param[in]  cols Array of column descriptors.
+ * @param[in]  ncols Number of columns.
+ * @param[out] si Pointer to an array of \ref dds_sample_info_t returned for each data value.
+ * @param[in]  maxs Maximum number of samples to take.
+ * @param[in]  mask Filter the data based on dds_sample_state_t|dds_view_state_t|dds_instance_state_t.
+ *
+ * @returns A dds_return_t with the number of samples taken or an error code.
+ *
+ * @retval >=0
+ *             Number of samples taken.
+ * @retval DDS_RETCODE_ERROR
+ *             An internal error has occurred.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             One of the given arguments is not valid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ */
+DDS_EXPORT dds_return_t
+dds_take_columns (
+  dds_entity_t reader,
+  const dds_column_t *cols,
+  uint32_t ncols,
+  dds_sample_info_t *si,
+  uint32_t maxs,
+  uint32_t mask);
+
 
 /**
  * @brief Access the collection of data values (of same type) and sample info from the
@@ -34,6 +34,10 @@ DDS_EXPORT void dds_topic_allow_set_qos (struct dds_topic *tp) ddsrt_nonnull_all
 typedef bool (*dds_topic_intern_filter_fn) (const void * sample, void *ctx);
 #endif
 
+/* Content filter to advertise for readers of the topic, NULL if there is none
+   or it has been replaced by another filter */
+const nn_content_filter_property_t *dds_topic_advertised_content_filter (const struct dds_topic *tp) ddsrt_nonnull_all;
+
 DDS_EXPORT void dds_topic_set_filter_with_ctx (dds_entity_t topic, dds_topic_intern_filter_fn filter, void *ctx);
 DDS_EXPORT dds_topic_intern_filter_fn dds_topic_get_filter_with_ctx (dds_entity_t topic);
 DDS_EXPORT dds_entity_t dds_create_topic_impl (
@@ -49,6 +49,7 @@ struct dds_statuscond;
 
 struct ddsi_sertype;
 struct ddsi_rhc;
+struct ddsi_tkmap_instance;
 
 typedef uint16_t status_mask_t;
 typedef ddsrt_atomic_uint32_t status_and_enabled_t;
@@ -332,6 +333,9 @@ typedef struct dds_reader {
   bool m_loan_out;
   void *m_loan;
   uint32_t m_loan_size;
+  struct ddsi_serdata **m_loan_sds; /* if m_loan_nsds > 0: references backing a shared loan, null for invalid samples */
+  uint32_t m_loan_sds_size;
+  uint32_t m_loan_nsds;
   unsigned m_wrapped_sertopic : 1; /* set iff reader's topic is a wrapped ddsi_sertopic for backwards compatibility */
 #ifdef DDS_HAS_SHM
   iox_sub_storage_extension_t m_iox_sub_stor;
@@ -355,6 +359,8 @@ typedef struct dds_writer {
   struct writer *m_wr;
   struct whc *m_whc; /* FIXME: ownership still with underlying DDSI writer (cos of DDSI built-in writers )*/
   bool whc_batch; /* FIXME: channels + latency budget */
+  uint32_t m_sg_min_size; /* min size of sequences to reference rather than serialize, 0 = none */
+  bool m_lazy_key; /* compute the key of a sample only when needed, requires a WHC without instances */
   dds_data_representation_id_t m_data_representation;
 #ifdef DDS_HAS_SHM
   iox_pub_storage_t m_iox_pub_stor;
@@ -376,11 +382,10 @@ typedef struct dds_topic {
   struct ddsi_sertype *m_stype;
   struct dds_ktopic *m_ktopic; /* refc'd, constant */
   struct dds_topic_filter m_filter;
+  struct ddsi_content_filter *m_content_filter; /* set once, advertised by readers while m_filter uses it */
   dds_inconsistent_topic_status_t m_inconsistent_topic_status; /* Status metrics */
 } dds_topic;
 
-typedef uint32_t dds_querycond_mask_t;
-
 typedef struct dds_readcond {
   dds_entity m_entity;
   uint32_t m_qminv;
@@ -390,7 +395,8 @@ typedef struct dds_readcond {
   struct dds_readcond *m_next;
   struct {
     dds_querycondition_filter_fn m_filter;
-    dds_querycond_mask_t m_qcmask; /* condition mask in RHC*/
+    struct ddsi_tkmap_instance *m_keyinst; /* instance of a key condition (refc'd), else NULL */
+    uint32_t m_index; /* index of filter condition in RHC condition sets */
   } m_query;
 } dds_readcond;
 
@@ -19,6 +19,8 @@
 #include "dds__querycond.h"
 #include "dds__readcond.h"
 #include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_tkmap.h"
+#include "dds/ddsi/q_thread.h"
 
 dds_entity_t dds_create_querycondition (dds_entity_t reader, uint32_t mask, dds_querycondition_filter_fn filter)
 {
@@ -30,7 +32,7 @@ dds_entity_t dds_create_querycondition (dds_entity_t reader, uint32_t mask, dds_
   else
   {
     dds_entity_t hdl;
-    dds_readcond *cond = dds_create_readcond (r, DDS_KIND_COND_QUERY, mask, filter);
+    dds_readcond *cond = dds_create_readcond (r, DDS_KIND_COND_QUERY, mask, filter, NULL);
     assert (cond);
     hdl = cond->m_entity.m_hdllink.hdl;
     dds_entity_init_complete (&cond->m_entity);
@@ -38,3 +40,43 @@ dds_entity_t dds_create_querycondition (dds_entity_t reader, uint32_t mask, dds_
     return hdl;
   }
 }
+
+dds_entity_t dds_create_querycondition_key (dds_entity_t reader, uint32_t mask, const void *keydata)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct ddsi_tkmap_instance *tk;
+  struct ddsi_serdata *sd;
+  dds_return_t rc;
+  dds_reader *r;
+
+  if (keydata == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((rc = dds_reader_lock (reader, &r)) != DDS_RETCODE_OK)
+    return rc;
+
+  /* The condition keeps a reference to the key-to-instance-handle mapping so that
+     the instance handle remains the same even while the reader has no samples of
+     the instance; the RHC then uses it as a key in its index of key conditions */
+  thread_state_awake (ts1, &r->m_entity.m_domain->gv);
+  if ((sd = ddsi_serdata_from_sample (r->m_topic->m_stype, SDK_KEY, keydata)) == NULL)
+    tk = NULL;
+  else
+  {
+    tk = ddsi_tkmap_find (r->m_entity.m_domain->gv.m_tkmap, sd, true);
+    ddsi_serdata_unref (sd);
+  }
+  thread_state_asleep (ts1);
+  if (tk == NULL)
+  {
+    dds_reader_unlock (r);
+    return DDS_RETCODE_BAD_PARAMETER;
+  }
+
+  dds_entity_t hdl;
+  dds_readcond *cond = dds_create_readcond (r, DDS_KIND_COND_QUERY, mask, 0, tk);
+  assert (cond);
+  hdl = cond->m_entity.m_hdllink.hdl;
+  dds_entity_init_complete (&cond->m_entity);
+  dds_reader_unlock (r);
+  return hdl;
+}
@@ -21,6 +21,51 @@
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_sertype.h"
 #include "dds/ddsi/ddsi_sertopic.h" // for extern ddsi_sertopic_serdata_ops_wrap
+#include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_cdrstream.h"
+#include "dds/ddsrt/heap.h"
+
+/* Loaned samples can be shared with other readers of the same data if the
+   serdata keeps a deserialized copy, which is only the case for the default
+   serdata implementation.  Read conditions go through the regular path,
+   because the RHC interface for serdata doesn't evaluate them. */
+static bool dds_reader_can_share_loan (const struct dds_reader *rd)
+{
+  return rd->m_entity.m_domain->gv.config.share_loaned_samples && !rd->m_wrapped_sertopic &&
+         rd->m_topic->m_stype->ops == &ddsi_sertype_ops_default;
+}
+
+/* The first entry of a shared loan is either the reader loan (if the first sample
+   is invalid) or the sample cached in the first serdata */
+static bool dds_reader_is_shared_loan (const struct dds_reader *rd, const void *buf0)
+{
+  if (!(rd->m_loan_out && rd->m_loan_nsds > 0))
+    return false;
+  else if (rd->m_loan_sds[0] == NULL)
+    return buf0 == rd->m_loan;
+  else
+    return buf0 == ddsi_serdata_default_shared_sample (rd->m_loan_sds[0]);
+}
+
+static void dds_read_share_loan (struct dds_reader *rd, void **buf, const dds_sample_info_t *si, int32_t n)
+{
+  /* Valid samples: point to the deserialized sample cached on the serdata and
+     hold on to the reference until the loan is returned.  Invalid samples only
+     have a key value, those go into the (zeroed) reader loan as usual. */
+  rd->m_loan_nsds = (n > 0) ? (uint32_t) n : 0;
+  for (int32_t i = 0; i < n; i++)
+  {
+    struct ddsi_serdata *sd = rd->m_loan_sds[i];
+    if (si[i].valid_data)
+      buf[i] = (void *) ddsi_serdata_default_shared_sample (sd);
+    else
+    {
+      (void) ddsi_serdata_untyped_to_sample (rd->m_topic->m_stype, sd, buf[i], NULL, NULL);
+      ddsi_serdata_unref (sd);
+      rd->m_loan_sds[i] = NULL;
+    }
+  }
+}
 
 /*
   dds_read_impl: Core read/take function. Usually maxs is size of buf and si
@@ -37,6 +82,7 @@ static dds_return_t dds_read_impl (bool take, dds_entity_t reader_or_condition,
   struct dds_reader *rd;
   struct dds_readcond *cond;
   unsigned nodata_cleanups = 0;
+  bool share_loan = false;
 #define NC_CLEAR_LOAN_OUT 1u
 #define NC_FREE_BUF 2u
 #define NC_RESET_BUF 4u
@@ -62,6 +108,22 @@ static dds_return_t dds_read_impl (bool take, dds_entity_t reader_or_condition,
 
   thread_state_awake (ts1, &entity->m_domain->gv);
 
+  /* The samples of a shared loan are the read-only ones cached in the serdata:
+     passing the buffer in again returns the loan, just like passing in a regular
+     loan hands it back to the reader to be filled again */
+  if (buf[0] != NULL && dds_reader_can_share_loan (rd))
+  {
+    ddsrt_mutex_lock (&rd->m_entity.m_mutex);
+    if (dds_reader_is_shared_loan (rd, buf[0]))
+    {
+      dds_reader_release_shared_loan (rd);
+      ddsi_sertype_zero_samples (rd->m_topic->m_stype, rd->m_loan, rd->m_loan_size);
+      rd->m_loan_out = false;
+      buf[0] = NULL;
+    }
+    ddsrt_mutex_unlock (&rd->m_entity.m_mutex);
+  }
+
   /* Allocate samples if not provided (assuming all or none provided) */
   if (buf[0] == NULL)
   {
@@ -95,6 +157,15 @@ static dds_return_t dds_read_impl (bool take, dds_entity_t reader_or_condition,
       rd->m_loan = buf[0];
       rd->m_loan_out = true;
       nodata_cleanups = NC_RESET_BUF | NC_CLEAR_LOAN_OUT;
+      if (cond == NULL && dds_reader_can_share_loan (rd))
+      {
+        if (rd->m_loan_sds_size < maxs)
+        {
+          rd->m_loan_sds = ddsrt_realloc (rd->m_loan_sds, maxs * sizeof (*rd->m_loan_sds));
+          rd->m_loan_sds_size = maxs;
+        }
+        share_loan = true;
+      }
     }
     ddsrt_mutex_unlock (&rd->m_entity.m_mutex);
   }
@@ -106,7 +177,15 @@ static dds_return_t dds_read_impl (bool take, dds_entity_t reader_or_condition,
   if (sm_old & (DDS_DATA_ON_READERS_STATUS << SAM_ENABLED_SHIFT))
     dds_entity_status_reset (rd->m_entity.m_parent, DDS_DATA_ON_READERS_STATUS);
 
-  if (take)
+  if (share_loan)
+  {
+    if (take)
+      ret = dds_rhc_takecdr (rd->m_rhc, lock, rd->m_loan_sds, si, maxs, mask & DDS_ANY_SAMPLE_STATE, mask & DDS_ANY_VIEW_STATE, mask & DDS_ANY_INSTANCE_STATE, hand);
+    else
+      ret = dds_rhc_readcdr (rd->m_rhc, lock, rd->m_loan_sds, si, maxs, mask & DDS_ANY_SAMPLE_STATE, mask & DDS_ANY_VIEW_STATE, mask & DDS_ANY_INSTANCE_STATE, hand);
+    dds_read_share_loan (rd, buf, si, ret);
+  }
+  else if (take)
     ret = dds_rhc_take (rd->m_rhc, lock, buf, si, maxs, mask, hand, cond);
   else
     ret = dds_rhc_read (rd->m_rhc, lock, buf, si, maxs, mask, hand, cond);
@@ -139,28 +218,12 @@ fail:
   return ret;
 }
 
-static dds_return_t dds_readcdr_impl (bool take, dds_entity_t reader_or_condition, struct ddsi_serdata **buf, uint32_t maxs, dds_sample_info_t *si, uint32_t mask, dds_instance_handle_t hand, bool lock)
+static dds_return_t dds_readcdr_pinned (bool take, struct dds_reader *rd, struct ddsi_serdata **buf, uint32_t maxs, dds_sample_info_t *si, uint32_t mask, dds_instance_handle_t hand, bool lock)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
-  dds_return_t ret = DDS_RETCODE_OK;
-  struct dds_reader *rd;
-  struct dds_entity *entity;
+  dds_return_t ret;
 
-  if (buf == NULL || si == NULL || maxs == 0 || maxs > INT32_MAX)
-    return DDS_RETCODE_BAD_PARAMETER;
-
-  if ((ret = dds_entity_pin (reader_or_condition, &entity)) < 0) {
-    return ret;
-  } else if (dds_entity_kind (entity) == DDS_KIND_READER) {
-    rd = (dds_reader *) entity;
-  } else if (dds_entity_kind (entity) != DDS_KIND_COND_READ && dds_entity_kind (entity) != DDS_KIND_COND_QUERY) {
-    dds_entity_unpin (entity);
-    return DDS_RETCODE_ILLEGAL_OPERATION;
-  } else {
-    rd = (dds_reader *) entity->m_parent;
-  }
-
-  thread_state_awake (ts1, &entity->m_domain->gv);
+  thread_state_awake (ts1, &rd->m_entity.m_domain->gv);
 
   /* read/take resets data available status -- must reset before reading because
      the actual writing is protected by RHC lock, not by rd->m_entity.m_lock */
@@ -195,11 +258,153 @@ static dds_return_t dds_readcdr_impl (bool take, dds_entity_t reader_or_conditio
     }
   }
 
-  dds_entity_unpin (entity);
   thread_state_asleep (ts1);
   return ret;
 }
 
+static dds_return_t dds_readcdr_impl (bool take, dds_entity_t reader_or_condition, struct ddsi_serdata **buf, uint32_t maxs, dds_sample_info_t *si, uint32_t mask, dds_instance_handle_t hand, bool lock)
+{
+  dds_return_t ret = DDS_RETCODE_OK;
+  struct dds_reader *rd;
+  struct dds_entity *entity;
+
+  if (buf == NULL || si == NULL || maxs == 0 || maxs > INT32_MAX)
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_entity_pin (reader_or_condition, &entity)) < 0) {
+    return ret;
+  } else if (dds_entity_kind (entity) == DDS_KIND_READER) {
+    rd = (dds_reader *) entity;
+  } else if (dds_entity_kind (entity) != DDS_KIND_COND_READ && dds_entity_kind (entity) != DDS_KIND_COND_QUERY) {
+    dds_entity_unpin (entity);
+    return DDS_RETCODE_ILLEGAL_OPERATION;
+  } else {
+    rd = (dds_reader *) entity->m_parent;
+  }
+
+  ret = dds_readcdr_pinned (take, rd, buf, maxs, si, mask, hand, lock);
+  dds_entity_unpin (entity);
+  return ret;
+}
+
+#define READ_COLUMNS_INLINE_SDS 32
+
+DDSRT_STATIC_ASSERT (sizeof (dds_column_t) == sizeof (struct dds_stream_column) &&
+                     offsetof (dds_column_t, offset) == offsetof (struct dds_stream_column, offset) &&
+                     offsetof (dds_column_t, size) == offsetof (struct dds_stream_column, size) &&
+                     offsetof (dds_column_t, buf) == offsetof (struct dds_stream_column, buf));
+
+static void dds_columns_from_sample (const dds_column_t *cols, uint32_t ncols, const char *sample, uint32_t idx)
+{
+  for (uint32_t k = 0; k < ncols; k++)
+  {
+    char *dst = (char *) cols[k].buf + idx * cols[k].size;
+    if (sample)
+      memcpy (dst, sample + cols[k].offset, cols[k].size);
+    else
+      memset (dst, 0, cols[k].size);
+  }
+}
+
+static void dds_columns_from_serdata (const dds_column_t *cols, uint32_t ncols, struct ddsi_serdata **sds, const dds_sample_info_t *si, int32_t n)
+{
+  const struct dds_stream_column *scols = (const struct dds_stream_column *) cols;
+  const struct ddsi_sertype *type = NULL;
+  struct dds_stream_columns *plan = NULL;
+  void *sample = NULL;
+  for (int32_t i = 0; i < n; i++)
+  {
+    const uint32_t idx = (uint32_t) i;
+    if (!si[i].valid_data)
+    {
+      /* invalid samples are untyped keys */
+      dds_columns_from_sample (cols, ncols, NULL, idx);
+      ddsi_serdata_unref (sds[i]);
+      continue;
+    }
+    if (type == NULL)
+    {
+      /* For a wrapped sertopic, the serdatas are of the type of the sertopic, not of
+         the reader's sertype */
+      type = sds[i]->type;
+      if (type->ops == &ddsi_sertype_ops_default)
+        plan = dds_stream_columns_new ((const struct ddsi_sertype_default *) type, ncols, scols);
+    }
+    if (plan
+#ifdef DDS_HAS_SHM
+        && sds[i]->iox_chunk == NULL
+#endif
+        )
+    {
+      dds_istream_t is;
+      dds_istream_from_serdata_default (&is, (const struct ddsi_serdata_default *) sds[i]);
+      dds_stream_read_columns (&is, plan, idx);
+    }
+    else
+    {
+      if (sample == NULL)
+        sample = ddsi_sertype_alloc_sample (type);
+      (void) ddsi_serdata_to_sample (sds[i], sample, NULL, NULL);
+      dds_columns_from_sample (cols, ncols, sample, idx);
+    }
+    ddsi_serdata_unref (sds[i]);
+  }
+  if (plan)
+    dds_stream_columns_free (plan);
+  if (sample)
+    ddsi_sertype_free_sample (type, sample, DDS_FREE_ALL);
+}
+
+static dds_return_t dds_read_columns_impl (bool take, dds_entity_t reader, const dds_column_t *cols, uint32_t ncols, dds_sample_info_t *si, uint32_t maxs, uint32_t mask)
+{
+  struct ddsi_serdata *sdsbuf[READ_COLUMNS_INLINE_SDS], **sds;
+  struct dds_reader *rd;
+  struct dds_entity *entity;
+  dds_return_t ret;
+
+  if (cols == NULL || ncols == 0 || si == NULL || maxs == 0 || maxs > INT32_MAX)
+    return DDS_RETCODE_BAD_PARAMETER;
+  for (uint32_t k = 0; k < ncols; k++)
+  {
+    if (cols[k].buf == NULL || (cols[k].size != 1 && cols[k].size != 2 && cols[k].size != 4 && cols[k].size != 8))
+      return DDS_RETCODE_BAD_PARAMETER;
+  }
+
+  /* Only readers: for conditions the samples would have to be matched against the
+     condition, which readcdr/takecdr don't do */
+  if ((ret = dds_entity_pin (reader, &entity)) < 0)
+    return ret;
+  if (dds_entity_kind (entity) != DDS_KIND_READER)
+  {
+    dds_entity_unpin (entity);
+    return DDS_RETCODE_ILLEGAL_OPERATION;
+  }
+  rd = (struct dds_reader *) entity;
+  const struct ddsi_sertype *stype = rd->m_topic->m_stype;
+  if (stype->ops == &ddsi_sertype_ops_default)
+  {
+    const uint32_t sample_size = ((const struct ddsi_sertype_default *) stype)->type.size;
+    for (uint32_t k = 0; k < ncols; k++)
+    {
+      if (cols[k].offset > sample_size || cols[k].size > sample_size - cols[k].offset)
+      {
+        dds_entity_unpin (entity);
+        return DDS_RETCODE_BAD_PARAMETER;
+      }
+    }
+  }
+
+  /* Extracting the columns is done after releasing the RHC lock, just like the
+     deserialization in read/take */
+  sds = (maxs <= READ_COLUMNS_INLINE_SDS) ? sdsbuf : ddsrt_malloc (maxs * sizeof (*sds));
+  if ((ret = dds_readcdr_pinned (take, rd, sds, maxs, si, mask, DDS_HANDLE_NIL, true)) > 0)
+    dds_columns_from_serdata (cols, ncols, sds, si, ret);
+  if (sds != sdsbuf)
+    ddsrt_free (sds);
+  dds_entity_unpin (entity);
+  return ret;
+}
+
 dds_return_t dds_read (dds_entity_t rd_or_cnd, void **buf, dds_sample_info_t *si, size_t bufsz, uint32_t maxs)
 {
   bool lock = true;
@@ -495,6 +700,16 @@ dds_return_t dds_takecdr_instance (dds_entity_t rd_or_cnd, struct ddsi_serdata *
   return dds_readcdr_impl(true, rd_or_cnd, buf, maxs, si, mask, handle, lock);
 }
 
+dds_return_t dds_read_columns (dds_entity_t reader, const dds_column_t *cols, uint32_t ncols, dds_sample_info_t *si, uint32_t maxs, uint32_t mask)
+{
+  return dds_read_columns_impl (false, reader, cols, ncols, si, maxs, mask);
+}
+
+dds_return_t dds_take_columns (dds_entity_t reader, const dds_column_t *cols, uint32_t ncols, dds_sample_info_t *si, uint32_t maxs, uint32_t mask)
+{
+  return dds_read_columns_impl (true, reader, cols, ncols, si, maxs, mask);
+}
+
 dds_return_t dds_take_next (dds_entity_t reader, void **buf, dds_sample_info_t *si)
 {
   uint32_t mask = DDS_NOT_READ_SAMPLE_STATE | DDS_ANY_VIEW_STATE | DDS_ANY_INSTANCE_STATE;
@@ -507,6 +722,25 @@ dds_return_t dds_take_next_wl (dds_entity_t reader, void **buf, dds_sample_info_
   return dds_read_impl (true, reader, buf, 1u, 1u, si, mask, DDS_HANDLE_NIL, true, true);
 }
 
+void dds_reader_release_shared_loan (struct dds_reader *rd)
+{
+  /* the samples of a shared loan are all in the reader's loan buffer, so
+     the loaned pointers are not needed for freeing the invalid samples */
+  const struct ddsi_sertype_default *st = (const struct ddsi_sertype_default *) rd->m_topic->m_stype;
+  for (uint32_t i = 0; i < rd->m_loan_nsds; i++)
+  {
+    if (rd->m_loan_sds[i] != NULL)
+      ddsi_serdata_unref (rd->m_loan_sds[i]);
+    else
+    {
+      void *sample = (char *) rd->m_loan + i * st->type.size;
+      ddsi_sertype_free_sample (&st->c, sample, DDS_FREE_CONTENTS);
+      ddsi_sertype_zero_sample (&st->c, sample);
+    }
+  }
+  rd->m_loan_nsds = 0;
+}
+
 dds_return_t dds_return_reader_loan (dds_reader *rd, void **buf, int32_t bufsz)
 {
   if (bufsz <= 0)
@@ -526,7 +760,7 @@ dds_return_t dds_return_reader_loan (dds_reader *rd, void **buf, int32_t bufsz)
      the observer_lock), so holding it for a bit longer in return for simpler
      code is a fair trade-off. */
   ddsrt_mutex_lock (&rd->m_entity.m_mutex);
-  if (buf[0] != rd->m_loan)
+  if (buf[0] != rd->m_loan && !dds_reader_is_shared_loan (rd, buf[0]))
   {
     /* Not so much a loan as a buffer allocated by the middleware on behalf of the
        application.  So it really is no more than a sophisticated variant of "free". */
@@ -544,7 +778,10 @@ dds_return_t dds_return_reader_loan (dds_reader *rd, void **buf, int32_t bufsz)
     /* Free only the memory referenced from the samples, not the samples themselves.
        Zero them to guarantee the absence of dangling pointers that might cause
        trouble on a following operation.  FIXME: there's got to be a better way */
-    ddsi_sertype_free_samples (st, buf, (size_t) bufsz, DDS_FREE_CONTENTS);
+    if (rd->m_loan_nsds > 0)
+      dds_reader_release_shared_loan (rd);
+    else
+      ddsi_sertype_free_samples (st, buf, (size_t) bufsz, DDS_FREE_CONTENTS);
     ddsi_sertype_zero_samples (st, rd->m_loan, rd->m_loan_size);
     rd->m_loan_out = false;
     buf[0] = NULL;
@@ -16,6 +16,7 @@
 #include "dds__entity.h"
 #include "dds/ddsi/ddsi_iid.h"
 #include "dds/ddsi/ddsi_entity_index.h"
+#include "dds/ddsi/ddsi_tkmap.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_thread.h"
 
@@ -27,8 +28,16 @@ static void dds_readcond_close (dds_entity *e)
      then causes the read condition to signal any attached waitsets.  It therefore has to
      be dissociated from the RHC before any freeing takes place. */
   struct dds_reader * const rd = (struct dds_reader *) e->m_parent;
+  dds_readcond * const cond = (dds_readcond *) e;
   assert (dds_entity_kind (&rd->m_entity) == DDS_KIND_READER);
-  dds_rhc_remove_readcondition (rd->m_rhc, (dds_readcond *) e);
+  dds_rhc_remove_readcondition (rd->m_rhc, cond);
+  if (dds_entity_kind (e) == DDS_KIND_COND_QUERY && cond->m_query.m_keyinst != NULL)
+  {
+    struct thread_state1 * const ts1 = lookup_thread_state ();
+    thread_state_awake (ts1, &e->m_domain->gv);
+    ddsi_tkmap_instance_unref (e->m_domain->gv.m_tkmap, cond->m_query.m_keyinst);
+    thread_state_asleep (ts1);
+  }
 }
 
 const struct dds_entity_deriver dds_entity_deriver_readcondition = {
@@ -41,10 +50,10 @@ const struct dds_entity_deriver dds_entity_deriver_readcondition = {
   .refresh_statistics = dds_entity_deriver_dummy_refresh_statistics
 };
 
-dds_readcond *dds_create_readcond (dds_reader *rd, dds_entity_kind_t kind, uint32_t mask, dds_querycondition_filter_fn filter)
+dds_readcond *dds_create_readcond (dds_reader *rd, dds_entity_kind_t kind, uint32_t mask, dds_querycondition_filter_fn filter, struct ddsi_tkmap_instance *keyinst)
 {
   dds_readcond *cond = dds_alloc (sizeof (*cond));
-  assert ((kind == DDS_KIND_COND_READ && filter == 0) || (kind == DDS_KIND_COND_QUERY && filter != 0));
+  assert ((kind == DDS_KIND_COND_READ && filter == 0 && keyinst == NULL) || (kind == DDS_KIND_COND_QUERY && (filter != 0) != (keyinst != NULL)));
   (void) dds_entity_init (&cond->m_entity, &rd->m_entity, kind, false, true, NULL, NULL, 0);
   cond->m_entity.m_iid = ddsi_iid_gen ();
   dds_entity_register_child (&rd->m_entity, &cond->m_entity);
@@ -54,7 +63,8 @@ dds_readcond *dds_create_readcond (dds_reader *rd, dds_entity_kind_t kind, uint3
   if (kind == DDS_KIND_COND_QUERY)
   {
     cond->m_query.m_filter = filter;
-    cond->m_query.m_qcmask = 0;
+    cond->m_query.m_keyinst = keyinst;
+    cond->m_query.m_index = 0;
   }
   if (!dds_rhc_add_readcondition (rd->m_rhc, cond))
   {
@@ -74,7 +84,7 @@ dds_entity_t dds_create_readcondition (dds_entity_t reader, uint32_t mask)
   else
   {
     dds_entity_t hdl;
-    dds_readcond *cond = dds_create_readcond(rd, DDS_KIND_COND_READ, mask, 0);
+    dds_readcond *cond = dds_create_readcond(rd, DDS_KIND_COND_READ, mask, 0, NULL);
     assert (cond);
     hdl = cond->m_entity.m_hdllink.hdl;
     dds_entity_init_complete (&cond->m_entity);
@@ -132,6 +132,14 @@
    Lifespan is based on the reception timestamp, and the monotonic time is
    used for sample expiry if this QoS is set to something else than infinite.
 
+   Ordered access PRESENTATION at TOPIC (or GROUP) scope additionally links
+   all samples and invalid samples of all instances in order of reception in
+   "fifo", and read/take without an instance handle walk that list instead of
+   the non-empty instances.  That returns the data in reception order and
+   costs time proportional to the number of samples inspected rather than the
+   number of instances.  GROUP scope is treated as TOPIC scope: there is no
+   ordering across readers.
+
    READ CONDITIONS
    ===============
 
@@ -158,8 +166,6 @@
    even when generating an invalid sample for an unregister message using
    the tkmap data. */
 
-#define MAX_ATTACHED_QUERYCONDS (CHAR_BIT * sizeof (dds_querycond_mask_t))
-
 #define INCLUDE_TRACE 1
 #if INCLUDE_TRACE
 #define TRACE(...) DDS_CLOG (DDS_LC_RHC, &rhc->gv->logconfig, __VA_ARGS__)
@@ -239,16 +245,37 @@ void lwregs_dump (struct lwregs *rt)
  ******     RHC     ******
  *************************/
 
+struct rhc_fifo_elem {
+  struct ddsrt_circlist_elem e; /* links (invalid) samples of all instances in order of reception */
+  struct rhc_instance *inst;    /* instance the (invalid) sample belongs to */
+};
+
+/* Set of filter query conditions, indexed by m_query.m_index: stored inline
+   for the first 64 conditions, as an array of rhc->qcond_nwords words when
+   there are more. */
+typedef union rhc_qcset {
+  uint64_t w;
+  uint64_t *ws;
+} rhc_qcset_t;
+
+/* Key conditions on one instance, indexed on instance handle */
+struct rhc_keyconds {
+  uint64_t iid;                /* instance handle, key of table */
+  dds_readcond *conds;         /* key conditions on this instance, linked via m_next */
+  uint32_t nsamplest;          /* number of those that check the sample state */
+};
+
 struct rhc_sample {
   struct ddsi_serdata *sample; /* serialised data (either just_key or real data) */
   struct rhc_sample *next;     /* next sample in time ordering, or oldest sample if most recent */
   uint64_t wr_iid;             /* unique id for writer of this sample (perhaps better in serdata) */
-  dds_querycond_mask_t conds;  /* matching query conditions */
+  rhc_qcset_t conds;           /* matching filter query conditions */
   bool isread;                 /* READ or NOT_READ sample state */
   uint32_t disposed_gen;       /* snapshot of instance counter at time of insertion */
   uint32_t no_writers_gen;     /* __/ */
+  struct rhc_fifo_elem fifo;   /* position in reception order, only if rhc->reception_order */
 #ifdef DDS_HAS_LIFESPAN
-  struct lifespan_fhnode lifespan;  /* fibheap node for lifespan */
+  struct lifespan_fhnode lifespan;  /* node in lifespan administration */
   struct rhc_instance *inst;   /* reference to rhc instance */
 #endif
 };
@@ -259,7 +286,8 @@ struct rhc_instance {
   struct rhc_sample *latest;   /* latest received sample; circular list old->new; null if no sample */
   uint32_t nvsamples;          /* number of "valid" samples in instance */
   uint32_t nvread;             /* number of READ "valid" samples in instance (0 <= nvread <= nvsamples) */
-  dds_querycond_mask_t conds;  /* matching query conditions */
+  rhc_qcset_t conds;           /* filter query conditions matching the key (for the invalid sample) */
+  struct rhc_keyconds *keyconds; /* key conditions on this instance, NULL if none */
   uint32_t wrcount;            /* number of live writers */
   unsigned isnew : 1;          /* NEW or NOT_NEW view state */
   unsigned a_sample_free : 1;  /* whether or not a_sample is in use */
@@ -275,6 +303,7 @@ struct rhc_instance {
   ddsi_guid_t wr_guid;         /* guid of last writer (if wr_iid != 0 then wr_guid is the corresponding guid, else undef) */
   ddsrt_wctime_t tstamp;          /* source time stamp of last update */
   struct ddsrt_circlist_elem nonempty_list; /* links non-empty instances in arbitrary ordering */
+  struct rhc_fifo_elem inv_fifo; /* position of invalid sample in reception order, only if rhc->reception_order */
 #ifdef DDS_HAS_DEADLINE_MISSED
   struct deadline_elem deadline; /* element in deadline missed administration */
 #endif
@@ -314,6 +343,8 @@ struct dds_rhc_default {
   bool exclusive_ownership;          /* true if EXCLUSIVE, false if SHARED */
   bool reliable;                     /* true if reliability RELIABLE */
   bool xchecks;                      /* whether to do expensive checking if checking at all */
+  bool reception_order;              /* true if PRESENTATION is ordered access across instances */
+  struct ddsrt_circlist fifo;        /* all (invalid) samples in reception order, if reception_order */
 
   dds_reader *reader;                /* reader -- may be NULL (used by rhc_torture) */
   struct ddsi_tkmap *tkmap;          /* back pointer to tkmap */
@@ -324,9 +355,15 @@ struct dds_rhc_default {
   ddsrt_mutex_t lock;
   dds_readcond * conds;              /* List of associated read conditions */
   uint32_t nconds;                   /* Number of associated read conditions */
-  uint32_t nqconds;                  /* Number of associated query conditions */
-  dds_querycond_mask_t qconds_samplest;  /* Mask of associated query conditions that check the sample state */
+  uint32_t nqconds;                  /* Number of associated filter query conditions */
+  uint32_t nkeyconds;                /* Number of associated key conditions */
+  uint32_t nqconds_samplest;         /* Number of associated query conditions that check the sample state */
+  uint32_t qcond_nwords;             /* Number of words in a query condition set */
+  rhc_qcset_t qconds_inuse;          /* Indices in use by filter query conditions */
+  rhc_qcset_t qconds_samplest;       /* Filter query conditions that check the sample state */
+  rhc_qcset_t qcond_scratch;         /* Conditions of the sample replaced by store, for updating the conditions */
   void *qcond_eval_samplebuf;        /* Temporary storage for evaluating query conditions, NULL if no qconds */
+  struct ddsrt_hh *keyconds;         /* Key conditions, indexed on instance handle */
 #ifdef DDS_HAS_LIFESPAN
   struct lifespan_adm lifespan;      /* Lifespan administration */
 #endif
@@ -346,16 +383,18 @@ struct trigger_info_pre {
 };
 
 struct trigger_info_qcond {
-  /* 0 or inst->conds depending on whether an invalid/valid sample was pushed out/added;
-     inc_xxx_read is there so read can indicate a sample changed from unread to read */
+  /* NULL or the conditions of the invalid/valid sample that was pushed out/added (for
+     an invalid sample, inst->conds); inc_xxx_read is there so read can indicate a sample
+     changed from unread to read.  Key conditions match any sample of their instance, so
+     for those it is only whether the pointer is non-NULL that matters. */
   bool dec_invsample_read;
   bool dec_sample_read;
   bool inc_invsample_read;
   bool inc_sample_read;
-  dds_querycond_mask_t dec_conds_invsample;
-  dds_querycond_mask_t dec_conds_sample;
-  dds_querycond_mask_t inc_conds_invsample;
-  dds_querycond_mask_t inc_conds_sample;
+  const rhc_qcset_t *dec_conds_invsample;
+  const rhc_qcset_t *dec_conds_sample;
+  const rhc_qcset_t *inc_conds_invsample;
+  const rhc_qcset_t *inc_conds_sample;
 };
 
 struct trigger_info_post {
@@ -399,6 +438,108 @@ static bool inst_has_unread (const struct rhc_instance *i)
   return inst_nread (i) < inst_nsamples (i);
 }
 
+static const uint64_t *qcset_words (const struct dds_rhc_default *rhc, const rhc_qcset_t *s)
+{
+  return (rhc->qcond_nwords == 1) ? &s->w : s->ws;
+}
+
+static uint64_t *qcset_words_rw (const struct dds_rhc_default *rhc, rhc_qcset_t *s)
+{
+  return (rhc->qcond_nwords == 1) ? &s->w : s->ws;
+}
+
+static void qcset_init (const struct dds_rhc_default *rhc, rhc_qcset_t *s)
+{
+  if (rhc->qcond_nwords == 1)
+    s->w = 0;
+  else
+    s->ws = ddsrt_calloc (rhc->qcond_nwords, sizeof (*s->ws));
+}
+
+static void qcset_fini (const struct dds_rhc_default *rhc, rhc_qcset_t *s)
+{
+  if (rhc->qcond_nwords > 1)
+    ddsrt_free (s->ws);
+}
+
+static void qcset_clear (const struct dds_rhc_default *rhc, rhc_qcset_t *s)
+{
+  memset (qcset_words_rw (rhc, s), 0, rhc->qcond_nwords * sizeof (uint64_t));
+}
+
+static void qcset_resize (const struct dds_rhc_default *rhc, rhc_qcset_t *s, uint32_t nwords)
+{
+  /* Pre: rhc->qcond_nwords is the current size */
+  assert (nwords > rhc->qcond_nwords);
+  uint64_t *ws = ddsrt_calloc (nwords, sizeof (*ws));
+  memcpy (ws, qcset_words (rhc, s), rhc->qcond_nwords * sizeof (*ws));
+  qcset_fini (rhc, s);
+  s->ws = ws;
+}
+
+static bool qcset_test (const struct dds_rhc_default *rhc, const rhc_qcset_t *s, uint32_t idx)
+{
+  /* an index out of range is simply not in the set */
+  if (idx >= 64 * rhc->qcond_nwords)
+    return false;
+  return (qcset_words (rhc, s)[idx / 64] >> (idx % 64)) & 1;
+}
+
+static void qcset_assign (const struct dds_rhc_default *rhc, rhc_qcset_t *s, uint32_t idx, bool v)
+{
+  assert (idx < 64 * rhc->qcond_nwords);
+  uint64_t * const w = &qcset_words_rw (rhc, s)[idx / 64];
+  *w = (*w & ~((uint64_t) 1 << (idx % 64))) | ((uint64_t) v << (idx % 64));
+}
+
+static bool qcset_isempty (const struct dds_rhc_default *rhc, const rhc_qcset_t *s)
+{
+  const uint64_t *ws = qcset_words (rhc, s);
+  for (uint32_t i = 0; i < rhc->qcond_nwords; i++)
+    if (ws[i])
+      return false;
+  return true;
+}
+
+static bool qcset_intersects (const struct dds_rhc_default *rhc, const rhc_qcset_t *a, const rhc_qcset_t *b)
+{
+  const uint64_t *as = qcset_words (rhc, a), *bs = qcset_words (rhc, b);
+  for (uint32_t i = 0; i < rhc->qcond_nwords; i++)
+    if (as[i] & bs[i])
+      return true;
+  return false;
+}
+
+static bool qcset_equal (const struct dds_rhc_default *rhc, const rhc_qcset_t *a, const rhc_qcset_t *b)
+{
+  /* NULL means no sample, and that is different from a sample that matches no filters */
+  if (a == NULL || b == NULL)
+    return a == b;
+  return memcmp (qcset_words (rhc, a), qcset_words (rhc, b), rhc->qcond_nwords * sizeof (uint64_t)) == 0;
+}
+
+static uint32_t qcset_first_clear (const struct dds_rhc_default *rhc, const rhc_qcset_t *s)
+{
+  /* returns 64 * rhc->qcond_nwords if all bits are set */
+  const uint64_t *ws = qcset_words (rhc, s);
+  uint32_t i;
+  for (i = 0; i < rhc->qcond_nwords && ws[i] == ~(uint64_t) 0; i++)
+    ;
+  if (i == rhc->qcond_nwords)
+    return 64 * i;
+  uint32_t j = 0;
+  while ((ws[i] >> j) & 1)
+    j++;
+  return 64 * i + j;
+}
+
+static bool qcond_matches (const struct dds_rhc_default *rhc, const dds_readcond *qcond, const rhc_qcset_t *conds)
+{
+  /* Key conditions are only ever evaluated on the samples of their own instance */
+  assert (qcond->m_query.m_filter != 0 || qcond->m_query.m_keyinst != NULL);
+  return qcond->m_query.m_filter == 0 || qcset_test (rhc, conds, qcond->m_query.m_index);
+}
+
 static bool untyped_to_clean_invsample (const struct ddsi_sertype *type, const struct ddsi_serdata *d, void *sample, void **bufptr, void *buflim)
 {
   /* ddsi_serdata_untyped_to_sample just deals with the key value, without paying any attention to attributes;
@@ -434,6 +575,19 @@ static int instance_iid_eq (const void *va, const void *vb)
   return (a->iid == b->iid);
 }
 
+static uint32_t keyconds_iid_hash (const void *va)
+{
+  const struct rhc_keyconds *a = va;
+  return (uint32_t) a->iid;
+}
+
+static int keyconds_iid_eq (const void *va, const void *vb)
+{
+  const struct rhc_keyconds *a = va;
+  const struct rhc_keyconds *b = vb;
+  return (a->iid == b->iid);
+}
+
 static void add_inst_to_nonempty_list (struct dds_rhc_default *rhc, struct rhc_instance *inst)
 {
   ddsrt_circlist_append (&rhc->nonempty_instances, &inst->nonempty_list);
@@ -463,6 +617,21 @@ static struct rhc_instance *next_nonempty_instance (const struct rhc_instance *i
   return DDSRT_FROM_CIRCLIST (struct rhc_instance, nonempty_list, inst->nonempty_list.next);
 }
 
+static void fifo_append (struct dds_rhc_default *rhc, struct rhc_fifo_elem *elem, struct rhc_instance *inst)
+{
+  if (rhc->reception_order)
+  {
+    elem->inst = inst;
+    ddsrt_circlist_append (&rhc->fifo, &elem->e);
+  }
+}
+
+static void fifo_remove (struct dds_rhc_default *rhc, struct rhc_fifo_elem *elem)
+{
+  if (rhc->reception_order)
+    ddsrt_circlist_remove (&rhc->fifo, &elem->e);
+}
+
 #ifdef DDS_HAS_LIFESPAN
 static void drop_expired_samples (struct dds_rhc_default *rhc, struct rhc_sample *sample)
 {
@@ -506,10 +675,10 @@ static void drop_expired_samples (struct dds_rhc_default *rhc, struct rhc_sample
   {
     inst->latest = NULL;
   }
-  trig_qc.dec_conds_sample = sample->conds;
-  free_sample (rhc, inst, sample);
+  trig_qc.dec_conds_sample = &sample->conds;
   get_trigger_info_cmn (&post.c, inst);
   update_conditions_locked (rhc, false, &pre, &post, &trig_qc, inst);
+  free_sample (rhc, inst, sample);
   if (inst_is_empty (inst))
     account_for_nonempty_to_empty_transition(rhc, &inst, "; ");
   TRACE (")\n");
@@ -567,7 +736,10 @@ struct dds_rhc *dds_rhc_default_new_xchecks (dds_reader *reader, struct ddsi_dom
   lwregs_init (&rhc->registrations);
   ddsrt_mutex_init (&rhc->lock);
   rhc->instances = ddsrt_hh_new (1, instance_iid_hash, instance_iid_eq);
+  rhc->keyconds = ddsrt_hh_new (1, keyconds_iid_hash, keyconds_iid_eq);
+  rhc->qcond_nwords = 1;
   ddsrt_circlist_init (&rhc->nonempty_instances);
+  ddsrt_circlist_init (&rhc->fifo);
   rhc->type = type;
   rhc->reader = reader;
   rhc->tkmap = gv->m_tkmap;
@@ -609,6 +781,9 @@ static void dds_rhc_default_set_qos (struct ddsi_rhc *rhc_common, const dds_qos_
   rhc->by_source_ordering = (qos->destination_order.kind == DDS_DESTINATIONORDER_BY_SOURCE_TIMESTAMP);
   rhc->exclusive_ownership = (qos->ownership.kind == DDS_OWNERSHIP_EXCLUSIVE);
   rhc->reliable = (qos->reliability.kind == DDS_RELIABILITY_RELIABLE);
+  /* PRESENTATION is immutable, so this can't change once samples have been stored */
+  assert (rhc->n_vsamples + rhc->n_invsamples == 0 || rhc->reception_order == (qos->presentation.access_scope != DDS_PRESENTATION_INSTANCE && qos->presentation.ordered_access));
+  rhc->reception_order = (qos->presentation.access_scope != DDS_PRESENTATION_INSTANCE && qos->presentation.ordered_access);
   assert(qos->history.kind != DDS_HISTORY_KEEP_LAST || qos->history.depth > 0);
   rhc->history_depth = (qos->history.kind == DDS_HISTORY_KEEP_LAST) ? (uint32_t)qos->history.depth : ~0u;
   /* FIXME: updating deadline duration not yet supported
@@ -629,31 +804,68 @@ static bool eval_predicate_invsample (const struct dds_rhc_default *rhc, const s
   return ret;
 }
 
-static struct rhc_sample *alloc_sample (struct rhc_instance *inst)
+static void eval_predicates (const struct dds_rhc_default *rhc, rhc_qcset_t *conds)
 {
+  /* Evaluates all filter conditions on the (invalid) sample in qcond_eval_samplebuf, so
+     that it needs to be deserialised only once, regardless of the number of conditions */
+  uint64_t * const ws = qcset_words_rw (rhc, conds);
+  qcset_clear (rhc, conds);
+  for (const dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
+  {
+    if (rc->m_query.m_filter != 0 && rc->m_query.m_filter (rhc->qcond_eval_samplebuf))
+      ws[rc->m_query.m_index / 64] |= (uint64_t) 1 << (rc->m_query.m_index % 64);
+  }
+}
+
+static void eval_predicates_sample (const struct dds_rhc_default *rhc, const struct ddsi_serdata *sample, rhc_qcset_t *conds)
+{
+  if (rhc->nqconds == 0)
+    qcset_clear (rhc, conds);
+  else
+  {
+    ddsi_serdata_to_sample (sample, rhc->qcond_eval_samplebuf, NULL, NULL);
+    eval_predicates (rhc, conds);
+  }
+}
+
+static void eval_predicates_invsample (const struct dds_rhc_default *rhc, const struct rhc_instance *inst, rhc_qcset_t *conds)
+{
+  if (rhc->nqconds == 0)
+    qcset_clear (rhc, conds);
+  else
+  {
+    untyped_to_clean_invsample (rhc->type, inst->tk->m_sample, rhc->qcond_eval_samplebuf, NULL, NULL);
+    eval_predicates (rhc, conds);
+  }
+}
+
+static struct rhc_sample *alloc_sample (const struct dds_rhc_default *rhc, struct rhc_instance *inst)
+{
+  struct rhc_sample *s;
   if (inst->a_sample_free)
   {
     inst->a_sample_free = 0;
 #if USE_VALGRIND
     VALGRIND_MAKE_MEM_UNDEFINED (&inst->a_sample, sizeof (inst->a_sample));
 #endif
-    return &inst->a_sample;
+    s = &inst->a_sample;
   }
   else
   {
     /* This instead of sizeof(rhc_sample) gets us type checking */
-    struct rhc_sample *s;
     s = ddsrt_malloc (sizeof (*s));
-    return s;
   }
+  qcset_init (rhc, &s->conds);
+  return s;
 }
 
-static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct rhc_sample *s)
+static void free_sample_keep_serdata (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct rhc_sample *s)
 {
-#ifndef DDS_HAS_LIFESPAN
-  DDSRT_UNUSED_ARG (rhc);
-#endif
-  ddsi_serdata_unref (s->sample);
+  /* Frees the sample, but not the serdata it references: ownership of that
+     is transferred to the caller (take uses this to convert it to an
+     application sample after unlocking the RHC) */
+  fifo_remove (rhc, &s->fifo);
+  qcset_fini (rhc, &s->conds);
 #ifdef DDS_HAS_LIFESPAN
   lifespan_unregister_sample_locked (&rhc->lifespan, &s->lifespan);
 #endif
@@ -671,12 +883,19 @@ static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
   }
 }
 
+static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct rhc_sample *s)
+{
+  ddsi_serdata_unref (s->sample);
+  free_sample_keep_serdata (rhc, inst, s);
+}
+
 static void inst_clear_invsample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct trigger_info_qcond *trig_qc)
 {
   assert (inst->inv_exists);
-  assert (trig_qc->dec_conds_invsample == 0);
+  assert (trig_qc->dec_conds_invsample == NULL);
   inst->inv_exists = 0;
-  trig_qc->dec_conds_invsample = inst->conds;
+  fifo_remove (rhc, &inst->inv_fifo);
+  trig_qc->dec_conds_invsample = &inst->conds;
   if (inst->inv_isread)
   {
     trig_qc->dec_invsample_read = true;
@@ -702,10 +921,11 @@ static void inst_set_invsample (struct dds_rhc_default *rhc, struct rhc_instance
   {
     /* Obviously optimisable, but that is perhaps not worth the bother */
     inst_clear_invsample_if_exists (rhc, inst, trig_qc);
-    assert (trig_qc->inc_conds_invsample == 0);
-    trig_qc->inc_conds_invsample = inst->conds;
+    assert (trig_qc->inc_conds_invsample == NULL);
+    trig_qc->inc_conds_invsample = &inst->conds;
     inst->inv_exists = 1;
     inst->inv_isread = 0;
+    fifo_append (rhc, &inst->inv_fifo, inst);
     rhc->n_invsamples++;
     *nda = true;
   }
@@ -715,6 +935,7 @@ static void free_empty_instance (struct rhc_instance *inst, struct dds_rhc_defau
 {
   assert (inst_is_empty (inst));
   ddsi_tkmap_instance_unref (rhc->tkmap, inst->tk);
+  qcset_fini (rhc, &inst->conds);
 #ifdef DDS_HAS_DEADLINE_MISSED
   if (inst->deadline_reg)
     deadline_unregister_instance_locked (&rhc->deadline, &inst->deadline);
@@ -786,6 +1007,12 @@ static void dds_rhc_default_free (struct ddsi_rhc *rhc_common)
 #endif
   ddsrt_hh_free (rhc->instances);
   lwregs_fini (&rhc->registrations);
+  /* conditions are detached before the reader is deleted */
+  assert (rhc->nkeyconds == 0);
+  ddsrt_hh_free (rhc->keyconds);
+  qcset_fini (rhc, &rhc->qconds_inuse);
+  qcset_fini (rhc, &rhc->qconds_samplest);
+  qcset_fini (rhc, &rhc->qcond_scratch);
   if (rhc->qcond_eval_samplebuf != NULL)
     ddsi_sertype_free_sample (rhc->type, rhc->qcond_eval_samplebuf, DDS_FREE_ALL);
   ddsrt_mutex_destroy (&rhc->lock);
@@ -817,10 +1044,10 @@ static void init_trigger_info_qcond (struct trigger_info_qcond *qc)
   qc->dec_sample_read = false;
   qc->inc_invsample_read = false;
   qc->inc_sample_read = false;
-  qc->dec_conds_invsample = 0;
-  qc->dec_conds_sample = 0;
-  qc->inc_conds_invsample = 0;
-  qc->inc_conds_sample = 0;
+  qc->dec_conds_invsample = NULL;
+  qc->dec_conds_sample = NULL;
+  qc->inc_conds_invsample = NULL;
+  qc->inc_conds_sample = NULL;
 }
 
 static bool trigger_info_differs (const struct dds_rhc_default *rhc, const struct trigger_info_pre *pre, const struct trigger_info_post *post, const struct trigger_info_qcond *trig_qc)
@@ -829,11 +1056,11 @@ static bool trigger_info_differs (const struct dds_rhc_default *rhc, const struc
       pre->c.has_read != post->c.has_read ||
       pre->c.has_not_read != post->c.has_not_read)
     return true;
-  else if (rhc->nqconds == 0)
+  else if (rhc->nqconds == 0 && rhc->nkeyconds == 0)
     return false;
   else
-    return (trig_qc->dec_conds_invsample != trig_qc->inc_conds_invsample ||
-            trig_qc->dec_conds_sample != trig_qc->inc_conds_sample ||
+    return (!qcset_equal (rhc, trig_qc->dec_conds_invsample, trig_qc->inc_conds_invsample) ||
+            !qcset_equal (rhc, trig_qc->dec_conds_sample, trig_qc->inc_conds_sample) ||
             trig_qc->dec_invsample_read != trig_qc->inc_invsample_read ||
             trig_qc->dec_sample_read != trig_qc->inc_sample_read);
 }
@@ -858,15 +1085,21 @@ static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
     inst_clear_invsample_if_exists (rhc, inst, trig_qc);
     assert (inst->latest != NULL);
     s = inst->latest->next;
-    assert (trig_qc->dec_conds_sample == 0);
+    assert (trig_qc->dec_conds_sample == NULL);
     ddsi_serdata_unref (s->sample);
+    fifo_remove (rhc, &s->fifo);
 
 #ifdef DDS_HAS_LIFESPAN
     lifespan_unregister_sample_locked (&rhc->lifespan, &s->lifespan);
 #endif
 
+    /* the conditions of the old sample are needed for updating the conditions after
+       the new one has been stored, swapping is cheaper than copying */
+    rhc_qcset_t tmp = rhc->qcond_scratch;
+    rhc->qcond_scratch = s->conds;
+    s->conds = tmp;
     trig_qc->dec_sample_read = s->isread;
-    trig_qc->dec_conds_sample = s->conds;
+    trig_qc->dec_conds_sample = &rhc->qcond_scratch;
     if (s->isread)
     {
       inst->nvread--;
@@ -896,7 +1129,7 @@ static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
     }
 
     /* add new latest sample */
-    s = alloc_sample (inst);
+    s = alloc_sample (rhc, inst);
     inst_clear_invsample_if_exists (rhc, inst, trig_qc);
     if (inst->latest == NULL)
     {
@@ -916,21 +1149,15 @@ static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
   s->isread = false;
   s->disposed_gen = inst->disposed_gen;
   s->no_writers_gen = inst->no_writers_gen;
+  fifo_append (rhc, &s->fifo, inst);
 #ifdef DDS_HAS_LIFESPAN
   s->inst = inst;
   s->lifespan.t_expire = wrinfo->lifespan_exp;
   lifespan_register_sample_locked (&rhc->lifespan, &s->lifespan);
 #endif
 
-  s->conds = 0;
-  if (rhc->nqconds != 0)
-  {
-    for (dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
-      if (rc->m_query.m_filter != 0 && eval_predicate_sample (rhc, s->sample, rc->m_query.m_filter))
-        s->conds |= rc->m_query.m_qcmask;
-  }
-
-  trig_qc->inc_conds_sample = s->conds;
+  eval_predicates_sample (rhc, s->sample, &s->conds);
+  trig_qc->inc_conds_sample = &s->conds;
   inst->latest = s;
   *nda = true;
   return true;
@@ -1394,22 +1621,18 @@ static struct rhc_instance *alloc_new_instance (struct dds_rhc_default *rhc, con
   inst->deadline_reg = 0;
   inst->isnew = 1;
   inst->a_sample_free = 1;
-  inst->conds = 0;
   inst->wr_iid = wrinfo->iid;
   inst->wr_iid_islive = (inst->wrcount != 0);
   inst->wr_guid = wrinfo->guid;
   inst->tstamp = serdata->timestamp;
   inst->strength = wrinfo->ownership_strength;
 
-  if (rhc->nqconds != 0)
+  qcset_init (rhc, &inst->conds);
+  eval_predicates_invsample (rhc, inst, &inst->conds);
+  if (rhc->nkeyconds > 0)
   {
-    for (dds_readcond *c = rhc->conds; c != NULL; c = c->m_next)
-    {
-      assert ((dds_entity_kind (&c->m_entity) == DDS_KIND_COND_READ && c->m_query.m_filter == 0) ||
-              (dds_entity_kind (&c->m_entity) == DDS_KIND_COND_QUERY && c->m_query.m_filter != 0));
-      if (c->m_query.m_filter && eval_predicate_invsample (rhc, inst, c->m_query.m_filter))
-        inst->conds |= c->m_query.m_qcmask;
-    }
+    struct rhc_keyconds template = { .iid = inst->iid };
+    inst->keyconds = ddsrt_hh_lookup (rhc->keyconds, &template);
   }
   return inst;
 }
@@ -1550,6 +1773,62 @@ static void update_viewstate_and_disposedness (struct dds_rhc_default * __restri
   }
 }
 
+/* With KEEP_LAST(1) history, the typical update is a new sample from the writer
+   that also wrote the previous one, for an alive instance that holds only that
+   previous sample.  That can be done by overwriting the sample in place: the
+   instance state doesn't change, the registration is already known, and the
+   state of the read conditions only changes if the replaced sample had been
+   read, so all of the generic machinery can be skipped.  Returns the serdata
+   that was replaced (to be released once the lock is dropped), or NULL if the
+   sample must go through the generic path. */
+static struct ddsi_serdata *store_keep_last_1_inplace (struct dds_rhc_default * __restrict rhc, struct rhc_instance * __restrict inst, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample)
+{
+  struct rhc_sample * const s = inst->latest;
+  assert (rhc->history_depth == 1);
+  if (s == NULL || inst->inv_exists || inst->isdisposed || !inst->wr_iid_islive || inst->wr_iid != wrinfo->iid)
+    return NULL;
+  if (rhc->by_source_ordering && sample->timestamp.v <= inst->tstamp.v)
+    return NULL;
+  if (rhc->nqconds > 0 || rhc->nkeyconds > 0 || (s->isread && rhc->nconds > 0))
+    return NULL;
+  if (rhc->reader && rhc->reader->m_topic->m_filter.mode != DDS_TOPIC_FILTER_NONE)
+    return NULL;
+
+  assert (inst->nvsamples == 1 && s->next == s);
+  struct ddsi_serdata * const old = s->sample;
+  fifo_remove (rhc, &s->fifo);
+#ifdef DDS_HAS_LIFESPAN
+  lifespan_unregister_sample_locked (&rhc->lifespan, &s->lifespan);
+#endif
+  if (s->isread)
+  {
+    inst->nvread--;
+    rhc->n_vread--;
+  }
+  s->sample = ddsi_serdata_ref (sample);
+  s->wr_iid = wrinfo->iid;
+  s->isread = false;
+  s->disposed_gen = inst->disposed_gen;
+  s->no_writers_gen = inst->no_writers_gen;
+  fifo_append (rhc, &s->fifo, inst);
+#ifdef DDS_HAS_LIFESPAN
+  s->lifespan.t_expire = wrinfo->lifespan_exp;
+  lifespan_register_sample_locked (&rhc->lifespan, &s->lifespan);
+#endif
+  inst->tstamp = sample->timestamp;
+  inst->strength = wrinfo->ownership_strength;
+#ifdef DDS_HAS_DEADLINE_MISSED
+  if (inst->deadline_reg)
+    deadline_renew_instance_locked (&rhc->deadline, &inst->deadline);
+  else
+  {
+    deadline_register_instance_locked (&rhc->deadline, &inst->deadline, ddsrt_time_monotonic ());
+    inst->deadline_reg = 1;
+  }
+#endif
+  return old;
+}
+
 /*
   dds_rhc_store: DDSI up call into read cache to store new sample. Returns whether sample
   delivered (true unless a reliable sample rejected).
@@ -1591,6 +1870,20 @@ static bool dds_rhc_default_store (struct ddsi_rhc * __restrict rhc_common, cons
   ddsrt_mutex_lock (&rhc->lock);
 
   inst = ddsrt_hh_lookup (rhc->instances, &dummy_instance);
+  if (inst != NULL && has_data && statusinfo == 0 && rhc->history_depth == 1)
+  {
+    struct ddsi_serdata *replaced;
+    if ((replaced = store_keep_last_1_inplace (rhc, inst, wrinfo, sample)) != NULL)
+    {
+      TRACE (" overwrite\n");
+      assert (rhc_check_counts_locked (rhc, true, true));
+      ddsrt_mutex_unlock (&rhc->lock);
+      ddsi_serdata_unref (replaced);
+      if (rhc->reader)
+        dds_reader_data_available_cb (rhc->reader);
+      return true;
+    }
+  }
   if (inst == NULL)
   {
     /* New instance for this reader.  If no data content -- not (also)
@@ -1958,14 +2251,14 @@ static void patch_generations (dds_sample_info_t *si, uint32_t last_of_inst)
   }
 }
 
-static bool read_sample_update_conditions (struct dds_rhc_default *rhc, struct trigger_info_pre *pre, struct trigger_info_post *post, struct trigger_info_qcond *trig_qc, struct rhc_instance *inst, dds_querycond_mask_t conds, bool sample_wasread)
+static bool read_sample_update_conditions (struct dds_rhc_default *rhc, struct trigger_info_pre *pre, struct trigger_info_post *post, struct trigger_info_qcond *trig_qc, struct rhc_instance *inst, const rhc_qcset_t *conds, bool sample_wasread)
 {
   /* No query conditions that are dependent on sample states */
-  if (rhc->qconds_samplest == 0)
+  if (rhc->nqconds_samplest == 0)
     return false;
 
   /* Some, but perhaps none that matches this sample */
-  if ((conds & rhc->qconds_samplest) == 0)
+  if (!qcset_intersects (rhc, conds, &rhc->qconds_samplest) && (inst->keyconds == NULL || inst->keyconds->nsamplest == 0))
     return false;
 
   TRACE("read_sample_update_conditions\n");
@@ -1974,15 +2267,15 @@ static bool read_sample_update_conditions (struct dds_rhc_default *rhc, struct t
   trig_qc->inc_sample_read = true;
   get_trigger_info_cmn (&post->c, inst);
   update_conditions_locked (rhc, false, pre, post, trig_qc, inst);
-  trig_qc->dec_conds_sample = trig_qc->inc_conds_sample = 0;
+  trig_qc->dec_conds_sample = trig_qc->inc_conds_sample = NULL;
   pre->c = post->c;
   return false;
 }
 
-static bool take_sample_update_conditions (struct dds_rhc_default *rhc, struct trigger_info_pre *pre, struct trigger_info_post *post, struct trigger_info_qcond *trig_qc, struct rhc_instance *inst, dds_querycond_mask_t conds, bool sample_wasread)
+static bool take_sample_update_conditions (struct dds_rhc_default *rhc, struct trigger_info_pre *pre, struct trigger_info_post *post, struct trigger_info_qcond *trig_qc, struct rhc_instance *inst, const rhc_qcset_t *conds, bool sample_wasread)
 {
   /* Mostly the same as read_...: but we are deleting samples (so no "inc sample") and need to process all query conditions that match this sample. */
-  if (rhc->nqconds == 0 || conds == 0)
+  if ((rhc->nqconds == 0 || qcset_isempty (rhc, conds)) && inst->keyconds == NULL)
     return false;
 
   TRACE("take_sample_update_conditions\n");
@@ -1990,11 +2283,22 @@ static bool take_sample_update_conditions (struct dds_rhc_default *rhc, struct t
   trig_qc->dec_sample_read = sample_wasread;
   get_trigger_info_cmn (&post->c, inst);
   update_conditions_locked (rhc, false, pre, post, trig_qc, inst);
-  trig_qc->dec_conds_sample = 0;
+  trig_qc->dec_conds_sample = NULL;
   pre->c = post->c;
   return false;
 }
 
+/* Read and take collect (references to) the serialised samples while holding
+   the RHC lock, but only convert them to application samples after releasing
+   it.  Deserialisation is generally the most expensive part of reading data,
+   and this way it no longer blocks the delivery thread from storing new
+   samples, nor other threads from reading/taking.  For read the serdata is
+   ref'd, for take the reference held by the RHC is transferred; for an
+   invalid sample the key in the tkmap instance is ref'd, as the instance may
+   disappear once the lock is released. */
+
+#define READ_TAKE_INLINE_SDS 32
+
 typedef bool (*read_take_to_sample_t) (const struct ddsi_serdata * __restrict d, void *__restrict  *__restrict  sample, void * __restrict * __restrict bufptr, void * __restrict buflim);
 typedef bool (*read_take_to_invsample_t) (const struct ddsi_sertype * __restrict type, const struct ddsi_serdata * __restrict d, void *__restrict * __restrict sample, void * __restrict * __restrict bufptr, void * __restrict buflim);
 
@@ -2008,21 +2312,34 @@ static bool read_take_to_invsample (const struct ddsi_sertype * __restrict type,
   return untyped_to_clean_invsample (type, d, *sample, (void **) bufptr, buflim);
 }
 
-static bool read_take_to_sample_ref (const struct ddsi_serdata * __restrict d, void * __restrict * __restrict sample, void * __restrict * __restrict bufptr, void * __restrict buflim)
+static struct ddsi_serdata **read_take_sds_alloc (struct ddsi_serdata **sdsbuf, void **values, int32_t max_samples, read_take_to_sample_t to_sample)
 {
-  (void) bufptr; (void) buflim;
-  *sample = ddsi_serdata_ref (d);
-  return true;
+  /* readcdr/takecdr (to_sample = NULL) return the serdata references themselves */
+  if (to_sample == NULL)
+    return (struct ddsi_serdata **) values;
+  else if (max_samples <= READ_TAKE_INLINE_SDS)
+    return sdsbuf;
+  else
+    return ddsrt_malloc ((size_t) max_samples * sizeof (*sdsbuf));
 }
 
-static bool read_take_to_invsample_ref (const struct ddsi_sertype * __restrict type, const struct ddsi_serdata * __restrict d, void * __restrict * __restrict sample, void * __restrict * __restrict bufptr, void * __restrict buflim)
+static void read_take_sds_convert (const struct dds_rhc_default *rhc, struct ddsi_serdata **sds, struct ddsi_serdata **sdsbuf, void **values, const dds_sample_info_t *info_seq, int32_t n, read_take_to_sample_t to_sample, read_take_to_invsample_t to_invsample)
 {
-  (void) type; (void) bufptr; (void) buflim;
-  *sample = ddsi_serdata_ref (d);
-  return true;
+  if (to_sample == NULL)
+    return;
+  for (int32_t i = 0; i < n; i++)
+  {
+    if (info_seq[i].valid_data)
+      to_sample (sds[i], values + i, 0, 0);
+    else
+      to_invsample (rhc->type, sds[i], values + i, 0, 0);
+    ddsi_serdata_unref (sds[i]);
+  }
+  if (sds != sdsbuf)
+    ddsrt_free (sds);
 }
 
-static int32_t read_w_qminv_inst (struct dds_rhc_default * const __restrict rhc, struct rhc_instance * const __restrict inst, void * __restrict * __restrict values, dds_sample_info_t * __restrict info_seq, const int32_t max_samples, const uint32_t qminv, const dds_querycond_mask_t qcmask, read_take_to_sample_t to_sample, read_take_to_invsample_t to_invsample)
+static int32_t read_w_qminv_inst (struct dds_rhc_default * const __restrict rhc, struct rhc_instance * const __restrict inst, struct ddsi_serdata ** __restrict sds, dds_sample_info_t * __restrict info_seq, const int32_t max_samples, const uint32_t qminv, const dds_readcond *qcond)
 {
   assert (max_samples > 0);
   if (inst_is_empty (inst) || (qmask_of_inst (inst) & qminv) != 0)
@@ -2044,14 +2361,14 @@ static int32_t read_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
   {
     struct rhc_sample *sample = inst->latest->next, * const end1 = sample;
     do {
-      if ((qmask_of_sample (sample) & qminv) == 0 && (qcmask == 0 || (sample->conds & qcmask)))
+      if ((qmask_of_sample (sample) & qminv) == 0 && (qcond == NULL || qcond_matches (rhc, qcond, &sample->conds)))
       {
         /* sample state matches too */
         set_sample_info (info_seq + n, inst, sample);
-        to_sample (sample->sample, values + n, 0, 0);
+        sds[n] = ddsi_serdata_ref (sample->sample);
         if (!sample->isread)
         {
-          read_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, sample->conds, false);
+          read_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, &sample->conds, false);
           sample->isread = true;
           inst->nvread++;
           rhc->n_vread++;
@@ -2063,13 +2380,13 @@ static int32_t read_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
   }
 
   /* add an invalid sample if it exists, matches and there is room in the result */
-  if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && (qcmask == 0 || (inst->conds & qcmask)))
+  if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && (qcond == NULL || qcond_matches (rhc, qcond, &inst->conds)))
   {
     set_sample_info_invsample (info_seq + n, inst);
-    to_invsample (rhc->type, inst->tk->m_sample, values + n, 0, 0);
+    sds[n] = ddsi_serdata_ref (inst->tk->m_sample);
     if (!inst->inv_isread)
     {
-      read_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, inst->conds, false);
+      read_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, &inst->conds, false);
       inst->inv_isread = 1;
       rhc->n_invread++;
     }
@@ -2091,16 +2408,16 @@ static int32_t read_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
   if (nread != inst_nread (inst) || inst_became_old)
   {
     get_trigger_info_cmn (&post.c, inst);
-    assert (trig_qc.dec_conds_invsample == 0);
-    assert (trig_qc.dec_conds_sample == 0);
-    assert (trig_qc.inc_conds_invsample == 0);
-    assert (trig_qc.inc_conds_sample == 0);
+    assert (trig_qc.dec_conds_invsample == NULL);
+    assert (trig_qc.dec_conds_sample == NULL);
+    assert (trig_qc.inc_conds_invsample == NULL);
+    assert (trig_qc.inc_conds_sample == NULL);
     update_conditions_locked (rhc, false, &pre, &post, &trig_qc, inst);
   }
   return n;
 }
 
-static int32_t take_w_qminv_inst (struct dds_rhc_default * const __restrict rhc, struct rhc_instance * __restrict * __restrict instptr, void * __restrict * __restrict values, dds_sample_info_t * __restrict info_seq, const int32_t max_samples, const uint32_t qminv, const dds_querycond_mask_t qcmask, read_take_to_sample_t to_sample, read_take_to_invsample_t to_invsample)
+static int32_t take_w_qminv_inst (struct dds_rhc_default * const __restrict rhc, struct rhc_instance * __restrict * __restrict instptr, struct ddsi_serdata ** __restrict sds, dds_sample_info_t * __restrict info_seq, const int32_t max_samples, const uint32_t qminv, const dds_readcond *qcond)
 {
   struct rhc_instance *inst = *instptr;
   assert (max_samples > 0);
@@ -2125,16 +2442,16 @@ static int32_t take_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
     while (nvsamples--)
     {
       struct rhc_sample * const sample1 = sample->next;
-      if ((qmask_of_sample (sample) & qminv) != 0 || (qcmask != 0 && !(sample->conds & qcmask)))
+      if ((qmask_of_sample (sample) & qminv) != 0 || (qcond != NULL && !qcond_matches (rhc, qcond, &sample->conds)))
       {
         /* sample mask doesn't match, or content predicate doesn't match */
         psample = sample;
       }
       else
       {
-        take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, sample->conds, sample->isread);
+        take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, &sample->conds, sample->isread);
         set_sample_info (info_seq + n, inst, sample);
-        to_sample (sample->sample, values + n, 0, 0);
+        sds[n] = sample->sample;
         rhc->n_vsamples--;
         if (sample->isread)
         {
@@ -2149,7 +2466,7 @@ static int32_t take_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
             inst->latest = psample;
           psample->next = sample1;
         }
-        free_sample (rhc, inst, sample);
+        free_sample_keep_serdata (rhc, inst, sample);
         if (++n == max_samples)
           break;
       }
@@ -2157,15 +2474,15 @@ static int32_t take_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
     }
   }
 
-  if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && (qcmask == 0 || (inst->conds & qcmask) != 0))
+  if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && (qcond == NULL || qcond_matches (rhc, qcond, &inst->conds)))
   {
     struct trigger_info_qcond dummy_trig_qc;
 #ifndef NDEBUG
     init_trigger_info_qcond (&dummy_trig_qc);
 #endif
-    take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, inst->conds, inst->inv_isread);
+    take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, &inst->conds, inst->inv_isread);
     set_sample_info_invsample (info_seq + n, inst);
-    to_invsample (rhc->type, inst->tk->m_sample, values + n, 0, 0);
+    sds[n] = ddsi_serdata_ref (inst->tk->m_sample);
     inst_clear_invsample (rhc, inst, &dummy_trig_qc);
     ++n;
   }
@@ -2180,10 +2497,10 @@ static int32_t take_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
     }
     /* if nsamples = 0, it won't match anything, so no need to do anything here for drop_instance_noupdate_no_writers */
     get_trigger_info_cmn (&post.c, inst);
-    assert (trig_qc.dec_conds_invsample == 0);
-    assert (trig_qc.dec_conds_sample == 0);
-    assert (trig_qc.inc_conds_invsample == 0);
-    assert (trig_qc.inc_conds_sample == 0);
+    assert (trig_qc.dec_conds_invsample == NULL);
+    assert (trig_qc.dec_conds_sample == NULL);
+    assert (trig_qc.inc_conds_invsample == NULL);
+    assert (trig_qc.inc_conds_sample == NULL);
     update_conditions_locked (rhc, false, &pre, &post, &trig_qc, inst);
   }
 
@@ -2192,10 +2509,237 @@ static int32_t take_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
   return n;
 }
 
+/* Reception-ordered read/take walk the FIFO of all samples instead of the
+   instances, returning a single sample at a time, and so the instance bits
+   of read_w_qminv_inst/take_w_qminv_inst are spread out over the per-sample
+   functions and fifo_finish_view_state.  The view state is only updated at
+   the end so that it is the same for all samples of an instance in a single
+   result, like it is in the instance-ordered case.  The exception is an
+   instance that becomes empty because all its samples got taken, as its
+   state can't affect anything else anymore and the instance may have to be
+   dropped.  The sample and generation ranks are patched after releasing the
+   lock in fifo_patch_generations. */
+
+static bool fifo_elem_matches (const struct dds_rhc_default *rhc, const struct rhc_instance *inst, const struct rhc_sample *sample, const uint32_t qminv, const dds_readcond *qcond)
+{
+  /* sample = NULL: the invalid sample of inst */
+  if ((qmask_of_inst (inst) & qminv) != 0)
+    return false;
+  else if (sample)
+    return (qmask_of_sample (sample) & qminv) == 0 && (qcond == NULL || qcond_matches (rhc, qcond, &sample->conds));
+  else
+    return (qmask_of_invsample (inst) & qminv) == 0 && (qcond == NULL || qcond_matches (rhc, qcond, &inst->conds));
+}
+
+static int32_t read_w_qminv_fifo_sample (struct dds_rhc_default * const __restrict rhc, struct rhc_instance * const __restrict inst, struct rhc_sample * const __restrict sample, struct ddsi_serdata ** __restrict sds, dds_sample_info_t * __restrict info, const uint32_t qminv, const dds_readcond *qcond)
+{
+  if (!fifo_elem_matches (rhc, inst, sample, qminv, qcond))
+    return 0;
+
+  struct trigger_info_pre pre;
+  struct trigger_info_post post;
+  struct trigger_info_qcond trig_qc;
+  const uint32_t nread = inst_nread (inst);
+  get_trigger_info_pre (&pre, inst);
+  init_trigger_info_qcond (&trig_qc);
+
+  if (sample)
+  {
+    set_sample_info (info, inst, sample);
+    *sds = ddsi_serdata_ref (sample->sample);
+    if (!sample->isread)
+    {
+      read_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, &sample->conds, false);
+      sample->isread = true;
+      inst->nvread++;
+      rhc->n_vread++;
+    }
+  }
+  else
+  {
+    set_sample_info_invsample (info, inst);
+    *sds = ddsi_serdata_ref (inst->tk->m_sample);
+    if (!inst->inv_isread)
+    {
+      read_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, &inst->conds, false);
+      inst->inv_isread = 1;
+      rhc->n_invread++;
+    }
+  }
+
+  if (nread != inst_nread (inst))
+  {
+    get_trigger_info_cmn (&post.c, inst);
+    assert (trig_qc.dec_conds_invsample == NULL);
+    assert (trig_qc.dec_conds_sample == NULL);
+    assert (trig_qc.inc_conds_invsample == NULL);
+    assert (trig_qc.inc_conds_sample == NULL);
+    update_conditions_locked (rhc, false, &pre, &post, &trig_qc, inst);
+  }
+  return 1;
+}
+
+static int32_t take_w_qminv_fifo_sample (struct dds_rhc_default * const __restrict rhc, struct rhc_instance * __restrict inst, struct rhc_sample * const __restrict sample, struct ddsi_serdata ** __restrict sds, dds_sample_info_t * __restrict info, const uint32_t qminv, const dds_readcond *qcond)
+{
+  if (!fifo_elem_matches (rhc, inst, sample, qminv, qcond))
+    return 0;
+
+  struct trigger_info_pre pre;
+  struct trigger_info_post post;
+  struct trigger_info_qcond trig_qc;
+  get_trigger_info_pre (&pre, inst);
+  init_trigger_info_qcond (&trig_qc);
+
+  if (sample)
+  {
+    /* usually the sample is the oldest one of the instance, but samples may
+       have been skipped because they didn't match */
+    struct rhc_sample *psample = inst->latest;
+    while (psample->next != sample)
+      psample = psample->next;
+    take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, &sample->conds, sample->isread);
+    set_sample_info (info, inst, sample);
+    *sds = sample->sample;
+    rhc->n_vsamples--;
+    if (sample->isread)
+    {
+      inst->nvread--;
+      rhc->n_vread--;
+    }
+    if (--inst->nvsamples == 0)
+      inst->latest = NULL;
+    else
+    {
+      if (inst->latest == sample)
+        inst->latest = psample;
+      psample->next = sample->next;
+    }
+    free_sample_keep_serdata (rhc, inst, sample);
+  }
+  else
+  {
+    struct trigger_info_qcond dummy_trig_qc;
+#ifndef NDEBUG
+    init_trigger_info_qcond (&dummy_trig_qc);
+#endif
+    take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, &inst->conds, inst->inv_isread);
+    set_sample_info_invsample (info, inst);
+    *sds = ddsi_serdata_ref (inst->tk->m_sample);
+    inst_clear_invsample (rhc, inst, &dummy_trig_qc);
+  }
+
+  if (inst_is_empty (inst) && inst->isnew)
+  {
+    inst->isnew = 0;
+    rhc->n_new--;
+  }
+  get_trigger_info_cmn (&post.c, inst);
+  assert (trig_qc.dec_conds_invsample == NULL);
+  assert (trig_qc.dec_conds_sample == NULL);
+  assert (trig_qc.inc_conds_invsample == NULL);
+  assert (trig_qc.inc_conds_sample == NULL);
+  update_conditions_locked (rhc, false, &pre, &post, &trig_qc, inst);
+  if (inst_is_empty (inst))
+    account_for_nonempty_to_empty_transition (rhc, &inst, "take: ");
+  return 1;
+}
+
+static int32_t read_take_w_qminv_fifo (struct dds_rhc_default * __restrict rhc, bool take, struct ddsi_serdata ** __restrict sds, dds_sample_info_t * __restrict info_seq, const int32_t max_samples, const uint32_t qminv, const dds_readcond *qcond)
+{
+  /* take removes elements from the FIFO, so count rather than stop at the starting point */
+  uint32_t nelems = rhc->n_vsamples + rhc->n_invsamples;
+  int32_t n = 0;
+  if (nelems == 0)
+    return 0;
+  struct ddsrt_circlist_elem *elem = ddsrt_circlist_oldest (&rhc->fifo);
+  while (nelems-- > 0 && n < max_samples)
+  {
+    struct rhc_fifo_elem * const fe = DDSRT_FROM_CIRCLIST (struct rhc_fifo_elem, e, elem);
+    struct rhc_instance * const inst = fe->inst;
+    struct rhc_sample * const sample = (fe == &inst->inv_fifo) ? NULL : DDSRT_FROM_CIRCLIST (struct rhc_sample, fifo, fe);
+    elem = elem->next;
+    if (take)
+      n += take_w_qminv_fifo_sample (rhc, inst, sample, sds + n, info_seq + n, qminv, qcond);
+    else
+      n += read_w_qminv_fifo_sample (rhc, inst, sample, sds + n, info_seq + n, qminv, qcond);
+  }
+  return n;
+}
+
+static void fifo_finish_view_state (struct dds_rhc_default * __restrict rhc, const dds_sample_info_t * __restrict info_seq, int32_t n)
+{
+  for (int32_t i = 0; i < n; i++)
+  {
+    struct rhc_instance template, *inst;
+    if (info_seq[i].view_state != DDS_VST_NEW)
+      continue;
+    template.iid = info_seq[i].instance_handle;
+    if ((inst = ddsrt_hh_lookup (rhc->instances, &template)) != NULL && inst->isnew)
+    {
+      struct trigger_info_pre pre;
+      struct trigger_info_post post;
+      struct trigger_info_qcond trig_qc;
+      get_trigger_info_pre (&pre, inst);
+      init_trigger_info_qcond (&trig_qc);
+      inst->isnew = 0;
+      rhc->n_new--;
+      get_trigger_info_cmn (&post.c, inst);
+      update_conditions_locked (rhc, false, &pre, &post, &trig_qc, inst);
+    }
+  }
+}
+
+struct fifo_rank {
+  uint64_t iid;
+  uint32_t count;
+  uint32_t ref;
+};
+
+#define FIFO_INLINE_RANKS 64
+
+static void fifo_patch_generations (dds_sample_info_t *si, int32_t n)
+{
+  /* Same as patch_generations, but the samples of an instance are interleaved
+     with those of other instances; a scan from the end with a small hash table
+     indexed on instance handle gives the number of samples of the same instance
+     following it and the generation reference of the last one. */
+  struct fifo_rank ranksbuf[FIFO_INLINE_RANKS], *ranks;
+  uint32_t size = FIFO_INLINE_RANKS;
+  if (n <= 1)
+    return;
+  while (size < 2 * (uint32_t) n)
+    size *= 2;
+  ranks = (size == FIFO_INLINE_RANKS) ? ranksbuf : ddsrt_malloc (size * sizeof (*ranks));
+  memset (ranks, 0, size * sizeof (*ranks));
+  for (int32_t i = n - 1; i >= 0; i--)
+  {
+    const uint32_t gen = si[i].disposed_generation_count + si[i].no_writers_generation_count;
+    uint32_t h = (uint32_t) si[i].instance_handle & (size - 1);
+    while (ranks[h].iid != 0 && ranks[h].iid != si[i].instance_handle)
+      h = (h + 1) & (size - 1);
+    if (ranks[h].iid == 0)
+    {
+      assert (si[i].sample_rank == 0 && si[i].generation_rank == 0);
+      ranks[h].iid = si[i].instance_handle;
+      ranks[h].ref = gen;
+    }
+    else
+    {
+      si[i].sample_rank = ++ranks[h].count;
+      si[i].generation_rank = ranks[h].ref - gen;
+    }
+  }
+  if (ranks != ranksbuf)
+    ddsrt_free (ranks);
+}
+
 static int32_t read_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock, void * __restrict * __restrict values, dds_sample_info_t * __restrict info_seq, int32_t max_samples, uint32_t qminv, dds_instance_handle_t handle, dds_readcond * __restrict cond, read_take_to_sample_t to_sample, read_take_to_invsample_t to_invsample)
 {
+  struct ddsi_serdata *sdsbuf[READ_TAKE_INLINE_SDS];
+  struct ddsi_serdata **sds;
   int32_t n = 0;
   assert (max_samples > 0);
+  sds = read_take_sds_alloc (sdsbuf, (void **) values, max_samples, to_sample);
   if (lock)
   {
     ddsrt_mutex_lock (&rhc->lock);
@@ -2207,22 +2751,32 @@ static int32_t read_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock,
     rhc->n_not_alive_no_writers, rhc->n_new, rhc->n_vsamples, rhc->n_invsamples,
     rhc->n_vread, rhc->n_invread);
 
-  const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_filter) ? cond->m_query.m_qcmask : 0;
-  if (handle)
+  const dds_readcond *qcond = (cond && cond->m_query.m_filter) ? cond : NULL;
+  const uint64_t key_iid = (cond && cond->m_query.m_keyinst) ? cond->m_query.m_keyinst->m_iid : 0;
+  if (handle || key_iid)
   {
+    /* a key condition restricts the operation to a single instance, just
+       like a handle does, but it is not an error if that instance is absent */
     struct rhc_instance template, *inst;
-    template.iid = handle;
-    if ((inst = ddsrt_hh_lookup (rhc->instances, &template)) != NULL)
-      n = read_w_qminv_inst (rhc, inst, values, info_seq, max_samples, qminv, qcmask, to_sample, to_invsample);
+    template.iid = handle ? handle : key_iid;
+    if ((inst = ddsrt_hh_lookup (rhc->instances, &template)) == NULL)
+      n = handle ? DDS_RETCODE_PRECONDITION_NOT_MET : 0;
+    else if (key_iid && inst->iid != key_iid)
+      n = 0;
     else
-      n = DDS_RETCODE_PRECONDITION_NOT_MET;
+      n = read_w_qminv_inst (rhc, inst, sds, info_seq, max_samples, qminv, qcond);
+  }
+  else if (rhc->reception_order)
+  {
+    n = read_take_w_qminv_fifo (rhc, false, sds, info_seq, max_samples, qminv, qcond);
+    fifo_finish_view_state (rhc, info_seq, n);
   }
   else if (!ddsrt_circlist_isempty (&rhc->nonempty_instances))
   {
     struct rhc_instance * inst = oldest_nonempty_instance (rhc);
     struct rhc_instance * const end = inst;
     do {
-      n += read_w_qminv_inst(rhc, inst, values + n, info_seq + n, max_samples - n, qminv, qcmask, to_sample, to_invsample);
+      n += read_w_qminv_inst (rhc, inst, sds + n, info_seq + n, max_samples - n, qminv, qcond);
       inst = next_nonempty_instance (inst);
     } while (inst != end && n < max_samples);
   }
@@ -2234,13 +2788,19 @@ static int32_t read_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock,
   // the RHC using dds_rhc_default_lock_samples to find out the number of samples present,
   // then allocate stuff and call read/take with lock=true. All that needs fixing.
   ddsrt_mutex_unlock (&rhc->lock);
+  if (handle == 0 && key_iid == 0 && rhc->reception_order)
+    fifo_patch_generations (info_seq, n);
+  read_take_sds_convert (rhc, sds, sdsbuf, (void **) values, info_seq, n, to_sample, to_invsample);
   return n;
 }
 
 static int32_t take_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock, void * __restrict * __restrict values, dds_sample_info_t * __restrict info_seq, int32_t max_samples, uint32_t qminv, dds_instance_handle_t handle, dds_readcond * __restrict cond, read_take_to_sample_t to_sample, read_take_to_invsample_t to_invsample)
 {
+  struct ddsi_serdata *sdsbuf[READ_TAKE_INLINE_SDS];
+  struct ddsi_serdata **sds;
   int32_t n = 0;
   assert (max_samples > 0);
+  sds = read_take_sds_alloc (sdsbuf, (void **) values, max_samples, to_sample);
   if (lock)
   {
     ddsrt_mutex_lock (&rhc->lock);
@@ -2252,15 +2812,25 @@ static int32_t take_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock,
     rhc->n_not_alive_no_writers, rhc->n_new, rhc->n_vsamples,
     rhc->n_invsamples, rhc->n_vread, rhc->n_invread);
 
-  const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_filter) ? cond->m_query.m_qcmask : 0;
-  if (handle)
+  const dds_readcond *qcond = (cond && cond->m_query.m_filter) ? cond : NULL;
+  const uint64_t key_iid = (cond && cond->m_query.m_keyinst) ? cond->m_query.m_keyinst->m_iid : 0;
+  if (handle || key_iid)
   {
+    /* a key condition restricts the operation to a single instance, just
+       like a handle does, but it is not an error if that instance is absent */
     struct rhc_instance template, *inst;
-    template.iid = handle;
-    if ((inst = ddsrt_hh_lookup (rhc->instances, &template)) != NULL)
-      n = take_w_qminv_inst (rhc, &inst, values, info_seq, max_samples, qminv, qcmask, to_sample, to_invsample);
+    template.iid = handle ? handle : key_iid;
+    if ((inst = ddsrt_hh_lookup (rhc->instances, &template)) == NULL)
+      n = handle ? DDS_RETCODE_PRECONDITION_NOT_MET : 0;
+    else if (key_iid && inst->iid != key_iid)
+      n = 0;
     else
-      n = DDS_RETCODE_PRECONDITION_NOT_MET;
+      n = take_w_qminv_inst (rhc, &inst, sds, info_seq, max_samples, qminv, qcond);
+  }
+  else if (rhc->reception_order)
+  {
+    n = read_take_w_qminv_fifo (rhc, true, sds, info_seq, max_samples, qminv, qcond);
+    fifo_finish_view_state (rhc, info_seq, n);
   }
   else if (!ddsrt_circlist_isempty (&rhc->nonempty_instances))
   {
@@ -2269,7 +2839,7 @@ static int32_t take_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock,
     while (n_insts-- > 0 && n < max_samples)
     {
       struct rhc_instance * const inst1 = next_nonempty_instance (inst);
-      n += take_w_qminv_inst (rhc, &inst, values + n, info_seq + n, max_samples - n, qminv, qcmask, to_sample, to_invsample);
+      n += take_w_qminv_inst (rhc, &inst, sds + n, info_seq + n, max_samples - n, qminv, qcond);
       inst = inst1;
     }
   }
@@ -2281,6 +2851,9 @@ static int32_t take_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock,
   // the RHC using dds_rhc_default_lock_samples to find out the number of samples present,
   // then allocate stuff and call read/take with lock=true. All that needs fixing.
   ddsrt_mutex_unlock (&rhc->lock);
+  if (handle == 0 && key_iid == 0 && rhc->reception_order)
+    fifo_patch_generations (info_seq, n);
+  read_take_sds_convert (rhc, sds, sdsbuf, (void **) values, info_seq, n, to_sample, to_invsample);
   return n;
 }
 
@@ -2300,14 +2873,14 @@ static int32_t dds_rhc_readcdr_w_qminv (struct dds_rhc_default *rhc, bool lock,
 {
   DDSRT_STATIC_ASSERT (sizeof (void *) == sizeof (struct ddsi_serdata *));
   assert (max_samples <= INT32_MAX);
-  return read_w_qminv (rhc, lock, (void **) values, info_seq, (int32_t) max_samples, qminv, handle, cond, read_take_to_sample_ref, read_take_to_invsample_ref);
+  return read_w_qminv (rhc, lock, (void **) values, info_seq, (int32_t) max_samples, qminv, handle, cond, NULL, NULL);
 }
 
 static int32_t dds_rhc_takecdr_w_qminv (struct dds_rhc_default *rhc, bool lock, struct ddsi_serdata **values, dds_sample_info_t *info_seq, uint32_t max_samples, uint32_t qminv, dds_instance_handle_t handle, dds_readcond *cond)
 {
   DDSRT_STATIC_ASSERT (sizeof (void *) == sizeof (struct ddsi_serdata *));
   assert (max_samples <= INT32_MAX);
-  return take_w_qminv (rhc, lock, (void **) values, info_seq, (int32_t) max_samples, qminv, handle, cond, read_take_to_sample_ref, read_take_to_invsample_ref);
+  return take_w_qminv (rhc, lock, (void **) values, info_seq, (int32_t) max_samples, qminv, handle, cond, NULL, NULL);
 }
 
 /*************************
@@ -2353,6 +2926,126 @@ static bool cond_is_sample_state_dependent (const struct dds_readcond *cond)
   }
 }
 
+static uint32_t qcond_count_matches (const struct dds_rhc_default *rhc, const struct rhc_instance *inst, const dds_readcond *cond)
+{
+  /* Number of samples in inst that match cond, ignoring the instance and view states */
+  uint32_t m = 0;
+  if (inst->inv_exists)
+    m += (qmask_of_invsample (inst) & cond->m_qminv) == 0 && qcond_matches (rhc, cond, &inst->conds);
+  if (inst->latest)
+  {
+    struct rhc_sample *sample = inst->latest->next, * const end = sample;
+    do {
+      m += (qmask_of_sample (sample) & cond->m_qminv) == 0 && qcond_matches (rhc, cond, &sample->conds);
+      sample = sample->next;
+    } while (sample != end);
+  }
+  return m;
+}
+
+static void qconds_grow (struct dds_rhc_default *rhc)
+{
+  /* All sets must be resized while rhc->qcond_nwords still gives their current size */
+  const uint32_t nwords = 2 * rhc->qcond_nwords;
+  struct ddsrt_hh_iter it;
+  for (struct rhc_instance *inst = ddsrt_hh_iter_first (rhc->instances, &it); inst != NULL; inst = ddsrt_hh_iter_next (&it))
+  {
+    qcset_resize (rhc, &inst->conds, nwords);
+    if (inst->latest)
+    {
+      struct rhc_sample *sample = inst->latest->next, * const end = sample;
+      do {
+        qcset_resize (rhc, &sample->conds, nwords);
+        sample = sample->next;
+      } while (sample != end);
+    }
+  }
+  qcset_resize (rhc, &rhc->qconds_inuse, nwords);
+  qcset_resize (rhc, &rhc->qconds_samplest, nwords);
+  qcset_resize (rhc, &rhc->qcond_scratch, nwords);
+  rhc->qcond_nwords = nwords;
+}
+
+static uint32_t add_filtercondition (struct dds_rhc_default *rhc, dds_readcond *cond)
+{
+  /* Allocate a slot in the condition sets, growing them if all are in use */
+  uint32_t idx;
+  if ((idx = qcset_first_clear (rhc, &rhc->qconds_inuse)) == 64 * rhc->qcond_nwords)
+    qconds_grow (rhc);
+  qcset_assign (rhc, &rhc->qconds_inuse, idx, true);
+  cond->m_query.m_index = idx;
+
+  rhc->nconds++;
+  cond->m_next = rhc->conds;
+  rhc->conds = cond;
+  if (cond_is_sample_state_dependent (cond))
+  {
+    qcset_assign (rhc, &rhc->qconds_samplest, idx, true);
+    rhc->nqconds_samplest++;
+  }
+  if (rhc->nqconds++ == 0)
+  {
+    assert (rhc->qcond_eval_samplebuf == NULL);
+    rhc->qcond_eval_samplebuf = ddsi_sertype_alloc_sample (rhc->type);
+  }
+
+  /* Attaching a query condition means clearing the allocated bit in all instances and
+     samples, except for those that match the predicate. */
+  struct ddsrt_hh_iter it;
+  uint32_t trigger = 0;
+  for (struct rhc_instance *inst = ddsrt_hh_iter_first (rhc->instances, &it); inst != NULL; inst = ddsrt_hh_iter_next (&it))
+  {
+    qcset_assign (rhc, &inst->conds, idx, eval_predicate_invsample (rhc, inst, cond->m_query.m_filter));
+    if (inst->latest)
+    {
+      struct rhc_sample *sample = inst->latest->next, * const end = sample;
+      do {
+        qcset_assign (rhc, &sample->conds, idx, eval_predicate_sample (rhc, sample->sample, cond->m_query.m_filter));
+        sample = sample->next;
+      } while (sample != end);
+    }
+    if (!inst_is_empty (inst) && rhc_get_cond_trigger (inst, cond))
+      trigger += qcond_count_matches (rhc, inst, cond);
+  }
+  return trigger;
+}
+
+static uint32_t add_keycondition (struct dds_rhc_default *rhc, dds_readcond *cond)
+{
+  /* Key conditions are kept out of rhc->conds, instead they are indexed on the instance
+     handle so that updating the conditions for a change to an instance only needs to
+     look at the key conditions for that instance */
+  struct rhc_keyconds template, *kc;
+  template.iid = cond->m_query.m_keyinst->m_iid;
+  if ((kc = ddsrt_hh_lookup (rhc->keyconds, &template)) == NULL)
+  {
+    kc = ddsrt_malloc (sizeof (*kc));
+    kc->iid = template.iid;
+    kc->conds = NULL;
+    kc->nsamplest = 0;
+    int ret = ddsrt_hh_add (rhc->keyconds, kc);
+    assert (ret);
+    (void) ret;
+  }
+  cond->m_next = kc->conds;
+  kc->conds = cond;
+  if (cond_is_sample_state_dependent (cond))
+  {
+    kc->nsamplest++;
+    rhc->nqconds_samplest++;
+  }
+  rhc->nkeyconds++;
+
+  struct rhc_instance itemplate, *inst;
+  itemplate.iid = kc->iid;
+  if ((inst = ddsrt_hh_lookup (rhc->instances, &itemplate)) == NULL)
+    return 0;
+  inst->keyconds = kc;
+  if (!inst_is_empty (inst) && rhc_get_cond_trigger (inst, cond))
+    return qcond_count_matches (rhc, inst, cond);
+  return 0;
+}
+
 static bool dds_rhc_default_add_readcondition (struct dds_rhc *rhc_common, dds_readcond *cond)
 {
   /* On the assumption that a readcondition will be attached to a
@@ -2360,44 +3053,26 @@ static bool dds_rhc_default_add_readcondition (struct dds_rhc *rhc_common, dds_r
      readconditions on a reader in one set, without distinguishing
      between those attached to a waitset or not. */
   struct dds_rhc_default * const rhc = (struct dds_rhc_default *) rhc_common;
-  struct ddsrt_hh_iter it;
 
-  assert ((dds_entity_kind (&cond->m_entity) == DDS_KIND_COND_READ && cond->m_query.m_filter == 0) ||
-          (dds_entity_kind (&cond->m_entity) == DDS_KIND_COND_QUERY && cond->m_query.m_filter != 0));
+  assert ((dds_entity_kind (&cond->m_entity) == DDS_KIND_COND_READ && cond->m_query.m_filter == 0 && cond->m_query.m_keyinst == NULL) ||
+          (dds_entity_kind (&cond->m_entity) == DDS_KIND_COND_QUERY && (cond->m_query.m_filter != 0) != (cond->m_query.m_keyinst != NULL)));
   assert (ddsrt_atomic_ld32 (&cond->m_entity.m_status.m_trigger) == 0);
-  assert (cond->m_query.m_qcmask == 0);
 
   cond->m_qminv = qmask_from_dcpsquery (cond->m_sample_states, cond->m_view_states, cond->m_instance_states);
 
   ddsrt_mutex_lock (&rhc->lock);
 
-  /* Allocate a slot in the condition bitmasks; return an error no more slots are available */
+  uint32_t trigger = 0;
   if (cond->m_query.m_filter != 0)
+    trigger = add_filtercondition (rhc, cond);
+  else if (cond->m_query.m_keyinst != NULL)
+    trigger = add_keycondition (rhc, cond);
+  else
   {
-    dds_querycond_mask_t avail_qcmask = ~(dds_querycond_mask_t)0;
-    for (dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
-    {
-      assert ((rc->m_query.m_filter == 0 && rc->m_query.m_qcmask == 0) || (rc->m_query.m_filter != 0 && rc->m_query.m_qcmask != 0));
-      avail_qcmask &= ~rc->m_query.m_qcmask;
-    }
-    if (avail_qcmask == 0)
-    {
-      /* no available indices */
-      ddsrt_mutex_unlock (&rhc->lock);
-      return false;
-    }
-
-    /* use the least significant bit set */
-    cond->m_query.m_qcmask = avail_qcmask & (~avail_qcmask + 1);
-  }
-
-  rhc->nconds++;
-  cond->m_next = rhc->conds;
-  rhc->conds = cond;
+    rhc->nconds++;
+    cond->m_next = rhc->conds;
+    rhc->conds = cond;
 
-  uint32_t trigger = 0;
-  if (cond->m_query.m_filter == 0)
-  {
     /* Read condition is not cached inside the instances and samples, so it only needs
        to be evaluated on the non-empty instances */
     if (!ddsrt_circlist_isempty (&rhc->nonempty_instances))
@@ -2410,40 +3085,6 @@ static bool dds_rhc_default_add_readcondition (struct dds_rhc *rhc_common, dds_r
       } while (inst != end);
     }
   }
-  else
-  {
-    if (cond_is_sample_state_dependent (cond))
-      rhc->qconds_samplest |= cond->m_query.m_qcmask;
-    if (rhc->nqconds++ == 0)
-    {
-      assert (rhc->qcond_eval_samplebuf == NULL);
-      rhc->qcond_eval_samplebuf = ddsi_sertype_alloc_sample (rhc->type);
-    }
-
-    /* Attaching a query condition means clearing the allocated bit in all instances and
-       samples, except for those that match the predicate. */
-    const dds_querycond_mask_t qcmask = cond->m_query.m_qcmask;
-    for (struct rhc_instance *inst = ddsrt_hh_iter_first (rhc->instances, &it); inst != NULL; inst = ddsrt_hh_iter_next (&it))
-    {
-      const bool instmatch = eval_predicate_invsample (rhc, inst, cond->m_query.m_filter);;
-      uint32_t matches = 0;
-
-      inst->conds = (inst->conds & ~qcmask) | (instmatch ? qcmask : 0);
-      if (inst->latest)
-      {
-        struct rhc_sample *sample = inst->latest->next, * const end = sample;
-        do {
-          const bool m = eval_predicate_sample (rhc, sample->sample, cond->m_query.m_filter);
-          sample->conds = (sample->conds & ~qcmask) | (m ? qcmask : 0);
-          matches += m;
-          sample = sample->next;
-        } while (sample != end);
-      }
-
-      if (!inst_is_empty (inst) && rhc_get_cond_trigger (inst, cond))
-        trigger += (inst->inv_exists ? instmatch : 0) + matches;
-    }
-  }
 
   if (trigger)
   {
@@ -2451,29 +3092,72 @@ static bool dds_rhc_default_add_readcondition (struct dds_rhc *rhc_common, dds_r
     dds_entity_status_signal (&cond->m_entity, DDS_DATA_AVAILABLE_STATUS);
   }
 
-  TRACE ("add_readcondition(%p, %"PRIx32", %"PRIx32", %"PRIx32") => %p qminv %"PRIx32" ; rhc %"PRIu32" conds\n",
+  TRACE ("add_readcondition(%p, %"PRIx32", %"PRIx32", %"PRIx32") => %p qminv %"PRIx32" ; rhc %"PRIu32" conds %"PRIu32" keyconds\n",
     (void *) rhc, cond->m_sample_states, cond->m_view_states,
-    cond->m_instance_states, (void *) cond, cond->m_qminv, rhc->nconds);
+    cond->m_instance_states, (void *) cond, cond->m_qminv, rhc->nconds, rhc->nkeyconds);
 
   ddsrt_mutex_unlock (&rhc->lock);
   return true;
 }
 
-static void dds_rhc_default_remove_readcondition (struct dds_rhc *rhc_common, dds_readcond *cond)
+static void remove_keycondition (struct dds_rhc_default *rhc, dds_readcond *cond)
 {
-  struct dds_rhc_default * const rhc = (struct dds_rhc_default *) rhc_common;
+  struct rhc_keyconds template, *kc;
   dds_readcond **ptr;
-  ddsrt_mutex_lock (&rhc->lock);
-  ptr = &rhc->conds;
+  template.iid = cond->m_query.m_keyinst->m_iid;
+  kc = ddsrt_hh_lookup (rhc->keyconds, &template);
+  assert (kc != NULL);
+  ptr = &kc->conds;
   while (*ptr != cond)
     ptr = &(*ptr)->m_next;
   *ptr = (*ptr)->m_next;
-  rhc->nconds--;
+  if (cond_is_sample_state_dependent (cond))
+  {
+    kc->nsamplest--;
+    rhc->nqconds_samplest--;
+  }
+  rhc->nkeyconds--;
+  if (kc->conds == NULL)
+  {
+    struct rhc_instance itemplate, *inst;
+    itemplate.iid = kc->iid;
+    if ((inst = ddsrt_hh_lookup (rhc->instances, &itemplate)) != NULL)
+    {
+      assert (inst->keyconds == kc);
+      inst->keyconds = NULL;
+    }
+    int ret = ddsrt_hh_remove (rhc->keyconds, kc);
+    assert (ret);
+    (void) ret;
+    ddsrt_free (kc);
+  }
+}
+
+static void dds_rhc_default_remove_readcondition (struct dds_rhc *rhc_common, dds_readcond *cond)
+{
+  struct dds_rhc_default * const rhc = (struct dds_rhc_default *) rhc_common;
+  dds_readcond **ptr;
+  ddsrt_mutex_lock (&rhc->lock);
+  if (cond->m_query.m_keyinst != NULL)
+    remove_keycondition (rhc, cond);
+  else
+  {
+    ptr = &rhc->conds;
+    while (*ptr != cond)
+      ptr = &(*ptr)->m_next;
+    *ptr = (*ptr)->m_next;
+    rhc->nconds--;
+  }
   if (cond->m_query.m_filter)
   {
+    const uint32_t idx = cond->m_query.m_index;
     rhc->nqconds--;
-    rhc->qconds_samplest &= ~cond->m_query.m_qcmask;
-    cond->m_query.m_qcmask = 0;
+    if (qcset_test (rhc, &rhc->qconds_samplest, idx))
+    {
+      qcset_assign (rhc, &rhc->qconds_samplest, idx, false);
+      rhc->nqconds_samplest--;
+    }
+    qcset_assign (rhc, &rhc->qconds_inuse, idx, false);
     if (rhc->nqconds == 0)
     {
       assert (rhc->qcond_eval_samplebuf != NULL);
@@ -2484,209 +3168,204 @@ static void dds_rhc_default_remove_readcondition (struct dds_rhc *rhc_common, dd
   ddsrt_mutex_unlock (&rhc->lock);
 }
 
-static bool update_conditions_locked (struct dds_rhc_default *rhc, bool called_from_insert, const struct trigger_info_pre *pre, const struct trigger_info_post *post, const struct trigger_info_qcond *trig_qc, const struct rhc_instance *inst)
+static bool update_condition_locked (struct dds_rhc_default *rhc, bool called_from_insert, const struct trigger_info_pre *pre, const struct trigger_info_post *post, const struct trigger_info_qcond *trig_qc, const struct rhc_instance *inst, dds_readcond *iter)
 {
-  /* Pre: rhc->lock held; returns 1 if triggering required, else 0. */
   bool trigger = false;
-  dds_readcond *iter;
-  bool m_pre, m_post;
-
-  TRACE ("update_conditions_locked(%p %p) - inst %"PRIu32" nonempty %"PRIu32" disp %"PRIu32" nowr %"PRIu32" new %"PRIu32" samples %"PRIu32" read %"PRIu32"\n",
-         (void *) rhc, (void *) inst, rhc->n_instances, rhc->n_nonempty_instances, rhc->n_not_alive_disposed,
-         rhc->n_not_alive_no_writers, rhc->n_new, rhc->n_vsamples, rhc->n_vread);
-  TRACE ("  pre (%"PRIx32",%d,%d) post (%"PRIx32",%d,%d) read -[%d,%d]+[%d,%d] qcmask -[%"PRIx32",%"PRIx32"]+[%"PRIx32",%"PRIx32"]\n",
-         pre->c.qminst, pre->c.has_read, pre->c.has_not_read,
-         post->c.qminst, post->c.has_read, post->c.has_not_read,
-         trig_qc->dec_invsample_read, trig_qc->dec_sample_read, trig_qc->inc_invsample_read, trig_qc->inc_sample_read,
-         trig_qc->dec_conds_invsample, trig_qc->dec_conds_sample, trig_qc->inc_conds_invsample, trig_qc->inc_conds_sample);
+  bool m_pre = ((pre->c.qminst & iter->m_qminv) == 0);
+  bool m_post = ((post->c.qminst & iter->m_qminv) == 0);
 
-  assert (rhc->n_nonempty_instances >= rhc->n_not_alive_disposed + rhc->n_not_alive_no_writers);
-#ifndef DDS_HAS_LIFESPAN
-  /* If lifespan is disabled, samples cannot expire and therefore
-     empty instances cannot be in the 'new' state. */
-  assert (rhc->n_nonempty_instances >= rhc->n_new);
-#endif
-  assert (rhc->n_vsamples >= rhc->n_vread);
+  /* Fast path out: instance did not and will not match based on instance, view states, so no
+     need to evaluate anything else */
+  if (!m_pre && !m_post)
+    return false;
 
-  iter = rhc->conds;
-  while (iter)
+  /* FIXME: use bitmask? */
+  switch (iter->m_sample_states)
   {
-    m_pre = ((pre->c.qminst & iter->m_qminv) == 0);
-    m_post = ((post->c.qminst & iter->m_qminv) == 0);
+    case DDS_SST_READ:
+      m_pre = m_pre && pre->c.has_read;
+      m_post = m_post && post->c.has_read;
+      break;
+    case DDS_SST_NOT_READ:
+      m_pre = m_pre && pre->c.has_not_read;
+      m_post = m_post && post->c.has_not_read;
+      break;
+    case DDS_SST_READ | DDS_SST_NOT_READ:
+    case 0:
+      m_pre = m_pre && (pre->c.has_read + pre->c.has_not_read);
+      m_post = m_post && (post->c.has_read + post->c.has_not_read);
+      break;
+    default:
+      DDS_FATAL ("update_readconditions: sample_states invalid: %"PRIx32"\n", iter->m_sample_states);
+  }
 
-    /* Fast path out: instance did not and will not match based on instance, view states, so no
-       need to evaluate anything else */
-    if (!m_pre && !m_post)
+  TRACE ("  cond %p %"PRIu32": ", (void *) iter, iter->m_query.m_index);
+  if (iter->m_query.m_filter == 0 && iter->m_query.m_keyinst == NULL)
+  {
+    assert (dds_entity_kind (&iter->m_entity) == DDS_KIND_COND_READ);
+    if (m_pre == m_post)
+      TRACE ("no change");
+    else if (m_pre < m_post)
     {
-      iter = iter->m_next;
-      continue;
+      TRACE ("now matches");
+      trigger = (ddsrt_atomic_inc32_ov (&iter->m_entity.m_status.m_trigger) == 0);
+      if (trigger)
+        TRACE (" (cond now triggers)");
+    }
+    else
+    {
+      TRACE ("no longer matches");
+      if (ddsrt_atomic_dec32_nv (&iter->m_entity.m_status.m_trigger) == 0)
+        TRACE (" (cond no longer triggers)");
     }
+  }
+  else if (m_pre || m_post) /* no need to look any further if both are false */
+  {
+    assert (dds_entity_kind (&iter->m_entity) == DDS_KIND_COND_QUERY);
+#define QCM(x) (trig_qc->x != NULL && qcond_matches (rhc, iter, trig_qc->x))
+    int32_t mdelta = 0;
 
-    /* FIXME: use bitmask? */
     switch (iter->m_sample_states)
     {
       case DDS_SST_READ:
-        m_pre = m_pre && pre->c.has_read;
-        m_post = m_post && post->c.has_read;
+        if (trig_qc->dec_invsample_read)
+          mdelta -= QCM (dec_conds_invsample);
+        if (trig_qc->dec_sample_read)
+          mdelta -= QCM (dec_conds_sample);
+        if (trig_qc->inc_invsample_read)
+          mdelta += QCM (inc_conds_invsample);
+        if (trig_qc->inc_sample_read)
+          mdelta += QCM (inc_conds_sample);
         break;
       case DDS_SST_NOT_READ:
-        m_pre = m_pre && pre->c.has_not_read;
-        m_post = m_post && post->c.has_not_read;
+        if (!trig_qc->dec_invsample_read)
+          mdelta -= QCM (dec_conds_invsample);
+        if (!trig_qc->dec_sample_read)
+          mdelta -= QCM (dec_conds_sample);
+        if (!trig_qc->inc_invsample_read)
+          mdelta += QCM (inc_conds_invsample);
+        if (!trig_qc->inc_sample_read)
+          mdelta += QCM (inc_conds_sample);
         break;
       case DDS_SST_READ | DDS_SST_NOT_READ:
       case 0:
-        m_pre = m_pre && (pre->c.has_read + pre->c.has_not_read);
-        m_post = m_post && (post->c.has_read + post->c.has_not_read);
+        mdelta -= QCM (dec_conds_invsample);
+        mdelta -= QCM (dec_conds_sample);
+        mdelta += QCM (inc_conds_invsample);
+        mdelta += QCM (inc_conds_sample);
         break;
       default:
         DDS_FATAL ("update_readconditions: sample_states invalid: %"PRIx32"\n", iter->m_sample_states);
     }
+#undef QCM
 
-    TRACE ("  cond %p %08"PRIx32": ", (void *) iter, iter->m_query.m_qcmask);
-    if (iter->m_query.m_filter == 0)
+    if (m_pre == m_post)
     {
-      assert (dds_entity_kind (&iter->m_entity) == DDS_KIND_COND_READ);
-      if (m_pre == m_post)
-        TRACE ("no change");
+      assert (m_pre);
+      /* there was a match at read-condition level
+         - therefore the matching samples in the instance are accounted for in the trigger count
+         - therefore an incremental update is required
+         there is always space for a valid and an invalid sample, both add and remove
+         inserting an update always has unread data added, but a read pretends it is a removal
+         of whatever and an insertion of read data */
+      assert (mdelta >= 0 || ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) >= (uint32_t) -mdelta);
+      if (mdelta == 0)
+        TRACE ("no change @ %"PRIu32" (0)", ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger));
+      else
+        TRACE ("m=%"PRId32" @ %"PRIu32" (0)", mdelta, ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) + (uint32_t) mdelta);
+      /* even though it matches now and matched before, it is not a given that any of the samples
+         matched before, so m_trigger may still be 0 */
+      const uint32_t ov = ddsrt_atomic_add32_ov (&iter->m_entity.m_status.m_trigger, (uint32_t) mdelta);
+      if (mdelta > 0 && ov == 0)
+        trigger = true;
+      if (trigger)
+        TRACE (" (cond now triggers)");
+      else if (mdelta < 0 && ov == (uint32_t) -mdelta)
+        TRACE (" (cond no longer triggers)");
+    }
+    else
+    {
+      /* There either was no match at read-condition level, now there is: scan all samples for matches;
+         or there was a match and now there is not: so also scan all samples for matches.  The only
+         difference is in whether the number of matches should be added or subtracted. */
+      const int32_t mcurrent = inst ? (int32_t) qcond_count_matches (rhc, inst, iter) : 0;
+      if (mdelta == 0 && mcurrent == 0)
+        TRACE ("no change @ %"PRIu32" (2)", ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger));
       else if (m_pre < m_post)
       {
-        TRACE ("now matches");
-        trigger = (ddsrt_atomic_inc32_ov (&iter->m_entity.m_status.m_trigger) == 0);
+        /* No match previously, so the instance wasn't accounted for at all in the trigger value.
+           Therefore when inserting data, all that matters is how many currently match.
+
+           When reading or taking it is evaluated incrementally _before_ changing the state of the
+           sample, so mrem reflects the state before the change, and the incremental change needs
+           to be taken into account. */
+        const int32_t m = called_from_insert ? mcurrent : mcurrent + mdelta;
+        TRACE ("mdelta=%"PRId32" mcurrent=%"PRId32" => %"PRId32" => %"PRIu32" (2a)", mdelta, mcurrent, m, ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) + (uint32_t) m);
+        assert (m >= 0 || ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) >= (uint32_t) -m);
+        trigger = (ddsrt_atomic_add32_ov (&iter->m_entity.m_status.m_trigger, (uint32_t) m) == 0 && m > 0);
         if (trigger)
           TRACE (" (cond now triggers)");
       }
       else
       {
-        TRACE ("no longer matches");
-        if (ddsrt_atomic_dec32_nv (&iter->m_entity.m_status.m_trigger) == 0)
+        /* Previously matched, but no longer, which means we need to subtract the current number
+           of matches as well as those that were removed just before, hence need the incremental
+           change as well */
+        const int32_t m = mcurrent - mdelta;
+        TRACE ("mdelta=%"PRId32" mcurrent=%"PRId32" => %"PRId32" => %"PRIu32" (2b)", mdelta, mcurrent, m, ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) - (uint32_t) m);
+        assert (m < 0 || ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) >= (uint32_t) m);
+        if (ddsrt_atomic_sub32_nv (&iter->m_entity.m_status.m_trigger, (uint32_t) m) == 0)
           TRACE (" (cond no longer triggers)");
       }
     }
-    else if (m_pre || m_post) /* no need to look any further if both are false */
-    {
-      assert (dds_entity_kind (&iter->m_entity) == DDS_KIND_COND_QUERY);
-      assert (iter->m_query.m_qcmask != 0);
-      const dds_querycond_mask_t qcmask = iter->m_query.m_qcmask;
-      int32_t mdelta = 0;
+  }
 
-      switch (iter->m_sample_states)
-      {
-        case DDS_SST_READ:
-          if (trig_qc->dec_invsample_read)
-            mdelta -= (trig_qc->dec_conds_invsample & qcmask) != 0;
-          if (trig_qc->dec_sample_read)
-            mdelta -= (trig_qc->dec_conds_sample & qcmask) != 0;
-          if (trig_qc->inc_invsample_read)
-            mdelta += (trig_qc->inc_conds_invsample & qcmask) != 0;
-          if (trig_qc->inc_sample_read)
-            mdelta += (trig_qc->inc_conds_sample & qcmask) != 0;
-          break;
-        case DDS_SST_NOT_READ:
-          if (!trig_qc->dec_invsample_read)
-            mdelta -= (trig_qc->dec_conds_invsample & qcmask) != 0;
-          if (!trig_qc->dec_sample_read)
-            mdelta -= (trig_qc->dec_conds_sample & qcmask) != 0;
-          if (!trig_qc->inc_invsample_read)
-            mdelta += (trig_qc->inc_conds_invsample & qcmask) != 0;
-          if (!trig_qc->inc_sample_read)
-            mdelta += (trig_qc->inc_conds_sample & qcmask) != 0;
-          break;
-        case DDS_SST_READ | DDS_SST_NOT_READ:
-        case 0:
-          mdelta -= (trig_qc->dec_conds_invsample & qcmask) != 0;
-          mdelta -= (trig_qc->dec_conds_sample & qcmask) != 0;
-          mdelta += (trig_qc->inc_conds_invsample & qcmask) != 0;
-          mdelta += (trig_qc->inc_conds_sample & qcmask) != 0;
-          break;
-        default:
-          DDS_FATAL ("update_readconditions: sample_states invalid: %"PRIx32"\n", iter->m_sample_states);
-      }
+  if (trigger)
+  {
+    dds_entity_status_signal (&iter->m_entity, DDS_DATA_AVAILABLE_STATUS);
+  }
+  TRACE ("\n");
+  return trigger;
+}
 
-      if (m_pre == m_post)
-      {
-        assert (m_pre);
-        /* there was a match at read-condition level
-           - therefore the matching samples in the instance are accounted for in the trigger count
-           - therefore an incremental update is required
-           there is always space for a valid and an invalid sample, both add and remove
-           inserting an update always has unread data added, but a read pretends it is a removal
-           of whatever and an insertion of read data */
-        assert (mdelta >= 0 || ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) >= (uint32_t) -mdelta);
-        if (mdelta == 0)
-          TRACE ("no change @ %"PRIu32" (0)", ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger));
-        else
-          TRACE ("m=%"PRId32" @ %"PRIu32" (0)", mdelta, ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) + (uint32_t) mdelta);
-        /* even though it matches now and matched before, it is not a given that any of the samples
-           matched before, so m_trigger may still be 0 */
-        const uint32_t ov = ddsrt_atomic_add32_ov (&iter->m_entity.m_status.m_trigger, (uint32_t) mdelta);
-        if (mdelta > 0 && ov == 0)
-          trigger = true;
-        if (trigger)
-          TRACE (" (cond now triggers)");
-        else if (mdelta < 0 && ov == (uint32_t) -mdelta)
-          TRACE (" (cond no longer triggers)");
-      }
-      else
-      {
-        /* There either was no match at read-condition level, now there is: scan all samples for matches;
-           or there was a match and now there is not: so also scan all samples for matches.  The only
-           difference is in whether the number of matches should be added or subtracted. */
-        int32_t mcurrent = 0;
-        if (inst)
-        {
-          if (inst->inv_exists)
-            mcurrent += (qmask_of_invsample (inst) & iter->m_qminv) == 0 && (inst->conds & qcmask) != 0;
-          if (inst->latest)
-          {
-            struct rhc_sample *sample = inst->latest->next, * const end = sample;
-            do {
-              mcurrent += (qmask_of_sample (sample) & iter->m_qminv) == 0 && (sample->conds & qcmask) != 0;
-              sample = sample->next;
-            } while (sample != end);
-          }
-        }
-        if (mdelta == 0 && mcurrent == 0)
-          TRACE ("no change @ %"PRIu32" (2)", ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger));
-        else if (m_pre < m_post)
-        {
-          /* No match previously, so the instance wasn't accounted for at all in the trigger value.
-             Therefore when inserting data, all that matters is how many currently match.
-
-             When reading or taking it is evaluated incrementally _before_ changing the state of the
-             sample, so mrem reflects the state before the change, and the incremental change needs
-             to be taken into account. */
-          const int32_t m = called_from_insert ? mcurrent : mcurrent + mdelta;
-          TRACE ("mdelta=%"PRId32" mcurrent=%"PRId32" => %"PRId32" => %"PRIu32" (2a)", mdelta, mcurrent, m, ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) + (uint32_t) m);
-          assert (m >= 0 || ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) >= (uint32_t) -m);
-          trigger = (ddsrt_atomic_add32_ov (&iter->m_entity.m_status.m_trigger, (uint32_t) m) == 0 && m > 0);
-          if (trigger)
-            TRACE (" (cond now triggers)");
-        }
-        else
-        {
-          /* Previously matched, but no longer, which means we need to subtract the current number
-             of matches as well as those that were removed just before, hence need the incremental
-             change as well */
-          const int32_t m = mcurrent - mdelta;
-          TRACE ("mdelta=%"PRId32" mcurrent=%"PRId32" => %"PRId32" => %"PRIu32" (2b)", mdelta, mcurrent, m, ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) - (uint32_t) m);
-          assert (m < 0 || ddsrt_atomic_ld32 (&iter->m_entity.m_status.m_trigger) >= (uint32_t) m);
-          if (ddsrt_atomic_sub32_nv (&iter->m_entity.m_status.m_trigger, (uint32_t) m) == 0)
-            TRACE (" (cond no longer triggers)");
-        }
-      }
-    }
+static bool update_conditions_locked (struct dds_rhc_default *rhc, bool called_from_insert, const struct trigger_info_pre *pre, const struct trigger_info_post *post, const struct trigger_info_qcond *trig_qc, const struct rhc_instance *inst)
+{
+  /* Pre: rhc->lock held; returns 1 if triggering required, else 0. */
+  bool trigger = false;
+
+  TRACE ("update_conditions_locked(%p %p) - inst %"PRIu32" nonempty %"PRIu32" disp %"PRIu32" nowr %"PRIu32" new %"PRIu32" samples %"PRIu32" read %"PRIu32"\n",
+         (void *) rhc, (void *) inst, rhc->n_instances, rhc->n_nonempty_instances, rhc->n_not_alive_disposed,
+         rhc->n_not_alive_no_writers, rhc->n_new, rhc->n_vsamples, rhc->n_vread);
+  TRACE ("  pre (%"PRIx32",%d,%d) post (%"PRIx32",%d,%d) read -[%d,%d]+[%d,%d] qcsets -[%d,%d]+[%d,%d]\n",
+         pre->c.qminst, pre->c.has_read, pre->c.has_not_read,
+         post->c.qminst, post->c.has_read, post->c.has_not_read,
+         trig_qc->dec_invsample_read, trig_qc->dec_sample_read, trig_qc->inc_invsample_read, trig_qc->inc_sample_read,
+         trig_qc->dec_conds_invsample != NULL, trig_qc->dec_conds_sample != NULL, trig_qc->inc_conds_invsample != NULL, trig_qc->inc_conds_sample != NULL);
+
+  assert (rhc->n_nonempty_instances >= rhc->n_not_alive_disposed + rhc->n_not_alive_no_writers);
+#ifndef DDS_HAS_LIFESPAN
+  /* If lifespan is disabled, samples cannot expire and therefore
+     empty instances cannot be in the 'new' state. */
+  assert (rhc->n_nonempty_instances >= rhc->n_new);
+#endif
+  assert (rhc->n_vsamples >= rhc->n_vread);
 
-    if (trigger)
+  for (dds_readcond *iter = rhc->conds; iter != NULL; iter = iter->m_next)
+  {
+    if (update_condition_locked (rhc, called_from_insert, pre, post, trig_qc, inst, iter))
+      trigger = true;
+  }
+  if (inst && inst->keyconds)
+  {
+    for (dds_readcond *iter = inst->keyconds->conds; iter != NULL; iter = iter->m_next)
     {
-      dds_entity_status_signal (&iter->m_entity, DDS_DATA_AVAILABLE_STATUS);
+      if (update_condition_locked (rhc, called_from_insert, pre, post, trig_qc, inst, iter))
+        trigger = true;
     }
-    TRACE ("\n");
-    iter = iter->m_next;
   }
   return trigger;
 }
 
-
 /*************************
  ******  READ/TAKE  ******
  *************************/
@@ -2736,7 +3415,7 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
   uint32_t n_vsamples = 0, n_vread = 0;
   uint32_t n_invsamples = 0, n_invread = 0;
   uint32_t cond_match_count[CHECK_MAX_CONDS];
-  dds_querycond_mask_t enabled_qcmask = 0;
+  uint32_t n_qconds = 0, n_qconds_samplest = 0, n_keyconds = 0;
   struct rhc_instance *inst;
   struct ddsrt_hh_iter iter;
   dds_readcond *rciter;
@@ -2749,10 +3428,18 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
   {
     assert ((dds_entity_kind (&rciter->m_entity) == DDS_KIND_COND_READ && rciter->m_query.m_filter == 0) ||
             (dds_entity_kind (&rciter->m_entity) == DDS_KIND_COND_QUERY && rciter->m_query.m_filter != 0));
-    assert ((rciter->m_query.m_filter != 0) == (rciter->m_query.m_qcmask != 0));
-    assert (!(enabled_qcmask & rciter->m_query.m_qcmask));
-    enabled_qcmask |= rciter->m_query.m_qcmask;
+    assert (rciter->m_query.m_keyinst == NULL);
+    if (rciter->m_query.m_filter != 0)
+    {
+      assert (qcset_test (rhc, &rhc->qconds_inuse, rciter->m_query.m_index));
+      assert (qcset_test (rhc, &rhc->qconds_samplest, rciter->m_query.m_index) == cond_is_sample_state_dependent (rciter));
+      for (dds_readcond const *rc1 = rciter->m_next; rc1; rc1 = rc1->m_next)
+        assert (rc1->m_query.m_filter == 0 || rc1->m_query.m_index != rciter->m_query.m_index);
+      n_qconds++;
+      n_qconds_samplest += cond_is_sample_state_dependent (rciter);
+    }
   }
+  assert (rhc->nqconds == n_qconds);
 
   for (inst = ddsrt_hh_iter_first (rhc->instances, &iter); inst; inst = ddsrt_hh_iter_next (&iter))
   {
@@ -2762,6 +3449,10 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
     n_instances++;
     if (inst->isnew)
       n_new++;
+    if (inst->keyconds)
+      assert (inst->keyconds->iid == inst->iid && ddsrt_hh_lookup (rhc->keyconds, inst->keyconds) == inst->keyconds);
+    else if (rhc->nkeyconds > 0)
+      assert (ddsrt_hh_lookup (rhc->keyconds, &(struct rhc_keyconds){ .iid = inst->iid }) == NULL);
     if (inst_is_empty (inst))
       continue;
 
@@ -2805,23 +3496,18 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
     {
       if (check_qcmask && rhc->nqconds > 0)
       {
-        dds_querycond_mask_t qcmask;
         untyped_to_clean_invsample (rhc->type, inst->tk->m_sample, rhc->qcond_eval_samplebuf, 0, 0);
-        qcmask = 0;
         for (rciter = rhc->conds; rciter; rciter = rciter->m_next)
-          if (rciter->m_query.m_filter != 0 && rciter->m_query.m_filter (rhc->qcond_eval_samplebuf))
-            qcmask |= rciter->m_query.m_qcmask;
-        assert ((inst->conds & enabled_qcmask) == qcmask);
+          if (rciter->m_query.m_filter != 0)
+            assert (qcset_test (rhc, &inst->conds, rciter->m_query.m_index) == rciter->m_query.m_filter (rhc->qcond_eval_samplebuf));
         if (inst->latest)
         {
           struct rhc_sample *sample = inst->latest->next, * const end = sample;
           do {
             ddsi_serdata_to_sample (sample->sample, rhc->qcond_eval_samplebuf, NULL, NULL);
-            qcmask = 0;
             for (rciter = rhc->conds; rciter; rciter = rciter->m_next)
-              if (rciter->m_query.m_filter != 0 && rciter->m_query.m_filter (rhc->qcond_eval_samplebuf))
-                qcmask |= rciter->m_query.m_qcmask;
-            assert ((sample->conds & enabled_qcmask) == qcmask);
+              if (rciter->m_query.m_filter != 0)
+                assert (qcset_test (rhc, &sample->conds, rciter->m_query.m_index) == rciter->m_query.m_filter (rhc->qcond_eval_samplebuf));
             sample = sample->next;
           } while (sample != end);
         }
@@ -2834,18 +3520,7 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
         else if (rciter->m_query.m_filter == 0)
           cond_match_count[i]++;
         else
-        {
-          if (inst->inv_exists)
-            cond_match_count[i] += (qmask_of_invsample (inst) & rciter->m_qminv) == 0 && (inst->conds & rciter->m_query.m_qcmask) != 0;
-          if (inst->latest)
-          {
-            struct rhc_sample *sample = inst->latest->next, * const end = sample;
-            do {
-              cond_match_count[i] += ((qmask_of_sample (sample) & rciter->m_qminv) == 0 && (sample->conds & rciter->m_query.m_qcmask) != 0);
-              sample = sample->next;
-            } while (sample != end);
-          }
-        }
+          cond_match_count[i] += qcond_count_matches (rhc, inst, rciter);
       }
     }
   }
@@ -2866,6 +3541,34 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
       assert (cond_match_count[i] == ddsrt_atomic_ld32 (&rciter->m_entity.m_status.m_trigger));
   }
 
+  {
+    struct rhc_keyconds *kc;
+    for (kc = ddsrt_hh_iter_first (rhc->keyconds, &iter); kc; kc = ddsrt_hh_iter_next (&iter))
+    {
+      uint32_t nsamplest = 0;
+      assert (kc->conds != NULL);
+      inst = ddsrt_hh_lookup (rhc->instances, &(struct rhc_instance){ .iid = kc->iid });
+      assert (inst == NULL || inst->keyconds == kc);
+      for (rciter = kc->conds; rciter; rciter = rciter->m_next)
+      {
+        assert (dds_entity_kind (&rciter->m_entity) == DDS_KIND_COND_QUERY);
+        assert (rciter->m_query.m_filter == 0 && rciter->m_query.m_keyinst->m_iid == kc->iid);
+        nsamplest += cond_is_sample_state_dependent (rciter);
+        n_keyconds++;
+        if (check_conds)
+        {
+          const uint32_t m = (inst && !inst_is_empty (inst) && rhc_get_cond_trigger (inst, rciter)) ? qcond_count_matches (rhc, inst, rciter) : 0;
+          assert (m == ddsrt_atomic_ld32 (&rciter->m_entity.m_status.m_trigger));
+          (void) m;
+        }
+      }
+      assert (kc->nsamplest == nsamplest);
+      n_qconds_samplest += nsamplest;
+    }
+    assert (rhc->nkeyconds == n_keyconds);
+    assert (rhc->nqconds_samplest == n_qconds_samplest);
+  }
+
   if (rhc->n_nonempty_instances == 0)
   {
     assert (ddsrt_circlist_isempty (&rhc->nonempty_instances));
@@ -2888,6 +3591,28 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
     assert (rhc->n_nonempty_instances == n_nonempty_instances);
   }
 
+  if (!rhc->reception_order)
+    assert (ddsrt_circlist_isempty (&rhc->fifo));
+  else if (rhc->n_vsamples + rhc->n_invsamples == 0)
+    assert (ddsrt_circlist_isempty (&rhc->fifo));
+  else
+  {
+    /* every (invalid) sample is in the FIFO exactly once */
+    struct ddsrt_circlist_elem const *elem = ddsrt_circlist_oldest (&rhc->fifo), * const end = elem;
+    uint32_t n_elems = 0;
+    do {
+      struct rhc_fifo_elem const * const fe = DDSRT_FROM_CIRCLIST (struct rhc_fifo_elem, e, elem);
+      assert (ddsrt_hh_lookup (rhc->instances, fe->inst) == fe->inst);
+      if (fe == &fe->inst->inv_fifo)
+        assert (fe->inst->inv_exists);
+      else
+        assert (fe->inst->nvsamples > 0);
+      elem = elem->next;
+      n_elems++;
+    } while (elem != end);
+    assert (n_elems == rhc->n_vsamples + rhc->n_invsamples);
+  }
+
   return 1;
 }
 #undef CHECK_MAX_CONDS
@@ -36,6 +36,7 @@
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_cdrstream.h"
 #include "dds/ddsi/ddsi_security_omg.h"
+#include "dds/ddsi/ddsi_content_filter.h"
 #include "dds__serdata_builtintopic.h"
 
 DECL_ENTITY_LOCK_UNLOCK (dds_topic)
@@ -236,6 +237,8 @@ static void dds_topic_close (dds_entity *e)
 
   ddsrt_mutex_unlock (&pp->m_entity.m_mutex);
   ddsi_sertype_unref (tp->m_stype);
+  if (tp->m_content_filter)
+    ddsi_content_filter_free (tp->m_content_filter);
 }
 
 static dds_return_t dds_topic_qos_set (dds_entity *e, const dds_qos_t *qos, bool enabled)
@@ -1064,6 +1067,72 @@ dds_topic_filter_fn dds_topic_get_filter (dds_entity_t topic)
   return dds_get_topic_filter_deprecated (topic);
 }
 
+dds_return_t dds_register_content_filter (dds_entity_t entity, const char *filter_class, dds_content_filter_fn fn, void *arg)
+{
+  dds_entity *e;
+  dds_return_t rc;
+  if (filter_class == NULL || fn == 0)
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((rc = dds_entity_pin (entity, &e)) != DDS_RETCODE_OK)
+    return rc;
+  if (e->m_domain == NULL)
+    rc = DDS_RETCODE_ILLEGAL_OPERATION;
+  else
+    rc = ddsi_content_filter_register_class (&e->m_domain->gv, filter_class, fn, arg);
+  dds_entity_unpin (e);
+  return rc;
+}
+
+static bool dds_content_filter_accepts (const void *sample, void *arg)
+{
+  return ddsi_content_filter_accepts (arg, sample);
+}
+
+dds_return_t dds_set_topic_content_filter (dds_entity_t topic, const char *filter_class, const char *expression, uint32_t nparams, const char * const *params)
+{
+  dds_topic *t;
+  dds_return_t rc;
+  if (filter_class == NULL || expression == NULL || (nparams > 0 && params == NULL))
+    return DDS_RETCODE_BAD_PARAMETER;
+  for (uint32_t i = 0; i < nparams; i++)
+    if (params[i] == NULL)
+      return DDS_RETCODE_BAD_PARAMETER;
+  if ((rc = dds_topic_lock (topic, &t)) != DDS_RETCODE_OK)
+    return rc;
+  if (t->m_content_filter != NULL)
+  {
+    /* readers may still be using it: it can only be freed when the topic is */
+    dds_topic_unlock (t);
+    return DDS_RETCODE_PRECONDITION_NOT_MET;
+  }
+
+  /* the property is only used for making a copy, so aliasing is fine */
+  nn_content_filter_property_t prop = {
+    .content_filtered_topic_name = t->m_name,
+    .related_topic_name = t->m_name,
+    .filter_class_name = (char *) filter_class,
+    .filter_expression = (char *) expression,
+    .expression_parameters = { .n = nparams, .strs = (char **) params }
+  };
+  if ((t->m_content_filter = ddsi_content_filter_new (&t->m_entity.m_domain->gv, &prop)) == NULL)
+    rc = DDS_RETCODE_PRECONDITION_NOT_MET;
+  else
+  {
+    t->m_filter.mode = DDS_TOPIC_FILTER_SAMPLE_ARG;
+    t->m_filter.f.sample_arg = dds_content_filter_accepts;
+    t->m_filter.arg = t->m_content_filter;
+  }
+  dds_topic_unlock (t);
+  return rc;
+}
+
+const nn_content_filter_property_t *dds_topic_advertised_content_filter (const struct dds_topic *tp)
+{
+  if (tp->m_content_filter == NULL || tp->m_filter.arg != tp->m_content_filter)
+    return NULL;
+  return &tp->m_content_filter->prop;
+}
+
 dds_return_t dds_get_name (dds_entity_t topic, char *name, size_t size)
 {
   dds_topic *t;
@@ -12,6 +12,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <string.h>
+#include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/misc.h"
@@ -44,7 +45,7 @@ struct whc_node {
   struct whc_node *next_seq; /* next in this interval */
   struct whc_node *prev_seq; /* prev in this interval */
   struct whc_idxnode *idxnode; /* NULL if not in index */
-  uint32_t idxnode_pos; /* index in idxnode.hist */
+  uint32_t idxnode_pos; /* index in idxnode.hist; ordinal of the node in a whc_fifo */
   seqno_t seq;
   uint64_t total_bytes; /* cumulative number of bytes up to and including this node */
   size_t size;
@@ -54,7 +55,7 @@ struct whc_node {
   ddsrt_mtime_t last_rexmit_ts;
   uint32_t rexmit_count;
 #ifdef DDS_HAS_LIFESPAN
-  struct lifespan_fhnode lifespan; /* fibheap node for lifespan */
+  struct lifespan_fhnode lifespan; /* node in lifespan administration */
 #endif
   struct ddsi_serdata *serdata;
 };
@@ -89,6 +90,7 @@ struct whc_writer_info {
   dds_writer * writer; /* can be NULL, eg in case of whc for built-in writers */
   unsigned is_transient_local: 1;
   unsigned has_deadline: 1;
+  unsigned has_lifespan: 1;
   uint32_t hdepth; /* 0 = unlimited */
   uint32_t tldepth; /* 0 = disabled/unlimited (no need to maintain an index if KEEP_ALL <=> is_transient_local + tldepth=0) */
   uint32_t idxdepth; /* = max (hdepth, tldepth) */
@@ -165,6 +167,8 @@ static void whc_default_sample_iter_init (const struct whc *whc, struct whc_samp
 static bool whc_default_sample_iter_borrow_next (struct whc_sample_iter *opaque_it, struct whc_borrowed_sample *sample);
 static void whc_default_free (struct whc *whc);
 
+static struct whc *whc_fifo_new (struct ddsi_domaingv *gv, size_t sample_overhead);
+
 static const ddsrt_avl_treedef_t whc_seq_treedef =
   DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct whc_intvnode, avlnode), offsetof (struct whc_intvnode, min), compare_seq, 0);
 
@@ -429,6 +433,11 @@ struct whc_writer_info *whc_make_wrinfo (struct dds_writer *wr, const dds_qos_t
   wrinfo->writer = wr;
   wrinfo->is_transient_local = (qos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL);
   wrinfo->has_deadline = (qos->deadline.deadline != DDS_INFINITY);
+#ifdef DDS_HAS_LIFESPAN
+  wrinfo->has_lifespan = ((qos->present & QP_LIFESPAN) && qos->lifespan.duration != DDS_INFINITY);
+#else
+  wrinfo->has_lifespan = 0;
+#endif
   wrinfo->hdepth = (qos->history.kind == DDS_HISTORY_KEEP_ALL) ? 0 : (unsigned) qos->history.depth;
   if (!wrinfo->is_transient_local)
     wrinfo->tldepth = 0;
@@ -438,11 +447,34 @@ struct whc_writer_info *whc_make_wrinfo (struct dds_writer *wr, const dds_qos_t
   return wrinfo;
 }
 
+/* Whether samples must be inserted with their instance, if not, whc_insert accepts a null
+   pointer for the instance and the writer need not look up the instance of every sample */
+bool whc_needs_instances (const struct whc_writer_info *wrinfo)
+{
+  return wrinfo->idxdepth > 0 || wrinfo->is_transient_local || wrinfo->has_deadline;
+}
+
 void whc_free_wrinfo (struct whc_writer_info *wrinfo)
 {
   ddsrt_free (wrinfo);
 }
 
+static void whc_node_freelist_ref (void)
+{
+  ddsrt_mutex_lock (&dds_global.m_mutex);
+  if (whc_count++ == 0)
+    nn_freelist_init (&whc_node_freelist, MAX_FREELIST_SIZE, offsetof (struct whc_node, next_seq));
+  ddsrt_mutex_unlock (&dds_global.m_mutex);
+}
+
+static void whc_node_freelist_unref (void)
+{
+  ddsrt_mutex_lock (&dds_global.m_mutex);
+  if (--whc_count == 0)
+    nn_freelist_fini (&whc_node_freelist, ddsrt_free);
+  ddsrt_mutex_unlock (&dds_global.m_mutex);
+}
+
 struct whc *whc_new (struct ddsi_domaingv *gv, const struct whc_writer_info *wrinfo)
 {
   size_t sample_overhead = 80; /* INFO_TS, DATA (estimate), inline QoS */
@@ -451,6 +483,11 @@ struct whc *whc_new (struct ddsi_domaingv *gv, const struct whc_writer_info *wri
 
   assert ((wrinfo->hdepth == 0 || wrinfo->tldepth <= wrinfo->hdepth) || wrinfo->is_transient_local);
 
+  /* The FIFO variant only handles the case where samples are only ever removed
+     in sequence number order because they have been acknowledged */
+  if (gv->config.whc_fifo && wrinfo->idxdepth == 0 && !wrinfo->is_transient_local && !wrinfo->has_deadline && !wrinfo->has_lifespan)
+    return whc_fifo_new (gv, sample_overhead);
+
   whc = ddsrt_malloc (sizeof (*whc));
   whc->common.ops = &whc_ops;
   ddsrt_mutex_init (&whc->lock);
@@ -489,18 +526,16 @@ struct whc *whc_new (struct ddsi_domaingv *gv, const struct whc_writer_info *wri
   whc->open_intv = intv;
   whc->maxseq_node = NULL;
 
-  ddsrt_mutex_lock (&dds_global.m_mutex);
-  if (whc_count++ == 0)
-    nn_freelist_init (&whc_node_freelist, MAX_FREELIST_SIZE, offsetof (struct whc_node, next_seq));
-  ddsrt_mutex_unlock (&dds_global.m_mutex);
-
+  whc_node_freelist_ref ();
   check_whc (whc);
   return (struct whc *)whc;
 }
 
 static void free_whc_node_contents (struct whc_node *whcn)
 {
-  ddsi_serdata_unref (whcn->serdata);
+  /* serdata is only a null pointer for the initial dummy node of a whc_fifo */
+  if (whcn->serdata)
+    ddsi_serdata_unref (whcn->serdata);
   if (whcn->plist) {
     ddsi_plist_fini (whcn->plist);
     ddsrt_free (whcn->plist);
@@ -548,10 +583,7 @@ void whc_default_free (struct whc *whc_generic)
 
   ddsrt_avl_free (&whc_seq_treedef, &whc->seq, ddsrt_free);
 
-  ddsrt_mutex_lock (&dds_global.m_mutex);
-  if (--whc_count == 0)
-    nn_freelist_fini (&whc_node_freelist, ddsrt_free);
-  ddsrt_mutex_unlock (&dds_global.m_mutex);
+  whc_node_freelist_unref ();
 
 #if USE_EHH
   ddsrt_ehh_free (whc->seq_hash);
@@ -756,10 +788,10 @@ static uint32_t whc_default_downgrade_to_volatile (struct whc *whc_generic, stru
   return cnt;
 }
 
-static size_t whcn_size (const struct whc_impl *whc, const struct whc_node *whcn)
+static size_t whcn_size (size_t sample_overhead, uint32_t fragment_size, const struct whc_node *whcn)
 {
   size_t sz = ddsi_serdata_size (whcn->serdata);
-  return sz + ((sz + whc->fragment_size - 1) / whc->fragment_size) * whc->sample_overhead;
+  return sz + ((sz + fragment_size - 1) / fragment_size) * sample_overhead;
 }
 
 static void whc_delete_one_intv (struct whc_impl *whc, struct whc_intvnode **p_intv, struct whc_node **p_whcn)
@@ -1185,7 +1217,7 @@ static struct whc_node *whc_default_insert_seq (struct whc_impl *whc, seqno_t ma
     newn->prev_seq->next_seq = newn;
   whc->maxseq_node = newn;
 
-  newn->size = whcn_size (whc, newn);
+  newn->size = whcn_size (whc->sample_overhead, whc->fragment_size, newn);
   whc->total_bytes += newn->size;
   newn->total_bytes = whc->total_bytes;
   if (newn->unacked)
@@ -1272,7 +1304,8 @@ static int whc_default_insert (struct whc *whc_generic, seqno_t max_drop_seq, se
   TRACE ("  whcn %p:", (void*)newn);
 
   /* Special case of empty data (such as commit messages) can't go into index, and if we're not maintaining an index, we're done, too */
-  if (serdata->kind == SDK_EMPTY)
+  assert (tk != NULL || !whc_needs_instances (&whc->wrinfo));
+  if (serdata->kind == SDK_EMPTY || tk == NULL)
   {
     TRACE (" empty or no hist\n");
     ddsrt_mutex_unlock (&whc->lock);
@@ -1504,3 +1537,440 @@ static bool whc_default_sample_iter_borrow_next (struct whc_sample_iter *opaque_
   ddsrt_mutex_unlock (&whc->lock);
   return valid;
 }
+
+/* FIFO WHC ----------------------------------------------------------- */
+
+/* For writers that keep all history, have volatile durability and neither
+ * deadline nor lifespan, samples are only ever removed in sequence number
+ * order, once acknowledged by all readers.  That allows a far simpler
+ * administration that is organised as a queue with separate locks for the
+ * two ends:
+ *
+ * - the samples form a singly linked list in sequence number order that
+ *   always starts with a "head" node: that is the most recently removed
+ *   sample (or an initial dummy).  The head node isn't part of the WHC
+ *   anymore, but it stays in memory until the next removal, and so
+ *   removing samples never touches a node that an insert may be linking
+ *   to.  This is the classic two-lock queue;
+ * - a circular array indexed by sequence number, sized to cover [min_seq,
+ *   maxp1), gives access by sequence number without a hash table, and so
+ *   there is nothing to update for individual samples when removing them;
+ * - the number of unacknowledged bytes follows from the cumulative sizes
+ *   in the nodes, as samples are all unacknowledged on insertion.
+ *
+ * Removing acknowledged samples is therefore a constant-time operation
+ * irrespective of the number of samples, the samples themselves get freed
+ * in whc_free_deferred_free_list, which the callers invoke after releasing
+ * the writer lock.
+ *
+ * Lock order is head_lock, then tail_lock.  Inserting only takes the
+ * tail_lock, except when the array needs to grow or there is a gap in the
+ * sequence numbers.  All other operations only take the head_lock.  min_seq
+ * is written by the head side only, maxp1 by the tail side only, both are
+ * read by the other side without holding its lock. */
+
+struct whc_fifo {
+  struct whc common;
+  ddsrt_mutex_t head_lock;
+  ddsrt_mutex_t tail_lock;
+  struct ddsi_domaingv *gv;
+  size_t sample_overhead;
+  uint32_t fragment_size;
+
+  /* protected by head_lock */
+  struct whc_node *head; /* most recently removed node, or a dummy */
+  seqno_t max_drop_seq;
+
+  /* protected by tail_lock */
+  struct whc_node *tail; /* most recently inserted node, or = head */
+  uint64_t total_bytes;
+  uint32_t ninserted;
+
+  ddsrt_atomic_uint64_t min_seq; /* all in WHC >= min_seq; empty iff min_seq = maxp1 */
+  ddsrt_atomic_uint64_t maxp1; /* all in WHC < maxp1 */
+
+  /* only changed while holding both locks */
+  uint32_t ring_size; /* power of 2 */
+  struct whc_node **ring; /* ring[seq % ring_size] for seq in [min_seq,maxp1), null in case of a gap */
+};
+
+#define WHC_FIFO_INITIAL_RING_SIZE 64u
+
+struct whc_fifo_sample_iter {
+  struct whc_sample_iter_base c;
+  bool first;
+};
+
+DDSRT_STATIC_ASSERT (sizeof (struct whc_fifo_sample_iter) <= sizeof (struct whc_sample_iter));
+
+static seqno_t fifo_min_seq (const struct whc_fifo *whc)
+{
+  return (seqno_t) ddsrt_atomic_ld64 (&whc->min_seq);
+}
+
+static seqno_t fifo_maxp1 (const struct whc_fifo *whc)
+{
+  /* pairs with the release fence in whc_fifo_insert: everything up to maxp1 is visible */
+  const seqno_t maxp1 = (seqno_t) ddsrt_atomic_ld64 (&whc->maxp1);
+  ddsrt_atomic_fence_acq ();
+  return maxp1;
+}
+
+static struct whc_node **fifo_slot (const struct whc_fifo *whc, seqno_t seq)
+{
+  return &whc->ring[(uint64_t) seq & (whc->ring_size - 1)];
+}
+
+static struct whc_node *fifo_findseq (const struct whc_fifo *whc, seqno_t seq)
+{
+  /* head_lock or tail_lock must be held */
+  if (seq < fifo_min_seq (whc) || seq >= fifo_maxp1 (whc))
+    return NULL;
+  return *fifo_slot (whc, seq);
+}
+
+static void fifo_get_state_locked (const struct whc_fifo *whc, struct whc_state *st)
+{
+  /* head_lock must be held */
+  seqno_t min_seq = fifo_min_seq (whc);
+  const seqno_t maxp1 = fifo_maxp1 (whc);
+  if (min_seq == maxp1)
+  {
+    st->min_seq = st->max_seq = -1;
+    st->unacked_bytes = 0;
+  }
+  else
+  {
+    /* the most recently inserted sample is never a gap, and its cumulative size is
+       stable and consistent with maxp1, unlike whc->total_bytes */
+    const struct whc_node *maxn = *fifo_slot (whc, maxp1 - 1);
+    while (*fifo_slot (whc, min_seq) == NULL)
+      min_seq++;
+    st->min_seq = min_seq;
+    st->max_seq = maxp1 - 1;
+    st->unacked_bytes = (size_t) (maxn->total_bytes - whc->head->total_bytes);
+  }
+}
+
+static void whc_fifo_get_state (const struct whc *whc_generic, struct whc_state *st)
+{
+  struct whc_fifo * const whc = (struct whc_fifo *) whc_generic;
+  ddsrt_mutex_lock (&whc->head_lock);
+  fifo_get_state_locked (whc, st);
+  ddsrt_mutex_unlock (&whc->head_lock);
+}
+
+static seqno_t fifo_next_seq_locked (const struct whc_fifo *whc, seqno_t seq)
+{
+  const seqno_t maxp1 = fifo_maxp1 (whc);
+  seqno_t s = fifo_min_seq (whc);
+  if (s <= seq)
+    s = seq + 1;
+  while (s < maxp1 && *fifo_slot (whc, s) == NULL)
+    s++;
+  return (s < maxp1) ? s : MAX_SEQ_NUMBER;
+}
+
+static seqno_t whc_fifo_next_seq (const struct whc *whc_generic, seqno_t seq)
+{
+  struct whc_fifo * const whc = (struct whc_fifo *) whc_generic;
+  seqno_t nseq;
+  ddsrt_mutex_lock (&whc->head_lock);
+  nseq = fifo_next_seq_locked (whc, seq);
+  ddsrt_mutex_unlock (&whc->head_lock);
+  return nseq;
+}
+
+static void fifo_grow_ring (struct whc_fifo *whc, seqno_t min_seq, seqno_t maxp1)
+{
+  /* both locks must be held */
+  uint32_t size = whc->ring_size;
+  while ((uint64_t) (maxp1 - min_seq) > size)
+    size *= 2;
+  if (size == whc->ring_size)
+    return;
+  struct whc_node **ring = ddsrt_malloc (size * sizeof (*ring));
+  for (seqno_t seq = min_seq; seq < fifo_maxp1 (whc); seq++)
+    ring[(uint64_t) seq & (size - 1)] = *fifo_slot (whc, seq);
+  ddsrt_free (whc->ring);
+  whc->ring = ring;
+  whc->ring_size = size;
+  TRACE ("  whc_fifo %p ring size %"PRIu32"\n", (void *) whc, size);
+}
+
+static int whc_fifo_insert (struct whc *whc_generic, seqno_t max_drop_seq, seqno_t seq, ddsrt_mtime_t exp, struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
+{
+  struct whc_fifo * const whc = (struct whc_fifo *) whc_generic;
+  struct whc_node *newn;
+  bool have_head_lock = false;
+  seqno_t maxp1;
+  (void) exp;
+  (void) tk;
+
+  TRACE ("whc_fifo_insert(%p max_drop_seq %"PRId64" seq %"PRId64" plist %p serdata %p:%"PRIx32")\n",
+         (void *) whc, max_drop_seq, seq, (void *) plist, (void *) serdata, serdata->hash);
+
+  /* There are no samples to delete on insertion because of acknowledgements: a
+     reliable reader may not acknowledge what it hasn't received */
+  assert (seq > max_drop_seq);
+  (void) max_drop_seq;
+
+  if ((newn = nn_freelist_pop (&whc_node_freelist)) == NULL)
+    newn = ddsrt_malloc (sizeof (*newn));
+  newn->seq = seq;
+  newn->plist = plist;
+  newn->unacked = 1;
+  newn->borrowed = 0;
+  newn->idxnode = NULL;
+  newn->last_rexmit_ts.v = 0;
+  newn->rexmit_count = 0;
+  newn->serdata = ddsi_serdata_ref (serdata);
+  newn->next_seq = NULL;
+  newn->size = whcn_size (whc->sample_overhead, whc->fragment_size, newn);
+
+  ddsrt_mutex_lock (&whc->tail_lock);
+  maxp1 = (seqno_t) ddsrt_atomic_ld64 (&whc->maxp1);
+  if (seq != maxp1 || (uint64_t) (maxp1 + 1 - fifo_min_seq (whc)) > whc->ring_size)
+  {
+    /* Gap or ring full: min_seq is stable only while holding head_lock, which has
+       to be acquired first */
+    ddsrt_mutex_unlock (&whc->tail_lock);
+    ddsrt_mutex_lock (&whc->head_lock);
+    ddsrt_mutex_lock (&whc->tail_lock);
+    have_head_lock = true;
+    maxp1 = (seqno_t) ddsrt_atomic_ld64 (&whc->maxp1);
+    if (fifo_min_seq (whc) == maxp1)
+    {
+      /* empty: simply restart at seq */
+      ddsrt_atomic_st64 (&whc->min_seq, (uint64_t) seq);
+      maxp1 = seq;
+    }
+    fifo_grow_ring (whc, fifo_min_seq (whc), seq + 1);
+    /* samples not stored in the WHC (e.g., written while no reliable reader was
+       matched) can't normally be followed by stored samples without all preceding
+       samples having been acknowledged, but gaps are supported all the same */
+    for (seqno_t s = maxp1; s < seq; s++)
+      *fifo_slot (whc, s) = NULL;
+  }
+  assert (seq >= maxp1);
+
+  newn->prev_seq = whc->tail;
+  whc->total_bytes += newn->size;
+  newn->total_bytes = whc->total_bytes;
+  newn->idxnode_pos = ++whc->ninserted;
+  *fifo_slot (whc, seq) = newn;
+  whc->tail->next_seq = newn;
+  whc->tail = newn;
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st64 (&whc->maxp1, (uint64_t) (seq + 1));
+  ddsrt_mutex_unlock (&whc->tail_lock);
+  if (have_head_lock)
+    ddsrt_mutex_unlock (&whc->head_lock);
+  return 0;
+}
+
+static uint32_t whc_fifo_remove_acked_messages (struct whc *whc_generic, seqno_t max_drop_seq, struct whc_state *whcst, struct whc_node **deferred_free_list)
+{
+  struct whc_fifo * const whc = (struct whc_fifo *) whc_generic;
+  struct whc_node *newhead = NULL;
+  uint32_t ndropped = 0;
+
+  ddsrt_mutex_lock (&whc->head_lock);
+  assert (max_drop_seq < MAX_SEQ_NUMBER);
+  assert (max_drop_seq >= whc->max_drop_seq);
+  TRACE ("whc_fifo_remove_acked_messages(%p max_drop_seq %"PRId64")\n", (void *) whc, max_drop_seq);
+
+  /* Everything up to and including max_drop_seq goes, except for what gets inserted
+     concurrently; the last sample dropped becomes the new head node */
+  const seqno_t min_seq = fifo_min_seq (whc);
+  const seqno_t maxp1 = fifo_maxp1 (whc);
+  for (seqno_t seq = (max_drop_seq < maxp1) ? max_drop_seq : maxp1 - 1; seq >= min_seq && newhead == NULL; seq--)
+    newhead = *fifo_slot (whc, seq);
+  if (newhead == NULL)
+    *deferred_free_list = NULL;
+  else
+  {
+    /* the old head node and all samples preceding the new head are freed; all of
+       those precede the tail and so aren't touched by inserts */
+    struct whc_node * const last_to_free = newhead->prev_seq;
+    assert (last_to_free != NULL);
+    last_to_free->next_seq = NULL;
+    *deferred_free_list = whc->head;
+    ndropped = newhead->idxnode_pos - whc->head->idxnode_pos;
+    whc->head = newhead;
+    ddsrt_atomic_st64 (&whc->min_seq, (uint64_t) (newhead->seq + 1));
+  }
+  if (max_drop_seq > whc->max_drop_seq)
+    whc->max_drop_seq = max_drop_seq;
+  fifo_get_state_locked (whc, whcst);
+  ddsrt_mutex_unlock (&whc->head_lock);
+  return ndropped;
+}
+
+static void whc_fifo_free_deferred_free_list (struct whc *whc_generic, struct whc_node *deferred_free_list)
+{
+  (void) whc_generic;
+  free_deferred_free_list (deferred_free_list);
+}
+
+static bool whc_fifo_borrow_sample (const struct whc *whc_generic, seqno_t seq, struct whc_borrowed_sample *sample)
+{
+  struct whc_fifo * const whc = (struct whc_fifo *) whc_generic;
+  struct whc_node *whcn;
+  bool found;
+  ddsrt_mutex_lock (&whc->head_lock);
+  if ((whcn = fifo_findseq (whc, seq)) == NULL)
+    found = false;
+  else
+  {
+    make_borrowed_sample (sample, whcn);
+    found = true;
+  }
+  ddsrt_mutex_unlock (&whc->head_lock);
+  return found;
+}
+
+static bool whc_fifo_borrow_sample_key (const struct whc *whc_generic, const struct ddsi_serdata *serdata_key, struct whc_borrowed_sample *sample)
+{
+  /* only used for transient-local data */
+  (void) whc_generic;
+  (void) serdata_key;
+  (void) sample;
+  return false;
+}
+
+static void fifo_return_sample_locked (struct whc_fifo *whc, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_node *whcn;
+  if ((whcn = fifo_findseq (whc, sample->seq)) == NULL)
+  {
+    /* removed while borrowed: ownership of the contents went to the borrowed copy */
+    ddsi_serdata_unref (sample->serdata);
+    if (sample->plist)
+    {
+      ddsi_plist_fini (sample->plist);
+      ddsrt_free (sample->plist);
+    }
+  }
+  else
+  {
+    assert (whcn->borrowed);
+    whcn->borrowed = 0;
+    if (update_retransmit_info)
+    {
+      whcn->rexmit_count = sample->rexmit_count;
+      whcn->last_rexmit_ts = sample->last_rexmit_ts;
+    }
+  }
+}
+
+static void whc_fifo_return_sample (struct whc *whc_generic, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_fifo * const whc = (struct whc_fifo *) whc_generic;
+  ddsrt_mutex_lock (&whc->head_lock);
+  fifo_return_sample_locked (whc, sample, update_retransmit_info);
+  ddsrt_mutex_unlock (&whc->head_lock);
+}
+
+static void whc_fifo_sample_iter_init (const struct whc *whc_generic, struct whc_sample_iter *opaque_it)
+{
+  struct whc_fifo_sample_iter *it = (struct whc_fifo_sample_iter *) opaque_it;
+  it->c.whc = (struct whc *) whc_generic;
+  it->first = true;
+}
+
+static bool whc_fifo_sample_iter_borrow_next (struct whc_sample_iter *opaque_it, struct whc_borrowed_sample *sample)
+{
+  struct whc_fifo_sample_iter * const it = (struct whc_fifo_sample_iter *) opaque_it;
+  struct whc_fifo * const whc = (struct whc_fifo *) it->c.whc;
+  seqno_t seq;
+  bool valid;
+  ddsrt_mutex_lock (&whc->head_lock);
+  if (!it->first)
+  {
+    seq = sample->seq;
+    fifo_return_sample_locked (whc, sample, false);
+  }
+  else
+  {
+    it->first = false;
+    seq = 0;
+  }
+  if ((seq = fifo_next_seq_locked (whc, seq)) == MAX_SEQ_NUMBER)
+    valid = false;
+  else
+  {
+    make_borrowed_sample (sample, *fifo_slot (whc, seq));
+    valid = true;
+  }
+  ddsrt_mutex_unlock (&whc->head_lock);
+  return valid;
+}
+
+static uint32_t whc_fifo_downgrade_to_volatile (struct whc *whc_generic, struct whc_state *st)
+{
+  /* volatile to begin with */
+  whc_fifo_get_state (whc_generic, st);
+  return 0;
+}
+
+static void whc_fifo_free (struct whc *whc_generic)
+{
+  struct whc_fifo * const whc = (struct whc_fifo *) whc_generic;
+  struct whc_node *whcn = whc->head;
+  while (whcn)
+  {
+    struct whc_node *tmp = whcn;
+    whcn = whcn->next_seq;
+    /* the head node may have been removed while borrowed, in which case the
+       contents were released when the sample was returned */
+    if (!tmp->borrowed)
+      free_whc_node_contents (tmp);
+    ddsrt_free (tmp);
+  }
+  ddsrt_free (whc->ring);
+  whc_node_freelist_unref ();
+  ddsrt_mutex_destroy (&whc->tail_lock);
+  ddsrt_mutex_destroy (&whc->head_lock);
+  ddsrt_free (whc);
+}
+
+static const struct whc_ops whc_fifo_ops = {
+  .insert = whc_fifo_insert,
+  .remove_acked_messages = whc_fifo_remove_acked_messages,
+  .free_deferred_free_list = whc_fifo_free_deferred_free_list,
+  .get_state = whc_fifo_get_state,
+  .next_seq = whc_fifo_next_seq,
+  .borrow_sample = whc_fifo_borrow_sample,
+  .borrow_sample_key = whc_fifo_borrow_sample_key,
+  .return_sample = whc_fifo_return_sample,
+  .sample_iter_init = whc_fifo_sample_iter_init,
+  .sample_iter_borrow_next = whc_fifo_sample_iter_borrow_next,
+  .downgrade_to_volatile = whc_fifo_downgrade_to_volatile,
+  .free = whc_fifo_free
+};
+
+static struct whc *whc_fifo_new (struct ddsi_domaingv *gv, size_t sample_overhead)
+{
+  struct whc_fifo *whc = ddsrt_malloc (sizeof (*whc));
+  struct whc_node *dummy = ddsrt_malloc (sizeof (*dummy));
+  whc->common.ops = &whc_fifo_ops;
+  ddsrt_mutex_init (&whc->head_lock);
+  ddsrt_mutex_init (&whc->tail_lock);
+  whc->gv = gv;
+  whc->sample_overhead = sample_overhead;
+  whc->fragment_size = gv->config.fragment_size;
+
+  memset (dummy, 0, sizeof (*dummy));
+  whc->head = whc->tail = dummy;
+  whc->max_drop_seq = 0;
+  whc->total_bytes = 0;
+  whc->ninserted = 0;
+  ddsrt_atomic_st64 (&whc->min_seq, 1);
+  ddsrt_atomic_st64 (&whc->maxp1, 1);
+  whc->ring_size = WHC_FIFO_INITIAL_RING_SIZE;
+  whc->ring = ddsrt_malloc (whc->ring_size * sizeof (*whc->ring));
+
+  whc_node_freelist_ref ();
+  return (struct whc *) whc;
+}
@@ -276,12 +276,37 @@ struct local_sourceinfo {
   const struct ddsi_sertype *src_type;
   struct ddsi_serdata *src_payload;
   struct ddsi_tkmap_instance *src_tk;
+  const void *src_sample; /* application sample, for constructing a keyed payload if src_tk is null */
+  bool src_keyed_here; /* src_payload and src_tk were constructed by local_make_sample */
   ddsrt_mtime_t timeout;
 };
 
+static bool local_make_keyed_payload (struct ddsi_domaingv *gv, struct local_sourceinfo *si)
+{
+  /* The key of the sample was not computed when it was written, but readers need it for
+     looking up the instance: construct a serdata with a key once and use it for all */
+  struct ddsi_serdata *d;
+  assert (si->src_sample != NULL);
+  if ((d = ddsi_serdata_from_sample (si->src_type, si->src_payload->kind, si->src_sample)) == NULL)
+    return false;
+  d->statusinfo = si->src_payload->statusinfo;
+  d->timestamp = si->src_payload->timestamp;
+  si->src_payload = d;
+  si->src_tk = ddsi_tkmap_lookup_instance_ref (gv->m_tkmap, d);
+  si->src_keyed_here = true;
+  return true;
+}
+
 static struct ddsi_serdata *local_make_sample (struct ddsi_tkmap_instance **tk, struct ddsi_domaingv *gv, struct ddsi_sertype const * const type, void *vsourceinfo)
 {
   struct local_sourceinfo *si = vsourceinfo;
+  if (si->src_tk == NULL && !local_make_keyed_payload (gv, si))
+  {
+    DDS_CWARNING (&gv->logconfig, "local: serialization %s failed\n", si->src_type->type_name);
+    return NULL;
+  }
+  /* Readers store the sample, so it can't reference the application's memory */
+  ddsi_serdata_detach (si->src_payload);
   struct ddsi_serdata *d = ddsi_serdata_ref_as_type (type, si->src_payload);
   if (d == NULL)
   {
@@ -318,7 +343,7 @@ static dds_return_t local_on_delivery_failure_fastpath (struct entity_common *so
   }
 }
 
-static dds_return_t deliver_locally (struct writer *wr, struct ddsi_serdata *payload, struct ddsi_tkmap_instance *tk)
+static dds_return_t deliver_locally (struct writer *wr, struct ddsi_serdata *payload, struct ddsi_tkmap_instance *tk, const void *sample)
 {
   static const struct deliver_locally_ops deliver_locally_ops = {
     .makesample = local_make_sample,
@@ -330,17 +355,37 @@ static dds_return_t deliver_locally (struct writer *wr, struct ddsi_serdata *pay
     .src_type = wr->type,
     .src_payload = payload,
     .src_tk = tk,
+    .src_sample = sample,
+    .src_keyed_here = false,
     .timeout = { 0 },
   };
   dds_return_t rc;
   struct ddsi_writer_info wrinfo;
   ddsi_make_writer_info (&wrinfo, &wr->e, wr->xqos, payload->statusinfo);
   rc = deliver_locally_allinsync (wr->e.gv, &wr->e, false, &wr->rdary, &wrinfo, &deliver_locally_ops, &sourceinfo);
+  if (sourceinfo.src_keyed_here)
+  {
+    ddsi_tkmap_instance_unref (wr->e.gv->m_tkmap, sourceinfo.src_tk);
+    ddsi_serdata_unref (sourceinfo.src_payload);
+  }
   if (rc == DDS_RETCODE_TIMEOUT)
     DDS_CERROR (&wr->e.gv->logconfig, "The writer could not deliver data on time, probably due to a local reader resources being full\n");
   return rc;
 }
 
+static struct ddsi_serdata *serdata_from_sample_for_write (const dds_writer *wr, enum ddsi_serdata_kind kind, const void *data, bool lazy_key)
+{
+  /* Large sequences may be transmitted directly from the application's memory if the
+     write is guaranteed to hand the data to the network stack before returning, the
+     WHC and local readers then detach the serdata if they need to hold on to it */
+  if (wr->m_sg_min_size > 0 && !wr->whc_batch)
+    return ddsi_serdata_from_sample_ref (wr->m_wr->type, kind, data, wr->m_sg_min_size);
+  else if (lazy_key)
+    return ddsi_serdata_from_sample_lazykey (wr->m_wr->type, kind, data);
+  else
+    return ddsi_serdata_from_sample (wr->m_wr->type, kind, data);
+}
+
 #if DDS_HAS_SHM
 static bool deliver_data_via_iceoryx(dds_writer *wr, struct ddsi_serdata *d) {
     if (wr->m_iox_pub != NULL && d->iox_chunk != NULL)
@@ -424,7 +469,7 @@ static dds_return_t deliver_data (struct writer *ddsi_wr, dds_writer *wr, struct
 #endif
 
   if (ret == DDS_RETCODE_OK && !suppress_local_delivery)
-    ret = deliver_locally (ddsi_wr, d, tk);
+    ret = deliver_locally (ddsi_wr, d, tk, NULL);
 
   ddsi_tkmap_instance_unref (ddsi_wr->e.gv->m_tkmap, tk);
 
@@ -640,7 +685,7 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
     // serialize for network since we will need to send via network anyway
     // we also need to serialize into an iceoryx chunk
  
-    d = ddsi_serdata_from_sample (ddsi_wr->type, writekey ? SDK_KEY : SDK_DATA, data);
+    d = serdata_from_sample_for_write (wr, writekey ? SDK_KEY : SDK_DATA, data, false);
     if(d == NULL) {
       ret = DDS_RETCODE_BAD_PARAMETER;
       goto release_chunk;
@@ -708,6 +753,9 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
   struct thread_state1 * const ts1 = lookup_thread_state ();
   const bool writekey = action & DDS_WR_KEY_BIT;
   struct writer *ddsi_wr = wr->m_wr;
+  /* Without an instance index in the WHC, the key is only needed for local readers and
+     for remote readers that need a keyhash, both of which compute it themselves */
+  const bool lazy_key = wr->m_lazy_key && !writekey;
   struct ddsi_serdata *d;
   dds_return_t ret = DDS_RETCODE_OK;
 
@@ -721,7 +769,7 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
   thread_state_awake (ts1, &wr->m_entity.m_domain->gv);
 
   /* Serialize and write data or key */
-  if ((d = ddsi_serdata_from_sample (ddsi_wr->type, writekey ? SDK_KEY : SDK_DATA, data)) == NULL)
+  if ((d = serdata_from_sample_for_write (wr, writekey ? SDK_KEY : SDK_DATA, data, lazy_key)) == NULL)
     ret = DDS_RETCODE_BAD_PARAMETER;
   else
   {
@@ -731,7 +779,7 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
     d->timestamp.v = tstamp;
     ddsi_serdata_ref (d);
 
-    tk = ddsi_tkmap_lookup_instance_ref (wr->m_entity.m_domain->gv.m_tkmap, d);
+    tk = lazy_key ? NULL : ddsi_tkmap_lookup_instance_ref (wr->m_entity.m_domain->gv.m_tkmap, d);
     ret = write_sample_gc (ts1, wr->m_xp, ddsi_wr, d, tk);
 
     if (ret >= 0) {
@@ -744,9 +792,10 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
     }
 
     if (ret == DDS_RETCODE_OK)
-      ret = deliver_locally (ddsi_wr, d, tk);
+      ret = deliver_locally (ddsi_wr, d, tk, data);
     ddsi_serdata_unref (d);
-    ddsi_tkmap_instance_unref (wr->m_entity.m_domain->gv.m_tkmap, tk);
+    if (tk)
+      ddsi_tkmap_instance_unref (wr->m_entity.m_domain->gv.m_tkmap, tk);
   }
   thread_state_asleep (ts1);
   return ret;
@@ -412,8 +412,12 @@ dds_entity_t dds_create_writer (dds_entity_t participant_or_publisher, dds_entit
   wr->m_xp = nn_xpack_new (gv, get_bandwidth_limit (wqos->transport_priority), async_mode);
   wrinfo = whc_make_wrinfo (wr, wqos);
   wr->m_whc = whc_new (gv, wrinfo);
+  wr->m_lazy_key = gv->config.lazy_write_key && !whc_needs_instances (wrinfo);
   whc_free_wrinfo (wrinfo);
   wr->whc_batch = gv->config.whc_batch;
+  /* referencing the application's data requires the sample to be sent before
+     the write returns, which is not the case with a latency budget */
+  wr->m_sg_min_size = async_mode ? 0 : gv->config.scatter_gather_min_size;
   wr->m_data_representation = data_representation;
 
 #ifdef DDS_HAS_SHM
@@ -1443,6 +1443,7 @@ CU_Theory ((const char *descr, const dds_topic_descriptor_t *desc1, const dds_to
     os.m_index = 0;
     os.m_size = 0;
     os.m_xcdr_version = CDR_ENC_VERSION_2;
+    os.m_extrefs = NULL;
 
     struct ddsi_sertype_default tp_wr;
     memset (&tp_wr, 0, sizeof (tp_wr));
@@ -1503,3 +1504,68 @@ CU_Theory ((const char *descr, const dds_topic_descriptor_t *desc1, const dds_to
 #undef K
 #undef C
 #undef F
+
+/**********************************************
+ * Column plans
+ **********************************************/
+typedef struct TestIdl_MsgColumns
+{
+  uint32_t col1;
+  uint32_t *col2;
+  char **col3;
+} TestIdl_MsgColumns;
+
+static const uint32_t TestIdl_MsgColumns_flat_ops [] =
+{
+  DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (TestIdl_MsgColumns, col1),
+  DDS_OP_RTS
+};
+
+static const uint32_t TestIdl_MsgColumns_ext_prim_ops [] =
+{
+  DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (TestIdl_MsgColumns, col1),
+  DDS_OP_ADR | DDS_OP_TYPE_4BY | DDS_OP_FLAG_EXT, offsetof (TestIdl_MsgColumns, col2), sizeof (uint32_t),
+  DDS_OP_RTS
+};
+
+static const uint32_t TestIdl_MsgColumns_ext_str_ops [] =
+{
+  DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (TestIdl_MsgColumns, col1),
+  DDS_OP_ADR | DDS_OP_TYPE_STR | DDS_OP_FLAG_EXT, offsetof (TestIdl_MsgColumns, col3), sizeof (char *),
+  DDS_OP_RTS
+};
+
+CU_Test (ddsc_cdrstream, columns_external)
+{
+  /* @external members are pointers in the sample, a type with one can't be handled by a
+     plan, even if the selected column precedes it; the number of instructions is given
+     explicitly because dds_stream_countops doesn't handle external primitives */
+#define T(n) TestIdl_MsgColumns_##n##_ops, sizeof (TestIdl_MsgColumns_##n##_ops) / sizeof (uint32_t)
+  static const struct { const char *descr; const uint32_t *ops; uint32_t nops; bool plan; } tests[] = {
+    { "flat", T(flat), true },
+    { "external primitive", T(ext_prim), false },
+    { "external string", T(ext_str), false }
+  };
+#undef T
+  uint32_t buf[1];
+  const struct dds_stream_column col = { offsetof (TestIdl_MsgColumns, col1), sizeof (uint32_t), buf };
+  for (size_t i = 0; i < sizeof (tests) / sizeof (tests[0]); i++)
+  {
+    msg ("Running test columns_external: %s", tests[i].descr);
+    struct ddsi_sertype_default tp;
+    memset (&tp, 0, sizeof (tp));
+    tp.type = (struct ddsi_sertype_default_desc) {
+      .size = sizeof (TestIdl_MsgColumns),
+      .align = sizeof (char *),
+      .flagset = 0,
+      .keys.nkeys = 0,
+      .keys.keys = NULL,
+      .ops.nops = tests[i].nops,
+      .ops.ops = (uint32_t *) tests[i].ops
+    };
+    struct dds_stream_columns *plan = dds_stream_columns_new (&tp, 1, &col);
+    CU_ASSERT_FATAL ((plan != NULL) == tests[i].plan);
+    if (plan)
+      dds_stream_columns_free (plan);
+  }
+}
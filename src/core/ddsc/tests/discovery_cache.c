@@ -0,0 +1,392 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsi/ddsi_discovery_cache.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_entity_index.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+/* Domain A is the remote application, domain B records it in its discovery
+   cache; both use the same port numbers so they see each other */
+#define DC_DOMAINID_A 1
+#define DC_DOMAINID_B 2
+
+#ifdef DDS_HAS_SHM
+#define DC_CONFIG_SHM "<Domain id=\"any\"><SharedMemory><Enable>false</Enable></SharedMemory></Domain>"
+#else
+#define DC_CONFIG_SHM ""
+#endif
+#define DC_CONFIG "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId><CacheFile>%s</CacheFile><CacheMaxAge>%s</CacheMaxAge></Discovery><Internal><LeaseDuration>2 s</LeaseDuration></Internal>" DC_CONFIG_SHM
+
+#define DC_TIMEOUT DDS_SECS (10)
+
+static char *dc_file;
+
+static void dc_init (void)
+{
+  ddsrt_asprintf (&dc_file, "cyclonedds_discovery_cache_test.%"PRIdPID".ddc", ddsrt_getpid ());
+}
+
+static void dc_fini (void)
+{
+  DDSRT_WARNING_MSVC_OFF(4996);
+  (void) remove (dc_file);
+  DDSRT_WARNING_MSVC_ON(4996);
+  ddsrt_free (dc_file);
+}
+
+static dds_entity_t dc_create_domain (dds_domainid_t domid, const char *cache_file, const char *max_age)
+{
+  char *config, *xconfig;
+  ddsrt_asprintf (&config, DC_CONFIG, cache_file, max_age);
+  xconfig = ddsrt_expand_envvars (config, domid);
+  const dds_entity_t dom = dds_create_domain (domid, xconfig);
+  CU_ASSERT_FATAL (dom > 0);
+  ddsrt_free (xconfig);
+  ddsrt_free (config);
+  const dds_entity_t pp = dds_create_participant (domid, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  return pp;
+}
+
+static struct ddsi_domaingv *dc_get_domaingv (dds_entity_t handle)
+{
+  struct dds_entity *x;
+  dds_return_t rc = dds_entity_pin (handle, &x);
+  CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+  struct ddsi_domaingv * const gv = &x->m_domain->gv;
+  dds_entity_unpin (x);
+  return gv;
+}
+
+static ddsi_guid_t dc_get_guid (dds_entity_t handle)
+{
+  struct dds_entity *x;
+  dds_return_t rc = dds_entity_pin (handle, &x);
+  CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+  const ddsi_guid_t guid = x->m_guid;
+  dds_entity_unpin (x);
+  return guid;
+}
+
+struct dc_collect {
+  uint32_t n, size;
+  ddsi_guid_t *guids;
+};
+
+static void dc_collect_cb (const struct ddsi_discovery_cache_entry *e, void *varg)
+{
+  struct dc_collect * const arg = varg;
+  if (arg->n == arg->size)
+  {
+    arg->size = (arg->size == 0) ? 16 : 2 * arg->size;
+    arg->guids = ddsrt_realloc (arg->guids, arg->size * sizeof (*arg->guids));
+  }
+  arg->guids[arg->n++] = e->guid;
+}
+
+static bool dc_collect_contains (const struct dc_collect *arg, const ddsi_guid_t *guid)
+{
+  for (uint32_t i = 0; i < arg->n; i++)
+    if (memcmp (&arg->guids[i], guid, sizeof (*guid)) == 0)
+      return true;
+  return false;
+}
+
+/* Returns a bit mask with bit i set if guids[i] is in the cache; restoring
+   an entry only copies it, so this can be used to look at a running domain's
+   cache */
+static uint32_t dc_cached (struct ddsi_discovery_cache *dc, int n, const ddsi_guid_t *guids)
+{
+  struct dc_collect arg = { 0, 0, NULL };
+  uint32_t mask = 0;
+  ddsi_discovery_cache_restore (dc, dc_collect_cb, &arg);
+  for (int i = 0; i < n; i++)
+    if (dc_collect_contains (&arg, &guids[i]))
+      mask |= 1u << i;
+  ddsrt_free (arg.guids);
+  return mask;
+}
+
+static bool dc_wait_cached (struct ddsi_discovery_cache *dc, int n, const ddsi_guid_t *guids, uint32_t expected)
+{
+  const dds_time_t tend = dds_time () + DC_TIMEOUT;
+  uint32_t mask;
+  while ((mask = dc_cached (dc, n, guids)) != expected && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (10));
+  return mask == expected;
+}
+
+/* Bit mask of the proxies for (participant, writer, reader) that exist in gv */
+static uint32_t dc_proxies (struct ddsi_domaingv *gv, const ddsi_guid_t guids[3])
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  uint32_t mask = 0;
+  thread_state_awake (ts1, gv);
+  if (entidx_lookup_proxy_participant_guid (gv->entity_index, &guids[0]))
+    mask |= 1;
+  if (entidx_lookup_proxy_writer_guid (gv->entity_index, &guids[1]))
+    mask |= 2;
+  if (entidx_lookup_proxy_reader_guid (gv->entity_index, &guids[2]))
+    mask |= 4;
+  thread_state_asleep (ts1);
+  return mask;
+}
+
+/* Creates domain A with a participant, writer and reader, and waits until
+   domain B has recorded them in its cache */
+static dds_entity_t dc_create_remote (dds_entity_t pp_b, ddsi_guid_t guids[3], dds_entity_t *wr_out)
+{
+  char topicname[100];
+  const dds_entity_t pp_a = dc_create_domain (DC_DOMAINID_A, "", "1 hr");
+  const dds_entity_t tp = dds_create_topic (pp_a, &Space_Type1_desc, create_unique_topic_name ("ddsc_discovery_cache", topicname, sizeof (topicname)), NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  const dds_entity_t wr = dds_create_writer (pp_a, tp, NULL, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  const dds_entity_t rd = dds_create_reader (pp_a, tp, NULL, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  guids[0] = dc_get_guid (pp_a);
+  guids[1] = dc_get_guid (wr);
+  guids[2] = dc_get_guid (rd);
+  if (wr_out)
+    *wr_out = wr;
+  struct ddsi_domaingv * const gv_b = dc_get_domaingv (pp_b);
+  CU_ASSERT_FATAL (gv_b->discovery_cache != NULL);
+  CU_ASSERT_FATAL (dc_wait_cached (gv_b->discovery_cache, 3, guids, 7));
+  return pp_a;
+}
+
+static unsigned char *dc_read (const char *name, size_t *size)
+{
+  DDSRT_WARNING_MSVC_OFF(4996);
+  FILE *fp = fopen (name, "rb");
+  CU_ASSERT_FATAL (fp != NULL);
+  (void) fseek (fp, 0, SEEK_END);
+  const long n = ftell (fp);
+  CU_ASSERT_FATAL (n > 0);
+  (void) fseek (fp, 0, SEEK_SET);
+  unsigned char *buf = ddsrt_malloc ((size_t) n);
+  CU_ASSERT_FATAL (fread (buf, 1, (size_t) n, fp) == (size_t) n);
+  (void) fclose (fp);
+  *size = (size_t) n;
+  return buf;
+  DDSRT_WARNING_MSVC_ON(4996);
+}
+
+static void dc_write (const char *name, const unsigned char *buf, size_t size)
+{
+  DDSRT_WARNING_MSVC_OFF(4996);
+  FILE *fp = fopen (name, "wb");
+  CU_ASSERT_FATAL (fp != NULL);
+  CU_ASSERT_FATAL (fwrite (buf, 1, size, fp) == size);
+  CU_ASSERT_FATAL (fclose (fp) == 0);
+  DDSRT_WARNING_MSVC_ON(4996);
+}
+
+/* Loads buf as a cache file in a new cache for gv and returns the number of
+   entries that would be restored; gv must not have a cache of its own, or it
+   might write its file while the name is temporarily replaced */
+static uint32_t dc_load (struct ddsi_domaingv *gv, char *name, const unsigned char *buf, size_t size)
+{
+  struct dc_collect arg = { 0, 0, NULL };
+  char * const orig_name = gv->config.discovery_cache_file;
+  dc_write (name, buf, size);
+  gv->config.discovery_cache_file = name;
+  struct ddsi_discovery_cache *dc = ddsi_discovery_cache_new (gv);
+  gv->config.discovery_cache_file = orig_name;
+  ddsi_discovery_cache_restore (dc, dc_collect_cb, &arg);
+  ddsi_discovery_cache_stop (dc);
+  ddsi_discovery_cache_free (dc);
+  ddsrt_free (arg.guids);
+  return arg.n;
+}
+
+CU_Test(ddsc_discovery_cache, read_file, .init = dc_init, .fini = dc_fini)
+{
+  const dds_entity_t pp_b = dc_create_domain (DC_DOMAINID_B, dc_file, "1 hr");
+  ddsi_guid_t guids[3];
+  const dds_entity_t pp_a = dc_create_remote (pp_b, guids, NULL);
+  ddsi_discovery_cache_write (dc_get_domaingv (pp_b)->discovery_cache);
+  struct ddsi_domaingv * const gv = dc_get_domaingv (pp_a);
+  CU_ASSERT_FATAL (gv->discovery_cache == NULL);
+
+  /* The header is magic, version, count and padding; other participants on
+     the network may also be in the file, so use the count it contains */
+  size_t size;
+  unsigned char * const orig = dc_read (dc_file, &size);
+  unsigned char * const buf = ddsrt_malloc (size);
+  char *name;
+  uint32_t count;
+  CU_ASSERT_FATAL (size >= 16);
+  memcpy (&count, orig + 8, sizeof (count));
+  CU_ASSERT_FATAL (count >= 3);
+  ddsrt_asprintf (&name, "%s.test", dc_file);
+  CU_ASSERT_FATAL (dc_load (gv, name, orig, size) == count);
+
+  /* Truncated files: everything up to the first incomplete record is used,
+     any truncation that cuts off data of the last record loses it */
+  uint32_t prev = 0;
+  for (size_t n = 0; n < size; n++)
+  {
+    const uint32_t m = dc_load (gv, name, orig, n);
+    CU_ASSERT (n > 16 || m == 0);
+    CU_ASSERT (m >= prev);
+    CU_ASSERT (n + 8 > size || m < count);
+    prev = m;
+  }
+
+  /* Corrupted headers */
+  memcpy (buf, orig, size);
+  buf[0] ^= 1;
+  CU_ASSERT (dc_load (gv, name, buf, size) == 0);
+  memcpy (buf, orig, size);
+  buf[4] ^= 1;
+  CU_ASSERT (dc_load (gv, name, buf, size) == 0);
+  {
+    const uint32_t more = count + 1, none = 0;
+    memcpy (buf, orig, size);
+    memcpy (buf + 8, &more, sizeof (more));
+    CU_ASSERT (dc_load (gv, name, buf, size) == count);
+    memcpy (buf + 8, &none, sizeof (none));
+    CU_ASSERT (dc_load (gv, name, buf, size) == 0);
+  }
+
+  /* Corrupt each byte in turn: the kind, size and identifying fields of the
+     records must not cause trouble, and it can never result in more entries */
+  for (size_t i = 0; i < size; i++)
+  {
+    memcpy (buf, orig, size);
+    buf[i] ^= 0xff;
+    CU_ASSERT (dc_load (gv, name, buf, size) <= count);
+  }
+
+  /* A missing file is not an error */
+  DDSRT_WARNING_MSVC_OFF(4996);
+  (void) remove (name);
+  DDSRT_WARNING_MSVC_ON(4996);
+  {
+    struct dc_collect arg = { 0, 0, NULL };
+    char * const orig_name = gv->config.discovery_cache_file;
+    gv->config.discovery_cache_file = name;
+    struct ddsi_discovery_cache *dc = ddsi_discovery_cache_new (gv);
+    gv->config.discovery_cache_file = orig_name;
+    ddsi_discovery_cache_restore (dc, dc_collect_cb, &arg);
+    CU_ASSERT (arg.n == 0);
+    ddsi_discovery_cache_stop (dc);
+    ddsi_discovery_cache_free (dc);
+  }
+
+  ddsrt_free (name);
+  ddsrt_free (buf);
+  ddsrt_free (orig);
+  dds_return_t rc = dds_delete (DDS_CYCLONEDDS_HANDLE);
+  CU_ASSERT_FATAL (rc == 0);
+}
+
+CU_Test(ddsc_discovery_cache, restore_and_expire, .init = dc_init, .fini = dc_fini)
+{
+  dds_entity_t pp_b = dc_create_domain (DC_DOMAINID_B, dc_file, "1 hr");
+  ddsi_guid_t guids[3];
+  const dds_entity_t pp_a = dc_create_remote (pp_b, guids, NULL);
+  CU_ASSERT (dc_proxies (dc_get_domaingv (pp_b), guids) == 7);
+
+  /* Stopping B writes the file, stopping A after that doesn't remove it */
+  dds_return_t rc = dds_delete (dds_get_parent (pp_b));
+  CU_ASSERT_FATAL (rc == 0);
+  rc = dds_delete (dds_get_parent (pp_a));
+  CU_ASSERT_FATAL (rc == 0);
+
+  /* The temporary file is per process and gone once the cache is written */
+  {
+    char *tmpname;
+    ddsrt_asprintf (&tmpname, "%s.%"PRIdPID".tmp", dc_file, ddsrt_getpid ());
+    DDSRT_WARNING_MSVC_OFF(4996);
+    FILE *fp = fopen (tmpname, "rb");
+    DDSRT_WARNING_MSVC_ON(4996);
+    CU_ASSERT (fp == NULL);
+    if (fp)
+      (void) fclose (fp);
+    ddsrt_free (tmpname);
+  }
+
+  /* On restart the proxies exist as soon as the domain does, even though A
+     is gone */
+  pp_b = dc_create_domain (DC_DOMAINID_B, dc_file, "1 hr");
+  struct ddsi_domaingv * const gv = dc_get_domaingv (pp_b);
+  CU_ASSERT (dc_proxies (gv, guids) == 7);
+
+  /* A's lease is 2s and it doesn't renew it, so they disappear again */
+  const dds_time_t tend = dds_time () + DC_TIMEOUT;
+  while (dc_proxies (gv, guids) != 0 && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (100));
+  CU_ASSERT (dc_proxies (gv, guids) == 0);
+
+  rc = dds_delete (DDS_CYCLONEDDS_HANDLE);
+  CU_ASSERT_FATAL (rc == 0);
+}
+
+CU_Test(ddsc_discovery_cache, max_age, .init = dc_init, .fini = dc_fini)
+{
+  dds_entity_t pp_b = dc_create_domain (DC_DOMAINID_B, dc_file, "1 s");
+  ddsi_guid_t guids[3];
+  const dds_entity_t pp_a = dc_create_remote (pp_b, guids, NULL);
+
+  dds_return_t rc = dds_delete (dds_get_parent (pp_b));
+  CU_ASSERT_FATAL (rc == 0);
+  rc = dds_delete (dds_get_parent (pp_a));
+  CU_ASSERT_FATAL (rc == 0);
+  dds_sleepfor (DDS_MSECS (1500));
+
+  /* A was last seen more than CacheMaxAge ago: nothing gets restored and the
+     entries are dropped from the cache */
+  pp_b = dc_create_domain (DC_DOMAINID_B, dc_file, "1 s");
+  struct ddsi_domaingv * const gv = dc_get_domaingv (pp_b);
+  CU_ASSERT (dc_proxies (gv, guids) == 0);
+  CU_ASSERT (dc_cached (gv->discovery_cache, 3, guids) == 0);
+
+  rc = dds_delete (DDS_CYCLONEDDS_HANDLE);
+  CU_ASSERT_FATAL (rc == 0);
+}
+
+CU_Test(ddsc_discovery_cache, dispose, .init = dc_init, .fini = dc_fini)
+{
+  const dds_entity_t pp_b = dc_create_domain (DC_DOMAINID_B, dc_file, "1 hr");
+  struct ddsi_domaingv * const gv = dc_get_domaingv (pp_b);
+  ddsi_guid_t guids[3];
+  dds_entity_t wr;
+  const dds_entity_t pp_a = dc_create_remote (pp_b, guids, &wr);
+
+  /* Deleting the writer removes only the writer */
+  dds_return_t rc = dds_delete (wr);
+  CU_ASSERT_FATAL (rc == 0);
+  CU_ASSERT (dc_wait_cached (gv->discovery_cache, 3, guids, 5));
+
+  /* Deleting the participant removes it, and its reader goes with it */
+  rc = dds_delete (dds_get_parent (pp_a));
+  CU_ASSERT_FATAL (rc == 0);
+  CU_ASSERT (dc_wait_cached (gv->discovery_cache, 3, guids, 0));
+  CU_ASSERT (dc_proxies (gv, guids) == 0);
+
+  rc = dds_delete (DDS_CYCLONEDDS_HANDLE);
+  CU_ASSERT_FATAL (rc == 0);
+}
@@ -0,0 +1,272 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_xevent.h"
+#include "dds/ddsi/q_ddsi_discovery.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+/* Two domains with the same port numbers, so they see each other, each with
+   several participants that have a reader for the data written in the other
+   domain and a writer for the data read in the other domain.  The test makes
+   the domains deaf and waits for leases to expire, so it uses port numbers of
+   its own rather than those of domain 0 that the other multi-domain tests use,
+   with a different pair for each test so they can run in parallel */
+#define XT_DOMAINID_A 1
+#define XT_DOMAINID_B 2
+#define XT_EXT_DOMAINID_EVENT 201
+#define XT_EXT_DOMAINID_DISCOVERY 202
+
+#ifdef DDS_HAS_SHM
+#define XT_CONFIG_SHM "<Domain id=\"any\"><SharedMemory><Enable>false</Enable></SharedMemory></Domain>"
+#else
+#define XT_CONFIG_SHM ""
+#endif
+#define XT_CONFIG "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>%d</ExternalDomainId></Discovery><Internal><EventThreads>%d</EventThreads><DiscoveryThreads>%d</DiscoveryThreads><LeaseDuration>2 s</LeaseDuration></Internal>" XT_CONFIG_SHM
+
+#define XT_NPP 8
+#define XT_NSAMPLES 10
+#define XT_NTHREADS 8
+#define XT_TIMEOUT DDS_SECS (10)
+
+struct xt_domain {
+  dds_entity_t pp[XT_NPP];
+  dds_entity_t rd[XT_NPP];
+  dds_entity_t wr[XT_NPP];
+};
+
+static void xt_create_domain (struct xt_domain *d, dds_domainid_t domid, int ext_domid, int event_threads, int discovery_threads, const char *rd_topic, const char *wr_topic)
+{
+  char *config, *xconfig;
+  ddsrt_asprintf (&config, XT_CONFIG, ext_domid, event_threads, discovery_threads);
+  xconfig = ddsrt_expand_envvars (config, domid);
+  const dds_entity_t dom = dds_create_domain (domid, xconfig);
+  CU_ASSERT_FATAL (dom > 0);
+  ddsrt_free (xconfig);
+  ddsrt_free (config);
+
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  for (int i = 0; i < XT_NPP; i++)
+  {
+    d->pp[i] = dds_create_participant (domid, NULL, NULL);
+    CU_ASSERT_FATAL (d->pp[i] > 0);
+    const dds_entity_t rd_tp = dds_create_topic (d->pp[i], &Space_Type1_desc, rd_topic, NULL, NULL);
+    CU_ASSERT_FATAL (rd_tp > 0);
+    const dds_entity_t wr_tp = dds_create_topic (d->pp[i], &Space_Type1_desc, wr_topic, NULL, NULL);
+    CU_ASSERT_FATAL (wr_tp > 0);
+    d->rd[i] = dds_create_reader (d->pp[i], rd_tp, qos, NULL);
+    CU_ASSERT_FATAL (d->rd[i] > 0);
+    d->wr[i] = dds_create_writer (d->pp[i], wr_tp, qos, NULL);
+    CU_ASSERT_FATAL (d->wr[i] > 0);
+  }
+  dds_delete_qos (qos);
+}
+
+static struct ddsi_domaingv *xt_get_domaingv (dds_entity_t handle)
+{
+  struct dds_entity *x;
+  dds_return_t rc = dds_entity_pin (handle, &x);
+  CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+  struct ddsi_domaingv * const gv = &x->m_domain->gv;
+  dds_entity_unpin (x);
+  return gv;
+}
+
+static ddsi_guid_t xt_get_guid (dds_entity_t handle)
+{
+  struct dds_entity *x;
+  dds_return_t rc = dds_entity_pin (handle, &x);
+  CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+  const ddsi_guid_t guid = x->m_guid;
+  dds_entity_unpin (x);
+  return guid;
+}
+
+static bool xt_matched (const struct xt_domain *d, uint32_t n)
+{
+  for (int i = 0; i < XT_NPP; i++)
+  {
+    dds_publication_matched_status_t pm;
+    dds_subscription_matched_status_t sm;
+    dds_return_t rc;
+    rc = dds_get_publication_matched_status (d->wr[i], &pm);
+    CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+    rc = dds_get_subscription_matched_status (d->rd[i], &sm);
+    CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+    if (pm.current_count != n || sm.current_count != n)
+      return false;
+  }
+  return true;
+}
+
+static bool xt_wait_matched (const struct xt_domain *d, uint32_t n)
+{
+  const dds_time_t tend = dds_time () + XT_TIMEOUT;
+  bool m;
+  while (!(m = xt_matched (d, n)) && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (10));
+  return m;
+}
+
+/* Writes XT_NSAMPLES samples with each writer while the receiving domain is deaf,
+   so that all of them have to be recovered via heartbeats and acknacks once it can
+   hear again, then checks that each reader receives all of them exactly once and
+   that the writers get all of them acknowledged */
+static void xt_check_delivery (const struct xt_domain *src, const struct xt_domain *dst)
+{
+  dds_return_t rc;
+  rc = dds_domain_set_deafmute (dst->pp[0], true, false, DDS_INFINITY);
+  CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+  for (int32_t i = 0; i < XT_NPP; i++)
+  {
+    for (int32_t j = 0; j < XT_NSAMPLES; j++)
+    {
+      Space_Type1 sample = { i, j, 0 };
+      rc = dds_write (src->wr[i], &sample);
+      CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+    }
+  }
+  dds_sleepfor (DDS_MSECS (200));
+  rc = dds_domain_set_deafmute (dst->pp[0], false, false, DDS_INFINITY);
+  CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+
+  for (int k = 0; k < XT_NPP; k++)
+  {
+    bool seen[XT_NPP][XT_NSAMPLES];
+    int nseen = 0;
+    memset (seen, 0, sizeof (seen));
+    const dds_time_t tend = dds_time () + XT_TIMEOUT;
+    while (nseen < XT_NPP * XT_NSAMPLES && dds_time () < tend)
+    {
+      Space_Type1 sample;
+      void *raw = &sample;
+      dds_sample_info_t si;
+      while ((rc = dds_take (dst->rd[k], &raw, &si, 1, 1)) == 1)
+      {
+        if (!si.valid_data)
+          continue;
+        CU_ASSERT_FATAL (sample.long_1 >= 0 && sample.long_1 < XT_NPP);
+        CU_ASSERT_FATAL (sample.long_2 >= 0 && sample.long_2 < XT_NSAMPLES);
+        CU_ASSERT_FATAL (!seen[sample.long_1][sample.long_2]);
+        seen[sample.long_1][sample.long_2] = true;
+        nseen++;
+      }
+      CU_ASSERT_FATAL (rc == 0);
+      if (nseen < XT_NPP * XT_NSAMPLES)
+        dds_sleepfor (DDS_MSECS (10));
+    }
+    CU_ASSERT_FATAL (nseen == XT_NPP * XT_NSAMPLES);
+  }
+
+  for (int i = 0; i < XT_NPP; i++)
+  {
+    rc = dds_wait_for_acks (src->wr[i], XT_TIMEOUT);
+    CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+  }
+}
+
+static uint32_t xt_count_distinct (const void * const *ps, int n)
+{
+  uint32_t m = 0;
+  for (int i = 0; i < n; i++)
+  {
+    int j = 0;
+    while (j < i && ps[j] != ps[i])
+      j++;
+    if (j == i)
+      m++;
+  }
+  return m;
+}
+
+static uint32_t xt_count_xeventqs (const struct ddsi_domaingv *gv, const dds_entity_t *handles)
+{
+  const void *qs[XT_NPP];
+  for (int i = 0; i < XT_NPP; i++)
+  {
+    const ddsi_guid_t guid = xt_get_guid (handles[i]);
+    qs[i] = xeventq_for_guid (gv, &guid);
+  }
+  return xt_count_distinct (qs, XT_NPP);
+}
+
+static uint32_t xt_count_dqueues (const struct ddsi_domaingv *gv, const dds_entity_t *handles)
+{
+  const void *qs[XT_NPP];
+  for (int i = 0; i < XT_NPP; i++)
+  {
+    const ddsi_guid_t guid = xt_get_guid (handles[i]);
+    qs[i] = builtins_dqueue_for_prefix (gv, &guid.prefix);
+  }
+  return xt_count_distinct (qs, XT_NPP);
+}
+
+static void xt_run (int ext_domid, int event_threads, int discovery_threads)
+{
+  char topic_ab[100], topic_ba[100];
+  struct xt_domain a, b;
+  create_unique_topic_name ("ddsc_extra_threads_ab", topic_ab, sizeof (topic_ab));
+  create_unique_topic_name ("ddsc_extra_threads_ba", topic_ba, sizeof (topic_ba));
+  xt_create_domain (&a, XT_DOMAINID_A, ext_domid, event_threads, discovery_threads, topic_ba, topic_ab);
+  xt_create_domain (&b, XT_DOMAINID_B, ext_domid, event_threads, discovery_threads, topic_ab, topic_ba);
+
+  /* discovery: every reader matches all writers in the other domain, and vice versa */
+  CU_ASSERT_FATAL (xt_wait_matched (&a, XT_NPP));
+  CU_ASSERT_FATAL (xt_wait_matched (&b, XT_NPP));
+
+  const struct ddsi_domaingv *gv_a = xt_get_domaingv (a.pp[0]);
+  if (event_threads > 1)
+  {
+    /* the writers' heartbeats and the proxy writers' acknacks are spread over the
+       event queues; the (proxy) writers in A have the same GUIDs as the writers */
+    CU_ASSERT_FATAL (gv_a->n_xevents_extra == (uint32_t) event_threads - 1);
+    CU_ASSERT_FATAL (xt_count_xeventqs (gv_a, a.wr) > 1);
+    CU_ASSERT_FATAL (xt_count_xeventqs (gv_a, b.wr) > 1);
+  }
+  if (discovery_threads > 1)
+  {
+    /* the discovery data of the participants in B is spread over the delivery queues */
+    CU_ASSERT_FATAL (gv_a->n_builtins_dqueues_extra == (uint32_t) discovery_threads - 1);
+    CU_ASSERT_FATAL (xt_count_dqueues (gv_a, b.pp) > 1);
+  }
+
+  /* reliable delivery after loss in both directions */
+  xt_check_delivery (&a, &b);
+  xt_check_delivery (&b, &a);
+
+  /* leases: once B goes silent, A must notice its participants' leases expiring */
+  dds_return_t rc = dds_domain_set_deafmute (b.pp[0], true, true, DDS_INFINITY);
+  CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (xt_wait_matched (&a, 0));
+
+  rc = dds_delete (DDS_CYCLONEDDS_HANDLE);
+  CU_ASSERT_FATAL (rc == 0);
+}
+
+CU_Test(ddsc_extra_threads, event_threads, .timeout = 30)
+{
+  xt_run (XT_EXT_DOMAINID_EVENT, XT_NTHREADS, 1);
+}
+
+CU_Test(ddsc_extra_threads, discovery_threads, .timeout = 30)
+{
+  xt_run (XT_EXT_DOMAINID_DISCOVERY, 1, XT_NTHREADS);
+}
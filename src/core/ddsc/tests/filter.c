@@ -26,12 +26,16 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "dds/dds.h"
 #include "dds/ddsrt/misc.h"
 #include "dds/ddsrt/attributes.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
 
 #include "test_common.h"
+#include "RoundTrip.h"
 
 #define MAXSAMPLES 20
 
@@ -769,3 +773,357 @@ CU_Test (ddsc_filter, sampleinfo)
   dds_delete (dp);
 }
 
+
+static bool content_filter_long2_eq (const void *vsample, const char *expression, uint32_t nparams, const char * const *params, void *arg)
+{
+  Space_Type1 const * const sample = vsample;
+  (void) arg;
+  CU_ASSERT_FATAL (strcmp (expression, "long_2 = %0") == 0);
+  CU_ASSERT_FATAL (nparams == 1);
+  return sample->long_2 == atoi (params[0]);
+}
+
+CU_Test (ddsc_filter, content_filter_remote)
+{
+  /* Different domain ids mapping to the same port numbers, so the writer in one
+     domain evaluates the filter advertised by the reader in the other */
+  const char *config = "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>";
+  char *pub_conf = ddsrt_expand_envvars (config, 0);
+  char *sub_conf = ddsrt_expand_envvars (config, 1);
+  const dds_entity_t pub_dom = dds_create_domain (0, pub_conf);
+  CU_ASSERT_FATAL (pub_dom > 0);
+  const dds_entity_t sub_dom = dds_create_domain (1, sub_conf);
+  CU_ASSERT_FATAL (sub_dom > 0);
+  ddsrt_free (pub_conf);
+  ddsrt_free (sub_conf);
+
+  dds_return_t ret;
+  ret = dds_register_content_filter (pub_dom, "long2", content_filter_long2_eq, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_register_content_filter (pub_dom, "long2", content_filter_long2_eq, NULL);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_PRECONDITION_NOT_MET);
+  ret = dds_register_content_filter (sub_dom, "long2", content_filter_long2_eq, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_filter", topicname, sizeof (topicname));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t pub_dp = dds_create_participant (0, NULL, NULL);
+  CU_ASSERT_FATAL (pub_dp > 0);
+  const dds_entity_t pub_tp = dds_create_topic (pub_dp, &Space_Type1_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+
+  // reliable filtered, best-effort filtered and best-effort unfiltered readers,
+  // each in its own participant because data is addressed to participants, but
+  // sharing a proxy writer because they are in the same domain instance
+  enum { RD_REL, RD_BE, RD_BE_UNF, NRDS }; // RD_BE_UNF must be last
+  dds_entity_t sub_dp[NRDS], sub_tp[NRDS], rd[NRDS];
+  const char *params[] = { "1" };
+  for (int k = 0; k < NRDS; k++)
+  {
+    sub_dp[k] = dds_create_participant (1, NULL, NULL);
+    CU_ASSERT_FATAL (sub_dp[k] > 0);
+    sub_tp[k] = dds_create_topic (sub_dp[k], &Space_Type1_desc, topicname, qos, NULL);
+    CU_ASSERT_FATAL (sub_tp[k] > 0);
+  }
+  ret = dds_set_topic_content_filter (sub_tp[RD_REL], "unknown", "long_2 = %0", 1, params);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_PRECONDITION_NOT_MET);
+  ret = dds_set_topic_content_filter (sub_tp[RD_REL], "long2", "long_2 = %0", 1, params);
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_set_topic_content_filter (sub_tp[RD_REL], "long2", "long_2 = %0", 1, params);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_PRECONDITION_NOT_MET);
+  ret = dds_set_topic_content_filter (sub_tp[RD_BE], "long2", "long_2 = %0", 1, params);
+  CU_ASSERT_FATAL (ret == 0);
+
+  for (int k = 0; k < NRDS; k++)
+  {
+    dds_qset_reliability (qos, (k == RD_REL) ? DDS_RELIABILITY_RELIABLE : DDS_RELIABILITY_BEST_EFFORT, DDS_INFINITY);
+    rd[k] = dds_create_reader (sub_dp[k], sub_tp[k], qos, NULL);
+    CU_ASSERT_FATAL (rd[k] > 0);
+  }
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  const dds_entity_t wr = dds_create_writer (pub_dp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  dds_time_t tend = dds_time () + DDS_SECS (10);
+  dds_publication_matched_status_t pm;
+  dds_subscription_matched_status_t sm[NRDS];
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+    ret = dds_get_publication_matched_status (wr, &pm);
+    CU_ASSERT_FATAL (ret == 0);
+    for (int k = 0; k < NRDS; k++)
+    {
+      ret = dds_get_subscription_matched_status (rd[k], &sm[k]);
+      CU_ASSERT_FATAL (ret == 0);
+    }
+  } while (!(pm.current_count == NRDS && sm[RD_REL].current_count == 1 && sm[RD_BE].current_count == 1 && sm[RD_BE_UNF].current_count == 1) && dds_time () < tend);
+  CU_ASSERT_FATAL (pm.current_count == NRDS);
+
+  // alternate rejected and accepted samples, ending with an accepted one: the
+  // rejected ones are replaced by GAPs and mustn't stall delivery of the others
+  for (int i = 0; i < 4; i++)
+  {
+    ret = dds_write (wr, &(Space_Type1){i,2,0});
+    CU_ASSERT_FATAL (ret == 0);
+    ret = dds_write (wr, &(Space_Type1){i,1,0});
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  // best-effort data can in principle be lost, but not in this test
+  const int nexp[NRDS] = { [RD_REL] = 4, [RD_BE] = 4, [RD_BE_UNF] = 8 };
+  for (int k = 0; k < NRDS; k++)
+  {
+    Space_Type1 data[MAXSAMPLES];
+    void *raw[MAXSAMPLES];
+    dds_sample_info_t si[MAXSAMPLES];
+    for (int i = 0; i < MAXSAMPLES; i++)
+      raw[i] = &data[i];
+    while (dds_read (rd[k], raw, si, MAXSAMPLES, MAXSAMPLES) < nexp[k] && dds_time () < tend)
+      dds_sleepfor (DDS_MSECS (10));
+  }
+
+  const struct exp exp = {
+    .n = 4, .xs = (const Space_Type1[]) {
+      {0,1,0}, {1,1,0}, {2,1,0}, {3,1,0}
+    }
+  };
+  const struct exp exp_unf = {
+    .n = 8, .xs = (const Space_Type1[]) {
+      {0,1,0}, {0,2,0}, {1,1,0}, {1,2,0}, {2,1,0}, {2,2,0}, {3,1,0}, {3,2,0}
+    }
+  };
+  checkdata (rd[RD_REL], &exp, "rd reliable");
+  checkdata (rd[RD_BE], &exp, "rd best-effort");
+  checkdata (rd[RD_BE_UNF], &exp_unf, "rd best-effort unfiltered");
+
+  // without the unfiltered reader, the rejected samples become GAPs
+  ret = dds_delete (sub_dp[RD_BE_UNF]);
+  CU_ASSERT_FATAL (ret == 0);
+  tend = dds_time () + DDS_SECS (10);
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+    ret = dds_get_publication_matched_status (wr, &pm);
+    CU_ASSERT_FATAL (ret == 0);
+  } while (pm.current_count != NRDS - 1 && dds_time () < tend);
+  CU_ASSERT_FATAL (pm.current_count == NRDS - 1);
+  for (int i = 0; i < 4; i++)
+  {
+    ret = dds_write (wr, &(Space_Type1){i,2,0});
+    CU_ASSERT_FATAL (ret == 0);
+    ret = dds_write (wr, &(Space_Type1){i,1,0});
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  for (int k = 0; k < RD_BE_UNF; k++)
+  {
+    Space_Type1 data[MAXSAMPLES];
+    void *raw[MAXSAMPLES];
+    dds_sample_info_t si[MAXSAMPLES];
+    for (int i = 0; i < MAXSAMPLES; i++)
+      raw[i] = &data[i];
+    while (dds_read (rd[k], raw, si, MAXSAMPLES, MAXSAMPLES) < nexp[k] && dds_time () < tend)
+      dds_sleepfor (DDS_MSECS (10));
+  }
+  checkdata (rd[RD_REL], &exp, "rd reliable");
+  checkdata (rd[RD_BE], &exp, "rd best-effort");
+
+  ret = dds_delete (pub_dom);
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_delete (sub_dom);
+  CU_ASSERT_FATAL (ret == 0);
+}
+
+static bool content_filter_payload0_eq (const void *vsample, const char *expression, uint32_t nparams, const char * const *params, void *arg)
+{
+  RoundTripModule_DataType const * const sample = vsample;
+  (void) expression;
+  (void) arg;
+  CU_ASSERT_FATAL (nparams == 1);
+  return sample->payload._length > 0 && sample->payload._buffer[0] == atoi (params[0]);
+}
+
+CU_Test (ddsc_filter, content_filter_remote_scattered)
+{
+  /* A best-effort writer doesn't store the sample in its WHC, so with a payload
+     larger than ScatterGatherMinSize the serdata still references the application's
+     sample when the filter is evaluated */
+  const char *config = "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery><Internal><ScatterGatherMinSize>64 B</ScatterGatherMinSize></Internal>";
+  char *pub_conf = ddsrt_expand_envvars (config, 0);
+  char *sub_conf = ddsrt_expand_envvars (config, 1);
+  const dds_entity_t pub_dom = dds_create_domain (0, pub_conf);
+  CU_ASSERT_FATAL (pub_dom > 0);
+  const dds_entity_t sub_dom = dds_create_domain (1, sub_conf);
+  CU_ASSERT_FATAL (sub_dom > 0);
+  ddsrt_free (pub_conf);
+  ddsrt_free (sub_conf);
+
+  dds_return_t ret;
+  ret = dds_register_content_filter (pub_dom, "payload0", content_filter_payload0_eq, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_register_content_filter (sub_dom, "payload0", content_filter_payload0_eq, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_filter", topicname, sizeof (topicname));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_BEST_EFFORT, 0);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t pub_dp = dds_create_participant (0, NULL, NULL);
+  CU_ASSERT_FATAL (pub_dp > 0);
+  const dds_entity_t pub_tp = dds_create_topic (pub_dp, &RoundTripModule_DataType_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_dp = dds_create_participant (1, NULL, NULL);
+  CU_ASSERT_FATAL (sub_dp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_dp, &RoundTripModule_DataType_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  const char *params[] = { "1" };
+  ret = dds_set_topic_content_filter (sub_tp, "payload0", "payload[0] = %0", 1, params);
+  CU_ASSERT_FATAL (ret == 0);
+  const dds_entity_t rd = dds_create_reader (sub_dp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pub_dp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  dds_time_t tend = dds_time () + DDS_SECS (10);
+  dds_publication_matched_status_t pm;
+  dds_subscription_matched_status_t sm;
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+    ret = dds_get_publication_matched_status (wr, &pm);
+    CU_ASSERT_FATAL (ret == 0);
+    ret = dds_get_subscription_matched_status (rd, &sm);
+    CU_ASSERT_FATAL (ret == 0);
+  } while (!(pm.current_count == 1 && sm.current_count == 1) && dds_time () < tend);
+  CU_ASSERT_FATAL (pm.current_count == 1 && sm.current_count == 1);
+
+  // payload[0] alternates between rejected and accepted values, the remainder
+  // identifies the sample
+  uint8_t payload[1000];
+  RoundTripModule_DataType sample = { .payload = { ._length = sizeof (payload), ._maximum = sizeof (payload), ._buffer = payload, ._release = false } };
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    memset (payload, i, sizeof (payload));
+    payload[0] = i % 2;
+    ret = dds_write (wr, &sample);
+    CU_ASSERT_FATAL (ret == 0);
+  }
+
+  // best-effort data can in principle be lost, but not in this test
+  RoundTripModule_DataType data[MAXSAMPLES];
+  void *raw[MAXSAMPLES];
+  dds_sample_info_t si[MAXSAMPLES];
+  memset (data, 0, sizeof (data));
+  for (int i = 0; i < MAXSAMPLES; i++)
+    raw[i] = &data[i];
+  while (dds_read (rd, raw, si, MAXSAMPLES, MAXSAMPLES) < 4 && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (10));
+  int32_t n = dds_take (rd, raw, si, MAXSAMPLES, MAXSAMPLES);
+  CU_ASSERT_FATAL (n == 4);
+  for (int32_t i = 0; i < n; i++)
+  {
+    CU_ASSERT_FATAL (si[i].valid_data);
+    CU_ASSERT_FATAL (data[i].payload._length == sizeof (payload));
+    CU_ASSERT_FATAL (data[i].payload._buffer[0] == 1);
+    for (uint32_t j = 1; j < data[i].payload._length; j++)
+      CU_ASSERT_FATAL (data[i].payload._buffer[j] == 2 * i + 1);
+  }
+  for (int i = 0; i < MAXSAMPLES; i++)
+    dds_sample_free (&data[i], &RoundTripModule_DataType_desc, DDS_FREE_CONTENTS);
+
+  ret = dds_delete (pub_dom);
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_delete (sub_dom);
+  CU_ASSERT_FATAL (ret == 0);
+}
+
+CU_Test (ddsc_filter, content_filter_remote_inline_qos)
+{
+  /* Dispose and unregister are not subject to the filter and rely on the status
+     info in the inline QoS of the DATA submessage */
+  const char *config = "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>";
+  char *pub_conf = ddsrt_expand_envvars (config, 0);
+  char *sub_conf = ddsrt_expand_envvars (config, 1);
+  const dds_entity_t pub_dom = dds_create_domain (0, pub_conf);
+  CU_ASSERT_FATAL (pub_dom > 0);
+  const dds_entity_t sub_dom = dds_create_domain (1, sub_conf);
+  CU_ASSERT_FATAL (sub_dom > 0);
+  ddsrt_free (pub_conf);
+  ddsrt_free (sub_conf);
+
+  dds_return_t ret;
+  ret = dds_register_content_filter (pub_dom, "long2", content_filter_long2_eq, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_register_content_filter (sub_dom, "long2", content_filter_long2_eq, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_filter", topicname, sizeof (topicname));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_writer_data_lifecycle (qos, false);
+  const dds_entity_t pub_dp = dds_create_participant (0, NULL, NULL);
+  CU_ASSERT_FATAL (pub_dp > 0);
+  const dds_entity_t pub_tp = dds_create_topic (pub_dp, &Space_Type1_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_dp = dds_create_participant (1, NULL, NULL);
+  CU_ASSERT_FATAL (sub_dp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_dp, &Space_Type1_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  const char *params[] = { "1" };
+  ret = dds_set_topic_content_filter (sub_tp, "long2", "long_2 = %0", 1, params);
+  CU_ASSERT_FATAL (ret == 0);
+  const dds_entity_t rd = dds_create_reader (sub_dp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pub_dp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  dds_time_t tend = dds_time () + DDS_SECS (10);
+  dds_publication_matched_status_t pm;
+  dds_subscription_matched_status_t sm;
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+    ret = dds_get_publication_matched_status (wr, &pm);
+    CU_ASSERT_FATAL (ret == 0);
+    ret = dds_get_subscription_matched_status (rd, &sm);
+    CU_ASSERT_FATAL (ret == 0);
+  } while (!(pm.current_count == 1 && sm.current_count == 1) && dds_time () < tend);
+  CU_ASSERT_FATAL (pm.current_count == 1 && sm.current_count == 1);
+
+  // instance 1 gets disposed, instance 2 unregistered
+  for (int32_t i = 1; i <= 2; i++)
+  {
+    ret = dds_write (wr, &(Space_Type1){i,1,0});
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  ret = dds_dispose (wr, &(Space_Type1){1,0,0});
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_unregister_instance (wr, &(Space_Type1){2,0,0});
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_wait_for_acks (wr, DDS_SECS (10));
+  CU_ASSERT_FATAL (ret == 0);
+
+  const dds_instance_state_t exp_ist[] = { [1] = DDS_IST_NOT_ALIVE_DISPOSED, [2] = DDS_IST_NOT_ALIVE_NO_WRITERS };
+  Space_Type1 data[MAXSAMPLES];
+  void *raw[MAXSAMPLES];
+  dds_sample_info_t si[MAXSAMPLES];
+  for (int i = 0; i < MAXSAMPLES; i++)
+    raw[i] = &data[i];
+  int32_t n = dds_read (rd, raw, si, MAXSAMPLES, MAXSAMPLES);
+  CU_ASSERT_FATAL (n == 2);
+  for (int32_t i = 0; i < n; i++)
+  {
+    CU_ASSERT_FATAL (si[i].valid_data);
+    CU_ASSERT_FATAL (data[i].long_1 == 1 || data[i].long_1 == 2);
+    CU_ASSERT_FATAL (si[i].instance_state == exp_ist[data[i].long_1]);
+  }
+
+  ret = dds_delete (pub_dom);
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_delete (sub_dom);
+  CU_ASSERT_FATAL (ret == 0);
+}
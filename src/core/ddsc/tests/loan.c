@@ -319,3 +319,256 @@ CU_Test (ddsc_loan, read_cleanup, .init = create_entities, .fini = delete_entiti
   result = dds_return_loan (reader, ptrs, n);
   CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
 }
+
+CU_Test (ddsc_loan, shared)
+{
+  const dds_entity_t dom = dds_create_domain (0, "<Internal><ShareLoanedSamples>true</ShareLoanedSamples></Internal>");
+  CU_ASSERT_FATAL (dom > 0);
+  const dds_entity_t pp = dds_create_participant (0, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  char topicname[100];
+  create_unique_topic_name ("ddsc_loan_shared", topicname, sizeof topicname);
+  const dds_entity_t tp = dds_create_topic (pp, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_writer_data_lifecycle (qos, false);
+  dds_entity_t rds[2];
+  for (int i = 0; i < 2; i++)
+  {
+    rds[i] = dds_create_reader (pp, tp, qos, NULL);
+    CU_ASSERT_FATAL (rds[i] > 0);
+  }
+  const dds_entity_t wr = dds_create_writer (pp, tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  /* rely on things like address sanitizer, valgrind for detecting double frees and leaks */
+  dds_return_t result;
+  int32_t n[2];
+  void *ptrs[2][3] = { { NULL } };
+  dds_sample_info_t si[2][3];
+  for (int32_t k = 1; k <= 2; k++)
+  {
+    result = dds_write (wr, &(Space_Type1){ k, 10 * k, 100 * k });
+    CU_ASSERT_FATAL (result == 0);
+  }
+
+  /* loaned reads from both readers must return the same, deserialized samples */
+  for (int i = 0; i < 2; i++)
+  {
+    n[i] = dds_read (rds[i], ptrs[i], si[i], 3, 3);
+    CU_ASSERT_FATAL (n[i] == 2);
+  }
+  for (int32_t j = 0; j < 2; j++)
+  {
+    const Space_Type1 *s = ptrs[0][j];
+    CU_ASSERT_FATAL (si[0][j].valid_data && si[1][j].valid_data);
+    CU_ASSERT_FATAL (ptrs[0][j] == ptrs[1][j]);
+    CU_ASSERT_FATAL (s->long_1 == j + 1 && s->long_2 == 10 * (j + 1) && s->long_3 == 100 * (j + 1));
+  }
+
+  /* reading through a read condition doesn't share */
+  const dds_entity_t rdcond = dds_create_readcondition (rds[1], DDS_ANY_STATE);
+  CU_ASSERT_FATAL (rdcond > 0);
+  void *cptrs[3] = { NULL };
+  dds_sample_info_t csi[3];
+  int32_t cn = dds_read (rdcond, cptrs, csi, 3, 3);
+  CU_ASSERT_FATAL (cn == 2);
+  CU_ASSERT_FATAL (cptrs[0] != ptrs[1][0] && ((const Space_Type1 *) cptrs[0])->long_1 == 1);
+  result = dds_return_loan (rdcond, cptrs, cn);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+
+  /* taking from one reader doesn't affect the samples loaned out by the other */
+  for (int i = 0; i < 2; i++)
+  {
+    result = dds_return_loan (rds[i], ptrs[i], n[i]);
+    CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+    CU_ASSERT_FATAL (ptrs[i][0] == NULL);
+  }
+  n[1] = dds_read (rds[1], ptrs[1], si[1], 3, 3);
+  CU_ASSERT_FATAL (n[1] == 2);
+  n[0] = dds_take (rds[0], ptrs[0], si[0], 3, 3);
+  CU_ASSERT_FATAL (n[0] == 2);
+  CU_ASSERT_FATAL (ptrs[0][0] == ptrs[1][0] && ptrs[0][1] == ptrs[1][1]);
+  result = dds_return_loan (rds[0], ptrs[0], n[0]);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (((const Space_Type1 *) ptrs[1][1])->long_3 == 200);
+  result = dds_return_loan (rds[1], ptrs[1], n[1]);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+
+  /* invalid samples are mixed in with the shared ones */
+  result = dds_dispose (wr, &(Space_Type1){ 1, 0, 0 });
+  CU_ASSERT_FATAL (result == 0);
+  result = dds_write (wr, &(Space_Type1){ 2, 21, 201 });
+  CU_ASSERT_FATAL (result == 0);
+  n[0] = dds_read (rds[0], ptrs[0], si[0], 3, 3);
+  CU_ASSERT_FATAL (n[0] == 2);
+  for (int32_t j = 0; j < 2; j++)
+  {
+    const Space_Type1 *s = ptrs[0][j];
+    if (s->long_1 == 1)
+    {
+      CU_ASSERT_FATAL (!si[0][j].valid_data && s->long_2 == 0 && s->long_3 == 0);
+    }
+    else
+    {
+      CU_ASSERT_FATAL (si[0][j].valid_data && s->long_1 == 2 && s->long_2 == 21 && s->long_3 == 201);
+    }
+  }
+
+  /* a second loaned read while the loan is out gets its own samples */
+  void *ptrs2[3] = { NULL };
+  int32_t n2 = dds_take (rds[0], ptrs2, si[1], 3, 3);
+  CU_ASSERT_FATAL (n2 == 2);
+  CU_ASSERT_FATAL (ptrs2[0] != ptrs[0][0] && ptrs2[1] != ptrs[0][1]);
+  result = dds_return_loan (rds[0], ptrs2, n2);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_return_loan (rds[0], ptrs[0], n[0]);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+
+  /* leave a loan outstanding on the other reader: deleting it must release it */
+  n[1] = dds_take (rds[1], ptrs[1], si[1], 3, 3);
+  CU_ASSERT_FATAL (n[1] == 3);
+  result = dds_delete (dom);
+  CU_ASSERT_FATAL (result == 0);
+}
+
+CU_Test (ddsc_loan, shared_reuse)
+{
+  const dds_entity_t dom = dds_create_domain (0, "<Internal><ShareLoanedSamples>true</ShareLoanedSamples></Internal>");
+  CU_ASSERT_FATAL (dom > 0);
+  const dds_entity_t pp = dds_create_participant (0, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  char topicname[100];
+  create_unique_topic_name ("ddsc_loan_shared_reuse", topicname, sizeof topicname);
+  const dds_entity_t tp = dds_create_topic (pp, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_entity_t rds[2];
+  for (int i = 0; i < 2; i++)
+  {
+    rds[i] = dds_create_reader (pp, tp, qos, NULL);
+    CU_ASSERT_FATAL (rds[i] > 0);
+  }
+  const dds_entity_t wr = dds_create_writer (pp, tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  dds_return_t result;
+  int32_t n[2];
+  void *ptrs[2][3] = { { NULL } };
+  dds_sample_info_t si[2][3];
+  for (int32_t k = 1; k <= 2; k++)
+  {
+    result = dds_write (wr, &(Space_Type1){ k, 10 * k, 100 * k });
+    CU_ASSERT_FATAL (result == 0);
+  }
+  for (int i = 0; i < 2; i++)
+  {
+    n[i] = dds_read (rds[i], ptrs[i], si[i], 3, 3);
+    CU_ASSERT_FATAL (n[i] == 2);
+  }
+  CU_ASSERT_FATAL (ptrs[0][0] == ptrs[1][0] && ptrs[0][1] == ptrs[1][1]);
+
+  /* passing the buffer of an outstanding shared loan into a read again returns
+     the loan and must not overwrite the samples shared with the other reader */
+  result = dds_write (wr, &(Space_Type1){ 3, 30, 300 });
+  CU_ASSERT_FATAL (result == 0);
+  n[0] = dds_take_mask (rds[0], ptrs[0], si[0], 3, 3, DDS_NOT_READ_SAMPLE_STATE);
+  CU_ASSERT_FATAL (n[0] == 1);
+  CU_ASSERT_FATAL (si[0][0].valid_data);
+  CU_ASSERT_FATAL (((const Space_Type1 *) ptrs[0][0])->long_1 == 3 && ((const Space_Type1 *) ptrs[0][0])->long_3 == 300);
+  for (int32_t j = 0; j < n[1]; j++)
+  {
+    const Space_Type1 *s = ptrs[1][j];
+    CU_ASSERT_FATAL (s->long_1 == j + 1 && s->long_2 == 10 * (j + 1) && s->long_3 == 100 * (j + 1));
+  }
+
+  /* doing it again without data leaves no loan outstanding */
+  n[0] = dds_take_mask (rds[0], ptrs[0], si[0], 3, 3, DDS_NOT_READ_SAMPLE_STATE);
+  CU_ASSERT_FATAL (n[0] == 0);
+  CU_ASSERT_FATAL (ptrs[0][0] == NULL);
+  n[0] = dds_read (rds[0], ptrs[0], si[0], 3, 3);
+  CU_ASSERT_FATAL (n[0] == 2);
+  CU_ASSERT_FATAL (ptrs[0][0] == ptrs[1][0] && ptrs[0][1] == ptrs[1][1]);
+  for (int i = 0; i < 2; i++)
+  {
+    result = dds_return_loan (rds[i], ptrs[i], n[i]);
+    CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  }
+  result = dds_delete (dom);
+  CU_ASSERT_FATAL (result == 0);
+}
+
+CU_Test (ddsc_loan, shared_invalid_first)
+{
+  const dds_entity_t dom = dds_create_domain (0, "<Internal><ShareLoanedSamples>true</ShareLoanedSamples></Internal>");
+  CU_ASSERT_FATAL (dom > 0);
+  const dds_entity_t pp = dds_create_participant (0, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  char topicname[100];
+  create_unique_topic_name ("ddsc_loan_shared_invalid_first", topicname, sizeof topicname);
+  const dds_entity_t tp = dds_create_topic (pp, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_entity_t rds[2];
+  for (int i = 0; i < 2; i++)
+  {
+    rds[i] = dds_create_reader (pp, tp, qos, NULL);
+    CU_ASSERT_FATAL (rds[i] > 0);
+  }
+  const dds_entity_t wr = dds_create_writer (pp, tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  /* disposing an unknown instance gives an invalid sample, it comes first because
+     the instance is older than the one with the valid sample */
+  dds_return_t result;
+  int32_t n[2];
+  void *ptrs[2][3] = { { NULL } };
+  dds_sample_info_t si[2][3];
+  result = dds_dispose (wr, &(Space_Type1){ 1, 0, 0 });
+  CU_ASSERT_FATAL (result == 0);
+  result = dds_write (wr, &(Space_Type1){ 2, 20, 200 });
+  CU_ASSERT_FATAL (result == 0);
+  for (int i = 0; i < 2; i++)
+  {
+    n[i] = dds_read (rds[i], ptrs[i], si[i], 3, 3);
+    CU_ASSERT_FATAL (n[i] == 2);
+    CU_ASSERT_FATAL (!si[i][0].valid_data && si[i][1].valid_data);
+  }
+  CU_ASSERT_FATAL (ptrs[0][0] != ptrs[1][0] && ptrs[0][1] == ptrs[1][1]);
+
+  /* passing the buffer in again must still be recognized as returning the shared
+     loan, rather than taking the new samples into the shared ones */
+  for (int32_t k = 3; k <= 4; k++)
+  {
+    result = dds_write (wr, &(Space_Type1){ k, 10 * k, 100 * k });
+    CU_ASSERT_FATAL (result == 0);
+  }
+  n[0] = dds_take_mask (rds[0], ptrs[0], si[0], 3, 3, DDS_NOT_READ_SAMPLE_STATE);
+  CU_ASSERT_FATAL (n[0] == 2);
+  for (int32_t j = 0; j < n[0]; j++)
+  {
+    const Space_Type1 *s = ptrs[0][j];
+    CU_ASSERT_FATAL (si[0][j].valid_data);
+    CU_ASSERT_FATAL (s->long_1 == j + 3 && s->long_2 == 10 * (j + 3) && s->long_3 == 100 * (j + 3));
+  }
+  CU_ASSERT_FATAL (ptrs[0][0] != ptrs[1][1] && ptrs[0][1] != ptrs[1][1]);
+  const Space_Type1 *s = ptrs[1][1];
+  CU_ASSERT_FATAL (s->long_1 == 2 && s->long_2 == 20 && s->long_3 == 200);
+
+  for (int i = 0; i < 2; i++)
+  {
+    result = dds_return_loan (rds[i], ptrs[i], n[i]);
+    CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  }
+  result = dds_delete (dom);
+  CU_ASSERT_FATAL (result == 0);
+}
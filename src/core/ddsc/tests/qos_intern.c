@@ -0,0 +1,121 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsi/ddsi_xqos.h"
+#include "dds/ddsi/ddsi_qos_intern.h"
+
+#include "test_common.h"
+
+/* More than ddsrt_hh can hold with a single hash value */
+#define QI_N 200
+
+static dds_qos_t *qi_make_qos (int32_t max_samples, dds_duration_t deadline)
+{
+  /* resource limits are not included in the hash, so QoS objects that only differ
+     in those have the same hash */
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_partition1 (qos, "qos_intern");
+  dds_qset_resource_limits (qos, max_samples, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED);
+  dds_qset_deadline (qos, deadline);
+  return qos;
+}
+
+CU_Test(ddsc_qos_intern, same_hash)
+{
+  struct ddsi_qos_intern * const qi = ddsi_qos_intern_new ();
+  dds_qos_t *qos[QI_N];
+  dds_qos_t *ref[QI_N];
+  uint64_t id[QI_N];
+  for (int i = 0; i < QI_N; i++)
+  {
+    qos[i] = qi_make_qos (i + 1, DDS_INFINITY);
+    ref[i] = ddsi_qos_intern_ref (qi, qos[i]);
+    CU_ASSERT_FATAL (ref[i] != NULL);
+    CU_ASSERT_FATAL (ddsi_xqos_delta (ref[i], qos[i], ~(uint64_t)0) == 0);
+    id[i] = ddsi_qos_intern_id (ref[i]);
+    for (int j = 0; j < i; j++)
+    {
+      CU_ASSERT_FATAL (ref[j] != ref[i]);
+      CU_ASSERT_FATAL (id[j] != id[i]);
+    }
+  }
+
+  /* a second reference to an equal QoS object gets the same one */
+  for (int i = 0; i < QI_N; i++)
+    CU_ASSERT_FATAL (ddsi_qos_intern_ref (qi, qos[i]) == ref[i]);
+
+  /* dropping both references to every other one removes those from the chains,
+     and leaves the others in place */
+  for (int i = 0; i < QI_N; i += 2)
+  {
+    ddsi_qos_intern_unref (qi, ref[i]);
+    ddsi_qos_intern_unref (qi, ref[i]);
+  }
+  for (int i = 1; i < QI_N; i += 2)
+  {
+    CU_ASSERT_FATAL (ddsi_qos_intern_ref (qi, qos[i]) == ref[i]);
+    ddsi_qos_intern_unref (qi, ref[i]);
+  }
+
+  /* ids are never reused, so a QoS object that was released gets a new one */
+  for (int i = 0; i < QI_N; i += 2)
+  {
+    ref[i] = ddsi_qos_intern_ref (qi, qos[i]);
+    CU_ASSERT_FATAL (ddsi_qos_intern_id (ref[i]) > id[i]);
+  }
+
+  for (int i = 0; i < QI_N; i++)
+  {
+    ddsi_qos_intern_unref (qi, ref[i]);
+    if (i % 2)
+      ddsi_qos_intern_unref (qi, ref[i]);
+    dds_delete_qos (qos[i]);
+  }
+  ddsi_qos_intern_free (qi);
+}
+
+CU_Test(ddsc_qos_intern, update)
+{
+  /* same sequence of operations as a QoS update of a proxy endpoint: construct the
+     new QoS from the interned one, intern it, then release the old one */
+  struct ddsi_qos_intern * const qi = ddsi_qos_intern_new ();
+  dds_qos_t * const qos_a = qi_make_qos (1, DDS_INFINITY);
+  dds_qos_t * const qos_b = qi_make_qos (1, DDS_SECS (1));
+  dds_qos_t * const a = ddsi_qos_intern_ref (qi, qos_a);
+  dds_qos_t * const a2 = ddsi_qos_intern_ref (qi, qos_a);
+  CU_ASSERT_FATAL (a == a2);
+
+  dds_qos_t newqos;
+  ddsi_xqos_copy (&newqos, a);
+  ddsi_xqos_fini_mask (&newqos, QP_DEADLINE);
+  ddsi_xqos_mergein_missing (&newqos, qos_b, QP_DEADLINE);
+  dds_qos_t * const b = ddsi_qos_intern_ref (qi, &newqos);
+  ddsi_xqos_fini (&newqos);
+  CU_ASSERT_FATAL (b != a);
+  CU_ASSERT_FATAL (ddsi_xqos_delta (b, qos_b, ~(uint64_t)0) == 0);
+  CU_ASSERT_FATAL (ddsi_qos_intern_id (b) != ddsi_qos_intern_id (a));
+
+  /* the other reference keeps the old one alive */
+  ddsi_qos_intern_unref (qi, a);
+  CU_ASSERT_FATAL (ddsi_qos_intern_ref (qi, qos_a) == a);
+  ddsi_qos_intern_unref (qi, a);
+  CU_ASSERT_FATAL (ddsi_qos_intern_ref (qi, qos_b) == b);
+  ddsi_qos_intern_unref (qi, b);
+
+  ddsi_qos_intern_unref (qi, a2);
+  ddsi_qos_intern_unref (qi, b);
+  ddsi_qos_intern_free (qi);
+  dds_delete_qos (qos_a);
+  dds_delete_qos (qos_b);
+}
@@ -238,6 +238,143 @@ CU_Test(ddsc_querycondition_create, deleted_reader, .init=querycondition_init, .
 }
 /*************************************************************************************************/
 
+/*************************************************************************************************/
+CU_Test(ddsc_querycondition_create, many, .init=querycondition_init, .fini=querycondition_fini)
+{
+    /* More conditions than fit in a single word of the per-sample condition sets */
+#define N_MANY_CONDS 150
+    uint32_t mask = DDS_ANY_SAMPLE_STATE | DDS_ANY_VIEW_STATE | DDS_ANY_INSTANCE_STATE;
+    dds_entity_t conds[N_MANY_CONDS];
+    dds_return_t ret;
+
+    for (int i = 0; i < N_MANY_CONDS; i++) {
+        conds[i] = dds_create_querycondition(g_reader, mask, filter_mod2);
+        CU_ASSERT_FATAL(conds[i] > 0);
+    }
+
+    /* Delete some to create holes, then fill them again */
+    for (int i = 0; i < N_MANY_CONDS; i += 7) {
+        ret = dds_delete(conds[i]);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+        conds[i] = dds_create_querycondition(g_reader, mask, filter_mod2);
+        CU_ASSERT_FATAL(conds[i] > 0);
+    }
+
+    /* All must trigger and read the 4 samples with an even long_1 */
+    for (int i = 0; i < N_MANY_CONDS; i++) {
+        CU_ASSERT_EQUAL_FATAL(dds_triggered(conds[i]), 1);
+        ret = dds_read(conds[i], g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+        CU_ASSERT_EQUAL_FATAL(ret, 4);
+        for (int j = 0; j < ret; j++) {
+            Space_Type1 *sample = (Space_Type1*)g_samples[j];
+            CU_ASSERT_EQUAL_FATAL(sample->long_1 % 2, 0);
+        }
+    }
+
+    for (int i = 0; i < N_MANY_CONDS; i++) {
+        ret = dds_delete(conds[i]);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    }
+#undef N_MANY_CONDS
+}
+/*************************************************************************************************/
+
+/*************************************************************************************************/
+CU_Test(ddsc_querycondition_create, key_null, .init=querycondition_init, .fini=querycondition_fini)
+{
+    uint32_t mask = DDS_ANY_SAMPLE_STATE | DDS_ANY_VIEW_STATE | DDS_ANY_INSTANCE_STATE;
+    dds_entity_t cond;
+    cond = dds_create_querycondition_key(g_reader, mask, NULL);
+    CU_ASSERT_EQUAL_FATAL(cond, DDS_RETCODE_BAD_PARAMETER);
+}
+/*************************************************************************************************/
+
+/*************************************************************************************************/
+CU_Test(ddsc_querycondition_key, read, .init=querycondition_init, .fini=querycondition_fini)
+{
+    uint32_t mask = DDS_ANY_SAMPLE_STATE | DDS_ANY_VIEW_STATE | DDS_ANY_INSTANCE_STATE;
+    Space_Type1 key = { 2, 0, 0 };
+    dds_entity_t cond;
+    dds_return_t ret;
+
+    cond = dds_create_querycondition_key(g_reader, mask, &key);
+    CU_ASSERT_FATAL(cond > 0);
+    CU_ASSERT_EQUAL_FATAL(dds_triggered(cond), 1);
+
+    /* Only the sample of the instance with long_1 = 2 */
+    ret = dds_read(cond, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+    CU_ASSERT_EQUAL_FATAL(ret, 1);
+    CU_ASSERT_EQUAL_FATAL(g_data[0].long_1, 2);
+    CU_ASSERT_EQUAL_FATAL(g_info[0].sample_state, DDS_SST_READ);
+    CU_ASSERT_EQUAL_FATAL(g_info[0].instance_state, DDS_IST_NOT_ALIVE_NO_WRITERS);
+
+    ret = dds_take(cond, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+    CU_ASSERT_EQUAL_FATAL(ret, 1);
+    CU_ASSERT_EQUAL_FATAL(g_data[0].long_1, 2);
+    CU_ASSERT_EQUAL_FATAL(dds_triggered(cond), 0);
+    ret = dds_read(cond, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+    CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+    /* The other instances are unaffected */
+    ret = dds_read(g_reader, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+    CU_ASSERT_EQUAL_FATAL(ret, MAX_SAMPLES - 1);
+
+    ret = dds_delete(cond);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+}
+/*************************************************************************************************/
+
+/*************************************************************************************************/
+CU_Test(ddsc_querycondition_key, trigger, .init=querycondition_init, .fini=querycondition_fini)
+{
+    uint32_t mask = DDS_NOT_READ_SAMPLE_STATE | DDS_ANY_VIEW_STATE | DDS_ALIVE_INSTANCE_STATE;
+    Space_Type1 sample = { 42, 1, 2 };
+    dds_entity_t cond, cond2;
+    dds_attach_t triggered;
+    dds_return_t ret;
+
+    /* Key conditions may be created for instances the reader doesn't know (yet) */
+    cond = dds_create_querycondition_key(g_reader, mask, &sample);
+    CU_ASSERT_FATAL(cond > 0);
+    cond2 = dds_create_querycondition_key(g_reader, mask, &sample);
+    CU_ASSERT_FATAL(cond2 > 0);
+    CU_ASSERT_EQUAL_FATAL(dds_triggered(cond), 0);
+    ret = dds_read(cond, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+    CU_ASSERT_EQUAL_FATAL(ret, 0);
+    ret = dds_waitset_attach(g_waitset, cond, cond);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    ret = dds_waitset_wait(g_waitset, &triggered, 1, 0);
+    CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+    /* Deleting one of the two must not affect the other one */
+    ret = dds_delete(cond2);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+
+    /* Writing another instance doesn't trigger it, writing this one does */
+    sample.long_1 = 43;
+    ret = dds_write(g_writer, &sample);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL_FATAL(dds_triggered(cond), 0);
+    sample.long_1 = 42;
+    ret = dds_write(g_writer, &sample);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    ret = dds_waitset_wait(g_waitset, &triggered, 1, DDS_SECS(1));
+    CU_ASSERT_EQUAL_FATAL(ret, 1);
+    CU_ASSERT_EQUAL_FATAL(cond, (dds_entity_t)(intptr_t)triggered);
+
+    /* Reading changes the sample state and so it no longer matches */
+    ret = dds_read(cond, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+    CU_ASSERT_EQUAL_FATAL(ret, 1);
+    CU_ASSERT_EQUAL_FATAL(g_data[0].long_1, 42);
+    CU_ASSERT_EQUAL_FATAL(dds_triggered(cond), 0);
+
+    ret = dds_waitset_detach(g_waitset, cond);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    ret = dds_delete(cond);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+}
+/*************************************************************************************************/
+
 /*************************************************************************************************/
 CU_TheoryDataPoints(ddsc_querycondition_create, invalid_readers) = {
         CU_DataPoints(dds_entity_t, -2, -1, 0, INT_MAX, INT_MIN),
@@ -11,6 +11,7 @@
  */
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
 
 #include "dds/dds.h"
 #include "dds/ddsrt/misc.h"
@@ -1794,6 +1795,68 @@ CU_Test(ddsc_take, valid, .init=reader_init, .fini=reader_fini)
 }
 /*************************************************************************************************/
 
+/*************************************************************************************************/
+CU_Test(ddsc_take, reception_order)
+{
+    /* Ordered access at topic scope returns samples in the order they were received
+     * across all instances, instead of grouped by instance. */
+    static const int32_t keys[] = { 3, 1, 2, 1, 3, 3, 0, 2 };
+    const int32_t nkeys = (int32_t) (sizeof (keys) / sizeof (keys[0]));
+    Space_Type1 data[sizeof (keys) / sizeof (keys[0])];
+    void *samples[sizeof (keys) / sizeof (keys[0])];
+    dds_sample_info_t info[sizeof (keys) / sizeof (keys[0])];
+    dds_return_t ret;
+    char name[100];
+
+    dds_entity_t pp = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(pp > 0);
+    dds_entity_t tp = dds_create_topic(pp, &Space_Type1_desc, create_unique_topic_name("ddsc_reader_reception_order", name, sizeof name), NULL, NULL);
+    CU_ASSERT_FATAL(tp > 0);
+    dds_qos_t *qos = dds_create_qos();
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+    dds_qset_presentation(qos, DDS_PRESENTATION_TOPIC, false, true);
+    dds_entity_t rd = dds_create_reader(pp, tp, qos, NULL);
+    CU_ASSERT_FATAL(rd > 0);
+    dds_entity_t wr = dds_create_writer(pp, tp, qos, NULL);
+    CU_ASSERT_FATAL(wr > 0);
+    dds_delete_qos(qos);
+
+    for (int32_t i = 0; i < nkeys; i++) {
+        Space_Type1 sample = { keys[i], i, 0 };
+        ret = dds_write(wr, &sample);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    }
+    memset(data, 0, sizeof(data));
+    for (int32_t i = 0; i < nkeys; i++)
+        samples[i] = &data[i];
+
+    /* Reading the oldest three makes instances 3, 1 and 2 "not new" */
+    ret = dds_read(rd, samples, info, (size_t) nkeys, 3);
+    CU_ASSERT_EQUAL_FATAL(ret, 3);
+    for (int32_t i = 0; i < ret; i++) {
+        CU_ASSERT_EQUAL_FATAL(data[i].long_2, i);
+        CU_ASSERT_EQUAL_FATAL(info[i].view_state, DDS_VST_NEW);
+    }
+
+    ret = dds_take(rd, samples, info, (size_t) nkeys, (uint32_t) nkeys);
+    CU_ASSERT_EQUAL_FATAL(ret, nkeys);
+    for (int32_t i = 0; i < ret; i++) {
+        uint32_t sample_rank = 0;
+        for (int32_t j = i + 1; j < ret; j++)
+            sample_rank += (keys[j] == keys[i]);
+        CU_ASSERT_EQUAL_FATAL(data[i].long_1, keys[i]);
+        CU_ASSERT_EQUAL_FATAL(data[i].long_2, i);
+        CU_ASSERT_EQUAL_FATAL(info[i].sample_rank, sample_rank);
+        CU_ASSERT_EQUAL_FATAL(info[i].sample_state, (i < 3) ? DDS_SST_READ : DDS_SST_NOT_READ);
+        CU_ASSERT_EQUAL_FATAL(info[i].view_state, (keys[i] == 0) ? DDS_VST_NEW : DDS_VST_OLD);
+    }
+
+    ret = dds_delete(pp);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+}
+/*************************************************************************************************/
+
 
 
 
@@ -3183,3 +3246,198 @@ CU_Test(ddsc_take_mask_wl, combination_of_states, .init=reader_init, .fini=reade
     CU_ASSERT_EQUAL_FATAL(ret, MAX_SAMPLES - expected_cnt);
 }
 /*************************************************************************************************/
+
+/**************************************************************************************************
+ *
+ * These will check the columnar read/take.
+ *
+ *************************************************************************************************/
+/*************************************************************************************************/
+CU_Test(ddsc_read_columns, invalid_params, .init=reader_init, .fini=reader_fini)
+{
+    int32_t c1[MAX_SAMPLES];
+    dds_column_t cols[2] = {
+        { offsetof (Space_Type1, long_1), sizeof (int32_t), c1 },
+        { offsetof (Space_Type1, long_3), sizeof (int32_t), c1 }
+    };
+    dds_column_t badcols[3][1] = {
+        { { offsetof (Space_Type1, long_1), 3, c1 } },
+        { { offsetof (Space_Type1, long_1), sizeof (int32_t), NULL } },
+        { { sizeof (Space_Type1), sizeof (int32_t), c1 } }
+    };
+    dds_return_t ret;
+
+    ret = dds_read_columns(g_reader, NULL, 1, g_info, MAX_SAMPLES, 0);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_BAD_PARAMETER);
+    ret = dds_read_columns(g_reader, cols, 0, g_info, MAX_SAMPLES, 0);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_BAD_PARAMETER);
+    ret = dds_read_columns(g_reader, cols, 2, NULL, MAX_SAMPLES, 0);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_BAD_PARAMETER);
+    ret = dds_read_columns(g_reader, cols, 2, g_info, 0, 0);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_BAD_PARAMETER);
+    for (size_t i = 0; i < sizeof (badcols) / sizeof (badcols[0]); i++) {
+        ret = dds_take_columns(g_reader, badcols[i], 1, g_info, MAX_SAMPLES, 0);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_BAD_PARAMETER);
+    }
+    ret = dds_read_columns(g_writer, cols, 2, g_info, MAX_SAMPLES, 0);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_ILLEGAL_OPERATION);
+    dds_entity_t cond = dds_create_readcondition(g_reader, DDS_ANY_STATE);
+    CU_ASSERT_FATAL(cond > 0);
+    ret = dds_read_columns(cond, cols, 2, g_info, MAX_SAMPLES, 0);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_ILLEGAL_OPERATION);
+    dds_delete(cond);
+
+    /* None of the failed calls may have taken anything */
+    ret = samples_cnt();
+    CU_ASSERT_EQUAL_FATAL(ret, MAX_SAMPLES);
+}
+/*************************************************************************************************/
+
+/*************************************************************************************************/
+CU_Test(ddsc_read_columns, read, .init=reader_init, .fini=reader_fini)
+{
+    int32_t c1[MAX_SAMPLES], c2[MAX_SAMPLES], c3[MAX_SAMPLES], c3dup[MAX_SAMPLES];
+    uint16_t c1half[MAX_SAMPLES];
+    /* columns in a different order than the members, one member twice, and one that
+       doesn't correspond to a member */
+    dds_column_t cols[5] = {
+        { offsetof (Space_Type1, long_3), sizeof (int32_t), c3 },
+        { offsetof (Space_Type1, long_1), sizeof (int32_t), c1 },
+        { offsetof (Space_Type1, long_3), sizeof (int32_t), c3dup },
+        { offsetof (Space_Type1, long_2), sizeof (int32_t), c2 },
+        { offsetof (Space_Type1, long_1), sizeof (uint16_t), c1half }
+    };
+    dds_return_t ret;
+
+    for (uint32_t ncols = 4; ncols <= 5; ncols++) {
+        ret = dds_read_columns(g_reader, cols, ncols, g_info, MAX_SAMPLES, DDS_ANY_STATE);
+        CU_ASSERT_EQUAL_FATAL(ret, MAX_SAMPLES);
+        for (int i = 0; i < ret; i++) {
+            CU_ASSERT_EQUAL_FATAL(g_info[i].valid_data, true);
+            CU_ASSERT_EQUAL_FATAL(c1[i], i);
+            CU_ASSERT_EQUAL_FATAL(c2[i], i/2);
+            CU_ASSERT_EQUAL_FATAL(c3[i], i/3);
+            CU_ASSERT_EQUAL_FATAL(c3dup[i], i/3);
+            if (ncols == 5) {
+                int32_t x = i;
+                uint16_t y;
+                memcpy (&y, &x, sizeof (y));
+                CU_ASSERT_EQUAL_FATAL(c1half[i], y);
+            }
+        }
+    }
+
+    /* Reading doesn't remove anything, but it does mark them as read */
+    ret = dds_read_columns(g_reader, cols, 1, g_info, MAX_SAMPLES, DDS_NOT_READ_SAMPLE_STATE);
+    CU_ASSERT_EQUAL_FATAL(ret, 0);
+    ret = samples_cnt();
+    CU_ASSERT_EQUAL_FATAL(ret, MAX_SAMPLES);
+}
+/*************************************************************************************************/
+
+/*************************************************************************************************/
+CU_Test(ddsc_take_columns, take, .init=reader_init, .fini=reader_fini)
+{
+    uint32_t mask = DDS_NOT_READ_SAMPLE_STATE | DDS_ANY_VIEW_STATE | DDS_ANY_INSTANCE_STATE;
+    int32_t c1[MAX_SAMPLES], c2[MAX_SAMPLES];
+    dds_column_t cols[2] = {
+        { offsetof (Space_Type1, long_1), sizeof (int32_t), c1 },
+        { offsetof (Space_Type1, long_2), sizeof (int32_t), c2 }
+    };
+    dds_return_t ret;
+
+    ret = dds_take_columns(g_reader, cols, 2, g_info, MAX_SAMPLES, mask);
+    CU_ASSERT_EQUAL_FATAL(ret, MAX_SAMPLES - SAMPLE_LAST_READ_SST - 1);
+    for (int i = 0; i < ret; i++) {
+        int expected_long_1 = SAMPLE_LAST_READ_SST + 1 + i;
+        CU_ASSERT_EQUAL_FATAL(c1[i], expected_long_1);
+        CU_ASSERT_EQUAL_FATAL(c2[i], expected_long_1/2);
+        CU_ASSERT_EQUAL_FATAL(g_info[i].sample_state, DDS_SST_NOT_READ);
+    }
+    ret = samples_cnt();
+    CU_ASSERT_EQUAL_FATAL(ret, SAMPLE_LAST_READ_SST + 1);
+}
+/*************************************************************************************************/
+
+/*************************************************************************************************/
+CU_Test(ddsc_take_columns, various_types)
+{
+    /* Not a memcpy-able type, so the columns get extracted by interpreting the type;
+       XCDR2 is interesting because of the different alignment of 8-byte members */
+    static const dds_data_representation_id_t reprs[] = { DDS_DATA_REPRESENTATION_XCDR1, DDS_DATA_REPRESENTATION_XCDR2 };
+    enum { N = 10 };
+    dds_entity_t pp, tp, rd, wr;
+    int64_t ll[N];
+    double d[N];
+    char c[N];
+    bool b[N];
+    uint16_t us[N];
+    dds_column_t cols[5] = {
+        { offsetof (Space_simpletypes, d), sizeof (double), d },
+        { offsetof (Space_simpletypes, ll), sizeof (int64_t), ll },
+        { offsetof (Space_simpletypes, b), sizeof (bool), b },
+        { offsetof (Space_simpletypes, us), sizeof (uint16_t), us },
+        { offsetof (Space_simpletypes, c), sizeof (char), c }
+    };
+    dds_sample_info_t si[N];
+    dds_return_t ret;
+    char name[100];
+
+    pp = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(pp > 0);
+    tp = dds_create_topic(pp, &Space_simpletypes_desc, create_unique_topic_name("ddsc_take_columns", name, sizeof name), NULL, NULL);
+    CU_ASSERT_FATAL(tp > 0);
+    dds_qos_t *qos = dds_create_qos();
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+    dds_qset_data_representation(qos, 2, reprs);
+    rd = dds_create_reader(pp, tp, qos, NULL);
+    CU_ASSERT_FATAL(rd > 0);
+
+    for (size_t r = 0; r < sizeof (reprs) / sizeof (reprs[0]); r++) {
+        dds_qset_data_representation(qos, 1, &reprs[r]);
+        wr = dds_create_writer(pp, tp, qos, NULL);
+        CU_ASSERT_FATAL(wr > 0);
+        for (int i = 0; i < N; i++) {
+            char key[10];
+            (void) snprintf(key, sizeof (key), "%d", i);
+            Space_simpletypes sample = {
+                .l = i, .ll = -((int64_t) 1 << 40) * i, .us = (uint16_t) (1000 * i), .ul = (uint32_t) i,
+                .ull = (uint64_t) i, .f = (float) i, .d = 0.5 * i, .c = (char) ('a' + i), .b = (i % 2) != 0,
+                .o = (uint8_t) i, .s = key
+            };
+            ret = dds_write(wr, &sample);
+            CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+        }
+        ret = dds_take_columns(rd, cols, 5, si, (uint32_t) N, DDS_ANY_STATE);
+        CU_ASSERT_EQUAL_FATAL(ret, N);
+        for (int i = 0; i < ret; i++) {
+            /* instances are not necessarily returned in the order of writing */
+            const int k = c[i] - 'a';
+            CU_ASSERT_FATAL(k >= 0 && k < N);
+            CU_ASSERT_EQUAL_FATAL(si[i].valid_data, true);
+            CU_ASSERT_EQUAL_FATAL(ll[i], -((int64_t) 1 << 40) * k);
+            CU_ASSERT_EQUAL_FATAL(d[i], 0.5 * k);
+            CU_ASSERT_EQUAL_FATAL(b[i], (k % 2) != 0);
+            CU_ASSERT_EQUAL_FATAL(us[i], (uint16_t) (1000 * k));
+        }
+
+        /* disposing an instance without samples results in an invalid sample, for which
+           the columns must be zero */
+        Space_simpletypes keyval = { .s = "0" };
+        ret = dds_dispose(wr, &keyval);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+        memset (ll, 0xff, sizeof (ll));
+        memset (c, 0xff, sizeof (c));
+        ret = dds_take_columns(rd, cols, 5, si, (uint32_t) N, DDS_ANY_STATE);
+        CU_ASSERT_EQUAL_FATAL(ret, 1);
+        CU_ASSERT_EQUAL_FATAL(si[0].valid_data, false);
+        CU_ASSERT_EQUAL_FATAL(si[0].instance_state, DDS_IST_NOT_ALIVE_DISPOSED);
+        CU_ASSERT_EQUAL_FATAL(ll[0], 0);
+        CU_ASSERT_EQUAL_FATAL(c[0], 0);
+        dds_delete(wr);
+    }
+    dds_delete_qos(qos);
+    dds_delete(pp);
+}
+/*************************************************************************************************/
@@ -16,10 +16,14 @@
 #include "dds/ddsrt/process.h"
 #include "dds/ddsrt/threads.h"
 #include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/random.h"
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_whc.h"
 #include "dds__entity.h"
+#include "dds__topic.h"
+#include "dds__whc.h"
 
 #include "test_common.h"
 
@@ -27,6 +31,7 @@
 #define DDS_DOMAINID_SUB 1
 #define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
 #define DDS_CONFIG_NO_PORT_GAIN_LOG "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Tracing><OutputFile>cyclonedds_whc_test.${CYCLONEDDS_DOMAIN_ID}.${CYCLONEDDS_PID}.log</OutputFile><Verbosity>finest</Verbosity></Tracing><Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+#define DDS_CONFIG_FIFO_WHC "<Internal><FifoWhc>true</FifoWhc></Internal>"
 
 #define SAMPLE_COUNT 5
 #define DEADLINE_DURATION DDS_MSECS(1)
@@ -40,13 +45,13 @@ static dds_entity_t g_remote_domain        = 0;
 static dds_entity_t g_remote_participant   = 0;
 static dds_entity_t g_remote_subscriber    = 0;
 
-static void whc_init(void)
+static void whc_init_config(const char *config)
 {
   /* Domains for pub and sub use a different domain id, but the portgain setting
          * in configuration is 0, so that both domains will map to the same port number.
          * This allows to create two domains in a single test process. */
-  char *conf_pub = ddsrt_expand_envvars(DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_PUB);
-  char *conf_sub = ddsrt_expand_envvars(DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_SUB);
+  char *conf_pub = ddsrt_expand_envvars(config, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars(config, DDS_DOMAINID_SUB);
   g_domain = dds_create_domain(DDS_DOMAINID_PUB, conf_pub);
   g_remote_domain = dds_create_domain(DDS_DOMAINID_SUB, conf_sub);
   dds_free(conf_pub);
@@ -70,6 +75,16 @@ static void whc_init(void)
   CU_ASSERT_FATAL(g_publisher > 0);
 }
 
+static void whc_init(void)
+{
+  whc_init_config(DDS_CONFIG_NO_PORT_GAIN);
+}
+
+static void whc_init_fifo(void)
+{
+  whc_init_config(DDS_CONFIG_NO_PORT_GAIN DDS_CONFIG_FIFO_WHC);
+}
+
 static void whc_fini (void)
 {
   dds_delete_qos(g_qos);
@@ -245,7 +260,7 @@ static void test_whc_end_state(dds_durability_kind_t d, dds_reliability_kind_t r
 }
 
 #define ARRAY_LEN(A) ((int32_t)(sizeof(A) / sizeof(A[0])))
-CU_Test(ddsc_whc, check_end_state, .init=whc_init, .fini=whc_fini, .timeout=30)
+static void test_whc_end_states(void)
 {
   dds_durability_kind_t dur[] = {V, TL};
   dds_reliability_kind_t rel[] = {BE, R};
@@ -290,6 +305,196 @@ CU_Test(ddsc_whc, check_end_state, .init=whc_init, .fini=whc_fini, .timeout=30)
                       }
 }
 
+CU_Test(ddsc_whc, check_end_state, .init=whc_init, .fini=whc_fini, .timeout=30)
+{
+  test_whc_end_states();
+}
+
+CU_Test(ddsc_whc, check_end_state_fifo, .init=whc_init_fifo, .fini=whc_fini, .timeout=30)
+{
+  /* volatile keep-all writers without a deadline use the FIFO WHC, the others must
+     be unaffected by the setting */
+  test_whc_end_states();
+}
+
+#define FIFO_STRESS_NSAMPLES 200000
+
+struct fifo_stress_arg {
+  struct whc *whc;
+  struct ddsi_serdata *sd;
+  ddsrt_atomic_uint64_t maxseq; /* highest sequence number inserted */
+  ddsrt_atomic_uint32_t stop;
+  uint32_t nremoved;
+  uint32_t nborrowed;
+};
+
+static uint32_t fifo_stress_insert (void *varg)
+{
+  struct fifo_stress_arg * const arg = varg;
+  for (seqno_t seq = 1; seq <= FIFO_STRESS_NSAMPLES; seq++)
+  {
+    /* skip an occasional sequence number, as happens when there are no reliable readers */
+    if ((seq % 1000) == 500)
+      continue;
+    int ret = whc_insert (arg->whc, 0, seq, DDSRT_MTIME_NEVER, NULL, arg->sd, NULL);
+    CU_ASSERT_FATAL (ret == 0);
+    ddsrt_atomic_st64 (&arg->maxseq, (uint64_t) seq);
+  }
+  ddsrt_atomic_st32 (&arg->stop, 1);
+  return 0;
+}
+
+static uint32_t fifo_stress_remove (void *varg)
+{
+  struct fifo_stress_arg * const arg = varg;
+  ddsrt_prng_t prng;
+  ddsrt_prng_init_simple (&prng, 1);
+  seqno_t max_drop_seq = 0;
+  while (!ddsrt_atomic_ld32 (&arg->stop))
+  {
+    /* acknowledgements never cover samples that haven't been written yet */
+    const seqno_t maxseq = (seqno_t) ddsrt_atomic_ld64 (&arg->maxseq);
+    const seqno_t next = max_drop_seq + (seqno_t) (ddsrt_prng_random (&prng) % 64);
+    if (next > max_drop_seq && next <= maxseq)
+    {
+      struct whc_state whcst;
+      struct whc_node *deferred_free_list;
+      max_drop_seq = next;
+      arg->nremoved += whc_remove_acked_messages (arg->whc, max_drop_seq, &whcst, &deferred_free_list);
+      whc_free_deferred_free_list (arg->whc, deferred_free_list);
+    }
+  }
+  return 0;
+}
+
+static uint32_t fifo_stress_borrow (void *varg)
+{
+  struct fifo_stress_arg * const arg = varg;
+  ddsrt_prng_t prng;
+  ddsrt_prng_init_simple (&prng, 2);
+  while (!ddsrt_atomic_ld32 (&arg->stop))
+  {
+    struct whc_state whcst;
+    struct whc_borrowed_sample sample;
+    whc_get_state (arg->whc, &whcst);
+    if (whcst.max_seq < 0)
+      continue;
+    /* removal may happen while the sample is borrowed, that's the interesting case */
+    const seqno_t seq = whcst.min_seq + (seqno_t) (ddsrt_prng_random (&prng) % (uint32_t) (whcst.max_seq - whcst.min_seq + 1));
+    if (whc_borrow_sample (arg->whc, seq, &sample))
+    {
+      CU_ASSERT_FATAL (sample.seq == seq && sample.serdata == arg->sd);
+      whc_return_sample (arg->whc, &sample, (ddsrt_prng_random (&prng) % 2) != 0);
+      arg->nborrowed++;
+    }
+  }
+  return 0;
+}
+
+static struct ddsi_serdata *fifo_make_serdata (dds_entity_t topic, struct ddsi_domaingv **gv)
+{
+  struct dds_topic *tp;
+  struct ddsi_serdata *sd;
+  dds_return_t ret = dds_topic_pin (topic, &tp);
+  CU_ASSERT_FATAL (ret == 0);
+  *gv = &tp->m_entity.m_domain->gv;
+  sd = ddsi_serdata_from_sample (tp->m_stype, SDK_DATA, &(Space_Type1){ 1, 2, 3 });
+  CU_ASSERT_FATAL (sd != NULL);
+  dds_topic_unpin (tp);
+  return sd;
+}
+
+static struct whc *fifo_make_whc (struct ddsi_domaingv *gv)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_durability (qos, DDS_DURABILITY_VOLATILE);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_deadline (qos, DDS_INFINITY);
+  dds_qset_durability_service (qos, 0, DDS_HISTORY_KEEP_LAST, 1, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED);
+  struct whc_writer_info *wrinfo = whc_make_wrinfo (NULL, qos);
+  struct whc *whc = whc_new (gv, wrinfo);
+  whc_free_wrinfo (wrinfo);
+  dds_delete_qos (qos);
+  return whc;
+}
+
+CU_Test(ddsc_whc, fifo_borrowed_head, .init=whc_init_fifo, .fini=whc_fini, .timeout=30)
+{
+  /* a sample removed while borrowed becomes the responsibility of the borrower,
+     including when it is the last one removed and so remains as the head node */
+  char name[100];
+  create_unique_topic_name ("ddsc_whc_fifo", name, sizeof name);
+  const dds_entity_t topic = dds_create_topic (g_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (topic > 0);
+  struct ddsi_domaingv *gv;
+  struct ddsi_serdata * const sd = fifo_make_serdata (topic, &gv);
+  struct whc * const whc = fifo_make_whc (gv);
+  for (seqno_t seq = 1; seq <= 3; seq++)
+    CU_ASSERT_FATAL (whc_insert (whc, 0, seq, DDSRT_MTIME_NEVER, NULL, sd, NULL) == 0);
+  CU_ASSERT_FATAL (ddsrt_atomic_ld32 (&sd->refc) == 4);
+
+  struct whc_borrowed_sample sample;
+  struct whc_state whcst;
+  struct whc_node *deferred_free_list;
+  CU_ASSERT_FATAL (whc_borrow_sample (whc, 2, &sample));
+  CU_ASSERT_FATAL (whc_remove_acked_messages (whc, 2, &whcst, &deferred_free_list) == 2);
+  whc_free_deferred_free_list (whc, deferred_free_list);
+  CU_ASSERT_FATAL (ddsrt_atomic_ld32 (&sd->refc) == 3);
+  CU_ASSERT_FATAL (whcst.min_seq == 3 && whcst.max_seq == 3);
+  whc_return_sample (whc, &sample, false);
+  CU_ASSERT_FATAL (ddsrt_atomic_ld32 (&sd->refc) == 2);
+  whc_free (whc);
+  CU_ASSERT_FATAL (ddsrt_atomic_ld32 (&sd->refc) == 1);
+  ddsi_serdata_unref (sd);
+  dds_delete (topic);
+}
+
+CU_Test(ddsc_whc, fifo_stress, .init=whc_init_fifo, .fini=whc_fini, .timeout=60)
+{
+  /* insert, acknowledge and borrow concurrently; the FIFO WHC has separate
+     locks for the inserting and the removing side, so these really do run in
+     parallel.  Meant for running under ASan/TSan */
+  char name[100];
+  create_unique_topic_name ("ddsc_whc_fifo", name, sizeof name);
+  const dds_entity_t topic = dds_create_topic (g_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (topic > 0);
+  struct ddsi_domaingv *gv;
+  struct fifo_stress_arg arg;
+  arg.sd = fifo_make_serdata (topic, &gv);
+  arg.whc = fifo_make_whc (gv);
+  ddsrt_atomic_st64 (&arg.maxseq, 0);
+  ddsrt_atomic_st32 (&arg.stop, 0);
+  arg.nremoved = 0;
+  arg.nborrowed = 0;
+
+  uint32_t (* const fs[]) (void *) = { fifo_stress_insert, fifo_stress_remove, fifo_stress_borrow };
+  ddsrt_thread_t tids[sizeof (fs) / sizeof (fs[0])];
+  ddsrt_threadattr_t tattr;
+  ddsrt_threadattr_init (&tattr);
+  for (size_t i = 0; i < sizeof (fs) / sizeof (fs[0]); i++)
+  {
+    dds_return_t ret = ddsrt_thread_create (&tids[i], "fifo_stress", &tattr, fs[i], &arg);
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  for (size_t i = 0; i < sizeof (fs) / sizeof (fs[0]); i++)
+    (void) ddsrt_thread_join (tids[i], NULL);
+  printf ("fifo_stress: removed %"PRIu32" borrowed %"PRIu32"\n", arg.nremoved, arg.nborrowed);
+
+  /* everything not yet removed is still present, in order */
+  struct whc_state whcst;
+  whc_get_state (arg.whc, &whcst);
+  CU_ASSERT_FATAL (whcst.max_seq == FIFO_STRESS_NSAMPLES);
+  const uint32_t nstored = FIFO_STRESS_NSAMPLES - FIFO_STRESS_NSAMPLES / 1000;
+  uint32_t n = 0;
+  for (seqno_t seq = whc_next_seq (arg.whc, 0); seq != MAX_SEQ_NUMBER; seq = whc_next_seq (arg.whc, seq))
+    n++;
+  CU_ASSERT_FATAL (arg.nremoved + n == nstored);
+  whc_free (arg.whc);
+  CU_ASSERT_FATAL (ddsrt_atomic_ld32 (&arg.sd->refc) == 1);
+  ddsi_serdata_unref (arg.sd);
+  dds_delete (topic);
+}
+
 #undef ARRAY_LEN
 #undef V
 #undef TL
@@ -0,0 +1,309 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_entity_index.h"
+#include "dds/ddsi/ddsi_plist.h"
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds/ddsi/ddsi_wraddrset.h"
+#include "dds/ddsi/q_addrset.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds__entity.h"
+
+#include "CUnit/Test.h"
+
+/* The writer's address set is maintained incrementally as readers match,
+   unmatch and change their address sets.  These tests check it against the
+   address set computed from scratch after every change, using proxy readers
+   in a domain and a writer that exists only for computing its address set,
+   so that nothing ever gets sent to these made-up addresses. */
+
+#define WRAS_NREADERS 40
+#define WRAS_NSTEPS 2000
+#define WRAS_MAXLOCS 5
+
+/* Connection 0 is a real one, the others are copies of it that stand in for
+   additional interfaces (only their identity matters for computing the
+   address set), so that redundant networking results in multiple rows */
+#define WRAS_NCONNS 3
+
+static const struct { int conn; const char *loc; } wras_pool[] = {
+  { 0, "192.0.2.1:7410" }, { 0, "192.0.2.2:7410" }, { 0, "192.0.2.3:7410" }, { 0, "192.0.2.3:7411" },
+  { 1, "198.51.100.1:7410" }, { 1, "198.51.100.2:7410" },
+  { 2, "203.0.113.1:7410" }, { 2, "203.0.113.2:7410" },
+  { 0, "239.255.0.1:7400" }, { 1, "239.255.0.1:7400" }, { 2, "239.255.0.1:7400" },
+  { 0, "239.255.0.2:7401" },
+  { 0, "239.255.1.0;0;4;0:7400" }, { 0, "239.255.1.0;0;4;1:7400" },
+  { 0, "239.255.1.0;0;4;2:7400" }, { 0, "239.255.1.0;0;4;3:7400" },
+  { 1, "239.255.1.0;0;4;0:7400" }, { 1, "239.255.1.0;0;4;1:7400" }
+};
+#define WRAS_POOLSIZE (sizeof (wras_pool) / sizeof (wras_pool[0]))
+
+struct wras_test_reader {
+  ddsi_guid_t guid;
+  bool exists;
+  bool matched;
+  seqno_t seq;
+};
+
+static dds_entity_t g_domain;
+static struct ddsi_domaingv *g_gv;
+static struct ddsi_tran_conn g_fake_conns[WRAS_NCONNS - 1];
+static ddsi_xlocator_t g_pool[WRAS_POOLSIZE];
+static ddsi_guid_t g_ppguid;
+static uint32_t g_next_eid;
+static struct writer g_wr;
+static dds_qos_t g_wrqos;
+static struct wras_test_reader g_rds[WRAS_NREADERS];
+static ddsrt_prng_t g_prng;
+
+static void wraddrset_init (void)
+{
+  const char *config = "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<General><Transport>udp</Transport></General>";
+  char *xconfig = ddsrt_expand_envvars (config, 0);
+  g_domain = dds_create_domain (0, xconfig);
+  CU_ASSERT_FATAL (g_domain > 0);
+  ddsrt_free (xconfig);
+
+  struct dds_entity *x;
+  dds_return_t rc = dds_entity_pin (g_domain, &x);
+  CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+  g_gv = &x->m_domain->gv;
+  dds_entity_unpin (x);
+  CU_ASSERT_FATAL (g_gv->n_interfaces > 0);
+
+  for (int i = 0; i < WRAS_NCONNS - 1; i++)
+    g_fake_conns[i] = *g_gv->xmit_conns[0];
+  for (size_t i = 0; i < WRAS_POOLSIZE; i++)
+  {
+    enum ddsi_locator_from_string_result res = ddsi_locator_from_string (g_gv, &g_pool[i].c, wras_pool[i].loc, g_gv->m_factory);
+    CU_ASSERT_FATAL (res == AFSR_OK);
+    g_pool[i].conn = (wras_pool[i].conn == 0) ? g_gv->xmit_conns[0] : &g_fake_conns[wras_pool[i].conn - 1];
+  }
+
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  ddsi_plist_t plist;
+  ddsi_plist_init_empty (&plist);
+  memset (&g_ppguid, 0, sizeof (g_ppguid));
+  g_ppguid.prefix.u[0] = 0x5ca1ab1e;
+  g_ppguid.prefix.u[1] = ddsrt_random ();
+  g_ppguid.prefix.u[2] = ddsrt_random ();
+  g_ppguid.entityid.u = NN_ENTITYID_PARTICIPANT;
+  thread_state_awake (ts1, g_gv);
+  const bool ok = new_proxy_participant (g_gv, &g_ppguid, 0, NULL, new_addrset (), new_addrset (), &plist, DDS_INFINITY, NN_VENDORID_ECLIPSE, CF_IMPLICITLY_CREATED_PROXYPP | CF_PROXYPP_NO_SPDP, ddsrt_time_wallclock (), 1);
+  thread_state_asleep (ts1);
+  CU_ASSERT_FATAL (ok);
+  g_next_eid = 1;
+
+  memset (&g_wr, 0, sizeof (g_wr));
+  g_wr.e.gv = g_gv;
+  g_wr.e.guid = g_ppguid;
+  g_wr.e.guid.prefix.u[0]++;
+  g_wr.e.guid.entityid.u = NN_ENTITYID_KIND_WRITER_WITH_KEY;
+  ddsi_xqos_init_empty (&g_wrqos);
+  g_wrqos.present = QP_LOCATOR_MASK;
+  g_wrqos.ignore_locator_type = 0;
+  g_wr.xqos = &g_wrqos;
+  ddsrt_avl_init (&wr_readers_treedef, &g_wr.readers);
+  g_wr.wras_cache = ddsi_wraddrset_cache_new ();
+
+  memset (g_rds, 0, sizeof (g_rds));
+  ddsrt_prng_init_simple (&g_prng, 0x3e3e3e3e);
+}
+
+static void wraddrset_fini (void)
+{
+  ddsrt_avl_free (&wr_readers_treedef, &g_wr.readers, ddsrt_free);
+  ddsi_wraddrset_cache_free (g_wr.wras_cache);
+  dds_return_t rc = dds_delete (g_domain);
+  CU_ASSERT_FATAL (rc == 0);
+}
+
+static struct addrset *wras_random_addrset (void)
+{
+  struct addrset *as = new_addrset ();
+  const uint32_t n = 1 + ddsrt_prng_random (&g_prng) % WRAS_MAXLOCS;
+  for (uint32_t i = 0; i < n; i++)
+    add_xlocator_to_addrset (g_gv, as, &g_pool[ddsrt_prng_random (&g_prng) % WRAS_POOLSIZE]);
+  return as;
+}
+
+static void wras_create_reader (struct wras_test_reader *rd)
+{
+  ddsi_plist_t plist;
+  ddsi_plist_init_empty (&plist);
+  plist.qos.present |= QP_TOPIC_NAME | QP_TYPE_NAME;
+  plist.qos.topic_name = ddsrt_strdup ("wraddrset");
+  plist.qos.type_name = ddsrt_strdup ("wraddrset");
+  if (ddsrt_prng_random (&g_prng) % 2)
+  {
+    plist.present |= PP_CYCLONE_REDUNDANT_NETWORKING;
+    plist.cyclone_redundant_networking = 1;
+  }
+  rd->guid.prefix = g_ppguid.prefix;
+  rd->guid.entityid.u = (g_next_eid++ << 8) | NN_ENTITYID_KIND_READER_WITH_KEY;
+  rd->seq = 1;
+  struct addrset *as = wras_random_addrset ();
+  const int ret = new_proxy_reader (g_gv, &g_ppguid, &rd->guid, as, &plist, ddsrt_time_wallclock (), rd->seq
+#ifdef DDS_HAS_SSM
+                                    , 0
+#endif
+                                    );
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  unref_addrset (as);
+  ddsi_plist_fini (&plist);
+  rd->exists = true;
+}
+
+static void wras_update_reader (struct wras_test_reader *rd)
+{
+  struct proxy_reader *prd = entidx_lookup_proxy_reader_guid (g_gv->entity_index, &rd->guid);
+  CU_ASSERT_FATAL (prd != NULL);
+  struct addrset *as = wras_random_addrset ();
+  update_proxy_reader (prd, ++rd->seq, as, prd->c.xqos, ddsrt_time_wallclock ());
+  unref_addrset (as);
+}
+
+static void wras_delete_reader (struct wras_test_reader *rd)
+{
+  const int ret = delete_proxy_reader (g_gv, &rd->guid, ddsrt_time_wallclock (), 0);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  rd->exists = false;
+}
+
+static void wras_match (struct wras_test_reader *rd)
+{
+  struct wr_prd_match *m = ddsrt_malloc (sizeof (*m));
+  memset (m, 0, sizeof (*m));
+  m->prd_guid = rd->guid;
+  ddsrt_avl_insert (&wr_readers_treedef, &g_wr.readers, m);
+  g_wr.num_readers++;
+  rd->matched = true;
+}
+
+static void wras_unmatch (struct wras_test_reader *rd)
+{
+  ddsrt_avl_dpath_t dp;
+  struct wr_prd_match *m = ddsrt_avl_lookup_dpath (&wr_readers_treedef, &g_wr.readers, &rd->guid, &dp);
+  CU_ASSERT_FATAL (m != NULL);
+  ddsrt_avl_delete_dpath (&wr_readers_treedef, &g_wr.readers, m, &dp);
+  ddsrt_free (m);
+  g_wr.num_readers--;
+  rd->matched = false;
+}
+
+struct wras_locs {
+  uint32_t n;
+  ddsi_xlocator_t locs[2 * WRAS_POOLSIZE];
+};
+
+static void wras_locs_add (const ddsi_xlocator_t *loc, void *varg)
+{
+  struct wras_locs *ls = varg;
+  CU_ASSERT_FATAL (ls->n < sizeof (ls->locs) / sizeof (ls->locs[0]));
+  ls->locs[ls->n++] = *loc;
+}
+
+static bool wras_addrset_equal (struct addrset *a, struct addrset *b)
+{
+  struct wras_locs la = { .n = 0 }, lb = { .n = 0 };
+  addrset_forall (a, wras_locs_add, &la);
+  addrset_forall (b, wras_locs_add, &lb);
+  if (la.n != lb.n)
+    return false;
+  for (uint32_t i = 0; i < la.n; i++)
+    if (compare_xlocators (&la.locs[i], &lb.locs[i]) != 0)
+      return false;
+  return true;
+}
+
+static void wras_check (void)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  thread_state_awake (ts1, g_gv);
+  struct addrset * const incr = compute_writer_addrset (&g_wr);
+  // doing it again without any changes must give the same result
+  struct addrset * const incr2 = compute_writer_addrset (&g_wr);
+  struct ddsi_wraddrset_cache * const wc = g_wr.wras_cache;
+  g_wr.wras_cache = ddsi_wraddrset_cache_new ();
+  struct addrset * const fresh = compute_writer_addrset (&g_wr);
+  ddsi_wraddrset_cache_free (g_wr.wras_cache);
+  g_wr.wras_cache = wc;
+  thread_state_asleep (ts1);
+  CU_ASSERT_FATAL (wras_addrset_equal (incr, fresh));
+  CU_ASSERT_FATAL (wras_addrset_equal (incr, incr2));
+  unref_addrset (fresh);
+  unref_addrset (incr2);
+  unref_addrset (incr);
+}
+
+CU_Test(ddsc_wraddrset, incremental_equals_fresh, .init = wraddrset_init, .fini = wraddrset_fini, .timeout = 60)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  wras_check ();
+  for (int step = 0; step < WRAS_NSTEPS; step++)
+  {
+    struct wras_test_reader * const rd = &g_rds[ddsrt_prng_random (&g_prng) % WRAS_NREADERS];
+    const uint32_t op = ddsrt_prng_random (&g_prng) % 8;
+    thread_state_awake (ts1, g_gv);
+    if (!rd->exists)
+    {
+      // a new proxy reader gets a new GUID, the writer may still have the old one matched
+      if (rd->matched)
+        wras_unmatch (rd);
+      wras_create_reader (rd);
+      wras_match (rd);
+    }
+    else if (op < 3)
+    {
+      if (rd->matched)
+        wras_unmatch (rd);
+      else
+        wras_match (rd);
+    }
+    else if (op < 7)
+    {
+      wras_update_reader (rd);
+    }
+    else
+    {
+      // the writer keeps it matched for a while, it must simply be skipped
+      wras_delete_reader (rd);
+    }
+    thread_state_asleep (ts1);
+    wras_check ();
+  }
+
+  // everything gone: empty address set
+  thread_state_awake (ts1, g_gv);
+  for (int i = 0; i < WRAS_NREADERS; i++)
+  {
+    if (g_rds[i].matched)
+      wras_unmatch (&g_rds[i]);
+    if (g_rds[i].exists)
+      wras_delete_reader (&g_rds[i]);
+  }
+  thread_state_asleep (ts1);
+  wras_check ();
+  thread_state_awake (ts1, g_gv);
+  struct addrset * const as = compute_writer_addrset (&g_wr);
+  thread_state_asleep (ts1);
+  CU_ASSERT (addrset_empty (as));
+  unref_addrset (as);
+}
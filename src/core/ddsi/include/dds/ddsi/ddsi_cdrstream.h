@@ -27,11 +27,29 @@ typedef struct dds_istream {
   uint32_t m_xcdr_version;  /* XCDR version of the data */
 } dds_istream_t;
 
+/* A sequence of primitive types referenced by, rather than copied into, an
+   output stream.  The stream contains (len % 8) bytes of unspecified contents
+   at index instead of the referenced bytes, so that alignment computations on
+   the stream are unaffected. */
+struct dds_ostream_extref {
+  uint32_t index;           /* Offset in buffer where the referenced bytes go */
+  uint32_t len;             /* Number of referenced bytes */
+  const void *ptr;          /* Referenced bytes */
+};
+
+struct dds_ostream_extrefs {
+  uint32_t min_size;        /* Minimum size of a sequence for referencing it */
+  uint32_t skipped;         /* Referenced bytes not present in the buffer */
+  uint32_t n, max;
+  struct dds_ostream_extref *refs;
+};
+
 typedef struct dds_ostream {
   unsigned char *m_buffer;
   uint32_t m_size;          /* Buffer size */
   uint32_t m_index;         /* Read/write offset from start of buffer */
   uint32_t m_xcdr_version;  /* XCDR version to use for serializing data */
+  struct dds_ostream_extrefs *m_extrefs; /* Non-null: may reference large sequences */
 } dds_ostream_t;
 
 typedef struct dds_ostreamBE {
@@ -42,6 +60,18 @@ typedef struct dds_ostreamLE {
   dds_ostream_t x;
 } dds_ostreamLE_t;
 
+/* Description of a column for dds_stream_read_columns: member at offset "offset" in the
+   sample of size "size" (1, 2, 4 or 8), the value for sample i goes to buf + i * size */
+struct dds_stream_column {
+  uint32_t offset;
+  uint32_t size;
+  void *buf;
+};
+
+/* Plan for extracting a set of columns from serialized samples of a type, NULL from
+   dds_stream_columns_new if the columns can't be read directly from the CDR */
+struct dds_stream_columns;
+
 DDSRT_STATIC_ASSERT (offsetof (dds_ostreamLE_t, x) == 0);
 DDSRT_STATIC_ASSERT (offsetof (dds_ostreamBE_t, x) == 0);
 
@@ -83,6 +113,9 @@ DDS_EXPORT void dds_stream_extract_keyBE_from_key (dds_istream_t * __restrict is
 
 DDS_EXPORT const uint32_t *dds_stream_read (dds_istream_t * __restrict is, char * __restrict data, const uint32_t * __restrict ops);
 DDS_EXPORT void dds_stream_read_key (dds_istream_t * __restrict is, char * __restrict sample, const struct ddsi_sertype_default * __restrict type);
+DDS_EXPORT struct dds_stream_columns *dds_stream_columns_new (const struct ddsi_sertype_default * __restrict type, uint32_t ncols, const struct dds_stream_column * __restrict cols);
+DDS_EXPORT void dds_stream_columns_free (struct dds_stream_columns *plan);
+DDS_EXPORT void dds_stream_read_columns (dds_istream_t * __restrict is, const struct dds_stream_columns * __restrict plan, uint32_t idx);
 
 DDS_EXPORT size_t dds_stream_print_key (dds_istream_t * __restrict is, const struct ddsi_sertype_default * __restrict type, char * __restrict buf, size_t size);
 
@@ -1066,6 +1066,51 @@ static struct cfgelem internal_cfgelems[] = {
       "expressed in samples. Once a delivery queue is full, incoming samples "
       "destined for that queue are dropped until space becomes available "
       "again.</p>")),
+  BOOL("LockFreeDeliveryQueues", NULL, 1, "false",
+    MEMBER(lockfree_delivery_queues),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether the delivery queues use a lock-free "
+      "queue instead of a mutex-protected one. In lock-free mode, enqueueing "
+      "samples never takes a lock and only wakes up the delivery thread if "
+      "it is sleeping, and the delivery thread briefly spins waiting for new "
+      "samples before going to sleep. This reduces the latency and the "
+      "number of context switches at high sample rates, at the cost of some "
+      "CPU time spent spinning.</p>")),
+  BOOL("FifoWhc", NULL, 1, "false",
+    MEMBER(whc_fifo),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether writers that keep all history and "
+      "have volatile durability, no deadline and no lifespan use a FIFO "
+      "writer history cache, with separate locks for inserting new samples "
+      "at the tail and for removing acknowledged ones from the head. In this "
+      "cache removing acknowledged samples takes constant time regardless of "
+      "how many samples are acknowledged at once, and the samples are freed "
+      "after the writer has been unlocked, so that a writer is not held up by "
+      "a large cleanup.</p>")),
+  BOOL("LazyWriteKey", NULL, 1, "false",
+    MEMBER(lazy_write_key),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether writers that keep all history and "
+      "have volatile durability and no deadline defer computing the key of "
+      "a sample until something needs it. The keyhash is then only computed "
+      "for remote readers that require it, which saves a significant amount "
+      "of time when writing samples with large keys, but samples have to be "
+      "serialized a second time for local readers.</p>")),
+  BOOL("ShareLoanedSamples", NULL, 1, "false",
+    MEMBER(share_loaned_samples),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether a read or take that lets the reader "
+      "lend out the samples (i.e., passing null pointers for the samples) "
+      "returns a deserialized sample that is cached with the received data "
+      "and shared by all local readers of that data, rather than "
+      "deserializing the data for each reader separately. The application "
+      "must treat such loaned samples as read-only. It only applies to "
+      "readers of types using the default (IDL-generated) representation "
+      "and not to reads through read or query conditions.</p>")),
   INT("PrimaryReorderMaxSamples", NULL, 1, "128",
     MEMBER(primary_reorder_maxsamples),
     FUNCTIONS(0, uf_uint, 0, pf_uint),
@@ -1097,6 +1142,15 @@ static struct cfgelem internal_cfgelems[] = {
       "defragmented simultaneously for a reliable writer. This has to be "
       "large enough to handle retransmissions of historical data in addition "
       "to new samples.</p>")),
+  BOOL("DefragSampleRing", NULL, 1, "true",
+    MEMBER(defrag_sample_ring),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether fragmented samples with sequence "
+      "numbers close to the most recent one are tracked in a small array "
+      "indexed by sequence number, only resorting to a search tree for "
+      "samples that fall far behind. Disabling it is only useful for "
+      "diagnosing problems.</p>")),
   ENUM("BuiltinEndpointSet", NULL, 1, "writers",
     MEMBER(besmode),
     FUNCTIONS(0, uf_besmode, 0, pf_besmode),
@@ -1448,6 +1502,105 @@ static struct cfgelem internal_cfgelems[] = {
     "transport (e.g., UDP) and ManySocketsMode not set to single (the "
     "default).</p>"),
     VALUES("false","true","default")),
+  INT("UnicastReceiveThreads", NULL, 1, "1",
+    MEMBER(unicast_recv_threads),
+    FUNCTIONS(0, uf_unicast_recv_threads, 0, pf_int),
+    DESCRIPTION(
+      "<p>This element sets the number of threads receiving unicast data "
+      "when ManySocketsMode is set to single and multiple receive threads "
+      "are in use. Values greater than 1 cause that many sockets to be bound "
+      "to the unicast data port using SO_REUSEPORT, each served by its own "
+      "receive thread, leaving it to the kernel to distribute the incoming "
+      "traffic over these sockets by hashing the source address. It only "
+      "has an effect for UDP on Linux, and only "
+      "if the unicast data port differs from the unicast discovery "
+      "port.</p>"),
+    RANGE("1;16")),
+  INT("EventThreads", NULL, 1, "1",
+    MEMBER(xevent_threads),
+    FUNCTIONS(0, uf_xevent_threads, 0, pf_int),
+    DESCRIPTION(
+      "<p>This element sets the number of threads handling timed events "
+      "(heartbeats, acknowledgements, retransmits, &c.). Values greater than "
+      "1 create additional event queues, each with its own thread, over "
+      "which the application writers and the proxy writers for application "
+      "data are distributed by hashing their GUIDs, so that the events for "
+      "any given writer are always handled in order by the same thread. "
+      "Discovery and all other events remain on the first queue.</p>"),
+    RANGE("1;16")),
+  INT("DiscoveryThreads", NULL, 1, "1",
+    MEMBER(discovery_threads),
+    FUNCTIONS(0, uf_discovery_threads, 0, pf_int),
+    DESCRIPTION(
+      "<p>This element sets the number of threads processing discovery data "
+      "(SPDP, SEDP and the other built-in topics). Values greater than 1 "
+      "create additional delivery queues, each with its own thread, over "
+      "which the remote participants are distributed by hashing their GUID "
+      "prefixes, so that the discovery data of any given participant is "
+      "always processed in order by the same thread, while that of different "
+      "participants, including the matching of the discovered endpoints, is "
+      "processed concurrently.</p>"),
+    RANGE("1;16")),
+  INT("ReceiveBatchSize", NULL, 1, "1",
+    MEMBER(recv_batch_size),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the maximum number of datagrams a receive thread "
+      "reads from a socket in a single system call. Values greater than 1 "
+      "only have an effect on platforms supporting recvmmsg (currently "
+      "Linux), elsewhere datagrams are always read one at a time. Each "
+      "datagram in a batch reserves Sizing/ReceiveBufferChunkSize bytes in "
+      "the receive buffer, and so the batch size is also limited by "
+      "Sizing/ReceiveBufferSize.</p>")),
+  STRING("ZeroCopyReceiveMinSize", NULL, 1, "0 B",
+    MEMBER(zerocopy_receive_min_size),
+    FUNCTIONS(0, uf_memsize, 0, pf_memsize),
+    DESCRIPTION(
+      "<p>This element sets the minimum size of a received sample for it to "
+      "be stored in the reader history caches by referencing the receive "
+      "buffer rather than by copying it out. It only applies to samples "
+      "received unfragmented and in the native byte order. A value of 0 "
+      "disables it.</p>\n"
+      "<p>A sample referencing a receive buffer keeps that entire buffer "
+      "(Sizing/ReceiveBufferSize) allocated for as long as the sample is "
+      "held by a reader, see also Internal/ZeroCopyReceiveMaxPinned.</p>"),
+    UNIT("memsize")),
+  STRING("ZeroCopyReceiveMaxPinned", NULL, 1, "4 MB",
+    MEMBER(zerocopy_receive_max_pinned),
+    FUNCTIONS(0, uf_memsize, 0, pf_memsize),
+    DESCRIPTION(
+      "<p>This element limits the number of bytes of received samples per "
+      "receive thread that may be held by referencing the receive buffers "
+      "(see Internal/ZeroCopyReceiveMinSize). Once the limit is reached, "
+      "received samples are copied until readers release enough of the "
+      "samples they hold.</p>"),
+    UNIT("memsize")),
+  STRING("ScatterGatherMinSize", NULL, 1, "0 B",
+    MEMBER(scatter_gather_min_size),
+    FUNCTIONS(0, uf_memsize, 0, pf_memsize),
+    DESCRIPTION(
+      "<p>This element sets the minimum size of a sequence of a primitive "
+      "type in a sample being written for it to be transmitted directly from "
+      "the application's memory rather than first being copied into the "
+      "serialized sample. It only applies to writers using XCDR1 that have a "
+      "latency budget of 0 and for which write batching is disabled. The "
+      "sample is still copied if it needs to be stored in the writer history "
+      "cache or is delivered to a local reader. A value of 0 disables it.</p>"),
+    UNIT("memsize")),
+  BOOL("SendBatching", NULL, 1, "false",
+    MEMBER(send_batching),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether a packet addressed to multiple "
+      "unicast destinations is sent using a single system call (sendmmsg) "
+      "and whether consecutive packets of equal size queued for "
+      "transmission to the same destinations (as happens for the fragments "
+      "of large samples published by writers with a non-zero latency "
+      "budget) are combined into a single system call using UDP generic "
+      "segmentation offload. This is currently only supported on Linux, "
+      "elsewhere, and when a bandwidth limit, packet loss simulation or "
+      "RTPS message protection is in use, packets are always sent one at "
+      "a time.</p>")),
   GROUP("ControlTopic", control_topic_cfgelems, control_topic_cfgattrs, 1,
     NOMEMBER,
     NOFUNCTIONS,
@@ -1794,6 +1947,36 @@ static struct cfgelem discovery_cfgelems[] = {
       "disappeared, allowing reconnect without loss of data when the "
       "discovery service restarts (or another instance takes over).</p>"),
     UNIT("duration_inf")),
+  STRING("CacheFile", NULL, 1, "",
+    MEMBER(discovery_cache_file),
+    FUNCTIONS(0, uf_string, ff_free, pf_string),
+    DESCRIPTION(
+      "<p>This element specifies the name of a file in which the "
+      "participants and endpoints discovered in the domain are recorded, "
+      "together with their QoS settings and locators. On start-up, the "
+      "recently seen ones are used to create provisional proxies, so that "
+      "matching and the first exchange of data can take place without "
+      "waiting for the discovery protocol. These proxies are removed "
+      "again when their lease expires, unless the remote participant "
+      "confirms its existence. The default, an empty string, disables the "
+      "cache.</p>\n"
+      "<p>The file must not be shared by processes running at the same "
+      "time, nor by different domains in a process, as each overwrites it "
+      "with its own view. Use a name that is unique to the process, for "
+      "example by substituting an environment variable that identifies "
+      "the application instance or ${CYCLONEDDS_DOMAIN_ID}, as in "
+      "\"/var/tmp/app-${APP_INSTANCE}-${CYCLONEDDS_DOMAIN_ID}.ddc\". "
+      "${CYCLONEDDS_PID} also gives a unique name, but then a "
+      "restarted process does not find the file written by its "
+      "predecessor.</p>")),
+  STRING("CacheMaxAge", NULL, 1, "1 hr",
+    MEMBER(discovery_cache_max_age),
+    FUNCTIONS(0, uf_duration_inf, 0, pf_duration),
+    DESCRIPTION(
+      "<p>This element specifies for how long a remote participant "
+      "recorded in the discovery cache (see Discovery/CacheFile) remains "
+      "eligible for use on start-up after it was last seen.</p>"),
+    UNIT("duration_inf")),
   GROUP("Peers", discovery_peers_cfgelems, NULL, 1,
     NOMEMBER,
     NOFUNCTIONS,
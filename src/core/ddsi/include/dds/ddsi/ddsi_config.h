@@ -75,6 +75,15 @@ enum ddsi_shm_loglevel {
 #define DDSI_PARTICIPANT_INDEX_AUTO -1
 #define DDSI_PARTICIPANT_INDEX_NONE -2
 
+/* Upper bound for Internal/UnicastReceiveThreads */
+#define DDSI_MAX_UNICAST_RECV_THREADS 16
+
+/* Upper bound for Internal/EventThreads */
+#define DDSI_MAX_XEVENT_THREADS 16
+
+/* Upper bound for Internal/DiscoveryThreads */
+#define DDSI_MAX_DISCOVERY_THREADS 16
+
 /* ddsi_config_listelem must be an overlay for all used listelem types */
 struct ddsi_config_listelem {
   struct ddsi_config_listelem *next;
@@ -283,12 +292,18 @@ struct ddsi_config
   int64_t liveliness_monitoring_interval;
   int prioritize_retransmit;
   enum ddsi_boolean_default multiple_recv_threads;
+  int unicast_recv_threads;
+  int xevent_threads;
+  int discovery_threads;
   unsigned recv_thread_stop_maxretries;
+  unsigned recv_batch_size;
+  int send_batching;
 
   unsigned primary_reorder_maxsamples;
   unsigned secondary_reorder_maxsamples;
 
   unsigned delivery_queue_maxsamples;
+  int lockfree_delivery_queues;
 
   uint16_t fragment_size;
   uint32_t max_msg_size;
@@ -341,6 +356,9 @@ struct ddsi_config
   int xmit_lossiness;           /**<< fraction of packets to drop on xmit, in units of 1e-3 */
   uint32_t rmsg_chunk_size;          /**<< size of a chunk in the receive buffer */
   uint32_t rbuf_size;                /* << size of a single receiver buffer */
+  uint32_t zerocopy_receive_min_size;
+  uint32_t zerocopy_receive_max_pinned;
+  uint32_t scatter_gather_min_size;
   enum ddsi_besmode besmode;
   int meas_hb_to_ack_latency;
   int unicast_response_to_spdp_messages;
@@ -354,9 +372,13 @@ struct ddsi_config
   uint32_t whc_highwater_mark;
   struct ddsi_config_maybe_uint32 whc_init_highwater_mark;
   int whc_adaptive;
+  int whc_fifo;
+  int lazy_write_key;
+  int share_loaned_samples;
 
   unsigned defrag_unreliable_maxsamples;
   unsigned defrag_reliable_maxsamples;
+  int defrag_sample_ring;
   unsigned accelerate_rexmit_block_size;
   int64_t responsiveness_timeout;
   uint32_t max_participants;
@@ -370,6 +392,8 @@ struct ddsi_config
   int64_t schedule_time_rounding;
   int64_t auto_resched_nack_delay;
   int64_t ds_grace_period;
+  char *discovery_cache_file;
+  int64_t discovery_cache_max_age;
 #ifdef DDS_HAS_BANDWIDTH_LIMITING
   uint32_t auxiliary_bandwidth_limit; /* bytes/second */
 #endif
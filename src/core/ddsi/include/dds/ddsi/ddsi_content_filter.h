@@ -0,0 +1,90 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_CONTENT_FILTER_H
+#define DDSI_CONTENT_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "dds/export.h"
+#include "dds/ddsrt/retcode.h"
+#include "dds/ddsi/ddsi_plist.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Content filters that can be evaluated by writers on behalf of remote
+   readers.  A reader advertises the filter class name, expression and
+   parameters in the ContentFilterProperty of its discovery data and if a
+   class of that name has been registered with the domain of a matching
+   writer, that writer evaluates the filter for each sample and does not send
+   the sample to a proxy participant none of whose matched readers accepts it
+   (sending GAPs to its reliable readers instead).
+
+   Filtering is per proxy participant rather than per proxy reader because a
+   GAP addressed to a single reader is applied to all in-sync readers of the
+   proxy writer in a Cyclone DDS receiver. */
+
+struct ddsi_domaingv;
+struct ddsi_serdata;
+struct writer;
+struct proxy_reader;
+struct wr_prd_match;
+
+typedef bool (*ddsi_content_filter_fn) (const void *sample, const char *expression, uint32_t nparams, const char * const *params, void *arg);
+
+struct ddsi_content_filter_class {
+  struct ddsi_content_filter_class *next;
+  char *name;
+  ddsi_content_filter_fn fn;
+  void *arg;
+};
+
+/* Content filter bound to an expression and parameters */
+struct ddsi_content_filter {
+  ddsi_content_filter_fn fn;
+  void *arg;
+  nn_content_filter_property_t prop;
+};
+
+void ddsi_content_filter_init_classes (struct ddsi_domaingv *gv);
+void ddsi_content_filter_fini_classes (struct ddsi_domaingv *gv);
+
+/* Registers a filter class; registering the same name twice is an error */
+DDS_EXPORT dds_return_t ddsi_content_filter_register_class (struct ddsi_domaingv *gv, const char *name, ddsi_content_filter_fn fn, void *arg);
+
+/* Returns a new filter if the class of prop has been registered, NULL otherwise */
+DDS_EXPORT struct ddsi_content_filter *ddsi_content_filter_new (struct ddsi_domaingv *gv, const nn_content_filter_property_t *prop);
+DDS_EXPORT void ddsi_content_filter_free (struct ddsi_content_filter *cf);
+DDS_EXPORT bool ddsi_content_filter_accepts (const struct ddsi_content_filter *cf, const void *sample);
+
+void ddsi_content_filter_property_copy (nn_content_filter_property_t *dst, const nn_content_filter_property_t *src);
+void ddsi_content_filter_property_fini (nn_content_filter_property_t *prop);
+
+/* Evaluates the filters of the matched readers of the proxy participant of *m
+   (stopping at the first that accepts), sets *m to the first match of the next
+   proxy participant and returns whether any accepts serdata.  The sample is
+   deserialized into *sample on first use, to be freed with
+   ddsi_content_filter_free_sample; wr->e.lock must be held */
+bool ddsi_content_filter_next_participant (const struct writer *wr, const struct wr_prd_match **m, struct ddsi_serdata *serdata, void **sample);
+void ddsi_content_filter_free_sample (const struct writer *wr, void *sample);
+
+/* filter_fn_t for proxy readers with a content filter, for use in handling
+   retransmit requests: true iff some matched reader of wr accepts the sample,
+   consistent with the original transmission; wr->e.lock must be held */
+int ddsi_proxy_reader_content_filter (struct writer *wr, struct proxy_reader *prd, struct ddsi_serdata *serdata);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_CONTENT_FILTER_H */
@@ -0,0 +1,96 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_DISCOVERY_CACHE_H
+#define DDSI_DISCOVERY_CACHE_H
+
+#include <stdint.h>
+#include "dds/export.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsi/ddsi_guid.h"
+#include "dds/ddsi/q_rtps.h"
+#include "dds/ddsi/q_protocol.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* The discovery cache records the SPDP and SEDP samples of the remote
+   participants and endpoints discovered in a domain in a file
+   (Discovery/CacheFile), so that after a restart they can be fed through the
+   regular discovery handlers to create provisional proxies without waiting
+   for the discovery protocol.  A provisional proxy participant simply has the
+   lease advertised in its SPDP sample and disappears unless the real
+   participant renews it.
+
+   Samples are stored in their serialized form, with the information from
+   the receiver state that is needed to interpret them.  The file is
+   rewritten shortly after a change and on shutdown; it is in native byte
+   order and only meant to be used on the machine that wrote it. */
+
+struct ddsi_domaingv;
+struct ddsi_serdata;
+struct receiver_state;
+struct ddsi_discovery_cache;
+
+enum ddsi_discovery_cache_kind {
+  DDSI_DCK_PARTICIPANT,
+  DDSI_DCK_WRITER,
+  DDSI_DCK_READER
+};
+
+struct ddsi_discovery_cache_entry {
+  ddsi_guid_t guid;
+  enum ddsi_discovery_cache_kind kind;
+  ddsi_guid_prefix_t src_guid_prefix;
+  nn_vendorid_t vendorid;
+  nn_protocol_version_t protocol_version;
+  seqno_t seq;
+  ddsrt_wctime_t timestamp; /* source timestamp of the sample */
+  ddsrt_wctime_t tseen; /* last time the participant was seen */
+  uint32_t size; /* including the 4-byte encoding header */
+  unsigned char *data;
+};
+
+typedef void (*ddsi_discovery_cache_restore_fn_t) (const struct ddsi_discovery_cache_entry *entry, void *arg);
+
+/** @brief Creates the discovery cache and loads the contents of the cache file, if any */
+DDS_EXPORT struct ddsi_discovery_cache *ddsi_discovery_cache_new (struct ddsi_domaingv *gv);
+
+/** @brief Frees the discovery cache without writing it */
+DDS_EXPORT void ddsi_discovery_cache_free (struct ddsi_discovery_cache *dc);
+
+/** @brief Stops writing the cache file in the background; must be called while the event queue is still running */
+DDS_EXPORT void ddsi_discovery_cache_stop (struct ddsi_discovery_cache *dc);
+
+/** @brief Writes the cache file if its contents changed */
+DDS_EXPORT void ddsi_discovery_cache_write (struct ddsi_discovery_cache *dc);
+
+/** @brief Invokes @p fn for the loaded participants that have been seen recently enough, then for their endpoints
+ *
+ * Entries that are too old or that belong to a participant that is too old are dropped.  The
+ * callback is invoked on a copy of the entry without holding any locks. */
+DDS_EXPORT void ddsi_discovery_cache_restore (struct ddsi_discovery_cache *dc, ddsi_discovery_cache_restore_fn_t fn, void *arg);
+
+/** @brief Records the serialized sample that resulted in the proxy participant or proxy endpoint @p guid
+ *
+ * Endpoints are only recorded if their participant is. If the cache already contains the sample
+ * with sequence number @p seq, it only updates the time the participant was last seen. */
+DDS_EXPORT void ddsi_discovery_cache_update (struct ddsi_discovery_cache *dc, enum ddsi_discovery_cache_kind kind, const ddsi_guid_t *guid, const struct receiver_state *rst, seqno_t seq, const struct ddsi_serdata *serdata);
+
+/** @brief Removes the entry for @p guid, the endpoints of a participant are dropped when the file is written */
+DDS_EXPORT void ddsi_discovery_cache_remove (struct ddsi_discovery_cache *dc, const ddsi_guid_t *guid);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_DISCOVERY_CACHE_H */
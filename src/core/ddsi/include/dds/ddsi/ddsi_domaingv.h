@@ -21,6 +21,7 @@
 #include "dds/ddsrt/sockets.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/fibheap.h"
+#include "dds/ddsrt/timewheel.h"
 
 #include "dds/ddsi/ddsi_plist.h"
 #include "dds/ddsi/ddsi_ownip.h"
@@ -41,6 +42,9 @@ struct addrset;
 struct xeventq;
 struct gcreq_queue;
 struct entity_index;
+struct ddsi_content_filter_class;
+struct ddsi_discovery_cache;
+struct ddsi_qos_intern;
 struct lease;
 struct ddsi_tran_conn;
 struct ddsi_tran_listener;
@@ -80,6 +84,7 @@ struct recv_thread_arg {
     } single;
     struct {
       os_sockWaitset ws;
+      struct ddsi_tran_conn *conn; /* if non-null: only socket handled by this thread */
     } many;
   } u;
 };
@@ -96,19 +101,29 @@ struct ddsi_domaingv {
 
   struct ddsi_tkmap * m_tkmap;
 
+  /* Shared, immutable QoS objects of proxy endpoints */
+  struct ddsi_qos_intern *qos_intern;
+
   /* Hash tables for participants, readers, writers, proxy
      participants, proxy readers and proxy writers by GUID. */
   struct entity_index *entity_index;
 
-  /* Timed events admin */
+  /* Timed events admin; writers and proxy writers may be assigned to the
+     extra queues (see xeventq_for_guid) */
   struct xeventq *xevents;
+  uint32_t n_xevents_extra;
+  struct xeventq *xevents_extra[DDSI_MAX_XEVENT_THREADS - 1];
+
+  /* Content filter classes registered for writer-side filtering */
+  ddsrt_mutex_t content_filter_classes_lock;
+  struct ddsi_content_filter_class *content_filter_classes;
 
   /* Queue for garbage collection requests */
   struct gcreq_queue *gcreq_queue;
 
   /* Lease junk */
   ddsrt_mutex_t leaseheap_lock;
-  ddsrt_fibheap_t leaseheap;
+  ddsrt_timewheel_t leasewheel;
 
   /* Transport factories & selected factory */
   struct ddsi_tran_factory *ddsi_tran_factories;
@@ -124,6 +139,11 @@ struct ddsi_domaingv {
   struct ddsi_tran_conn * disc_conn_uc;
   struct ddsi_tran_conn * data_conn_uc;
 
+  /* Additional sockets bound to the unicast data port, one per additional
+     unicast receive thread (see Internal/UnicastReceiveThreads) */
+  uint32_t n_data_conn_uc_extra;
+  struct ddsi_tran_conn * data_conn_uc_extra[DDSI_MAX_UNICAST_RECV_THREADS - 1];
+
   /* Connection used for all output (for connectionless transports), this
      used to simply be data_conn_uc, but:
 
@@ -219,10 +239,11 @@ struct ddsi_domaingv {
      trigger socket.) Receive buffer pool is per receive thread,
      it is only a global variable because it needs to be freed way later
      than the receive thread itself terminates */
-#define MAX_RECV_THREADS 3
+#define MAX_RECV_THREADS (2 + DDSI_MAX_UNICAST_RECV_THREADS)
   uint32_t n_recv_threads;
   struct recv_thread {
     const char *name;
+    char name_buf[16];
     struct thread_state1 *ts;
     struct recv_thread_arg arg;
   } recv_threads[MAX_RECV_THREADS];
@@ -266,8 +287,21 @@ struct ddsi_domaingv {
   struct nn_reorder *spdp_reorder;
 
   /* Built-in stuff other than SPDP gets funneled through the builtins
-     delivery queue; currently just SEDP and PMD */
+     delivery queue; currently just SEDP and PMD.  With multiple discovery
+     threads, the remote participants are distributed over the builtins
+     queue and the extra ones (see builtins_dqueue_for_prefix).  The
+     discovery locks serialize the creation and deletion of the proxies
+     of any given participant, should its discovery data arrive through
+     different queues (e.g., when relayed by another participant), and
+     are indexed the same way. */
   struct nn_dqueue *builtins_dqueue;
+  uint32_t n_builtins_dqueues_extra;
+  struct nn_dqueue *builtins_dqueues_extra[DDSI_MAX_DISCOVERY_THREADS - 1];
+  ddsrt_mutex_t discovery_lock[DDSI_MAX_DISCOVERY_THREADS];
+
+  /* Persistent cache of discovered participants and endpoints, NULL unless
+     Discovery/CacheFile is set */
+  struct ddsi_discovery_cache *discovery_cache;
 
   struct debug_monitor *debmon;
 
@@ -50,6 +50,18 @@ struct entidx_enum
 #endif
 };
 
+#define ENTIDX_ENUM_ENDPOINTS_INLINE 16
+
+struct entidx_enum_endpoints
+{
+  struct entity_common **eps;
+  uint32_t n, i;
+  struct entity_common *eps_inline[ENTIDX_ENUM_ENDPOINTS_INLINE];
+#ifndef NDEBUG
+  vtime_t vtime;
+#endif
+};
+
 /* Readers & writers are both in a GUID- and in a GID-keyed table. If
    they are in the GID-based one, they are also in the GUID-based one,
    but not the way around, for two reasons:
@@ -116,9 +128,6 @@ struct entidx_enum_proxy_writer { struct entidx_enum st; };
 struct entidx_enum_proxy_reader { struct entidx_enum st; };
 
 void entidx_enum_init (struct entidx_enum *st, const struct entity_index *ei, enum entity_kind kind) ddsrt_nonnull_all;
-void entidx_enum_init_topic (struct entidx_enum *st, const struct entity_index *gh, enum entity_kind kind, const char *topic, struct match_entities_range_key *max) ddsrt_nonnull_all;
-void entidx_enum_init_topic_w_prefix (struct entidx_enum *st, const struct entity_index *ei, enum entity_kind kind, const char *topic, const ddsi_guid_prefix_t *prefix, struct match_entities_range_key *max) ddsrt_nonnull_all;
-void *entidx_enum_next_max (struct entidx_enum *st, const struct match_entities_range_key *max) ddsrt_nonnull_all;
 void *entidx_enum_next (struct entidx_enum *st) ddsrt_nonnull_all;
 void entidx_enum_fini (struct entidx_enum *st) ddsrt_nonnull_all;
 
@@ -143,6 +152,23 @@ void entidx_enum_proxy_reader_fini (struct entidx_enum_proxy_reader *st) ddsrt_n
 void entidx_enum_participant_fini (struct entidx_enum_participant *st) ddsrt_nonnull_all;
 void entidx_enum_proxy_participant_fini (struct entidx_enum_proxy_participant *st) ddsrt_nonnull_all;
 
+/* Enumeration of the (proxy) readers or writers of the topic of endpoint "ep":
+
+   - "next" visits all endpoints of the specified kind and topic that
+     were in the index at the time of calling init, each exactly once
+     and in arbitrary order, including those that have subsequently been
+     removed (but not yet freed, as the calling thread is awake);
+
+   - it does not visit endpoints added after calling init, and it costs
+     time proportional to the number of endpoints of the topic, not to the
+     number of entities in the index;
+
+   - "ep" must have been inserted in the index, if it has since been
+     removed, there is nothing to visit. */
+void entidx_enum_endpoints_init (struct entidx_enum_endpoints *st, const struct entity_index *ei, enum entity_kind kind, const struct entity_common *ep) ddsrt_nonnull_all;
+void *entidx_enum_endpoints_next (struct entidx_enum_endpoints *st) ddsrt_nonnull_all;
+void entidx_enum_endpoints_fini (struct entidx_enum_endpoints *st) ddsrt_nonnull_all;
+
 #ifdef DDS_HAS_TOPIC_DISCOVERY
 void entidx_insert_topic_guid (struct entity_index *ei, struct topic *tp) ddsrt_nonnull_all;
 void entidx_remove_topic_guid (struct entity_index *ei, struct topic *tp) ddsrt_nonnull_all;
@@ -0,0 +1,82 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_QOS_INTERN_H
+#define DDSI_QOS_INTERN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "dds/export.h"
+#include "dds/ddsi/ddsi_xqos.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Proxy endpoints in large systems mostly have byte-identical QoS, so rather
+   than giving each its own copy, they share a reference-counted, immutable
+   copy from a table of all such QoS objects.  Each interned QoS has an id
+   that is never reused, so that QoS matching results can be cached by id
+   without risk of confusing a new QoS object with an old one that happened
+   to be allocated at the same address. */
+
+struct ddsi_qos_intern;
+struct gcreq_queue;
+
+/** @brief Creates an empty table of interned QoS objects */
+DDS_EXPORT struct ddsi_qos_intern *ddsi_qos_intern_new (void);
+
+/** @brief Frees the table, all interned QoS objects must have been released */
+DDS_EXPORT void ddsi_qos_intern_free (struct ddsi_qos_intern *qi);
+
+/**
+ * @brief Looks up a QoS object equal to @p xqos, creating one if there is none
+ *
+ * @param[in] qi    table of interned QoS objects
+ * @param[in] xqos  QoS to look up, not referenced after return
+ *
+ * @returns a reference to an interned QoS object equal to @p xqos, which must not be modified
+ */
+DDS_EXPORT dds_qos_t *ddsi_qos_intern_ref (struct ddsi_qos_intern *qi, const dds_qos_t *xqos);
+
+/** @brief Releases a reference obtained from @ref ddsi_qos_intern_ref */
+DDS_EXPORT void ddsi_qos_intern_unref (struct ddsi_qos_intern *qi, const dds_qos_t *xqos);
+
+/** @brief Releases a reference once all threads that may still be using it have moved on */
+DDS_EXPORT void ddsi_qos_intern_unref_gc (struct ddsi_qos_intern *qi, struct gcreq_queue *gcreq_queue, const dds_qos_t *xqos);
+
+/** @brief Returns the id of an interned QoS object, ids are never 0 */
+DDS_EXPORT uint64_t ddsi_qos_intern_id (const dds_qos_t *xqos);
+
+#define DDSI_QOS_MATCH_CACHE_SIZE 8
+
+struct ddsi_qos_match_cache_entry {
+  uint64_t id;
+  bool match;
+  dds_qos_policy_id_t reason;
+};
+
+/* Direct-mapped cache of the results of matching the QoS of a local endpoint
+   with interned QoS objects of proxy endpoints, protected by the qos_lock of
+   the local endpoint and cleared whenever its QoS changes. */
+struct ddsi_qos_match_cache {
+  struct ddsi_qos_match_cache_entry e[DDSI_QOS_MATCH_CACHE_SIZE];
+};
+
+DDS_EXPORT void ddsi_qos_match_cache_init (struct ddsi_qos_match_cache *mc);
+DDS_EXPORT bool ddsi_qos_match_cache_lookup (const struct ddsi_qos_match_cache *mc, uint64_t id, bool *match, dds_qos_policy_id_t *reason);
+DDS_EXPORT void ddsi_qos_match_cache_insert (struct ddsi_qos_match_cache *mc, uint64_t id, bool match, dds_qos_policy_id_t reason);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_QOS_INTERN_H */
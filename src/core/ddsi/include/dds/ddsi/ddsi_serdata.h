@@ -176,6 +176,30 @@ typedef uint32_t(*ddsi_serdata_iox_size_t) (const struct ddsi_serdata* d);
 typedef struct ddsi_serdata* (*ddsi_serdata_from_iox_t) (const struct ddsi_sertype* type, enum ddsi_serdata_kind kind, void* sub, void* buffer);
 #endif
 
+/* Construct a serdata from an application sample like from_sample, except that the
+   serdata may reference sequences of at least min_ref_size bytes in the sample rather
+   than copying them (optional; if absent, from_sample is used)
+   - a serdata so constructed is only valid for as long as the sample is, and may only
+     be passed to get_size, to_ser, to_ser_ref, to_ser_unref, to_untyped, eqkey, print,
+     get_keyhash and detach until it has been detached
+   - such a serdata must therefore be detached before anything that may hold on to it
+     beyond the lifetime of the sample gets it (WHC, local readers) */
+typedef struct ddsi_serdata * (*ddsi_serdata_from_sample_ref_t) (const struct ddsi_sertype *type, enum ddsi_serdata_kind kind, const void *sample, uint32_t min_ref_size);
+
+/* Copy any memory referenced by a serdata obtained from from_sample_ref into the
+   serdata (optional, no-op for other serdatas and for serdatas already detached)
+   - the serdata may not be in use by another thread */
+typedef void (*ddsi_serdata_detach_t) (struct ddsi_serdata *d);
+
+/* Construct a serdata from an application sample like from_sample, except that the
+   key need not be computed (optional; if absent, from_sample is used)
+   - a serdata so constructed may lack a key, in which case its hash is meaningless and
+     it may only be passed to get_size, to_ser, to_ser_ref, to_ser_unref, to_sample,
+     print, get_keyhash, detach and free
+   - it can therefore not be used for looking up an instance in the tkmap, nor be stored
+     in a reader history cache or a writer history cache that indexes by instance */
+typedef struct ddsi_serdata * (*ddsi_serdata_from_sample_lazykey_t) (const struct ddsi_sertype *type, enum ddsi_serdata_kind kind, const void *sample);
+
 struct ddsi_serdata_ops {
   ddsi_serdata_eqkey_t eqkey;
   ddsi_serdata_size_t get_size;
@@ -196,11 +220,16 @@ struct ddsi_serdata_ops {
   ddsi_serdata_iox_size_t get_sample_size;
   ddsi_serdata_from_iox_t from_iox_buffer;
 #endif
+  ddsi_serdata_from_sample_ref_t from_sample_ref;
+  ddsi_serdata_detach_t detach;
+  ddsi_serdata_from_sample_lazykey_t from_sample_lazykey;
 };
 
 #define DDSI_SERDATA_HAS_PRINT 1
 #define DDSI_SERDATA_HAS_FROM_SER_IOV 1
 #define DDSI_SERDATA_HAS_GET_KEYHASH 1
+#define DDSI_SERDATA_HAS_FROM_SAMPLE_REF 1
+#define DDSI_SERDATA_HAS_FROM_SAMPLE_LAZYKEY 1
 
 DDS_EXPORT void ddsi_serdata_init (struct ddsi_serdata *d, const struct ddsi_sertype *type, enum ddsi_serdata_kind kind);
 
@@ -270,6 +299,25 @@ DDS_INLINE_EXPORT inline struct ddsi_serdata *ddsi_serdata_from_sample (const st
   return type->serdata_ops->from_sample (type, kind, sample);
 }
 
+DDS_INLINE_EXPORT inline struct ddsi_serdata *ddsi_serdata_from_sample_ref (const struct ddsi_sertype *type, enum ddsi_serdata_kind kind, const void *sample, uint32_t min_ref_size) {
+  if (type->serdata_ops->from_sample_ref)
+    return type->serdata_ops->from_sample_ref (type, kind, sample, min_ref_size);
+  else
+    return type->serdata_ops->from_sample (type, kind, sample);
+}
+
+DDS_INLINE_EXPORT inline struct ddsi_serdata *ddsi_serdata_from_sample_lazykey (const struct ddsi_sertype *type, enum ddsi_serdata_kind kind, const void *sample) {
+  if (type->serdata_ops->from_sample_lazykey)
+    return type->serdata_ops->from_sample_lazykey (type, kind, sample);
+  else
+    return type->serdata_ops->from_sample (type, kind, sample);
+}
+
+DDS_INLINE_EXPORT inline void ddsi_serdata_detach (struct ddsi_serdata *d) {
+  if (d->ops->detach)
+    d->ops->detach (d);
+}
+
 DDS_INLINE_EXPORT inline struct ddsi_serdata *ddsi_serdata_to_untyped (const struct ddsi_serdata *d) {
   return d->ops->to_untyped (d);
 }
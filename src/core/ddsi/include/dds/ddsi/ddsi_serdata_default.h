@@ -13,6 +13,7 @@
 #define DDSI_SERDATA_DEFAULT_H
 
 #include "dds/ddsrt/endian.h"
+#include "dds/ddsrt/atomics.h"
 #include "dds/ddsi/q_protocol.h" /* for nn_parameterid_t */
 #include "dds/ddsi/q_freelist.h"
 #include "dds/ddsrt/avl.h"
@@ -26,6 +27,8 @@ extern "C" {
 #endif
 
 struct ddsi_typeid_t;
+struct nn_rmsg;
+struct dds_ostream_extrefs;
 
 struct CDRHeader {
   unsigned short identifier;
@@ -73,7 +76,11 @@ struct ddsi_serdata_default_key {
   DDSI_SERDATA_DEFAULT_DEBUG_FIELDS   \
   struct ddsi_serdata_default_key key;\
   struct serdatapool *serpool;        \
-  struct ddsi_serdata_default *next /* in pool->freelist */
+  struct ddsi_serdata_default *next; /* in pool->freelist */ \
+  struct nn_rmsg *rmsg; /* if non-null: header & data in rmsg, at hdr_ref */ \
+  const struct CDRHeader *hdr_ref; /* if non-null and rmsg null: owned copy */ \
+  struct dds_ostream_extrefs *extrefs; /* if non-null: data references sample until detached */ \
+  ddsrt_atomic_voidp_t shared_sample /* if non-null: deserialized sample shared by loans */
 #define DDSI_SERDATA_DEFAULT_POSTPAD  \
   struct CDRHeader hdr;               \
   char data[]
@@ -163,6 +170,11 @@ extern DDS_EXPORT const struct ddsi_serdata_ops ddsi_serdata_ops_xcdr2_nokey;
 struct serdatapool * ddsi_serdatapool_new (void);
 void ddsi_serdatapool_free (struct serdatapool * pool);
 
+/* Returns the deserialized form of a valid sample, constructing it on first use.
+   It is shared by everyone holding a reference to the serdata, lives as long as
+   the serdata does, and must be treated as read-only. */
+DDS_EXPORT const void *ddsi_serdata_default_shared_sample (struct ddsi_serdata *dcmn);
+
 #if defined (__cplusplus)
 }
 #endif
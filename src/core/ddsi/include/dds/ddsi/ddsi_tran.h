@@ -46,7 +46,9 @@ typedef struct ddsi_tran_qos ddsi_tran_qos_t;
 /* Function pointer types */
 
 typedef ssize_t (*ddsi_tran_read_fn_t) (ddsi_tran_conn_t, unsigned char *, size_t, bool, ddsi_locator_t *);
+typedef ssize_t (*ddsi_tran_read_batch_fn_t) (ddsi_tran_conn_t, size_t, unsigned char * const *, size_t, ssize_t *, ddsi_locator_t *);
 typedef ssize_t (*ddsi_tran_write_fn_t) (ddsi_tran_conn_t, const ddsi_locator_t *, size_t, const ddsrt_iovec_t *, uint32_t);
+typedef ssize_t (*ddsi_tran_write_multi_fn_t) (ddsi_tran_conn_t, size_t, const ddsi_locator_t *, size_t, const ddsrt_iovec_t *, uint32_t, uint32_t);
 typedef int (*ddsi_tran_locator_fn_t) (ddsi_tran_factory_t, ddsi_tran_base_t, ddsi_locator_t *);
 typedef bool (*ddsi_tran_supports_fn_t) (const struct ddsi_tran_factory *, int32_t);
 typedef ddsrt_socket_t (*ddsi_tran_handle_fn_t) (ddsi_tran_base_t);
@@ -113,7 +115,9 @@ struct ddsi_tran_conn
   /* Functions */
 
   ddsi_tran_read_fn_t m_read_fn;
+  ddsi_tran_read_batch_fn_t m_read_batch_fn; /* optional, may be null */
   ddsi_tran_write_fn_t m_write_fn;
+  ddsi_tran_write_multi_fn_t m_write_multi_fn; /* optional, may be null */
   ddsi_tran_peer_locator_fn_t m_peer_locator_fn;
   ddsi_tran_disable_multiplexing_fn_t m_disable_multiplexing_fn;
   ddsi_tran_locator_fn_t m_locator_fn;
@@ -124,6 +128,7 @@ struct ddsi_tran_conn
   bool m_connless;
   bool m_stream;
   bool m_closed;
+  bool m_gso; /* m_write_multi_fn supports segmentation offload */
   ddsrt_atomic_uint32_t m_count;
 
   /* Relationships */
@@ -225,6 +230,7 @@ struct ddsi_tran_qos
   enum ddsi_tran_qos_purpose m_purpose;
   int m_diffserv;
   struct nn_interface *m_interface; // only for purpose = XMIT
+  bool m_reuse_port; // only for purpose = RECV_UC, share port with other sockets (SO_REUSEPORT)
 };
 
 void ddsi_tran_factories_fini (struct ddsi_domaingv *gv);
@@ -280,6 +286,31 @@ DDS_INLINE_EXPORT inline ssize_t ddsi_conn_write (ddsi_tran_conn_t conn, const d
 DDS_INLINE_EXPORT inline ssize_t ddsi_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, size_t len, bool allow_spurious, ddsi_locator_t *srcloc) {
   return conn->m_closed ? -1 : conn->m_read_fn (conn, buf, len, allow_spurious, srcloc);
 }
+DDS_INLINE_EXPORT inline bool ddsi_conn_supports_read_batch (const struct ddsi_tran_conn *conn) {
+  return conn->m_read_batch_fn != 0;
+}
+/* Receives up to nbufs datagrams of at most len bytes each into bufs[0 .. nbufs-1], storing
+   their sizes in sizes[] and their sources in srclocs[]. Returns the number of datagrams
+   received, 0 for a spurious wakeup and -1 on error.  Transports that don't support it fall
+   back to reading a single datagram. */
+DDS_INLINE_EXPORT inline ssize_t ddsi_conn_read_batch (ddsi_tran_conn_t conn, size_t nbufs, unsigned char * const *bufs, size_t len, ssize_t *sizes, ddsi_locator_t *srclocs) {
+  if (conn->m_closed)
+    return -1;
+  else if (conn->m_read_batch_fn && nbufs > 1)
+    return conn->m_read_batch_fn (conn, nbufs, bufs, len, sizes, srclocs);
+  else if ((sizes[0] = conn->m_read_fn (conn, bufs[0], len, true, &srclocs[0])) <= 0)
+    return sizes[0];
+  else
+    return 1;
+}
+/* Sends the packet in iov[0 .. niov-1] to each of the ndst destinations in dsts, returning
+   the number of destinations it was sent to successfully or -1 if the connection is closed.
+   If segsize is not 0, the iovecs hold a train of packets that are all segsize bytes long
+   except possibly the last one, with packet boundaries coinciding with iovec boundaries.
+   This is passed as a single buffer to the kernel if the transport supports segmentation
+   offload, otherwise it is sent one packet at a time. */
+ssize_t ddsi_conn_write_multi (ddsi_tran_conn_t conn, size_t ndst, const ddsi_locator_t *dsts, size_t niov, const ddsrt_iovec_t *iov, uint32_t segsize, uint32_t flags);
+ssize_t ddsi_conn_write_segments (ddsi_tran_conn_t conn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t segsize, uint32_t flags);
 bool ddsi_conn_peer_locator (ddsi_tran_conn_t conn, ddsi_locator_t * loc);
 void ddsi_conn_disable_multiplexing (ddsi_tran_conn_t conn);
 void ddsi_conn_add_ref (ddsi_tran_conn_t conn);
@@ -15,14 +15,24 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+#include "dds/export.h"
+
 #if defined (__cplusplus)
 extern "C" {
 #endif
 
 struct addrset;
 struct writer;
+struct ddsi_wraddrset_cache;
+
+/** @brief Creates the state used for incrementally computing the address set of a writer */
+DDS_EXPORT struct ddsi_wraddrset_cache *ddsi_wraddrset_cache_new (void);
+
+/** @brief Frees the state used for computing the address set of a writer */
+DDS_EXPORT void ddsi_wraddrset_cache_free (struct ddsi_wraddrset_cache *wc);
 
-struct addrset *compute_writer_addrset (const struct writer *wr);
+/** @brief Computes the address set of a writer from its matched readers, wr->e.lock must be held */
+DDS_EXPORT struct addrset *compute_writer_addrset (struct writer *wr);
 
 #if defined (__cplusplus)
 }
@@ -12,8 +12,8 @@
 #ifndef NN_ADDRSET_H
 #define NN_ADDRSET_H
 
+#include "dds/export.h"
 #include "dds/ddsrt/sync.h"
-#include "dds/ddsrt/avl.h"
 #include "dds/ddsi/q_log.h"
 #include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/q_protocol.h"
@@ -23,29 +23,31 @@
 extern "C" {
 #endif
 
-typedef struct addrset_node {
-  ddsrt_avl_node_t avlnode;
-  ddsi_xlocator_t loc;
-} * addrset_node_t;
+/* Locators sorted by compare_xlocators; address sets typically contain only
+   a handful of them, and a sorted array is much more compact than a tree */
+struct addrset_locs {
+  uint32_t n, size;
+  ddsi_xlocator_t *locs;
+};
 
 struct addrset {
   ddsrt_mutex_t lock;
   ddsrt_atomic_uint32_t refc;
-  ddsrt_avl_ctree_t ucaddrs, mcaddrs;
+  struct addrset_locs ucaddrs, mcaddrs;
 };
 
 typedef void (*addrset_forall_fun_t) (const ddsi_xlocator_t *loc, void *arg);
 typedef ssize_t (*addrset_forone_fun_t) (const ddsi_xlocator_t *loc, void *arg);
 
-struct addrset *new_addrset (void);
+DDS_EXPORT struct addrset *new_addrset (void);
 struct addrset *ref_addrset (struct addrset *as);
-void unref_addrset (struct addrset *as);
+DDS_EXPORT void unref_addrset (struct addrset *as);
 void add_locator_to_addrset (const struct ddsi_domaingv *gv, struct addrset *as, const ddsi_locator_t *loc);
-void add_xlocator_to_addrset (const struct ddsi_domaingv *gv, struct addrset *as, const ddsi_xlocator_t *loc);
+DDS_EXPORT void add_xlocator_to_addrset (const struct ddsi_domaingv *gv, struct addrset *as, const ddsi_xlocator_t *loc);
 void remove_from_addrset (const struct ddsi_domaingv *gv, struct addrset *as, const ddsi_xlocator_t *loc);
 int addrset_purge (struct addrset *as);
 int compare_locators (const ddsi_locator_t *a, const ddsi_locator_t *b);
-int compare_xlocators (const ddsi_xlocator_t *a, const ddsi_xlocator_t *b);
+DDS_EXPORT int compare_xlocators (const ddsi_xlocator_t *a, const ddsi_xlocator_t *b);
 
 /* These lock ASADD, then lock/unlock AS any number of times, then
    unlock ASADD */
@@ -58,14 +60,14 @@ size_t addrset_count_uc (const struct addrset *as);
 size_t addrset_count_mc (const struct addrset *as);
 int addrset_empty_uc (const struct addrset *as);
 int addrset_empty_mc (const struct addrset *as);
-int addrset_empty (const struct addrset *as);
+DDS_EXPORT int addrset_empty (const struct addrset *as);
 int addrset_any_uc (const struct addrset *as, ddsi_xlocator_t *dst);
 int addrset_any_mc (const struct addrset *as, ddsi_xlocator_t *dst);
 void addrset_any_uc_else_mc_nofail (const struct addrset *as, ddsi_xlocator_t *dst);
 
 /* Keeps AS locked */
 int addrset_forone (struct addrset *as, addrset_forone_fun_t f, void *arg);
-void addrset_forall (struct addrset *as, addrset_forall_fun_t f, void *arg);
+DDS_EXPORT void addrset_forall (struct addrset *as, addrset_forall_fun_t f, void *arg);
 size_t addrset_forall_count (struct addrset *as, addrset_forall_fun_t f, void *arg);
 size_t addrset_forall_uc_else_mc_count (struct addrset *as, addrset_forall_fun_t f, void *arg);
 size_t addrset_forall_mc_count (struct addrset *as, addrset_forall_fun_t f, void *arg);
@@ -12,6 +12,7 @@
 #ifndef NN_DDSI_DISCOVERY_H
 #define NN_DDSI_DISCOVERY_H
 
+#include "dds/export.h"
 #include "dds/ddsi/q_unused.h"
 #include "dds/ddsi/ddsi_domaingv.h" // FIXME: MAX_XMIT_CONNS
 
@@ -26,6 +27,7 @@ struct reader;
 struct nn_rsample_info;
 struct nn_rdata;
 struct ddsi_plist;
+struct nn_dqueue;
 
 struct participant_builtin_topic_data_locators {
   struct nn_locators_one def_uni[MAX_XMIT_CONNS], meta_uni[MAX_XMIT_CONNS];
@@ -43,6 +45,30 @@ int sedp_write_reader (struct reader *rd);
 int sedp_dispose_unregister_writer (struct writer *wr);
 int sedp_dispose_unregister_reader (struct reader *rd);
 
+/** @brief Returns the delivery queue for the built-in topics of the remote participant with the given GUID prefix
+ *
+ * Discovery data of different remote participants is processed concurrently when multiple
+ * discovery threads are configured, but that of any given participant always goes through
+ * the same queue.
+ *
+ * @param[in] gv      domain
+ * @param[in] prefix  GUID prefix of the remote participant
+ *
+ * @returns the delivery queue to use
+ */
+DDS_EXPORT struct nn_dqueue *builtins_dqueue_for_prefix (const struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix);
+
+/**
+ * @brief Creates provisional proxy participants and endpoints from the discovery cache
+ *
+ * The cached SPDP and SEDP samples are processed as if they had just been received, the
+ * proxy participants thus created disappear when their lease expires unless the remote
+ * participant confirms their existence.
+ *
+ * @param[in] gv  domain, gv->discovery_cache must be non-NULL
+ */
+void restore_discovery_cache (struct ddsi_domaingv *gv);
+
 int builtins_dqueue_handler (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const ddsi_guid_t *rdguid, void *qarg);
 
 #if defined (__cplusplus)
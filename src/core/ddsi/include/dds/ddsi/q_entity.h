@@ -32,6 +32,7 @@
 #include "dds/ddsi/ddsi_typelookup.h"
 #include "dds/ddsi/ddsi_tran.h"
 #include "dds/ddsi/ddsi_list_genptr.h"
+#include "dds/ddsi/ddsi_qos_intern.h"
 
 #if defined (__cplusplus)
 extern "C" {
@@ -44,6 +45,7 @@ struct nn_dqueue;
 struct nn_rsample_info;
 struct nn_rdata;
 struct addrset;
+struct ddsi_wraddrset_cache;
 struct ddsi_sertype;
 struct whc;
 struct dds_qos;
@@ -134,6 +136,7 @@ struct wr_prd_match {
   seqno_t max_seq; /* sort-of highest ack'd seq nr in subtree (see augment function) */
   seqno_t seq; /* highest acknowledged seq nr */
   seqno_t last_seq; /* highest seq send to this reader used when filter is applied */
+  const struct ddsi_content_filter *content_filter; /* proxy reader's content filter if evaluated by writer, owned by the proxy reader */
   uint32_t num_reliable_readers_where_seq_equals_max;
   ddsi_guid_t arbitrary_unacked_reader;
   nn_count_t prev_acknack; /* latest accepted acknack sequence number */
@@ -208,6 +211,8 @@ struct entity_common {
   bool onlylocal;
   struct ddsi_domaingv *gv;
   ddsrt_avl_node_t all_entities_avlnode;
+  struct entidx_topic *entidx_topic; /* topic index entry of (proxy) reader/writer, protected by all_entities_lock */
+  uint32_t entidx_topic_idx; /* position in entidx_topic's array of endpoints of its kind, idem */
 
   /* QoS changes always lock the entity itself, and additionally
      (and within the scope of the entity lock) acquire qos_lock
@@ -317,6 +322,7 @@ struct writer
   int throttling; /* non-zero when some thread is waiting for the WHC to shrink */
   struct hbcontrol hbcontrol; /* controls heartbeat timing, piggybacking */
   struct dds_qos *xqos;
+  struct ddsi_qos_match_cache qos_match_cache; /* results of matching with proxies, protected by e.qos_lock */
   enum writer_state state;
   unsigned reliable: 1; /* iff 1, writer is reliable <=> heartbeat_xevent != NULL */
   unsigned handle_as_transient_local: 1; /* controls whether data is retained in WHC */
@@ -334,6 +340,7 @@ struct writer
   uint32_t alive_vclock; /* virtual clock counting transitions between alive/not-alive */
   const struct ddsi_sertype * type; /* type of the data written by this writer */
   struct addrset *as; /* set of addresses to publish to */
+  struct ddsi_wraddrset_cache *wras_cache; /* matched readers' locators for computing "as", protected by e.lock */
   struct addrset *as_group; /* alternate case, used for SPDP, when using Cloud with multiple bootstrap locators */
   struct xevent *heartbeat_xevent; /* timed event for "periodically" publishing heartbeats when unack'd data present, NULL <=> unreliable */
   struct ldur_fhnode *lease_duration; /* fibheap node to keep lease duration for this writer, NULL in case of automatic liveliness with inifite duration  */
@@ -347,6 +354,7 @@ struct writer
   uint32_t num_readers; /* total number of matching PROXY readers */
   uint32_t num_reliable_readers; /* number of matching reliable PROXY readers */
   uint32_t num_readers_requesting_keyhash; /* also +1 for protected keys and config override for generating keyhash */
+  uint32_t num_content_filtered_readers; /* number of matching PROXY readers with a content filter evaluated by this writer */
   ddsrt_avl_tree_t readers; /* all matching PROXY readers, see struct wr_prd_match */
   ddsrt_avl_tree_t local_readers; /* all matching LOCAL readers, see struct wr_rd_match */
 #ifdef DDS_HAS_NETWORK_PARTITIONS
@@ -389,6 +397,7 @@ struct reader
   void * status_cb_entity;
   struct ddsi_rhc * rhc; /* reader history, tracks registrations and data */
   struct dds_qos *xqos;
+  struct ddsi_qos_match_cache qos_match_cache; /* results of matching with proxies, protected by e.qos_lock */
   unsigned reliable: 1; /* 1 iff reader is reliable */
   unsigned handle_as_transient_local: 1; /* 1 iff reader wants historical data from proxy writers */
   unsigned request_keyhash: 1; /* really controlled by the sertype */
@@ -406,6 +415,7 @@ struct reader
   ddsrt_avl_tree_t local_writers; /* all matching LOCAL writers, see struct rd_wr_match */
   ddsi2direct_directread_cb_t ddsi2direct_cb;
   void *ddsi2direct_cbarg;
+  nn_content_filter_property_t *content_filter; /* advertised content filter, NULL if none */
 #ifdef DDS_HAS_SECURITY
   struct reader_sec_attributes *sec_attr;
 #endif
@@ -483,8 +493,8 @@ struct proxy_endpoint_common
   struct proxy_participant *proxypp; /* counted backref to proxy participant */
   struct proxy_endpoint_common *next_ep; /* next \ endpoint belonging to this proxy participant */
   struct proxy_endpoint_common *prev_ep; /* prev / -- this is in arbitrary ordering */
-  struct dds_qos *xqos; /* proxy endpoint QoS lives here; FIXME: local ones should have it moved to common as well */
-  struct addrset *as; /* address set to use for communicating with this endpoint */
+  struct dds_qos *xqos; /* proxy endpoint QoS lives here, interned in gv->qos_intern and therefore immutable; FIXME: local ones should have it moved to common as well */
+  struct addrset *as; /* address set to use for communicating with this endpoint; never modified in place, only replaced (see ddsi_wraddrset.c) */
   ddsi_guid_t group_guid; /* 0:0:0:0 if not available */
   nn_vendorid_t vendor; /* cached from proxypp->vendor */
   seqno_t seq; /* sequence number of most recent SEDP message */
@@ -554,6 +564,7 @@ struct proxy_reader {
   ddsrt_avl_tree_t writers; /* matching LOCAL writers */
   uint32_t receive_buffer_size; /* assumed receive buffer size inherited from proxypp */
   filter_fn_t filter;
+  struct ddsi_content_filter *content_filter; /* advertised content filter if its class is known locally, else NULL */
 };
 
 DDS_EXPORT extern const ddsrt_avl_treedef_t wr_readers_treedef;
@@ -729,7 +740,7 @@ DDS_EXPORT struct writer *get_builtin_writer (const struct participant *pp, unsi
    writer/reader already known. */
 
 dds_return_t new_writer (struct writer **wr_out, struct ddsi_guid *wrguid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct whc * whc, status_cb_t status_cb, void *status_cb_arg);
-dds_return_t new_reader (struct reader **rd_out, struct ddsi_guid *rdguid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct ddsi_rhc * rhc, status_cb_t status_cb, void *status_cb_arg);
+dds_return_t new_reader (struct reader **rd_out, struct ddsi_guid *rdguid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct ddsi_rhc * rhc, status_cb_t status_cb, void *status_cb_arg, const nn_content_filter_property_t *content_filter);
 
 void update_reader_qos (struct reader *rd, const struct dds_qos *xqos);
 void update_writer_qos (struct writer *wr, const struct dds_qos *xqos);
@@ -781,7 +792,7 @@ int writer_set_notalive (struct writer *wr, bool notify);
 /* Set when this proxy participant is not to be announced on the built-in topics yet */
 #define CF_PROXYPP_NO_SPDP                     (1 << 2)
 
-bool new_proxy_participant (struct ddsi_domaingv *gv, const struct ddsi_guid *guid, uint32_t bes, const struct ddsi_guid *privileged_pp_guid, struct addrset *as_default, struct addrset *as_meta, const struct ddsi_plist *plist, dds_duration_t tlease_dur, nn_vendorid_t vendor, unsigned custom_flags, ddsrt_wctime_t timestamp, seqno_t seq);
+DDS_EXPORT bool new_proxy_participant (struct ddsi_domaingv *gv, const struct ddsi_guid *guid, uint32_t bes, const struct ddsi_guid *privileged_pp_guid, struct addrset *as_default, struct addrset *as_meta, const struct ddsi_plist *plist, dds_duration_t tlease_dur, nn_vendorid_t vendor, unsigned custom_flags, ddsrt_wctime_t timestamp, seqno_t seq);
 DDS_EXPORT int delete_proxy_participant_by_guid (struct ddsi_domaingv *gv, const struct ddsi_guid *guid, ddsrt_wctime_t timestamp, int isimplicit);
 
 int update_proxy_participant_plist_locked (struct proxy_participant *proxypp, seqno_t seq, const struct ddsi_plist *datap, ddsrt_wctime_t timestamp);
@@ -807,7 +818,7 @@ int delete_proxy_topic_locked (struct proxy_participant *proxypp, struct proxy_t
 /* To create a new proxy writer or reader; the proxy participant is
    determined from the GUID and must exist. */
 int new_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid, const struct ddsi_guid *guid, struct addrset *as, const struct ddsi_plist *plist, struct nn_dqueue *dqueue, struct xeventq *evq, ddsrt_wctime_t timestamp, seqno_t seq);
-int new_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid, const struct ddsi_guid *guid, struct addrset *as, const struct ddsi_plist *plist, ddsrt_wctime_t timestamp, seqno_t seq
+DDS_EXPORT int new_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid, const struct ddsi_guid *guid, struct addrset *as, const struct ddsi_plist *plist, ddsrt_wctime_t timestamp, seqno_t seq
 #ifdef DDS_HAS_SSM
                       , int favours_ssm
 #endif
@@ -819,9 +830,9 @@ int new_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid,
    no outstanding references may still exist (determined by checking
    thread progress, &c.). */
 int delete_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *guid, ddsrt_wctime_t timestamp, int isimplicit);
-int delete_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *guid, ddsrt_wctime_t timestamp, int isimplicit);
+DDS_EXPORT int delete_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *guid, ddsrt_wctime_t timestamp, int isimplicit);
 
-void update_proxy_reader (struct proxy_reader *prd, seqno_t seq, struct addrset *as, const struct dds_qos *xqos, ddsrt_wctime_t timestamp);
+DDS_EXPORT void update_proxy_reader (struct proxy_reader *prd, seqno_t seq, struct addrset *as, const struct dds_qos *xqos, ddsrt_wctime_t timestamp);
 void update_proxy_writer (struct proxy_writer *pwr, seqno_t seq, struct addrset *as, const struct dds_qos *xqos, ddsrt_wctime_t timestamp);
 
 void proxy_writer_set_alive_may_unlock (struct proxy_writer *pwr, bool notify);
@@ -14,6 +14,7 @@
 
 #include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/fibheap.h"
+#include "dds/ddsrt/timewheel.h"
 #include "dds/ddsrt/time.h"
 
 #if defined (__cplusplus)
@@ -26,7 +27,7 @@ struct entity_common;
 struct ddsi_domaingv; /* FIXME: make a special for the lease admin */
 
 struct lease {
-  ddsrt_fibheap_node_t heapnode;
+  ddsrt_timewheel_node_t wheelnode;
   ddsrt_fibheap_node_t pp_heapnode;
   ddsrt_etime_t tsched;         /* access guarded by leaseheap_lock */
   ddsrt_atomic_uint64_t tend;   /* really an ddsrt_etime_t */
@@ -34,7 +35,6 @@ struct lease {
   struct entity_common *entity; /* constant */
 };
 
-int compare_lease_tsched (const void *va, const void *vb);
 int compare_lease_tdur (const void *va, const void *vb);
 void lease_management_init (struct ddsi_domaingv *gv);
 void lease_management_term (struct ddsi_domaingv *gv);
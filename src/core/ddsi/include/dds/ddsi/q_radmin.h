@@ -99,9 +99,6 @@ struct nn_rmsg {
      the real packet. */
   struct nn_rmsg_chunk *lastchunk;
 
-  /* whether to log */
-  bool trace;
-
   struct nn_rmsg_chunk chunk;
 };
 DDSRT_STATIC_ASSERT (sizeof (struct nn_rmsg) == offsetof (struct nn_rmsg, chunk) + sizeof (struct nn_rmsg_chunk));
@@ -216,22 +213,26 @@ struct ddsrt_log_cfg;
 struct nn_fragment_number_set_header;
 struct nn_sequence_number_set_header;
 
-struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size);
+struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size, uint32_t max_pinned_bytes);
 void nn_rbufpool_setowner (struct nn_rbufpool *rbp, ddsrt_thread_t tid);
 void nn_rbufpool_free (struct nn_rbufpool *rbp);
 
 struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbufpool);
+uint32_t nn_rmsg_new_batch (struct nn_rbufpool *rbufpool, uint32_t n, struct nn_rmsg **rmsgs);
+void nn_rmsg_end_batch (struct nn_rbufpool *rbufpool);
 void nn_rmsg_setsize (struct nn_rmsg *rmsg, uint32_t size);
 void nn_rmsg_commit (struct nn_rmsg *rmsg);
 void nn_rmsg_free (struct nn_rmsg *rmsg);
 void *nn_rmsg_alloc (struct nn_rmsg *rmsg, uint32_t size);
+bool nn_rmsg_pin (struct nn_rmsg *rmsg, uint32_t size);
+void nn_rmsg_unpin (struct nn_rmsg *rmsg, uint32_t size);
 
 struct nn_rdata *nn_rdata_new (struct nn_rmsg *rmsg, uint32_t start, uint32_t endp1, uint32_t submsg_offset, uint32_t payload_offset, uint32_t keyhash_offset);
 struct nn_rdata *nn_rdata_newgap (struct nn_rmsg *rmsg);
 void nn_fragchain_adjust_refcount (struct nn_rdata *frag, int adjust);
 void nn_fragchain_unref (struct nn_rdata *frag);
 
-struct nn_defrag *nn_defrag_new (const struct ddsrt_log_cfg *logcfg, enum nn_defrag_drop_mode drop_mode, uint32_t max_samples);
+struct nn_defrag *nn_defrag_new (const struct ddsrt_log_cfg *logcfg, enum nn_defrag_drop_mode drop_mode, uint32_t max_samples, bool use_ring);
 void nn_defrag_free (struct nn_defrag *defrag);
 struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo);
 void nn_defrag_notegap (struct nn_defrag *defrag, seqno_t min, seqno_t maxp1);
@@ -44,6 +44,12 @@ DDS_EXPORT void xeventq_free (struct xeventq *evq);
 DDS_EXPORT dds_return_t xeventq_start (struct xeventq *evq, const char *name); /* <0 => error, =0 => ok */
 DDS_EXPORT void xeventq_stop (struct xeventq *evq);
 
+/* Event queue to use for the entity with the given GUID: events for an entity
+   must always go to the same queue, so this is a fixed mapping that spreads
+   application writers and proxy writers over the queues configured with
+   Internal/EventThreads; built-in entities always map to gv->xevents */
+DDS_EXPORT struct xeventq *xeventq_for_guid (const struct ddsi_domaingv *gv, const ddsi_guid_t *guid);
+
 DDS_EXPORT void qxev_msg (struct xeventq *evq, struct nn_xmsg *msg);
 
 DDS_EXPORT void qxev_pwr_entityid (struct proxy_writer * pwr, const ddsi_guid_t *guid);
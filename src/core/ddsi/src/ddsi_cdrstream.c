@@ -128,6 +128,7 @@ void dds_ostream_init (dds_ostream_t * __restrict st, uint32_t size, uint32_t xc
   st->m_size = 0;
   st->m_index = 0;
   st->m_xcdr_version = xcdr_version;
+  st->m_extrefs = NULL;
   dds_cdr_resize (st, size);
 }
 
@@ -345,6 +346,30 @@ static void dds_os_put_bytes_aligned (dds_ostream_t * __restrict os, const void
   os->m_index += sz;
 }
 
+static bool dds_os_put_bytes_extref (dds_ostream_t * __restrict os, const void * __restrict data, uint32_t num, uint32_t elem_sz, uint32_t align)
+{
+  /* Records a reference to the data instead of copying it, but only reserves
+     (sz % 8) bytes in the stream to keep the alignment of everything that
+     follows the same as it would have been had the data been copied */
+  struct dds_ostream_extrefs * const x = os->m_extrefs;
+  const uint32_t sz = num * elem_sz;
+  if (sz < x->min_size)
+    return false;
+  if (x->n == x->max)
+  {
+    x->max = (x->max == 0) ? 4 : 2 * x->max;
+    x->refs = ddsrt_realloc (x->refs, x->max * sizeof (*x->refs));
+  }
+  dds_cdr_alignto_clear_and_resize (os, align, sz % 8);
+  x->refs[x->n].index = os->m_index;
+  x->refs[x->n].len = sz;
+  x->refs[x->n].ptr = data;
+  x->n++;
+  x->skipped += sz - sz % 8;
+  os->m_index += sz % 8;
+  return true;
+}
+
 static uint32_t get_type_size (enum dds_stream_typecode type)
 {
   DDSRT_STATIC_ASSERT (DDS_OP_VAL_1BY == 1 && DDS_OP_VAL_2BY == 2 && DDS_OP_VAL_4BY == 3 && DDS_OP_VAL_8BY == 4);
@@ -994,12 +1019,16 @@ static inline void dds_stream_to_LE_insitu (void * __restrict vbuf, uint32_t siz
 
 // Little-endian
 #define NAME_BYTE_ORDER_EXT LE
+#define BYTE_ORDER_IS_NATIVE (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN)
 #include "ddsi_cdrstream_write.part.c"
+#undef BYTE_ORDER_IS_NATIVE
 #undef NAME_BYTE_ORDER_EXT
 
 // Big-endian
 #define NAME_BYTE_ORDER_EXT BE
+#define BYTE_ORDER_IS_NATIVE (DDSRT_ENDIAN == DDSRT_BIG_ENDIAN)
 #include "ddsi_cdrstream_write.part.c"
+#undef BYTE_ORDER_IS_NATIVE
 #undef NAME_BYTE_ORDER_EXT
 
 // Map some write-native functions to their little-endian or big-endian equivalent
@@ -2728,6 +2757,223 @@ void dds_stream_read_key (dds_istream_t * __restrict is, char * __restrict sampl
   }
 }
 
+enum dds_stream_colstep_kind {
+  DDS_STREAM_COLSTEP_PRIM,    /* primitive member, read into a column or skipped */
+  DDS_STREAM_COLSTEP_STR,     /* string member, skipped */
+  DDS_STREAM_COLSTEP_PRIMSEQ, /* sequence of primitives, skipped */
+  DDS_STREAM_COLSTEP_PRIMARR, /* array of primitives, skipped */
+  DDS_STREAM_COLSTEP_ADR      /* anything else, skipped by interpreting the type */
+};
+
+struct dds_stream_colstep {
+  enum dds_stream_colstep_kind kind;
+  uint32_t size;       /* (element) size for PRIM, PRIMSEQ and PRIMARR */
+  uint32_t count;      /* number of elements for PRIMARR */
+  uint32_t col;        /* column to read a PRIM into, UINT32_MAX if not selected */
+  const uint32_t *ops; /* instructions for ADR */
+};
+
+struct dds_stream_columns {
+  const struct ddsi_sertype_default *type;
+  const struct dds_stream_column *cols;
+  uint32_t ncols;
+  bool dheader;        /* appendable type: members following the DHEADER may be absent */
+  bool has_dups;       /* some member is selected in more than one column */
+  uint32_t *dup_of;    /* dup_of[k] != k: column k is a copy of column dup_of[k] */
+  uint32_t nsteps;
+  struct dds_stream_colstep steps[];
+};
+
+static bool dds_stream_colstep_prim_size (enum dds_stream_typecode type, uint32_t *size)
+{
+  switch (type)
+  {
+    case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY: case DDS_OP_VAL_ENU:
+      *size = get_type_size (type);
+      return true;
+    default:
+      return false;
+  }
+}
+
+static void dds_stream_colstep_init (struct dds_stream_colstep *step, const uint32_t *ops)
+{
+  const uint32_t insn = *ops;
+  step->size = step->count = 0;
+  step->col = UINT32_MAX;
+  step->ops = ops;
+  switch (DDS_OP_TYPE (insn))
+  {
+    case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY: case DDS_OP_VAL_ENU:
+      step->kind = DDS_STREAM_COLSTEP_PRIM;
+      (void) dds_stream_colstep_prim_size (DDS_OP_TYPE (insn), &step->size);
+      break;
+    case DDS_OP_VAL_STR: case DDS_OP_VAL_BST: case DDS_OP_VAL_BSP:
+      step->kind = DDS_STREAM_COLSTEP_STR;
+      break;
+    case DDS_OP_VAL_SEQ:
+      step->kind = dds_stream_colstep_prim_size (DDS_OP_SUBTYPE (insn), &step->size) ? DDS_STREAM_COLSTEP_PRIMSEQ : DDS_STREAM_COLSTEP_ADR;
+      break;
+    case DDS_OP_VAL_ARR:
+      step->kind = dds_stream_colstep_prim_size (DDS_OP_SUBTYPE (insn), &step->size) ? DDS_STREAM_COLSTEP_PRIMARR : DDS_STREAM_COLSTEP_ADR;
+      step->count = ops[2];
+      break;
+    default:
+      step->kind = DDS_STREAM_COLSTEP_ADR;
+      break;
+  }
+}
+
+struct dds_stream_columns *dds_stream_columns_new (const struct ddsi_sertype_default * __restrict type, uint32_t ncols, const struct dds_stream_column * __restrict cols)
+{
+  /* Columns can be read straight from the CDR if the type consists of top-level members
+     only (final or appendable, but not mutable because then the members can occur in any
+     order) and each column is one of its primitive members.  Members stored externally
+     (@external) are pointers in the sample and have an additional size operand, so
+     those types are left to the generic path as well.  The plan is a list of steps,
+     one per member up to the last selected one, that can be executed for each sample
+     without interpreting the type's instructions. */
+  const uint32_t *ops = type->type.ops.ops;
+  bool dheader = false;
+  uint32_t insn, nmembers = 0;
+  if (DDS_OP (*ops) == DDS_OP_DLC)
+  {
+    dheader = true;
+    ops++;
+  }
+  for (const uint32_t *op = ops; (insn = *op) != DDS_OP_RTS; op = dds_stream_skip_adr (insn, op))
+  {
+    if (DDS_OP (insn) != DDS_OP_ADR || DDS_OP_TYPE (insn) == DDS_OP_VAL_STU || DDS_OP_TYPE (insn) == DDS_OP_VAL_EXT || op_type_external (insn))
+      return NULL;
+    nmembers++;
+  }
+
+  struct dds_stream_columns *plan = ddsrt_malloc (sizeof (*plan) + nmembers * sizeof (plan->steps[0]) + ncols * sizeof (uint32_t));
+  plan->type = type;
+  plan->cols = cols;
+  plan->ncols = ncols;
+  plan->dheader = dheader;
+  plan->has_dups = false;
+  plan->dup_of = (uint32_t *) &plan->steps[nmembers];
+  plan->nsteps = 0;
+  nmembers = 0;
+  for (const uint32_t *op = ops; (insn = *op) != DDS_OP_RTS; op = dds_stream_skip_adr (insn, op))
+    dds_stream_colstep_init (&plan->steps[nmembers++], op);
+
+  for (uint32_t k = 0; k < ncols; k++)
+  {
+    uint32_t m;
+    for (m = 0; m < nmembers; m++)
+      if (plan->steps[m].ops[1] == cols[k].offset)
+        break;
+    if (m == nmembers || plan->steps[m].kind != DDS_STREAM_COLSTEP_PRIM || plan->steps[m].size != cols[k].size)
+    {
+      ddsrt_free (plan);
+      return NULL;
+    }
+    if (plan->steps[m].col == UINT32_MAX)
+    {
+      plan->steps[m].col = k;
+      plan->dup_of[k] = k;
+    }
+    else
+    {
+      plan->dup_of[k] = plan->steps[m].col;
+      plan->has_dups = true;
+    }
+    if (m + 1 > plan->nsteps)
+      plan->nsteps = m + 1;
+  }
+  return plan;
+}
+
+void dds_stream_columns_free (struct dds_stream_columns *plan)
+{
+  ddsrt_free (plan);
+}
+
+static uint32_t dds_stream_colstep_align (const dds_istream_t * __restrict is, uint32_t size)
+{
+  return (size == 8 && is->m_xcdr_version == CDR_ENC_VERSION_2) ? 4 : size;
+}
+
+static void dds_stream_column_copy (char * __restrict dst, const void * __restrict src, uint32_t size)
+{
+  /* constant sizes so the compiler can turn them into simple loads and stores */
+  switch (size)
+  {
+    case 1: memcpy (dst, src, 1); break;
+    case 2: memcpy (dst, src, 2); break;
+    case 4: memcpy (dst, src, 4); break;
+    case 8: memcpy (dst, src, 8); break;
+    default: abort (); break;
+  }
+}
+
+void dds_stream_read_columns (dds_istream_t * __restrict is, const struct dds_stream_columns * __restrict plan, uint32_t idx)
+{
+  const struct dds_stream_column * const cols = plan->cols;
+  if (plan->type->opt_size && is->m_xcdr_version == CDR_ENC_VERSION_1)
+  {
+    /* Layout of struct & CDR is the same, so the offsets in the sample are also the
+       offsets in the CDR */
+    for (uint32_t k = 0; k < plan->ncols; k++)
+      dds_stream_column_copy ((char *) cols[k].buf + idx * cols[k].size, is->m_buffer + is->m_index + cols[k].offset, cols[k].size);
+    return;
+  }
+
+  uint32_t end = is->m_size;
+  if (plan->dheader)
+  {
+    /* Members at the end may be absent, the columns then get the default value (0) */
+    const uint32_t dheader = dds_is_get4 (is);
+    end = is->m_index + dheader;
+    for (uint32_t k = 0; k < plan->ncols; k++)
+      memset ((char *) cols[k].buf + idx * cols[k].size, 0, cols[k].size);
+  }
+  for (uint32_t s = 0; s < plan->nsteps && is->m_index < end; s++)
+  {
+    const struct dds_stream_colstep * const step = &plan->steps[s];
+    switch (step->kind)
+    {
+      case DDS_STREAM_COLSTEP_PRIM:
+        /* data is in native endianness, so a memcpy does the trick */
+        dds_cdr_alignto (is, dds_stream_colstep_align (is, step->size));
+        if (step->col != UINT32_MAX)
+          dds_stream_column_copy ((char *) cols[step->col].buf + idx * step->size, is->m_buffer + is->m_index, step->size);
+        is->m_index += step->size;
+        break;
+      case DDS_STREAM_COLSTEP_STR: {
+        const uint32_t len = dds_is_get4 (is);
+        is->m_index += len;
+        break;
+      }
+      case DDS_STREAM_COLSTEP_PRIMSEQ: {
+        const uint32_t num = dds_is_get4 (is);
+        if (num > 0)
+        {
+          dds_cdr_alignto (is, dds_stream_colstep_align (is, step->size));
+          is->m_index += num * step->size;
+        }
+        break;
+      }
+      case DDS_STREAM_COLSTEP_PRIMARR:
+        dds_cdr_alignto (is, dds_stream_colstep_align (is, step->size));
+        is->m_index += step->count * step->size;
+        break;
+      case DDS_STREAM_COLSTEP_ADR:
+        (void) dds_stream_extract_key_from_data_skip_adr (is, step->ops, DDS_OP_TYPE (*step->ops));
+        break;
+    }
+  }
+  if (plan->has_dups)
+  {
+    for (uint32_t k = 0; k < plan->ncols; k++)
+      if (plan->dup_of[k] != k)
+        dds_stream_column_copy ((char *) cols[k].buf + idx * cols[k].size, (char *) cols[plan->dup_of[k]].buf + idx * cols[k].size, cols[k].size);
+  }
+}
+
 /* Used in dds_stream_write_key for writing keys in native endianness, so no
    swap is needed in that case and this function is a no-op */
 static inline void dds_stream_swap_if_needed_insitu (void * __restrict vbuf, uint32_t size, uint32_t num)
@@ -3260,9 +3506,21 @@ DDSRT_STATIC_ASSERT ((offsetof (struct ddsi_serdata_default, data) % 8) == 0);
 
 void dds_istream_from_serdata_default (dds_istream_t * __restrict s, const struct ddsi_serdata_default * __restrict d)
 {
-  s->m_buffer = (const unsigned char *) d;
-  s->m_index = (uint32_t) offsetof (struct ddsi_serdata_default, data);
-  s->m_size = d->size + s->m_index;
+  /* a serdata referencing a sample must be detached before it can be read */
+  assert (d->extrefs == NULL || d->hdr_ref != NULL);
+  if (d->hdr_ref)
+  {
+    /* data is in the received message or in a separate buffer */
+    s->m_buffer = (const unsigned char *) (d->hdr_ref + 1);
+    s->m_index = 0;
+    s->m_size = d->pos;
+  }
+  else
+  {
+    s->m_buffer = (const unsigned char *) d;
+    s->m_index = (uint32_t) offsetof (struct ddsi_serdata_default, data);
+    s->m_size = d->size + s->m_index;
+  }
 #if DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN
   assert (CDR_ENC_LE (d->hdr.identifier));
 #elif DDSRT_ENDIAN == DDSRT_BIG_ENDIAN
@@ -3273,9 +3531,11 @@ void dds_istream_from_serdata_default (dds_istream_t * __restrict s, const struc
 
 void dds_ostream_from_serdata_default (dds_ostream_t * __restrict s, const struct ddsi_serdata_default * __restrict d)
 {
+  assert (d->hdr_ref == NULL);
   s->m_buffer = (unsigned char *) d;
   s->m_index = (uint32_t) offsetof (struct ddsi_serdata_default, data);
   s->m_size = d->size + s->m_index;
+  s->m_extrefs = NULL;
 #if DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN
   assert (CDR_ENC_LE (d->hdr.identifier));
 #elif DDSRT_ENDIAN == DDSRT_BIG_ENDIAN
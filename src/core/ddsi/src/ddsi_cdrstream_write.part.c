@@ -53,6 +53,15 @@ static const uint32_t *dds_stream_write_seqBO (DDS_OSTREAM_T * __restrict os, co
         const uint32_t elem_size = get_type_size (subtype);
         const uint32_t align = is_xcdr2 && subtype == DDS_OP_VAL_8BY ? 4 : elem_size;
         void * dst;
+        /* Large sequences may be referenced rather than copied if the caller asked for it,
+           but only if no byte swapping is needed and the size of the sequence doesn't need
+           to be written in a DHEADER (so XCDR1 only) */
+        if (BYTE_ORDER_IS_NATIVE && !is_xcdr2 && ((struct dds_ostream *)os)->m_extrefs &&
+            dds_os_put_bytes_extref ((struct dds_ostream *)os, seq->_buffer, num, elem_size, align))
+        {
+          ops += 2;
+          break;
+        }
         /* Combining put bytes and swap into a single step would improve the performance
            of writing data in non-native endianess. But in most cases the data will
            be written in native endianess, and in that case the swap is a no-op (for writing
@@ -0,0 +1,173 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/avl.h"
+#include "dds/ddsi/ddsi_content_filter.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_sertype.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/sysdeps.h"
+
+void ddsi_content_filter_init_classes (struct ddsi_domaingv *gv)
+{
+  ddsrt_mutex_init (&gv->content_filter_classes_lock);
+  gv->content_filter_classes = NULL;
+}
+
+void ddsi_content_filter_fini_classes (struct ddsi_domaingv *gv)
+{
+  while (gv->content_filter_classes)
+  {
+    struct ddsi_content_filter_class *c = gv->content_filter_classes;
+    gv->content_filter_classes = c->next;
+    ddsrt_free (c->name);
+    ddsrt_free (c);
+  }
+  ddsrt_mutex_destroy (&gv->content_filter_classes_lock);
+}
+
+static struct ddsi_content_filter_class *lookup_class_locked (struct ddsi_domaingv *gv, const char *name)
+{
+  struct ddsi_content_filter_class *c;
+  for (c = gv->content_filter_classes; c; c = c->next)
+    if (strcmp (c->name, name) == 0)
+      break;
+  return c;
+}
+
+dds_return_t ddsi_content_filter_register_class (struct ddsi_domaingv *gv, const char *name, ddsi_content_filter_fn fn, void *arg)
+{
+  dds_return_t ret = DDS_RETCODE_OK;
+  ddsrt_mutex_lock (&gv->content_filter_classes_lock);
+  if (lookup_class_locked (gv, name) != NULL)
+    ret = DDS_RETCODE_PRECONDITION_NOT_MET;
+  else
+  {
+    struct ddsi_content_filter_class *c = ddsrt_malloc (sizeof (*c));
+    c->name = ddsrt_strdup (name);
+    c->fn = fn;
+    c->arg = arg;
+    c->next = gv->content_filter_classes;
+    gv->content_filter_classes = c;
+  }
+  ddsrt_mutex_unlock (&gv->content_filter_classes_lock);
+  return ret;
+}
+
+void ddsi_content_filter_property_copy (nn_content_filter_property_t *dst, const nn_content_filter_property_t *src)
+{
+  dst->content_filtered_topic_name = ddsrt_strdup (src->content_filtered_topic_name);
+  dst->related_topic_name = ddsrt_strdup (src->related_topic_name);
+  dst->filter_class_name = ddsrt_strdup (src->filter_class_name);
+  dst->filter_expression = ddsrt_strdup (src->filter_expression);
+  dst->expression_parameters.n = src->expression_parameters.n;
+  dst->expression_parameters.strs = NULL;
+  if (src->expression_parameters.n > 0)
+  {
+    dst->expression_parameters.strs = ddsrt_malloc (src->expression_parameters.n * sizeof (*dst->expression_parameters.strs));
+    for (uint32_t i = 0; i < src->expression_parameters.n; i++)
+      dst->expression_parameters.strs[i] = ddsrt_strdup (src->expression_parameters.strs[i]);
+  }
+}
+
+void ddsi_content_filter_property_fini (nn_content_filter_property_t *prop)
+{
+  ddsrt_free (prop->content_filtered_topic_name);
+  ddsrt_free (prop->related_topic_name);
+  ddsrt_free (prop->filter_class_name);
+  ddsrt_free (prop->filter_expression);
+  for (uint32_t i = 0; i < prop->expression_parameters.n; i++)
+    ddsrt_free (prop->expression_parameters.strs[i]);
+  ddsrt_free (prop->expression_parameters.strs);
+}
+
+struct ddsi_content_filter *ddsi_content_filter_new (struct ddsi_domaingv *gv, const nn_content_filter_property_t *prop)
+{
+  struct ddsi_content_filter_class *c;
+  struct ddsi_content_filter *cf = NULL;
+  ddsrt_mutex_lock (&gv->content_filter_classes_lock);
+  if ((c = lookup_class_locked (gv, prop->filter_class_name)) != NULL)
+  {
+    cf = ddsrt_malloc (sizeof (*cf));
+    cf->fn = c->fn;
+    cf->arg = c->arg;
+    ddsi_content_filter_property_copy (&cf->prop, prop);
+  }
+  ddsrt_mutex_unlock (&gv->content_filter_classes_lock);
+  return cf;
+}
+
+void ddsi_content_filter_free (struct ddsi_content_filter *cf)
+{
+  ddsi_content_filter_property_fini (&cf->prop);
+  ddsrt_free (cf);
+}
+
+bool ddsi_content_filter_accepts (const struct ddsi_content_filter *cf, const void *sample)
+{
+  return cf->fn (sample, cf->prop.filter_expression, cf->prop.expression_parameters.n, (const char * const *) cf->prop.expression_parameters.strs, cf->arg);
+}
+
+bool ddsi_content_filter_next_participant (const struct writer *wr, const struct wr_prd_match **pm, struct ddsi_serdata *serdata, void **sample)
+{
+  const struct wr_prd_match *m = *pm;
+  const ddsi_guid_prefix_t prefix = m->prd_guid.prefix;
+  bool accept = false;
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  for (; m && memcmp (&m->prd_guid.prefix, &prefix, sizeof (prefix)) == 0; m = ddsrt_avl_find_succ (&wr_readers_treedef, &wr->readers, m))
+  {
+    if (accept)
+      continue;
+    else if (m->content_filter == NULL || serdata->kind != SDK_DATA)
+      accept = true;
+    else
+    {
+      if (*sample == NULL)
+      {
+        /* a best-effort writer doesn't store the sample in the WHC, so it may still
+           reference the application's sample and can't be deserialized as is */
+        ddsi_serdata_detach (serdata);
+        *sample = ddsi_sertype_alloc_sample (wr->type);
+        ddsi_serdata_to_sample (serdata, *sample, NULL, NULL);
+      }
+      accept = ddsi_content_filter_accepts (m->content_filter, *sample);
+    }
+  }
+  *pm = m;
+  return accept;
+}
+
+void ddsi_content_filter_free_sample (const struct writer *wr, void *sample)
+{
+  if (sample)
+    ddsi_sertype_free_sample (wr->type, sample, DDS_FREE_ALL);
+}
+
+int ddsi_proxy_reader_content_filter (struct writer *wr, struct proxy_reader *prd, struct ddsi_serdata *serdata)
+{
+  /* a GAP for prd may also affect the readers of other participants that happen
+     to be in the same domain instance, so only reject if no one accepts */
+  const struct wr_prd_match *m = ddsrt_avl_find_min (&wr_readers_treedef, &wr->readers);
+  void *sample = NULL;
+  int accept = 0;
+  DDSRT_UNUSED_ARG (prd);
+  while (m && !accept)
+    accept = ddsi_content_filter_next_participant (wr, &m, serdata, &sample);
+  ddsi_content_filter_free_sample (wr, sample);
+  return accept;
+}
@@ -11,7 +11,7 @@
  */
 #include <stddef.h>
 #include <stdlib.h>
-#include "dds/ddsrt/circlist.h"
+#include "dds/ddsrt/timewheel.h"
 #include "dds/ddsrt/time.h"
 #include "dds/ddsi/ddsi_deadline.h"
 #include "dds/ddsi/q_xevent.h"
@@ -23,33 +23,30 @@ static void instance_deadline_missed_cb (struct xevent *xev, void *varg, ddsrt_m
   resched_xevent_if_earlier (xev, next_valid);
 }
 
-/* Gets the instance from the list in deadline admin that has the earliest missed deadline and
- * removes the instance element from the list. If no more instances with missed deadline exist
- * in the list, the deadline (ddsrt_mtime_t) for the first instance to 'expire' is returned. If
- * the list is empty, DDSRT_MTIME_NEVER is returned */
+/* Gets an instance from the deadline admin that has a missed deadline and
+ * removes the instance element from the admin. If no instance with a missed
+ * deadline exists, a lower bound on the deadline (ddsrt_mtime_t) for the first
+ * instance to 'expire' is returned. If the admin is empty, DDSRT_MTIME_NEVER is
+ * returned */
 ddsrt_mtime_t deadline_next_missed_locked (struct deadline_adm *deadline_adm, ddsrt_mtime_t tnow, void **instance)
 {
-  struct deadline_elem *elem = NULL;
-  if (!ddsrt_circlist_isempty (&deadline_adm->list))
+  ddsrt_timewheel_node_t *twn;
+  if ((twn = ddsrt_timewheel_next_expired (&deadline_adm->wheel, tnow.v)) != NULL)
   {
-    struct ddsrt_circlist_elem *list_elem = ddsrt_circlist_oldest (&deadline_adm->list);
-    elem = DDSRT_FROM_CIRCLIST (struct deadline_elem, e, list_elem);
-    if (elem->t_deadline.v <= tnow.v)
-    {
-      ddsrt_circlist_remove (&deadline_adm->list, &elem->e);
-      if (instance != NULL)
-        *instance = (char *)elem - deadline_adm->elem_offset;
-      return (ddsrt_mtime_t) { 0 };
-    }
+    struct deadline_elem *elem = DDSRT_FROM_TIMEWHEEL (struct deadline_elem, wheelnode, twn);
+    ddsrt_timewheel_delete (&deadline_adm->wheel, &elem->wheelnode);
+    if (instance != NULL)
+      *instance = (char *)elem - deadline_adm->elem_offset;
+    return (ddsrt_mtime_t) { 0 };
   }
   if (instance != NULL)
     *instance = NULL;
-  return (elem != NULL) ? elem->t_deadline : DDSRT_MTIME_NEVER;
+  return (ddsrt_mtime_t) { ddsrt_timewheel_next_time (&deadline_adm->wheel) };
 }
 
 void deadline_init (const struct ddsi_domaingv *gv, struct deadline_adm *deadline_adm, size_t list_offset, size_t elem_offset, deadline_missed_cb_t deadline_missed_cb)
 {
-  ddsrt_circlist_init (&deadline_adm->list);
+  ddsrt_timewheel_init (&deadline_adm->wheel);
   deadline_adm->evt = qxev_callback (gv->xevents, DDSRT_MTIME_NEVER, instance_deadline_missed_cb, deadline_adm);
   deadline_adm->deadline_missed_cb = deadline_missed_cb;
   deadline_adm->list_offset = list_offset;
@@ -66,10 +63,9 @@ void deadline_clear (struct deadline_adm *deadline_adm)
   while ((deadline_next_missed_locked (deadline_adm, DDSRT_MTIME_NEVER, NULL)).v == 0);
 }
 
-void deadline_fini (const struct deadline_adm *deadline_adm)
+void deadline_fini (struct deadline_adm *deadline_adm)
 {
-  assert (ddsrt_circlist_isempty (&deadline_adm->list));
-  (void) deadline_adm;
+  ddsrt_timewheel_fini (&deadline_adm->wheel);
 }
 
 DDS_EXPORT extern inline void deadline_register_instance_locked (struct deadline_adm *deadline_adm, struct deadline_elem *elem, ddsrt_mtime_t tnow);
@@ -77,9 +73,9 @@ DDS_EXPORT extern inline void deadline_reregister_instance_locked (struct deadli
 
 void deadline_register_instance_real (struct deadline_adm *deadline_adm, struct deadline_elem *elem, ddsrt_mtime_t tprev, ddsrt_mtime_t tnow)
 {
-  ddsrt_circlist_append(&deadline_adm->list, &elem->e);
   elem->t_deadline = (tprev.v + deadline_adm->dur >= tnow.v) ? tprev : tnow;
   elem->t_deadline.v += deadline_adm->dur;
+  ddsrt_timewheel_insert (&deadline_adm->wheel, &elem->wheelnode, elem->t_deadline.v);
   resched_xevent_if_earlier (deadline_adm->evt, elem->t_deadline);
 }
 
@@ -90,23 +86,21 @@ void deadline_unregister_instance_real (struct deadline_adm *deadline_adm, struc
   /* Updating the scheduled event with the new shortest expiry
    * is not required, because the event will be rescheduled when
    * this removed element expires. Only remove the element from the
-   * deadline list */
+   * deadline admin */
 
   elem->t_deadline = DDSRT_MTIME_NEVER;
-  ddsrt_circlist_remove(&deadline_adm->list, &elem->e);
+  ddsrt_timewheel_delete (&deadline_adm->wheel, &elem->wheelnode);
 }
 
 DDS_EXPORT extern inline void deadline_renew_instance_locked (struct deadline_adm *deadline_adm, struct deadline_elem *elem);
 
 void deadline_renew_instance_real (struct deadline_adm *deadline_adm, struct deadline_elem *elem)
 {
-  /* move element to end of the list (list->latest) and update deadline
-     according to current deadline duration in rhc (event with old deadline
-     will still be triggered, but has no effect on this instance because in
-     the callback the deadline (which will be the updated value) will be
-     checked for expiry */
-  ddsrt_circlist_remove(&deadline_adm->list, &elem->e);
+  /* update deadline according to current deadline duration in rhc and move
+     element in the timing wheel (event with old deadline will still be
+     triggered, but has no effect on this instance because in the callback the
+     deadline (which will be the updated value) will be checked for expiry */
   elem->t_deadline = ddsrt_time_monotonic();
   elem->t_deadline.v += deadline_adm->dur;
-  ddsrt_circlist_append(&deadline_adm->list, &elem->e);
+  ddsrt_timewheel_update (&deadline_adm->wheel, &elem->wheelnode, elem->t_deadline.v);
 }
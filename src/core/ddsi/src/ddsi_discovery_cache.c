@@ -0,0 +1,471 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsrt/mh3.h"
+#include "dds/ddsi/ddsi_discovery_cache.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/q_radmin.h"
+#include "dds/ddsi/q_xevent.h"
+#include "dds/ddsi/q_log.h"
+#include "dds/ddsi/sysdeps.h"
+
+/* Delay between the first change and writing the file, so that a burst of
+   discovery traffic results in a single write */
+#define DISCOVERY_CACHE_WRITE_DELAY DDS_SECS (1)
+
+#define DISCOVERY_CACHE_MAGIC "CDDC"
+#define DISCOVERY_CACHE_VERSION 1u
+
+/* File layout: header, followed by "count" records, each followed by "size"
+   bytes of serialized data padded to a multiple of 8 bytes; all in native
+   byte order, a file written on a machine with a different byte order fails
+   the version check */
+struct dc_file_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t count;
+  uint32_t pad;
+};
+
+struct dc_file_record {
+  ddsi_guid_t guid;
+  ddsi_guid_prefix_t src_guid_prefix;
+  uint32_t kind;
+  nn_vendorid_t vendorid;
+  nn_protocol_version_t protocol_version;
+  uint32_t size;
+  int64_t seq;
+  int64_t timestamp;
+  int64_t tseen;
+};
+
+struct ddsi_discovery_cache {
+  struct ddsi_domaingv *gv;
+  ddsrt_mutex_t lock;
+  struct ddsrt_hh *entries;
+  struct xevent *evt;
+  bool dirty;
+  ddsrt_wctime_t twritten;
+};
+
+static uint32_t dc_align8 (uint32_t x)
+{
+  return (x + 7u) & ~7u;
+}
+
+static uint32_t dc_entry_hash (const void *va)
+{
+  /* The entities of a participant share the prefix and differ only in a few bits
+     of the entity id, so all of the GUID must be mixed in properly: ddsrt_hh can
+     only hold a handful of entries with the same hash */
+  const struct ddsi_discovery_cache_entry *a = va;
+  return ddsrt_mh3 (&a->guid, sizeof (a->guid), 0);
+}
+
+static int dc_entry_equal (const void *va, const void *vb)
+{
+  const struct ddsi_discovery_cache_entry *a = va;
+  const struct ddsi_discovery_cache_entry *b = vb;
+  return memcmp (&a->guid, &b->guid, sizeof (a->guid)) == 0;
+}
+
+static void dc_entry_free (struct ddsi_discovery_cache_entry *e)
+{
+  ddsrt_free (e->data);
+  ddsrt_free (e);
+}
+
+static struct ddsi_discovery_cache_entry *dc_lookup_participant (const struct ddsi_discovery_cache *dc, const ddsi_guid_prefix_t *prefix)
+{
+  struct ddsi_discovery_cache_entry template;
+  template.guid.prefix = *prefix;
+  template.guid.entityid.u = NN_ENTITYID_PARTICIPANT;
+  return ddsrt_hh_lookup (dc->entries, &template);
+}
+
+static bool dc_participant_is_recent (const struct ddsi_discovery_cache *dc, const struct ddsi_discovery_cache_entry *pp, ddsrt_wctime_t tnow)
+{
+  const dds_duration_t max_age = dc->gv->config.discovery_cache_max_age;
+  return pp != NULL && pp->kind == DDSI_DCK_PARTICIPANT && (max_age == DDS_INFINITY || pp->tseen.v >= tnow.v - max_age);
+}
+
+static void dc_read_file (struct ddsi_discovery_cache *dc)
+{
+  DDSRT_WARNING_MSVC_OFF(4996);
+  struct ddsi_domaingv * const gv = dc->gv;
+  const char *name = gv->config.discovery_cache_file;
+  FILE *fp;
+  if ((fp = fopen (name, "rb")) == NULL)
+  {
+    GVLOGDISC ("discovery cache: %s not found\n", name);
+    return;
+  }
+
+  unsigned char *buf = NULL;
+  size_t size = 0, cap = 0, n;
+  do {
+    if (size == cap)
+    {
+      cap = (cap == 0) ? 65536 : 2 * cap;
+      buf = ddsrt_realloc (buf, cap);
+    }
+    n = fread (buf + size, 1, cap - size, fp);
+    size += n;
+  } while (n > 0);
+  const bool read_error = ferror (fp);
+  (void) fclose (fp);
+
+  struct dc_file_header hdr;
+  uint32_t count = 0;
+  size_t pos = sizeof (hdr);
+  if (read_error)
+    goto invalid;
+  if (size < sizeof (hdr))
+    goto invalid;
+  memcpy (&hdr, buf, sizeof (hdr));
+  if (memcmp (hdr.magic, DISCOVERY_CACHE_MAGIC, sizeof (hdr.magic)) != 0 || hdr.version != DISCOVERY_CACHE_VERSION)
+    goto invalid;
+  for (count = 0; count < hdr.count; count++)
+  {
+    struct dc_file_record rec;
+    if (size - pos < sizeof (rec))
+      goto invalid;
+    memcpy (&rec, buf + pos, sizeof (rec));
+    pos += sizeof (rec);
+    if (rec.kind > DDSI_DCK_READER || rec.size < 4 || size - pos < rec.size)
+      goto invalid;
+
+    struct ddsi_discovery_cache_entry *e = ddsrt_malloc (sizeof (*e));
+    e->guid = rec.guid;
+    e->kind = (enum ddsi_discovery_cache_kind) rec.kind;
+    e->src_guid_prefix = rec.src_guid_prefix;
+    e->vendorid = rec.vendorid;
+    e->protocol_version = rec.protocol_version;
+    e->seq = rec.seq;
+    e->timestamp.v = rec.timestamp;
+    e->tseen.v = rec.tseen;
+    e->size = rec.size;
+    e->data = ddsrt_memdup (buf + pos, rec.size);
+    pos += (size - pos < dc_align8 (rec.size)) ? size - pos : dc_align8 (rec.size);
+    struct ddsi_discovery_cache_entry *old;
+    if ((old = ddsrt_hh_lookup (dc->entries, e)) != NULL)
+    {
+      ddsrt_hh_remove (dc->entries, old);
+      dc_entry_free (old);
+    }
+    ddsrt_hh_add (dc->entries, e);
+  }
+  GVLOGDISC ("discovery cache: loaded %"PRIu32" entries from %s\n", count, name);
+  ddsrt_free (buf);
+  return;
+
+invalid:
+  GVWARNING ("discovery cache: %s is invalid, ignoring all but the first %"PRIu32" entries\n", name, count);
+  ddsrt_free (buf);
+  DDSRT_WARNING_MSVC_ON(4996);
+}
+
+static bool dc_write_file (struct ddsi_domaingv *gv, const unsigned char *buf, size_t size)
+{
+  DDSRT_WARNING_MSVC_OFF(4996);
+  const char *name = gv->config.discovery_cache_file;
+  char *tmpname;
+  FILE *fp;
+  bool ok;
+  /* Processes sharing a configuration file by mistake must at least not
+     write to the same temporary file */
+  (void) ddsrt_asprintf (&tmpname, "%s.%"PRIdPID".tmp", name, ddsrt_getpid ());
+  if ((fp = fopen (tmpname, "wb")) == NULL)
+  {
+    GVWARNING ("discovery cache: %s could not be opened for writing\n", tmpname);
+    ddsrt_free (tmpname);
+    return false;
+  }
+  ok = (fwrite (buf, 1, size, fp) == size);
+  ok = (fclose (fp) == 0) && ok;
+  /* Replace the old file only once the new one has been written completely,
+     on some platforms rename fails if the target exists */
+  if (ok && rename (tmpname, name) != 0)
+  {
+    (void) remove (name);
+    ok = (rename (tmpname, name) == 0);
+  }
+  if (!ok)
+  {
+    GVWARNING ("discovery cache: failed to write %s\n", name);
+    (void) remove (tmpname);
+  }
+  ddsrt_free (tmpname);
+  return ok;
+  DDSRT_WARNING_MSVC_ON(4996);
+}
+
+static unsigned char *dc_serialize_locked (struct ddsi_discovery_cache *dc, size_t *size, uint32_t *count)
+{
+  const ddsrt_wctime_t tnow = ddsrt_time_wallclock ();
+  struct ddsrt_hh_iter it;
+  struct ddsi_discovery_cache_entry *e;
+  size_t sz = sizeof (struct dc_file_header);
+  uint32_t n = 0;
+
+  /* Participants that haven't been seen for longer than the maximum age will
+     never be restored, neither will the endpoints of participants no longer
+     in the cache: so don't write them */
+  for (e = ddsrt_hh_iter_first (dc->entries, &it); e; e = ddsrt_hh_iter_next (&it))
+  {
+    if (!dc_participant_is_recent (dc, dc_lookup_participant (dc, &e->guid.prefix), tnow))
+      continue;
+    sz += sizeof (struct dc_file_record) + dc_align8 (e->size);
+    n++;
+  }
+
+  unsigned char *buf = ddsrt_malloc (sz), *p = buf;
+  struct dc_file_header hdr;
+  memcpy (hdr.magic, DISCOVERY_CACHE_MAGIC, sizeof (hdr.magic));
+  hdr.version = DISCOVERY_CACHE_VERSION;
+  hdr.count = n;
+  hdr.pad = 0;
+  memcpy (p, &hdr, sizeof (hdr));
+  p += sizeof (hdr);
+  for (e = ddsrt_hh_iter_first (dc->entries, &it); e; e = ddsrt_hh_iter_next (&it))
+  {
+    if (!dc_participant_is_recent (dc, dc_lookup_participant (dc, &e->guid.prefix), tnow))
+      continue;
+    struct dc_file_record rec;
+    memset (&rec, 0, sizeof (rec));
+    rec.guid = e->guid;
+    rec.src_guid_prefix = e->src_guid_prefix;
+    rec.kind = (uint32_t) e->kind;
+    rec.vendorid = e->vendorid;
+    rec.protocol_version = e->protocol_version;
+    rec.size = e->size;
+    rec.seq = e->seq;
+    rec.timestamp = e->timestamp.v;
+    rec.tseen = e->tseen.v;
+    memcpy (p, &rec, sizeof (rec));
+    p += sizeof (rec);
+    memcpy (p, e->data, e->size);
+    memset (p + e->size, 0, dc_align8 (e->size) - e->size);
+    p += dc_align8 (e->size);
+  }
+  assert ((size_t) (p - buf) == sz);
+  dc->twritten = tnow;
+  *size = sz;
+  *count = n;
+  return buf;
+}
+
+void ddsi_discovery_cache_write (struct ddsi_discovery_cache *dc)
+{
+  struct ddsi_domaingv * const gv = dc->gv;
+  unsigned char *buf;
+  size_t size;
+  uint32_t count;
+  ddsrt_mutex_lock (&dc->lock);
+  if (!dc->dirty)
+  {
+    ddsrt_mutex_unlock (&dc->lock);
+    return;
+  }
+  buf = dc_serialize_locked (dc, &size, &count);
+  dc->dirty = false;
+  ddsrt_mutex_unlock (&dc->lock);
+
+  if (dc_write_file (gv, buf, size))
+    GVLOGDISC ("discovery cache: wrote %"PRIu32" entries to %s\n", count, gv->config.discovery_cache_file);
+  ddsrt_free (buf);
+}
+
+static void dc_write_cb (struct xevent *xev, void *varg, ddsrt_mtime_t tnow)
+{
+  struct ddsi_discovery_cache * const dc = varg;
+  (void) xev;
+  (void) tnow;
+  ddsi_discovery_cache_write (dc);
+}
+
+static void dc_mark_dirty_locked (struct ddsi_discovery_cache *dc)
+{
+  if (dc->dirty)
+    return;
+  dc->dirty = true;
+  if (dc->evt)
+    (void) resched_xevent_if_earlier (dc->evt, ddsrt_mtime_add_duration (ddsrt_time_monotonic (), DISCOVERY_CACHE_WRITE_DELAY));
+}
+
+struct ddsi_discovery_cache *ddsi_discovery_cache_new (struct ddsi_domaingv *gv)
+{
+  struct ddsi_discovery_cache *dc = ddsrt_malloc (sizeof (*dc));
+  dc->gv = gv;
+  ddsrt_mutex_init (&dc->lock);
+  dc->entries = ddsrt_hh_new (1, dc_entry_hash, dc_entry_equal);
+  dc->dirty = false;
+  dc->twritten = ddsrt_time_wallclock ();
+  dc_read_file (dc);
+  dc->evt = qxev_callback (gv->xevents, DDSRT_MTIME_NEVER, dc_write_cb, dc);
+  return dc;
+}
+
+void ddsi_discovery_cache_free (struct ddsi_discovery_cache *dc)
+{
+  struct ddsrt_hh_iter it;
+  struct ddsi_discovery_cache_entry *e;
+  /* If the event still exists, it is freed with the event queue */
+  for (e = ddsrt_hh_iter_first (dc->entries, &it); e; e = ddsrt_hh_iter_next (&it))
+  {
+    ddsrt_hh_remove (dc->entries, e);
+    dc_entry_free (e);
+  }
+  ddsrt_hh_free (dc->entries);
+  ddsrt_mutex_destroy (&dc->lock);
+  ddsrt_free (dc);
+}
+
+void ddsi_discovery_cache_stop (struct ddsi_discovery_cache *dc)
+{
+  /* The callback takes the lock, so the event must be deleted without holding it */
+  struct xevent *evt;
+  ddsrt_mutex_lock (&dc->lock);
+  evt = dc->evt;
+  dc->evt = NULL;
+  /* The final write on shutdown also records when the participants were last seen */
+  dc->dirty = true;
+  ddsrt_mutex_unlock (&dc->lock);
+  if (evt)
+    delete_xevent_callback (evt);
+}
+
+static struct ddsi_discovery_cache_entry *dc_entry_dup (const struct ddsi_discovery_cache_entry *e)
+{
+  struct ddsi_discovery_cache_entry *c = ddsrt_memdup (e, sizeof (*e));
+  c->data = ddsrt_memdup (e->data, e->size);
+  return c;
+}
+
+void ddsi_discovery_cache_restore (struct ddsi_discovery_cache *dc, ddsi_discovery_cache_restore_fn_t fn, void *arg)
+{
+  const ddsrt_wctime_t tnow = ddsrt_time_wallclock ();
+  struct ddsrt_hh_iter it;
+  struct ddsi_discovery_cache_entry *e, **restore;
+  uint32_t n = 0, nparticipants = 0, size = 32;
+
+  /* Copy the entries to restore so that the callback can be invoked without
+     holding the lock: the discovery handlers running concurrently update the
+     cache; participants go first, so their endpoints can be created */
+  restore = ddsrt_malloc (size * sizeof (*restore));
+  ddsrt_mutex_lock (&dc->lock);
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (e = ddsrt_hh_iter_first (dc->entries, &it); e; e = ddsrt_hh_iter_next (&it))
+    {
+      if ((pass == 0) != (e->kind == DDSI_DCK_PARTICIPANT))
+        continue;
+      if (!dc_participant_is_recent (dc, dc_lookup_participant (dc, &e->guid.prefix), tnow))
+      {
+        /* endpoints are visited after their participants got removed */
+        ddsrt_hh_remove (dc->entries, e);
+        dc_entry_free (e);
+        dc_mark_dirty_locked (dc);
+        continue;
+      }
+      if (n == size)
+      {
+        size *= 2;
+        restore = ddsrt_realloc (restore, size * sizeof (*restore));
+      }
+      restore[n++] = dc_entry_dup (e);
+    }
+    if (pass == 0)
+      nparticipants = n;
+  }
+  ddsrt_mutex_unlock (&dc->lock);
+
+  struct ddsi_domaingv * const gv = dc->gv;
+  GVLOGDISC ("discovery cache: restoring %"PRIu32" participants and %"PRIu32" endpoints\n", nparticipants, n - nparticipants);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    fn (restore[i], arg);
+    dc_entry_free (restore[i]);
+  }
+  ddsrt_free (restore);
+}
+
+void ddsi_discovery_cache_update (struct ddsi_discovery_cache *dc, enum ddsi_discovery_cache_kind kind, const ddsi_guid_t *guid, const struct receiver_state *rst, seqno_t seq, const struct ddsi_serdata *serdata)
+{
+  const ddsrt_wctime_t tnow = ddsrt_time_wallclock ();
+  struct ddsi_discovery_cache_entry template, *e;
+  template.guid = *guid;
+  ddsrt_mutex_lock (&dc->lock);
+  if (kind != DDSI_DCK_PARTICIPANT && dc_lookup_participant (dc, &guid->prefix) == NULL)
+  {
+    ddsrt_mutex_unlock (&dc->lock);
+    return;
+  }
+  if ((e = ddsrt_hh_lookup (dc->entries, &template)) != NULL && e->kind == kind && e->seq == seq)
+  {
+    /* Periodic SPDP retransmits only update the time it was last seen, that
+       only warrants rewriting the file once in a while to prevent the
+       participant from exceeding the maximum age */
+    const dds_duration_t max_age = dc->gv->config.discovery_cache_max_age;
+    e->tseen = tnow;
+    if (max_age != DDS_INFINITY && tnow.v - dc->twritten.v > max_age / 4)
+      dc_mark_dirty_locked (dc);
+  }
+  else
+  {
+    const uint32_t size = ddsi_serdata_size (serdata);
+    if (e == NULL)
+    {
+      e = ddsrt_malloc (sizeof (*e));
+      e->guid = *guid;
+      e->data = NULL;
+      ddsrt_hh_add (dc->entries, e);
+    }
+    e->kind = kind;
+    e->src_guid_prefix = rst->src_guid_prefix;
+    e->vendorid = rst->vendor;
+    e->protocol_version = rst->protocol_version;
+    e->seq = seq;
+    e->timestamp = serdata->timestamp;
+    e->tseen = tnow;
+    e->size = size;
+    e->data = ddsrt_realloc (e->data, size);
+    ddsi_serdata_to_ser (serdata, 0, size, e->data);
+    dc_mark_dirty_locked (dc);
+  }
+  ddsrt_mutex_unlock (&dc->lock);
+}
+
+void ddsi_discovery_cache_remove (struct ddsi_discovery_cache *dc, const ddsi_guid_t *guid)
+{
+  struct ddsi_discovery_cache_entry template, *e;
+  template.guid = *guid;
+  ddsrt_mutex_lock (&dc->lock);
+  if ((e = ddsrt_hh_lookup (dc->entries, &template)) != NULL)
+  {
+    ddsrt_hh_remove (dc->entries, e);
+    dc_entry_free (e);
+    dc_mark_dirty_locked (dc);
+  }
+  ddsrt_mutex_unlock (&dc->lock);
+}
@@ -15,6 +15,8 @@
 
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/misc.h"
+#include "dds/ddsrt/mh3.h"
+#include "dds/ddsrt/string.h"
 
 #include "dds/ddsrt/hopscotch.h"
 #include "dds/ddsrt/avl.h"
@@ -26,10 +28,33 @@
 #include "dds/ddsi/q_rtps.h" /* guid_t */
 #include "dds/ddsi/q_thread.h" /* for assert(thread is awake) */
 
+/* Endpoints of the same topic, one array for each kind of endpoint, so that matching an
+   endpoint only needs to look at the candidates rather than scan all endpoints of that
+   kind; the name is the single copy of the topic name used as key in the topic index.
+
+   The entry doubles as the interned topic: each endpoint in it points to it from
+   entity_common::entidx_topic and records its position in entidx_topic_idx, so that
+   only inserting an endpoint requires hashing and comparing the name and removing
+   one takes constant time.  The endpoints' own names can't be shared, they are part
+   of QoS objects that get replaced and freed independently of the index. */
+#define ENTIDX_TOPIC_NKINDS 4
+
+struct entidx_topic_eps {
+  uint32_t n, size;
+  struct entity_common **eps;
+};
+
+struct entidx_topic {
+  char *name;
+  uint32_t nendpoints; /* total over all kinds, the topic is removed when it drops to 0 */
+  struct entidx_topic_eps eps[ENTIDX_TOPIC_NKINDS];
+};
+
 struct entity_index {
   struct ddsrt_chh *guid_hash;
   ddsrt_mutex_t all_entities_lock;
   ddsrt_avl_tree_t all_entities;
+  struct ddsrt_hh *topics; /* protected by all_entities_lock */
 };
 
 static const uint64_t unihashconsts[] = {
@@ -137,43 +162,108 @@ static int all_entities_compare (const void *va, const void *vb)
     return memcmp (&a->guid, &b->guid, sizeof (a->guid));
 }
 
-static void match_endpoint_range (enum entity_kind kind, const char *tp, struct match_entities_range_key *min, struct match_entities_range_key *max)
+static int entidx_topic_kind_index (enum entity_kind kind)
 {
-  /* looking for entities of kind KIND; initialize fake entities such that they are
-     valid input to all_entities_compare and that span the range of all possibly
-     matching endpoints. */
-  min->entity.e.kind = max->entity.e.kind = kind;
-  memset (&min->entity.e.guid, 0x00, sizeof (min->entity.e.guid));
-  memset (&max->entity.e.guid, 0xff, sizeof (max->entity.e.guid));
-  min->xqos.present = max->xqos.present = QP_TOPIC_NAME;
-  min->xqos.topic_name = max->xqos.topic_name = (char *) tp;
   switch (kind)
   {
-    case EK_PARTICIPANT:
-    case EK_PROXY_PARTICIPANT:
-      break;
-    case EK_TOPIC:
-#ifdef DDS_HAS_TOPIC_DISCOVERY
-      min->entity.tp.definition = &min->tpdef;
-      max->entity.tp.definition = &max->tpdef;
-      min->entity.tp.definition->xqos = &min->xqos;
-      max->entity.tp.definition->xqos = &max->xqos;
-#endif
-      break;
-    case EK_WRITER:
-      min->entity.wr.xqos = &min->xqos;
-      max->entity.wr.xqos = &max->xqos;
-      break;
-    case EK_READER:
-      min->entity.rd.xqos = &min->xqos;
-      max->entity.rd.xqos = &max->xqos;
-      break;
+    case EK_WRITER: return 0;
+    case EK_READER: return 1;
+    case EK_PROXY_WRITER: return 2;
+    case EK_PROXY_READER: return 3;
+    default: return -1;
+  }
+}
+
+static const char *endpoint_topic_name (const struct entity_common *e)
+{
+  const struct dds_qos *xqos = NULL;
+  switch (e->kind)
+  {
+    case EK_WRITER: xqos = ((const struct writer *) e)->xqos; break;
+    case EK_READER: xqos = ((const struct reader *) e)->xqos; break;
     case EK_PROXY_WRITER:
-    case EK_PROXY_READER:
-      min->entity.gpe.c.vendor = max->entity.gpe.c.vendor = NN_VENDORID_ECLIPSE;
-      min->entity.gpe.c.xqos = &min->xqos;
-      max->entity.gpe.c.xqos = &max->xqos;
-      break;
+    case EK_PROXY_READER: xqos = ((const struct generic_proxy_endpoint *) e)->c.xqos; break;
+    default: assert (0); return NULL;
+  }
+  assert ((xqos->present & QP_TOPIC_NAME) && xqos->topic_name);
+  return xqos->topic_name;
+}
+
+static uint32_t entidx_topic_hash (const void *vtp)
+{
+  const struct entidx_topic *tp = vtp;
+  return ddsrt_mh3 (tp->name, strlen (tp->name), 0);
+}
+
+static int entidx_topic_eq (const void *va, const void *vb)
+{
+  const struct entidx_topic *a = va;
+  const struct entidx_topic *b = vb;
+  return strcmp (a->name, b->name) == 0;
+}
+
+static void entidx_topic_free (struct entidx_topic *tp)
+{
+  for (int k = 0; k < ENTIDX_TOPIC_NKINDS; k++)
+    ddsrt_free (tp->eps[k].eps);
+  ddsrt_free (tp->name);
+  ddsrt_free (tp);
+}
+
+static void entidx_topic_free_wrapper (void *vtp, void *varg)
+{
+  (void) varg;
+  entidx_topic_free (vtp);
+}
+
+static void add_to_topic_index (struct entity_index *ei, struct entity_common *e, int kidx)
+{
+  struct entidx_topic template = { .name = (char *) endpoint_topic_name (e) }, *tp;
+  if ((tp = ddsrt_hh_lookup (ei->topics, &template)) == NULL)
+  {
+    tp = ddsrt_malloc (sizeof (*tp));
+    tp->name = ddsrt_strdup (template.name);
+    tp->nendpoints = 0;
+    for (int k = 0; k < ENTIDX_TOPIC_NKINDS; k++)
+    {
+      tp->eps[k].n = tp->eps[k].size = 0;
+      tp->eps[k].eps = NULL;
+    }
+    ddsrt_hh_add (ei->topics, tp);
+  }
+  struct entidx_topic_eps * const x = &tp->eps[kidx];
+  if (x->n == x->size)
+  {
+    x->size = (x->size == 0) ? 4 : 2 * x->size;
+    x->eps = ddsrt_realloc (x->eps, x->size * sizeof (*x->eps));
+  }
+  e->entidx_topic_idx = x->n;
+  x->eps[x->n++] = e;
+  tp->nendpoints++;
+  e->entidx_topic = tp;
+}
+
+static void remove_from_topic_index (struct entity_index *ei, struct entity_common *e, int kidx)
+{
+  struct entidx_topic * const tp = e->entidx_topic;
+  assert (tp != NULL && strcmp (tp->name, endpoint_topic_name (e)) == 0);
+  e->entidx_topic = NULL;
+  struct entidx_topic_eps * const x = &tp->eps[kidx];
+  const uint32_t i = e->entidx_topic_idx;
+  assert (i < x->n && x->eps[i] == e);
+  /* move the last one into the hole, so only that one's position changes */
+  x->eps[i] = x->eps[--x->n];
+  x->eps[i]->entidx_topic_idx = i;
+  if (--tp->nendpoints == 0)
+  {
+    ddsrt_hh_remove (ei->topics, tp);
+    entidx_topic_free (tp);
+  }
+  else if (x->n < x->size / 4)
+  {
+    /* shrink after a burst of deletions, leaving room for growth */
+    x->size /= 2;
+    x->eps = ddsrt_realloc (x->eps, x->size * sizeof (*x->eps));
   }
 }
 
@@ -240,12 +330,15 @@ struct entity_index *entity_index_new (struct ddsi_domaingv *gv)
   } else {
     ddsrt_mutex_init (&entidx->all_entities_lock);
     ddsrt_avl_init (&all_entities_treedef, &entidx->all_entities);
+    entidx->topics = ddsrt_hh_new (1, entidx_topic_hash, entidx_topic_eq);
     return entidx;
   }
 }
 
 void entity_index_free (struct entity_index *entidx)
 {
+  ddsrt_hh_enum (entidx->topics, entidx_topic_free_wrapper, NULL);
+  ddsrt_hh_free (entidx->topics);
   ddsrt_avl_free (&all_entities_treedef, &entidx->all_entities, 0);
   ddsrt_mutex_destroy (&entidx->all_entities_lock);
   ddsrt_chh_free (entidx->guid_hash);
@@ -255,17 +348,23 @@ void entity_index_free (struct entity_index *entidx)
 
 static void add_to_all_entities (struct entity_index *ei, struct entity_common *e)
 {
+  const int kidx = entidx_topic_kind_index (e->kind);
   ddsrt_mutex_lock (&ei->all_entities_lock);
   assert (ddsrt_avl_lookup (&all_entities_treedef, &ei->all_entities, e) == NULL);
   ddsrt_avl_insert (&all_entities_treedef, &ei->all_entities, e);
+  if (kidx >= 0)
+    add_to_topic_index (ei, e, kidx);
   ddsrt_mutex_unlock (&ei->all_entities_lock);
 }
 
 static void remove_from_all_entities (struct entity_index *ei, struct entity_common *e)
 {
+  const int kidx = entidx_topic_kind_index (e->kind);
   ddsrt_mutex_lock (&ei->all_entities_lock);
   assert (ddsrt_avl_lookup (&all_entities_treedef, &ei->all_entities, e) != NULL);
   ddsrt_avl_delete (&all_entities_treedef, &ei->all_entities, e);
+  if (kidx >= 0)
+    remove_from_topic_index (ei, e, kidx);
   ddsrt_mutex_unlock (&ei->all_entities_lock);
 }
 
@@ -432,28 +531,6 @@ static void entidx_enum_init_minmax_int (struct entidx_enum *st, const struct en
   ddsrt_mutex_unlock (&st->entidx->all_entities_lock);
 }
 
-void entidx_enum_init_topic (struct entidx_enum *st, const struct entity_index *ei, enum entity_kind kind, const char *topic, struct match_entities_range_key *max)
-{
-  assert (kind == EK_READER || kind == EK_WRITER || kind == EK_PROXY_READER || kind == EK_PROXY_WRITER);
-  struct match_entities_range_key min;
-  match_endpoint_range (kind, topic, &min, max);
-  entidx_enum_init_minmax_int (st, ei, &min);
-  if (st->cur && all_entities_compare (st->cur, &max->entity) > 0)
-    st->cur = NULL;
-}
-
-void entidx_enum_init_topic_w_prefix (struct entidx_enum *st, const struct entity_index *ei, enum entity_kind kind, const char *topic, const ddsi_guid_prefix_t *prefix, struct match_entities_range_key *max)
-{
-  assert (kind == EK_READER || kind == EK_WRITER || kind == EK_PROXY_READER || kind == EK_PROXY_WRITER);
-  struct match_entities_range_key min;
-  match_endpoint_range (kind, topic, &min, max);
-  min.entity.e.guid.prefix = *prefix;
-  max->entity.e.guid.prefix = *prefix;
-  entidx_enum_init_minmax_int (st, ei, &min);
-  if (st->cur && all_entities_compare (st->cur, &max->entity) > 0)
-    st->cur = NULL;
-}
-
 void entidx_enum_init (struct entidx_enum *st, const struct entity_index *ei, enum entity_kind kind)
 {
   struct match_entities_range_key min;
@@ -509,17 +586,6 @@ void *entidx_enum_next (struct entidx_enum *st)
   return res;
 }
 
-void *entidx_enum_next_max (struct entidx_enum *st, const struct match_entities_range_key *max)
-{
-  void *res = entidx_enum_next (st);
-
-  /* max may only make the bounds tighter */
-  assert (max->entity.e.kind == st->kind);
-  if (st->cur && all_entities_compare (st->cur, &max->entity) > 0)
-    st->cur = NULL;
-  return res;
-}
-
 struct writer *entidx_enum_writer_next (struct entidx_enum_writer *st)
 {
   DDSRT_STATIC_ASSERT (offsetof (struct writer, e) == 0);
@@ -592,6 +658,46 @@ void entidx_enum_proxy_participant_fini (struct entidx_enum_proxy_participant *s
   entidx_enum_fini (&st->st);
 }
 
+void entidx_enum_endpoints_init (struct entidx_enum_endpoints *st, const struct entity_index *ei, enum entity_kind kind, const struct entity_common *ep)
+{
+  /* Copying the pointers while holding the lock avoids having to deal with concurrent
+     modifications of the array, the entities themselves remain valid for as long as the
+     thread is awake because the GC doesn't free them before */
+  struct entity_index * const entidx = (struct entity_index *) ei;
+  const int kidx = entidx_topic_kind_index (kind);
+  const struct entidx_topic *tp;
+  assert (kidx >= 0);
+#ifndef NDEBUG
+  assert (thread_is_awake ());
+  st->vtime = ddsrt_atomic_ld32 (&lookup_thread_state ()->vtime);
+#endif
+  st->eps = st->eps_inline;
+  st->n = st->i = 0;
+  ddsrt_mutex_lock (&entidx->all_entities_lock);
+  if ((tp = ep->entidx_topic) != NULL && tp->eps[kidx].n > 0)
+  {
+    const struct entidx_topic_eps *x = &tp->eps[kidx];
+    if (x->n > ENTIDX_ENUM_ENDPOINTS_INLINE)
+      st->eps = ddsrt_malloc (x->n * sizeof (*st->eps));
+    memcpy (st->eps, x->eps, x->n * sizeof (*st->eps));
+    st->n = x->n;
+  }
+  ddsrt_mutex_unlock (&entidx->all_entities_lock);
+}
+
+void *entidx_enum_endpoints_next (struct entidx_enum_endpoints *st)
+{
+  assert (ddsrt_atomic_ld32 (&lookup_thread_state ()->vtime) == st->vtime);
+  return (st->i < st->n) ? st->eps[st->i++] : NULL;
+}
+
+void entidx_enum_endpoints_fini (struct entidx_enum_endpoints *st)
+{
+  assert (ddsrt_atomic_ld32 (&lookup_thread_state ()->vtime) == st->vtime);
+  if (st->eps != st->eps_inline)
+    ddsrt_free (st->eps);
+}
+
 #ifdef DDS_HAS_TOPIC_DISCOVERY
 
 void entidx_insert_topic_guid (struct entity_index *ei, struct topic *tp)
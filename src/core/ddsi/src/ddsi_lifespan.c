@@ -12,19 +12,10 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include "dds/ddsrt/heap.h"
-#include "dds/ddsrt/fibheap.h"
+#include "dds/ddsrt/timewheel.h"
 #include "dds/ddsi/ddsi_lifespan.h"
 #include "dds/ddsi/q_xevent.h"
 
-static int compare_lifespan_texp (const void *va, const void *vb)
-{
-  const struct lifespan_fhnode *a = va;
-  const struct lifespan_fhnode *b = vb;
-  return (a->t_expire.v == b->t_expire.v) ? 0 : (a->t_expire.v < b->t_expire.v) ? -1 : 1;
-}
-
-const ddsrt_fibheap_def_t lifespan_fhdef = DDSRT_FIBHEAPDEF_INITIALIZER(offsetof (struct lifespan_fhnode, heapnode), compare_lifespan_texp);
-
 static void lifespan_rhc_node_exp (struct xevent *xev, void *varg, ddsrt_mtime_t tnow)
 {
   struct lifespan_adm * const lifespan_adm = varg;
@@ -33,41 +24,45 @@ static void lifespan_rhc_node_exp (struct xevent *xev, void *varg, ddsrt_mtime_t
 }
 
 
-/* Gets the sample from the fibheap in lifespan admin that was expired first. If no more
- * expired samples exist in the fibheap, the expiry time (ddsrt_mtime_t) for the next sample to
- * expire is returned. If the fibheap contains no more samples, DDSRT_MTIME_NEVER is returned */
-ddsrt_mtime_t lifespan_next_expired_locked (const struct lifespan_adm *lifespan_adm, ddsrt_mtime_t tnow, void **sample)
+/* Gets a sample from the lifespan admin that has expired, the sample is not
+ * removed. If no sample has expired, a lower bound for the expiry time of the
+ * first sample to expire is returned (the timing wheel does not track the
+ * exact expiry of samples far in the future), or DDSRT_MTIME_NEVER if there
+ * are no samples with a finite lifespan */
+ddsrt_mtime_t lifespan_next_expired_locked (struct lifespan_adm *lifespan_adm, ddsrt_mtime_t tnow, void **sample)
 {
-  struct lifespan_fhnode *node;
-  if ((node = ddsrt_fibheap_min(&lifespan_fhdef, &lifespan_adm->ls_exp_heap)) != NULL && node->t_expire.v <= tnow.v)
+  ddsrt_timewheel_node_t *twn;
+  if ((twn = ddsrt_timewheel_next_expired (&lifespan_adm->ls_exp_wheel, tnow.v)) != NULL)
   {
+    struct lifespan_fhnode *node = DDSRT_FROM_TIMEWHEEL (struct lifespan_fhnode, wheelnode, twn);
     *sample = (char *)node - lifespan_adm->fhn_offset;
     return (ddsrt_mtime_t) { 0 };
   }
   *sample = NULL;
-  return (node != NULL) ? node->t_expire : DDSRT_MTIME_NEVER;
+  return (ddsrt_mtime_t) { ddsrt_timewheel_next_time (&lifespan_adm->ls_exp_wheel) };
 }
 
 void lifespan_init (const struct ddsi_domaingv *gv, struct lifespan_adm *lifespan_adm, size_t fh_offset, size_t fh_node_offset, sample_expired_cb_t sample_expired_cb)
 {
-  ddsrt_fibheap_init (&lifespan_fhdef, &lifespan_adm->ls_exp_heap);
+  ddsrt_timewheel_init (&lifespan_adm->ls_exp_wheel);
   lifespan_adm->evt = qxev_callback (gv->xevents, DDSRT_MTIME_NEVER, lifespan_rhc_node_exp, lifespan_adm);
   lifespan_adm->sample_expired_cb = sample_expired_cb;
   lifespan_adm->fh_offset = fh_offset;
   lifespan_adm->fhn_offset = fh_node_offset;
 }
 
-void lifespan_fini (const struct lifespan_adm *lifespan_adm)
+void lifespan_fini (struct lifespan_adm *lifespan_adm)
 {
-  assert (ddsrt_fibheap_min (&lifespan_fhdef, &lifespan_adm->ls_exp_heap) == NULL);
+  assert (ddsrt_timewheel_isempty (&lifespan_adm->ls_exp_wheel));
   delete_xevent_callback (lifespan_adm->evt);
+  ddsrt_timewheel_fini (&lifespan_adm->ls_exp_wheel);
 }
 
 DDS_EXPORT extern inline void lifespan_register_sample_locked (struct lifespan_adm *lifespan_adm, struct lifespan_fhnode *node);
 
 void lifespan_register_sample_real (struct lifespan_adm *lifespan_adm, struct lifespan_fhnode *node)
 {
-  ddsrt_fibheap_insert(&lifespan_fhdef, &lifespan_adm->ls_exp_heap, node);
+  ddsrt_timewheel_insert (&lifespan_adm->ls_exp_wheel, &node->wheelnode, node->t_expire.v);
   resched_xevent_if_earlier (lifespan_adm->evt, node->t_expire);
 }
 
@@ -78,6 +73,6 @@ void lifespan_unregister_sample_real (struct lifespan_adm *lifespan_adm, struct
   /* Updating the scheduled event with the new shortest expiry
    * is not required, because the event will be rescheduled when
    * this removed node expires. Only remove the node from the
-   * lifespan heap */
-  ddsrt_fibheap_delete(&lifespan_fhdef, &lifespan_adm->ls_exp_heap, node);
+   * lifespan timing wheel */
+  ddsrt_timewheel_delete (&lifespan_adm->ls_exp_wheel, &node->wheelnode);
 }
@@ -1826,6 +1826,7 @@ static const struct piddesc piddesc_omg[] = {
   PP  (PARTICIPANT_MANUAL_LIVELINESS_COUNT, participant_manual_liveliness_count, Xi),
   PP  (PARTICIPANT_BUILTIN_ENDPOINTS,       participant_builtin_endpoints, Xu),
   PP  (PARTICIPANT_LEASE_DURATION,          participant_lease_duration, XD),
+  PP  (CONTENT_FILTER_PROPERTY,             content_filter_property, XS, XS, XS, XS, XQ, XS, XSTOP),
   PPV (PARTICIPANT_GUID,                    participant_guid, XG),
   PPV (GROUP_GUID,                          group_guid, XG),
   PP  (BUILTIN_ENDPOINT_SET,                builtin_endpoint_set, Xu),
@@ -2001,11 +2002,11 @@ static const struct piddesc_index piddesc_vendor_index[] = {
    initialized by ddsi_plist_init_tables; will assert when
    table too small or too large */
 #ifdef DDS_HAS_TYPE_DISCOVERY
+static const struct piddesc *piddesc_unalias[21 + SECURITY_PROC_ARRAY_SIZE];
+static const struct piddesc *piddesc_fini[21 + SECURITY_PROC_ARRAY_SIZE];
+#else
 static const struct piddesc *piddesc_unalias[20 + SECURITY_PROC_ARRAY_SIZE];
 static const struct piddesc *piddesc_fini[20 + SECURITY_PROC_ARRAY_SIZE];
-#else
-static const struct piddesc *piddesc_unalias[19 + SECURITY_PROC_ARRAY_SIZE];
-static const struct piddesc *piddesc_fini[19 + SECURITY_PROC_ARRAY_SIZE];
 #endif
 static uint64_t plist_fini_mask, qos_fini_mask;
 static ddsrt_once_t table_init_control = DDSRT_ONCE_INIT;
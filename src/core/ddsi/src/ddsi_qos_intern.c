@@ -0,0 +1,251 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsrt/mh3.h"
+#include "dds/ddsi/ddsi_qos_intern.h"
+#include "dds/ddsi/q_gc.h"
+
+struct ddsi_qos_intern_node {
+  dds_qos_t xqos; /* must be first */
+  struct ddsi_qos_intern *owner;
+  struct ddsi_qos_intern_node *next; /* next node with the same hash */
+  uint64_t id;
+  uint32_t hash;
+  uint32_t refc;
+};
+
+/* The hash table contains the first node of each chain of nodes with the same
+   hash; the hash doesn't cover all policies and ddsrt_hh can't hold more than a
+   handful of entries with the same hash, so unequal QoS objects with the same
+   hash are chained rather than added to the table. */
+struct ddsi_qos_intern {
+  ddsrt_mutex_t lock;
+  struct ddsrt_hh *chains;
+  uint64_t next_id;
+};
+
+static uint32_t hash_octetseq (const ddsi_octetseq_t *x, uint32_t seed)
+{
+  return ddsrt_mh3 (x->value, x->length, seed);
+}
+
+static uint32_t hash_string (const char *x, uint32_t seed)
+{
+  return ddsrt_mh3 (x, strlen (x), seed);
+}
+
+static uint32_t qos_hash (const dds_qos_t *xqos)
+{
+  /* Hashing the distinguishing features is good enough: what makes endpoints
+     different in practice is their topic, partitions, reliability and
+     durability settings and the various kinds of user data.  Equality is
+     checked in full. */
+  const uint64_t present = xqos->present;
+  uint32_t h = ddsrt_mh3 (&present, sizeof (present), 0);
+  if (present & QP_TOPIC_NAME)
+    h = hash_string (xqos->topic_name, h);
+  if (present & QP_TYPE_NAME)
+    h = hash_string (xqos->type_name, h);
+  if (present & QP_PARTITION)
+  {
+    /* partition is a set, so the hash must not depend on the order */
+    uint32_t hp = 0;
+    for (uint32_t i = 0; i < xqos->partition.n; i++)
+      hp ^= hash_string (xqos->partition.strs[i], 0);
+    h = ddsrt_mh3 (&hp, sizeof (hp), h);
+  }
+  if (present & QP_USER_DATA)
+    h = hash_octetseq (&xqos->user_data, h);
+  if (present & QP_TOPIC_DATA)
+    h = hash_octetseq (&xqos->topic_data, h);
+  if (present & QP_GROUP_DATA)
+    h = hash_octetseq (&xqos->group_data, h);
+#ifdef DDS_HAS_TYPE_DISCOVERY
+  if (present & QP_CYCLONE_TYPE_INFORMATION)
+    h = hash_octetseq (&xqos->type_information, h);
+#endif
+  const int32_t kinds[] = {
+    (present & QP_RELIABILITY) ? (int32_t) xqos->reliability.kind : -1,
+    (present & QP_DURABILITY) ? (int32_t) xqos->durability.kind : -1,
+    (present & QP_HISTORY) ? (int32_t) xqos->history.kind : -1,
+    (present & QP_HISTORY) ? xqos->history.depth : -1,
+    (present & QP_OWNERSHIP) ? (int32_t) xqos->ownership.kind : -1,
+    (present & QP_OWNERSHIP_STRENGTH) ? xqos->ownership_strength.value : -1,
+    (present & QP_LIVELINESS) ? (int32_t) xqos->liveliness.kind : -1
+  };
+  h = ddsrt_mh3 (kinds, sizeof (kinds), h);
+  const dds_duration_t durations[] = {
+    (present & QP_DEADLINE) ? xqos->deadline.deadline : -1,
+    (present & QP_LATENCY_BUDGET) ? xqos->latency_budget.duration : -1,
+    (present & QP_LIFESPAN) ? xqos->lifespan.duration : -1,
+    (present & QP_LIVELINESS) ? xqos->liveliness.lease_duration : -1
+  };
+  return ddsrt_mh3 (durations, sizeof (durations), h);
+}
+
+static uint32_t node_hash (const void *va)
+{
+  const struct ddsi_qos_intern_node *a = va;
+  return a->hash;
+}
+
+static int node_hash_equal (const void *va, const void *vb)
+{
+  const struct ddsi_qos_intern_node *a = va;
+  const struct ddsi_qos_intern_node *b = vb;
+  return a->hash == b->hash;
+}
+
+struct ddsi_qos_intern *ddsi_qos_intern_new (void)
+{
+  struct ddsi_qos_intern *qi = ddsrt_malloc (sizeof (*qi));
+  ddsrt_mutex_init (&qi->lock);
+  qi->chains = ddsrt_hh_new (32, node_hash, node_hash_equal);
+  qi->next_id = 1;
+  return qi;
+}
+
+void ddsi_qos_intern_free (struct ddsi_qos_intern *qi)
+{
+#ifndef NDEBUG
+  struct ddsrt_hh_iter it;
+  assert (ddsrt_hh_iter_first (qi->chains, &it) == NULL);
+#endif
+  ddsrt_hh_free (qi->chains);
+  ddsrt_mutex_destroy (&qi->lock);
+  ddsrt_free (qi);
+}
+
+dds_qos_t *ddsi_qos_intern_ref (struct ddsi_qos_intern *qi, const dds_qos_t *xqos)
+{
+  struct ddsi_qos_intern_node *template, *n;
+  /* A shallow copy suffices for the lookup, if it fails the node becomes
+     the new entry after all */
+  template = ddsrt_malloc (sizeof (*template));
+  memcpy (&template->xqos, xqos, sizeof (*xqos));
+  template->hash = qos_hash (xqos);
+  ddsrt_mutex_lock (&qi->lock);
+  struct ddsi_qos_intern_node * const head = ddsrt_hh_lookup (qi->chains, template);
+  for (n = head; n != NULL; n = n->next)
+  {
+    if (ddsi_xqos_delta (&n->xqos, xqos, ~(uint64_t)0) == 0)
+    {
+      n->refc++;
+      ddsrt_mutex_unlock (&qi->lock);
+      ddsrt_free (template);
+      return &n->xqos;
+    }
+  }
+  n = template;
+  ddsi_xqos_copy (&n->xqos, xqos);
+  n->owner = qi;
+  n->id = qi->next_id++;
+  n->refc = 1;
+  if (head == NULL)
+  {
+    n->next = NULL;
+    ddsrt_hh_add (qi->chains, n);
+  }
+  else
+  {
+    n->next = head->next;
+    head->next = n;
+  }
+  ddsrt_mutex_unlock (&qi->lock);
+  return &n->xqos;
+}
+
+void ddsi_qos_intern_unref (struct ddsi_qos_intern *qi, const dds_qos_t *xqos)
+{
+  struct ddsi_qos_intern_node *n = (struct ddsi_qos_intern_node *) xqos;
+  ddsrt_mutex_lock (&qi->lock);
+  assert (n->refc > 0);
+  if (--n->refc > 0)
+    n = NULL;
+  else
+  {
+    struct ddsi_qos_intern_node * const head = ddsrt_hh_lookup (qi->chains, n);
+    assert (head != NULL);
+    if (head == n)
+    {
+      /* the next one in the chain, if any, takes its place in the table */
+      ddsrt_hh_remove (qi->chains, n);
+      if (n->next)
+        ddsrt_hh_add (qi->chains, n->next);
+    }
+    else
+    {
+      struct ddsi_qos_intern_node *prev = head;
+      while (prev->next != n)
+        prev = prev->next;
+      prev->next = n->next;
+    }
+  }
+  ddsrt_mutex_unlock (&qi->lock);
+  if (n)
+  {
+    ddsi_xqos_fini (&n->xqos);
+    ddsrt_free (n);
+  }
+}
+
+static void gc_qos_intern_unref (struct gcreq *gcreq)
+{
+  const struct ddsi_qos_intern_node *n = gcreq->arg;
+  ddsi_qos_intern_unref (n->owner, &n->xqos);
+  gcreq_free (gcreq);
+}
+
+void ddsi_qos_intern_unref_gc (struct ddsi_qos_intern *qi, struct gcreq_queue *gcreq_queue, const dds_qos_t *xqos)
+{
+  const struct ddsi_qos_intern_node *n = (const struct ddsi_qos_intern_node *) xqos;
+  assert (n->owner == qi);
+  (void) qi;
+  struct gcreq *gcreq = gcreq_new (gcreq_queue, gc_qos_intern_unref);
+  gcreq->arg = (void *) n;
+  gcreq_enqueue (gcreq);
+}
+
+uint64_t ddsi_qos_intern_id (const dds_qos_t *xqos)
+{
+  const struct ddsi_qos_intern_node *n = (const struct ddsi_qos_intern_node *) xqos;
+  return n->id;
+}
+
+void ddsi_qos_match_cache_init (struct ddsi_qos_match_cache *mc)
+{
+  for (uint32_t i = 0; i < DDSI_QOS_MATCH_CACHE_SIZE; i++)
+    mc->e[i].id = 0;
+}
+
+bool ddsi_qos_match_cache_lookup (const struct ddsi_qos_match_cache *mc, uint64_t id, bool *match, dds_qos_policy_id_t *reason)
+{
+  const struct ddsi_qos_match_cache_entry *e = &mc->e[id % DDSI_QOS_MATCH_CACHE_SIZE];
+  if (e->id != id)
+    return false;
+  *match = e->match;
+  *reason = e->reason;
+  return true;
+}
+
+void ddsi_qos_match_cache_insert (struct ddsi_qos_match_cache *mc, uint64_t id, bool match, dds_qos_policy_id_t reason)
+{
+  struct ddsi_qos_match_cache_entry *e = &mc->e[id % DDSI_QOS_MATCH_CACHE_SIZE];
+  e->id = id;
+  e->match = match;
+  e->reason = reason;
+}
@@ -228,7 +228,9 @@ static dds_return_t ddsi_raweth_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tr
   uc->m_base.m_base.m_handle_fn = ddsi_raweth_conn_handle;
   uc->m_base.m_locator_fn = ddsi_raweth_conn_locator;
   uc->m_base.m_read_fn = ddsi_raweth_conn_read;
+  uc->m_base.m_read_batch_fn = 0;
   uc->m_base.m_write_fn = ddsi_raweth_conn_write;
+  uc->m_base.m_write_multi_fn = 0;
   uc->m_base.m_disable_multiplexing_fn = 0;
 
   DDS_CTRACE (&fact->gv->logconfig, "ddsi_raweth_create_conn %s socket %d port %u\n", mcast ? "multicast" : "unicast", uc->m_sock, uc->m_base.m_base.m_port);
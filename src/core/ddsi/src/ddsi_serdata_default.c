@@ -18,6 +18,7 @@
 #include "dds/ddsrt/log.h"
 #include "dds/ddsrt/md5.h"
 #include "dds/ddsrt/mh3.h"
+#include "dds/ddsrt/string.h"
 #include "dds/ddsi/q_bswap.h"
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_freelist.h"
@@ -101,6 +102,85 @@ static void serdata_default_append_blob (struct ddsi_serdata_default **d, size_t
   memcpy (p, data, sz);
 }
 
+/* Returns a pointer to the CDR header that is immediately followed by the data, which
+   is either in the serdata itself, in the received message it references or in a
+   separate buffer */
+static const char *serdata_default_cdr (const struct ddsi_serdata_default *d)
+{
+  return d->hdr_ref ? (const char *) d->hdr_ref : (const char *) &d->hdr;
+}
+
+/* A serdata constructed by from_sample_ref that has not been detached yet: its CDR
+   is made up of the pieces in the serdata, interleaved with the referenced sequences
+   in the sample */
+static bool serdata_default_is_scattered (const struct ddsi_serdata_default *d)
+{
+  return d->extrefs != NULL && d->hdr_ref == NULL;
+}
+
+static uint32_t serdata_default_sg_npieces (const struct ddsi_serdata_default *d)
+{
+  return 2 * d->extrefs->n + 1;
+}
+
+static void serdata_default_sg_piece (const struct ddsi_serdata_default *d, uint32_t i, const char **ptr, size_t *len)
+{
+  const struct dds_ostream_extrefs * const x = d->extrefs;
+  const uint32_t k = i / 2;
+  if (i % 2)
+  {
+    *ptr = x->refs[k].ptr;
+    *len = x->refs[k].len;
+  }
+  else
+  {
+    const size_t hdrsz = sizeof (struct CDRHeader);
+    const size_t start = (k == 0) ? 0 : hdrsz + x->refs[k - 1].index + x->refs[k - 1].len % 8;
+    const size_t end = hdrsz + ((k < x->n) ? x->refs[k].index : d->pos - x->skipped);
+    *ptr = (const char *) &d->hdr + start;
+    *len = end - start;
+  }
+}
+
+static void serdata_default_sg_to_ser (const struct ddsi_serdata_default *d, size_t off, size_t sz, char *buf)
+{
+  const uint32_t npieces = serdata_default_sg_npieces (d);
+  size_t pstart = 0;
+  for (uint32_t i = 0; i < npieces && sz > 0; i++)
+  {
+    const char *ptr;
+    size_t len;
+    serdata_default_sg_piece (d, i, &ptr, &len);
+    if (off < pstart + len)
+    {
+      const size_t n = (pstart + len - off < sz) ? pstart + len - off : sz;
+      memcpy (buf, ptr + (off - pstart), n);
+      buf += n;
+      off += n;
+      sz -= n;
+    }
+    pstart += len;
+  }
+  assert (sz == 0);
+}
+
+static bool serdata_default_sg_is_piece (const struct ddsi_serdata_default *d, const void *ref)
+{
+  const uintptr_t p = (uintptr_t) ref;
+  const uint32_t npieces = serdata_default_sg_npieces (d);
+  if (d->hdr_ref && p >= (uintptr_t) d->hdr_ref && p < (uintptr_t) d->hdr_ref + sizeof (struct CDRHeader) + d->pos)
+    return true;
+  for (uint32_t i = 0; i < npieces; i++)
+  {
+    const char *ptr;
+    size_t len;
+    serdata_default_sg_piece (d, i, &ptr, &len);
+    if (p >= (uintptr_t) ptr && p < (uintptr_t) ptr + len)
+      return true;
+  }
+  return false;
+}
+
 static const unsigned char *serdata_default_keybuf(const struct ddsi_serdata_default *d)
 {
   assert(d->key.buftype != KEYBUFTYPE_UNSET);
@@ -145,14 +225,29 @@ static void serdata_default_free(struct ddsi_serdata *dcmn)
   struct ddsi_serdata_default *d = (struct ddsi_serdata_default *)dcmn;
   assert(ddsrt_atomic_ld32(&d->c.refc) == 0);
 
+  const bool pinned = (d->rmsg != NULL);
   if (d->key.buftype == KEYBUFTYPE_DYNALLOC)
     ddsrt_free(d->key.u.dynbuf);
+  if (pinned)
+    nn_rmsg_unpin (d->rmsg, d->pos);
+  else if (d->hdr_ref)
+    ddsrt_free ((void *) d->hdr_ref);
+  if (d->extrefs)
+  {
+    ddsrt_free (d->extrefs->refs);
+    ddsrt_free (d->extrefs);
+  }
+  void *shared_sample;
+  if ((shared_sample = ddsrt_atomic_ldvoidp (&d->shared_sample)) != NULL)
+    ddsi_sertype_free_sample (d->c.type, shared_sample, DDS_FREE_ALL);
 
 #ifdef DDS_HAS_SHM
   free_iox_chunk(d->c.iox_subscriber, &d->c.iox_chunk);
 #endif
 
-  if (d->size > MAX_SIZE_FOR_POOL || !nn_freelist_push (&d->serpool->freelist, d))
+  /* A serdata referencing a received message may outlive the domain, e.g., after
+     dds_takecdr, so it doesn't go back to the domain's pool */
+  if (pinned || d->size > MAX_SIZE_FOR_POOL || !nn_freelist_push (&d->serpool->freelist, d))
     dds_free (d);
 }
 
@@ -170,6 +265,10 @@ static void serdata_default_init(struct ddsi_serdata_default *d, const struct dd
   d->hdr.options = 0;
   d->key.buftype = KEYBUFTYPE_UNSET;
   d->key.keysize = 0;
+  d->rmsg = NULL;
+  d->hdr_ref = NULL;
+  d->extrefs = NULL;
+  ddsrt_atomic_stvoidp (&d->shared_sample, NULL);
 }
 
 static struct ddsi_serdata_default *serdata_default_allocnew (struct serdatapool *serpool, uint32_t init_size)
@@ -289,27 +388,46 @@ static void gen_serdata_key_from_cdr (dds_istream_t * __restrict is, struct ddsi
   gen_serdata_key (type, kh, just_key ? GSKIK_CDRKEY : GSKIK_CDRSAMPLE, is);
 }
 
-/* Construct a serdata from a fragchain received over the network */
-static struct ddsi_serdata_default *serdata_default_from_ser_common (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const struct nn_rdata *fragchain, size_t size)
+/* Construct a serdata that references the received message instead of copying it, if
+   the sample is large enough to make it worthwhile, is contained in a single fragment,
+   doesn't require byte swapping and the limit on pinned bytes hasn't been reached */
+static struct ddsi_serdata_default *serdata_default_from_ser_rmsg (const struct ddsi_sertype_default *tp, enum ddsi_serdata_kind kind, const struct nn_rdata *fragchain, size_t size, const unsigned char *cdr)
 {
-  const struct ddsi_sertype_default *tp = (const struct ddsi_sertype_default *)tpcmn;
+  struct ddsi_domaingv const * const gv = ddsrt_atomic_ldvoidp (&tp->c.gv);
+  struct CDRHeader hdr;
+  if (gv == NULL || gv->config.zerocopy_receive_min_size == 0 || size < gv->config.zerocopy_receive_min_size)
+    return NULL;
+  if (fragchain->nextfrag != NULL || fragchain->maxp1 != size || ((uintptr_t) cdr % 4) != 0)
+    return NULL;
+  memcpy (&hdr, cdr, sizeof (hdr));
+  if (!CDR_ENC_IS_NATIVE (hdr.identifier))
+    return NULL;
 
-  /* FIXME: check whether this really is the correct maximum: offsets are relative
-     to the CDR header, but there are also some places that use a serdata as-if it
-     were a stream, and those use offsets (m_index) relative to the start of the
-     serdata */
-  if (size > UINT32_MAX - offsetof (struct ddsi_serdata_default, hdr))
+  const uint32_t pos = (uint32_t) size - (uint32_t) sizeof (hdr);
+  if (!nn_rmsg_pin (fragchain->rmsg, pos))
+    return NULL;
+  struct ddsi_serdata_default *d = serdata_default_new_size (tp, kind, 0, CDR_ENC_VERSION_UNDEF);
+  if (d == NULL)
+  {
+    nn_rmsg_unpin (fragchain->rmsg, pos);
     return NULL;
+  }
+  d->hdr = hdr;
+  assert_valid_xcdr_id (d->hdr.identifier);
+  d->rmsg = fragchain->rmsg;
+  d->hdr_ref = (const struct CDRHeader *) cdr;
+  d->pos = pos;
+  return d;
+}
+
+static struct ddsi_serdata_default *serdata_default_from_ser_copy (const struct ddsi_sertype_default *tp, enum ddsi_serdata_kind kind, const struct nn_rdata *fragchain, size_t size, const unsigned char *cdr)
+{
   struct ddsi_serdata_default *d = serdata_default_new_size (tp, kind, (uint32_t) size, CDR_ENC_VERSION_UNDEF);
   if (d == NULL)
     return NULL;
 
   uint32_t off = 4; /* must skip the CDR header */
-
-  assert (fragchain->min == 0);
-  assert (fragchain->maxp1 >= off); /* CDR header must be in first fragment */
-
-  memcpy (&d->hdr, NN_RMSG_PAYLOADOFF (fragchain->rmsg, NN_RDATA_PAYLOAD_OFF (fragchain)), sizeof (d->hdr));
+  memcpy (&d->hdr, cdr, sizeof (d->hdr));
   assert_valid_xcdr_id (d->hdr.identifier);
 
   while (fragchain)
@@ -325,6 +443,31 @@ static struct ddsi_serdata_default *serdata_default_from_ser_common (const struc
     }
     fragchain = fragchain->nextfrag;
   }
+  return d;
+}
+
+/* Construct a serdata from a fragchain received over the network */
+static struct ddsi_serdata_default *serdata_default_from_ser_common (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const struct nn_rdata *fragchain, size_t size)
+{
+  const struct ddsi_sertype_default *tp = (const struct ddsi_sertype_default *)tpcmn;
+
+  /* FIXME: check whether this really is the correct maximum: offsets are relative
+     to the CDR header, but there are also some places that use a serdata as-if it
+     were a stream, and those use offsets (m_index) relative to the start of the
+     serdata */
+  if (size > UINT32_MAX - offsetof (struct ddsi_serdata_default, hdr))
+    return NULL;
+  assert (fragchain->min == 0);
+  assert (fragchain->maxp1 >= 4); /* CDR header must be in first fragment */
+  const unsigned char *cdr = NN_RMSG_PAYLOADOFF (fragchain->rmsg, NN_RDATA_PAYLOAD_OFF (fragchain));
+  struct ddsi_serdata_default *d;
+  char *data;
+  if ((d = serdata_default_from_ser_rmsg (tp, kind, fragchain, size, cdr)) != NULL)
+    data = (char *) (d->hdr_ref + 1);
+  else if ((d = serdata_default_from_ser_copy (tp, kind, fragchain, size, cdr)) != NULL)
+    data = d->data;
+  else
+    return NULL;
 
   const bool needs_bswap = !CDR_ENC_IS_NATIVE (d->hdr.identifier);
   d->hdr.identifier = CDR_ENC_TO_NATIVE (d->hdr.identifier);
@@ -336,7 +479,7 @@ static struct ddsi_serdata_default *serdata_default_from_ser_common (const struc
     ddsi_serdata_unref (&d->c);
     return NULL;
   }
-  else if (!dds_stream_normalize (d->data, d->pos - pad, needs_bswap, xcdr_version, tp, kind == SDK_KEY, &actual_size))
+  else if (!dds_stream_normalize (data, d->pos - pad, needs_bswap, xcdr_version, tp, kind == SDK_KEY, &actual_size))
   {
     ddsi_serdata_unref (&d->c);
     return NULL;
@@ -344,7 +487,7 @@ static struct ddsi_serdata_default *serdata_default_from_ser_common (const struc
   else
   {
     dds_istream_t is;
-    dds_istream_init (&is, actual_size, d->data, get_xcdr_version (d->hdr.identifier));
+    dds_istream_init (&is, actual_size, data, get_xcdr_version (d->hdr.identifier));
     gen_serdata_key_from_cdr (&is, &d->key, tp, kind == SDK_KEY);
     // for (int n = 0; n < d->key.keysize; n++) {
     //   if (d->key.buftype == KEYBUFTYPE_DYNALLOC || d->key.buftype == KEYBUFTYPE_DYNALIAS)
@@ -517,7 +660,18 @@ static struct ddsi_serdata* serdata_default_from_iox(const struct ddsi_sertype*
 #endif
 
 
-static struct ddsi_serdata_default *serdata_default_from_sample_cdr_common (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, uint32_t xcdr_version, const void *sample)
+static void serdata_default_adopt_extrefs (struct ddsi_serdata_default *d, struct dds_ostream_extrefs *x)
+{
+  /* The stream starts at the serdata rather than at the data, and the size of the
+     data includes the referenced bytes that aren't in the serdata */
+  const uint32_t off = (uint32_t) offsetof (struct ddsi_serdata_default, data);
+  for (uint32_t i = 0; i < x->n; i++)
+    x->refs[i].index -= off;
+  d->pos += x->skipped;
+  d->extrefs = ddsrt_memdup (x, sizeof (*x));
+}
+
+static struct ddsi_serdata_default *serdata_default_from_sample_cdr_common (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, uint32_t xcdr_version, const void *sample, uint32_t min_ref_size, bool lazy_key)
 {
   const struct ddsi_sertype_default *tp = (const struct ddsi_sertype_default *)tpcmn;
   struct ddsi_serdata_default *d = serdata_default_new(tp, kind, xcdr_version);
@@ -557,43 +711,98 @@ static struct ddsi_serdata_default *serdata_default_from_sample_cdr_common (cons
         gen_serdata_key_from_sample (tp, &d->key, sample);
       }
       break;
-    case SDK_DATA:
+    case SDK_DATA: {
+      struct dds_ostream_extrefs x = { .min_size = min_ref_size, .skipped = 0, .n = 0, .max = 0, .refs = NULL };
+      if (min_ref_size > 0)
+        os.m_extrefs = &x;
       dds_stream_write_sample (&os, sample, tp);
       dds_ostream_add_to_serdata_default (&os, &d);
-      gen_serdata_key_from_sample (tp, &d->key, sample);
+      if (x.n > 0)
+        serdata_default_adopt_extrefs (d, &x);
+      /* a lazy key is computed from the CDR when needed, which requires it to be contiguous */
+      if (!lazy_key || x.n > 0)
+        gen_serdata_key_from_sample (tp, &d->key, sample);
       break;
+    }
   }
   return d;
 }
 
-static struct ddsi_serdata *serdata_default_from_sample_data_representation (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, dds_data_representation_id_t data_representation, const void *sample, bool key)
+static struct ddsi_serdata *serdata_default_from_sample_data_representation (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, dds_data_representation_id_t data_representation, const void *sample, uint32_t min_ref_size, bool key)
 {
   assert (data_representation == DDS_DATA_REPRESENTATION_XCDR1 || data_representation == DDS_DATA_REPRESENTATION_XCDR2);
   struct ddsi_serdata_default *d;
   uint32_t xcdr_version = data_representation == DDS_DATA_REPRESENTATION_XCDR1 ? CDR_ENC_VERSION_1 : CDR_ENC_VERSION_2;
-  if ((d = serdata_default_from_sample_cdr_common (tpcmn, kind, xcdr_version, sample)) == NULL)
+  if ((d = serdata_default_from_sample_cdr_common (tpcmn, kind, xcdr_version, sample, min_ref_size, false)) == NULL)
     return NULL;
   return key ? fix_serdata_default (d, tpcmn->serdata_basehash) : fix_serdata_default_nokey (d, tpcmn->serdata_basehash);
 }
 
+static struct ddsi_serdata *serdata_default_from_sample_lazykey_data_representation (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, dds_data_representation_id_t data_representation, const void *sample)
+{
+  assert (data_representation == DDS_DATA_REPRESENTATION_XCDR1 || data_representation == DDS_DATA_REPRESENTATION_XCDR2);
+  struct ddsi_serdata_default *d;
+  uint32_t xcdr_version = data_representation == DDS_DATA_REPRESENTATION_XCDR1 ? CDR_ENC_VERSION_1 : CDR_ENC_VERSION_2;
+  if ((d = serdata_default_from_sample_cdr_common (tpcmn, kind, xcdr_version, sample, 0, true)) == NULL)
+    return NULL;
+  /* without a key there is nothing to hash, the hash is only used for instance lookups and
+     those are not allowed for a serdata without a key anyway */
+  return (d->key.buftype != KEYBUFTYPE_UNSET) ? fix_serdata_default (d, tpcmn->serdata_basehash) : fix_serdata_default_nokey (d, tpcmn->serdata_basehash);
+}
+
 static struct ddsi_serdata *serdata_default_from_sample_cdr (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
 {
-  return serdata_default_from_sample_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR1, sample, true);
+  return serdata_default_from_sample_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR1, sample, 0, true);
 }
 
 static struct ddsi_serdata *serdata_default_from_sample_xcdr2 (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
 {
-  return serdata_default_from_sample_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR2, sample, true);
+  return serdata_default_from_sample_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR2, sample, 0, true);
 }
 
 static struct ddsi_serdata *serdata_default_from_sample_cdr_nokey (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
 {
-  return serdata_default_from_sample_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR1, sample, false);
+  return serdata_default_from_sample_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR1, sample, 0, false);
 }
 
 static struct ddsi_serdata *serdata_default_from_sample_xcdr2_nokey (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
 {
-  return serdata_default_from_sample_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR2, sample, false);
+  return serdata_default_from_sample_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR2, sample, 0, false);
+}
+
+static struct ddsi_serdata *serdata_default_from_sample_lazykey_cdr (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
+{
+  return serdata_default_from_sample_lazykey_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR1, sample);
+}
+
+static struct ddsi_serdata *serdata_default_from_sample_lazykey_xcdr2 (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
+{
+  return serdata_default_from_sample_lazykey_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR2, sample);
+}
+
+/* Only for XCDR1: sequences can't be referenced in XCDR2 because of the DHEADERs */
+static struct ddsi_serdata *serdata_default_from_sample_ref_cdr (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const void *sample, uint32_t min_ref_size)
+{
+  return serdata_default_from_sample_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR1, sample, min_ref_size, true);
+}
+
+static struct ddsi_serdata *serdata_default_from_sample_ref_cdr_nokey (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const void *sample, uint32_t min_ref_size)
+{
+  return serdata_default_from_sample_data_representation (tpcmn, kind, DDS_DATA_REPRESENTATION_XCDR1, sample, min_ref_size, false);
+}
+
+static void serdata_default_detach (struct ddsi_serdata *serdata_common)
+{
+  struct ddsi_serdata_default *d = (struct ddsi_serdata_default *)serdata_common;
+  if (serdata_default_is_scattered (d))
+  {
+    /* The references are kept, to_ser_unref needs them to recognise copies made by
+       to_ser_ref prior to detaching */
+    const size_t sz = sizeof (struct CDRHeader) + d->pos;
+    char *buf = ddsrt_malloc (sz);
+    serdata_default_sg_to_ser (d, 0, sz, buf);
+    d->hdr_ref = (const struct CDRHeader *) buf;
+  }
 }
 
 
@@ -632,7 +841,10 @@ static void serdata_default_to_ser (const struct ddsi_serdata *serdata_common, s
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
   assert (off < d->pos + sizeof(struct CDRHeader));
   assert (sz <= alignup_size (d->pos + sizeof(struct CDRHeader), 4) - off);
-  memcpy (buf, (char *)&d->hdr + off, sz);
+  if (serdata_default_is_scattered (d))
+    serdata_default_sg_to_ser (d, off, sz, buf);
+  else
+    memcpy (buf, serdata_default_cdr (d) + off, sz);
 }
 
 static struct ddsi_serdata *serdata_default_to_ser_ref (const struct ddsi_serdata *serdata_common, size_t off, size_t sz, ddsrt_iovec_t *ref)
@@ -640,14 +852,41 @@ static struct ddsi_serdata *serdata_default_to_ser_ref (const struct ddsi_serdat
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
   assert (off < d->pos + sizeof(struct CDRHeader));
   assert (sz <= alignup_size (d->pos + sizeof(struct CDRHeader), 4) - off);
-  ref->iov_base = (char *)&d->hdr + off;
+  if (!serdata_default_is_scattered (d))
+    ref->iov_base = (char *) serdata_default_cdr (d) + off;
+  else
+  {
+    /* Reference the piece if the range is contained in a single one, or else make a
+       copy of the range: the pieces are typically large compared to the fragments, so
+       this should be rare.  The copy is recognised on unref because it isn't in any
+       of the pieces. */
+    const uint32_t npieces = serdata_default_sg_npieces (d);
+    size_t pstart = 0;
+    ref->iov_base = NULL;
+    for (uint32_t i = 0; i < npieces && ref->iov_base == NULL; i++)
+    {
+      const char *ptr;
+      size_t len;
+      serdata_default_sg_piece (d, i, &ptr, &len);
+      if (off >= pstart && off + sz <= pstart + len)
+        ref->iov_base = (char *) ptr + (off - pstart);
+      pstart += len;
+    }
+    if (ref->iov_base == NULL)
+    {
+      ref->iov_base = ddsrt_malloc (sz);
+      serdata_default_sg_to_ser (d, off, sz, ref->iov_base);
+    }
+  }
   ref->iov_len = (ddsrt_iov_len_t)sz;
   return ddsi_serdata_ref(serdata_common);
 }
 
 static void serdata_default_to_ser_unref (struct ddsi_serdata *serdata_common, const ddsrt_iovec_t *ref)
 {
-  (void)ref;
+  const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
+  if (d->extrefs && !serdata_default_sg_is_piece (d, ref->iov_base))
+    ddsrt_free (ref->iov_base);
   ddsi_serdata_unref(serdata_common);
 }
 
@@ -686,6 +925,23 @@ static bool serdata_default_to_sample_cdr (const struct ddsi_serdata *serdata_co
   return true; /* FIXME: can't conversion to sample fail? */
 }
 
+const void *ddsi_serdata_default_shared_sample (struct ddsi_serdata *dcmn)
+{
+  struct ddsi_serdata_default *d = (struct ddsi_serdata_default *)dcmn;
+  void *sample, *cur;
+  assert (d->c.type != NULL && d->c.kind == SDK_DATA);
+  if ((cur = ddsrt_atomic_ldvoidp (&d->shared_sample)) != NULL)
+    return cur;
+  /* Readers may race to construct it: the first one to install its copy wins,
+     the others discard theirs */
+  sample = ddsi_sertype_alloc_sample (d->c.type);
+  (void) ddsi_serdata_to_sample (&d->c, sample, NULL, NULL);
+  if (ddsrt_atomic_casvoidp (&d->shared_sample, NULL, sample))
+    return sample;
+  ddsi_sertype_free_sample (d->c.type, sample, DDS_FREE_ALL);
+  return ddsrt_atomic_ldvoidp (&d->shared_sample);
+}
+
 static bool serdata_default_untyped_to_sample_cdr (const struct ddsi_sertype *sertype_common, const struct ddsi_serdata *serdata_common, void *sample, void **bufptr, void *buflim)
 {
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
@@ -714,19 +970,43 @@ static size_t serdata_default_print_cdr (const struct ddsi_sertype *sertype_comm
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
   const struct ddsi_sertype_default *tp = (const struct ddsi_sertype_default *)sertype_common;
   dds_istream_t is;
-  dds_istream_from_serdata_default (&is, d);
+  size_t n;
+  if (!serdata_default_is_scattered (d))
+    dds_istream_from_serdata_default (&is, d);
+  else
+  {
+    char *tmp = ddsrt_malloc (d->pos);
+    serdata_default_sg_to_ser (d, sizeof (struct CDRHeader), d->pos, tmp);
+    dds_istream_init (&is, d->pos, tmp, get_xcdr_version (d->hdr.identifier));
+  }
   if (d->c.kind == SDK_KEY)
-    return dds_stream_print_key (&is, tp, buf, size);
+    n = dds_stream_print_key (&is, tp, buf, size);
   else
-    return dds_stream_print_sample (&is, tp, buf, size);
+    n = dds_stream_print_sample (&is, tp, buf, size);
+  if (serdata_default_is_scattered (d))
+    ddsrt_free ((void *) is.m_buffer);
+  return n;
 }
 
 static void serdata_default_get_keyhash (const struct ddsi_serdata *serdata_common, struct ddsi_keyhash *buf, bool force_md5)
 {
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
   const struct ddsi_sertype_default *tp = (const struct ddsi_sertype_default *)d->c.type;
+  struct ddsi_serdata_default_key lazykey;
+  const struct ddsi_serdata_default_key *key = &d->key;
   assert(buf);
-  assert(d->key.buftype != KEYBUFTYPE_UNSET);
+
+  if (key->buftype == KEYBUFTYPE_UNSET)
+  {
+    /* Constructed by from_sample_lazykey: extract the key from the CDR into a temporary,
+       the serdata may be shared with other threads and so can't be updated */
+    dds_istream_t is;
+    assert (d->c.kind == SDK_DATA);
+    dds_istream_from_serdata_default (&is, d);
+    gen_serdata_key_from_cdr (&is, &lazykey, tp, false);
+    key = &lazykey;
+  }
+  const unsigned char *keybuf = (key->buftype == KEYBUFTYPE_STATIC) ? key->u.stbuf : key->u.dynbuf;
 
   // Convert native representation to what keyhashes expect
   // d->key could also be in big-endian, but that eliminates the possibility of aliasing d->data
@@ -740,19 +1020,19 @@ static void serdata_default_get_keyhash (const struct ddsi_serdata *serdata_comm
   /* serdata has a XCDR2 serialized key, so initializer the istream with this version
      and with the size of that key (d->key.keysize) */
   dds_istream_t is;
-  dds_istream_init (&is, d->key.keysize, serdata_default_keybuf(d), CDR_ENC_VERSION_2);
+  dds_istream_init (&is, key->keysize, keybuf, CDR_ENC_VERSION_2);
 
   /* The output stream uses the XCDR version from the serdata, so that the keyhash in
      ostream is calculated using this CDR representation (XTypes spec 7.6.8, RTPS spec 9.6.3.8) */
   dds_ostreamBE_t os;
   dds_ostreamBE_init (&os, 0, xcdrv);
   dds_stream_extract_keyBE_from_key (&is, &os, tp);
-  assert (is.m_index == d->key.keysize);
+  assert (is.m_index == key->keysize);
 
   /* We know the key size for XCDR2 encoding, but for XCDR1 there can be additional
      padding because of 8-byte alignment of key fields */
   if (xcdrv == CDR_ENC_VERSION_2)
-    assert (os.x.m_index == d->key.keysize);
+    assert (os.x.m_index == key->keysize);
 
   /* Cannot use is_topic_fixed_key here, because in case there is a bounded string
      key field, it may contain a shorter string and fit in the 16 bytes */
@@ -770,6 +1050,8 @@ static void serdata_default_get_keyhash (const struct ddsi_serdata *serdata_comm
     memcpy (buf->value, os.x.m_buffer, actual_keysz);
   }
   dds_ostreamBE_fini (&os);
+  if (key == &lazykey && lazykey.buftype == KEYBUFTYPE_DYNALLOC)
+    ddsrt_free (lazykey.u.dynbuf);
 }
 
 const struct ddsi_serdata_ops ddsi_serdata_ops_cdr = {
@@ -792,6 +1074,9 @@ const struct ddsi_serdata_ops ddsi_serdata_ops_cdr = {
   , .get_sample_size = ddsi_serdata_iox_size
   , .from_iox_buffer = serdata_default_from_iox
 #endif
+  , .from_sample_ref = serdata_default_from_sample_ref_cdr
+  , .detach = serdata_default_detach
+  , .from_sample_lazykey = serdata_default_from_sample_lazykey_cdr
 };
 
 const struct ddsi_serdata_ops ddsi_serdata_ops_xcdr2 = {
@@ -814,6 +1099,8 @@ const struct ddsi_serdata_ops ddsi_serdata_ops_xcdr2 = {
   , .get_sample_size = ddsi_serdata_iox_size
   , .from_iox_buffer = serdata_default_from_iox
 #endif
+  , .detach = serdata_default_detach
+  , .from_sample_lazykey = serdata_default_from_sample_lazykey_xcdr2
 };
 
 const struct ddsi_serdata_ops ddsi_serdata_ops_cdr_nokey = {
@@ -836,6 +1123,8 @@ const struct ddsi_serdata_ops ddsi_serdata_ops_cdr_nokey = {
   , .get_sample_size = ddsi_serdata_iox_size
   , .from_iox_buffer = serdata_default_from_iox
 #endif
+  , .from_sample_ref = serdata_default_from_sample_ref_cdr_nokey
+  , .detach = serdata_default_detach
 };
 
 const struct ddsi_serdata_ops ddsi_serdata_ops_xcdr2_nokey = {
@@ -858,4 +1147,5 @@ const struct ddsi_serdata_ops ddsi_serdata_ops_xcdr2_nokey = {
   , .get_sample_size = ddsi_serdata_iox_size
   , .from_iox_buffer = serdata_default_from_iox
 #endif
+  , .detach = serdata_default_detach
 };
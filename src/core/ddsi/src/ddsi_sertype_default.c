@@ -217,6 +217,7 @@ static dds_ostream_t ostream_from_buffer(void *buffer, size_t size, uint16_t enc
   os.m_size = (uint32_t) size;
   os.m_index = 0;
   os.m_xcdr_version = encoding_version;
+  os.m_extrefs = NULL;
   return os;
 }
 
@@ -37,6 +37,8 @@ DDS_EXPORT extern inline int ddsi_listener_locator (ddsi_tran_listener_t listene
 DDS_EXPORT extern inline int ddsi_listener_listen (ddsi_tran_listener_t listener);
 DDS_EXPORT extern inline ddsi_tran_conn_t ddsi_listener_accept (ddsi_tran_listener_t listener);
 DDS_EXPORT extern inline ssize_t ddsi_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, size_t len, bool allow_spurious, ddsi_locator_t *srcloc);
+DDS_EXPORT extern inline bool ddsi_conn_supports_read_batch (const struct ddsi_tran_conn *conn);
+DDS_EXPORT extern inline ssize_t ddsi_conn_read_batch (ddsi_tran_conn_t conn, size_t nbufs, unsigned char * const *bufs, size_t len, ssize_t *sizes, ddsi_locator_t *srclocs);
 DDS_EXPORT extern inline ssize_t ddsi_conn_write (ddsi_tran_conn_t conn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags);
 
 void ddsi_factory_add (struct ddsi_domaingv *gv, ddsi_tran_factory_t factory)
@@ -172,11 +174,51 @@ void ddsi_factory_conn_init (const struct ddsi_tran_factory *factory, const stru
   ddsrt_atomic_st32 (&conn->m_count, 1);
   conn->m_connless = factory->m_connless;
   conn->m_stream = factory->m_stream;
+  conn->m_gso = false;
   conn->m_factory = (struct ddsi_tran_factory *) factory;
   conn->m_interf = interf;
   conn->m_base.gv = factory->gv;
 }
 
+ssize_t ddsi_conn_write_segments (ddsi_tran_conn_t conn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t segsize, uint32_t flags)
+{
+  if (segsize == 0)
+    return ddsi_conn_write (conn, dst, niov, iov, flags);
+  ssize_t ret = 0;
+  size_t start = 0, len = 0;
+  for (size_t i = 0; i < niov; i++)
+  {
+    len += iov[i].iov_len;
+    assert (len <= segsize);
+    if (len == segsize || i + 1 == niov)
+    {
+      const ssize_t r = ddsi_conn_write (conn, dst, i + 1 - start, iov + start, flags);
+      if (r < 0)
+        return r;
+      ret += r;
+      start = i + 1;
+      len = 0;
+    }
+  }
+  return ret;
+}
+
+ssize_t ddsi_conn_write_multi (ddsi_tran_conn_t conn, size_t ndst, const ddsi_locator_t *dsts, size_t niov, const ddsrt_iovec_t *iov, uint32_t segsize, uint32_t flags)
+{
+  if (conn->m_closed)
+    return -1;
+  else if (conn->m_write_multi_fn && (segsize == 0 || conn->m_gso))
+    return conn->m_write_multi_fn (conn, ndst, dsts, niov, iov, segsize, flags);
+  else
+  {
+    ssize_t nsent = 0;
+    for (size_t i = 0; i < ndst; i++)
+      if (ddsi_conn_write_segments (conn, &dsts[i], niov, iov, segsize, flags) >= 0)
+        nsent++;
+    return nsent;
+  }
+}
+
 void ddsi_conn_disable_multiplexing (ddsi_tran_conn_t conn)
 {
   if (conn->m_disable_multiplexing_fn)
@@ -28,6 +28,10 @@
 #include "dds/ddsi/q_pcap.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 
+#if DDSRT_HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif
+
 union addr {
   struct sockaddr_storage x;
   struct sockaddr a;
@@ -61,6 +65,33 @@ static void addr_to_loc (const struct ddsi_tran_factory *tran, ddsi_locator_t *d
   ddsi_ipaddr_to_loc (dst, &src->a, (src->a.sa_family == AF_INET) ? NN_LOCATOR_KIND_UDPv4 : NN_LOCATOR_KIND_UDPv6);
 }
 
+static void ddsi_udp_conn_read_done (ddsi_udp_conn_t conn, const union addr *src, unsigned char *buf, size_t len, ssize_t ret, bool trunc_flag, ddsi_locator_t *srcloc)
+{
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+
+  if (srcloc)
+    addr_to_loc (conn->m_base.m_factory, srcloc, src);
+
+  if (gv->pcap_fp)
+  {
+    union addr dest;
+    socklen_t dest_len = sizeof (dest);
+    if (ddsrt_getsockname (conn->m_sock, &dest.a, &dest_len) != DDS_RETCODE_OK)
+      memset (&dest, 0, sizeof (dest));
+    write_pcap_received (gv, ddsrt_time_wallclock (), &src->x, &dest.x, buf, (size_t) ret);
+  }
+
+  /* Check for udp packet truncation */
+  if ((size_t) ret > len || trunc_flag)
+  {
+    char addrbuf[DDSI_LOCSTRLEN];
+    ddsi_locator_t tmp;
+    addr_to_loc (conn->m_base.m_factory, &tmp, src);
+    ddsi_locator_to_string (addrbuf, sizeof (addrbuf), &tmp);
+    GVWARNING ("%s => %d truncated to %d\n", addrbuf, (int) ret, (int) len);
+  }
+}
+
 static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * buf, size_t len, bool allow_spurious, ddsi_locator_t *srcloc)
 {
   ddsi_udp_conn_t conn = (ddsi_udp_conn_t) conn_cmn;
@@ -94,32 +125,12 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * bu
 
   if (ret > 0)
   {
-    if (srcloc)
-      addr_to_loc (conn->m_base.m_factory, srcloc, &src);
-
-    if (gv->pcap_fp)
-    {
-      union addr dest;
-      socklen_t dest_len = sizeof (dest);
-      if (ddsrt_getsockname (conn->m_sock, &dest.a, &dest_len) != DDS_RETCODE_OK)
-        memset (&dest, 0, sizeof (dest));
-      write_pcap_received (gv, ddsrt_time_wallclock (), &src.x, &dest.x, buf, (size_t) ret);
-    }
-
-    /* Check for udp packet truncation */
 #if DDSRT_MSGHDR_FLAGS
     const bool trunc_flag = (msghdr.msg_flags & MSG_TRUNC) != 0;
 #else
     const bool trunc_flag = false;
 #endif
-    if ((size_t) ret > len || trunc_flag)
-    {
-      char addrbuf[DDSI_LOCSTRLEN];
-      ddsi_locator_t tmp;
-      addr_to_loc (conn->m_base.m_factory, &tmp, &src);
-      ddsi_locator_to_string (addrbuf, sizeof (addrbuf), &tmp);
-      GVWARNING ("%s => %d truncated to %d\n", addrbuf, (int) ret, (int) len);
-    }
+    ddsi_udp_conn_read_done (conn, &src, buf, len, ret, trunc_flag, srcloc);
   }
   else if (rc != DDS_RETCODE_BAD_PARAMETER && rc != DDS_RETCODE_NO_CONNECTION)
   {
@@ -129,6 +140,53 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * bu
   return ret;
 }
 
+#if DDSRT_HAVE_RECVMMSG
+#define DDSI_UDP_MAX_READ_BATCH 64
+
+static ssize_t ddsi_udp_conn_read_batch (ddsi_tran_conn_t conn_cmn, size_t nbufs, unsigned char * const *bufs, size_t len, ssize_t *sizes, ddsi_locator_t *srclocs)
+{
+  ddsi_udp_conn_t conn = (ddsi_udp_conn_t) conn_cmn;
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  dds_return_t rc;
+  uint32_t nrecv = 0;
+  ddsrt_mmsghdr_t msgs[DDSI_UDP_MAX_READ_BATCH];
+  ddsrt_iovec_t msg_iovs[DDSI_UDP_MAX_READ_BATCH];
+  union addr srcs[DDSI_UDP_MAX_READ_BATCH];
+
+  if (nbufs > DDSI_UDP_MAX_READ_BATCH)
+    nbufs = DDSI_UDP_MAX_READ_BATCH;
+  for (size_t i = 0; i < nbufs; i++)
+  {
+    msg_iovs[i].iov_base = (void *) bufs[i];
+    msg_iovs[i].iov_len = (ddsrt_iov_len_t) len;
+    memset (&msgs[i], 0, sizeof (msgs[i]));
+    msgs[i].msg_hdr.msg_name = &srcs[i].x;
+    msgs[i].msg_hdr.msg_namelen = (socklen_t) sizeof (srcs[i]);
+    msgs[i].msg_hdr.msg_iov = &msg_iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  do {
+    rc = ddsrt_recvmmsg (conn->m_sock, msgs, (uint32_t) nbufs, 0, &nrecv);
+  } while (rc == DDS_RETCODE_INTERRUPTED);
+
+  if (rc != DDS_RETCODE_OK)
+  {
+    if (rc == DDS_RETCODE_BAD_PARAMETER || rc == DDS_RETCODE_NO_CONNECTION)
+      return 0;
+    GVERROR ("UDP recvmmsg sock %d: retcode %"PRId32"\n", (int) conn->m_sock, rc);
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < nrecv; i++)
+  {
+    sizes[i] = (ssize_t) msgs[i].msg_len;
+    ddsi_udp_conn_read_done (conn, &srcs[i], bufs[i], len, sizes[i], (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0, &srclocs[i]);
+  }
+  return (ssize_t) nrecv;
+}
+#endif
+
 static void set_msghdr_iov (ddsrt_msghdr_t *mhdr, const ddsrt_iovec_t *iov, size_t iovlen)
 {
   mhdr->msg_iov = (ddsrt_iovec_t *) iov;
@@ -192,6 +250,129 @@ static ssize_t ddsi_udp_conn_write (ddsi_tran_conn_t conn_cmn, const ddsi_locato
   return (rc == DDS_RETCODE_OK) ? ret : -1;
 }
 
+#if DDSRT_HAVE_SENDMMSG
+#define DDSI_UDP_MAX_WRITE_BATCH 64
+
+static void ddsi_udp_conn_write_multi_pcap (ddsi_udp_conn_t conn, const ddsrt_mmsghdr_t *msgs, uint32_t n)
+{
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  const ddsrt_wctime_t now = ddsrt_time_wallclock ();
+  union addr sa;
+  socklen_t alen = sizeof (sa);
+  if (ddsrt_getsockname (conn->m_sock, &sa.a, &alen) != DDS_RETCODE_OK)
+    memset(&sa, 0, sizeof(sa));
+  for (uint32_t i = 0; i < n; i++)
+    write_pcap_sent (gv, now, &sa.x, &msgs[i].msg_hdr, msgs[i].msg_len);
+}
+
+static ssize_t ddsi_udp_conn_write_multi (ddsi_tran_conn_t conn_cmn, size_t ndst, const ddsi_locator_t *dsts, size_t niov, const ddsrt_iovec_t *iov, uint32_t segsize, uint32_t flags)
+{
+  ddsi_udp_conn_t conn = (ddsi_udp_conn_t) conn_cmn;
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  ddsrt_mmsghdr_t msgs[DDSI_UDP_MAX_WRITE_BATCH];
+  union addr dstaddrs[DDSI_UDP_MAX_WRITE_BATCH];
+#ifdef UDP_SEGMENT
+  union {
+    char buf[CMSG_SPACE (sizeof (uint16_t))];
+    struct cmsghdr align;
+  } gso_cmsg;
+  if (segsize > 0)
+  {
+    struct cmsghdr *cm = (struct cmsghdr *) gso_cmsg.buf;
+    const uint16_t gso_size = (uint16_t) segsize;
+    assert (segsize <= UINT16_MAX);
+    memset (&gso_cmsg, 0, sizeof (gso_cmsg));
+    cm->cmsg_level = IPPROTO_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN (sizeof (gso_size));
+    memcpy (CMSG_DATA (cm), &gso_size, sizeof (gso_size));
+  }
+#else
+  assert (segsize == 0);
+#endif
+  int sendflags = 0;
+#if MSG_NOSIGNAL && !LWIP_SOCKET
+  sendflags |= MSG_NOSIGNAL;
+#endif
+  ssize_t nsent = 0;
+  assert (niov <= INT_MAX);
+
+  size_t d = 0;
+  while (d < ndst)
+  {
+    const uint32_t n = (ndst - d > DDSI_UDP_MAX_WRITE_BATCH) ? DDSI_UDP_MAX_WRITE_BATCH : (uint32_t) (ndst - d);
+    for (uint32_t i = 0; i < n; i++)
+    {
+      ddsi_ipaddr_from_loc (&dstaddrs[i].x, &dsts[d + i]);
+      memset (&msgs[i], 0, sizeof (msgs[i]));
+      set_msghdr_iov (&msgs[i].msg_hdr, iov, niov);
+      msgs[i].msg_hdr.msg_name = &dstaddrs[i].x;
+      msgs[i].msg_hdr.msg_namelen = (socklen_t) ddsrt_sockaddr_get_size (&dstaddrs[i].a);
+#ifdef UDP_SEGMENT
+      if (segsize > 0)
+      {
+        msgs[i].msg_hdr.msg_control = gso_cmsg.buf;
+        msgs[i].msg_hdr.msg_controllen = sizeof (gso_cmsg.buf);
+      }
+#endif
+      msgs[i].msg_hdr.msg_flags = (int) flags;
+    }
+
+    uint32_t i = 0;
+    unsigned retry = 2;
+    while (i < n)
+    {
+      dds_return_t rc;
+      uint32_t cnt = 0;
+      rc = ddsrt_sendmmsg (conn->m_sock, msgs + i, n - i, sendflags, &cnt);
+      if (rc == DDS_RETCODE_OK)
+      {
+        if (gv->pcap_fp)
+          ddsi_udp_conn_write_multi_pcap (conn, msgs + i, cnt);
+        nsent += (ssize_t) cnt;
+        i += cnt;
+        retry = 2;
+      }
+      else if (rc == DDS_RETCODE_INTERRUPTED || rc == DDS_RETCODE_TRY_AGAIN || (rc == DDS_RETCODE_NOT_ALLOWED && retry-- > 0))
+      {
+        continue;
+      }
+      else
+      {
+        /* Segmentation offload fails with EINVAL if a segment exceeds the path MTU: then
+           the packets have to be sent one by one, and so in effect does any other error */
+        if (segsize > 0 && rc == DDS_RETCODE_BAD_PARAMETER)
+        {
+          if (ddsi_conn_write_segments (conn_cmn, &dsts[d + i], niov, iov, segsize, flags) >= 0)
+            nsent++;
+        }
+        else if (rc != DDS_RETCODE_NOT_ALLOWED && rc != DDS_RETCODE_NO_CONNECTION)
+        {
+          char locbuf[DDSI_LOCSTRLEN];
+          GVERROR ("ddsi_udp_conn_write_multi to %s failed with retcode %"PRId32"\n", ddsi_locator_to_string (locbuf, sizeof (locbuf), &dsts[d + i]), rc);
+        }
+        i++;
+        retry = 2;
+      }
+    }
+    d += n;
+  }
+  return nsent;
+}
+
+static bool ddsi_udp_probe_gso (ddsrt_socket_t sock)
+{
+#ifdef UDP_SEGMENT
+  int gso_size;
+  socklen_t optlen = (socklen_t) sizeof (gso_size);
+  return ddsrt_getsockopt (sock, IPPROTO_UDP, UDP_SEGMENT, &gso_size, &optlen) == DDS_RETCODE_OK;
+#else
+  (void) sock;
+  return false;
+#endif
+}
+#endif /* DDSRT_HAVE_SENDMMSG */
+
 static void ddsi_udp_disable_multiplexing (ddsi_tran_conn_t conn_cmn)
 {
 #if defined _WIN32 && !defined WINCE
@@ -499,6 +680,21 @@ static dds_return_t ddsi_udp_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_
     }
   }
 
+  if (qos->m_reuse_port)
+  {
+    assert (qos->m_purpose == DDSI_TRAN_QOS_RECV_UC);
+#ifdef SO_REUSEPORT
+    if ((rc = ddsrt_setsockopt (sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof (one))) != DDS_RETCODE_OK)
+    {
+      GVERROR ("ddsi_udp_create_conn: failed to enable port reuse: %s\n", dds_strretcode (rc));
+      goto fail_w_socket;
+    }
+#else
+    GVERROR ("ddsi_udp_create_conn: port reuse not supported\n");
+    goto fail_w_socket;
+#endif
+  }
+
   if ((rc = set_rcvbuf (gv, sock, &gv->config.socket_rcvbuf_size)) < 0)
     goto fail_w_socket;
   if (rc > 0) {
@@ -568,7 +764,19 @@ static dds_return_t ddsi_udp_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_
   conn->m_base.m_base.m_handle_fn = ddsi_udp_conn_handle;
 
   conn->m_base.m_read_fn = ddsi_udp_conn_read;
+#if DDSRT_HAVE_RECVMMSG
+  conn->m_base.m_read_batch_fn = ddsi_udp_conn_read_batch;
+#else
+  conn->m_base.m_read_batch_fn = 0;
+#endif
   conn->m_base.m_write_fn = ddsi_udp_conn_write;
+#if DDSRT_HAVE_SENDMMSG
+  conn->m_base.m_write_multi_fn = ddsi_udp_conn_write_multi;
+  /* pcap output works at the level of (individual) messages */
+  conn->m_base.m_gso = (gv->pcap_fp == NULL) && ddsi_udp_probe_gso (sock);
+#else
+  conn->m_base.m_write_multi_fn = 0;
+#endif
   conn->m_base.m_disable_multiplexing_fn = ddsi_udp_disable_multiplexing;
   conn->m_base.m_locator_fn = ddsi_udp_conn_locator;
 
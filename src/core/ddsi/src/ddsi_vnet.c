@@ -76,7 +76,9 @@ static dds_return_t ddsi_vnet_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran
   x->m_base.m_base.m_handle_fn = ddsi_vnet_conn_handle;
   x->m_base.m_locator_fn = ddsi_vnet_conn_locator;
   x->m_base.m_read_fn = 0;
+  x->m_base.m_read_batch_fn = 0;
   x->m_base.m_write_fn = 0;
+  x->m_base.m_write_multi_fn = 0;
   x->m_base.m_disable_multiplexing_fn = 0;
 
   DDS_CTRACE (&fact->gv->logconfig, "ddsi_vnet_create_conn intf %s kind %s\n", x->m_base.m_interf->name, fact->m_typename);
@@ -15,104 +15,86 @@
 
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/static_assert.h"
+#include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsrt/mh3.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_addrset.h"
 #include "dds/ddsi/q_log.h"
-#include "dds/ddsi/q_bitset.h"
+#include "dds/ddsi/q_misc.h"
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_wraddrset.h"
 
 #include "dds/ddsi/ddsi_udp.h" /* nn_mc4gen_address_t */
 
-// For each (reader, locator) pair, the coverage map gives:
-// -1 if the reader isn't covered by this locator, >= 0 if it is
+// The address set of a writer is the solution of a set cover problem: a
+// coverage matrix with a row for each matched reader and a column for each
+// locator, where the entries say whether (and how) the reader can be
+// reached via the locator.  The matrix gets maintained incrementally as
+// readers come and go, instead of being recomputed from the address sets
+// of all readers for every change:
 //
-// If covered, the value depends on the kind of locator:
-// - for regular locators: 0
+// - each reader maps to a row (or, with redundant networking, to one row
+//   per interface), and rows are shared by all readers reachable via the
+//   same locators, counting the number of readers as the weight of the row
+// - the columns track the total weight of the rows referencing them
+//
+// The rows of a reader are derived once and kept for as long as the proxy
+// reader's c.as is the same pointer as the one they were derived from.  That
+// relies on the invariant that a proxy reader's c.as is only ever replaced
+// (update_proxy_reader), never modified in place: adding or removing a
+// locator in a proxy reader's address set would silently leave the rows
+// stale.  Holding a reference to it guarantees a new address set can't be
+// allocated at the same address.
+//
+// Most readers have few locators, so the rows are stored sparsely, and
+// adding or removing a reader is proportional to its number of locators.
+// Selecting the locators is then proportional to the number of distinct
+// rows times their size, rather than to the number of readers times the
+// total number of locators.
+//
+// Cover information for a (reader, locator) pair depends on the kind of
+// locator:
+// - for regular locators: whether it is multicast and/or loopback
 // - for MCGEN locators:   bit position in address
 typedef uint8_t cover_info_t;
-typedef char rdname_t[3];
 
-struct cover {
-  int nreaders;
-  int nlocs;
-  rdname_t *rdnames;
-  cover_info_t m[]; // [nreaders][nlocs]
+struct wras_row_entry {
+  ddsi_xlocator_t loc;
+  cover_info_t ci;
+  uint32_t colidx; // scratch space for compute_writer_addrset
 };
 
-static size_t cover_size (int nreaders, int nlocs)
-{
-  return sizeof (struct cover) + (uint32_t) nlocs * (uint32_t) nreaders * sizeof (cover_info_t);
-}
-
-static struct cover *cover_new (int nreaders, int nlocs, bool want_rdnames)
-{
-  struct cover *c = ddsrt_malloc (cover_size (nreaders, nlocs));
-  c->nreaders = nreaders;
-  c->nlocs = nlocs;
-  if (want_rdnames)
-    c->rdnames = ddsrt_malloc ((size_t) nreaders * sizeof (*c->rdnames));
-  else
-    c->rdnames = NULL;
-  for (int i = 0; i < nreaders; i++)
-    for (int j = 0; j < nlocs; j++)
-      c->m[i * nlocs + j] = 0xff;
-  return c;
-}
-
-static void cover_makeroom (struct cover **c, int rdidx)
-{
-  if (rdidx == (*c)->nreaders)
-  {
-    // why 60? why not ... we only get here if the redundant networking trick is enabled
-    const int chunk = 60;
-    (*c) = ddsrt_realloc (*c, cover_size ((*c)->nreaders + chunk, (*c)->nlocs));
-    (*c)->nreaders += chunk;
-    if ((*c)->rdnames)
-      (*c)->rdnames = ddsrt_realloc ((*c)->rdnames, (size_t) (*c)->nreaders * sizeof (*(*c)->rdnames));
-  }
-}
-
-static void cover_update_nreaders (struct cover *c, int nreaders)
-{
-  // Coverage matrix initially gets created based on the number of matching proxy readers
-  // but by the time we get around to populating it, some of them may no longer be around
-  // (that is, the GUID lookup fails).  This function exists to allow reducing the number
-  // of readers to what actually is used in computing the address set.  That way the need
-  // to carry the count separately disappears.
-  assert (nreaders <= c->nreaders);
-  c->nreaders = nreaders;
-}
-
-static int cover_get_nreaders (const struct cover *c)
-{
-  return c->nreaders;
-}
-
-static int cover_get_nlocs (const struct cover *c)
-{
-  return c->nlocs;
-}
+struct wras_row {
+  uint32_t hash;
+  uint32_t weight; // number of readers (redundant networking: reader/interface pairs) sharing this row
+  bool covered; // scratch space for compute_writer_addrset
+  uint32_t nlocs;
+  struct wras_row_entry e[]; // sorted on wras_compare_locs
+};
 
-static void cover_free (struct cover *c)
-{
-  if (c->rdnames)
-    ddsrt_free (c->rdnames);
-  ddsrt_free (c);
-}
+struct wras_reader {
+  ddsi_guid_t prd_guid; // must be first
+  struct addrset *as; // proxy reader address set the rows were derived from, never modified in place
+  uint32_t gen;
+  uint32_t nrows;
+  struct wras_row *rows[];
+};
 
-static void cover_set (struct cover *c, int rdidx, int lidx, cover_info_t v)
-{
-  assert (rdidx < c->nreaders && lidx < c->nlocs);
-  c->m[rdidx * c->nlocs + lidx] = v;
-}
+struct wras_column {
+  ddsi_xlocator_t loc;
+  cover_info_t ci; // of one of the readers, all that matters for the cost is the same for all
+  uint32_t nrds; // total weight of the rows containing this locator
+};
 
-static cover_info_t cover_get (const struct cover *c, int rdidx, int lidx)
-{
-  assert (rdidx < c->nreaders && lidx < c->nlocs);
-  return c->m[rdidx * c->nlocs + lidx];
-}
+struct ddsi_wraddrset_cache {
+  struct ddsrt_hh *readers;
+  struct ddsrt_hh *rows;
+  uint32_t gen;
+  uint32_t nrows;
+  uint32_t ncols, colsize;
+  struct wras_column *cols; // sorted on wras_compare_locs
+};
 
 typedef int32_t cost_t;
 typedef int32_t delta_cost_t;
@@ -150,16 +132,24 @@ static void costmap_set (struct costmap *wm, int lidx, readercount_cost_t v)
   wm->m[lidx] = v;
 }
 
-static void costmap_adjust (struct costmap *wm, int lidx, delta_cost_t v)
+static cost_t sat_cost_add_n (cost_t x, int32_t a, uint32_t n)
+{
+  // equivalent to adding a n times with saturation, because the additions are all in the same direction
+  DDSRT_STATIC_ASSERT (sizeof (cost_t) == sizeof (int32_t));
+  const int64_t y = (int64_t) x + (int64_t) a * (int64_t) n;
+  return (y > INT32_MAX) ? INT32_MAX : (y < INT32_MIN) ? INT32_MIN : (cost_t) y;
+}
+
+static void costmap_adjust (struct costmap *wm, int lidx, uint32_t nrds, delta_cost_t v)
 {
   assert (lidx < wm->nlocs);
   if (wm->m[lidx].cost == INT32_MAX)
     return;
-  assert (wm->m[lidx].nrds > 0);
-  if (--wm->m[lidx].nrds == 0)
+  assert (wm->m[lidx].nrds >= nrds);
+  if ((wm->m[lidx].nrds -= nrds) == 0)
     wm->m[lidx].cost = INT32_MAX;
-  else
-    wm->m[lidx].cost += v;
+  else if ((wm->m[lidx].cost = sat_cost_add_n (wm->m[lidx].cost, v, nrds)) == INT32_MAX)
+    wm->m[lidx].cost = INT32_MAX - 1;
 }
 
 static readercount_cost_t costmap_get (const struct costmap *wm, int lidx)
@@ -187,29 +177,6 @@ static void locset_free (struct locset *ls)
   ddsrt_free (ls);
 }
 
-static struct addrset *wras_collect_all_locs (const struct writer *wr)
-{
-  struct entity_index * const gh = wr->e.gv->entity_index;
-  struct addrset *all_addrs = new_addrset ();
-  struct wr_prd_match *m;
-  ddsrt_avl_iter_t it;
-  for (m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
-  {
-    struct proxy_reader *prd;
-    if ((prd = entidx_lookup_proxy_reader_guid (gh, &m->prd_guid)) == NULL)
-      continue;
-    copy_addrset_into_addrset (wr->e.gv, all_addrs, prd->c.as);
-  }
-  if (!addrset_empty (all_addrs))
-  {
-#ifdef DDS_HAS_SSM
-    if (wr->supports_ssm && wr->ssm_as)
-      copy_addrset_into_addrset_mc (wr->e.gv, all_addrs, wr->ssm_as);
-#endif
-  }
-  return all_addrs;
-}
-
 struct rebuild_flatten_locs_helper_arg {
   ddsi_xlocator_t *locs;
   int idx;
@@ -237,15 +204,6 @@ static void wras_flatten_locs_prealloc (struct locset *ls, struct addrset *addrs
   ls->nlocs = flarg.idx;
 }
 
-static struct locset *wras_flatten_locs (struct addrset *all_addrs)
-{
-  const int nin = (int) addrset_count (all_addrs);
-  struct locset *ls = locset_new (nin);
-  wras_flatten_locs_prealloc (ls, all_addrs);
-  assert (ls->nlocs == nin);
-  return ls;
-}
-
 static int wras_compare_locs (const void *va, const void *vb)
 {
   // Each machine has a slightly UDPv4MCGEN locator because the address
@@ -267,28 +225,13 @@ static int wras_compare_locs (const void *va, const void *vb)
   }
 }
 
-static struct locset *wras_calc_locators (const struct ddsrt_log_cfg *logcfg, struct addrset *all_addrs)
+static int wras_compare_row_entries (const void *va, const void *vb)
 {
-  struct locset *ls = wras_flatten_locs (all_addrs);
-  int i, j;
-  /* We want MC gens just once for each IP,BASE,COUNT pair, not once for each node */
-  i = 0; j = 1;
-  qsort (ls->locs, (size_t) ls->nlocs, sizeof (*ls->locs), wras_compare_locs);
-  while (j < ls->nlocs)
-  {
-    if (wras_compare_locs (&ls->locs[i], &ls->locs[j]) != 0)
-      ls->locs[++i] = ls->locs[j];
-    j++;
-  }
-  ls->nlocs = i+1;
-  DDS_CLOG (DDS_LC_DISCOVERY, logcfg, "reduced nlocs=%d\n", ls->nlocs);
-  return ls;
+  const struct wras_row_entry *a = va;
+  const struct wras_row_entry *b = vb;
+  return wras_compare_locs (&a->loc, &b->loc);
 }
 
-#define CI_STATUS_MASK     0x3
-#define CI_REACHABLE       0x0 // reachable via this locator
-#define CI_INCLUDED        0x1 // reachable, already included in selected locators
-#define CI_NOMATCH         0x2 // not reached by this locator
 #define CI_LOOPBACK        0x4 // is a loopback locator (set for entire row)
 #define CI_MULTICAST_MASK 0xf8 // 0: no, 1: ASM, 2: SSM, (index+3) if MCGEN
 #define CI_MULTICAST_SHIFT   3
@@ -314,16 +257,7 @@ static const int32_t cost_delivered = -1;
 
 #define CI_ICEORYX        0xfc // FIXME: this is a hack
 
-static cost_t sat_cost_add (cost_t x, int32_t a)
-{
-  DDSRT_STATIC_ASSERT (sizeof (cost_t) == sizeof (int32_t) && (cost_t) ((uint32_t)1 << 31) < 0);
-  if (a >= 0)
-    return (x > INT32_MAX - a) ? INT32_MAX : x + a;
-  else
-    return (x < INT32_MIN - a) ? INT32_MIN : x + a;
-}
-
-static readercount_cost_t calc_locator_cost (const struct cover *c, int lidx, bool prefer_multicast, dds_locator_mask_t ignore)
+static readercount_cost_t calc_locator_cost (const struct wras_column *col, bool prefer_multicast, dds_locator_mask_t ignore)
 {
   const int32_t cost_uc  = prefer_multicast ? 1000000 : 2;
   const int32_t cost_mc  = prefer_multicast ? 1 : 3;
@@ -333,21 +267,11 @@ static readercount_cost_t calc_locator_cost (const struct cover *c, int lidx, bo
 
   // FIXME: should associate costs with interfaces, so that, e.g., iceoryx << loopback < GbE < WiFi without any details needed here
 
-  // Find first reader that this locator addresses so we actually know something
-  // about the locator.  There should be at least one, but if none were to be there
-  // we already know this is an invalid choice.
-  int rdidx;
-  cover_info_t ci = 0; // clang (at least) can't figure out that init is unnecessary
-  for (rdidx = 0; rdidx < c->nreaders; rdidx++)
-  {
-    ci = cover_get (c, rdidx, lidx);
-    if ((ci & CI_STATUS_MASK) != CI_NOMATCH)
-      break;
-  }
-  if (rdidx == c->nreaders)
-    goto no_readers;
-
-  if ((ci & ~CI_STATUS_MASK) == CI_ICEORYX)
+  // The base cost follows from the kind of locator, which is the same for all readers
+  // addressed by it.  Columns without readers don't exist.
+  const cover_info_t ci = col->ci;
+  assert (col->nrds > 0);
+  if (ci == CI_ICEORYX)
   {
     if (0 == (ignore & NN_LOCATOR_KIND_SHEM))
       x.cost = INT32_MIN;
@@ -363,28 +287,8 @@ static readercount_cost_t calc_locator_cost (const struct cover *c, int lidx, bo
   if (!(ci & CI_LOOPBACK))
     x.cost += cost_non_loopback;
 
-  for (; rdidx < c->nreaders; rdidx++)
-  {
-    ci = cover_get (c, rdidx, lidx);
-    if ((ci & CI_STATUS_MASK) == CI_NOMATCH)
-      continue;
-
-#if 0
-    // this is nice for checking the incremental work done in wras_drop_covered_readers,
-    // but that is only possible if the cost_redundant_iceoryx == cost_discarded
-    if ((ci & CI_STATUS_MASK) == CI_INCLUDED)
-    {
-      // FIXME: need addressed hosts, addressed processes; those change when nodes come/go
-      x.cost = sat_cost_add (x.cost, cost_discarded);
-    }
-    else
-#endif
-    {
-      assert ((ci & CI_STATUS_MASK) == CI_REACHABLE);
-      x.cost = sat_cost_add (x.cost, cost_delivered);
-      x.nrds++;
-    }
-  }
+  x.cost = sat_cost_add_n (x.cost, cost_delivered, col->nrds);
+  x.nrds = col->nrds;
   if (x.cost == INT32_MAX)
     x.cost = INT32_MAX - 1;
 
@@ -457,19 +361,12 @@ static bool locator_is_iceoryx (const ddsi_xlocator_t *l)
 #endif
 }
 
-static bool wras_cover_locatorset (struct ddsi_domaingv const * const gv, struct cover *cov, const struct locset *locs, const struct locset *work_locs, int rdidx, int nloopback, int first, int last) ddsrt_attribute_warn_unused_result;
-
-static bool wras_cover_locatorset (struct ddsi_domaingv const * const gv, struct cover *cov, const struct locset *locs, const struct locset *work_locs, int rdidx, int nloopback, int first, int last)
+static uint32_t wras_append_row_entries (struct ddsi_domaingv const * const gv, struct wras_row_entry *es, uint32_t n, const struct locset *work_locs, int nloopback, int first, int last)
 {
   for (int j = first; j <= last; j++)
   {
-    /* all addresses should be in the combined set of addresses, unless the address sets change on the fly:
-       in that case, restart */
-    const ddsi_xlocator_t *l = bsearch (&work_locs->locs[j], locs->locs, (size_t) locs->nlocs, sizeof (*locs->locs), wras_compare_locs);
-    if (l == NULL)
-      return false;
+    const ddsi_xlocator_t *l = &work_locs->locs[j];
     cover_info_t x;
-    int lidx = (int) (l - locs->locs);
     if (locator_is_iceoryx (l)) // FIXME: a gross hack
     {
       x = CI_ICEORYX;
@@ -488,163 +385,338 @@ static bool wras_cover_locatorset (struct ddsi_domaingv const * const gv, struct
       x |= (cover_info_t) (multicast_indicator (gv, l) << CI_MULTICAST_SHIFT);
     }
     char buf[200];
-    GVTRACE ("rdidx %u lidx %s %u -> %x\n", rdidx, ddsi_xlocator_to_string(buf, sizeof(buf), &work_locs->locs[j]), lidx, x);
-    assert (x != 0xff);
-    assert (cover_get (cov, rdidx, lidx) == 0xff);
-    cover_set (cov, rdidx, lidx, x);
+    GVTRACE ("  %s -> %x\n", ddsi_xlocator_to_string(buf, sizeof(buf), l), x);
+    es[n].loc = *l;
+    es[n].ci = x;
+    es[n].colidx = 0;
+    n++;
   }
-  return true;
+  return n;
 }
 
-static bool wras_calc_cover (const struct writer *wr, const struct locset *locs, struct cover **pcov) ddsrt_attribute_warn_unused_result;
+static uint32_t wras_row_hash (const struct wras_row *row)
+{
+  uint32_t h = row->nlocs;
+  for (uint32_t i = 0; i < row->nlocs; i++)
+  {
+    const uintptr_t conn = (uintptr_t) row->e[i].loc.conn;
+    h = ddsrt_mh3 (&row->e[i].loc.c, sizeof (row->e[i].loc.c), h);
+    h = ddsrt_mh3 (&conn, sizeof (conn), h);
+    h = ddsrt_mh3 (&row->e[i].ci, sizeof (row->e[i].ci), h);
+  }
+  return h;
+}
 
-static bool wras_calc_cover (const struct writer *wr, const struct locset *locs, struct cover **pcov)
+static uint32_t wras_row_hash_wrapper (const void *va)
 {
-  struct ddsi_domaingv * const gv = wr->e.gv;
-  struct entity_index * const gh = gv->entity_index;
-  ddsrt_avl_iter_t it;
-  const bool want_rdnames = true;
-  // allocate cover matrix, it needs to be grow if there are readers requesting redundant delivery
-  // (but that's rare enough to be ok with reallocating it for now)
-  struct cover *cov = cover_new ((int) wr->num_readers, locs->nlocs, want_rdnames);
-  struct locset *work_locs = locset_new (locs->nlocs);
-  int rdidx = 0;
-  char rdletter = 'a', rddigit = '0';
-  for (struct wr_prd_match *m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
+  const struct wras_row *a = va;
+  return a->hash;
+}
+
+static int wras_row_equal (const void *va, const void *vb)
+{
+  const struct wras_row *a = va;
+  const struct wras_row *b = vb;
+  if (a->hash != b->hash || a->nlocs != b->nlocs)
+    return 0;
+  for (uint32_t i = 0; i < a->nlocs; i++)
+    if (a->e[i].ci != b->e[i].ci || compare_xlocators (&a->e[i].loc, &b->e[i].loc) != 0)
+      return 0;
+  return 1;
+}
+
+static uint32_t wras_reader_hash (const void *va)
+{
+  const struct wras_reader *a = va;
+  return ddsrt_mh3 (&a->prd_guid, sizeof (a->prd_guid), 0);
+}
+
+static int wras_reader_equal (const void *va, const void *vb)
+{
+  const struct wras_reader *a = va;
+  const struct wras_reader *b = vb;
+  return guid_eq (&a->prd_guid, &b->prd_guid);
+}
+
+static bool wras_lookup_column (const struct ddsi_wraddrset_cache *wc, const ddsi_xlocator_t *loc, uint32_t *idx)
+{
+  // binary search, on failure *idx is the position at which to insert it
+  uint32_t lo = 0, hi = wc->ncols;
+  while (lo < hi)
   {
-    struct proxy_reader *prd;
-    struct addrset *ass[] = { NULL, NULL, NULL };
-    bool increment_rdidx = true;
-    if ((prd = entidx_lookup_proxy_reader_guid (gh, &m->prd_guid)) == NULL)
-      continue;
-    ass[0] = prd->c.as;
+    const uint32_t m = lo + (hi - lo) / 2;
+    const int c = wras_compare_locs (&wc->cols[m].loc, loc);
+    if (c == 0)
+    {
+      *idx = m;
+      return true;
+    }
+    else if (c < 0)
+      lo = m + 1;
+    else
+      hi = m;
+  }
+  *idx = lo;
+  return false;
+}
+
+static void wras_ref_column (struct ddsi_wraddrset_cache *wc, const struct wras_row_entry *e)
+{
+  uint32_t idx;
+  if (!wras_lookup_column (wc, &e->loc, &idx))
+  {
+    if (wc->ncols == wc->colsize)
+    {
+      wc->colsize = (wc->colsize == 0) ? 8 : 2 * wc->colsize;
+      wc->cols = ddsrt_realloc (wc->cols, wc->colsize * sizeof (*wc->cols));
+    }
+    memmove (&wc->cols[idx + 1], &wc->cols[idx], (wc->ncols - idx) * sizeof (*wc->cols));
+    wc->cols[idx].loc = e->loc;
+    wc->cols[idx].ci = e->ci;
+    wc->cols[idx].nrds = 0;
+    wc->ncols++;
+  }
+  wc->cols[idx].nrds++;
+}
+
+static void wras_unref_column (struct ddsi_wraddrset_cache *wc, const struct wras_row_entry *e)
+{
+  uint32_t idx;
+  const bool found = wras_lookup_column (wc, &e->loc, &idx);
+  assert (found);
+  (void) found;
+  assert (wc->cols[idx].nrds > 0);
+  if (--wc->cols[idx].nrds == 0)
+  {
+    wc->ncols--;
+    memmove (&wc->cols[idx], &wc->cols[idx + 1], (wc->ncols - idx) * sizeof (*wc->cols));
+  }
+}
+
+static struct wras_row *wras_ref_row (struct ddsi_wraddrset_cache *wc, uint32_t nlocs, const struct wras_row_entry *es)
+{
+  struct wras_row *row = ddsrt_malloc (sizeof (*row) + nlocs * sizeof (*row->e));
+  row->nlocs = nlocs;
+  memcpy (row->e, es, nlocs * sizeof (*row->e));
+  qsort (row->e, nlocs, sizeof (*row->e), wras_compare_row_entries);
+  // a locator can occur only once in a row, but the SSM address may also be one of the reader's
+  uint32_t i = 0;
+  for (uint32_t j = 1; j < row->nlocs; j++)
+    if (wras_compare_row_entries (&row->e[i], &row->e[j]) != 0)
+      row->e[++i] = row->e[j];
+  row->nlocs = (row->nlocs == 0) ? 0 : i + 1;
+  row->hash = wras_row_hash (row);
+
+  struct wras_row *existing;
+  if ((existing = ddsrt_hh_lookup (wc->rows, row)) != NULL)
+  {
+    ddsrt_free (row);
+    row = existing;
+  }
+  else
+  {
+    row->weight = 0;
+    row->covered = false;
+    ddsrt_hh_add (wc->rows, row);
+    wc->nrows++;
+  }
+  row->weight++;
+  for (i = 0; i < row->nlocs; i++)
+    wras_ref_column (wc, &row->e[i]);
+  return row;
+}
+
+static void wras_unref_row (struct ddsi_wraddrset_cache *wc, struct wras_row *row)
+{
+  for (uint32_t i = 0; i < row->nlocs; i++)
+    wras_unref_column (wc, &row->e[i]);
+  assert (row->weight > 0);
+  if (--row->weight == 0)
+  {
+    ddsrt_hh_remove (wc->rows, row);
+    wc->nrows--;
+    ddsrt_free (row);
+  }
+}
+
+static struct wras_reader *wras_add_reader (struct ddsi_wraddrset_cache *wc, const struct writer *wr, const struct proxy_reader *prd, struct addrset *as)
+{
+  struct ddsi_domaingv * const gv = wr->e.gv;
+  struct addrset *ass[] = { as, NULL, NULL };
 #ifdef DDS_HAS_SSM
-    if (prd->favours_ssm && wr->supports_ssm)
-      ass[1] = wr->ssm_as;
+  if (prd->favours_ssm && wr->supports_ssm)
+    ass[1] = wr->ssm_as;
 #endif
-    for (int i = 0; ass[i]; i++)
+  int nlocs_max = 0;
+  for (int i = 0; ass[i]; i++)
+    nlocs_max += (int) addrset_count (ass[i]);
+
+  // Every row has at least one locator, plus possibly one for the SSM address
+  struct wras_row **rows = ddsrt_malloc ((size_t) (nlocs_max + 1) * sizeof (*rows));
+  struct wras_row_entry *es = ddsrt_malloc ((size_t) (nlocs_max + 1) * sizeof (*es));
+  struct wras_row_entry *es_rn = ddsrt_malloc ((size_t) (nlocs_max + 1) * sizeof (*es_rn));
+  struct locset *work_locs = locset_new (nlocs_max);
+  uint32_t nrows = 0, nes = 0;
+  GVTRACE ("wras_add_reader "PGUIDFMT"\n", PGUID (prd->e.guid));
+  for (int i = 0; ass[i]; i++)
+  {
+    work_locs->nlocs = nlocs_max;
+    wras_flatten_locs_prealloc (work_locs, ass[i]);
+    const int nloopback = move_loopback_forward (gv, work_locs);
+    GVTRACE ("nloopback = %d, nlocs = %d, redundant_networking = %d\n", nloopback, work_locs->nlocs, prd->redundant_networking);
+    if (!prd->redundant_networking || nloopback == work_locs->nlocs)
     {
-      work_locs->nlocs = locs->nlocs;
-      wras_flatten_locs_prealloc (work_locs, ass[i]);
-      const int nloopback = move_loopback_forward (gv, work_locs);
-      GVTRACE ("nloopback = %d, nlocs = %d, redundant_networking = %d\n", nloopback, work_locs->nlocs, prd->redundant_networking);
-      if (!prd->redundant_networking || nloopback == work_locs->nlocs)
-      {
-        cover_makeroom (&cov, rdidx);
-        for (int j = 0; j < work_locs->nlocs; j++)
-        {
-          if (!wras_cover_locatorset (gv, cov, locs, work_locs, rdidx, nloopback, j, j))
-            goto addrset_changed;
-        }
-      }
-      else
-      {
-        int j = nloopback;
-        while (j < work_locs->nlocs)
-        {
-          cover_makeroom (&cov, rdidx);
-          if (nloopback > 0)
-          {
-            if (!wras_cover_locatorset (gv, cov, locs, work_locs, rdidx, nloopback, 0, nloopback - 1))
-              goto addrset_changed;
-          }
-          int k = j + 1;
-          while (k < work_locs->nlocs && work_locs->locs[j].conn == work_locs->locs[k].conn)
-            k++;
-          GVTRACE ("j = %d, k = %d\n", j, k);
-          if (!wras_cover_locatorset (gv, cov, locs, work_locs, rdidx, nloopback, j, k - 1))
-            goto addrset_changed;
-          j = k;
-          for (int l = 0; l < cov->nlocs; l++)
-            if (cover_get (cov, rdidx, l) == 0xff)
-              cover_set (cov, rdidx, l, CI_NOMATCH);
-          cov->rdnames[rdidx][0] = rdletter;
-          cov->rdnames[rdidx][1] = rddigit++;
-          cov->rdnames[rdidx][2] = 0;
-          rdidx++;
-          increment_rdidx = false;
-        }
-      }
+      nes = wras_append_row_entries (gv, es, nes, work_locs, nloopback, 0, work_locs->nlocs - 1);
     }
-    if (increment_rdidx)
+    else
     {
-      cover_makeroom (&cov, rdidx);
-      for (int i = 0; i < cov->nlocs; i++)
-        if (cover_get (cov, rdidx, i) == 0xff)
-          cover_set (cov, rdidx, i, CI_NOMATCH);
-      cov->rdnames[rdidx][0] = rdletter;
-      cov->rdnames[rdidx][1] = 0;
-      rdidx++;
+      // a separate row for each interface, each including the loopback locators
+      int j = nloopback;
+      while (j < work_locs->nlocs)
+      {
+        uint32_t nes_rn = 0;
+        int k = j + 1;
+        while (k < work_locs->nlocs && work_locs->locs[j].conn == work_locs->locs[k].conn)
+          k++;
+        GVTRACE ("j = %d, k = %d\n", j, k);
+        nes_rn = wras_append_row_entries (gv, es_rn, nes_rn, work_locs, nloopback, 0, nloopback - 1);
+        nes_rn = wras_append_row_entries (gv, es_rn, nes_rn, work_locs, nloopback, j, k - 1);
+        rows[nrows++] = wras_ref_row (wc, nes_rn, es_rn);
+        j = k;
+      }
     }
-    if (++rdletter == 'z')
-      rdletter = 'a';
-    rddigit = '0';
   }
+  if (nes > 0)
+    rows[nrows++] = wras_ref_row (wc, nes, es);
   locset_free (work_locs);
-  if (rdidx == 0)
+  ddsrt_free (es_rn);
+  ddsrt_free (es);
+
+  struct wras_reader *r = ddsrt_malloc (sizeof (*r) + nrows * sizeof (*r->rows));
+  r->prd_guid = prd->e.guid;
+  r->as = ref_addrset (as);
+  r->gen = wc->gen;
+  r->nrows = nrows;
+  memcpy (r->rows, rows, nrows * sizeof (*r->rows));
+  ddsrt_free (rows);
+  ddsrt_hh_add (wc->readers, r);
+  return r;
+}
+
+static void wras_remove_reader (struct ddsi_wraddrset_cache *wc, struct wras_reader *r)
+{
+  for (uint32_t i = 0; i < r->nrows; i++)
+    wras_unref_row (wc, r->rows[i]);
+  ddsrt_hh_remove (wc->readers, r);
+  unref_addrset (r->as);
+  ddsrt_free (r);
+}
+
+static void wras_sync_readers (struct ddsi_wraddrset_cache *wc, const struct writer *wr)
+{
+  struct entity_index * const gh = wr->e.gv->entity_index;
+  struct wr_prd_match *m;
+  struct wras_reader *r;
+  ddsrt_avl_iter_t it;
+  struct ddsrt_hh_iter hit;
+  wc->gen++;
+  for (m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
   {
-    cover_free (cov);
-    *pcov = NULL;
+    struct proxy_reader *prd;
+    if ((prd = entidx_lookup_proxy_reader_guid (gh, &m->prd_guid)) == NULL)
+      continue;
+    // See the invariant on proxy reader address sets at the top of this file
+    struct addrset * const as = prd->c.as;
+    if ((r = ddsrt_hh_lookup (wc->readers, &m->prd_guid)) != NULL && r->as != as)
+    {
+      wras_remove_reader (wc, r);
+      r = NULL;
+    }
+    if (r == NULL)
+      r = wras_add_reader (wc, wr, prd, as);
+    r->gen = wc->gen;
   }
-  else
+  for (r = ddsrt_hh_iter_first (wc->readers, &hit); r; r = ddsrt_hh_iter_next (&hit))
   {
-    cover_update_nreaders (cov, rdidx);
-    *pcov = cov;
+    if (r->gen != wc->gen)
+      wras_remove_reader (wc, r);
   }
-  return true;
+}
 
-addrset_changed:
-  locset_free (work_locs);
-  cover_free (cov);
-  return false;
+struct ddsi_wraddrset_cache *ddsi_wraddrset_cache_new (void)
+{
+  struct ddsi_wraddrset_cache *wc = ddsrt_malloc (sizeof (*wc));
+  wc->readers = ddsrt_hh_new (1, wras_reader_hash, wras_reader_equal);
+  wc->rows = ddsrt_hh_new (1, wras_row_hash_wrapper, wras_row_equal);
+  wc->gen = 0;
+  wc->nrows = 0;
+  wc->ncols = wc->colsize = 0;
+  wc->cols = NULL;
+  return wc;
 }
 
-static struct costmap *wras_calc_costmap (const struct cover *covered, bool prefer_multicast, dds_locator_mask_t ignore)
+void ddsi_wraddrset_cache_free (struct ddsi_wraddrset_cache *wc)
 {
-  const int nlocs = cover_get_nlocs (covered);
-  struct costmap *wm = costmap_new (nlocs);
-  for (int i = 0; i < nlocs; i++)
-    costmap_set (wm, i, calc_locator_cost (covered, i, prefer_multicast, ignore));
+  struct ddsrt_hh_iter it;
+  struct wras_reader *r;
+  for (r = ddsrt_hh_iter_first (wc->readers, &it); r; r = ddsrt_hh_iter_next (&it))
+    wras_remove_reader (wc, r);
+  assert (wc->nrows == 0 && wc->ncols == 0);
+  ddsrt_hh_free (wc->readers);
+  ddsrt_hh_free (wc->rows);
+  ddsrt_free (wc->cols);
+  ddsrt_free (wc);
+}
+
+static const struct wras_row_entry *wras_row_lookup (const struct wras_row *row, uint32_t colidx)
+{
+  for (uint32_t i = 0; i < row->nlocs; i++)
+    if (row->e[i].colidx == colidx)
+      return &row->e[i];
+  return NULL;
+}
+
+static struct costmap *wras_calc_costmap (const struct ddsi_wraddrset_cache *wc, bool prefer_multicast, dds_locator_mask_t ignore)
+{
+  struct costmap *wm = costmap_new ((int) wc->ncols);
+  for (uint32_t i = 0; i < wc->ncols; i++)
+    costmap_set (wm, (int) i, calc_locator_cost (&wc->cols[i], prefer_multicast, ignore));
   return wm;
 }
 
-static void wras_trace_cover (const struct ddsi_domaingv *gv, const struct locset *locs, const struct costmap *wm, const struct cover *covered)
+static void wras_trace_cover (const struct ddsi_domaingv *gv, const struct ddsi_wraddrset_cache *wc, const struct costmap *wm, struct wras_row * const *rows)
 {
   if (!(gv->logconfig.c.mask & DDS_LC_DISCOVERY))
     return;
-  const int nreaders = cover_get_nreaders (covered);
-  const int nlocs = cover_get_nlocs (covered);
-  assert (nlocs == locs->nlocs);
   GVLOGDISC ("  %61s", "");
-  for (int i = 0; i < nreaders; i++)
-    GVLOGDISC (" %3s", covered->rdnames[i]);
+  for (uint32_t i = 0; i < wc->nrows; i++)
+    GVLOGDISC (" %3"PRIu32, rows[i]->weight);
   GVLOGDISC ("\n");
-  for (int i = 0; i < nlocs; i++)
+  for (uint32_t i = 0; i < wc->ncols; i++)
   {
     char buf[DDSI_LOCSTRLEN];
-    ddsi_xlocator_to_string (buf, sizeof(buf), &locs->locs[i]);
-    GVLOGDISC ("  loc %2d = %-40s%11"PRId32" {", i, buf, costmap_get (wm, i).cost);
-    for (int j = 0; j < nreaders; j++)
+    ddsi_xlocator_to_string (buf, sizeof(buf), &wc->cols[i].loc);
+    GVLOGDISC ("  loc %2"PRIu32" = %-40s%11"PRId32" {", i, buf, costmap_get (wm, (int) i).cost);
+    for (uint32_t j = 0; j < wc->nrows; j++)
     {
-      cover_info_t ci = cover_get (covered, j, i);
-      if ((ci & CI_STATUS_MASK) == CI_NOMATCH)
+      const struct wras_row_entry *e = wras_row_lookup (rows[j], i);
+      if (e == NULL)
         GVLOGDISC ("  ..");
       else
       {
-        assert ((ci & CI_STATUS_MASK) == CI_INCLUDED || (ci & CI_STATUS_MASK) == CI_REACHABLE);
-        if ((ci & CI_STATUS_MASK) == CI_INCLUDED)
+        if (rows[j]->covered)
           GVLOGDISC (" *");
         else
           GVLOGDISC (" +");
-        if ((ci & ~CI_STATUS_MASK) == CI_ICEORYX)
+        if (e->ci == CI_ICEORYX)
           GVLOGDISC ("I ");
         else
         {
-          if ((ci & CI_MULTICAST_MASK) == 0)
+          if ((e->ci & CI_MULTICAST_MASK) == 0)
             GVLOGDISC ("u");
           else
-            GVLOGDISC ("%d", ci >> CI_MULTICAST_SHIFT);
-          GVLOGDISC ("%c", (ci & CI_LOOPBACK) ? 'l' : ' ');
+            GVLOGDISC ("%d", e->ci >> CI_MULTICAST_SHIFT);
+          GVLOGDISC ("%c", (e->ci & CI_LOOPBACK) ? 'l' : ' ');
         }
       }
     }
@@ -652,17 +724,17 @@ static void wras_trace_cover (const struct ddsi_domaingv *gv, const struct locse
   }
 }
 
-static int wras_choose_locator (const struct locset *locs, const struct costmap *wm)
+static int wras_choose_locator (int nlocs, const struct costmap *wm)
 {
   // general preference for unicast is by having a larger base cost for a multicast
   // general preference for loopback is by having a cost for non-loopback interfaces
   // prefer_multicast: done by assigning much greater cost to unicast than to multicast
   // "reader favours SSM": slightly lower cost than ASM (it only "favours" it, after all)
-  if (locs->nlocs == 0)
+  if (nlocs == 0)
     return -1;
   int best = 0;
   readercount_cost_t w_best = costmap_get (wm, best);
-  for (int i = 1; i < locs->nlocs; i++)
+  for (int i = 1; i < nlocs; i++)
   {
     const readercount_cost_t w_i = costmap_get (wm, i);
     if (w_i.cost < w_best.cost || (w_i.cost == w_best.cost && w_i.nrds > w_best.nrds))
@@ -674,34 +746,32 @@ static int wras_choose_locator (const struct locset *locs, const struct costmap
   return (w_best.cost != INT32_MAX) ? best : -1;
 }
 
-static void wras_add_locator (const struct ddsi_domaingv *gv, struct addrset *newas, int locidx, const struct locset *locs, const struct cover *covered)
+static void wras_add_locator (const struct ddsi_domaingv *gv, struct addrset *newas, int locidx, const struct ddsi_wraddrset_cache *wc, struct wras_row * const *rows)
 {
   ddsi_xlocator_t tmploc;
   char str[DDSI_LOCSTRLEN];
   const char *kindstr;
   const ddsi_xlocator_t *locp;
 
-  if (locs->locs[locidx].c.kind != NN_LOCATOR_KIND_UDPv4MCGEN)
+  if (wc->cols[locidx].loc.c.kind != NN_LOCATOR_KIND_UDPv4MCGEN)
   {
-    locp = &locs->locs[locidx];
+    locp = &wc->cols[locidx].loc;
     kindstr = "simple";
   }
   else /* convert MC gen to the correct multicast address */
   {
-    const int nreaders = cover_get_nreaders (covered);
     nn_udpv4mcgen_address_t l1;
     uint32_t iph, ipn;
-    int i;
-    tmploc = locs->locs[locidx];
+    tmploc = wc->cols[locidx].loc;
     memcpy (&l1, tmploc.c.address, sizeof (l1));
     tmploc.c.kind = NN_LOCATOR_KIND_UDPv4;
     memset (tmploc.c.address, 0, 12);
     iph = ntohl (l1.ipv4.s_addr);
-    for (i = 0; i < nreaders; i++)
+    for (uint32_t i = 0; i < wc->nrows; i++)
     {
-      cover_info_t ci = cover_get (covered, i, locidx);
-      if ((ci & CI_STATUS_MASK) == CI_REACHABLE)
-        iph |= 1u << ((ci >> CI_MULTICAST_SHIFT) - CI_MULTICAST_MCGEN_OFFSET);
+      const struct wras_row_entry *e;
+      if (!rows[i]->covered && (e = wras_row_lookup (rows[i], (uint32_t) locidx)) != NULL)
+        iph |= 1u << ((e->ci >> CI_MULTICAST_SHIFT) - CI_MULTICAST_MCGEN_OFFSET);
     }
     ipn = htonl (iph);
     memcpy (tmploc.c.address + 12, &ipn, 4);
@@ -720,94 +790,72 @@ static void wras_add_locator (const struct ddsi_domaingv *gv, struct addrset *ne
   }
 }
 
-static void wras_drop_covered_readers (int locidx, struct costmap *wm, struct cover *covered, bool prefer_multicast)
+static void wras_drop_covered_readers (int locidx, struct costmap *wm, const struct ddsi_wraddrset_cache *wc, struct wras_row * const *rows)
 {
   /* readers covered by this locator no longer matter */
-  const int nreaders = cover_get_nreaders (covered);
-  const int nlocs = cover_get_nlocs (covered);
-  for (int i = 0; i < nreaders; i++)
+  for (uint32_t i = 0; i < wc->nrows; i++)
   {
-    const cover_info_t ci_rd_loc = cover_get (covered, i, locidx);
-    if ((ci_rd_loc & CI_STATUS_MASK) != CI_REACHABLE)
+    struct wras_row * const row = rows[i];
+    const struct wras_row_entry *e_rd_loc;
+    if (row->covered || (e_rd_loc = wras_row_lookup (row, (uint32_t) locidx)) == NULL)
       continue;
-    for (int j = 0; j < nlocs; j++)
-    {
-      cover_info_t ci = cover_get (covered, i, j);
-      if ((ci & CI_STATUS_MASK) == CI_REACHABLE)
-      {
-        cover_set (covered, i, j, (cover_info_t) ((ci & ~CI_STATUS_MASK) | CI_INCLUDED));
-        // from reachable to included -> cost goes from "delivered" to "discarded"
-        const int32_t cost =
-          ((ci_rd_loc & ~CI_STATUS_MASK) == CI_ICEORYX) ? cost_redundant_iceoryx : cost_discarded;
-        costmap_adjust (wm, j, cost - cost_delivered);
-      }
-    }
-  }
-#if 0 && !defined NDEBUG
-  // if distinguishing between consequences of delivering via multiple locators to one
-  // already covered by iceoryx, this doesn't work anymore
-  for (int j = 0; j < nlocs; j++)
-  {
-    const readercount_cost_t a = costmap_get (wm, j);
-    const readercount_cost_t b = calc_locator_cost (covered, j, prefer_multicast);
-    assert (a.nrds == b.nrds);
-    assert (a.cost == b.cost);
+    row->covered = true;
+    // from reachable to included -> cost goes from "delivered" to "discarded"
+    const int32_t cost = (e_rd_loc->ci == CI_ICEORYX) ? cost_redundant_iceoryx : cost_discarded;
+    for (uint32_t j = 0; j < row->nlocs; j++)
+      costmap_adjust (wm, (int) row->e[j].colidx, row->weight, cost - cost_delivered);
   }
-#else
-  (void) prefer_multicast;
-#endif
 }
 
-struct addrset *compute_writer_addrset (const struct writer *wr)
+struct addrset *compute_writer_addrset (struct writer *wr)
 {
   struct ddsi_domaingv * const gv = wr->e.gv;
+  struct ddsi_wraddrset_cache * const wc = wr->wras_cache;
   const bool prefer_multicast = gv->config.prefer_multicast;
-  struct locset *locs;
-  struct cover *covered;
-  struct addrset *newas;
-
-  // Gather all addresses, using an addrset means no need to worry about
-  // duplicates. If no addresses found it is trivial.
+  struct addrset *newas = new_addrset ();
+
+  // Bring the coverage matrix up-to-date with the matched readers, this only
+  // does real work for readers that are new or have a new address set
+  wras_sync_readers (wc, wr);
+  ELOGDISC (wr, "setcover: %"PRIu32" readers %"PRIu32" rows %"PRIu32" locators\n",
+            (uint32_t) wr->num_readers, wc->nrows, wc->ncols);
+  if (wc->ncols == 0)
   {
-    struct addrset *all_addrs = wras_collect_all_locs (wr);
-    if (addrset_empty (all_addrs))
-      return all_addrs;
-    nn_log_addrset (gv, DDS_LC_DISCOVERY, "setcover: all_addrs", all_addrs);
-    ELOGDISC (wr, "\n");
-    locs = wras_calc_locators (&gv->logconfig, all_addrs);
-    unref_addrset (all_addrs);
+    // No readers or no addresses, no need to do anything else
+    return newas;
   }
 
-  if (!wras_calc_cover (wr, locs, &covered))
-  {
-    // Addrset computation fails when some proxy reader's address can't be found in all_addrs,
-    // which means its address set changed while we were working.  In that case, the change
-    // will trigger a recalculation and we can just return the old one.
-    //
-    // FIXME: copying it is a bit excessive (a little rework and refcount manipulation suffices)
-    newas = ref_addrset (wr->as);
-  }
-  else if (covered == NULL)
-  {
-    // No readers, no need to do anything else
-    newas = new_addrset ();
-  }
-  else
+  // Column indices change when locators are added or removed, so look them up
+  // once before running the greedy algorithm
+  struct wras_row **rows = ddsrt_malloc (wc->nrows * sizeof (*rows));
   {
-    assert(wr->xqos->present & QP_LOCATOR_MASK);
-    struct costmap *wm = wras_calc_costmap (covered, prefer_multicast, wr->xqos->ignore_locator_type);
-    int best;
-    newas = new_addrset ();
-    while ((best = wras_choose_locator (locs, wm)) >= 0)
+    struct ddsrt_hh_iter it;
+    uint32_t i = 0;
+    for (struct wras_row *row = ddsrt_hh_iter_first (wc->rows, &it); row; row = ddsrt_hh_iter_next (&it))
     {
-      wras_trace_cover (gv, locs, wm, covered);
-      ELOGDISC (wr, "  best = %d\n", best);
-      wras_add_locator (gv, newas, best, locs, covered);
-      wras_drop_covered_readers (best, wm, covered, prefer_multicast);
+      row->covered = false;
+      for (uint32_t j = 0; j < row->nlocs; j++)
+      {
+        const bool found = wras_lookup_column (wc, &row->e[j].loc, &row->e[j].colidx);
+        assert (found);
+        (void) found;
+      }
+      rows[i++] = row;
     }
-    costmap_free (wm);
-    cover_free (covered);
+    assert (i == wc->nrows);
+  }
+
+  assert(wr->xqos->present & QP_LOCATOR_MASK);
+  struct costmap *wm = wras_calc_costmap (wc, prefer_multicast, wr->xqos->ignore_locator_type);
+  int best;
+  while ((best = wras_choose_locator ((int) wc->ncols, wm)) >= 0)
+  {
+    wras_trace_cover (gv, wc, wm, rows);
+    ELOGDISC (wr, "  best = %d\n", best);
+    wras_add_locator (gv, newas, best, wc, rows);
+    wras_drop_covered_readers (best, wm, wc, rows);
   }
-  locset_free (locs);
+  costmap_free (wm);
+  ddsrt_free (rows);
   return newas;
 }
@@ -17,7 +17,6 @@
 #include "dds/ddsrt/log.h"
 #include "dds/ddsrt/string.h"
 #include "dds/ddsrt/misc.h"
-#include "dds/ddsrt/avl.h"
 #include "dds/ddsi/ddsi_tran.h"
 #include "dds/ddsi/q_log.h"
 #include "dds/ddsi/q_misc.h"
@@ -39,11 +38,6 @@
 #define TRYLOCK(as) (ddsrt_mutex_trylock (&((struct addrset *) (as))->lock))
 #define UNLOCK(as) (ddsrt_mutex_unlock (&((struct addrset *) (as))->lock))
 
-static int compare_xlocators_vwrap (const void *va, const void *vb);
-
-static const ddsrt_avl_ctreedef_t addrset_treedef =
-  DDSRT_AVL_CTREEDEF_INITIALIZER (offsetof (struct addrset_node, avlnode), offsetof (struct addrset_node, loc), compare_xlocators_vwrap, 0);
-
 static int add_addresses_to_addrset_1 (const struct ddsi_domaingv *gv, struct addrset *as, ddsi_locator_t *loc, int port_mode, const char *msgtag)
 {
   char buf[DDSI_LOCSTRLEN];
@@ -162,9 +156,62 @@ int compare_xlocators (const ddsi_xlocator_t *a, const ddsi_xlocator_t *b)
   }
 }
 
-static int compare_xlocators_vwrap (const void *va, const void *vb)
+static void addrset_locs_init (struct addrset_locs *ls)
+{
+  ls->n = ls->size = 0;
+  ls->locs = NULL;
+}
+
+static void addrset_locs_fini (struct addrset_locs *ls)
+{
+  ddsrt_free (ls->locs);
+  addrset_locs_init (ls);
+}
+
+static bool addrset_locs_lookup (const struct addrset_locs *ls, const ddsi_xlocator_t *loc, uint32_t *idx)
+{
+  /* binary search, on failure *idx is the position at which to insert it */
+  uint32_t lo = 0, hi = ls->n;
+  while (lo < hi)
+  {
+    const uint32_t m = lo + (hi - lo) / 2;
+    const int c = compare_xlocators (&ls->locs[m], loc);
+    if (c == 0)
+    {
+      *idx = m;
+      return true;
+    }
+    else if (c < 0)
+      lo = m + 1;
+    else
+      hi = m;
+  }
+  *idx = lo;
+  return false;
+}
+
+static void addrset_locs_insert (struct addrset_locs *ls, const ddsi_xlocator_t *loc)
 {
-  return compare_xlocators (va, vb);
+  uint32_t idx;
+  if (addrset_locs_lookup (ls, loc, &idx))
+    return;
+  if (ls->n == ls->size)
+  {
+    ls->size = (ls->size == 0) ? 2 : 2 * ls->size;
+    ls->locs = ddsrt_realloc (ls->locs, ls->size * sizeof (*ls->locs));
+  }
+  memmove (&ls->locs[idx + 1], &ls->locs[idx], (ls->n - idx) * sizeof (*ls->locs));
+  ls->locs[idx] = *loc;
+  ls->n++;
+}
+
+static void addrset_locs_remove (struct addrset_locs *ls, const ddsi_xlocator_t *loc)
+{
+  uint32_t idx;
+  if (!addrset_locs_lookup (ls, loc, &idx))
+    return;
+  ls->n--;
+  memmove (&ls->locs[idx], &ls->locs[idx + 1], (ls->n - idx) * sizeof (*ls->locs));
 }
 
 struct addrset *new_addrset (void)
@@ -172,8 +219,8 @@ struct addrset *new_addrset (void)
   struct addrset *as = ddsrt_malloc (sizeof (*as));
   ddsrt_atomic_st32 (&as->refc, 1);
   ddsrt_mutex_init (&as->lock);
-  ddsrt_avl_cinit (&addrset_treedef, &as->ucaddrs);
-  ddsrt_avl_cinit (&addrset_treedef, &as->mcaddrs);
+  addrset_locs_init (&as->ucaddrs);
+  addrset_locs_init (&as->mcaddrs);
   return as;
 }
 
@@ -190,8 +237,8 @@ void unref_addrset (struct addrset *as)
 {
   if ((as != NULL) && (ddsrt_atomic_dec32_ov (&as->refc) == 1))
   {
-    ddsrt_avl_cfree (&addrset_treedef, &as->ucaddrs, ddsrt_free);
-    ddsrt_avl_cfree (&addrset_treedef, &as->mcaddrs, ddsrt_free);
+    addrset_locs_fini (&as->ucaddrs);
+    addrset_locs_fini (&as->mcaddrs);
     ddsrt_mutex_destroy (&as->lock);
     ddsrt_free (as);
   }
@@ -226,12 +273,10 @@ int is_unspec_xlocator (const ddsi_xlocator_t *loc)
 #ifdef DDS_HAS_SSM
 int addrset_contains_ssm (const struct ddsi_domaingv *gv, const struct addrset *as)
 {
-  struct addrset_node *n;
-  ddsrt_avl_citer_t it;
   LOCK (as);
-  for (n = ddsrt_avl_citer_first (&addrset_treedef, &as->mcaddrs, &it); n; n = ddsrt_avl_citer_next (&it))
+  for (uint32_t i = 0; i < as->mcaddrs.n; i++)
   {
-    if (ddsi_is_ssm_mcaddr (gv, &n->loc.c))
+    if (ddsi_is_ssm_mcaddr (gv, &as->mcaddrs.locs[i].c))
     {
       UNLOCK (as);
       return 1;
@@ -243,14 +288,12 @@ int addrset_contains_ssm (const struct ddsi_domaingv *gv, const struct addrset *
 
 int addrset_any_ssm (const struct ddsi_domaingv *gv, const struct addrset *as, ddsi_xlocator_t *dst)
 {
-  struct addrset_node *n;
-  ddsrt_avl_citer_t it;
   LOCK (as);
-  for (n = ddsrt_avl_citer_first (&addrset_treedef, &as->mcaddrs, &it); n; n = ddsrt_avl_citer_next (&it))
+  for (uint32_t i = 0; i < as->mcaddrs.n; i++)
   {
-    if (ddsi_is_ssm_mcaddr (gv, &n->loc.c))
+    if (ddsi_is_ssm_mcaddr (gv, &as->mcaddrs.locs[i].c))
     {
-      *dst = n->loc;
+      *dst = as->mcaddrs.locs[i];
       UNLOCK (as);
       return 1;
     }
@@ -261,14 +304,12 @@ int addrset_any_ssm (const struct ddsi_domaingv *gv, const struct addrset *as, d
 
 int addrset_any_non_ssm_mc (const struct ddsi_domaingv *gv, const struct addrset *as, ddsi_xlocator_t *dst)
 {
-  struct addrset_node *n;
-  ddsrt_avl_citer_t it;
   LOCK (as);
-  for (n = ddsrt_avl_citer_first (&addrset_treedef, &as->mcaddrs, &it); n; n = ddsrt_avl_citer_next (&it))
+  for (uint32_t i = 0; i < as->mcaddrs.n; i++)
   {
-    if (!ddsi_is_ssm_mcaddr (gv, &n->loc.c))
+    if (!ddsi_is_ssm_mcaddr (gv, &as->mcaddrs.locs[i].c))
     {
-      *dst = n->loc;
+      *dst = as->mcaddrs.locs[i];
       UNLOCK (as);
       return 1;
     }
@@ -281,8 +322,8 @@ int addrset_any_non_ssm_mc (const struct ddsi_domaingv *gv, const struct addrset
 int addrset_purge (struct addrset *as)
 {
   LOCK (as);
-  ddsrt_avl_cfree (&addrset_treedef, &as->ucaddrs, ddsrt_free);
-  ddsrt_avl_cfree (&addrset_treedef, &as->mcaddrs, ddsrt_free);
+  addrset_locs_fini (&as->ucaddrs);
+  addrset_locs_fini (&as->mcaddrs);
   UNLOCK (as);
   return 0;
 }
@@ -291,15 +332,9 @@ static void add_xlocator_to_addrset_impl (const struct ddsi_domaingv *gv, struct
 {
   assert (!is_unspec_locator (&loc->c));
   assert (loc->conn != NULL);
-  ddsrt_avl_ipath_t path;
-  ddsrt_avl_ctree_t *tree = ddsi_is_mcaddr (gv, &loc->c) ? &as->mcaddrs : &as->ucaddrs;
+  struct addrset_locs *ls = ddsi_is_mcaddr (gv, &loc->c) ? &as->mcaddrs : &as->ucaddrs;
   LOCK (as);
-  if (ddsrt_avl_clookup_ipath (&addrset_treedef, tree, loc, &path) == NULL)
-  {
-    struct addrset_node *n = ddsrt_malloc (sizeof (*n));
-    n->loc = *loc;
-    ddsrt_avl_cinsert_ipath (&addrset_treedef, tree, n, &path);
-  }
+  addrset_locs_insert (ls, loc);
   UNLOCK (as);
 }
 
@@ -358,35 +393,25 @@ void add_locator_to_addrset (const struct ddsi_domaingv *gv, struct addrset *as,
 
 void remove_from_addrset (const struct ddsi_domaingv *gv, struct addrset *as, const ddsi_xlocator_t *loc)
 {
-  ddsrt_avl_dpath_t path;
-  ddsrt_avl_ctree_t *tree = ddsi_is_mcaddr (gv, &loc->c) ? &as->mcaddrs : &as->ucaddrs;
-  struct addrset_node *n;
+  struct addrset_locs *ls = ddsi_is_mcaddr (gv, &loc->c) ? &as->mcaddrs : &as->ucaddrs;
   LOCK (as);
-  if ((n = ddsrt_avl_clookup_dpath (&addrset_treedef, tree, loc, &path)) != NULL)
-  {
-    ddsrt_avl_cdelete_dpath (&addrset_treedef, tree, n, &path);
-    ddsrt_free (n);
-  }
+  addrset_locs_remove (ls, loc);
   UNLOCK (as);
 }
 
 void copy_addrset_into_addrset_uc (const struct ddsi_domaingv *gv, struct addrset *as, const struct addrset *asadd)
 {
-  struct addrset_node *n;
-  ddsrt_avl_citer_t it;
   LOCK (asadd);
-  for (n = ddsrt_avl_citer_first (&addrset_treedef, &asadd->ucaddrs, &it); n; n = ddsrt_avl_citer_next (&it))
-    add_xlocator_to_addrset_impl (gv, as, &n->loc);
+  for (uint32_t i = 0; i < asadd->ucaddrs.n; i++)
+    add_xlocator_to_addrset_impl (gv, as, &asadd->ucaddrs.locs[i]);
   UNLOCK (asadd);
 }
 
 void copy_addrset_into_addrset_mc (const struct ddsi_domaingv *gv, struct addrset *as, const struct addrset *asadd)
 {
-  struct addrset_node *n;
-  ddsrt_avl_citer_t it;
   LOCK (asadd);
-  for (n = ddsrt_avl_citer_first (&addrset_treedef, &asadd->mcaddrs, &it); n; n = ddsrt_avl_citer_next (&it))
-    add_xlocator_to_addrset_impl (gv, as, &n->loc);
+  for (uint32_t i = 0; i < asadd->mcaddrs.n; i++)
+    add_xlocator_to_addrset_impl (gv, as, &asadd->mcaddrs.locs[i]);
   UNLOCK (asadd);
 }
 
@@ -399,13 +424,11 @@ void copy_addrset_into_addrset (const struct ddsi_domaingv *gv, struct addrset *
 #ifdef DDS_HAS_SSM
 void copy_addrset_into_addrset_no_ssm_mc (const struct ddsi_domaingv *gv, struct addrset *as, const struct addrset *asadd)
 {
-  struct addrset_node *n;
-  ddsrt_avl_citer_t it;
   LOCK (asadd);
-  for (n = ddsrt_avl_citer_first (&addrset_treedef, &asadd->mcaddrs, &it); n; n = ddsrt_avl_citer_next (&it))
+  for (uint32_t i = 0; i < asadd->mcaddrs.n; i++)
   {
-    if (!ddsi_is_ssm_mcaddr (gv, &n->loc.c))
-      add_xlocator_to_addrset_impl (gv, as, &n->loc);
+    if (!ddsi_is_ssm_mcaddr (gv, &asadd->mcaddrs.locs[i].c))
+      add_xlocator_to_addrset_impl (gv, as, &asadd->mcaddrs.locs[i]);
   }
   UNLOCK (asadd);
 
@@ -426,7 +449,7 @@ size_t addrset_count (const struct addrset *as)
   {
     size_t count;
     LOCK (as);
-    count = ddsrt_avl_ccount (&as->ucaddrs) + ddsrt_avl_ccount (&as->mcaddrs);
+    count = (size_t) as->ucaddrs.n + (size_t) as->mcaddrs.n;
     UNLOCK (as);
     return count;
   }
@@ -440,7 +463,7 @@ size_t addrset_count_uc (const struct addrset *as)
   {
     size_t count;
     LOCK (as);
-    count = ddsrt_avl_ccount (&as->ucaddrs);
+    count = (size_t) as->ucaddrs.n;
     UNLOCK (as);
     return count;
   }
@@ -454,7 +477,7 @@ size_t addrset_count_mc (const struct addrset *as)
   {
     size_t count;
     LOCK (as);
-    count = ddsrt_avl_ccount (&as->mcaddrs);
+    count = (size_t) as->mcaddrs.n;
     UNLOCK (as);
     return count;
   }
@@ -464,7 +487,7 @@ int addrset_empty_uc (const struct addrset *as)
 {
   int isempty;
   LOCK (as);
-  isempty = ddsrt_avl_cis_empty (&as->ucaddrs);
+  isempty = (as->ucaddrs.n == 0);
   UNLOCK (as);
   return isempty;
 }
@@ -473,7 +496,7 @@ int addrset_empty_mc (const struct addrset *as)
 {
   int isempty;
   LOCK (as);
-  isempty = ddsrt_avl_cis_empty (&as->mcaddrs);
+  isempty = (as->mcaddrs.n == 0);
   UNLOCK (as);
   return isempty;
 }
@@ -482,7 +505,7 @@ int addrset_empty (const struct addrset *as)
 {
   int isempty;
   LOCK (as);
-  isempty = ddsrt_avl_cis_empty (&as->ucaddrs) && ddsrt_avl_cis_empty (&as->mcaddrs);
+  isempty = (as->ucaddrs.n == 0 && as->mcaddrs.n == 0);
   UNLOCK (as);
   return isempty;
 }
@@ -490,15 +513,14 @@ int addrset_empty (const struct addrset *as)
 int addrset_any_uc (const struct addrset *as, ddsi_xlocator_t *dst)
 {
   LOCK (as);
-  if (ddsrt_avl_cis_empty (&as->ucaddrs))
+  if (as->ucaddrs.n == 0)
   {
     UNLOCK (as);
     return 0;
   }
   else
   {
-    const struct addrset_node *n = ddsrt_avl_croot_non_empty (&addrset_treedef, &as->ucaddrs);
-    *dst = n->loc;
+    *dst = as->ucaddrs.locs[0];
     UNLOCK (as);
     return 1;
   }
@@ -507,15 +529,14 @@ int addrset_any_uc (const struct addrset *as, ddsi_xlocator_t *dst)
 int addrset_any_mc (const struct addrset *as, ddsi_xlocator_t *dst)
 {
   LOCK (as);
-  if (ddsrt_avl_cis_empty (&as->mcaddrs))
+  if (as->mcaddrs.n == 0)
   {
     UNLOCK (as);
     return 0;
   }
   else
   {
-    const struct addrset_node *n = ddsrt_avl_croot_non_empty (&addrset_treedef, &as->mcaddrs);
-    *dst = n->loc;
+    *dst = as->mcaddrs.locs[0];
     UNLOCK (as);
     return 1;
   }
@@ -524,43 +545,31 @@ int addrset_any_mc (const struct addrset *as, ddsi_xlocator_t *dst)
 void addrset_any_uc_else_mc_nofail (const struct addrset *as, ddsi_xlocator_t *dst)
 {
   LOCK (as);
-  if (!ddsrt_avl_cis_empty (&as->ucaddrs))
+  if (as->ucaddrs.n > 0)
   {
-    const struct addrset_node *n = ddsrt_avl_croot_non_empty (&addrset_treedef, &as->ucaddrs);
-    *dst = n->loc;
+    *dst = as->ucaddrs.locs[0];
   }
   else
   {
-    assert (!ddsrt_avl_cis_empty (&as->mcaddrs));
-    const struct addrset_node *n = ddsrt_avl_croot_non_empty (&addrset_treedef, &as->mcaddrs);
-    *dst = n->loc;
+    assert (as->mcaddrs.n > 0);
+    *dst = as->mcaddrs.locs[0];
   }
   UNLOCK (as);
 }
 
-struct addrset_forall_helper_arg
+static void addrset_locs_forall (const struct addrset_locs *ls, addrset_forall_fun_t f, void *arg)
 {
-  addrset_forall_fun_t f;
-  void * arg;
-};
-
-static void addrset_forall_helper (void *vnode, void *varg)
-{
-  const struct addrset_node *n = vnode;
-  struct addrset_forall_helper_arg *arg = varg;
-  arg->f (&n->loc, arg->arg);
+  for (uint32_t i = 0; i < ls->n; i++)
+    f (&ls->locs[i], arg);
 }
 
 size_t addrset_forall_count (struct addrset *as, addrset_forall_fun_t f, void *arg)
 {
-  struct addrset_forall_helper_arg arg1;
   size_t count;
-  arg1.f = f;
-  arg1.arg = arg;
   LOCK (as);
-  ddsrt_avl_cwalk (&addrset_treedef, &as->mcaddrs, addrset_forall_helper, &arg1);
-  ddsrt_avl_cwalk (&addrset_treedef, &as->ucaddrs, addrset_forall_helper, &arg1);
-  count = ddsrt_avl_ccount (&as->ucaddrs) + ddsrt_avl_ccount (&as->mcaddrs);
+  addrset_locs_forall (&as->mcaddrs, f, arg);
+  addrset_locs_forall (&as->ucaddrs, f, arg);
+  count = (size_t) as->ucaddrs.n + (size_t) as->mcaddrs.n;
   UNLOCK (as);
   return count;
 }
@@ -572,56 +581,39 @@ void addrset_forall (struct addrset *as, addrset_forall_fun_t f, void *arg)
 
 size_t addrset_forall_uc_else_mc_count (struct addrset *as, addrset_forall_fun_t f, void *arg)
 {
-  struct addrset_forall_helper_arg arg1;
+  const struct addrset_locs *ls;
   size_t count;
-  arg1.f = f;
-  arg1.arg = arg;
   LOCK (as);
-  if (!ddsrt_avl_cis_empty (&as->ucaddrs))
-  {
-    ddsrt_avl_cwalk (&addrset_treedef, &as->ucaddrs, addrset_forall_helper, &arg1);
-    count = ddsrt_avl_ccount (&as->ucaddrs);
-  }
-  else
-  {
-    ddsrt_avl_cwalk (&addrset_treedef, &as->mcaddrs, addrset_forall_helper, &arg1);
-    count = ddsrt_avl_ccount (&as->mcaddrs);
-  }
+  ls = (as->ucaddrs.n > 0) ? &as->ucaddrs : &as->mcaddrs;
+  addrset_locs_forall (ls, f, arg);
+  count = (size_t) ls->n;
   UNLOCK (as);
   return count;
 }
 
 size_t addrset_forall_mc_count (struct addrset *as, addrset_forall_fun_t f, void *arg)
 {
-  struct addrset_forall_helper_arg arg1;
   size_t count;
-  arg1.f = f;
-  arg1.arg = arg;
   LOCK (as);
-  ddsrt_avl_cwalk (&addrset_treedef, &as->mcaddrs, addrset_forall_helper, &arg1);
-  count = ddsrt_avl_ccount (&as->mcaddrs);
+  addrset_locs_forall (&as->mcaddrs, f, arg);
+  count = (size_t) as->mcaddrs.n;
   UNLOCK (as);
   return count;
 }
 
 int addrset_forone (struct addrset *as, addrset_forone_fun_t f, void *arg)
 {
-  addrset_node_t n;
-  ddsrt_avl_ctree_t *trees[2];
-  ddsrt_avl_citer_t iter;
-
-  trees[0] = &as->mcaddrs;
-  trees[1] = &as->ucaddrs;
+  const struct addrset_locs *lss[2];
+  lss[0] = &as->mcaddrs;
+  lss[1] = &as->ucaddrs;
   for (int i = 0; i < 2; i++)
   {
-    n = (addrset_node_t) ddsrt_avl_citer_first (&addrset_treedef, trees[i], &iter);
-    while (n)
+    for (uint32_t j = 0; j < lss[i]->n; j++)
     {
-      if ((f) (&n->loc, arg) > 0)
+      if ((f) (&lss[i]->locs[j], arg) > 0)
       {
         return 0;
       }
-      n = (addrset_node_t) ddsrt_avl_citer_next (&iter);
     }
   }
   return -1;
@@ -654,15 +646,13 @@ void nn_log_addrset (struct ddsi_domaingv *gv, uint32_t tf, const char *prefix,
   }
 }
 
-static int addrset_eq_onesidederr1 (const ddsrt_avl_ctree_t *at, const ddsrt_avl_ctree_t *bt)
+static int addrset_eq_onesidederr1 (const struct addrset_locs *a, const struct addrset_locs *b)
 {
-  /* Just checking the root */
-  if (ddsrt_avl_cis_empty (at) && ddsrt_avl_cis_empty (bt)) {
+  /* Just checking the trivial cases */
+  if (a->n == 0 && b->n == 0) {
     return 1;
-  } else if (ddsrt_avl_cis_singleton (at) && ddsrt_avl_cis_singleton (bt)) {
-    const struct addrset_node *a = ddsrt_avl_croot_non_empty (&addrset_treedef, at);
-    const struct addrset_node *b = ddsrt_avl_croot_non_empty (&addrset_treedef, bt);
-    return compare_xlocators (&a->loc, &b->loc) == 0;
+  } else if (a->n == 1 && b->n == 1) {
+    return compare_xlocators (&a->locs[0], &b->locs[0]) == 0;
   } else {
     return 0;
   }
@@ -161,6 +161,9 @@ DUPF(uint32);
 #endif
 DU(natint);
 DU(natint_255);
+DU(unicast_recv_threads);
+DU(xevent_threads);
+DU(discovery_threads);
 DUPF(participantIndex);
 DU(dyn_port);
 DUPF(memsize);
@@ -1400,6 +1403,21 @@ static enum update_result uf_natint_255(struct cfgst *cfgst, void *parent, struc
   return uf_int_min_max(cfgst, parent, cfgelem, first, value, 0, 255);
 }
 
+static enum update_result uf_unicast_recv_threads(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int first, const char *value)
+{
+  return uf_int_min_max(cfgst, parent, cfgelem, first, value, 1, DDSI_MAX_UNICAST_RECV_THREADS);
+}
+
+static enum update_result uf_xevent_threads(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int first, const char *value)
+{
+  return uf_int_min_max(cfgst, parent, cfgelem, first, value, 1, DDSI_MAX_XEVENT_THREADS);
+}
+
+static enum update_result uf_discovery_threads(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int first, const char *value)
+{
+  return uf_int_min_max(cfgst, parent, cfgelem, first, value, 1, DDSI_MAX_DISCOVERY_THREADS);
+}
+
 static enum update_result uf_uint (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG (int first), const char *value)
 {
   uint32_t * const elem = cfg_address (cfgst, parent, cfgelem);
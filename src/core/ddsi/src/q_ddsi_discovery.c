@@ -46,6 +46,8 @@
 #include "dds/ddsi/q_feature_check.h"
 #include "dds/ddsi/ddsi_security_omg.h"
 #include "dds/ddsi/ddsi_pmd.h"
+#include "dds/ddsi/ddsi_discovery_cache.h"
+#include "dds/ddsi/ddsi_content_filter.h"
 #ifdef DDS_HAS_SECURITY
 #include "dds/ddsi/ddsi_security_exchange.h"
 #endif
@@ -628,6 +630,28 @@ static void respond_to_spdp (const struct ddsi_domaingv *gv, const ddsi_guid_t *
   entidx_enum_participant_fini (&est);
 }
 
+static uint32_t discovery_index_for_prefix (const struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix)
+{
+  const uint32_t h0 = prefix->u[0] ^ prefix->u[1] ^ prefix->u[2];
+  const uint32_t h = (uint32_t) (((uint64_t) h0 * UINT64_C (16292676669999574021)) >> 32);
+  return h % (gv->n_builtins_dqueues_extra + 1);
+}
+
+struct nn_dqueue *builtins_dqueue_for_prefix (const struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix)
+{
+  if (gv->n_builtins_dqueues_extra == 0)
+    return gv->builtins_dqueue;
+  const uint32_t idx = discovery_index_for_prefix (gv, prefix);
+  return (idx == 0) ? gv->builtins_dqueue : gv->builtins_dqueues_extra[idx - 1];
+}
+
+static ddsrt_mutex_t *discovery_lock_for_prefix (struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix)
+{
+  /* Same mapping as for the queues, so that there is no contention unless the
+     discovery data of a participant is relayed by another one */
+  return &gv->discovery_lock[discovery_index_for_prefix (gv, prefix)];
+}
+
 static int handle_spdp_dead (const struct receiver_state *rst, ddsi_entityid_t pwr_entityid, ddsrt_wctime_t timestamp, const ddsi_plist_t *datap, unsigned statusinfo)
 {
   struct ddsi_domaingv * const gv = rst->gv;
@@ -649,6 +673,8 @@ static int handle_spdp_dead (const struct receiver_state *rst, ddsi_entityid_t p
       else
       {
         GVLOGDISC (" delete");
+        if (gv->discovery_cache)
+          ddsi_discovery_cache_remove (gv->discovery_cache, &guid);
       }
     }
     else
@@ -975,6 +1001,19 @@ static int handle_spdp_alive (const struct receiver_state *rst, seqno_t seq, dds
   }
 }
 
+static void update_discovery_cache_spdp (const struct receiver_state *rst, ddsi_entityid_t pwr_entityid, seqno_t seq, const struct ddsi_serdata *serdata, const ddsi_plist_t *datap)
+{
+  /* Only participants that announce themselves without security: secure ones
+     have to be authenticated anyway, and relayed ones depend on the relay */
+  struct ddsi_domaingv * const gv = rst->gv;
+  if (pwr_entityid.u != NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_WRITER || (datap->present & PP_IDENTITY_TOKEN))
+    return;
+  if (!(datap->present & PP_PARTICIPANT_GUID) || memcmp (&datap->participant_guid.prefix, &rst->src_guid_prefix, sizeof (rst->src_guid_prefix)) != 0)
+    return;
+  if (entidx_lookup_proxy_participant_guid (gv->entity_index, &datap->participant_guid) != NULL)
+    ddsi_discovery_cache_update (gv->discovery_cache, DDSI_DCK_PARTICIPANT, &datap->participant_guid, rst, seq, serdata);
+}
+
 static void handle_spdp (const struct receiver_state *rst, ddsi_entityid_t pwr_entityid, seqno_t seq, const struct ddsi_serdata *serdata)
 {
   struct ddsi_domaingv * const gv = rst->gv;
@@ -982,10 +1021,14 @@ static void handle_spdp (const struct receiver_state *rst, ddsi_entityid_t pwr_e
   if (ddsi_serdata_to_sample (serdata, &decoded_data, NULL, NULL))
   {
     int interesting = 0;
+    ddsrt_mutex_t * const lock = discovery_lock_for_prefix (gv, (decoded_data.present & PP_PARTICIPANT_GUID) ? &decoded_data.participant_guid.prefix : &rst->src_guid_prefix);
+    ddsrt_mutex_lock (lock);
     switch (serdata->statusinfo & (NN_STATUSINFO_DISPOSE | NN_STATUSINFO_UNREGISTER))
     {
       case 0:
         interesting = handle_spdp_alive (rst, seq, serdata->timestamp, &decoded_data);
+        if (gv->discovery_cache)
+          update_discovery_cache_spdp (rst, pwr_entityid, seq, serdata, &decoded_data);
         break;
 
       case NN_STATUSINFO_DISPOSE:
@@ -994,6 +1037,7 @@ static void handle_spdp (const struct receiver_state *rst, ddsi_entityid_t pwr_e
         interesting = handle_spdp_dead (rst, pwr_entityid, serdata->timestamp, &decoded_data, serdata->statusinfo);
         break;
     }
+    ddsrt_mutex_unlock (lock);
 
     ddsi_plist_fini (&decoded_data);
     GVLOG (interesting ? DDS_LC_DISCOVERY : DDS_LC_TRACE, "\n");
@@ -1158,6 +1202,13 @@ static int sedp_write_endpoint_impl
         ps.present |= PP_CYCLONE_REQUESTS_KEYHASH;
         ps.cyclone_requests_keyhash = 1u;
       }
+      if (rd->content_filter)
+      {
+        /* not aliased: the plist code frees the expression parameters sequence even
+           if it is marked as aliased */
+        ps.present |= PP_CONTENT_FILTER_PROPERTY;
+        ddsi_content_filter_property_copy (&ps.content_filter_property, rd->content_filter);
+      }
     }
 
 #ifdef DDS_HAS_SSM
@@ -1697,10 +1748,10 @@ static void handle_sedp_alive_endpoint (const struct receiver_state *rst, seqno_
 #ifdef DDS_HAS_NETWORK_CHANNELS
         {
           struct ddsi_config_channel_listelem *channel = find_channel (&gv->config, xqos->transport_priority);
-          new_proxy_writer (gv, &ppguid, &datap->endpoint_guid, as, datap, channel->dqueue, channel->evq ? channel->evq : gv->xevents, timestamp, seq);
+          new_proxy_writer (gv, &ppguid, &datap->endpoint_guid, as, datap, channel->dqueue, channel->evq ? channel->evq : xeventq_for_guid (gv, &datap->endpoint_guid), timestamp, seq);
         }
 #else
-        new_proxy_writer (gv, &ppguid, &datap->endpoint_guid, as, datap, gv->user_dqueue, gv->xevents, timestamp, seq);
+        new_proxy_writer (gv, &ppguid, &datap->endpoint_guid, as, datap, gv->user_dqueue, xeventq_for_guid (gv, &datap->endpoint_guid), timestamp, seq);
 #endif
       }
     }
@@ -1736,6 +1787,8 @@ static void handle_sedp_dead_endpoint (const struct receiver_state *rst, ddsi_pl
   else
     res = delete_proxy_reader (gv, &datap->endpoint_guid, timestamp, 0);
   GVLOGDISC (" %s\n", (res < 0) ? " unknown" : " delete");
+  if (res >= 0 && gv->discovery_cache)
+    ddsi_discovery_cache_remove (gv->discovery_cache, &datap->endpoint_guid);
 }
 
 #ifdef DDS_HAS_TOPIC_DISCOVERY
@@ -1822,12 +1875,39 @@ static void handle_sedp_dead_topic (const struct receiver_state *rst, ddsi_plist
 
 #endif /* DDS_HAS_TOPIC_DISCOVERY */
 
+static const ddsi_guid_prefix_t *sedp_subject_prefix (const struct receiver_state *rst, const ddsi_plist_t *datap, ddsi_sedp_kind_t sedp_kind)
+{
+  /* Prefix of the participant owning the entity described by the SEDP sample,
+     which need not be the one that sent it */
+#ifdef DDS_HAS_TOPIC_DISCOVERY
+  if (sedp_kind == SEDP_KIND_TOPIC)
+    return (datap->present & PP_CYCLONE_TOPIC_GUID) ? &datap->topic_guid.prefix : &rst->src_guid_prefix;
+#else
+  (void) sedp_kind;
+#endif
+  return (datap->present & PP_ENDPOINT_GUID) ? &datap->endpoint_guid.prefix : &rst->src_guid_prefix;
+}
+
+static void update_discovery_cache_sedp (const struct receiver_state *rst, seqno_t seq, const struct ddsi_serdata *serdata, const ddsi_plist_t *datap, ddsi_sedp_kind_t sedp_kind)
+{
+  /* The cache only records endpoints of participants it knows */
+  struct ddsi_domaingv * const gv = rst->gv;
+  if (!(datap->present & PP_ENDPOINT_GUID) || memcmp (&datap->endpoint_guid.prefix, &rst->src_guid_prefix, sizeof (rst->src_guid_prefix)) != 0)
+    return;
+  if (sedp_kind == SEDP_KIND_WRITER && entidx_lookup_proxy_writer_guid (gv->entity_index, &datap->endpoint_guid) != NULL)
+    ddsi_discovery_cache_update (gv->discovery_cache, DDSI_DCK_WRITER, &datap->endpoint_guid, rst, seq, serdata);
+  else if (sedp_kind == SEDP_KIND_READER && entidx_lookup_proxy_reader_guid (gv->entity_index, &datap->endpoint_guid) != NULL)
+    ddsi_discovery_cache_update (gv->discovery_cache, DDSI_DCK_READER, &datap->endpoint_guid, rst, seq, serdata);
+}
+
 static void handle_sedp (const struct receiver_state *rst, seqno_t seq, struct ddsi_serdata *serdata, ddsi_sedp_kind_t sedp_kind)
 {
   ddsi_plist_t decoded_data;
   if (ddsi_serdata_to_sample (serdata, &decoded_data, NULL, NULL))
   {
     struct ddsi_domaingv * const gv = rst->gv;
+    ddsrt_mutex_t * const lock = discovery_lock_for_prefix (gv, sedp_subject_prefix (rst, &decoded_data, sedp_kind));
+    ddsrt_mutex_lock (lock);
     GVLOGDISC ("SEDP ST%"PRIx32, serdata->statusinfo);
     switch (serdata->statusinfo & (NN_STATUSINFO_DISPOSE | NN_STATUSINFO_UNREGISTER))
     {
@@ -1837,7 +1917,11 @@ static void handle_sedp (const struct receiver_state *rst, seqno_t seq, struct d
           handle_sedp_alive_topic (rst, seq, &decoded_data, &rst->src_guid_prefix, rst->vendor, serdata->timestamp);
         else
 #endif
+        {
           handle_sedp_alive_endpoint (rst, seq, &decoded_data, sedp_kind, &rst->src_guid_prefix, rst->vendor, serdata->timestamp);
+          if (gv->discovery_cache)
+            update_discovery_cache_sedp (rst, seq, serdata, &decoded_data, sedp_kind);
+        }
         break;
       case NN_STATUSINFO_DISPOSE:
       case NN_STATUSINFO_UNREGISTER:
@@ -1850,10 +1934,76 @@ static void handle_sedp (const struct receiver_state *rst, seqno_t seq, struct d
           handle_sedp_dead_endpoint (rst, &decoded_data, sedp_kind, serdata->timestamp);
         break;
     }
+    ddsrt_mutex_unlock (lock);
     ddsi_plist_fini (&decoded_data);
   }
 }
 
+static void restore_discovery_cache_entry (const struct ddsi_discovery_cache_entry *e, void *varg)
+{
+  struct ddsi_domaingv * const gv = varg;
+  struct ddsi_sertype *type;
+  switch (e->kind)
+  {
+    case DDSI_DCK_PARTICIPANT: type = gv->spdp_type; break;
+    case DDSI_DCK_WRITER: type = gv->sedp_writer_type; break;
+    case DDSI_DCK_READER: type = gv->sedp_reader_type; break;
+    default: return;
+  }
+
+  /* Nothing is known about the source address and it wasn't addressed to anyone in
+     particular, so the new proxy participants get a response */
+  struct receiver_state rst;
+  memset (&rst, 0, sizeof (rst));
+  rst.gv = gv;
+  rst.src_guid_prefix = e->src_guid_prefix;
+  rst.vendor = e->vendorid;
+  rst.protocol_version = e->protocol_version;
+  set_unspec_locator (&rst.srcloc);
+
+  ddsrt_iovec_t iov = { .iov_base = e->data, .iov_len = (ddsrt_iov_len_t) e->size };
+  struct ddsi_serdata *d = ddsi_serdata_from_ser_iov (type, SDK_DATA, 1, &iov, e->size);
+  if (d == NULL)
+  {
+    GVLOGDISC ("discovery cache: "PGUIDFMT" deserialization failed\n", PGUID (e->guid));
+    return;
+  }
+  d->timestamp = e->timestamp;
+  d->statusinfo = 0;
+  struct ddsi_serdata_plist *d_plist = (struct ddsi_serdata_plist *) d;
+  d_plist->protoversion = e->protocol_version;
+  d_plist->vendorid = e->vendorid;
+
+  ddsi_plist_t decoded_data;
+  if (ddsi_serdata_to_sample (d, &decoded_data, NULL, NULL))
+  {
+    struct thread_state1 * const ts1 = lookup_thread_state ();
+    ddsrt_mutex_t * const lock = discovery_lock_for_prefix (gv, &e->guid.prefix);
+    thread_state_awake (ts1, gv);
+    ddsrt_mutex_lock (lock);
+    GVLOGDISC ("discovery cache: ");
+    if (e->kind == DDSI_DCK_PARTICIPANT)
+    {
+      (void) handle_spdp_alive (&rst, e->seq, e->timestamp, &decoded_data);
+      GVLOGDISC ("\n");
+    }
+    else
+    {
+      GVLOGDISC ("SEDP ST0");
+      handle_sedp_alive_endpoint (&rst, e->seq, &decoded_data, (e->kind == DDSI_DCK_WRITER) ? SEDP_KIND_WRITER : SEDP_KIND_READER, &rst.src_guid_prefix, rst.vendor, e->timestamp);
+    }
+    ddsrt_mutex_unlock (lock);
+    thread_state_asleep (ts1);
+    ddsi_plist_fini (&decoded_data);
+  }
+  ddsi_serdata_unref (d);
+}
+
+void restore_discovery_cache (struct ddsi_domaingv *gv)
+{
+  ddsi_discovery_cache_restore (gv->discovery_cache, restore_discovery_cache_entry, gv);
+}
+
 #ifdef DDS_HAS_TYPE_DISCOVERY
 static void handle_typelookup (const struct receiver_state *rst, ddsi_entityid_t wr_entity_id, struct ddsi_serdata *serdata)
 {
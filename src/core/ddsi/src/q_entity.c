@@ -46,6 +46,7 @@
 #include "dds/ddsi/ddsi_udp.h" /* nn_mc4gen_address_t */
 #include "dds/ddsi/ddsi_rhc.h"
 #include "dds/ddsi/ddsi_wraddrset.h"
+#include "dds/ddsi/ddsi_content_filter.h"
 
 #include "dds/ddsi/sysdeps.h"
 #include "dds__whc.h"
@@ -122,7 +123,7 @@ static const unsigned builtin_writers_besmask =
 ;
 
 static dds_return_t new_writer_guid (struct writer **wr_out, const struct ddsi_guid *guid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct whc *whc, status_cb_t status_cb, void *status_cbarg);
-static dds_return_t new_reader_guid (struct reader **rd_out, const struct ddsi_guid *guid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct ddsi_rhc *rhc, status_cb_t status_cb, void *status_cbarg);
+static dds_return_t new_reader_guid (struct reader **rd_out, const struct ddsi_guid *guid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct ddsi_rhc *rhc, status_cb_t status_cb, void *status_cbarg, const nn_content_filter_property_t *content_filter);
 static struct participant *ref_participant (struct participant *pp, const struct ddsi_guid *guid_of_refing_entity);
 static void unref_participant (struct participant *pp, const struct ddsi_guid *guid_of_refing_entity);
 static struct entity_common *entity_common_from_proxy_endpoint_common (const struct proxy_endpoint_common *c);
@@ -309,6 +310,8 @@ static void entity_common_init (struct entity_common *e, struct ddsi_domaingv *g
   e->name = ddsrt_strdup (name ? name : "");
   e->onlylocal = onlylocal;
   e->gv = gv;
+  e->entidx_topic = NULL;
+  e->entidx_topic_idx = 0;
   ddsrt_mutex_init (&e->lock);
   ddsrt_mutex_init (&e->qos_lock);
   if (builtintopic_is_visible (gv->builtin_topic_interface, guid, vendorid))
@@ -543,7 +546,7 @@ static void remove_deleted_participant_guid (struct deleted_participants_admin *
 }
 
 /* PARTICIPANT ------------------------------------------------------ */
-static bool update_qos_locked (struct entity_common *e, dds_qos_t *ent_qos, const dds_qos_t *xqos, ddsrt_wctime_t timestamp)
+static bool update_qos_locked (struct entity_common *e, dds_qos_t *ent_qos, struct ddsi_qos_match_cache *mcache, const dds_qos_t *xqos, ddsrt_wctime_t timestamp)
 {
   uint64_t mask;
 
@@ -570,11 +573,49 @@ static bool update_qos_locked (struct entity_common *e, dds_qos_t *ent_qos, cons
   ddsrt_mutex_lock (&e->qos_lock);
   ddsi_xqos_fini_mask (ent_qos, mask);
   ddsi_xqos_mergein_missing (ent_qos, xqos, mask);
+  if (mcache)
+    ddsi_qos_match_cache_init (mcache);
   ddsrt_mutex_unlock (&e->qos_lock);
   builtintopic_write_endpoint (e->gv->builtin_topic_interface, e, timestamp, true);
   return true;
 }
 
+static bool update_proxy_endpoint_qos_locked (struct entity_common *e, dds_qos_t **ent_qos, const dds_qos_t *xqos, ddsrt_wctime_t timestamp)
+{
+  /* Proxy endpoints share interned QoS objects, so an update means replacing
+     the QoS by another interned one; the old one may still be in use by
+     threads that looked it up without holding qos_lock, so it is released
+     via the garbage collector */
+  struct ddsi_domaingv * const gv = e->gv;
+  uint64_t mask;
+
+  mask = ddsi_xqos_delta (*ent_qos, xqos, QP_CHANGEABLE_MASK & ~(QP_RXO_MASK | QP_PARTITION)) & xqos->present;
+  EELOGDISC (e, "update_qos_locked "PGUIDFMT" delta=%"PRIu64" QOS={", PGUID(e->guid), mask);
+  ddsi_xqos_log (DDS_LC_DISCOVERY, &gv->logconfig, xqos);
+  EELOGDISC (e, "}\n");
+
+  if (mask == 0)
+    /* no change, or an as-yet unsupported one */
+    return false;
+
+  dds_qos_t newqos, *old;
+  ddsi_xqos_copy (&newqos, *ent_qos);
+  ddsi_xqos_fini_mask (&newqos, mask);
+  ddsi_xqos_mergein_missing (&newqos, xqos, mask);
+  dds_qos_t * const interned = ddsi_qos_intern_ref (gv->qos_intern, &newqos);
+  ddsi_xqos_fini (&newqos);
+
+  ddsrt_mutex_lock (&e->qos_lock);
+  old = *ent_qos;
+  *ent_qos = interned;
+  ddsrt_mutex_unlock (&e->qos_lock);
+
+  ddsi_qos_intern_unref_gc (gv->qos_intern, gv->gcreq_queue, old);
+
+  builtintopic_write_endpoint (gv->builtin_topic_interface, e, timestamp, true);
+  return true;
+}
+
 static dds_return_t pp_allocate_entityid(ddsi_entityid_t *id, uint32_t kind, struct participant *pp)
 {
   uint32_t id1;
@@ -661,11 +702,11 @@ static void add_security_builtin_endpoints(struct participant *pp, ddsi_guid_t *
   if (add_readers)
   {
     subguid->entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_SECURE_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_SUBSCRIPTION_SECURE_NAME, gv->sedp_reader_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_SUBSCRIPTION_SECURE_NAME, gv->sedp_reader_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_SUBSCRIPTION_MESSAGE_SECURE_DETECTOR;
 
     subguid->entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_PUBLICATIONS_SECURE_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PUBLICATION_SECURE_NAME, gv->sedp_writer_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PUBLICATION_SECURE_NAME, gv->sedp_writer_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_PUBLICATION_MESSAGE_SECURE_DETECTOR;
   }
 
@@ -674,19 +715,19 @@ static void add_security_builtin_endpoints(struct participant *pp, ddsi_guid_t *
    * besmode flag setting, because all participant do require authentication.
    */
   subguid->entityid = to_entityid (NN_ENTITYID_SPDP_RELIABLE_BUILTIN_PARTICIPANT_SECURE_READER);
-  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_SECURE_NAME, gv->spdp_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_SECURE_NAME, gv->spdp_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
   pp->bes |= NN_DISC_BUILTIN_ENDPOINT_PARTICIPANT_SECURE_DETECTOR;
 
   subguid->entityid = to_entityid (NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_VOLATILE_SECURE_READER);
-  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_VOLATILE_MESSAGE_SECURE_NAME, gv->pgm_volatile_type, &gv->builtin_secure_volatile_xqos_rd, NULL, NULL, NULL);
+  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_VOLATILE_MESSAGE_SECURE_NAME, gv->pgm_volatile_type, &gv->builtin_secure_volatile_xqos_rd, NULL, NULL, NULL, NULL);
   pp->bes |= NN_BUILTIN_ENDPOINT_PARTICIPANT_VOLATILE_SECURE_DETECTOR;
 
   subguid->entityid = to_entityid (NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_STATELESS_MESSAGE_READER);
-  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_STATELESS_MESSAGE_NAME, gv->pgm_stateless_type, &gv->builtin_stateless_xqos_rd, NULL, NULL, NULL);
+  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_STATELESS_MESSAGE_NAME, gv->pgm_stateless_type, &gv->builtin_stateless_xqos_rd, NULL, NULL, NULL, NULL);
   pp->bes |= NN_BUILTIN_ENDPOINT_PARTICIPANT_STATELESS_MESSAGE_DETECTOR;
 
   subguid->entityid = to_entityid (NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_MESSAGE_SECURE_READER);
-  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_MESSAGE_SECURE_NAME, gv->pmd_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_MESSAGE_SECURE_NAME, gv->pmd_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
   pp->bes |= NN_BUILTIN_ENDPOINT_PARTICIPANT_MESSAGE_SECURE_DETECTOR;
 }
 #endif
@@ -739,21 +780,21 @@ static void add_builtin_endpoints(struct participant *pp, ddsi_guid_t *subguid,
   {
     /* SPDP reader: */
     subguid->entityid = to_entityid (NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_NAME, gv->spdp_type, &gv->spdp_endpoint_xqos, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_NAME, gv->spdp_type, &gv->spdp_endpoint_xqos, NULL, NULL, NULL, NULL);
     pp->bes |= NN_DISC_BUILTIN_ENDPOINT_PARTICIPANT_DETECTOR;
 
     /* SEDP readers: */
     subguid->entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_SUBSCRIPTION_NAME, gv->sedp_reader_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_SUBSCRIPTION_NAME, gv->sedp_reader_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_DISC_BUILTIN_ENDPOINT_SUBSCRIPTION_DETECTOR;
 
     subguid->entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_PUBLICATIONS_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PUBLICATION_NAME, gv->sedp_writer_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PUBLICATION_NAME, gv->sedp_writer_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_DISC_BUILTIN_ENDPOINT_PUBLICATION_DETECTOR;
 
     /* PMD reader: */
     subguid->entityid = to_entityid (NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_MESSAGE_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_MESSAGE_NAME, gv->pmd_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_MESSAGE_NAME, gv->pmd_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_PARTICIPANT_MESSAGE_DATA_READER;
 
 #ifdef DDS_HAS_TOPIC_DISCOVERY
@@ -761,18 +802,18 @@ static void add_builtin_endpoints(struct participant *pp, ddsi_guid_t *subguid,
     {
       /* SEDP topic reader: */
       subguid->entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_TOPIC_READER);
-      new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_TOPIC_NAME, gv->sedp_topic_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+      new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_TOPIC_NAME, gv->sedp_topic_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
       pp->bes |= NN_DISC_BUILTIN_ENDPOINT_TOPICS_DETECTOR;
     }
 #endif
 #ifdef DDS_HAS_TYPE_DISCOVERY
     /* TypeLookup readers: */
     subguid->entityid = to_entityid (NN_ENTITYID_TL_SVC_BUILTIN_REQUEST_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_TYPELOOKUP_REQUEST_NAME, gv->tl_svc_request_type, &gv->builtin_volatile_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_TYPELOOKUP_REQUEST_NAME, gv->tl_svc_request_type, &gv->builtin_volatile_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_TL_SVC_REQUEST_DATA_READER;
 
     subguid->entityid = to_entityid (NN_ENTITYID_TL_SVC_BUILTIN_REPLY_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_TYPELOOKUP_REPLY_NAME, gv->tl_svc_reply_type, &gv->builtin_volatile_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_TYPELOOKUP_REPLY_NAME, gv->tl_svc_reply_type, &gv->builtin_volatile_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_TL_SVC_REPLY_DATA_READER;
 #endif
   }
@@ -1242,7 +1283,7 @@ dds_return_t new_participant (ddsi_guid_t *p_ppguid, struct ddsi_domaingv *gv, u
 void update_participant_plist (struct participant *pp, const ddsi_plist_t *plist)
 {
   ddsrt_mutex_lock (&pp->e.lock);
-  if (update_qos_locked (&pp->e, &pp->plist->qos, &plist->qos, ddsrt_time_wallclock ()))
+  if (update_qos_locked (&pp->e, &pp->plist->qos, NULL, &plist->qos, ddsrt_time_wallclock ()))
     spdp_write (pp);
   ddsrt_mutex_unlock (&pp->e.lock);
 }
@@ -1597,11 +1638,6 @@ static uint32_t get_min_receive_buffer_size (struct writer *wr)
 
 static void rebuild_writer_addrset (struct writer *wr)
 {
-  /* FIXME: way too inefficient in this form:
-     - it gets computed for every change
-     - in many cases the set of addresses from the readers
-       is identical, so we could cache the results */
-
   /* only one operation at a time */
   ASSERT_MUTEX_HELD (&wr->e.lock);
 
@@ -1785,6 +1821,7 @@ static void writer_drop_connection (const struct ddsi_guid *wr_guid, const struc
       wr->num_readers--;
       wr->num_reliable_readers -= m->is_reliable;
       wr->num_readers_requesting_keyhash -= prd->requests_keyhash ? 1 : 0;
+      wr->num_content_filtered_readers -= (m->content_filter != NULL) ? 1 : 0;
       rebuild_writer_addrset (wr);
       remove_acked_messages (wr, &whcst, &deferred_free_list);
     }
@@ -2108,6 +2145,7 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd,
   m->all_have_replied_to_hb = 0;
   m->non_responsive_count = 0;
   m->rexmit_requests = 0;
+  m->content_filter = prd->content_filter;
 #ifdef DDS_HAS_SECURITY
   m->crypto_handle = crypto_handle;
 #else
@@ -2165,6 +2203,7 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd,
     wr->num_readers++;
     wr->num_reliable_readers += m->is_reliable;
     wr->num_readers_requesting_keyhash += prd->requests_keyhash ? 1 : 0;
+    wr->num_content_filtered_readers += (m->content_filter != NULL) ? 1 : 0;
     rebuild_writer_addrset (wr);
     ddsrt_mutex_unlock (&wr->e.lock);
 
@@ -2734,11 +2773,40 @@ static bool topickind_qos_match_p_lock (
   const int shift = (uintptr_t) rd > (uintptr_t) wr;
   for (int i = 0; i < 2; i++)
     ddsrt_mutex_lock (locks[i + shift]);
+
+  /* Proxy endpoints have interned QoS objects, so the outcome of matching a local
+     endpoint with a given proxy QoS can be cached in the local endpoint, which
+     in large systems avoids evaluating the same combination over and over */
+  struct ddsi_qos_match_cache *mcache = NULL;
+  uint64_t mcache_id = 0;
+  if (rd->kind == EK_READER && wr->kind == EK_PROXY_WRITER)
+  {
+    mcache = &((struct reader *) rd)->qos_match_cache;
+    mcache_id = ddsi_qos_intern_id (wrqos);
+  }
+  else if (rd->kind == EK_PROXY_READER && wr->kind == EK_WRITER)
+  {
+    mcache = &((struct writer *) wr)->qos_match_cache;
+    mcache_id = ddsi_qos_intern_id (rdqos);
+  }
+
+  bool ret;
 #ifdef DDS_HAS_TYPE_DISCOVERY
-  bool rd_type_lookup, wr_type_lookup;
-  bool ret = qos_match_p (gv, rdqos, wrqos, reason, rd_typeid, wr_typeid, &rd_type_lookup, &wr_type_lookup);
+  bool rd_type_lookup = false, wr_type_lookup = false;
+  if (mcache == NULL || !ddsi_qos_match_cache_lookup (mcache, mcache_id, &ret, reason))
+  {
+    ret = qos_match_p (gv, rdqos, wrqos, reason, rd_typeid, wr_typeid, &rd_type_lookup, &wr_type_lookup);
+    /* a mismatch because of missing type information is not final */
+    if (mcache && !rd_type_lookup && !wr_type_lookup)
+      ddsi_qos_match_cache_insert (mcache, mcache_id, ret, *reason);
+  }
 #else
-  bool ret = qos_match_p (gv, rdqos, wrqos, reason);
+  if (mcache == NULL || !ddsi_qos_match_cache_lookup (mcache, mcache_id, &ret, reason))
+  {
+    ret = qos_match_p (gv, rdqos, wrqos, reason);
+    if (mcache)
+      ddsi_qos_match_cache_insert (mcache, mcache_id, ret, *reason);
+  }
 #endif
   for (int i = 0; i < 2; i++)
     ddsrt_mutex_unlock (locks[i + shift]);
@@ -3058,22 +3126,20 @@ static void generic_do_match (struct entity_common *e, ddsrt_mtime_t tnow, bool
     /* Non-builtins need matching on topics, the local orphan endpoints
        are a bit weird because they reuse the builtin entityids but
        otherwise need to be treated as normal readers */
-    struct match_entities_range_key max;
+    struct entidx_enum_endpoints it;
     const char *tp = entity_topic_name (e);
     EELOGDISC (e, "match_%s_with_%ss(%s "PGUIDFMT") scanning all %ss%s%s\n",
                kindstr[e->kind].full_us, kindstr[mkind].full_us,
                kindstr[e->kind].abbrev, PGUID (e->guid),
                kindstr[mkind].abbrev,
                tp ? " of topic " : "", tp ? tp : "");
-    /* Note: we visit at least all proxies that existed when we called
-       init (with the -- possible -- exception of ones that were
-       deleted between our calling init and our reaching it while
-       enumerating), but we may visit a single proxy reader multiple
-       times. */
-    entidx_enum_init_topic (&it, entidx, mkind, tp, &max);
-    while ((em = entidx_enum_next_max (&it, &max)) != NULL)
+    /* Note: we visit all proxies that existed when we called init
+       (including ones that were deleted between our calling init and
+       our reaching it while enumerating), each of them once. */
+    entidx_enum_endpoints_init (&it, entidx, mkind, e);
+    while ((em = entidx_enum_endpoints_next (&it)) != NULL)
       generic_do_match_connect (e, em, tnow, local);
-    entidx_enum_fini (&it);
+    entidx_enum_endpoints_fini (&it);
   }
   else if (!local)
   {
@@ -3228,18 +3294,16 @@ static void update_proxy_participant_endpoint_matching (struct proxy_participant
     mkind = generic_do_match_mkind (e->kind, false);
     if (!is_builtin_entityid (e->guid.entityid, NN_VENDORID_ECLIPSE))
     {
-      struct entidx_enum it;
+      struct entidx_enum_endpoints it;
       struct entity_common *em;
-      struct match_entities_range_key max;
-      const char *tp = entity_topic_name (e);
 
-      entidx_enum_init_topic(&it, entidx, mkind, tp, &max);
-      while ((em = entidx_enum_next_max (&it, &max)) != NULL)
+      entidx_enum_endpoints_init (&it, entidx, mkind, e);
+      while ((em = entidx_enum_endpoints_next (&it)) != NULL)
       {
         if (&pp->e == get_entity_parent(em))
           generic_do_match_connect (e, em, tnow, false);
       }
-      entidx_enum_fini (&it);
+      entidx_enum_endpoints_fini (&it);
     }
     else
     {
@@ -3265,19 +3329,17 @@ void update_proxy_endpoint_matching (const struct ddsi_domaingv *gv, struct gene
   GVLOGDISC ("update_proxy_endpoint_matching (proxy ep "PGUIDFMT")\n", PGUID (proxy_ep->e.guid));
   enum entity_kind mkind = generic_do_match_mkind (proxy_ep->e.kind, false);
   assert (!is_builtin_entityid (proxy_ep->e.guid.entityid, NN_VENDORID_ECLIPSE));
-  struct entidx_enum it;
+  struct entidx_enum_endpoints it;
   struct entity_common *em;
-  struct match_entities_range_key max;
-  const char *tp = entity_topic_name (&proxy_ep->e);
   ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
 
-  entidx_enum_init_topic (&it, gv->entity_index, mkind, tp, &max);
-  while ((em = entidx_enum_next_max (&it, &max)) != NULL)
+  entidx_enum_endpoints_init (&it, gv->entity_index, mkind, &proxy_ep->e);
+  while ((em = entidx_enum_endpoints_next (&it)) != NULL)
   {
     GVLOGDISC ("match proxy ep "PGUIDFMT" with "PGUIDFMT"\n", PGUID (proxy_ep->e.guid), PGUID (em->guid));
     generic_do_match_connect (&proxy_ep->e, em, tnow, false);
   }
-  entidx_enum_fini (&it);
+  entidx_enum_endpoints_fini (&it);
 }
 
 /* ENDPOINT --------------------------------------------------------- */
@@ -3685,6 +3747,7 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
   wr->num_readers = 0;
   wr->num_reliable_readers = 0;
   wr->num_readers_requesting_keyhash = 0;
+  wr->num_content_filtered_readers = 0;
   wr->num_acks_received = 0;
   wr->num_nacks_received = 0;
   wr->throttle_count = 0;
@@ -3717,6 +3780,7 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
   ddsi_xqos_mergein_missing (wr->xqos, &ddsi_default_qos_writer, ~(uint64_t)0);
   assert (wr->xqos->aliased == 0);
   set_topic_type_name (wr->xqos, topic_name, type->type_name);
+  ddsi_qos_match_cache_init (&wr->qos_match_cache);
 
   ELOGDISC (wr, "WRITER "PGUIDFMT" QOS={", PGUID (wr->e.guid));
   ddsi_xqos_log (DDS_LC_DISCOVERY, &wr->e.gv->logconfig, wr->xqos);
@@ -3745,6 +3809,7 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
     ((wr->e.guid.entityid.u & NN_ENTITYID_KIND_MASK) == NN_ENTITYID_KIND_WRITER_WITH_KEY);
   wr->type = ddsi_sertype_ref (type);
   wr->as = new_addrset ();
+  wr->wras_cache = ddsi_wraddrset_cache_new ();
   wr->as_group = NULL;
 
 #ifdef DDS_HAS_NETWORK_PARTITIONS
@@ -3804,7 +3869,8 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
   }
 #endif
 
-  /* for non-builtin writers, select the eventqueue based on the channel it is mapped to */
+  /* for non-builtin writers, select the eventqueue based on the channel it is mapped to,
+     or else distribute them over the event queues based on the GUID */
 
 #ifdef DDS_HAS_NETWORK_CHANNELS
   if (!is_builtin_entityid (wr->e.guid.entityid, ownvendorid))
@@ -3812,12 +3878,12 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
     struct ddsi_config_channel_listelem *channel = find_channel (&wr->e.gv->config, wr->xqos->transport_priority);
     ELOGDISC (wr, "writer "PGUIDFMT": transport priority %d => channel '%s' priority %d\n",
               PGUID (wr->e.guid), wr->xqos->transport_priority.value, channel->name, channel->priority);
-    wr->evq = channel->evq ? channel->evq : wr->e.gv->xevents;
+    wr->evq = channel->evq ? channel->evq : xeventq_for_guid (wr->e.gv, &wr->e.guid);
   }
   else
 #endif
   {
-    wr->evq = wr->e.gv->xevents;
+    wr->evq = xeventq_for_guid (wr->e.gv, &wr->e.guid);
   }
 
   /* heartbeat event will be deleted when the handler can't find a
@@ -4000,7 +4066,7 @@ struct local_orphan_writer *new_local_orphan_writer (struct ddsi_domaingv *gv, d
 void update_writer_qos (struct writer *wr, const dds_qos_t *xqos)
 {
   ddsrt_mutex_lock (&wr->e.lock);
-  if (update_qos_locked (&wr->e, wr->xqos, xqos, ddsrt_time_wallclock ()))
+  if (update_qos_locked (&wr->e, wr->xqos, &wr->qos_match_cache, xqos, ddsrt_time_wallclock ()))
     sedp_write_writer (wr);
   ddsrt_mutex_unlock (&wr->e.lock);
 }
@@ -4062,6 +4128,7 @@ static void gc_delete_writer (struct gcreq *gcreq)
     unref_addrset (wr->ssm_as);
 #endif
   unref_addrset (wr->as); /* must remain until readers gone (rebuilding of addrset) */
+  ddsi_wraddrset_cache_free (wr->wras_cache);
   ddsi_xqos_fini (wr->xqos);
   ddsrt_free (wr->xqos);
   local_reader_ary_fini (&wr->rdary);
@@ -4330,7 +4397,8 @@ static dds_return_t new_reader_guid
   const struct dds_qos *xqos,
   struct ddsi_rhc *rhc,
   status_cb_t status_cb,
-  void * status_entity
+  void * status_entity,
+  const nn_content_filter_property_t *content_filter
 )
 {
   /* see new_writer_guid for commenets */
@@ -4356,6 +4424,7 @@ static dds_return_t new_reader_guid
   ddsi_xqos_mergein_missing (rd->xqos, &ddsi_default_qos_reader, ~(uint64_t)0);
   assert (rd->xqos->aliased == 0);
   set_topic_type_name (rd->xqos, topic_name, type->type_name);
+  ddsi_qos_match_cache_init (&rd->qos_match_cache);
 
   if (rd->e.gv->logconfig.c.mask & DDS_LC_DISCOVERY)
   {
@@ -4379,6 +4448,12 @@ static dds_return_t new_reader_guid
   rd->request_keyhash = rd->type->request_keyhash;
   rd->ddsi2direct_cb = 0;
   rd->ddsi2direct_cbarg = 0;
+  rd->content_filter = NULL;
+  if (content_filter)
+  {
+    rd->content_filter = ddsrt_malloc (sizeof (*rd->content_filter));
+    ddsi_content_filter_property_copy (rd->content_filter, content_filter);
+  }
   rd->init_acknack_count = 1;
   rd->num_writers = 0;
 #ifdef DDS_HAS_SSM
@@ -4481,7 +4556,8 @@ dds_return_t new_reader
   const struct dds_qos *xqos,
   struct ddsi_rhc * rhc,
   status_cb_t status_cb,
-  void * status_cbarg
+  void * status_cbarg,
+  const nn_content_filter_property_t *content_filter
 )
 {
   dds_return_t rc;
@@ -4491,7 +4567,7 @@ dds_return_t new_reader
   kind = type->typekind_no_key ? NN_ENTITYID_KIND_READER_NO_KEY : NN_ENTITYID_KIND_READER_WITH_KEY;
   if ((rc = pp_allocate_entityid (&rdguid->entityid, kind, pp)) < 0)
     return rc;
-  return new_reader_guid (rd_out, rdguid, group_guid, pp, topic_name, type, xqos, rhc, status_cb, status_cbarg);
+  return new_reader_guid (rd_out, rdguid, group_guid, pp, topic_name, type, xqos, rhc, status_cb, status_cbarg, content_filter);
 }
 
 static void gc_delete_reader (struct gcreq *gcreq)
@@ -4539,6 +4615,11 @@ static void gc_delete_reader (struct gcreq *gcreq)
   }
   ddsi_sertype_unref ((struct ddsi_sertype *) rd->type);
 
+  if (rd->content_filter)
+  {
+    ddsi_content_filter_property_fini (rd->content_filter);
+    ddsrt_free (rd->content_filter);
+  }
   ddsi_xqos_fini (rd->xqos);
   ddsrt_free (rd->xqos);
   endpoint_common_fini (&rd->e, &rd->c);
@@ -4564,7 +4645,7 @@ dds_return_t delete_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *gu
 void update_reader_qos (struct reader *rd, const dds_qos_t *xqos)
 {
   ddsrt_mutex_lock (&rd->e.lock);
-  if (update_qos_locked (&rd->e, rd->xqos, xqos, ddsrt_time_wallclock ()))
+  if (update_qos_locked (&rd->e, rd->xqos, &rd->qos_match_cache, xqos, ddsrt_time_wallclock ()))
     sedp_write_reader (rd);
   ddsrt_mutex_unlock (&rd->e.lock);
 }
@@ -4807,7 +4888,7 @@ static void create_proxy_builtin_endpoint_impl (struct ddsi_domaingv *gv, ddsrt_
   plist->qos.topic_name = dds_string_dup (topic_name);
   plist->qos.present |= QP_TOPIC_NAME;
   if (is_writer_entityid (ep_guid->entityid))
-    new_proxy_writer (gv, ppguid, ep_guid, proxypp->as_meta, plist, gv->builtins_dqueue, gv->xevents, timestamp, 0);
+    new_proxy_writer (gv, ppguid, ep_guid, proxypp->as_meta, plist, builtins_dqueue_for_prefix (gv, &ppguid->prefix), gv->xevents, timestamp, 0);
   else
   {
 #ifdef DDS_HAS_SSM
@@ -5134,9 +5215,11 @@ static void free_proxy_participant(struct proxy_participant *proxypp)
 
 bool new_proxy_participant (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid, uint32_t bes, const struct ddsi_guid *privileged_pp_guid, struct addrset *as_default, struct addrset *as_meta, const ddsi_plist_t *plist, dds_duration_t tlease_dur, nn_vendorid_t vendor, unsigned custom_flags, ddsrt_wctime_t timestamp, seqno_t seq)
 {
-  /* No locking => iff all participants use unique guids, and sedp
-     runs on a single thread, it can't go wrong. FIXME, maybe? The
-     same holds for the other functions for creating entities. */
+  /* No locking => iff all participants use unique guids, and the
+     discovery data for any one participant is processed while holding
+     its discovery lock (see discovery_lock_for_prefix), it can't go
+     wrong. FIXME, maybe? The same holds for the other functions for
+     creating entities. */
   struct proxy_participant *proxypp;
   const bool is_secure = ((bes & NN_DISC_BUILTIN_ENDPOINT_PARTICIPANT_SECURE_ANNOUNCER) != 0);
   assert (!is_secure || (plist->present & PP_IDENTITY_TOKEN));
@@ -5296,7 +5379,7 @@ int update_proxy_participant_plist_locked (struct proxy_participant *proxypp, se
     ddsi_plist_init_empty (new_plist);
     ddsi_plist_mergein_missing (new_plist, datap, pmask, qmask);
     ddsi_plist_mergein_missing (new_plist, &ddsi_default_plist_participant, ~(uint64_t)0, ~(uint64_t)0);
-    (void) update_qos_locked (&proxypp->e, &proxypp->plist->qos, &new_plist->qos, timestamp);
+    (void) update_qos_locked (&proxypp->e, &proxypp->plist->qos, NULL, &new_plist->qos, timestamp);
     ddsi_plist_fini (new_plist);
     ddsrt_free (new_plist);
     proxypp->proxypp_have_spdp = 1;
@@ -5937,7 +6020,7 @@ static int proxy_endpoint_common_init (struct entity_common *e, struct proxy_end
 
   name = (plist->present & PP_ENTITY_NAME) ? plist->entity_name : "";
   entity_common_init (e, proxypp->e.gv, guid, name, kind, tcreate, proxypp->vendor, false);
-  c->xqos = ddsi_xqos_dup (&plist->qos);
+  c->xqos = ddsi_qos_intern_ref (proxypp->e.gv->qos_intern, &plist->qos);
   c->as = ref_addrset (as);
   c->vendor = proxypp->vendor;
   c->seq = seq;
@@ -5966,8 +6049,7 @@ static int proxy_endpoint_common_init (struct entity_common *e, struct proxy_end
 #ifdef DDS_HAS_TYPE_DISCOVERY
     ddsi_tl_meta_proxy_unref (proxypp->e.gv, &c->type_id, guid);
 #endif
-    ddsi_xqos_fini (c->xqos);
-    ddsrt_free (c->xqos);
+    ddsi_qos_intern_unref (proxypp->e.gv->qos_intern, c->xqos);
     unref_addrset (c->as);
     entity_common_fini (e);
     return ret;
@@ -5983,8 +6065,7 @@ static void proxy_endpoint_common_fini (struct entity_common *e, struct proxy_en
   if (c->type != NULL)
     ddsi_sertype_unref ((struct ddsi_sertype *) c->type);
 #endif
-  ddsi_xqos_fini (c->xqos);
-  ddsrt_free (c->xqos);
+  ddsi_qos_intern_unref (e->gv->qos_intern, c->xqos);
   unref_addrset (c->as);
   entity_common_fini (e);
 }
@@ -6120,11 +6201,11 @@ int new_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid,
 
   if (isreliable)
   {
-    pwr->defrag = nn_defrag_new (&gv->logconfig, NN_DEFRAG_DROP_LATEST, gv->config.defrag_reliable_maxsamples);
+    pwr->defrag = nn_defrag_new (&gv->logconfig, NN_DEFRAG_DROP_LATEST, gv->config.defrag_reliable_maxsamples, gv->config.defrag_sample_ring);
   }
   else
   {
-    pwr->defrag = nn_defrag_new (&gv->logconfig, NN_DEFRAG_DROP_OLDEST, gv->config.defrag_unreliable_maxsamples);
+    pwr->defrag = nn_defrag_new (&gv->logconfig, NN_DEFRAG_DROP_OLDEST, gv->config.defrag_unreliable_maxsamples, gv->config.defrag_sample_ring);
   }
   reorder_mode = get_proxy_writer_reorder_mode(pwr->e.guid.entityid, isreliable);
   pwr->reorder = nn_reorder_new (&gv->logconfig, reorder_mode, gv->config.primary_reorder_maxsamples, gv->config.late_ack_mode);
@@ -6195,7 +6276,7 @@ void update_proxy_writer (struct proxy_writer *pwr, seqno_t seq, struct addrset
       }
     }
 
-    (void) update_qos_locked (&pwr->e, pwr->c.xqos, xqos, timestamp);
+    (void) update_proxy_endpoint_qos_locked (&pwr->e, &pwr->c.xqos, xqos, timestamp);
   }
   ddsrt_mutex_unlock (&pwr->e.lock);
 }
@@ -6253,7 +6334,7 @@ void update_proxy_reader (struct proxy_reader *prd, seqno_t seq, struct addrset
       }
     }
 
-    (void) update_qos_locked (&prd->e, prd->c.xqos, xqos, timestamp);
+    (void) update_proxy_endpoint_qos_locked (&prd->e, &prd->c.xqos, xqos, timestamp);
   }
   ddsrt_mutex_unlock (&prd->e.lock);
 }
@@ -6454,6 +6535,16 @@ int new_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid,
   prd->filter = NULL;
 #endif
 
+  /* a content filter is evaluated by the writer only if the filter class is
+     known locally, otherwise the reader gets all data and filters it itself */
+  prd->content_filter = NULL;
+  if ((plist->present & PP_CONTENT_FILTER_PROPERTY) && (prd->content_filter = ddsi_content_filter_new (gv, &plist->content_filter_property)) != NULL)
+  {
+    GVLOGDISC ("new_proxy_reader("PGUIDFMT"): content filter %s \"%s\"\n", PGUID (*guid), prd->content_filter->prop.filter_class_name, prd->content_filter->prop.filter_expression);
+    if (prd->filter == NULL)
+      prd->filter = ddsi_proxy_reader_content_filter;
+  }
+
   /* locking the entity prevents matching while the built-in topic hasn't been published yet */
   ddsrt_mutex_lock (&prd->e.lock);
   entidx_insert_proxy_reader_guid (gv->entity_index, prd);
@@ -6528,6 +6619,9 @@ static void gc_delete_proxy_reader (struct gcreq *gcreq)
 #ifdef DDS_HAS_SECURITY
   q_omg_security_deregister_remote_reader(prd);
 #endif
+  /* no writer references the content filter once all connections are dropped */
+  if (prd->content_filter)
+    ddsi_content_filter_free (prd->content_filter);
   proxy_endpoint_common_fini (&prd->e, &prd->c);
   ddsrt_free (prd);
 }
@@ -62,8 +62,11 @@
 #include "dds/ddsi/ddsi_serdata_pserop.h"
 #include "dds/ddsi/ddsi_serdata_plist.h"
 #include "dds/ddsi/ddsi_security_omg.h"
+#include "dds/ddsi/ddsi_discovery_cache.h"
+#include "dds/ddsi/ddsi_qos_intern.h"
 
 #include "dds/ddsi/ddsi_tkmap.h"
+#include "dds/ddsi/ddsi_content_filter.h"
 #include "dds__whc.h"
 #include "dds/ddsi/ddsi_iid.h"
 
@@ -91,6 +94,25 @@ enum make_uc_sockets_ret {
   MUSRET_ERROR          /* generic error, no use continuing */
 };
 
+static bool use_multiple_receive_threads (const struct ddsi_config *cfg);
+
+static uint32_t n_unicast_recv_threads (const struct ddsi_domaingv *gv)
+{
+  /* Multiple sockets bound to the same unicast data port only make sense if the kernel
+     spreads the incoming datagrams over them (Linux does so by hashing the source and
+     destination addresses) and if each gets its own receive thread */
+#if defined __linux && defined SO_REUSEPORT
+  if (gv->config.unicast_recv_threads > 1 &&
+      (gv->config.transport_selector == DDSI_TRANS_UDP || gv->config.transport_selector == DDSI_TRANS_UDP6) &&
+      gv->config.many_sockets_mode == DDSI_MSM_SINGLE_UNICAST &&
+      use_multiple_receive_threads (&gv->config))
+    return (uint32_t) gv->config.unicast_recv_threads;
+#else
+  (void) gv;
+#endif
+  return 1;
+}
+
 static enum make_uc_sockets_ret make_uc_sockets (struct ddsi_domaingv *gv, uint32_t * pdisc, uint32_t * pdata, int ppid)
 {
   dds_return_t rc;
@@ -121,14 +143,29 @@ static enum make_uc_sockets_ret make_uc_sockets (struct ddsi_domaingv *gv, uint3
     gv->data_conn_uc = gv->disc_conn_uc;
   else
   {
-    rc = ddsi_factory_create_conn (&gv->data_conn_uc, gv->m_factory, *pdata, &qos);
+    /* Port reuse is only enabled for the data port: binding the discovery port still
+       fails if another process already uses this participant index */
+    const uint32_t nshards = n_unicast_recv_threads (gv);
+    const ddsi_tran_qos_t data_qos = { .m_purpose = DDSI_TRAN_QOS_RECV_UC, .m_diffserv = 0, .m_interface = NULL, .m_reuse_port = (nshards > 1) };
+    rc = ddsi_factory_create_conn (&gv->data_conn_uc, gv->m_factory, *pdata, &data_qos);
     if (rc != DDS_RETCODE_OK)
       goto fail_data;
+    for (gv->n_data_conn_uc_extra = 0; gv->n_data_conn_uc_extra + 1 < nshards; gv->n_data_conn_uc_extra++)
+    {
+      rc = ddsi_factory_create_conn (&gv->data_conn_uc_extra[gv->n_data_conn_uc_extra], gv->m_factory, *pdata, &data_qos);
+      if (rc != DDS_RETCODE_OK)
+        goto fail_data_extra;
+    }
   }
   ddsi_conn_locator (gv->disc_conn_uc, &gv->loc_meta_uc);
   ddsi_conn_locator (gv->data_conn_uc, &gv->loc_default_uc);
   return MUSRET_SUCCESS;
 
+fail_data_extra:
+  while (gv->n_data_conn_uc_extra > 0)
+    ddsi_conn_free (gv->data_conn_uc_extra[--gv->n_data_conn_uc_extra]);
+  ddsi_conn_free (gv->data_conn_uc);
+  gv->data_conn_uc = NULL;
 fail_data:
   ddsi_conn_free (gv->disc_conn_uc);
   gv->disc_conn_uc = NULL;
@@ -966,6 +1003,8 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
     gv->recv_threads[i].arg.gv = gv;
     gv->recv_threads[i].arg.u.single.loc = NULL;
     gv->recv_threads[i].arg.u.single.conn = NULL;
+    gv->recv_threads[i].arg.u.many.ws = NULL;
+    gv->recv_threads[i].arg.u.many.conn = NULL;
   }
 
   /* First thread always uses a waitset and gobbles up all sockets not handled by dedicated threads - FIXME: DDSI_MSM_NO_UNICAST mode with UDP probably doesn't even need this one to use a waitset */
@@ -984,7 +1023,7 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
       ddsi_conn_disable_multiplexing (gv->data_conn_mc);
       gv->n_recv_threads++;
     }
-    if (gv->config.many_sockets_mode == DDSI_MSM_SINGLE_UNICAST)
+    if (gv->config.many_sockets_mode == DDSI_MSM_SINGLE_UNICAST && gv->n_data_conn_uc_extra == 0)
     {
       /* No per-participant sockets => handle data unicasts on a separate thread as well */
       gv->recv_threads[gv->n_recv_threads].name = "recvUC";
@@ -994,6 +1033,21 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
       ddsi_conn_disable_multiplexing (gv->data_conn_uc);
       gv->n_recv_threads++;
     }
+    else if (gv->config.many_sockets_mode == DDSI_MSM_SINGLE_UNICAST)
+    {
+      /* Multiple sockets share the unicast data port, one thread for each.  The kernel
+         decides which of them receives a packet, so the trick of sending a packet to
+         wake up the thread doesn't work, but a waitset can be triggered directly */
+      for (uint32_t k = 0; k <= gv->n_data_conn_uc_extra; k++)
+      {
+        struct recv_thread * const rt = &gv->recv_threads[gv->n_recv_threads];
+        (void) snprintf (rt->name_buf, sizeof (rt->name_buf), "recvUC%"PRIu32, k);
+        rt->name = rt->name_buf;
+        rt->arg.mode = RTM_MANY;
+        rt->arg.u.many.conn = (k == 0) ? gv->data_conn_uc : gv->data_conn_uc_extra[k - 1];
+        gv->n_recv_threads++;
+      }
+    }
   }
   assert (gv->n_recv_threads <= MAX_RECV_THREADS);
 
@@ -1003,7 +1057,7 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
     /* We create the rbufpool for the receive thread, and so we'll
        become the initial owner thread. The receive thread will change
        it before it does anything with it. */
-    if ((gv->recv_threads[i].arg.rbpool = nn_rbufpool_new (&gv->logconfig, gv->config.rbuf_size, gv->config.rmsg_chunk_size)) == NULL)
+    if ((gv->recv_threads[i].arg.rbpool = nn_rbufpool_new (&gv->logconfig, gv->config.rbuf_size, gv->config.rmsg_chunk_size, gv->config.zerocopy_receive_max_pinned)) == NULL)
     {
       GVERROR ("rtps_init: can't allocate receive buffer pool for thread %s\n", gv->recv_threads[i].name);
       goto fail;
@@ -1100,6 +1154,10 @@ static void free_conns (struct ddsi_domaingv *gv)
   ddsi_tran_conn_t cs[4 + MAX_XMIT_CONNS] = { gv->disc_conn_mc, gv->data_conn_mc, gv->disc_conn_uc, gv->data_conn_uc };
   for (size_t i = 0; i < MAX_XMIT_CONNS; i++)
     cs[4 + i] = gv->xmit_conns[i];
+  // the additional unicast data sockets are never aliased
+  for (uint32_t i = 0; i < gv->n_data_conn_uc_extra; i++)
+    ddsi_conn_free (gv->data_conn_uc_extra[i]);
+  gv->n_data_conn_uc_extra = 0;
   for (size_t i = 0; i < sizeof (cs) / sizeof (cs[0]); i++)
   {
     if (cs[i] == NULL)
@@ -1326,6 +1384,7 @@ int rtps_init (struct ddsi_domaingv *gv)
 
   gv->disc_conn_uc = NULL;
   gv->data_conn_uc = NULL;
+  gv->n_data_conn_uc_extra = 0;
   gv->disc_conn_mc = NULL;
   gv->data_conn_mc = NULL;
   for (size_t i = 0; i < MAX_XMIT_CONNS; i++)
@@ -1520,6 +1579,7 @@ int rtps_init (struct ddsi_domaingv *gv)
 
   ddsrt_mutex_init (&gv->privileged_pp_lock);
   gv->privileged_pp = NULL;
+  ddsi_content_filter_init_classes (gv);
 
   /* Base participant GUID.  IID initialisation should be from a really good random
      generator and yield almost-unique numbers, and with a fallback of using process
@@ -1558,10 +1618,13 @@ int rtps_init (struct ddsi_domaingv *gv)
 
   ddsrt_mutex_init (&gv->lock);
   ddsrt_mutex_init (&gv->spdp_lock);
-  gv->spdp_defrag = nn_defrag_new (&gv->logconfig, NN_DEFRAG_DROP_OLDEST, gv->config.defrag_unreliable_maxsamples);
+  for (int i = 0; i < gv->config.discovery_threads; i++)
+    ddsrt_mutex_init (&gv->discovery_lock[i]);
+  gv->spdp_defrag = nn_defrag_new (&gv->logconfig, NN_DEFRAG_DROP_OLDEST, gv->config.defrag_unreliable_maxsamples, gv->config.defrag_sample_ring);
   gv->spdp_reorder = nn_reorder_new (&gv->logconfig, NN_REORDER_MODE_ALWAYS_DELIVER, gv->config.primary_reorder_maxsamples, false);
 
   gv->m_tkmap = ddsi_tkmap_new (gv);
+  gv->qos_intern = ddsi_qos_intern_new ();
 
   if (gv->m_factory->m_connless)
   {
@@ -1799,6 +1862,21 @@ int rtps_init (struct ddsi_domaingv *gv)
     0
 #endif
   );
+  gv->n_xevents_extra = (uint32_t) gv->config.xevent_threads - 1;
+  for (uint32_t i = 0; i < gv->n_xevents_extra; i++)
+  {
+    gv->xevents_extra[i] = xeventq_new
+    (
+      gv,
+      gv->config.max_queued_rexmit_bytes,
+      gv->config.max_queued_rexmit_msgs,
+#ifdef DDS_HAS_BANDWIDTH_LIMITING
+      gv->config.auxiliary_bandwidth_limit
+#else
+      0
+#endif
+    );
+  }
 
 #ifdef DDS_HAS_SECURITY
   q_omg_security_init(gv);
@@ -1845,6 +1923,13 @@ int rtps_init (struct ddsi_domaingv *gv)
   ddsrt_mutex_init (&gv->sendq_running_lock);
 
   gv->builtins_dqueue = nn_dqueue_new ("builtins", gv, gv->config.delivery_queue_maxsamples, builtins_dqueue_handler, NULL);
+  gv->n_builtins_dqueues_extra = (uint32_t) gv->config.discovery_threads - 1;
+  for (uint32_t i = 0; i < gv->n_builtins_dqueues_extra; i++)
+  {
+    char name[16];
+    (void) snprintf (name, sizeof (name), "builtins.%"PRIu32, i + 1);
+    gv->builtins_dqueues_extra[i] = nn_dqueue_new (name, gv, gv->config.delivery_queue_maxsamples, builtins_dqueue_handler, NULL);
+  }
 #ifdef DDS_HAS_NETWORK_CHANNELS
   for (struct ddsi_config_channel_listelem *chptr = gv->config.channels; chptr; chptr = chptr->next)
     chptr->dqueue = nn_dqueue_new (chptr->name, &gv->config, gv->config.delivery_queue_maxsamples, user_dqueue_handler, NULL);
@@ -1852,6 +1937,11 @@ int rtps_init (struct ddsi_domaingv *gv)
   gv->user_dqueue = nn_dqueue_new ("user", gv, gv->config.delivery_queue_maxsamples, user_dqueue_handler, NULL);
 #endif
 
+  if (gv->config.discovery_cache_file[0])
+    gv->discovery_cache = ddsi_discovery_cache_new (gv);
+  else
+    gv->discovery_cache = NULL;
+
   if (reset_deaf_mute_time.v < DDS_NEVER)
     qxev_callback (gv->xevents, reset_deaf_mute_time, reset_deaf_mute, gv);
   return 0;
@@ -1877,12 +1967,16 @@ err_network_partition_addrset:
     free_config_networkpartition_addresses (np);
 #endif
 err_unicast_sockets:
+  ddsi_qos_intern_free (gv->qos_intern);
   ddsi_tkmap_free (gv->m_tkmap);
   nn_reorder_free (gv->spdp_reorder);
   nn_defrag_free (gv->spdp_defrag);
+  for (int i = 0; i < gv->config.discovery_threads; i++)
+    ddsrt_mutex_destroy (&gv->discovery_lock[i]);
   ddsrt_mutex_destroy (&gv->spdp_lock);
   ddsrt_mutex_destroy (&gv->lock);
   ddsrt_mutex_destroy (&gv->privileged_pp_lock);
+  ddsi_content_filter_fini_classes (gv);
   entity_index_free (gv->entity_index);
   gv->entity_index = NULL;
   deleted_participants_admin_free (gv->deleted_participants);
@@ -1954,10 +2048,27 @@ static void stop_all_xeventq_upto (struct ddsi_config_channel_listelem *chptr)
 }
 #endif
 
+static void stop_extra_xeventq_upto (struct ddsi_domaingv *gv, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    xeventq_stop (gv->xevents_extra[i]);
+}
+
 int rtps_start (struct ddsi_domaingv *gv)
 {
   if (xeventq_start (gv->xevents, NULL) < 0)
     return -1;
+  for (uint32_t i = 0; i < gv->n_xevents_extra; i++)
+  {
+    char name[16];
+    (void) snprintf (name, sizeof (name), "%"PRIu32, i + 1);
+    if (xeventq_start (gv->xevents_extra[i], name) < 0)
+    {
+      stop_extra_xeventq_upto (gv, i);
+      xeventq_stop (gv->xevents);
+      return -1;
+    }
+  }
 #ifdef DDS_HAS_NETWORK_CHANNELS
   for (struct ddsi_config_channel_listelem *chptr = gv->config.channels; chptr; chptr = chptr->next)
   {
@@ -1966,6 +2077,7 @@ int rtps_start (struct ddsi_domaingv *gv)
       if (xeventq_start (chptr->evq, chptr->name) < 0)
       {
         stop_all_xeventq_upto (chptr);
+        stop_extra_xeventq_upto (gv, gv->n_xevents_extra);
         xeventq_stop (gv->xevents);
         return -1;
       }
@@ -1978,6 +2090,7 @@ int rtps_start (struct ddsi_domaingv *gv)
 #ifdef DDS_HAS_NETWORK_CHANNELS
     stop_all_xeventq_upto (NULL);
 #endif
+    stop_extra_xeventq_upto (gv, gv->n_xevents_extra);
     xeventq_stop (gv->xevents);
     return -1;
   }
@@ -2002,6 +2115,8 @@ int rtps_start (struct ddsi_domaingv *gv)
     }
   }
 
+  if (gv->discovery_cache)
+    restore_discovery_cache (gv);
   return 0;
 }
 
@@ -2015,7 +2130,7 @@ static void builtins_dqueue_ready_cb (void *varg)
 {
   struct dq_builtins_ready_arg *arg = varg;
   ddsrt_mutex_lock (&arg->lock);
-  arg->ready = 1;
+  arg->ready++;
   ddsrt_cond_broadcast (&arg->cond);
   ddsrt_mutex_unlock (&arg->lock);
 }
@@ -2045,7 +2160,10 @@ void rtps_stop (struct ddsi_domaingv *gv)
     ddsi_listener_free(gv->listener);
   }
 
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_stop (gv->discovery_cache);
   xeventq_stop (gv->xevents);
+  stop_extra_xeventq_upto (gv, gv->n_xevents_extra);
 #ifdef DDS_HAS_NETWORK_CHANNELS
   for (chptr = gv->config.channels; chptr; chptr = chptr->next)
   {
@@ -2054,7 +2172,7 @@ void rtps_stop (struct ddsi_domaingv *gv)
   }
 #endif /* DDS_HAS_NETWORK_CHANNELS */
 
-  /* Send a bubble through the delivery queue for built-ins, so that any
+  /* Send a bubble through the delivery queues for built-ins, so that any
      pending proxy participant discovery is finished before we start
      deleting them */
   {
@@ -2063,14 +2181,20 @@ void rtps_stop (struct ddsi_domaingv *gv)
     ddsrt_cond_init (&arg.cond);
     arg.ready = 0;
     nn_dqueue_enqueue_callback(gv->builtins_dqueue, builtins_dqueue_ready_cb, &arg);
+    for (uint32_t i = 0; i < gv->n_builtins_dqueues_extra; i++)
+      nn_dqueue_enqueue_callback(gv->builtins_dqueues_extra[i], builtins_dqueue_ready_cb, &arg);
     ddsrt_mutex_lock (&arg.lock);
-    while (!arg.ready)
+    while (arg.ready < 1 + (int) gv->n_builtins_dqueues_extra)
       ddsrt_cond_wait (&arg.cond, &arg.lock);
     ddsrt_mutex_unlock (&arg.lock);
     ddsrt_cond_destroy (&arg.cond);
     ddsrt_mutex_destroy (&arg.lock);
   }
 
+  /* No more discovery data will be processed: save what we know */
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_write (gv->discovery_cache);
+
   /* Once the receive threads have stopped, defragmentation and
      reorder state can't change anymore, and can be freed safely. */
   nn_reorder_free (gv->spdp_reorder);
@@ -2174,6 +2298,8 @@ void rtps_fini (struct ddsi_domaingv *gv)
   /* No new data gets added to any admin, all synchronous processing
      has ended, so now we can drain the delivery queues to end up with
      the expected reference counts all over the radmin thingummies. */
+  for (uint32_t i = 0; i < gv->n_builtins_dqueues_extra; i++)
+    nn_dqueue_free (gv->builtins_dqueues_extra[i]);
   nn_dqueue_free (gv->builtins_dqueue);
 
 #ifdef DDS_HAS_NETWORK_CHANNELS
@@ -2191,7 +2317,11 @@ void rtps_fini (struct ddsi_domaingv *gv)
   q_omg_security_deinit (gv->security_context);
 #endif
 
+  for (uint32_t i = 0; i < gv->n_xevents_extra; i++)
+    xeventq_free (gv->xevents_extra[i]);
   xeventq_free (gv->xevents);
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_free (gv->discovery_cache);
 
   // if sendq thread is started
   ddsrt_mutex_lock (&gv->sendq_running_lock);
@@ -2249,7 +2379,9 @@ void rtps_fini (struct ddsi_domaingv *gv)
     nn_rbufpool_free (gv->recv_threads[i].arg.rbpool);
   }
 
+  ddsi_qos_intern_free (gv->qos_intern);
   ddsi_tkmap_free (gv->m_tkmap);
+  ddsi_content_filter_fini_classes (gv);
   entity_index_free (gv->entity_index);
   gv->entity_index = NULL;
   deleted_participants_admin_free (gv->deleted_participants);
@@ -2302,6 +2434,8 @@ void rtps_fini (struct ddsi_domaingv *gv)
   ddsi_xqos_fini (&gv->spdp_endpoint_xqos);
   ddsi_plist_fini (&gv->default_local_plist_pp);
 
+  for (int i = 0; i < gv->config.discovery_threads; i++)
+    ddsrt_mutex_destroy (&gv->discovery_lock[i]);
   ddsrt_mutex_destroy (&gv->lock);
 
   while (gv->recvips)
@@ -16,7 +16,7 @@
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/sync.h"
 
-#include "dds/ddsrt/fibheap.h"
+#include "dds/ddsrt/timewheel.h"
 
 #include "dds/ddsi/ddsi_serdata_default.h"
 #include "dds/ddsi/q_protocol.h"
@@ -38,25 +38,17 @@
 #include "dds/ddsi/q_transmit.h"
 #include "dds/ddsi/q_lease.h"
 #include "dds/ddsi/q_gc.h"
+#include "dds/ddsi/ddsi_discovery_cache.h"
 
 /* This is absolute bottom for signed integers, where -x = x and yet x
    != 0 -- and note that it had better be 2's complement machine! */
 #define TSCHED_NOT_ON_HEAP INT64_MIN
 
-const ddsrt_fibheap_def_t lease_fhdef = DDSRT_FIBHEAPDEF_INITIALIZER (offsetof (struct lease, heapnode), compare_lease_tsched);
-
 static void force_lease_check (struct gcreq_queue *gcreq_queue)
 {
   gcreq_enqueue (gcreq_new (gcreq_queue, gcreq_free));
 }
 
-int compare_lease_tsched (const void *va, const void *vb)
-{
-  const struct lease *a = va;
-  const struct lease *b = vb;
-  return (a->tsched.v == b->tsched.v) ? 0 : (a->tsched.v < b->tsched.v) ? -1 : 1;
-}
-
 int compare_lease_tdur (const void *va, const void *vb)
 {
   const struct lease *a = va;
@@ -67,12 +59,12 @@ int compare_lease_tdur (const void *va, const void *vb)
 void lease_management_init (struct ddsi_domaingv *gv)
 {
   ddsrt_mutex_init (&gv->leaseheap_lock);
-  ddsrt_fibheap_init (&lease_fhdef, &gv->leaseheap);
+  ddsrt_timewheel_init (&gv->leasewheel);
 }
 
 void lease_management_term (struct ddsi_domaingv *gv)
 {
-  assert (ddsrt_fibheap_min (&lease_fhdef, &gv->leaseheap) == NULL);
+  ddsrt_timewheel_fini (&gv->leasewheel);
   ddsrt_mutex_destroy (&gv->leaseheap_lock);
 }
 
@@ -113,7 +105,7 @@ void lease_register (struct lease *l) /* FIXME: make lease admin struct */
   if (tend != DDS_NEVER)
   {
     l->tsched.v = tend;
-    ddsrt_fibheap_insert (&lease_fhdef, &gv->leaseheap, l);
+    ddsrt_timewheel_insert (&gv->leasewheel, &l->wheelnode, l->tsched.v);
   }
   ddsrt_mutex_unlock (&gv->leaseheap_lock);
 
@@ -128,7 +120,7 @@ void lease_unregister (struct lease *l)
   ddsrt_mutex_lock (&gv->leaseheap_lock);
   if (l->tsched.v != TSCHED_NOT_ON_HEAP)
   {
-    ddsrt_fibheap_delete (&lease_fhdef, &gv->leaseheap, l);
+    ddsrt_timewheel_delete (&gv->leasewheel, &l->wheelnode);
     l->tsched.v = TSCHED_NOT_ON_HEAP;
   }
   ddsrt_mutex_unlock (&gv->leaseheap_lock);
@@ -193,7 +185,7 @@ void lease_set_expiry (struct lease *l, ddsrt_etime_t when)
     /* moved forward and currently scheduled (by virtue of
        TSCHED_NOT_ON_HEAP == INT64_MIN) */
     l->tsched = when;
-    ddsrt_fibheap_decrease_key (&lease_fhdef, &gv->leaseheap, l);
+    ddsrt_timewheel_update (&gv->leasewheel, &l->wheelnode, l->tsched.v);
     trace_lease_renew (l, "earlier ", when);
     trigger = true;
   }
@@ -201,7 +193,7 @@ void lease_set_expiry (struct lease *l, ddsrt_etime_t when)
   {
     /* not currently scheduled, with a finite new expiry time */
     l->tsched = when;
-    ddsrt_fibheap_insert (&lease_fhdef, &gv->leaseheap, l);
+    ddsrt_timewheel_insert (&gv->leasewheel, &l->wheelnode, l->tsched.v);
     trace_lease_renew (l, "insert ", when);
     trigger = true;
   }
@@ -214,16 +206,17 @@ void lease_set_expiry (struct lease *l, ddsrt_etime_t when)
 
 int64_t check_and_handle_lease_expiration (struct ddsi_domaingv *gv, ddsrt_etime_t tnowE)
 {
-  struct lease *l;
+  ddsrt_timewheel_node_t *twn;
   int64_t delay;
   ddsrt_mutex_lock (&gv->leaseheap_lock);
-  while ((l = ddsrt_fibheap_min (&lease_fhdef, &gv->leaseheap)) != NULL && l->tsched.v <= tnowE.v)
+  while ((twn = ddsrt_timewheel_next_expired (&gv->leasewheel, tnowE.v)) != NULL)
   {
+    struct lease *l = DDSRT_FROM_TIMEWHEEL (struct lease, wheelnode, twn);
     ddsi_guid_t g = l->entity->guid;
     enum entity_kind k = l->entity->kind;
 
     assert (l->tsched.v != TSCHED_NOT_ON_HEAP);
-    ddsrt_fibheap_extract_min (&lease_fhdef, &gv->leaseheap);
+    ddsrt_timewheel_delete (&gv->leasewheel, &l->wheelnode);
     /* only possible concurrent action is to move tend into the future (renew_lease),
        all other operations occur with leaseheap_lock held */
     int64_t tend = (int64_t) ddsrt_atomic_ld64 (&l->tend);
@@ -234,7 +227,7 @@ int64_t check_and_handle_lease_expiration (struct ddsi_domaingv *gv, ddsrt_etime
         l->tsched.v = TSCHED_NOT_ON_HEAP;
       } else {
         l->tsched.v = tend;
-        ddsrt_fibheap_insert (&lease_fhdef, &gv->leaseheap, l);
+        ddsrt_timewheel_insert (&gv->leasewheel, &l->wheelnode, l->tsched.v);
       }
       continue;
     }
@@ -274,7 +267,7 @@ int64_t check_and_handle_lease_expiration (struct ddsi_domaingv *gv, ddsrt_etime
       {
         GVLOGDISC ("but postponing because privileged pp "PGUIDFMT" is still live\n", PGUID (proxypp->privileged_pp_guid));
         l->tsched = ddsrt_etime_add_duration (tnowE, DDS_MSECS (200));
-        ddsrt_fibheap_insert (&lease_fhdef, &gv->leaseheap, l);
+        ddsrt_timewheel_insert (&gv->leasewheel, &l->wheelnode, l->tsched.v);
         continue;
       }
     }
@@ -286,6 +279,8 @@ int64_t check_and_handle_lease_expiration (struct ddsi_domaingv *gv, ddsrt_etime
     {
       case EK_PROXY_PARTICIPANT:
         delete_proxy_participant_by_guid (gv, &g, ddsrt_time_wallclock(), 1);
+        if (gv->discovery_cache)
+          ddsi_discovery_cache_remove (gv->discovery_cache, &g);
         break;
       case EK_PROXY_WRITER:
         proxy_writer_set_notalive ((struct proxy_writer *) l->entity, true);
@@ -303,7 +298,9 @@ int64_t check_and_handle_lease_expiration (struct ddsi_domaingv *gv, ddsrt_etime
     ddsrt_mutex_lock (&gv->leaseheap_lock);
   }
 
-  delay = (l == NULL) ? DDS_INFINITY : (l->tsched.v - tnowE.v);
+  /* the timing wheel only gives a lower bound for the next expiry, waking up
+     early is harmless */
+  delay = ddsrt_timewheel_isempty (&gv->leasewheel) ? DDS_INFINITY : (ddsrt_timewheel_next_time (&gv->leasewheel) - tnowE.v);
   ddsrt_mutex_unlock (&gv->leaseheap_lock);
   return delay;
 }
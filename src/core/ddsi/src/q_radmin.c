@@ -187,6 +187,19 @@
          process (rmsg)
          nn_rmsg_commit (rmsg)
 
+       or, when receiving several messages in one system call:
+
+       while ...
+         n = nn_rmsg_new_batch (rbpool, N, rmsgs)
+         k = recvmmsg (rmsgs[0..n-1].payload, 64kB)
+         for i in 0 .. k-1
+           nn_rmsg_setsize (rmsgs[i], actualsize[i])
+           process (rmsgs[i])
+           nn_rmsg_commit (rmsgs[i])
+         for i in k .. n-1
+           nn_rmsg_commit (rmsgs[i])
+         nn_rmsg_end_batch (rbpool)
+
        ... ensure no references to any buffer in rbpool exist ...
        nn_rbufpool_free (rbpool)
        ...
@@ -282,10 +295,22 @@ struct nn_rbufpool {
      happens anyway. */
   ddsrt_mutex_t lock;
   struct nn_rbuf *current;
+
+  /* One reference for the owner, released by nn_rbufpool_free, and one for
+     each rbuf, because messages pinned by samples (see nn_rmsg_pin) keep
+     their rbuf alive and may well outlive the receive thread and even the
+     domain.  The pool is freed when the last one is released. */
+  ddsrt_atomic_uint32_t refc;
+  struct nn_rbuf *batch_rbuf; /* rbuf of batch in progress, or NULL */
   uint32_t rbuf_size;
   uint32_t max_rmsg_size;
+
+  /* Bytes of received data referenced by samples that live beyond
+     delivery (see nn_rmsg_pin), and the limit on that */
+  ddsrt_atomic_uint32_t pinned_bytes;
+  uint32_t max_pinned_bytes;
   const struct ddsrt_log_cfg *logcfg;
-  bool trace;
+  bool trace; /* cleared by nn_rbufpool_free: logcfg may be gone after that */
 #ifndef NDEBUG
   /* Thread that owns this pool, so we can check that no other thread
      is calling functions only the owner may use. */
@@ -299,9 +324,9 @@ static void nn_rbuf_release (struct nn_rbuf *rbuf);
 #define TRACE_CFG(obj, logcfg, ...) ((obj)->trace ? (void) DDS_CLOG (DDS_LC_RADMIN, (logcfg), __VA_ARGS__) : (void) 0)
 #define TRACE(obj, ...)             TRACE_CFG ((obj), (obj)->logcfg, __VA_ARGS__)
 #define RBPTRACE(...)               TRACE_CFG (rbp, rbp->logcfg, __VA_ARGS__)
-#define RBUFTRACE(...)              TRACE_CFG (rbuf, rbuf->rbufpool->logcfg, __VA_ARGS__)
-#define RMSGTRACE(...)              TRACE_CFG (rmsg, rmsg->chunk.rbuf->rbufpool->logcfg, __VA_ARGS__)
-#define RDATATRACE(rdata, ...)      TRACE_CFG ((rdata)->rmsg, (rdata)->rmsg->chunk.rbuf->rbufpool->logcfg, __VA_ARGS__)
+#define RBUFTRACE(...)              TRACE_CFG (rbuf->rbufpool, rbuf->rbufpool->logcfg, __VA_ARGS__)
+#define RMSGTRACE(...)              TRACE_CFG (rmsg->chunk.rbuf->rbufpool, rmsg->chunk.rbuf->rbufpool->logcfg, __VA_ARGS__)
+#define RDATATRACE(rdata, ...)      TRACE_CFG ((rdata)->rmsg->chunk.rbuf->rbufpool, (rdata)->rmsg->chunk.rbuf->rbufpool->logcfg, __VA_ARGS__)
 
 static uint32_t align_rmsg (uint32_t x)
 {
@@ -336,7 +361,7 @@ static uint32_t max_rmsg_size_w_hdr (uint32_t max_rmsg_size)
     + max_rmsg_size;
 }
 
-struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size)
+struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size, uint32_t max_pinned_bytes)
 {
   struct nn_rbufpool *rbp;
 
@@ -356,9 +381,13 @@ struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_
 #endif
 
   ddsrt_mutex_init (&rbp->lock);
+  ddsrt_atomic_st32 (&rbp->refc, 1);
 
+  rbp->batch_rbuf = NULL;
   rbp->rbuf_size = rbuf_size;
   rbp->max_rmsg_size = max_rmsg_size;
+  ddsrt_atomic_st32 (&rbp->pinned_bytes, 0);
+  rbp->max_pinned_bytes = max_pinned_bytes;
   rbp->logcfg = logcfg;
   rbp->trace = (logcfg->c.mask & DDS_LC_RADMIN) != 0;
 
@@ -387,6 +416,18 @@ void nn_rbufpool_setowner (UNUSED_ARG_NDEBUG (struct nn_rbufpool *rbp), UNUSED_A
 #endif
 }
 
+static void nn_rbufpool_release (struct nn_rbufpool *rbp)
+{
+  if (ddsrt_atomic_dec32_ov (&rbp->refc) == 1)
+  {
+#if USE_VALGRIND
+    VALGRIND_DESTROY_MEMPOOL (rbp);
+#endif
+    ddsrt_mutex_destroy (&rbp->lock);
+    ddsrt_free (rbp);
+  }
+}
+
 void nn_rbufpool_free (struct nn_rbufpool *rbp)
 {
 #if 0
@@ -397,11 +438,10 @@ void nn_rbufpool_free (struct nn_rbufpool *rbp)
   ASSERT_RBUFPOOL_OWNER (rbp);
 #endif
   nn_rbuf_release (rbp->current);
-#if USE_VALGRIND
-  VALGRIND_DESTROY_MEMPOOL (rbp);
-#endif
-  ddsrt_mutex_destroy (&rbp->lock);
-  ddsrt_free (rbp);
+  /* Pinned messages may still reference it, but those are released by
+     the application once the logging configuration may be gone */
+  rbp->trace = false;
+  nn_rbufpool_release (rbp);
 }
 
 /* RBUF ---------------------------------------------------------------- */
@@ -411,7 +451,6 @@ struct nn_rbuf {
   uint32_t size;
   uint32_t max_rmsg_size;
   struct nn_rbufpool *rbufpool;
-  bool trace;
 
   /* Allocating sequentially, releasing in random order, not bothering
      to reuse memory as soon as it becomes available again. I think
@@ -419,6 +458,16 @@ struct nn_rbuf {
      approach.  Changes would be confined rmsg_new and rmsg_free. */
   unsigned char *freeptr;
 
+  /* A batch of rmsgs allocated by nn_rmsg_new_batch occupies the
+     fixed-size slots up to batch_end, and freeptr is set beyond the
+     batch while it is being processed so that any other allocations
+     can't overlap it.  Committing a message in the batch advances
+     batch_hwm instead of freeptr, and at the end of the batch freeptr
+     is moved back to batch_hwm if nothing else got allocated in the
+     meantime.  Both are NULL when there is no batch. */
+  unsigned char *batch_end;
+  unsigned char *batch_hwm;
+
   /* to ensure reasonable alignment of raw[] */
   union {
     int64_t l;
@@ -442,11 +491,13 @@ static struct nn_rbuf *nn_rbuf_alloc_new (struct nn_rbufpool *rbp)
 #endif
 
   rb->rbufpool = rbp;
+  ddsrt_atomic_inc32 (&rbp->refc);
   ddsrt_atomic_st32 (&rb->n_live_rmsg_chunks, 1);
   rb->size = rbp->rbuf_size;
   rb->max_rmsg_size = rbp->max_rmsg_size;
   rb->freeptr = rb->raw;
-  rb->trace = rbp->trace;
+  rb->batch_end = NULL;
+  rb->batch_hwm = NULL;
   RBPTRACE ("rbuf_alloc_new(%p) = %p\n", (void *) rbp, (void *) rb);
   return rb;
 }
@@ -474,6 +525,7 @@ static void nn_rbuf_release (struct nn_rbuf *rbuf)
   {
     RBPTRACE ("rbuf_release(%p) free\n", (void *) rbuf);
     ddsrt_free (rbuf);
+    nn_rbufpool_release (rbp);
   }
 }
 
@@ -531,6 +583,15 @@ static void init_rmsg_chunk (struct nn_rmsg_chunk *chunk, struct nn_rbuf *rbuf)
   ddsrt_atomic_inc32 (&rbuf->n_live_rmsg_chunks);
 }
 
+static void init_rmsg (struct nn_rmsg *rmsg, struct nn_rbuf *rbuf)
+{
+  /* Reference to this rmsg, undone by rmsg_commit(). */
+  ddsrt_atomic_st32 (&rmsg->refcount, RMSG_REFCOUNT_UNCOMMITTED_BIAS);
+  /* Initial chunk */
+  init_rmsg_chunk (&rmsg->chunk, rbuf);
+  rmsg->lastchunk = &rmsg->chunk;
+}
+
 struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbp)
 {
   /* Note: only one thread calls nn_rmsg_new on a pool */
@@ -541,18 +602,76 @@ struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbp)
   if (rmsg == NULL)
     return NULL;
 
-  /* Reference to this rmsg, undone by rmsg_commit(). */
-  ddsrt_atomic_st32 (&rmsg->refcount, RMSG_REFCOUNT_UNCOMMITTED_BIAS);
-  /* Initial chunk */
-  init_rmsg_chunk (&rmsg->chunk, rbp->current);
-  rmsg->trace = rbp->trace;
-  rmsg->lastchunk = &rmsg->chunk;
+  init_rmsg (rmsg, rbp->current);
   /* Incrementing freeptr happens in commit(), so that discarding the
      message is really simple. */
   RBPTRACE ("rmsg_new(%p) = %p\n", (void *) rbp, (void *) rmsg);
   return rmsg;
 }
 
+uint32_t nn_rmsg_new_batch (struct nn_rbufpool *rbp, uint32_t n, struct nn_rmsg **rmsgs)
+{
+  /* Note: only one thread calls nn_rmsg_new_batch on a pool; allocates
+     between 1 and n rmsgs in consecutive slots of the current rbuf,
+     or none if out of memory.  Each slot is as large as what
+     nn_rmsg_new reserves, so processing any of these messages is no
+     different from processing a message allocated by nn_rmsg_new. */
+  const uint32_t asize = max_rmsg_size_w_hdr (rbp->max_rmsg_size);
+  const uint32_t stride = align_rmsg (asize);
+  struct nn_rbuf *rb;
+  uint32_t i, k;
+  RBPTRACE ("rmsg_new_batch(%p, %"PRIu32")\n", (void *) rbp, n);
+  ASSERT_RBUFPOOL_OWNER (rbp);
+  assert (n > 0);
+  assert (rbp->batch_rbuf == NULL);
+
+  /* guarantees there is room for at least one */
+  if (nn_rbuf_alloc (rbp) == NULL)
+    return 0;
+  rb = rbp->current;
+  k = (uint32_t) (rb->raw + rb->size - rb->freeptr) / stride;
+  if (k > n)
+    k = n;
+  else if (k == 0)
+    k = 1;
+  for (i = 0; i < k; i++)
+  {
+    rmsgs[i] = (struct nn_rmsg *) (rb->freeptr + i * stride);
+#if USE_VALGRIND
+    if (i > 0)
+      VALGRIND_MEMPOOL_ALLOC (rbp, rmsgs[i], asize);
+#endif
+    init_rmsg (rmsgs[i], rb);
+  }
+  rb->batch_hwm = rb->freeptr;
+  rb->freeptr += (k - 1) * stride + asize;
+  rb->batch_end = rb->freeptr;
+  rbp->batch_rbuf = rb;
+  RBPTRACE ("rmsg_new_batch(%p) = %"PRIu32" x %p\n", (void *) rbp, k, (void *) rmsgs[0]);
+  return k;
+}
+
+void nn_rmsg_end_batch (struct nn_rbufpool *rbp)
+{
+  /* Note: only to be called once all rmsgs in the batch have been
+     committed */
+  struct nn_rbuf *rb = rbp->batch_rbuf;
+  RBPTRACE ("rmsg_end_batch(%p)\n", (void *) rbp);
+  ASSERT_RBUFPOOL_OWNER (rbp);
+  assert (rb != NULL);
+  /* If the rbuf got replaced while processing the batch, it may
+     already have been freed, but in that case it can't be used for
+     allocating anything anymore and there is nothing to reclaim */
+  if (rb == rbp->current)
+  {
+    if (rb->freeptr == rb->batch_end)
+      rb->freeptr = rb->batch_hwm;
+    rb->batch_end = NULL;
+    rb->batch_hwm = NULL;
+  }
+  rbp->batch_rbuf = NULL;
+}
+
 void nn_rmsg_setsize (struct nn_rmsg *rmsg, uint32_t size)
 {
   uint32_t size8P = align_rmsg (size);
@@ -602,8 +721,12 @@ void nn_rmsg_free (struct nn_rmsg *rmsg)
 static void commit_rmsg_chunk (struct nn_rmsg_chunk *chunk)
 {
   struct nn_rbuf *rbuf = chunk->rbuf;
+  unsigned char *end = (unsigned char *) (chunk + 1) + chunk->u.size;
   RBUFTRACE ("commit_rmsg_chunk(%p)\n", (void *) chunk);
-  rbuf->freeptr = (unsigned char *) (chunk + 1) + chunk->u.size;
+  if (rbuf->batch_end == NULL || end > rbuf->batch_end)
+    rbuf->freeptr = end;
+  else if (end > rbuf->batch_hwm)
+    rbuf->batch_hwm = end;
 }
 
 void nn_rmsg_commit (struct nn_rmsg *rmsg)
@@ -626,7 +749,7 @@ void nn_rmsg_commit (struct nn_rmsg *rmsg)
   assert (ddsrt_atomic_ld32 (&rmsg->refcount) >= RMSG_REFCOUNT_UNCOMMITTED_BIAS);
   assert (ddsrt_atomic_ld32 (&rmsg->chunk.rbuf->n_live_rmsg_chunks) > 0);
   assert (ddsrt_atomic_ld32 (&chunk->rbuf->n_live_rmsg_chunks) > 0);
-  assert (chunk->rbuf->rbufpool->current == chunk->rbuf);
+  assert (chunk->rbuf->rbufpool->current == chunk->rbuf || chunk->rbuf->batch_end != NULL);
   if (ddsrt_atomic_sub32_nv (&rmsg->refcount, RMSG_REFCOUNT_UNCOMMITTED_BIAS) == 0)
     nn_rmsg_free (rmsg);
   else
@@ -675,6 +798,38 @@ static void nn_rmsg_unref (struct nn_rmsg *rmsg)
     nn_rmsg_free (rmsg);
 }
 
+bool nn_rmsg_pin (struct nn_rmsg *rmsg, uint32_t size)
+{
+  /* Note: any thread that holds a reference to rmsg may pin it, so
+     typically a delivery thread.  Pinning adds a reference that is
+     independent of the rdatas and the sample pipeline, and counts
+     "size" bytes against the limit of the pool, the idea being that
+     whatever pins a message may hold on to it for a long time,
+     causing the entire rbuf to stay allocated.  The limit is checked
+     against the pool of the first chunk only, but pinned messages
+     will anyway have a single chunk. */
+  struct nn_rbufpool * const rbp = rmsg->chunk.rbuf->rbufpool;
+  uint32_t pinned;
+  assert (ddsrt_atomic_ld32 (&rmsg->refcount) > 0);
+  do {
+    pinned = ddsrt_atomic_ld32 (&rbp->pinned_bytes);
+    if (size > rbp->max_pinned_bytes - pinned)
+      return false;
+  } while (!ddsrt_atomic_cas32 (&rbp->pinned_bytes, pinned, pinned + size));
+  RMSGTRACE ("rmsg_pin(%p, %"PRIu32")\n", (void *) rmsg, size);
+  ddsrt_atomic_inc32 (&rmsg->refcount);
+  return true;
+}
+
+void nn_rmsg_unpin (struct nn_rmsg *rmsg, uint32_t size)
+{
+  struct nn_rbufpool * const rbp = rmsg->chunk.rbuf->rbufpool;
+  RMSGTRACE ("rmsg_unpin(%p, %"PRIu32")\n", (void *) rmsg, size);
+  assert (ddsrt_atomic_ld32 (&rbp->pinned_bytes) >= size);
+  ddsrt_atomic_sub32 (&rbp->pinned_bytes, size);
+  nn_rmsg_unref (rmsg);
+}
+
 void *nn_rmsg_alloc (struct nn_rmsg *rmsg, uint32_t size)
 {
   struct nn_rmsg_chunk *chunk = rmsg->lastchunk;
@@ -857,9 +1012,24 @@ struct nn_rsample {
   } u;
 };
 
+/* Fragmented samples with a sequence number in the window
+   (ring_maxseq - NN_DEFRAG_RING_SIZE, ring_maxseq] are stored in
+   "ring", indexed by sequence number, so that the common case of a
+   few samples being defragmented concurrently doesn't need any tree
+   operations.  Samples that fall out of the window when a new,
+   higher sequence number shows up (say, because a fragment got lost
+   and is being retransmitted) are moved to "sampletree".  The window
+   only moves forward, and so all samples in sampletree always have a
+   lower sequence number than those in the ring. */
+#define NN_DEFRAG_RING_SIZE 32
+
 struct nn_defrag {
   ddsrt_avl_tree_t sampletree;
-  struct nn_rsample *max_sample; /* = max(sampletree) */
+  struct nn_rsample *max_sample; /* = max(ring U sampletree) */
+  seqno_t ring_maxseq; /* remains 0 if the ring is disabled */
+  uint32_t ring_n;
+  bool use_ring;
+  struct nn_rsample *ring[NN_DEFRAG_RING_SIZE];
   uint32_t n_samples;
   uint32_t max_samples;
   enum nn_defrag_drop_mode drop_mode;
@@ -888,7 +1058,7 @@ static int compare_seqno (const void *va, const void *vb)
   return (a == b) ? 0 : (a < b) ? -1 : 1;
 }
 
-struct nn_defrag *nn_defrag_new (const struct ddsrt_log_cfg *logcfg, enum nn_defrag_drop_mode drop_mode, uint32_t max_samples)
+struct nn_defrag *nn_defrag_new (const struct ddsrt_log_cfg *logcfg, enum nn_defrag_drop_mode drop_mode, uint32_t max_samples, bool use_ring)
 {
   struct nn_defrag *d;
   assert (max_samples >= 1);
@@ -899,6 +1069,10 @@ struct nn_defrag *nn_defrag_new (const struct ddsrt_log_cfg *logcfg, enum nn_def
   d->max_samples = max_samples;
   d->n_samples = 0;
   d->max_sample = NULL;
+  d->ring_maxseq = 0;
+  d->ring_n = 0;
+  d->use_ring = use_ring;
+  memset (d->ring, 0, sizeof (d->ring));
   d->discarded_bytes = 0;
   d->logcfg = logcfg;
   d->trace = (logcfg->c.mask & DDS_LC_RADMIN) != 0;
@@ -910,6 +1084,112 @@ void nn_defrag_stats (struct nn_defrag *defrag, uint64_t *discarded_bytes)
   *discarded_bytes = defrag->discarded_bytes;
 }
 
+static bool defrag_in_ring (const struct nn_defrag *defrag, seqno_t seq)
+{
+  return seq <= defrag->ring_maxseq && seq > defrag->ring_maxseq - NN_DEFRAG_RING_SIZE;
+}
+
+static uint32_t defrag_ring_idx (seqno_t seq)
+{
+  assert (seq > 0);
+  return (uint32_t) ((uint64_t) seq % NN_DEFRAG_RING_SIZE);
+}
+
+static struct nn_rsample *defrag_lookup (const struct nn_defrag *defrag, seqno_t seq)
+{
+  if (defrag_in_ring (defrag, seq))
+  {
+    struct nn_rsample * const s = defrag->ring[defrag_ring_idx (seq)];
+    assert (s == NULL || s->u.defrag.seq == seq);
+    return s;
+  }
+  return ddsrt_avl_lookup (&defrag_sampletree_treedef, &defrag->sampletree, &seq);
+}
+
+static void defrag_insert (struct nn_defrag *defrag, struct nn_rsample *sample)
+{
+  const seqno_t seq = sample->u.defrag.seq;
+  if (defrag->use_ring && seq > defrag->ring_maxseq)
+  {
+    /* Move the window forward, pushing the samples that fall out of
+       it into the tree; those are all larger than anything already
+       in the tree */
+    const seqno_t newlo = seq - NN_DEFRAG_RING_SIZE + 1;
+    seqno_t x = defrag->ring_maxseq - NN_DEFRAG_RING_SIZE + 1;
+    if (x < 1)
+      x = 1;
+    for (; x < newlo && x <= defrag->ring_maxseq && defrag->ring_n > 0; x++)
+    {
+      struct nn_rsample ** const slot = &defrag->ring[defrag_ring_idx (x)];
+      if (*slot)
+      {
+        assert ((*slot)->u.defrag.seq == x);
+        TRACE (defrag, "  move sample %"PRId64" from ring to tree\n", x);
+        ddsrt_avl_insert (&defrag_sampletree_treedef, &defrag->sampletree, *slot);
+        *slot = NULL;
+        defrag->ring_n--;
+      }
+    }
+    defrag->ring_maxseq = seq;
+  }
+  if (defrag_in_ring (defrag, seq))
+  {
+    assert (defrag->ring[defrag_ring_idx (seq)] == NULL);
+    defrag->ring[defrag_ring_idx (seq)] = sample;
+    defrag->ring_n++;
+  }
+  else
+  {
+    ddsrt_avl_insert (&defrag_sampletree_treedef, &defrag->sampletree, sample);
+  }
+}
+
+static void defrag_remove (struct nn_defrag *defrag, struct nn_rsample *sample)
+{
+  const seqno_t seq = sample->u.defrag.seq;
+  if (defrag_in_ring (defrag, seq))
+  {
+    assert (defrag->ring[defrag_ring_idx (seq)] == sample);
+    defrag->ring[defrag_ring_idx (seq)] = NULL;
+    defrag->ring_n--;
+  }
+  else
+  {
+    ddsrt_avl_delete (&defrag_sampletree_treedef, &defrag->sampletree, sample);
+  }
+}
+
+static struct nn_rsample *defrag_find_min (const struct nn_defrag *defrag)
+{
+  struct nn_rsample *s;
+  if ((s = ddsrt_avl_find_min (&defrag_sampletree_treedef, &defrag->sampletree)) != NULL || defrag->ring_n == 0)
+    return s;
+  for (seqno_t x = defrag->ring_maxseq - NN_DEFRAG_RING_SIZE + 1; x <= defrag->ring_maxseq; x++)
+    if (x > 0 && (s = defrag->ring[defrag_ring_idx (x)]) != NULL)
+      return s;
+  assert (0);
+  return NULL;
+}
+
+static struct nn_rsample *defrag_find_max_below (const struct nn_defrag *defrag, seqno_t maxp1)
+{
+  /* maxp1 is an upper bound for the sequence numbers present, which
+     allows skipping the empty slots when the maximum gets removed */
+  struct nn_rsample *s;
+  if (defrag->ring_n == 0)
+    return ddsrt_avl_find_max (&defrag_sampletree_treedef, &defrag->sampletree);
+  for (seqno_t x = (maxp1 <= defrag->ring_maxseq) ? maxp1 - 1 : defrag->ring_maxseq; x > defrag->ring_maxseq - NN_DEFRAG_RING_SIZE && x > 0; x--)
+    if ((s = defrag->ring[defrag_ring_idx (x)]) != NULL)
+      return s;
+  assert (0);
+  return NULL;
+}
+
+static struct nn_rsample *defrag_find_max (const struct nn_defrag *defrag)
+{
+  return defrag_find_max_below (defrag, defrag->ring_maxseq + 1);
+}
+
 void nn_fragchain_adjust_refcount (struct nn_rdata *frag, int adjust)
 {
   RDATATRACE (frag, "fragchain_adjust_refcount(%p, %d)\n", (void *) frag, adjust);
@@ -938,7 +1218,7 @@ static void defrag_rsample_drop (struct nn_defrag *defrag, struct nn_rsample *rs
   ddsrt_avl_iter_t iter;
   struct nn_defrag_iv *iv;
   TRACE (defrag, "  defrag_rsample_drop (%p, %p)\n", (void *) defrag, (void *) rsample);
-  ddsrt_avl_delete (&defrag_sampletree_treedef, &defrag->sampletree, rsample);
+  defrag_remove (defrag, rsample);
   assert (defrag->n_samples > 0);
   defrag->n_samples--;
   for (iv = ddsrt_avl_iter_first (&rsample_defrag_fragtree_treedef, &rsample->u.defrag.fragtree, &iter); iv; iv = ddsrt_avl_iter_next (&iter))
@@ -952,12 +1232,12 @@ static void defrag_rsample_drop (struct nn_defrag *defrag, struct nn_rsample *rs
 void nn_defrag_free (struct nn_defrag *defrag)
 {
   struct nn_rsample *s;
-  s = ddsrt_avl_find_min (&defrag_sampletree_treedef, &defrag->sampletree);
+  s = defrag_find_min (defrag);
   while (s)
   {
     TRACE (defrag, "defrag_free(%p, sample %p seq %"PRId64")\n", (void *) defrag, (void *) s, s->u.defrag.seq);
     defrag_rsample_drop (defrag, s);
-    s = ddsrt_avl_find_min (&defrag_sampletree_treedef, &defrag->sampletree);
+    s = defrag_find_min (defrag);
   }
   assert (defrag->n_samples == 0);
   ddsrt_free (defrag);
@@ -1306,7 +1586,7 @@ static int defrag_limit_samples (struct nn_defrag *defrag, seqno_t seq, seqno_t
       break;
     case NN_DEFRAG_DROP_OLDEST:
       TRACE (defrag, "  drop mode = DROP_OLDEST\n");
-      sample_to_drop = ddsrt_avl_find_min (&defrag_sampletree_treedef, &defrag->sampletree);
+      sample_to_drop = defrag_find_min (defrag);
       assert (sample_to_drop);
       if (seq < sample_to_drop->u.defrag.seq)
       {
@@ -1319,7 +1599,7 @@ static int defrag_limit_samples (struct nn_defrag *defrag, seqno_t seq, seqno_t
   defrag_rsample_drop (defrag, sample_to_drop);
   if (sample_to_drop == defrag->max_sample)
   {
-    defrag->max_sample = ddsrt_avl_find_max (&defrag_sampletree_treedef, &defrag->sampletree);
+    defrag->max_sample = defrag_find_max (defrag);
     *max_seq = defrag->max_sample ? defrag->max_sample->u.defrag.seq : 0;
     TRACE (defrag, "  updating max_sample: now %p %"PRId64"\n",
            (void *) defrag->max_sample, defrag->max_sample ? defrag->max_sample->u.defrag.seq : 0);
@@ -1353,7 +1633,6 @@ struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata
      by adding BIAS to the refcount. */
   struct nn_rsample *sample, *result;
   seqno_t max_seq;
-  ddsrt_avl_ipath_t path;
 
   assert (defrag->n_samples <= defrag->max_samples);
 
@@ -1365,7 +1644,7 @@ struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata
   /* max_seq is used for the fast path, and is 0 when there is no
      last message in 'defrag'. max_seq and max_sample must be
      consistent. Max_sample must be consistent with tree */
-  assert (defrag->max_sample == ddsrt_avl_find_max (&defrag_sampletree_treedef, &defrag->sampletree));
+  assert (defrag->max_sample == defrag_find_max (defrag));
   max_seq = defrag->max_sample ? defrag->max_sample->u.defrag.seq : 0;
   TRACE (defrag, "defrag_rsample(%p, %p [%"PRIu32"..%"PRIu32") msg %p, %p seq %"PRId64" size %"PRIu32") max_seq %p %"PRId64":\n",
          (void *) defrag, (void *) rdata, rdata->min, rdata->maxp1, (void *) rdata->rmsg,
@@ -1385,26 +1664,22 @@ struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata
   }
   else if (sampleinfo->seq > max_seq)
   {
-    /* a node with a key greater than the maximum always is the right
-       child of the old maximum node */
-    /* FIXME: MERGE THIS ONE WITH THE NEXT */
     TRACE (defrag, "  new max sample\n");
-    ddsrt_avl_lookup_ipath (&defrag_sampletree_treedef, &defrag->sampletree, &sampleinfo->seq, &path);
     if ((sample = defrag_rsample_new (rdata, sampleinfo)) == NULL)
       return NULL;
-    ddsrt_avl_insert_ipath (&defrag_sampletree_treedef, &defrag->sampletree, sample, &path);
+    defrag_insert (defrag, sample);
     defrag->max_sample = sample;
     defrag->n_samples++;
     result = NULL;
   }
-  else if ((sample = ddsrt_avl_lookup_ipath (&defrag_sampletree_treedef, &defrag->sampletree, &sampleinfo->seq, &path)) == NULL)
+  else if ((sample = defrag_lookup (defrag, sampleinfo->seq)) == NULL)
   {
     /* a new sequence number, but smaller than the maximum */
     TRACE (defrag, "  new sample less than max\n");
     assert (sampleinfo->seq < max_seq);
     if ((sample = defrag_rsample_new (rdata, sampleinfo)) == NULL)
       return NULL;
-    ddsrt_avl_insert_ipath (&defrag_sampletree_treedef, &defrag->sampletree, sample, &path);
+    defrag_insert (defrag, sample);
     defrag->n_samples++;
     result = NULL;
   }
@@ -1417,23 +1692,23 @@ struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata
 
   if (result != NULL)
   {
-    /* Once completed, remove from defrag sample tree and convert to
-       reorder format. If it is the sample with the maximum sequence in
-       the tree, an update of max_sample is required. */
+    /* Once completed, remove from defrag ring/sample tree and convert
+       to reorder format. If it is the sample with the maximum sequence
+       in the tree, an update of max_sample is required. */
     TRACE (defrag, "  complete\n");
-    ddsrt_avl_delete (&defrag_sampletree_treedef, &defrag->sampletree, result);
+    defrag_remove (defrag, result);
     assert (defrag->n_samples > 0);
     defrag->n_samples--;
     if (result == defrag->max_sample)
     {
-      defrag->max_sample = ddsrt_avl_find_max (&defrag_sampletree_treedef, &defrag->sampletree);
+      defrag->max_sample = defrag_find_max_below (defrag, result->u.defrag.seq);
       TRACE (defrag, "  updating max_sample: now %p %"PRId64"\n",
              (void *) defrag->max_sample, defrag->max_sample ? defrag->max_sample->u.defrag.seq : 0);
     }
     rsample_convert_defrag_to_reorder (result);
   }
 
-  assert (defrag->max_sample == ddsrt_avl_find_max (&defrag_sampletree_treedef, &defrag->sampletree));
+  assert (defrag->max_sample == defrag_find_max (defrag));
   return result;
 }
 
@@ -1449,7 +1724,12 @@ void nn_defrag_notegap (struct nn_defrag *defrag, seqno_t min, seqno_t maxp1)
     defrag_rsample_drop (defrag, s);
     s = s1;
   }
-  defrag->max_sample = ddsrt_avl_find_max (&defrag_sampletree_treedef, &defrag->sampletree);
+  for (uint32_t i = 0; i < NN_DEFRAG_RING_SIZE && defrag->ring_n > 0; i++)
+  {
+    if ((s = defrag->ring[i]) != NULL && s->u.defrag.seq >= min && s->u.defrag.seq < maxp1)
+      defrag_rsample_drop (defrag, s);
+  }
+  defrag->max_sample = defrag_find_max (defrag);
 }
 
 enum nn_defrag_nackmap_result nn_defrag_nackmap (struct nn_defrag *defrag, seqno_t seq, uint32_t maxfragnum, struct nn_fragment_number_set_header *map, uint32_t *mapbits, uint32_t maxsz)
@@ -1458,7 +1738,7 @@ enum nn_defrag_nackmap_result nn_defrag_nackmap (struct nn_defrag *defrag, seqno
   struct nn_defrag_iv *iv;
   uint32_t i, fragsz, nfrags;
   assert (maxsz <= 256);
-  s = ddsrt_avl_lookup (&defrag_sampletree_treedef, &defrag->sampletree, &seq);
+  s = defrag_lookup (defrag, seq);
   if (s == NULL)
   {
     if (maxfragnum == UINT32_MAX)
@@ -1577,7 +1857,12 @@ void nn_defrag_prune (struct nn_defrag *defrag, ddsi_guid_prefix_t *dst, seqno_t
     }
     s = s1;
   }
-  defrag->max_sample = ddsrt_avl_find_max (&defrag_sampletree_treedef, &defrag->sampletree);
+  for (uint32_t i = 0; i < NN_DEFRAG_RING_SIZE && defrag->ring_n > 0; i++)
+  {
+    if ((s = defrag->ring[i]) != NULL && s->u.defrag.seq >= min && guid_prefix_eq (&s->u.defrag.sampleinfo->rst->dst_guid_prefix, dst))
+      defrag_rsample_drop (defrag, s);
+  }
+  defrag->max_sample = defrag_find_max (defrag);
 }
 
 /* REORDER -------------------------------------------------------------
@@ -1656,10 +1941,20 @@ void nn_defrag_prune (struct nn_defrag *defrag, ddsi_guid_prefix_t *dst, seqno_t
    based on the fragment chain instead of the sample.  Example code is
    in the overview comment at the top of this file. */
 
+/* The reorder admin tracks which sequence numbers in [next_seq,
+   next_seq + NN_REORDER_COVERED_BITS) are covered by an interval in
+   sampleivtree in a bitmap indexed by sequence number modulo its size,
+   so that constructing an ACKNACK bitmap is merely copying words out
+   of it rather than walking the tree.  It is updated wherever an
+   interval grows or shrinks, and whenever next_seq advances. */
+#define NN_REORDER_COVERED_BITS NN_SEQUENCE_NUMBER_SET_MAX_BITS
+#define NN_REORDER_COVERED_WORDS (NN_REORDER_COVERED_BITS / 32)
+
 struct nn_reorder {
   ddsrt_avl_tree_t sampleivtree;
   struct nn_rsample *max_sampleiv; /* = max(sampleivtree) */
   seqno_t next_seq;
+  uint32_t covered[NN_REORDER_COVERED_WORDS];
   enum nn_reorder_mode mode;
   uint32_t max_samples;
   uint32_t n_samples;
@@ -1680,6 +1975,7 @@ struct nn_reorder *nn_reorder_new (const struct ddsrt_log_cfg *logcfg, enum nn_r
   ddsrt_avl_init (&reorder_sampleivtree_treedef, &r->sampleivtree);
   r->max_sampleiv = NULL;
   r->next_seq = 1;
+  memset (r->covered, 0, sizeof (r->covered));
   r->mode = mode;
   r->max_samples = max_samples;
   r->n_samples = 0;
@@ -1727,12 +2023,75 @@ void nn_reorder_free (struct nn_reorder *r)
   ddsrt_free (r);
 }
 
+static seqno_t reorder_covered_end (const struct nn_reorder *reorder)
+{
+  if (reorder->next_seq > MAX_SEQ_NUMBER - NN_REORDER_COVERED_BITS)
+    return MAX_SEQ_NUMBER;
+  return reorder->next_seq + NN_REORDER_COVERED_BITS;
+}
+
+static uint32_t reorder_covered_idx (seqno_t seq)
+{
+  return (uint32_t) ((uint64_t) seq % NN_REORDER_COVERED_BITS);
+}
+
+static void reorder_covered_update (struct nn_reorder *reorder, seqno_t min, seqno_t maxp1, bool covered)
+{
+  const seqno_t end = reorder_covered_end (reorder);
+  if (min < reorder->next_seq)
+    min = reorder->next_seq;
+  if (maxp1 > end)
+    maxp1 = end;
+  for (seqno_t seq = min; seq < maxp1; seq++)
+  {
+    const uint32_t idx = reorder_covered_idx (seq);
+    if (covered)
+      nn_bitset_set (NN_REORDER_COVERED_BITS, reorder->covered, idx);
+    else
+      nn_bitset_clear (NN_REORDER_COVERED_BITS, reorder->covered, idx);
+  }
+}
+
+static void reorder_covered_from_tree (struct nn_reorder *reorder, seqno_t min, seqno_t maxp1)
+{
+  /* sets the bits for [min,maxp1) covered by the intervals in the tree,
+     which will typically be none */
+  struct nn_rsample *iv = ddsrt_avl_lookup_pred_eq (&reorder_sampleivtree_treedef, &reorder->sampleivtree, &min);
+  if (iv == NULL)
+    iv = ddsrt_avl_find_min (&reorder_sampleivtree_treedef, &reorder->sampleivtree);
+  else if (iv->u.reorder.maxp1 <= min)
+    iv = ddsrt_avl_find_succ (&reorder_sampleivtree_treedef, &reorder->sampleivtree, iv);
+  for (; iv && iv->u.reorder.min < maxp1; iv = ddsrt_avl_find_succ (&reorder_sampleivtree_treedef, &reorder->sampleivtree, iv))
+    reorder_covered_update (reorder, (iv->u.reorder.min < min) ? min : iv->u.reorder.min, (iv->u.reorder.maxp1 > maxp1) ? maxp1 : iv->u.reorder.maxp1, true);
+}
+
+static void reorder_set_next_seq (struct nn_reorder *reorder, seqno_t seq)
+{
+  /* Sliding the window forward: the bits of sequence numbers dropping
+     out of it get reused for those entering it at the end */
+  const seqno_t old_end = reorder_covered_end (reorder);
+  if (seq < reorder->next_seq || seq >= old_end)
+  {
+    memset (reorder->covered, 0, sizeof (reorder->covered));
+    reorder->next_seq = seq;
+    reorder_covered_from_tree (reorder, seq, reorder_covered_end (reorder));
+  }
+  else
+  {
+    for (seqno_t x = reorder->next_seq; x < seq; x++)
+      nn_bitset_clear (NN_REORDER_COVERED_BITS, reorder->covered, reorder_covered_idx (x));
+    reorder->next_seq = seq;
+    reorder_covered_from_tree (reorder, old_end, reorder_covered_end (reorder));
+  }
+}
+
 static void reorder_add_rsampleiv (struct nn_reorder *reorder, struct nn_rsample *rsample)
 {
   ddsrt_avl_ipath_t path;
   if (ddsrt_avl_lookup_ipath (&reorder_sampleivtree_treedef, &reorder->sampleivtree, &rsample->u.reorder.min, &path) != NULL)
     assert (0);
   ddsrt_avl_insert_ipath (&reorder_sampleivtree_treedef, &reorder->sampleivtree, rsample, &path);
+  reorder_covered_update (reorder, rsample->u.reorder.min, rsample->u.reorder.maxp1, true);
 }
 
 #ifndef NDEBUG
@@ -1860,8 +2219,11 @@ static void delete_last_sample (struct nn_reorder *reorder)
     /* Last sample is in an interval of its own - delete it, and
        recalc max_sampleiv. */
     TRACE (reorder, "  delete_last_sample: in singleton interval\n");
-    reorder->discarded_bytes += last->sc.first->sampleinfo->size;
+    /* gaps are stored with a null sampleinfo and don't count as discarded data */
+    if (last->sc.first->sampleinfo)
+      reorder->discarded_bytes += last->sc.first->sampleinfo->size;
     fragchain = last->sc.first->fragchain;
+    reorder_covered_update (reorder, last->min, last->maxp1, false);
     ddsrt_avl_delete (&reorder_sampleivtree_treedef, &reorder->sampleivtree, reorder->max_sampleiv);
     reorder->max_sampleiv = ddsrt_avl_find_max (&reorder_sampleivtree_treedef, &reorder->sampleivtree);
     /* No harm done if it the sampleivtree is empty, except that we
@@ -1884,12 +2246,25 @@ static void delete_last_sample (struct nn_reorder *reorder)
       pe = e;
       e = e->next;
     } while (e != last->sc.last);
-    reorder->discarded_bytes += e->sampleinfo->size;
+    const seqno_t old_maxp1 = last->maxp1;
     fragchain = e->fragchain;
     pe->next = NULL;
-    assert (pe->sampleinfo->seq + 1 < last->maxp1);
     last->sc.last = pe;
-    last->maxp1--;
+    if (e->sampleinfo == NULL)
+    {
+      /* gaps are stored with a null sampleinfo; all we lose by
+         dropping one is the rdata, the interval remains valid */
+      last->maxp1--;
+    }
+    else
+    {
+      /* a gap can extend the interval beyond the last sample without
+         being stored, so the interval now ends at the dropped sample */
+      reorder->discarded_bytes += e->sampleinfo->size;
+      last->maxp1 = e->sampleinfo->seq;
+    }
+    assert (pe->sampleinfo == NULL || pe->sampleinfo->seq < last->maxp1);
+    reorder_covered_update (reorder, last->maxp1, old_maxp1, false);
     last->n_samples--;
   }
 
@@ -1961,7 +2336,7 @@ nn_reorder_result_t nn_reorder_rsample (struct nn_rsample_chain *sc, struct nn_r
       if (reorder_try_append_and_discard (reorder, rsampleiv, min))
         reorder->max_sampleiv = NULL;
     }
-    reorder->next_seq = s->maxp1;
+    reorder_set_next_seq (reorder, s->maxp1);
     *sc = rsampleiv->u.reorder.sc;
     (*refcount_adjust)++;
     TRACE (reorder, "  return [%"PRId64",%"PRId64")\n", s->min, s->maxp1);
@@ -2018,6 +2393,7 @@ nn_reorder_result_t nn_reorder_rsample (struct nn_rsample_chain *sc, struct nn_r
     if (reorder->n_samples < reorder->max_samples)
     {
       append_rsample_interval (reorder->max_sampleiv, rsampleiv);
+      reorder_covered_update (reorder, s->min, s->maxp1, true);
       reorder->n_samples++;
     }
     else
@@ -2094,6 +2470,7 @@ nn_reorder_result_t nn_reorder_rsample (struct nn_rsample_chain *sc, struct nn_r
       /* grow predeq at end, and maybe append immsucc as well */
       TRACE (reorder, "  growing predeq at end ...\n");
       append_rsample_interval (predeq, rsampleiv);
+      reorder_covered_update (reorder, s->min, s->maxp1, true);
       if (reorder_try_append_and_discard (reorder, predeq, immsucc))
         reorder->max_sampleiv = predeq;
     }
@@ -2107,6 +2484,7 @@ nn_reorder_result_t nn_reorder_rsample (struct nn_rsample_chain *sc, struct nn_r
       immsucc->u.reorder.sc.first = s->sc.first;
       immsucc->u.reorder.min = s->min;
       immsucc->u.reorder.n_samples += s->n_samples;
+      reorder_covered_update (reorder, s->min, s->maxp1, true);
 
       /* delete_last_sample may eventually decide to delete the last
          sample contained in immsucc without checking whether immsucc
@@ -2191,6 +2569,7 @@ static struct nn_rsample *coalesce_intervals_touching_range (struct nn_reorder *
     *valuable = 1;
     s->u.reorder.maxp1 = maxp1;
   }
+  reorder_covered_update (reorder, min, maxp1, true);
   return s;
 }
 
@@ -2222,6 +2601,7 @@ static int reorder_insert_gap (struct nn_reorder *reorder, struct nn_rdata *rdat
   s->u.reorder.maxp1 = maxp1;
   s->u.reorder.n_samples = 1;
   ddsrt_avl_insert_ipath (&reorder_sampleivtree_treedef, &reorder->sampleivtree, s, &path);
+  reorder_covered_update (reorder, min, maxp1, true);
   return 1;
 }
 
@@ -2278,7 +2658,7 @@ nn_reorder_result_t nn_reorder_gap (struct nn_rsample_chain *sc, struct nn_reord
     if (min <= reorder->next_seq)
     {
       TRACE (reorder, "  next expected: %"PRId64"\n", maxp1);
-      reorder->next_seq = maxp1;
+      reorder_set_next_seq (reorder, maxp1);
       res = NN_REORDER_ACCEPT;
     }
     else if (reorder->n_samples == reorder->max_samples &&
@@ -2317,7 +2697,7 @@ nn_reorder_result_t nn_reorder_gap (struct nn_rsample_chain *sc, struct nn_reord
     ddsrt_avl_delete (&reorder_sampleivtree_treedef, &reorder->sampleivtree, coalesced);
     if (coalesced->u.reorder.min <= reorder->next_seq)
       assert (min <= reorder->next_seq);
-    reorder->next_seq = coalesced->u.reorder.maxp1;
+    reorder_set_next_seq (reorder, coalesced->u.reorder.maxp1);
     reorder->max_sampleiv = ddsrt_avl_find_max (&reorder_sampleivtree_treedef, &reorder->sampleivtree);
     TRACE (reorder, "  next expected: %"PRId64"\n", reorder->next_seq);
     *sc = coalesced->u.reorder.sc;
@@ -2380,11 +2760,25 @@ int nn_reorder_wantsample (const struct nn_reorder *reorder, seqno_t seq)
   return (s == NULL || s->u.reorder.maxp1 <= seq);
 }
 
-unsigned nn_reorder_nackmap (const struct nn_reorder *reorder, seqno_t base, seqno_t maxseq, struct nn_sequence_number_set_header *map, uint32_t *mapbits, uint32_t maxsz, int notail)
+#ifndef NDEBUG
+static void reorder_covered_check (const struct nn_reorder *reorder)
 {
-  struct nn_rsample *iv;
-  seqno_t i;
+  /* the incrementally maintained bitmap must match the intervals */
+  const seqno_t end = reorder_covered_end (reorder);
+  struct nn_rsample *iv = ddsrt_avl_find_min (&reorder_sampleivtree_treedef, &reorder->sampleivtree);
+  for (seqno_t seq = reorder->next_seq; seq < end; seq++)
+  {
+    while (iv && iv->u.reorder.maxp1 <= seq)
+      iv = ddsrt_avl_find_succ (&reorder_sampleivtree_treedef, &reorder->sampleivtree, iv);
+    const bool in_iv = (iv != NULL && iv->u.reorder.min <= seq);
+    assert (in_iv == (nn_bitset_isset (NN_REORDER_COVERED_BITS, reorder->covered, reorder_covered_idx (seq)) != 0));
+    (void) in_iv;
+  }
+}
+#endif
 
+unsigned nn_reorder_nackmap (const struct nn_reorder *reorder, seqno_t base, seqno_t maxseq, struct nn_sequence_number_set_header *map, uint32_t *mapbits, uint32_t maxsz, int notail)
+{
   /* reorder->next_seq-1 is the last one we delivered, so the last one
      we ack; maxseq is the latest sample we know exists.  Valid bitmap
      lengths are 1 .. 256, so maxsz must be within that range, except
@@ -2417,31 +2811,41 @@ unsigned nn_reorder_nackmap (const struct nn_reorder *reorder, seqno_t base, seq
     map->numbits = maxsz;
   else
     map->numbits = (uint32_t) (maxseq + 1 - base);
-  nn_bitset_zero (map->numbits, mapbits);
 
-  if ((iv = ddsrt_avl_find_min (&reorder_sampleivtree_treedef, &reorder->sampleivtree)) != NULL)
-    assert (iv->u.reorder.min > base);
-  i = base;
-  while (iv && i < base + map->numbits)
+  /* Everything in [base,next_seq] is missing because no interval can
+     cover it; beyond that the missing ones are those not covered by an
+     interval.  If "notail" is set, missing samples beyond the last
+     interval are not requested. */
+  assert (reorder->max_sampleiv == NULL || reorder->max_sampleiv->u.reorder.min > base);
+#ifndef NDEBUG
+  reorder_covered_check (reorder);
+#endif
+  if (notail)
   {
-    for (; i < base + map->numbits && i < iv->u.reorder.min; i++)
-    {
-      unsigned x = (unsigned) (i - base);
-      nn_bitset_set (map->numbits, mapbits, x);
-    }
-    i = iv->u.reorder.maxp1;
-    iv = ddsrt_avl_find_succ (&reorder_sampleivtree_treedef, &reorder->sampleivtree, iv);
+    const seqno_t tail = reorder->max_sampleiv ? reorder->max_sampleiv->u.reorder.maxp1 : base;
+    if (tail < base + map->numbits)
+      map->numbits = (uint32_t) (tail - base);
   }
-  if (notail && i < base + map->numbits)
-    map->numbits = (unsigned) (i - base);
-  else
+  const uint32_t nwords = (map->numbits + 31) / 32;
+  for (uint32_t k = 0; k < nwords; k++)
   {
-    for (; i < base + map->numbits; i++)
+    const seqno_t seq0 = base + 32 * (seqno_t) k;
+    uint32_t w;
+    if (seq0 + 32 <= reorder->next_seq)
+      w = 0;
+    else
     {
-      unsigned x = (unsigned) (i - base);
-      nn_bitset_set (map->numbits, mapbits, x);
+      const uint32_t pos = reorder_covered_idx (seq0), i = pos / 32, sh = pos % 32;
+      w = reorder->covered[i];
+      if (sh != 0)
+        w = (w << sh) | (reorder->covered[(i + 1) % NN_REORDER_COVERED_WORDS] >> (32 - sh));
+      if (seq0 < reorder->next_seq)
+        w &= ~UINT32_C (0) >> (reorder->next_seq - seq0);
     }
+    mapbits[k] = ~w;
   }
+  if ((map->numbits % 32) != 0)
+    mapbits[nwords - 1] &= ~(~UINT32_C (0) >> (map->numbits % 32));
   return map->numbits;
 }
 
@@ -2452,7 +2856,7 @@ seqno_t nn_reorder_next_seq (const struct nn_reorder *reorder)
 
 void nn_reorder_set_next_seq (struct nn_reorder *reorder, seqno_t seq)
 {
-  reorder->next_seq = seq;
+  reorder_set_next_seq (reorder, seq);
 }
 
 /* DQUEUE -------------------------------------------------------------- */
@@ -2469,8 +2873,20 @@ struct nn_dqueue {
   char *name;
   uint32_t max_samples;
   ddsrt_atomic_uint32_t nof_samples;
+
+  /* Lock-free mode: producers push (reversed) chains onto lf_head with a
+     CAS, the dqueue thread grabs the whole list at once and restores the
+     order.  The lock and condition variable are only used for waking up
+     the dqueue thread once it has given up spinning and set lf_parked. */
+  bool lockfree;
+  ddsrt_atomic_voidp_t lf_head;
+  ddsrt_atomic_uint32_t lf_parked;
+  uint32_t lf_spin;
 };
 
+#define DQUEUE_LF_MIN_SPIN 16
+#define DQUEUE_LF_MAX_SPIN 4096
+
 enum dqueue_elem_kind {
   DQEK_DATA,
   DQEK_GAP,
@@ -2512,6 +2928,57 @@ static enum dqueue_elem_kind dqueue_elem_kind (const struct nn_rsample_chain_ele
     return DQEK_BUBBLE;
 }
 
+static struct nn_rsample_chain_elem *dqueue_lf_take (struct nn_dqueue *q)
+{
+  void *head;
+  do {
+    if ((head = ddsrt_atomic_ldvoidp (&q->lf_head)) == NULL)
+      return NULL;
+  } while (!ddsrt_atomic_casvoidp (&q->lf_head, head, NULL));
+  return head;
+}
+
+static void dqueue_lf_wait (struct nn_dqueue *q, struct nn_rsample_chain *sc)
+{
+  /* Spin for a little while before going to sleep, with the number of
+     attempts adapting to whether spinning helped the previous time */
+  struct nn_rsample_chain_elem *rev;
+  uint32_t spins = 0;
+  bool parked = false;
+  while ((rev = dqueue_lf_take (q)) == NULL)
+  {
+    if (spins < q->lf_spin)
+      spins++;
+    else
+    {
+      ddsrt_mutex_lock (&q->lock);
+      ddsrt_atomic_st32 (&q->lf_parked, 1);
+      ddsrt_atomic_fence ();
+      if (ddsrt_atomic_ldvoidp (&q->lf_head) == NULL)
+        ddsrt_cond_wait (&q->cond, &q->lock);
+      ddsrt_atomic_st32 (&q->lf_parked, 0);
+      ddsrt_mutex_unlock (&q->lock);
+      parked = true;
+    }
+  }
+  if (parked)
+    q->lf_spin = (q->lf_spin / 2 < DQUEUE_LF_MIN_SPIN) ? DQUEUE_LF_MIN_SPIN : q->lf_spin / 2;
+  else if (spins > 0)
+    q->lf_spin = (2 * q->lf_spin > DQUEUE_LF_MAX_SPIN) ? DQUEUE_LF_MAX_SPIN : 2 * q->lf_spin;
+
+  /* The list is in reverse order of enqueueing */
+  struct nn_rsample_chain_elem *fwd = NULL;
+  sc->last = rev;
+  while (rev)
+  {
+    struct nn_rsample_chain_elem * const next = rev->next;
+    rev->next = fwd;
+    fwd = rev;
+    rev = next;
+  }
+  sc->first = fwd;
+}
+
 static uint32_t dqueue_thread (struct nn_dqueue *q)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
@@ -2523,18 +2990,24 @@ static uint32_t dqueue_thread (struct nn_dqueue *q)
   ddsi_guid_t rdguid, *prdguid = NULL;
   uint32_t rdguid_count = 0;
 
-  ddsrt_mutex_lock (&q->lock);
+  if (!q->lockfree)
+    ddsrt_mutex_lock (&q->lock);
   while (keepgoing)
   {
     struct nn_rsample_chain sc;
 
     LOG_THREAD_CPUTIME (&gv->logconfig, next_thread_cputime);
 
-    if (q->sc.first == NULL)
-      ddsrt_cond_wait (&q->cond, &q->lock);
-    sc = q->sc;
-    q->sc.first = q->sc.last = NULL;
-    ddsrt_mutex_unlock (&q->lock);
+    if (q->lockfree)
+      dqueue_lf_wait (q, &sc);
+    else
+    {
+      if (q->sc.first == NULL)
+        ddsrt_cond_wait (&q->cond, &q->lock);
+      sc = q->sc;
+      q->sc.first = q->sc.last = NULL;
+      ddsrt_mutex_unlock (&q->lock);
+    }
 
     thread_state_awake_fixed_domain (ts1);
     while (sc.first)
@@ -2598,9 +3071,11 @@ static uint32_t dqueue_thread (struct nn_dqueue *q)
     }
 
     thread_state_asleep (ts1);
-    ddsrt_mutex_lock (&q->lock);
+    if (!q->lockfree)
+      ddsrt_mutex_lock (&q->lock);
   }
-  ddsrt_mutex_unlock (&q->lock);
+  if (!q->lockfree)
+    ddsrt_mutex_unlock (&q->lock);
   return 0;
 }
 
@@ -2619,6 +3094,10 @@ struct nn_dqueue *nn_dqueue_new (const char *name, const struct ddsi_domaingv *g
   q->handler = handler;
   q->handler_arg = arg;
   q->sc.first = q->sc.last = NULL;
+  q->lockfree = gv->config.lockfree_delivery_queues;
+  ddsrt_atomic_stvoidp (&q->lf_head, NULL);
+  ddsrt_atomic_st32 (&q->lf_parked, 0);
+  q->lf_spin = DQUEUE_LF_MIN_SPIN;
 
   ddsrt_mutex_init (&q->lock);
   ddsrt_cond_init (&q->cond);
@@ -2661,12 +3140,39 @@ static int nn_dqueue_enqueue_locked (struct nn_dqueue *q, struct nn_rsample_chai
   return must_signal;
 }
 
+static int nn_dqueue_enqueue_lf (struct nn_dqueue *q, struct nn_rsample_chain *sc)
+{
+  /* Pushing the chain in reverse order means the entire list is in
+     reverse order, which the dqueue thread can undo in one go */
+  struct nn_rsample_chain_elem *rev = NULL, *e = sc->first;
+  while (e)
+  {
+    struct nn_rsample_chain_elem * const next = e->next;
+    e->next = rev;
+    rev = e;
+    e = next;
+  }
+  assert (rev == sc->last);
+  void *head;
+  do {
+    head = ddsrt_atomic_ldvoidp (&q->lf_head);
+    sc->first->next = head;
+  } while (!ddsrt_atomic_casvoidp (&q->lf_head, head, sc->last));
+  /* CAS is a full barrier, pairs with the fence in dqueue_lf_wait */
+  return ddsrt_atomic_ld32 (&q->lf_parked) != 0;
+}
+
 bool nn_dqueue_enqueue_deferred_wakeup (struct nn_dqueue *q, struct nn_rsample_chain *sc, nn_reorder_result_t rres)
 {
   bool signal;
   assert (rres > 0);
   assert (sc->first);
   assert (sc->last->next == NULL);
+  if (q->lockfree)
+  {
+    ddsrt_atomic_add32 (&q->nof_samples, (uint32_t) rres);
+    return nn_dqueue_enqueue_lf (q, sc);
+  }
   ddsrt_mutex_lock (&q->lock);
   ddsrt_atomic_add32 (&q->nof_samples, (uint32_t) rres);
   signal = nn_dqueue_enqueue_locked (q, sc);
@@ -2686,6 +3192,13 @@ void nn_dqueue_enqueue (struct nn_dqueue *q, struct nn_rsample_chain *sc, nn_reo
   assert (rres > 0);
   assert (sc->first);
   assert (sc->last->next == NULL);
+  if (q->lockfree)
+  {
+    ddsrt_atomic_add32 (&q->nof_samples, (uint32_t) rres);
+    if (nn_dqueue_enqueue_lf (q, sc))
+      dd_dqueue_enqueue_trigger (q);
+    return;
+  }
   ddsrt_mutex_lock (&q->lock);
   ddsrt_atomic_add32 (&q->nof_samples, (uint32_t) rres);
   if (nn_dqueue_enqueue_locked (q, sc))
@@ -2693,18 +3206,33 @@ void nn_dqueue_enqueue (struct nn_dqueue *q, struct nn_rsample_chain *sc, nn_reo
   ddsrt_mutex_unlock (&q->lock);
 }
 
-static int nn_dqueue_enqueue_bubble_locked (struct nn_dqueue *q, struct nn_dqueue_bubble *b)
+static void nn_dqueue_init_bubble (struct nn_dqueue_bubble *b)
 {
-  struct nn_rsample_chain sc;
   b->sce.next = NULL;
   b->sce.fragchain = NULL;
   b->sce.sampleinfo = (struct nn_rsample_info *) b;
+}
+
+static int nn_dqueue_enqueue_bubble_locked (struct nn_dqueue *q, struct nn_dqueue_bubble *b)
+{
+  struct nn_rsample_chain sc;
+  nn_dqueue_init_bubble (b);
   sc.first = sc.last = &b->sce;
   return nn_dqueue_enqueue_locked (q, &sc);
 }
 
 static void nn_dqueue_enqueue_bubble (struct nn_dqueue *q, struct nn_dqueue_bubble *b)
 {
+  if (q->lockfree)
+  {
+    struct nn_rsample_chain sc;
+    nn_dqueue_init_bubble (b);
+    sc.first = sc.last = &b->sce;
+    ddsrt_atomic_inc32 (&q->nof_samples);
+    if (nn_dqueue_enqueue_lf (q, &sc))
+      dd_dqueue_enqueue_trigger (q);
+    return;
+  }
   ddsrt_mutex_lock (&q->lock);
   ddsrt_atomic_inc32 (&q->nof_samples);
   if (nn_dqueue_enqueue_bubble_locked (q, b))
@@ -2735,6 +3263,19 @@ void nn_dqueue_enqueue1 (struct nn_dqueue *q, const ddsi_guid_t *rdguid, struct
   assert (rdguid != NULL);
   assert (sc->first);
   assert (sc->last->next == NULL);
+  if (q->lockfree)
+  {
+    /* bubble and samples must be adjacent in the queue, so push them as one chain */
+    struct nn_rsample_chain bsc;
+    nn_dqueue_init_bubble (b);
+    b->sce.next = sc->first;
+    bsc.first = &b->sce;
+    bsc.last = sc->last;
+    ddsrt_atomic_add32 (&q->nof_samples, 1 + (uint32_t) rres);
+    if (nn_dqueue_enqueue_lf (q, &bsc))
+      dd_dqueue_enqueue_trigger (q);
+    return;
+  }
   ddsrt_mutex_lock (&q->lock);
   ddsrt_atomic_add32 (&q->nof_samples, 1 + (uint32_t) rres);
   if (nn_dqueue_enqueue_bubble_locked (q, b))
@@ -2783,6 +3324,7 @@ void nn_dqueue_free (struct nn_dqueue *q)
 
   join_thread (q->ts);
   assert (q->sc.first == NULL);
+  assert (ddsrt_atomic_ldvoidp (&q->lf_head) == NULL);
   ddsrt_cond_destroy (&q->cond);
   ddsrt_mutex_destroy (&q->lock);
   ddsrt_free (q->name);
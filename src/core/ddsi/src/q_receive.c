@@ -2463,11 +2463,12 @@ static int handle_SPDP (const struct nn_rsample_info *sampleinfo, struct nn_rdat
   struct nn_rdata *fragchain;
   nn_reorder_result_t rres;
   int refc_adjust = 0;
+  struct nn_dqueue * const dqueue = builtins_dqueue_for_prefix (gv, &sampleinfo->rst->src_guid_prefix);
   ddsrt_mutex_lock (&gv->spdp_lock);
   rsample = nn_defrag_rsample (gv->spdp_defrag, rdata, sampleinfo);
   fragchain = nn_rsample_fragchain (rsample);
-  if ((rres = nn_reorder_rsample (&sc, gv->spdp_reorder, rsample, &refc_adjust, nn_dqueue_is_full (gv->builtins_dqueue))) > 0)
-    nn_dqueue_enqueue (gv->builtins_dqueue, &sc, rres);
+  if ((rres = nn_reorder_rsample (&sc, gv->spdp_reorder, rsample, &refc_adjust, nn_dqueue_is_full (dqueue))) > 0)
+    nn_dqueue_enqueue (dqueue, &sc, rres);
   nn_fragchain_adjust_refcount (fragchain, refc_adjust);
   ddsrt_mutex_unlock (&gv->spdp_lock);
   return 0;
@@ -3159,6 +3160,59 @@ malformed:
   return -1;
 }
 
+/* Upper bound to the number of datagrams read from a socket in one go,
+   Internal/ReceiveBatchSize is clamped to this */
+#define MAX_RECV_BATCH_SIZE 64
+
+static bool process_packet (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool, struct nn_rmsg *rmsg, ssize_t sz, const ddsi_locator_t *srcloc)
+{
+  unsigned char *buff = (unsigned char *) NN_RMSG_PAYLOAD (rmsg);
+  Header_t *hdr = (Header_t *) buff;
+
+  if (sz > 0 && !gv->deaf)
+  {
+    nn_rmsg_setsize (rmsg, (uint32_t) sz);
+    assert (thread_is_asleep ());
+
+    if ((size_t)sz < RTPS_MESSAGE_HEADER_SIZE || *(uint32_t *)buff != NN_PROTOCOLID_AS_UINT32)
+    {
+      /* discard packets that are really too small or don't have magic cookie */
+    }
+    else if (hdr->version.major != RTPS_MAJOR || (hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
+    {
+      if ((hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
+        GVTRACE ("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu\n, version mismatch: %d.%d\n",
+                 PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, hdr->version.major, hdr->version.minor);
+      if (DDSI_SC_PEDANTIC_P (gv->config))
+        malformed_packet_received_nosubmsg (gv, buff, sz, "header", hdr->vendorid);
+    }
+    else
+    {
+      hdr->guid_prefix = nn_ntoh_guid_prefix (hdr->guid_prefix);
+
+      if (gv->logconfig.c.mask & DDS_LC_TRACE)
+      {
+        char addrstr[DDSI_LOCSTRLEN];
+        ddsi_locator_to_string(addrstr, sizeof(addrstr), srcloc);
+        GVTRACE ("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu from %s\n",
+                 PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, addrstr);
+      }
+      nn_rtps_msg_state_t res = decode_rtps_message (ts1, gv, &rmsg, &hdr, &buff, &sz, rbpool, conn->m_stream);
+      if (res != NN_RTPS_MSG_STATE_ERROR)
+      {
+        handle_submsg_sequence (ts1, gv, conn, srcloc, ddsrt_time_wallclock (), ddsrt_time_elapsed (), &hdr->guid_prefix, guidprefix, buff, (size_t) sz, buff + RTPS_MESSAGE_HEADER_SIZE, rmsg, res == NN_RTPS_MSG_STATE_ENCODED);
+      }
+      else
+      {
+        /* drop message */
+        sz = 1;
+      }
+    }
+  }
+  nn_rmsg_commit (rmsg);
+  return (sz > 0);
+}
+
 static bool do_packet (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool)
 {
   /* UDP max packet size is 64kB */
@@ -3244,48 +3298,45 @@ static bool do_packet (struct thread_state1 * const ts1, struct ddsi_domaingv *g
     sz = ddsi_conn_read (conn, buff, buff_len, true, &srcloc);
   }
 
-  if (sz > 0 && !gv->deaf)
-  {
-    nn_rmsg_setsize (rmsg, (uint32_t) sz);
-    assert (thread_is_asleep ());
+  return process_packet (ts1, gv, conn, guidprefix, rbpool, rmsg, sz, &srcloc);
+}
 
-    if ((size_t)sz < RTPS_MESSAGE_HEADER_SIZE || *(uint32_t *)buff != NN_PROTOCOLID_AS_UINT32)
-    {
-      /* discard packets that are really too small or don't have magic cookie */
-    }
-    else if (hdr->version.major != RTPS_MAJOR || (hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
-    {
-      if ((hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
-        GVTRACE ("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu\n, version mismatch: %d.%d\n",
-                 PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, hdr->version.major, hdr->version.minor);
-      if (DDSI_SC_PEDANTIC_P (gv->config))
-        malformed_packet_received_nosubmsg (gv, buff, sz, "header", hdr->vendorid);
-    }
-    else
-    {
-      hdr->guid_prefix = nn_ntoh_guid_prefix (hdr->guid_prefix);
+static bool do_packet_batch (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool, uint32_t batch_size)
+{
+  /* Datagram-oriented transports only, UDP max packet size is 64kB */
+  const size_t maxsz = gv->config.rmsg_chunk_size < 65536 ? gv->config.rmsg_chunk_size : 65536;
+  struct nn_rmsg *rmsgs[MAX_RECV_BATCH_SIZE];
+  unsigned char *buffs[MAX_RECV_BATCH_SIZE];
+  ssize_t szs[MAX_RECV_BATCH_SIZE];
+  ddsi_locator_t srclocs[MAX_RECV_BATCH_SIZE];
+  uint32_t n;
+  ssize_t nrecv;
+
+  assert (!conn->m_stream);
+  assert (batch_size <= MAX_RECV_BATCH_SIZE);
+  if ((n = nn_rmsg_new_batch (rbpool, batch_size, rmsgs)) == 0)
+    return false;
+  for (uint32_t i = 0; i < n; i++)
+    buffs[i] = (unsigned char *) NN_RMSG_PAYLOAD (rmsgs[i]);
 
-      if (gv->logconfig.c.mask & DDS_LC_TRACE)
-      {
-        char addrstr[DDSI_LOCSTRLEN];
-        ddsi_locator_to_string(addrstr, sizeof(addrstr), &srcloc);
-        GVTRACE ("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu from %s\n",
-                 PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, addrstr);
-      }
-      nn_rtps_msg_state_t res = decode_rtps_message (ts1, gv, &rmsg, &hdr, &buff, &sz, rbpool, conn->m_stream);
-      if (res != NN_RTPS_MSG_STATE_ERROR)
-      {
-        handle_submsg_sequence (ts1, gv, conn, &srcloc, ddsrt_time_wallclock (), ddsrt_time_elapsed (), &hdr->guid_prefix, guidprefix, buff, (size_t) sz, buff + RTPS_MESSAGE_HEADER_SIZE, rmsg, res == NN_RTPS_MSG_STATE_ENCODED);
-      }
-      else
-      {
-        /* drop message */
-        sz = 1;
-      }
-    }
+  nrecv = ddsi_conn_read_batch (conn, n, buffs, maxsz, szs, srclocs);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    if ((ssize_t) i < nrecv)
+      (void) process_packet (ts1, gv, conn, guidprefix, rbpool, rmsgs[i], szs[i], &srclocs[i]);
+    else
+      nn_rmsg_commit (rmsgs[i]);
   }
-  nn_rmsg_commit (rmsg);
-  return (sz > 0);
+  nn_rmsg_end_batch (rbpool);
+  return (nrecv > 0);
+}
+
+static bool do_packet_maybe_batch (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool, uint32_t batch_size)
+{
+  if (batch_size > 1 && !conn->m_stream && ddsi_conn_supports_read_batch (conn))
+    return do_packet_batch (ts1, gv, conn, guidprefix, rbpool, batch_size);
+  else
+    return do_packet (ts1, gv, conn, guidprefix, rbpool);
 }
 
 struct local_participant_desc
@@ -3439,8 +3490,12 @@ static int recv_thread_waitset_add_conn (os_sockWaitset ws, ddsi_tran_conn_t con
   {
     struct ddsi_domaingv *gv = conn->m_base.gv;
     for (uint32_t i = 0; i < gv->n_recv_threads; i++)
+    {
       if (gv->recv_threads[i].arg.mode == RTM_SINGLE && gv->recv_threads[i].arg.u.single.conn == conn)
         return 0;
+      if (gv->recv_threads[i].arg.mode == RTM_MANY && gv->recv_threads[i].arg.u.many.conn == conn)
+        return 0;
+    }
     return os_sockWaitsetAdd (ws, conn);
   }
 }
@@ -3482,6 +3537,9 @@ uint32_t recv_thread (void *vrecv_thread_arg)
   struct nn_rbufpool *rbpool = recv_thread_arg->rbpool;
   os_sockWaitset waitset = recv_thread_arg->mode == RTM_MANY ? recv_thread_arg->u.many.ws : NULL;
   ddsrt_mtime_t next_thread_cputime = { 0 };
+  const uint32_t batch_size =
+    (gv->config.recv_batch_size == 0) ? 1 :
+    (gv->config.recv_batch_size > MAX_RECV_BATCH_SIZE) ? MAX_RECV_BATCH_SIZE : gv->config.recv_batch_size;
 
   nn_rbufpool_setowner (rbpool, ddsrt_thread_self ());
   if (waitset == NULL)
@@ -3490,7 +3548,7 @@ uint32_t recv_thread (void *vrecv_thread_arg)
     while (ddsrt_atomic_ld32 (&gv->rtps_keepgoing))
     {
       LOG_THREAD_CPUTIME (&gv->logconfig, next_thread_cputime);
-      (void) do_packet (ts1, gv, conn, NULL, rbpool);
+      (void) do_packet_maybe_batch (ts1, gv, conn, NULL, rbpool, batch_size);
     }
   }
   else
@@ -3499,7 +3557,14 @@ uint32_t recv_thread (void *vrecv_thread_arg)
     unsigned num_fixed = 0, num_fixed_uc = 0;
     os_sockWaitsetCtx ctx;
     local_participant_set_init (&lps, &gv->participant_set_generation);
-    if (gv->m_factory->m_connless)
+    if (recv_thread_arg->u.many.conn)
+    {
+      /* dedicated to one of the sockets sharing the unicast data port */
+      if (os_sockWaitsetAdd (waitset, recv_thread_arg->u.many.conn) < 0)
+        DDS_FATAL("recv_thread: failed to add data_conn_uc to waitset\n");
+      num_fixed = 1;
+    }
+    else if (gv->m_factory->m_connless)
     {
       int rc;
       if ((rc = recv_thread_waitset_add_conn (waitset, gv->disc_conn_uc)) < 0)
@@ -3568,7 +3633,7 @@ uint32_t recv_thread (void *vrecv_thread_arg)
           else
             guid_prefix = &lps.ps[(unsigned)idx - num_fixed].guid_prefix;
           /* Process message and clean out connection if failed or closed */
-          if (!do_packet (ts1, gv, conn, guid_prefix, rbpool) && !conn->m_connless)
+          if (!do_packet_maybe_batch (ts1, gv, conn, guid_prefix, rbpool, batch_size) && !conn->m_connless)
             ddsi_conn_free (conn);
         }
       }
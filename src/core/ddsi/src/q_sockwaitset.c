@@ -27,9 +27,12 @@
 #define MODE_KQUEUE 1
 #define MODE_SELECT 2
 #define MODE_WFMEVS 3
+#define MODE_EPOLL 4
 
 #if defined __APPLE__
 #define MODE_SEL MODE_KQUEUE
+#elif defined __linux && !LWIP_SOCKET
+#define MODE_SEL MODE_EPOLL
 #elif defined WINCE
 #define MODE_SEL MODE_WFMEVS
 #else
@@ -283,6 +286,298 @@ int os_sockWaitsetNextEvent (os_sockWaitsetCtx ctx, ddsi_tran_conn_t *conn)
   return -1;
 }
 
+#elif MODE_SEL == MODE_EPOLL
+
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+/* The connections are kept in a dense array, just like the select-based
+   version, so that the indices returned by os_sockWaitsetNextEvent have the
+   same meaning.  Entry 0 is the eventfd used for triggering.  The file
+   descriptors are registered with epoll as they are added and removed, and
+   are mapped back to their index using "fdidx", so that neither waiting nor
+   enumerating the events depends on the number of connections in the set. */
+
+struct os_sockWaitsetCtx
+{
+  struct epoll_event *evs;
+  ddsi_tran_conn_t *conns; /* connections corresponding to evs */
+  int *idxs;               /* index of connections in conns */
+  uint32_t nevs;
+  uint32_t evs_sz;
+  uint32_t index; /* cursor for enumerating */
+};
+
+struct os_sockWaitset
+{
+  int epfd;
+  int evfd; /* eventfd used for triggering */
+  ddsrt_mutex_t lock; /* for add/delete */
+  uint32_t n, sz;
+  ddsi_tran_conn_t *conns;
+  int *fds;
+  int *fdidx; /* fd -> index in conns/fds, or -1 */
+  uint32_t fdidx_sz;
+  struct os_sockWaitsetCtx ctx; /* set of descriptors being handled */
+};
+
+static int epoll_add_fd (os_sockWaitset ws, int fd)
+{
+  struct epoll_event ev;
+  memset (&ev, 0, sizeof (ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  return epoll_ctl (ws->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void epoll_del_fd (os_sockWaitset ws, int fd)
+{
+  /* the socket may already have been closed, in which case the kernel has
+     dropped it from the epoll set, so errors are not interesting */
+  struct epoll_event ev;
+  memset (&ev, 0, sizeof (ev));
+  (void) epoll_ctl (ws->epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+static int lookup_fd_locked (const struct os_sockWaitset *ws, int fd)
+{
+  return ((uint32_t) fd < ws->fdidx_sz) ? ws->fdidx[fd] : -1;
+}
+
+static void set_fdidx_locked (os_sockWaitset ws, int fd, int idx)
+{
+  assert (fd >= 0);
+  if ((uint32_t) fd >= ws->fdidx_sz)
+  {
+    uint32_t newsz = ws->fdidx_sz;
+    while ((uint32_t) fd >= newsz)
+      newsz *= 2;
+    ws->fdidx = ddsrt_realloc (ws->fdidx, newsz * sizeof (*ws->fdidx));
+    for (uint32_t i = ws->fdidx_sz; i < newsz; i++)
+      ws->fdidx[i] = -1;
+    ws->fdidx_sz = newsz;
+  }
+  ws->fdidx[fd] = idx;
+}
+
+static void add_entry_locked (os_sockWaitset ws, ddsi_tran_conn_t conn, int fd)
+{
+  if (ws->n == ws->sz)
+  {
+    ws->sz += WAITSET_DELTA;
+    ws->conns = ddsrt_realloc (ws->conns, ws->sz * sizeof (*ws->conns));
+    ws->fds = ddsrt_realloc (ws->fds, ws->sz * sizeof (*ws->fds));
+  }
+  ws->conns[ws->n] = conn;
+  ws->fds[ws->n] = fd;
+  set_fdidx_locked (ws, fd, (int) ws->n);
+  ws->n++;
+}
+
+os_sockWaitset os_sockWaitsetNew (void)
+{
+  os_sockWaitset ws;
+  if ((ws = ddsrt_malloc (sizeof (*ws))) == NULL)
+    goto fail_waitset;
+  ws->n = 0;
+  ws->sz = WAITSET_DELTA;
+  ws->conns = ddsrt_malloc (ws->sz * sizeof (*ws->conns));
+  ws->fds = ddsrt_malloc (ws->sz * sizeof (*ws->fds));
+  ws->fdidx_sz = 64;
+  ws->fdidx = ddsrt_malloc (ws->fdidx_sz * sizeof (*ws->fdidx));
+  for (uint32_t i = 0; i < ws->fdidx_sz; i++)
+    ws->fdidx[i] = -1;
+  ws->ctx.nevs = 0;
+  ws->ctx.index = 0;
+  ws->ctx.evs_sz = WAITSET_DELTA;
+  ws->ctx.evs = ddsrt_malloc (ws->ctx.evs_sz * sizeof (*ws->ctx.evs));
+  ws->ctx.conns = ddsrt_malloc (ws->ctx.evs_sz * sizeof (*ws->ctx.conns));
+  ws->ctx.idxs = ddsrt_malloc (ws->ctx.evs_sz * sizeof (*ws->ctx.idxs));
+  if ((ws->epfd = epoll_create1 (EPOLL_CLOEXEC)) == -1)
+    goto fail_epoll;
+  if ((ws->evfd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1)
+    goto fail_eventfd;
+  if (epoll_add_fd (ws, ws->evfd) == -1)
+    goto fail_add_trigger;
+  add_entry_locked (ws, NULL, ws->evfd);
+  ddsrt_mutex_init (&ws->lock);
+  return ws;
+
+fail_add_trigger:
+  close (ws->evfd);
+fail_eventfd:
+  close (ws->epfd);
+fail_epoll:
+  ddsrt_free (ws->ctx.idxs);
+  ddsrt_free (ws->ctx.conns);
+  ddsrt_free (ws->ctx.evs);
+  ddsrt_free (ws->fdidx);
+  ddsrt_free (ws->fds);
+  ddsrt_free (ws->conns);
+  ddsrt_free (ws);
+fail_waitset:
+  return NULL;
+}
+
+void os_sockWaitsetFree (os_sockWaitset ws)
+{
+  ddsrt_mutex_destroy (&ws->lock);
+  close (ws->evfd);
+  close (ws->epfd);
+  ddsrt_free (ws->ctx.idxs);
+  ddsrt_free (ws->ctx.conns);
+  ddsrt_free (ws->ctx.evs);
+  ddsrt_free (ws->fdidx);
+  ddsrt_free (ws->fds);
+  ddsrt_free (ws->conns);
+  ddsrt_free (ws);
+}
+
+void os_sockWaitsetTrigger (os_sockWaitset ws)
+{
+  const uint64_t one = 1;
+  if (write (ws->evfd, &one, sizeof (one)) != (ssize_t) sizeof (one) && errno != EAGAIN)
+  {
+    /* EAGAIN means the counter is saturated, and so it has been triggered already */
+    DDS_WARNING("os_sockWaitsetTrigger: write failed on trigger eventfd, errno = %d\n", errno);
+  }
+}
+
+int os_sockWaitsetAdd (os_sockWaitset ws, ddsi_tran_conn_t conn)
+{
+  const int fd = ddsi_conn_handle (conn);
+  int idx, ret;
+  assert (fd >= 0);
+  ddsrt_mutex_lock (&ws->lock);
+  if ((idx = lookup_fd_locked (ws, fd)) > 0 && ws->conns[idx] == conn)
+    ret = 0;
+  else if (idx > 0)
+  {
+    /* file descriptor got reused without the old connection having been removed,
+       closing it will have dropped it from the epoll set */
+    if (epoll_add_fd (ws, fd) == -1 && errno != EEXIST)
+      ret = -1;
+    else
+    {
+      ws->conns[idx] = conn;
+      ret = 1;
+    }
+  }
+  else if (epoll_add_fd (ws, fd) == -1)
+    ret = -1;
+  else
+  {
+    add_entry_locked (ws, conn, fd);
+    ret = 1;
+  }
+  ddsrt_mutex_unlock (&ws->lock);
+  return ret;
+}
+
+void os_sockWaitsetPurge (os_sockWaitset ws, unsigned index)
+{
+  ddsrt_mutex_lock (&ws->lock);
+  for (uint32_t i = index + 1; i < ws->n; i++)
+  {
+    epoll_del_fd (ws, ws->fds[i]);
+    ws->fdidx[ws->fds[i]] = -1;
+    ws->conns[i] = NULL;
+  }
+  if (index + 1 < ws->n)
+    ws->n = index + 1;
+  ddsrt_mutex_unlock (&ws->lock);
+}
+
+void os_sockWaitsetRemove (os_sockWaitset ws, ddsi_tran_conn_t conn)
+{
+  const int fd = ddsi_conn_handle (conn);
+  int idx;
+  assert (fd >= 0);
+  ddsrt_mutex_lock (&ws->lock);
+  if ((idx = lookup_fd_locked (ws, fd)) > 0 && ws->conns[idx] == conn)
+  {
+    epoll_del_fd (ws, fd);
+    ws->fdidx[fd] = -1;
+    ws->n--;
+    if ((uint32_t) idx != ws->n)
+    {
+      ws->fds[idx] = ws->fds[ws->n];
+      ws->conns[idx] = ws->conns[ws->n];
+      ws->fdidx[ws->fds[idx]] = idx;
+    }
+  }
+  ddsrt_mutex_unlock (&ws->lock);
+}
+
+os_sockWaitsetCtx os_sockWaitsetWait (os_sockWaitset ws)
+{
+  /* if the array of events is smaller than the number of file descriptors in the
+     epoll set, things will still work fine, as the kernel will just return what can
+     be stored, and the set will be grown on the next call */
+  os_sockWaitsetCtx ctx = &ws->ctx;
+  int nevs;
+  ddsrt_mutex_lock (&ws->lock);
+  if (ctx->evs_sz < ws->n)
+  {
+    ctx->evs_sz = ws->n;
+    ctx->evs = ddsrt_realloc (ctx->evs, ctx->evs_sz * sizeof (*ctx->evs));
+    ctx->conns = ddsrt_realloc (ctx->conns, ctx->evs_sz * sizeof (*ctx->conns));
+    ctx->idxs = ddsrt_realloc (ctx->idxs, ctx->evs_sz * sizeof (*ctx->idxs));
+  }
+  ddsrt_mutex_unlock (&ws->lock);
+
+  nevs = epoll_wait (ws->epfd, ctx->evs, (int) ctx->evs_sz, -1);
+  if (nevs < 0)
+  {
+    if (errno == EINTR)
+      nevs = 0;
+    else
+    {
+      DDS_WARNING("os_sockWaitsetWait: epoll_wait failed, errno = %d\n", errno);
+      return NULL;
+    }
+  }
+
+  /* map file descriptors to connections & indices, skipping the trigger and any
+     file descriptors that got removed while we were waiting */
+  ctx->nevs = 0;
+  ctx->index = 0;
+  ddsrt_mutex_lock (&ws->lock);
+  for (int i = 0; i < nevs; i++)
+  {
+    const int fd = ctx->evs[i].data.fd;
+    int idx;
+    if (fd == ws->evfd)
+    {
+      uint64_t dummy;
+      if (read (ws->evfd, &dummy, sizeof (dummy)) != (ssize_t) sizeof (dummy) && errno != EAGAIN)
+        DDS_WARNING("os_sockWaitsetWait: read failed on trigger eventfd, errno = %d\n", errno);
+    }
+    else if ((idx = lookup_fd_locked (ws, fd)) > 0)
+    {
+      ctx->conns[ctx->nevs] = ws->conns[idx];
+      ctx->idxs[ctx->nevs] = idx - 1;
+      ctx->nevs++;
+    }
+  }
+  ddsrt_mutex_unlock (&ws->lock);
+  return ctx;
+}
+
+int os_sockWaitsetNextEvent (os_sockWaitsetCtx ctx, ddsi_tran_conn_t *conn)
+{
+  if (ctx->index < ctx->nevs)
+  {
+    const uint32_t idx = ctx->index++;
+    *conn = ctx->conns[idx];
+    return ctx->idxs[idx];
+  }
+  return -1;
+}
+
 #elif MODE_SEL == MODE_WFMEVS
 
 struct os_sockWaitsetCtx
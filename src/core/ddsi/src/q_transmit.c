@@ -38,6 +38,7 @@
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_sertype.h"
 #include "dds/ddsi/ddsi_security_omg.h"
+#include "dds/ddsi/ddsi_content_filter.h"
 
 #include "dds/ddsi/sysdeps.h"
 #include "dds__whc.h"
@@ -499,7 +500,7 @@ static dds_return_t create_fragment_message_simple (struct writer *wr, seqno_t s
   return 0;
 }
 
-dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, uint32_t fragnum, uint16_t nfrags, struct proxy_reader *prd, struct nn_xmsg **pmsg, int isnew, uint32_t advertised_fragnum)
+static dds_return_t create_fragment_message_int (struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, uint32_t fragnum, uint16_t nfrags, struct proxy_reader *prd, bool to_participant, struct nn_xmsg **pmsg, int isnew, uint32_t advertised_fragnum)
 {
   /* We always fragment into FRAGMENT_SIZEd fragments, which are near
      the smallest allowed fragment size & can't be bothered (yet) to
@@ -524,7 +525,7 @@ dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const stru
   enum nn_xmsg_kind xmsg_kind = isnew ? NN_XMSG_KIND_DATA : NN_XMSG_KIND_DATA_REXMIT;
   const uint32_t size = ddsi_serdata_size (serdata);
   dds_return_t ret = 0;
-  (void)plist;
+  (void) plist;
 
   ASSERT_MUTEX_HELD (&wr->e.lock);
 
@@ -614,7 +615,7 @@ dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const stru
   }
 
   ddcmn->extraFlags = 0;
-  ddcmn->readerId = nn_hton_entityid (prd ? prd->e.guid.entityid : to_entityid (NN_ENTITYID_UNKNOWN));
+  ddcmn->readerId = nn_hton_entityid ((prd && !to_participant) ? prd->e.guid.entityid : to_entityid (NN_ENTITYID_UNKNOWN));
   ddcmn->writerId = nn_hton_entityid (wr->e.guid.entityid);
   ddcmn->writerSN = toSN (seq);
 
@@ -664,6 +665,11 @@ dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const stru
   return ret;
 }
 
+dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, uint32_t fragnum, uint16_t nfrags, struct proxy_reader *prd, struct nn_xmsg **pmsg, int isnew, uint32_t advertised_fragnum)
+{
+  return create_fragment_message_int (wr, seq, plist, serdata, fragnum, nfrags, prd, false, pmsg, isnew, advertised_fragnum);
+}
+
 static void create_HeartbeatFrag (struct writer *wr, seqno_t seq, unsigned fragnum, struct proxy_reader *prd, struct nn_xmsg **pmsg)
 {
   struct ddsi_domaingv const * const gv = wr->e.gv;
@@ -904,6 +910,115 @@ int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct dds
   return enqueued ? 0 : -1;
 }
 
+static void content_filtered_add_msg (struct nn_xmsg ***msgs, uint32_t *nmsgs, uint32_t *maxmsgs, struct nn_xmsg *msg)
+{
+  if (msg == NULL)
+    return;
+  if (*nmsgs == *maxmsgs)
+  {
+    *maxmsgs = (*maxmsgs == 0) ? 8 : 2 * *maxmsgs;
+    *msgs = ddsrt_realloc (*msgs, *maxmsgs * sizeof (**msgs));
+  }
+  (*msgs)[(*nmsgs)++] = msg;
+}
+
+static void transmit_sample_content_filtered_unlocks_wr (struct nn_xpack *xp, struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata)
+{
+  /* on entry: &wr->e.lock held; on exit: lock no longer held
+
+     Some matched proxy readers have a content filter that we evaluate: if no
+     reader accepts the sample, the reliable ones get a GAP; otherwise each proxy
+     participant with a reader that accepts it or with a reliable reader gets it
+     addressed to the participant (rather than to a specific reader, so it is
+     delivered to all its readers, which filter it locally).  Best-effort readers
+     are always considered to have acknowledged everything, but they do get data.
+
+     Remote participants in the same domain instance share a proxy writer and
+     therefore also its reorder administration, so a GAP sent to one of them
+     means the sample is lost for all of them.  There is no way of telling which
+     ones share a domain instance, hence GAPs are only sent if no one accepts the
+     sample.  Messages are created with the lock held but only queued once it
+     has been released, so plist remains valid even if the WHC owns it. */
+  struct ddsi_domaingv * const gv = wr->e.gv;
+  const uint32_t sz = ddsi_serdata_size (serdata);
+  const uint32_t nfrags = (sz == 0) ? 1 : (sz + gv->config.fragment_size - 1) / gv->config.fragment_size;
+  struct nn_xmsg **msgs = NULL;
+  uint32_t nmsgs = 0, maxmsgs = 0;
+  struct ppfilter { const struct wr_prd_match *m; bool accept; } *pps = NULL;
+  uint32_t npps = 0, maxpps = 0;
+  bool accept_any = false;
+  bool data_queued = false;
+  void *sample = NULL;
+
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  const struct wr_prd_match *m = ddsrt_avl_find_min (&wr_readers_treedef, &wr->readers);
+  while (m)
+  {
+    if (npps == maxpps)
+    {
+      maxpps = (maxpps == 0) ? 8 : 2 * maxpps;
+      pps = ddsrt_realloc (pps, maxpps * sizeof (*pps));
+    }
+    pps[npps].m = m;
+    pps[npps].accept = ddsi_content_filter_next_participant (wr, &m, serdata, &sample);
+    accept_any = accept_any || pps[npps].accept;
+    npps++;
+  }
+  ddsi_content_filter_free_sample (wr, sample);
+
+  for (uint32_t k = 0; k < npps; k++)
+  {
+    const struct wr_prd_match * const mend = (k + 1 < npps) ? pps[k + 1].m : NULL;
+    for (const struct wr_prd_match *mi = pps[k].m; mi != mend; mi = ddsrt_avl_find_succ (&wr_readers_treedef, &wr->readers, mi))
+    {
+      struct proxy_reader *prd;
+      if ((prd = entidx_lookup_proxy_reader_guid (gv->entity_index, &mi->prd_guid)) == NULL)
+        continue;
+      if (accept_any)
+      {
+        if (!(pps[k].accept || mi->is_reliable))
+          continue;
+        for (uint32_t i = 0; i < nfrags; i++)
+        {
+          struct nn_xmsg *fmsg = NULL;
+          if (create_fragment_message_int (wr, seq, plist, serdata, i, 1, prd, true, &fmsg, 1, (i + 1) == nfrags ? i : UINT32_MAX) >= 0)
+            content_filtered_add_msg (&msgs, &nmsgs, &maxmsgs, fmsg);
+        }
+        data_queued = true;
+        break;
+      }
+      else if (mi->is_reliable)
+      {
+        struct nn_gap_info gi;
+        nn_gap_info_init (&gi);
+        nn_gap_info_update (gv, &gi, seq);
+        content_filtered_add_msg (&msgs, &nmsgs, &maxmsgs, nn_gap_info_create_gap (wr, prd, &gi));
+      }
+    }
+  }
+  ddsrt_free (pps);
+
+  /* the sequence number normally gets recorded as transmitted when the data
+     goes out, but if no one gets it, it is never sent */
+  if (!data_queued)
+    writer_update_seq_xmit (wr, seq);
+  if (wr->heartbeat_xevent)
+    writer_hbcontrol_note_asyncwrite (wr, serdata->twrite);
+  if (xp == NULL)
+  {
+    for (uint32_t i = 0; i < nmsgs; i++)
+      qxev_msg (wr->evq, msgs[i]);
+    ddsrt_mutex_unlock (&wr->e.lock);
+  }
+  else
+  {
+    ddsrt_mutex_unlock (&wr->e.lock);
+    for (uint32_t i = 0; i < nmsgs; i++)
+      nn_xpack_addmsg (xp, msgs[i], 0);
+  }
+  ddsrt_free (msgs);
+}
+
 static int insert_sample_in_whc (struct writer *wr, seqno_t seq, struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
 {
   /* returns: < 0 on error, 0 if no need to insert in whc, > 0 if inserted */
@@ -945,6 +1060,9 @@ static int insert_sample_in_whc (struct writer *wr, seqno_t seq, struct ddsi_pli
     if (wr->xqos->lifespan.duration != DDS_INFINITY && (serdata->statusinfo & (NN_STATUSINFO_UNREGISTER | NN_STATUSINFO_DISPOSE)) == 0)
       exp = ddsrt_mtime_add_duration(serdata->twrite, wr->xqos->lifespan.duration);
 #endif
+    /* The WHC holds on to the sample beyond the write operation, so it can't
+       reference the application's memory */
+    ddsi_serdata_detach (serdata);
     res = ((insres = whc_insert (wr->whc, writer_max_drop_seq (wr), seq, exp, plist, serdata, tk)) < 0) ? insres : 1;
 
 #ifdef DDS_HAS_DEADLINE_MISSED
@@ -1302,6 +1420,16 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
       ddsrt_free (plist);
     }
   }
+  else if (wr->num_content_filtered_readers > 0 && !q_omg_writer_is_submessage_protected (wr))
+  {
+    transmit_sample_content_filtered_unlocks_wr (xp, wr, seq, plist, serdata);
+    /* If not actually inserted, WHC didn't take ownership of plist */
+    if (r == 0 && plist != NULL)
+    {
+      ddsi_plist_fini (plist);
+      ddsrt_free (plist);
+    }
+  }
   else
   {
     /* Note the subtlety of enqueueing with the lock held but
@@ -562,6 +562,16 @@ void xeventq_stop (struct xeventq *evq)
   evq->ts = NULL;
 }
 
+struct xeventq *xeventq_for_guid (const struct ddsi_domaingv *gv, const ddsi_guid_t *guid)
+{
+  if (gv->n_xevents_extra == 0 || is_builtin_entityid (guid->entityid, NN_VENDORID_ECLIPSE))
+    return gv->xevents;
+  const uint32_t h0 = guid->prefix.u[0] ^ guid->prefix.u[1] ^ guid->prefix.u[2] ^ guid->entityid.u;
+  const uint32_t h = (uint32_t) (((uint64_t) h0 * UINT64_C (16292676669999574021)) >> 32);
+  const uint32_t idx = h % (gv->n_xevents_extra + 1);
+  return (idx == 0) ? gv->xevents : gv->xevents_extra[idx - 1];
+}
+
 void xeventq_free (struct xeventq *evq)
 {
   struct xevent *ev;
@@ -1277,6 +1277,87 @@ static void nn_xpack_send1v (const ddsi_xlocator_t *loc, void * varg)
   (void) nn_xpack_send1 (loc, varg);
 }
 
+/* Sending a packet to several destinations with a single call: the locators are collected
+   from the address set and written out whenever the connection changes or the array is full.
+   The "segsize" allows passing a train of packets of segsize bytes to the transport, for it
+   to use segmentation offload. */
+#define NN_XPACK_MAX_MULTI_DSTS 64
+
+struct nn_xpack_send_multi_arg {
+  struct nn_xpack *xp;
+  size_t niov;
+  const ddsrt_iovec_t *iov;
+  uint32_t segsize;
+  ddsi_tran_conn_t conn;
+  size_t ndst;
+  ddsi_locator_t dsts[NN_XPACK_MAX_MULTI_DSTS];
+};
+
+static bool nn_xpack_may_send_multi (const struct nn_xpack *xp)
+{
+  struct ddsi_domaingv const * const gv = xp->gv;
+  if (!gv->config.send_batching || gv->mute || gv->config.xmit_lossiness > 0)
+    return false;
+#ifdef DDS_HAS_BANDWIDTH_LIMITING
+  if (xp->limiter.bandwidth != NN_BW_UNLIMITED)
+    return false;
+#endif
+#ifdef DDS_HAS_SECURITY
+  if (xp->sec_info.use_rtps_encoding)
+    return false;
+#endif
+  return true;
+}
+
+static void nn_xpack_send_multi_flush (struct nn_xpack_send_multi_arg *arg)
+{
+  if (arg->ndst > 0)
+  {
+    (void) ddsi_conn_write_multi (arg->conn, arg->ndst, arg->dsts, arg->niov, arg->iov, arg->segsize, arg->xp->call_flags);
+    arg->ndst = 0;
+  }
+}
+
+static void nn_xpack_send_multi_add (const ddsi_xlocator_t *loc, void *varg)
+{
+  struct nn_xpack_send_multi_arg * const arg = varg;
+  struct ddsi_domaingv const * const gv = arg->xp->gv;
+
+  if (gv->logconfig.c.mask & DDS_LC_TRACE)
+  {
+    char buf[DDSI_LOCSTRLEN];
+    GVTRACE (" %s", ddsi_xlocator_to_string (buf, sizeof(buf), loc));
+  }
+#ifdef DDS_HAS_SHM
+  if (loc->c.kind == NN_LOCATOR_KIND_SHEM)
+    return;
+#endif
+  if (arg->ndst == NN_XPACK_MAX_MULTI_DSTS || (arg->ndst > 0 && loc->conn != arg->conn))
+    nn_xpack_send_multi_flush (arg);
+  arg->conn = loc->conn;
+  arg->dsts[arg->ndst++] = loc->c;
+}
+
+static size_t nn_xpack_send_multi (struct nn_xpack *xp, size_t niov, const ddsrt_iovec_t *iov, uint32_t segsize)
+{
+  struct nn_xpack_send_multi_arg arg = {
+    .xp = xp, .niov = niov, .iov = iov, .segsize = segsize, .conn = NULL, .ndst = 0
+  };
+  size_t calls;
+  if (xp->dstmode == NN_XMSG_DST_ONE)
+  {
+    nn_xpack_send_multi_add (&xp->dstaddr.loc, &arg);
+    calls = 1;
+  }
+  else
+  {
+    calls = addrset_forall_count (xp->dstaddr.all.as, nn_xpack_send_multi_add, &arg);
+  }
+  nn_xpack_send_multi_flush (&arg);
+  xp->call_flags = 0;
+  return calls;
+}
+
 static void nn_xpack_send_real (struct nn_xpack *xp)
 {
   struct ddsi_domaingv const * const gv = xp->gv;
@@ -1315,7 +1396,10 @@ static void nn_xpack_send_real (struct nn_xpack *xp)
     calls = 0;
     if (xp->dstaddr.all.as)
     {
-      calls = addrset_forall_count (xp->dstaddr.all.as, nn_xpack_send1v, xp);
+      if (nn_xpack_may_send_multi (xp))
+        calls = nn_xpack_send_multi (xp, xp->niov, xp->iov, 0);
+      else
+        calls = addrset_forall_count (xp->dstaddr.all.as, nn_xpack_send1v, xp);
       unref_addrset (xp->dstaddr.all.as);
     }
 
@@ -1343,6 +1427,86 @@ static void nn_xpack_send_real (struct nn_xpack *xp)
 #define SENDQ_HW 10
 #define SENDQ_LW 0
 
+/* Consecutive queued xpacks for the same destinations, all of the same size except possibly
+   the last one, can be sent as a single train using segmentation offload.  That's typically
+   what you get for the fragments of a large sample.  The limits are those of Linux' UDP GSO:
+   at most 64 segments and the whole train must fit in a single (maximum size) datagram. */
+#define NN_XPACK_MAX_TRAIN_LENGTH 64
+#define NN_XPACK_MAX_TRAIN_SIZE 65000
+
+static bool nn_xpack_may_start_train (const struct nn_xpack *xp)
+{
+  struct ddsi_domaingv const * const gv = xp->gv;
+  if (xp->niov == 0 || !nn_xpack_may_send_multi (xp))
+    return false;
+  switch (xp->dstmode)
+  {
+    case NN_XMSG_DST_ONE:
+      return xp->dstaddr.loc.conn->m_gso;
+    case NN_XMSG_DST_ALL:
+      if (xp->dstaddr.all.as == NULL || xp->dstaddr.all.as_group != NULL)
+        return false;
+      for (int i = 0; i < gv->n_interfaces; i++)
+        if (!gv->xmit_conns[i]->m_gso)
+          return false;
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool nn_xpack_train_mayappend (const struct nn_xpack *head, const struct nn_xpack *last, const struct nn_xpack *next, size_t niov, uint32_t size)
+{
+  if (last->msg_len.length != head->msg_len.length)
+    return false;
+  if (next->niov == 0 || next->msg_len.length > head->msg_len.length || next->dstmode != head->dstmode)
+    return false;
+  if (niov + next->niov > NN_XMSG_MAX_MESSAGE_IOVECS || size + next->msg_len.length > NN_XPACK_MAX_TRAIN_SIZE)
+    return false;
+#ifdef DDS_HAS_SECURITY
+  if (next->sec_info.use_rtps_encoding)
+    return false;
+#endif
+  switch (head->dstmode)
+  {
+    case NN_XMSG_DST_ONE:
+      return (next->dstaddr.loc.conn == head->dstaddr.loc.conn &&
+              memcmp (&next->dstaddr.loc.c, &head->dstaddr.loc.c, sizeof (next->dstaddr.loc.c)) == 0);
+    case NN_XMSG_DST_ALL:
+      return next->dstaddr.all.as == head->dstaddr.all.as && next->dstaddr.all.as_group == NULL;
+    default:
+      return false;
+  }
+}
+
+static void nn_xpack_send_train (struct nn_xpack * const *train, size_t ntrain)
+{
+  struct nn_xpack * const xp = train[0];
+  struct ddsi_domaingv * const gv = xp->gv;
+  ddsrt_iovec_t iov[NN_XMSG_MAX_MESSAGE_IOVECS];
+  size_t niov = 0;
+  uint32_t size = 0;
+
+  for (size_t i = 0; i < ntrain; i++)
+  {
+    memcpy (iov + niov, train[i]->iov, train[i]->niov * sizeof (*iov));
+    niov += train[i]->niov;
+    size += train[i]->msg_len.length;
+  }
+  GVTRACE ("nn_xpack_send_train %"PRIuSIZE"x%"PRIu32" [", ntrain, xp->msg_len.length);
+  const size_t calls = nn_xpack_send_multi (xp, niov, iov, xp->msg_len.length);
+  GVTRACE (" ]\n");
+  GVLOG (DDS_LC_TRAFFIC, "traffic-xmit (%lu) %"PRIu32"\n", (unsigned long) calls, size);
+
+  for (size_t i = 0; i < ntrain; i++)
+  {
+    if (train[i]->dstmode == NN_XMSG_DST_ALL)
+      unref_addrset (train[i]->dstaddr.all.as);
+    nn_xmsg_chain_release (gv, &train[i]->included_msgs);
+    nn_xpack_reinit (train[i]);
+  }
+}
+
 static uint32_t nn_xpack_sendq_thread (void *vgv)
 {
   struct ddsi_domaingv *gv = vgv;
@@ -1360,12 +1524,35 @@ static uint32_t nn_xpack_sendq_thread (void *vgv)
     }
     else
     {
+      struct nn_xpack *train[NN_XPACK_MAX_TRAIN_LENGTH];
+      size_t ntrain = 1;
+      train[0] = xp;
       gv->sendq_head = xp->sendq_next;
       if (--gv->sendq_length == SENDQ_LW)
         ddsrt_cond_broadcast (&gv->sendq_cond);
+      if (nn_xpack_may_start_train (xp))
+      {
+        struct nn_xpack *next;
+        size_t niov = xp->niov;
+        uint32_t size = xp->msg_len.length;
+        while (ntrain < NN_XPACK_MAX_TRAIN_LENGTH && (next = gv->sendq_head) != NULL &&
+               nn_xpack_train_mayappend (xp, train[ntrain - 1], next, niov, size))
+        {
+          gv->sendq_head = next->sendq_next;
+          if (--gv->sendq_length == SENDQ_LW)
+            ddsrt_cond_broadcast (&gv->sendq_cond);
+          niov += next->niov;
+          size += next->msg_len.length;
+          train[ntrain++] = next;
+        }
+      }
       ddsrt_mutex_unlock (&gv->sendq_lock);
-      nn_xpack_send_real (xp);
-      nn_xpack_free (xp);
+      if (ntrain == 1)
+        nn_xpack_send_real (xp);
+      else
+        nn_xpack_send_train (train, ntrain);
+      for (size_t i = 0; i < ntrain; i++)
+        nn_xpack_free (train[i]);
       ddsrt_mutex_lock (&gv->sendq_lock);
     }
   }
@@ -0,0 +1,223 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/time.h"
+#include "ColumnsTypes.h"
+
+/* Compares the rate at which samples can be read from a reader when only a few
+   members are of interest: once using dds_read, which deserializes the full
+   sample into an array of structs, and once using dds_read_columns, which only
+   extracts the selected members into an array per member.  "Flat" is a type of
+   which the in-memory and serialized representations are identical, "Mixed" one
+   with a string and a sequence for which the columns have to be located by
+   interpreting the type. */
+
+#define NCOLS 3
+#define MAX_BATCH 4096
+
+struct bench_type {
+  const char *name;
+  const dds_topic_descriptor_t *desc;
+  size_t size;
+  void (*fill) (void *sample, uint32_t i);
+  int32_t (*get_id) (const void *sample);
+  dds_column_t cols[NCOLS];
+};
+
+static void fill_flat (void *vsample, uint32_t i)
+{
+  ColumnsTypes_Flat *s = vsample;
+  memset (s, 0, sizeof (*s));
+  s->id = (int32_t) i;
+  s->seq = (int32_t) i;
+  s->ts = (int64_t) i * 1000;
+  s->v3 = 0.5 * i;
+}
+
+static int32_t get_id_flat (const void *vsample)
+{
+  return ((const ColumnsTypes_Flat *) vsample)->id;
+}
+
+static void fill_mixed (void *vsample, uint32_t i)
+{
+  static double hist[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  static char name[] = "mixed";
+  ColumnsTypes_Mixed *s = vsample;
+  memset (s, 0, sizeof (*s));
+  s->id = (int32_t) i;
+  s->name = name;
+  s->seq = (int32_t) i;
+  s->hist._length = s->hist._maximum = sizeof (hist) / sizeof (hist[0]);
+  s->hist._buffer = hist;
+  s->ts = (int64_t) i * 1000;
+  s->v3 = 0.5 * i;
+}
+
+static int32_t get_id_mixed (const void *vsample)
+{
+  return ((const ColumnsTypes_Mixed *) vsample)->id;
+}
+
+static struct bench_type types[] = {
+  { "Flat", &ColumnsTypes_Flat_desc, sizeof (ColumnsTypes_Flat), fill_flat, get_id_flat, {
+    { offsetof (ColumnsTypes_Flat, id), sizeof (int32_t), NULL },
+    { offsetof (ColumnsTypes_Flat, ts), sizeof (int64_t), NULL },
+    { offsetof (ColumnsTypes_Flat, v3), sizeof (double), NULL } } },
+  { "Mixed", &ColumnsTypes_Mixed_desc, sizeof (ColumnsTypes_Mixed), fill_mixed, get_id_mixed, {
+    { offsetof (ColumnsTypes_Mixed, id), sizeof (int32_t), NULL },
+    { offsetof (ColumnsTypes_Mixed, ts), sizeof (int64_t), NULL },
+    { offsetof (ColumnsTypes_Mixed, v3), sizeof (double), NULL } } }
+};
+
+static void write_batch (dds_entity_t wr, const struct bench_type *t, void *sample, uint32_t batch)
+{
+  for (uint32_t i = 0; i < batch; i++)
+  {
+    t->fill (sample, i);
+    if (dds_write (wr, sample) != 0)
+    {
+      fprintf (stderr, "dds_write failed\n");
+      exit (1);
+    }
+  }
+}
+
+static void check_count (dds_return_t n, uint32_t batch)
+{
+  if (n != (dds_return_t) batch)
+  {
+    fprintf (stderr, "take returned %"PRId32", expected %"PRIu32"\n", n, batch);
+    exit (1);
+  }
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [-i ITERATIONS]\n", argv0);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  static const uint32_t batches[] = { 16, 256, MAX_BATCH };
+  uint32_t iterations = 100;
+  int opt;
+  while ((opt = getopt (argc, argv, "i:")) != EOF)
+  {
+    switch (opt)
+    {
+      case 'i': iterations = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (iterations < 1)
+    usage (argv[0]);
+
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  if (pp < 0)
+  {
+    fprintf (stderr, "dds_create_participant: %s\n", dds_strretcode (pp));
+    return 1;
+  }
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+
+  dds_sample_info_t *si = ddsrt_malloc (MAX_BATCH * sizeof (*si));
+  void **ptrs = ddsrt_malloc (MAX_BATCH * sizeof (*ptrs));
+  char *colbufs[NCOLS];
+  for (int k = 0; k < NCOLS; k++)
+    colbufs[k] = ddsrt_malloc (MAX_BATCH * sizeof (int64_t));
+
+  int64_t sum = 0;
+  printf ("%8s %8s %14s %14s %8s\n", "type", "batch", "read[Msps]", "columns[Msps]", "speedup");
+  for (size_t ti = 0; ti < sizeof (types) / sizeof (types[0]); ti++)
+  {
+    struct bench_type * const t = &types[ti];
+    char tpname[100];
+    (void) snprintf (tpname, sizeof (tpname), "columns_bench_%s", t->name);
+    const dds_entity_t tp = dds_create_topic (pp, t->desc, tpname, NULL, NULL);
+    const dds_entity_t rd = dds_create_reader (pp, tp, qos, NULL);
+    const dds_entity_t wr = dds_create_writer (pp, tp, qos, NULL);
+    if (tp < 0 || rd < 0 || wr < 0)
+    {
+      fprintf (stderr, "failed to create topic/reader/writer\n");
+      return 1;
+    }
+    void *wrsample = ddsrt_malloc (t->size);
+    char *samples = ddsrt_calloc (MAX_BATCH, t->size);
+    for (uint32_t i = 0; i < MAX_BATCH; i++)
+      ptrs[i] = samples + i * t->size;
+    for (int k = 0; k < NCOLS; k++)
+      t->cols[k].buf = colbufs[k];
+
+    for (size_t bi = 0; bi < sizeof (batches) / sizeof (batches[0]); bi++)
+    {
+      const uint32_t batch = batches[bi];
+      write_batch (wr, t, wrsample, batch);
+      dds_return_t n;
+
+      const dds_time_t t0 = dds_time ();
+      for (uint32_t it = 0; it < iterations; it++)
+      {
+        n = dds_read (rd, ptrs, si, batch, batch);
+        check_count (n, batch);
+        for (int32_t i = 0; i < n; i++)
+          sum += t->get_id (ptrs[i]);
+      }
+      const dds_time_t t1 = dds_time ();
+      for (uint32_t it = 0; it < iterations; it++)
+      {
+        n = dds_read_columns (rd, t->cols, NCOLS, si, batch, 0);
+        check_count (n, batch);
+        for (int32_t i = 0; i < n; i++)
+          sum += ((const int32_t *) t->cols[0].buf)[i];
+      }
+      const dds_time_t t2 = dds_time ();
+      n = dds_take_columns (rd, t->cols, NCOLS, si, batch, 0);
+      check_count (n, batch);
+
+      const int64_t trow = t1 - t0, tcol = t2 - t1;
+      const double nsamples = (double) batch * iterations;
+      const double row_rate = nsamples / (double) (trow ? trow : 1) * 1e3;
+      const double col_rate = nsamples / (double) (tcol ? tcol : 1) * 1e3;
+      printf ("%8s %8"PRIu32" %14.2f %14.2f %8.2f\n", t->name, batch, row_rate, col_rate, col_rate / row_rate);
+    }
+
+    for (uint32_t i = 0; i < MAX_BATCH; i++)
+      dds_sample_free (ptrs[i], t->desc, DDS_FREE_CONTENTS);
+    ddsrt_free (samples);
+    ddsrt_free (wrsample);
+    (void) dds_delete (wr);
+    (void) dds_delete (rd);
+    (void) dds_delete (tp);
+  }
+  /* print it so the compiler can't eliminate the reads */
+  printf ("(checksum %"PRId64")\n", sum);
+
+  for (int k = 0; k < NCOLS; k++)
+    ddsrt_free (colbufs[k]);
+  ddsrt_free (ptrs);
+  ddsrt_free (si);
+  dds_delete_qos (qos);
+  (void) dds_delete (pp);
+  return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/time.h"
+#include "DiscoveryStormTypes.h"
+
+/* Measures how long it takes to discover a large number of remote writers and
+   what it costs to match a new reader once they have been discovered.  The
+   "storm" domain creates P participants with W writers each, spread evenly
+   over T topics; the "observer" domain has a reader for each topic and waits
+   until all readers have matched all writers.  The two are different domains
+   in the same process, configured to use the same port numbers so that they
+   discover each other.
+
+   Once discovery is complete, it measures the time it takes to create and
+   delete a reader in the observer domain, once for a topic with P*W/T remote
+   writers and once for a topic without any writers.  Matching only looks at
+   the writers of the topic, so the latter should be cheap regardless of the
+   total number of endpoints. */
+
+#define DOMAIN_OBSERVER 0
+#define DOMAIN_STORM 1
+
+static dds_entity_t create_domain (dds_domainid_t domid)
+{
+  const char *config = "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>";
+  char *conf = ddsrt_expand_envvars (config, domid);
+  const dds_entity_t dom = dds_create_domain (domid, conf);
+  ddsrt_free (conf);
+  if (dom < 0)
+  {
+    fprintf (stderr, "dds_create_domain: %s\n", dds_strretcode (dom));
+    exit (1);
+  }
+  return dom;
+}
+
+static dds_entity_t create_participant (dds_domainid_t domid)
+{
+  const dds_entity_t pp = dds_create_participant (domid, NULL, NULL);
+  if (pp < 0)
+  {
+    fprintf (stderr, "dds_create_participant: %s\n", dds_strretcode (pp));
+    exit (1);
+  }
+  return pp;
+}
+
+static dds_entity_t create_topic (dds_entity_t pp, uint32_t t)
+{
+  char tpname[100];
+  (void) snprintf (tpname, sizeof (tpname), "discovery_storm_bench_%"PRIu32, t);
+  const dds_entity_t tp = dds_create_topic (pp, &DiscoveryStormTypes_Msg_desc, tpname, NULL, NULL);
+  if (tp < 0)
+  {
+    fprintf (stderr, "dds_create_topic: %s\n", dds_strretcode (tp));
+    exit (1);
+  }
+  return tp;
+}
+
+static bool all_matched (const dds_entity_t *rds, uint32_t ntopics, uint32_t expected)
+{
+  for (uint32_t t = 0; t < ntopics; t++)
+  {
+    dds_subscription_matched_status_t st;
+    if (dds_get_subscription_matched_status (rds[t], &st) < 0)
+    {
+      fprintf (stderr, "dds_get_subscription_matched_status failed\n");
+      exit (1);
+    }
+    if (st.current_count < expected)
+      return false;
+  }
+  return true;
+}
+
+static double time_create_reader (dds_entity_t pp, dds_entity_t tp, uint32_t iterations)
+{
+  const dds_time_t t0 = dds_time ();
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    const dds_entity_t rd = dds_create_reader (pp, tp, NULL, NULL);
+    if (rd < 0)
+    {
+      fprintf (stderr, "dds_create_reader: %s\n", dds_strretcode (rd));
+      exit (1);
+    }
+    (void) dds_delete (rd);
+  }
+  const dds_time_t t1 = dds_time ();
+  return (double) (t1 - t0) / (double) iterations;
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [-p PARTICIPANTS] [-w WRITERS-PER-PARTICIPANT] [-t TOPICS] [-i ITERATIONS]\n", argv0);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  uint32_t nparticipants = 50, nwriters = 20, ntopics = 10, iterations = 100;
+  int opt;
+  while ((opt = getopt (argc, argv, "p:w:t:i:")) != EOF)
+  {
+    switch (opt)
+    {
+      case 'p': nparticipants = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'w': nwriters = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 't': ntopics = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'i': iterations = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (nparticipants < 1 || nwriters < 1 || ntopics < 1 || iterations < 1 || (nparticipants * nwriters) % ntopics != 0)
+    usage (argv[0]);
+
+  (void) create_domain (DOMAIN_OBSERVER);
+  (void) create_domain (DOMAIN_STORM);
+
+  const dds_entity_t obs_pp = create_participant (DOMAIN_OBSERVER);
+  dds_entity_t *obs_tps = ddsrt_malloc (ntopics * sizeof (*obs_tps));
+  dds_entity_t *obs_rds = ddsrt_malloc (ntopics * sizeof (*obs_rds));
+  for (uint32_t t = 0; t < ntopics; t++)
+  {
+    obs_tps[t] = create_topic (obs_pp, t);
+    if ((obs_rds[t] = dds_create_reader (obs_pp, obs_tps[t], NULL, NULL)) < 0)
+    {
+      fprintf (stderr, "dds_create_reader: %s\n", dds_strretcode (obs_rds[t]));
+      return 1;
+    }
+  }
+  const dds_entity_t obs_empty_tp = create_topic (obs_pp, ntopics);
+
+  const dds_time_t tstart = dds_time ();
+  uint32_t k = 0;
+  for (uint32_t p = 0; p < nparticipants; p++)
+  {
+    const dds_entity_t pp = create_participant (DOMAIN_STORM);
+    dds_entity_t *tps = ddsrt_malloc (ntopics * sizeof (*tps));
+    for (uint32_t t = 0; t < ntopics; t++)
+      tps[t] = 0;
+    for (uint32_t w = 0; w < nwriters; w++, k++)
+    {
+      const uint32_t t = k % ntopics;
+      if (tps[t] == 0)
+        tps[t] = create_topic (pp, t);
+      const dds_entity_t wr = dds_create_writer (pp, tps[t], NULL, NULL);
+      if (wr < 0)
+      {
+        fprintf (stderr, "dds_create_writer: %s\n", dds_strretcode (wr));
+        return 1;
+      }
+    }
+    ddsrt_free (tps);
+  }
+  const dds_time_t tcreated = dds_time ();
+
+  const uint32_t per_topic = nparticipants * nwriters / ntopics;
+  const dds_time_t tabort = dds_time () + DDS_SECS (60);
+  while (!all_matched (obs_rds, ntopics, per_topic))
+  {
+    if (dds_time () > tabort)
+    {
+      fprintf (stderr, "timed out waiting for discovery\n");
+      return 1;
+    }
+    dds_sleepfor (DDS_MSECS (1));
+  }
+  const dds_time_t tdiscovered = dds_time ();
+
+  const double tfull = time_create_reader (obs_pp, obs_tps[0], iterations);
+  const double tempty = time_create_reader (obs_pp, obs_empty_tp, iterations);
+
+  const uint32_t nendpoints = nparticipants * nwriters;
+  printf ("%12s %12s %14s %14s %16s %16s\n", "participants", "writers", "create[ms]", "discover[ms]", "match-full[us]", "match-empty[us]");
+  printf ("%12"PRIu32" %12"PRIu32" %14.1f %14.1f %16.1f %16.1f\n", nparticipants, nendpoints,
+          (double) (tcreated - tstart) / 1e6, (double) (tdiscovered - tstart) / 1e6, tfull / 1e3, tempty / 1e3);
+
+  ddsrt_free (obs_rds);
+  ddsrt_free (obs_tps);
+  (void) dds_delete (DDS_CYCLONEDDS_HANDLE);
+  return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/time.h"
+#include "LazyKeyTypes.h"
+
+/* Measures the cost of writing a sample with a keep-all, volatile writer that
+   has no readers, once in a domain that computes the key of every sample that
+   gets written, and once in a domain configured to compute it only when it is
+   needed.  The writes cycle over a fixed set of instances, so that the cost of
+   creating instances doesn't factor in.  "SmallKey" has a single integer as
+   key, "BigKey" a key of a few hundred bytes consisting of two strings and a
+   number of integers. */
+
+#define DOMAIN_EAGER 0
+#define DOMAIN_LAZY 1
+#define NINST 100
+
+struct bench_type {
+  const char *name;
+  const dds_topic_descriptor_t *desc;
+  void (*fill) (void *sample, uint32_t i);
+};
+
+static unsigned char payload[16];
+
+static void fill_small (void *vsample, uint32_t i)
+{
+  LazyKeyTypes_SmallKey *s = vsample;
+  s->id = (int32_t) (i % NINST);
+  s->seq = (int32_t) i;
+  s->payload._length = s->payload._maximum = sizeof (payload);
+  s->payload._buffer = payload;
+}
+
+static void fill_big (void *vsample, uint32_t i)
+{
+  static char name[] = "a rather long name that makes up a substantial part of the key";
+  static char path[] = "/and/a/path/that/makes/up/another/substantial/part/of/the/key/of/the/sample/as/well";
+  LazyKeyTypes_BigKey *s = vsample;
+  s->name = name;
+  s->k0 = s->k2 = s->k4 = s->k6 = (int64_t) (i % NINST);
+  s->k1 = s->k3 = s->k5 = s->k7 = -(int64_t) (i % NINST);
+  s->path = path;
+  s->seq = (int32_t) i;
+  s->payload._length = s->payload._maximum = sizeof (payload);
+  s->payload._buffer = payload;
+}
+
+static const struct bench_type types[] = {
+  { "SmallKey", &LazyKeyTypes_SmallKey_desc, fill_small },
+  { "BigKey", &LazyKeyTypes_BigKey_desc, fill_big }
+};
+
+static double run (dds_entity_t pp, const struct bench_type *t, uint32_t iterations)
+{
+  union {
+    LazyKeyTypes_SmallKey small;
+    LazyKeyTypes_BigKey big;
+  } sample;
+  char tpname[100];
+  (void) snprintf (tpname, sizeof (tpname), "lazykey_bench_%s", t->name);
+  const dds_entity_t tp = dds_create_topic (pp, t->desc, tpname, NULL, NULL);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t wr = dds_create_writer (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  if (tp < 0 || wr < 0)
+  {
+    fprintf (stderr, "failed to create topic/writer\n");
+    exit (1);
+  }
+
+  /* first round creates the instances */
+  for (uint32_t i = 0; i < NINST; i++)
+  {
+    t->fill (&sample, i);
+    if (dds_write (wr, &sample) != 0)
+    {
+      fprintf (stderr, "dds_write failed\n");
+      exit (1);
+    }
+  }
+  const dds_time_t t0 = dds_time ();
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    t->fill (&sample, i);
+    if (dds_write (wr, &sample) != 0)
+    {
+      fprintf (stderr, "dds_write failed\n");
+      exit (1);
+    }
+  }
+  const dds_time_t t1 = dds_time ();
+  (void) dds_delete (wr);
+  (void) dds_delete (tp);
+  return (double) (t1 - t0) / (double) iterations;
+}
+
+static dds_entity_t create_participant (dds_domainid_t domid, const char *lazy)
+{
+  char config[100];
+  (void) snprintf (config, sizeof (config), "<Internal><LazyWriteKey>%s</LazyWriteKey></Internal>", lazy);
+  const dds_entity_t dom = dds_create_domain (domid, config);
+  if (dom < 0)
+  {
+    fprintf (stderr, "dds_create_domain: %s\n", dds_strretcode (dom));
+    exit (1);
+  }
+  const dds_entity_t pp = dds_create_participant (domid, NULL, NULL);
+  if (pp < 0)
+  {
+    fprintf (stderr, "dds_create_participant: %s\n", dds_strretcode (pp));
+    exit (1);
+  }
+  return pp;
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [-i ITERATIONS]\n", argv0);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  uint32_t iterations = 100000;
+  int opt;
+  while ((opt = getopt (argc, argv, "i:")) != EOF)
+  {
+    switch (opt)
+    {
+      case 'i': iterations = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (iterations < 1)
+    usage (argv[0]);
+
+  const dds_entity_t pp_eager = create_participant (DOMAIN_EAGER, "false");
+  const dds_entity_t pp_lazy = create_participant (DOMAIN_LAZY, "true");
+
+  printf ("%10s %14s %14s %8s\n", "type", "eager[ns]", "lazy[ns]", "speedup");
+  for (size_t ti = 0; ti < sizeof (types) / sizeof (types[0]); ti++)
+  {
+    const double te = run (pp_eager, &types[ti], iterations);
+    const double tl = run (pp_lazy, &types[ti], iterations);
+    printf ("%10s %14.1f %14.1f %8.2f\n", types[ti].name, te, tl, te / tl);
+  }
+  (void) dds_delete (DDS_CYCLONEDDS_HANDLE);
+  return 0;
+}
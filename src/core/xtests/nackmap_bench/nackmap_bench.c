@@ -0,0 +1,141 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/cdtors.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/log.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds/ddsi/q_radmin.h"
+
+/* Measures the cost of constructing the ACKNACK bitmap from the reorder
+   admin of a reliable proxy writer, for increasing reorder window sizes and
+   loss rates.  The first sample is always lost so that nothing gets
+   delivered, the rest of the window is filled with samples of which a
+   fraction is lost.  Also reports the cost of inserting the samples, as
+   that is where the bitmap is maintained. */
+
+#define PAYLOAD_OFF 16u
+#define PAYLOAD_SIZE 32u
+
+static struct ddsrt_log_cfg logcfg;
+static struct receiver_state rst;
+
+static void insert (struct nn_rbufpool *rbp, struct nn_defrag *defrag, struct nn_reorder *reorder, seqno_t seq)
+{
+  struct nn_rmsg *rmsg = nn_rmsg_new (rbp);
+  nn_rmsg_setsize (rmsg, PAYLOAD_OFF + PAYLOAD_SIZE);
+  struct nn_rsample_info si;
+  memset (&si, 0, sizeof (si));
+  si.seq = seq;
+  si.rst = &rst;
+  si.size = PAYLOAD_SIZE;
+  si.fragsize = PAYLOAD_SIZE;
+  struct nn_rdata *rdata = nn_rdata_new (rmsg, 0, PAYLOAD_SIZE, 0, PAYLOAD_OFF, 0);
+  struct nn_rsample *rsample;
+  if ((rsample = nn_defrag_rsample (defrag, rdata, &si)) != NULL)
+  {
+    struct nn_rdata *fragchain = nn_rsample_fragchain (rsample);
+    struct nn_rsample_chain sc;
+    int refc_adjust = 0;
+    if (nn_reorder_rsample (&sc, reorder, rsample, &refc_adjust, 0) > 0)
+    {
+      fprintf (stderr, "unexpected delivery of %"PRId64"\n", seq);
+      exit (1);
+    }
+    nn_fragchain_adjust_refcount (fragchain, refc_adjust);
+  }
+  nn_rmsg_commit (rmsg);
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [-s SEED] [-i ITERATIONS]\n", argv0);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  static const uint32_t windows[] = { 16, 64, 256, 1024, 4096 };
+  static const uint32_t loss_ppm[] = { 1000, 10000, 100000, 500000 };
+  uint32_t seed = 1, iterations = 100000;
+  int opt;
+  while ((opt = getopt (argc, argv, "s:i:")) != EOF)
+  {
+    switch (opt)
+    {
+      case 's': seed = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'i': iterations = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (iterations < 1)
+    usage (argv[0]);
+
+  ddsrt_init ();
+  dds_log_cfg_init (&logcfg, 0, 0, stderr, stderr);
+  memset (&rst, 0, sizeof (rst));
+
+  ddsrt_prng_t prng;
+  ddsrt_prng_init_simple (&prng, seed);
+  uint64_t sum = 0;
+  printf ("%8s %8s %10s %12s %12s\n", "window", "loss[%]", "missing", "insert[ns]", "nackmap[ns]");
+  for (size_t w = 0; w < sizeof (windows) / sizeof (windows[0]); w++)
+  {
+    for (size_t l = 0; l < sizeof (loss_ppm) / sizeof (loss_ppm[0]); l++)
+    {
+      const uint32_t window = windows[w];
+      struct nn_rbufpool *rbp = nn_rbufpool_new (&logcfg, 1048576, 65536, 0);
+      struct nn_defrag *defrag = nn_defrag_new (&logcfg, NN_DEFRAG_DROP_LATEST, 16, true);
+      struct nn_reorder *reorder = nn_reorder_new (&logcfg, NN_REORDER_MODE_NORMAL, window, false);
+
+      uint32_t ninserted = 0;
+      const ddsrt_mtime_t t0 = ddsrt_time_monotonic ();
+      for (seqno_t seq = 2; seq <= (seqno_t) window; seq++)
+      {
+        if ((ddsrt_prng_random (&prng) % 1000000) >= loss_ppm[l])
+        {
+          insert (rbp, defrag, reorder, seq);
+          ninserted++;
+        }
+      }
+      const ddsrt_mtime_t t1 = ddsrt_time_monotonic ();
+
+      struct nn_sequence_number_set_header map;
+      uint32_t bits[NN_SEQUENCE_NUMBER_SET_MAX_BITS / 32];
+      for (uint32_t i = 0; i < iterations; i++)
+      {
+        sum += nn_reorder_nackmap (reorder, 1, (seqno_t) window, &map, bits, NN_SEQUENCE_NUMBER_SET_MAX_BITS, (int) (i % 2));
+        sum += bits[0];
+      }
+      const ddsrt_mtime_t t2 = ddsrt_time_monotonic ();
+
+      printf ("%8"PRIu32" %8.1f %10"PRIu32" %12.1f %12.1f\n", window, (double) loss_ppm[l] / 1e4,
+              window - ninserted,
+              ninserted ? (double) (t1.v - t0.v) / ninserted : 0.0,
+              (double) (t2.v - t1.v) / iterations);
+      nn_reorder_free (reorder);
+      nn_defrag_free (defrag);
+      nn_rbufpool_free (rbp);
+    }
+  }
+  /* print it so the compiler can't eliminate the nackmap calls */
+  printf ("(checksum %"PRIu64")\n", sum);
+  ddsrt_fini ();
+  return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "dds/dds.h"
+#include "ProxyQosTypes.h"
+
+/* Measures the memory footprint of a large number of proxy writers, once with
+   all writers having the same QoS and once with each writer having a
+   different QoS because of a unique user data value.  Proxy endpoints with
+   identical QoS share a single copy of it, so the difference between the two
+   is (roughly) the cost of a QoS object.
+
+   The writers are created in a child process, the observer is another child
+   process that has a reader for the topic and reports the growth of its
+   maximum resident set size between creating the reader and having matched
+   all writers.  That growth includes the proxy writers and everything else
+   the observer needs for them, such as the matches with the reader.  The
+   children re-execute the program, because a forked copy would inherit the
+   state used for generating GUIDs and end up with the same ones. */
+
+#define TOPIC_NAME "proxy_qos_bench"
+
+static dds_entity_t create_participant (void)
+{
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  if (pp < 0)
+  {
+    fprintf (stderr, "dds_create_participant: %s\n", dds_strretcode (pp));
+    exit (1);
+  }
+  return pp;
+}
+
+static dds_entity_t create_topic (dds_entity_t pp)
+{
+  const dds_entity_t tp = dds_create_topic (pp, &ProxyQosTypes_Msg_desc, TOPIC_NAME, NULL, NULL);
+  if (tp < 0)
+  {
+    fprintf (stderr, "dds_create_topic: %s\n", dds_strretcode (tp));
+    exit (1);
+  }
+  return tp;
+}
+
+static void run_writers (uint32_t nparticipants, uint32_t nwriters, bool unique)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_partition1 (qos, "proxy_qos_bench");
+  for (uint32_t w = 0; w < nwriters; w++)
+  {
+    static dds_entity_t pp, tp;
+    if (w % ((nwriters + nparticipants - 1) / nparticipants) == 0)
+    {
+      pp = create_participant ();
+      tp = create_topic (pp);
+    }
+    if (unique)
+    {
+      char ud[32];
+      const int n = snprintf (ud, sizeof (ud), "writer %"PRIu32, w);
+      dds_qset_userdata (qos, ud, (size_t) n);
+    }
+    const dds_entity_t wr = dds_create_writer (pp, tp, qos, NULL);
+    if (wr < 0)
+    {
+      fprintf (stderr, "dds_create_writer: %s\n", dds_strretcode (wr));
+      exit (1);
+    }
+  }
+  dds_delete_qos (qos);
+  /* keep the writers alive until the observer is done */
+  while (true)
+    dds_sleepfor (DDS_SECS (1));
+}
+
+static long maxrss_kb (void)
+{
+  struct rusage u;
+  (void) getrusage (RUSAGE_SELF, &u);
+  return u.ru_maxrss;
+}
+
+static void run_observer (const char *label, uint32_t nwriters)
+{
+  const dds_entity_t pp = create_participant ();
+  const dds_entity_t tp = create_topic (pp);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_partition1 (qos, "proxy_qos_bench");
+  const dds_entity_t rd = dds_create_reader (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  if (rd < 0)
+  {
+    fprintf (stderr, "dds_create_reader: %s\n", dds_strretcode (rd));
+    exit (1);
+  }
+  const long rss0 = maxrss_kb ();
+
+  const dds_time_t tstart = dds_time ();
+  const dds_time_t tabort = tstart + DDS_SECS (600);
+  dds_subscription_matched_status_t st;
+  do {
+    if (dds_time () > tabort)
+    {
+      fprintf (stderr, "timed out waiting for discovery\n");
+      exit (1);
+    }
+    dds_sleepfor (DDS_MSECS (10));
+    if (dds_get_subscription_matched_status (rd, &st) < 0)
+    {
+      fprintf (stderr, "dds_get_subscription_matched_status failed\n");
+      exit (1);
+    }
+  } while (st.current_count < nwriters);
+  const dds_time_t tdone = dds_time ();
+  const long rss1 = maxrss_kb ();
+
+  printf ("%8s %10"PRIu32" %14.1f %12ld %14.1f\n", label, nwriters, (double) (tdone - tstart) / 1e6,
+          rss1 - rss0, 1024.0 * (double) (rss1 - rss0) / (double) nwriters);
+  fflush (stdout);
+  (void) dds_delete (DDS_CYCLONEDDS_HANDLE);
+  exit (0);
+}
+
+static pid_t spawn (const char *argv0, const char *mode, uint32_t nparticipants, uint32_t nwriters)
+{
+  char n[20], p[20];
+  (void) snprintf (n, sizeof (n), "%"PRIu32, nwriters);
+  (void) snprintf (p, sizeof (p), "%"PRIu32, nparticipants);
+  const pid_t pid = fork ();
+  if (pid == 0)
+  {
+    (void) execl (argv0, argv0, "-m", mode, "-n", n, "-p", p, (char *) NULL);
+    fprintf (stderr, "exec %s failed\n", argv0);
+    _exit (1);
+  }
+  return pid;
+}
+
+static bool run (const char *argv0, const char *label, uint32_t nparticipants, uint32_t nwriters)
+{
+  char wrmode[20], obsmode[20];
+  pid_t wrpid, obspid;
+  int status;
+  (void) snprintf (wrmode, sizeof (wrmode), "w%s", label);
+  (void) snprintf (obsmode, sizeof (obsmode), "o%s", label);
+  wrpid = spawn (argv0, wrmode, nparticipants, nwriters);
+  obspid = spawn (argv0, obsmode, nparticipants, nwriters);
+  (void) waitpid (obspid, &status, 0);
+  (void) kill (wrpid, SIGTERM);
+  (void) waitpid (wrpid, NULL, 0);
+  return WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [-n WRITERS] [-p PARTICIPANTS]\n", argv0);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  uint32_t nwriters = 100000, nparticipants = 100;
+  const char *mode = NULL;
+  int opt;
+  while ((opt = getopt (argc, argv, "m:n:p:")) != EOF)
+  {
+    switch (opt)
+    {
+      case 'm': mode = optarg; break;
+      case 'n': nwriters = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'p': nparticipants = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (nwriters < 1 || nparticipants < 1 || nparticipants > nwriters)
+    usage (argv[0]);
+
+  /* internal: child processes */
+  if (mode && mode[0] == 'w')
+    run_writers (nparticipants, nwriters, strcmp (mode + 1, "unique") == 0);
+  else if (mode && mode[0] == 'o')
+    run_observer (mode + 1, nwriters);
+  else if (mode)
+    usage (argv[0]);
+
+  printf ("%8s %10s %14s %12s %14s\n", "qos", "writers", "discover[ms]", "rss[kB]", "per-writer[B]");
+  fflush (stdout);
+  if (!run (argv[0], "shared", nparticipants, nwriters))
+    return 1;
+  if (!run (argv[0], "unique", nparticipants, nwriters))
+    return 1;
+  return 0;
+}
@@ -0,0 +1,404 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/attributes.h"
+#include "dds/ddsrt/cdtors.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/log.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsi/q_misc.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds/ddsi/q_radmin.h"
+
+/* Feeds a randomly generated stream of fragments (reordered, duplicated,
+   lost & retransmitted much later, dropped by GAPs) through two instances
+   of the defragmenter + reorder admin in lock-step: one with the sequence
+   number indexed ring enabled and one with only the AVL tree.  After each
+   event the results of the two must be identical: the same samples
+   delivered in the same order, the same NACK bitmaps, the same next
+   expected sequence number.  Finally, missing samples are "retransmitted"
+   until everything has been delivered and the delivered samples are
+   checked against what was published. */
+
+#define PAYLOAD_OFF 16u
+#define FRAGSIZE 64u
+#define NACKMAP_BITS 256u
+
+struct inst {
+  const char *name;
+  struct nn_rbufpool *rbp;
+  struct nn_defrag *defrag;
+  struct nn_reorder *reorder;
+  int64_t ndelivered;
+  seqno_t *delivered;
+  uint64_t ncomplete;
+};
+
+struct smp {
+  uint32_t nfrags;
+  uint32_t size;
+  bool gapped;
+};
+
+struct event {
+  seqno_t seq;
+  uint32_t frag; /* UINT32_MAX: gap */
+  int64_t due;
+};
+
+static struct ddsrt_log_cfg logcfg;
+static struct receiver_state rst;
+static struct smp *smps;
+static uint64_t nevents;
+
+static unsigned char payload_byte (seqno_t seq, uint32_t off)
+{
+  return (unsigned char) ((uint64_t) seq * 131 + off);
+}
+
+static void fail (const char *fmt, ...) ddsrt_attribute_format ((printf, 1, 2));
+
+static void fail (const char *fmt, ...)
+{
+  va_list ap;
+  va_start (ap, fmt);
+  fprintf (stderr, "event %"PRIu64": ", nevents);
+  vfprintf (stderr, fmt, ap);
+  va_end (ap);
+  exit (1);
+}
+
+static void check_sample (struct inst *x, const struct nn_rsample_info *si, const struct nn_rdata *fragchain)
+{
+  uint32_t off = 0;
+  if (si->seq < 1 || smps[si->seq].gapped)
+    fail ("%s: delivered unexpected sample %"PRId64"\n", x->name, si->seq);
+  if (si->size != smps[si->seq].size)
+    fail ("%s: sample %"PRId64" has wrong size\n", x->name, si->seq);
+  for (; fragchain; fragchain = fragchain->nextfrag)
+  {
+    const unsigned char *p = NN_RMSG_PAYLOADOFF (fragchain->rmsg, NN_RDATA_PAYLOAD_OFF (fragchain));
+    if (fragchain->min > off)
+      fail ("%s: sample %"PRId64" has a hole at %"PRIu32"\n", x->name, si->seq, off);
+    for (; off < fragchain->maxp1; off++)
+      if (p[off - fragchain->min] != payload_byte (si->seq, off))
+        fail ("%s: sample %"PRId64" has wrong content at %"PRIu32"\n", x->name, si->seq, off);
+  }
+  if (off != si->size)
+    fail ("%s: sample %"PRId64" is truncated\n", x->name, si->seq);
+}
+
+static void deliver (struct inst *x, struct nn_rsample_chain *sc)
+{
+  while (sc->first)
+  {
+    struct nn_rsample_chain_elem *e = sc->first;
+    sc->first = e->next;
+    if (e->sampleinfo != NULL)
+    {
+      check_sample (x, e->sampleinfo, e->fragchain);
+      if (x->ndelivered > 0 && e->sampleinfo->seq <= x->delivered[x->ndelivered - 1])
+        fail ("%s: sample %"PRId64" delivered out of order\n", x->name, e->sampleinfo->seq);
+      x->delivered[x->ndelivered++] = e->sampleinfo->seq;
+    }
+    nn_fragchain_unref (e->fragchain);
+  }
+}
+
+static void inst_init (struct inst *x, const char *name, bool use_ring, uint32_t defrag_max, uint32_t reorder_max, seqno_t nsamples)
+{
+  x->name = name;
+  x->rbp = nn_rbufpool_new (&logcfg, 1048576, 65536, 0);
+  x->defrag = nn_defrag_new (&logcfg, NN_DEFRAG_DROP_LATEST, defrag_max, use_ring);
+  x->reorder = nn_reorder_new (&logcfg, NN_REORDER_MODE_NORMAL, reorder_max, false);
+  x->ndelivered = 0;
+  x->delivered = ddsrt_malloc ((size_t) (nsamples + 1) * sizeof (*x->delivered));
+  x->ncomplete = 0;
+}
+
+static void inst_fini (struct inst *x)
+{
+  nn_reorder_free (x->reorder);
+  nn_defrag_free (x->defrag);
+  nn_rbufpool_free (x->rbp);
+  ddsrt_free (x->delivered);
+}
+
+static void inst_fragment (struct inst *x, seqno_t seq, uint32_t frag)
+{
+  const struct smp *s = &smps[seq];
+  const uint32_t min = frag * FRAGSIZE;
+  const uint32_t maxp1 = (min + FRAGSIZE < s->size) ? min + FRAGSIZE : s->size;
+  struct nn_rmsg *rmsg = nn_rmsg_new (x->rbp);
+  unsigned char *p = NN_RMSG_PAYLOAD (rmsg);
+  for (uint32_t off = min; off < maxp1; off++)
+    p[PAYLOAD_OFF + off - min] = payload_byte (seq, off);
+  nn_rmsg_setsize (rmsg, PAYLOAD_OFF + maxp1 - min);
+
+  struct nn_rsample_info si;
+  memset (&si, 0, sizeof (si));
+  si.seq = seq;
+  si.rst = &rst;
+  si.size = s->size;
+  si.fragsize = FRAGSIZE;
+  struct nn_rdata *rdata = nn_rdata_new (rmsg, min, maxp1, 0, PAYLOAD_OFF, 0);
+  struct nn_rsample *rsample;
+  if ((rsample = nn_defrag_rsample (x->defrag, rdata, &si)) != NULL)
+  {
+    struct nn_rdata *fragchain = nn_rsample_fragchain (rsample);
+    struct nn_rsample_chain sc;
+    nn_reorder_result_t rres;
+    int refc_adjust = 0;
+    x->ncomplete++;
+    if ((rres = nn_reorder_rsample (&sc, x->reorder, rsample, &refc_adjust, 0)) > 0)
+      deliver (x, &sc);
+    nn_fragchain_adjust_refcount (fragchain, refc_adjust);
+  }
+  nn_rmsg_commit (rmsg);
+}
+
+static void inst_gap (struct inst *x, seqno_t min, seqno_t maxp1)
+{
+  struct nn_rmsg *rmsg = nn_rmsg_new (x->rbp);
+  nn_rmsg_setsize (rmsg, PAYLOAD_OFF);
+  struct nn_rdata *gap = nn_rdata_newgap (rmsg);
+  struct nn_rsample_chain sc;
+  nn_reorder_result_t rres;
+  int refc_adjust = 0;
+  nn_defrag_notegap (x->defrag, min, maxp1);
+  if ((rres = nn_reorder_gap (&sc, x->reorder, gap, min, maxp1, &refc_adjust)) > 0)
+    deliver (x, &sc);
+  nn_fragchain_adjust_refcount (gap, refc_adjust);
+  nn_rmsg_commit (rmsg);
+}
+
+static void inst_prune (struct inst *x, seqno_t min)
+{
+  nn_defrag_prune (x->defrag, &rst.dst_guid_prefix, min);
+}
+
+static void compare (struct inst *a, struct inst *b)
+{
+  uint64_t da, db;
+  if (a->ndelivered != b->ndelivered || memcmp (a->delivered, b->delivered, (size_t) a->ndelivered * sizeof (*a->delivered)) != 0)
+    fail ("delivered samples differ (%"PRId64" vs %"PRId64")\n", a->ndelivered, b->ndelivered);
+  if (a->ncomplete != b->ncomplete)
+    fail ("number of completed samples differs (%"PRIu64" vs %"PRIu64")\n", a->ncomplete, b->ncomplete);
+  if (nn_reorder_next_seq (a->reorder) != nn_reorder_next_seq (b->reorder))
+    fail ("next_seq differs\n");
+  nn_defrag_stats (a->defrag, &da);
+  nn_defrag_stats (b->defrag, &db);
+  if (da != db)
+    fail ("defrag discarded bytes differ\n");
+}
+
+static void compare_nackmap (struct inst *a, struct inst *b, seqno_t seq)
+{
+  struct nn_fragment_number_set_header mapa, mapb;
+  uint32_t bitsa[NACKMAP_BITS / 32], bitsb[NACKMAP_BITS / 32];
+  const uint32_t maxfragnum = smps[seq].nfrags - 1;
+  enum nn_defrag_nackmap_result ra = nn_defrag_nackmap (a->defrag, seq, maxfragnum, &mapa, bitsa, NACKMAP_BITS);
+  enum nn_defrag_nackmap_result rb = nn_defrag_nackmap (b->defrag, seq, maxfragnum, &mapb, bitsb, NACKMAP_BITS);
+  if (ra != rb)
+    fail ("nackmap for %"PRId64" differs\n", seq);
+  if (ra == DEFRAG_NACKMAP_FRAGMENTS_MISSING)
+  {
+    if (mapa.bitmap_base != mapb.bitmap_base || mapa.numbits != mapb.numbits ||
+        memcmp (bitsa, bitsb, NN_FRAGMENT_NUMBER_SET_BITS_SIZE (mapa.numbits)) != 0)
+      fail ("nackmap for %"PRId64" differs\n", seq);
+  }
+}
+
+static void compare_reorder_nackmap (struct inst *a, struct inst *b, seqno_t behind, seqno_t maxseq, int notail)
+{
+  /* the base may be before next_seq when samples are still waiting in
+     the delivery queue */
+  struct nn_sequence_number_set_header mapa, mapb;
+  uint32_t bitsa[NN_SEQUENCE_NUMBER_SET_MAX_BITS / 32], bitsb[NN_SEQUENCE_NUMBER_SET_MAX_BITS / 32];
+  const seqno_t base = (nn_reorder_next_seq (a->reorder) > behind) ? nn_reorder_next_seq (a->reorder) - behind : 1;
+  uint32_t na = nn_reorder_nackmap (a->reorder, base, maxseq, &mapa, bitsa, NN_SEQUENCE_NUMBER_SET_MAX_BITS, notail);
+  uint32_t nb = nn_reorder_nackmap (b->reorder, base, maxseq, &mapb, bitsb, NN_SEQUENCE_NUMBER_SET_MAX_BITS, notail);
+  if (na != nb || fromSN (mapa.bitmap_base) != fromSN (mapb.bitmap_base) || memcmp (bitsa, bitsb, NN_SEQUENCE_NUMBER_SET_BITS_SIZE (na)) != 0)
+    fail ("reorder nackmap differs\n");
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [-s SEED] [-n SAMPLES] [-f MAXFRAGS] [-d DEFRAGMAX] [-r REORDERMAX] [-l LOSS%%] [-g GAP%%]\n", argv0);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  uint32_t seed = 1, maxfrags = 8, defrag_max = 16, reorder_max = 64, loss = 2, gaprate = 1;
+  seqno_t nsamples = 100000;
+  int opt;
+  while ((opt = getopt (argc, argv, "s:n:f:d:r:l:g:")) != EOF)
+  {
+    switch (opt)
+    {
+      case 's': seed = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'n': nsamples = (seqno_t) strtoll (optarg, NULL, 0); break;
+      case 'f': maxfrags = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'd': defrag_max = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'r': reorder_max = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'l': loss = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'g': gaprate = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (nsamples < 1 || maxfrags < 1 || defrag_max < 1 || reorder_max < 1 || loss > 100 || gaprate > 100)
+    usage (argv[0]);
+
+  ddsrt_init ();
+  dds_log_cfg_init (&logcfg, 0, 0, stderr, stderr);
+  memset (&rst, 0, sizeof (rst));
+
+  ddsrt_prng_t prng;
+  ddsrt_prng_init_simple (&prng, seed);
+  smps = ddsrt_malloc ((size_t) (nsamples + 1) * sizeof (*smps));
+  for (seqno_t i = 1; i <= nsamples; i++)
+  {
+    smps[i].nfrags = 1 + ddsrt_prng_random (&prng) % maxfrags;
+    smps[i].size = (smps[i].nfrags - 1) * FRAGSIZE + 1 + ddsrt_prng_random (&prng) % FRAGSIZE;
+    smps[i].gapped = (ddsrt_prng_random (&prng) % 100) < gaprate;
+  }
+
+  struct inst a, b;
+  inst_init (&a, "ring", true, defrag_max, reorder_max, nsamples);
+  inst_init (&b, "tree", false, defrag_max, reorder_max, nsamples);
+
+  /* Generate fragments in a random order, each is delayed by a few steps
+     so that fragments of a handful of samples are interleaved, some are
+     "lost" and retransmitted much later, some are duplicated, and for some
+     samples only some fragments are sent before a GAP */
+  size_t npend = 0, szpend = 1024;
+  struct event *pend = ddsrt_malloc (szpend * sizeof (*pend));
+  seqno_t next = 1;
+  int64_t step = 0;
+  while (next <= nsamples || npend > 0)
+  {
+    step++;
+    if (next <= nsamples && npend < 16 * maxfrags)
+    {
+      const struct smp *s = &smps[next];
+      const uint32_t nsend = s->gapped ? (s->nfrags > 1 ? ddsrt_prng_random (&prng) % s->nfrags : 0) : s->nfrags;
+      if (npend + s->nfrags + 1 > szpend)
+      {
+        szpend *= 2;
+        pend = ddsrt_realloc (pend, szpend * sizeof (*pend));
+      }
+      for (uint32_t f = 0; f < nsend; f++)
+      {
+        int64_t delay = ddsrt_prng_random (&prng) % 8;
+        if ((ddsrt_prng_random (&prng) % 100) < loss)
+          delay += 1 + ddsrt_prng_random (&prng) % 500;
+        pend[npend++] = (struct event) { .seq = next, .frag = f, .due = step + delay };
+      }
+      if (s->gapped)
+        pend[npend++] = (struct event) { .seq = next, .frag = UINT32_MAX, .due = step + 8 + ddsrt_prng_random (&prng) % 100 };
+      next++;
+    }
+
+    size_t i = 0;
+    while (i < npend)
+    {
+      size_t j = i + ddsrt_prng_random (&prng) % (npend - i);
+      struct event ev = pend[j];
+      if (ev.due > step)
+      {
+        /* move it out of the way, keeping it */
+        pend[j] = pend[i];
+        pend[i++] = ev;
+        continue;
+      }
+      pend[j] = pend[--npend];
+      nevents++;
+      if (ev.frag == UINT32_MAX)
+      {
+        inst_gap (&a, ev.seq, ev.seq + 1);
+        inst_gap (&b, ev.seq, ev.seq + 1);
+      }
+      else
+      {
+        inst_fragment (&a, ev.seq, ev.frag);
+        inst_fragment (&b, ev.seq, ev.frag);
+        if ((ddsrt_prng_random (&prng) % 100) < 2)
+        {
+          inst_fragment (&a, ev.seq, ev.frag);
+          inst_fragment (&b, ev.seq, ev.frag);
+        }
+      }
+      compare (&a, &b);
+    }
+
+    if (next > 1 && (ddsrt_prng_random (&prng) % 4) == 0)
+    {
+      const seqno_t lo = (next > 48) ? next - 48 : 1;
+      const seqno_t seq = lo + (seqno_t) (ddsrt_prng_random (&prng) % (uint32_t) (next - lo));
+      compare_nackmap (&a, &b, seq);
+      compare_reorder_nackmap (&a, &b, (seqno_t) (ddsrt_prng_random (&prng) % 40), next - 1, (int) (ddsrt_prng_random (&prng) % 2));
+    }
+    if ((ddsrt_prng_random (&prng) % 10000) == 0)
+    {
+      const seqno_t min = (next > 16) ? next - 16 : 1;
+      inst_prune (&a, min);
+      inst_prune (&b, min);
+      compare (&a, &b);
+    }
+  }
+  ddsrt_free (pend);
+
+  /* Retransmit whatever is still missing, in order, until everything has
+     been delivered */
+  seqno_t seq;
+  while ((seq = nn_reorder_next_seq (a.reorder)) <= nsamples)
+  {
+    nevents++;
+    if (smps[seq].gapped)
+    {
+      inst_gap (&a, seq, seq + 1);
+      inst_gap (&b, seq, seq + 1);
+    }
+    else
+    {
+      for (uint32_t f = 0; f < smps[seq].nfrags; f++)
+      {
+        inst_fragment (&a, seq, f);
+        inst_fragment (&b, seq, f);
+      }
+    }
+    compare (&a, &b);
+    if (nn_reorder_next_seq (a.reorder) == seq)
+      fail ("no progress at %"PRId64"\n", seq);
+  }
+
+  int64_t nexpected = 0;
+  for (seqno_t i = 1; i <= nsamples; i++)
+    if (!smps[i].gapped && a.delivered[nexpected++] != i)
+      fail ("sample %"PRId64" not delivered\n", i);
+  if (a.ndelivered != nexpected)
+    fail ("delivered %"PRId64" samples, expected %"PRId64"\n", a.ndelivered, nexpected);
+
+  printf ("%"PRIu64" events, %"PRId64" samples delivered, %"PRIu64" completed in defrag\n", nevents, a.ndelivered, a.ncomplete);
+  inst_fini (&a);
+  inst_fini (&b);
+  ddsrt_free (smps);
+  ddsrt_fini ();
+  return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/time.h"
+#include "RhcBenchTypes.h"
+
+/* Measures the cost of a write that gets delivered to a number of local
+   KEEP_LAST readers, for a varying number of instances.  Every write replaces
+   the one sample of the instance that is already in the reader history cache:
+   with a depth of 1 that is done in place, with a depth of 2 the store takes
+   the generic path of pushing out the oldest sample of the instance, which is
+   what a depth of 1 did before it had a path of its own.  The readers never
+   read, so the samples all remain unread. */
+
+#define MAX_READERS 4
+
+static double run (dds_entity_t pp, dds_entity_t tp, int32_t depth, uint32_t nreaders, uint32_t ninst, uint32_t iterations, int64_t *sum)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, depth);
+  dds_entity_t rd[MAX_READERS];
+  for (uint32_t i = 0; i < nreaders; i++)
+  {
+    if ((rd[i] = dds_create_reader (pp, tp, qos, NULL)) < 0)
+    {
+      fprintf (stderr, "dds_create_reader: %s\n", dds_strretcode (rd[i]));
+      exit (1);
+    }
+  }
+  dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, 1);
+  const dds_entity_t wr = dds_create_writer (pp, tp, qos, NULL);
+  if (wr < 0)
+  {
+    fprintf (stderr, "dds_create_writer: %s\n", dds_strretcode (wr));
+    exit (1);
+  }
+  dds_delete_qos (qos);
+
+  /* first round creates the instances, so that the measurement only covers
+     replacing samples */
+  RhcBenchTypes_Sample s;
+  memset (&s, 0, sizeof (s));
+  for (uint32_t k = 0; k < ninst; k++)
+  {
+    s.id = (int32_t) k;
+    if (dds_write (wr, &s) != 0)
+    {
+      fprintf (stderr, "dds_write failed\n");
+      exit (1);
+    }
+  }
+  const dds_time_t t0 = dds_time ();
+  for (uint32_t it = 0; it < iterations; it++)
+  {
+    s.seq = (int32_t) it;
+    for (uint32_t k = 0; k < ninst; k++)
+    {
+      s.id = (int32_t) k;
+      s.ts = t0 + k;
+      if (dds_write (wr, &s) != 0)
+      {
+        fprintf (stderr, "dds_write failed\n");
+        exit (1);
+      }
+    }
+  }
+  const dds_time_t t1 = dds_time ();
+
+  for (uint32_t i = 0; i < nreaders; i++)
+  {
+    dds_sample_info_t si;
+    void *raw = NULL;
+    int32_t n;
+    while ((n = dds_take (rd[i], &raw, &si, 1, 1)) > 0)
+    {
+      *sum += ((RhcBenchTypes_Sample *) raw)->seq;
+      (void) dds_return_loan (rd[i], &raw, n);
+      raw = NULL;
+    }
+    (void) dds_delete (rd[i]);
+  }
+  (void) dds_delete (wr);
+  return (double) (t1 - t0) / ((double) iterations * ninst);
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [-i ITERATIONS]\n", argv0);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  static const uint32_t ninsts[] = { 1, 100, 10000 };
+  static const uint32_t nreaderss[] = { 1, MAX_READERS };
+  uint32_t iterations = 1000;
+  int opt;
+  while ((opt = getopt (argc, argv, "i:")) != EOF)
+  {
+    switch (opt)
+    {
+      case 'i': iterations = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (iterations < 1)
+    usage (argv[0]);
+
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  if (pp < 0)
+  {
+    fprintf (stderr, "dds_create_participant: %s\n", dds_strretcode (pp));
+    return 1;
+  }
+  const dds_entity_t tp = dds_create_topic (pp, &RhcBenchTypes_Sample_desc, "rhc_keeplast1_bench", NULL, NULL);
+  if (tp < 0)
+  {
+    fprintf (stderr, "dds_create_topic: %s\n", dds_strretcode (tp));
+    return 1;
+  }
+
+  int64_t sum = 0;
+  printf ("%10s %8s %14s %14s %8s\n", "instances", "readers", "depth2[ns]", "depth1[ns]", "speedup");
+  for (size_t ii = 0; ii < sizeof (ninsts) / sizeof (ninsts[0]); ii++)
+  {
+    for (size_t ri = 0; ri < sizeof (nreaderss) / sizeof (nreaderss[0]); ri++)
+    {
+      /* scale the number of iterations down for large numbers of instances to
+         keep the run time reasonable */
+      const uint32_t ninst = ninsts[ii], nrd = nreaderss[ri];
+      const uint32_t iters = (iterations / ninst) ? iterations / ninst : 1;
+      const double t2 = run (pp, tp, 2, nrd, ninst, iters * 10, &sum);
+      const double t1 = run (pp, tp, 1, nrd, ninst, iters * 10, &sum);
+      printf ("%10"PRIu32" %8"PRIu32" %14.1f %14.1f %8.2f\n", ninst, nrd, t2, t1, t2 / t1);
+    }
+  }
+  /* print it so the compiler can't eliminate the takes */
+  printf ("(checksum %"PRId64")\n", sum);
+  (void) dds_delete (pp);
+  return 0;
+}
@@ -18,6 +18,8 @@
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/process.h"
 #include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/threads.h"
 #include "dds/ddsrt/random.h"
 #include "dds/dds.h"
 #include "dds/ddsi/ddsi_tkmap.h"
@@ -199,15 +201,18 @@ _Pragma("GCC diagnostic pop")
 #endif
 }
 
-static struct dds_rhc *mkrhc (struct ddsi_domaingv *gv, dds_reader *rd, dds_history_kind_t hk, int32_t hdepth, dds_destination_order_kind_t dok)
+static struct dds_rhc *mkrhc (struct ddsi_domaingv *gv, dds_reader *rd, dds_history_kind_t hk, int32_t hdepth, dds_destination_order_kind_t dok, bool ordered_access)
 {
   struct dds_rhc *rhc;
   dds_qos_t rqos;
   ddsi_xqos_init_empty (&rqos);
-  rqos.present |= QP_HISTORY | QP_DESTINATION_ORDER;
+  rqos.present |= QP_HISTORY | QP_DESTINATION_ORDER | QP_PRESENTATION;
   rqos.history.kind = hk;
   rqos.history.depth = hdepth;
   rqos.destination_order.kind = dok;
+  rqos.presentation.access_scope = ordered_access ? DDS_PRESENTATION_TOPIC : DDS_PRESENTATION_INSTANCE;
+  rqos.presentation.coherent_access = false;
+  rqos.presentation.ordered_access = ordered_access;
   ddsi_xqos_mergein_missing (&rqos, &ddsi_default_qos_reader, ~(uint64_t)0);
   thread_state_awake_domain_ok (lookup_thread_state ());
   rhc = dds_rhc_default_new_xchecks (rd, gv, mdtype, true);
@@ -348,6 +353,13 @@ static void rdtkcond (struct dds_rhc *rhc, dds_readcond *cond, const struct chec
     const int x = (rres_iseq[i].sample_state == DDS_NOT_READ_SAMPLE_STATE) + 2 * (rres_iseq[i].view_state == DDS_NEW_VIEW_STATE) + 4 * is;
     states_seen[x][rres_iseq[i].valid_data]++;
 
+    /* sample rank is the number of samples of the same instance following it in the result */
+    uint32_t sample_rank = 0;
+    for (int j = i + 1; j < cnt; j++)
+      sample_rank += (rres_iseq[j].instance_handle == rres_iseq[i].instance_handle);
+    if (rres_iseq[i].sample_rank != sample_rank)
+      abort ();
+
     /* invalid samples are expected to be zero except for the key fields */
     if (!rres_iseq[i].valid_data)
     {
@@ -403,6 +415,11 @@ static void rdtkcond (struct dds_rhc *rhc, dds_readcond *cond, const struct chec
             abort ();
           break;
       }
+      if (cond->m_query.m_keyinst)
+      {
+        if (rres_iseq[i].instance_handle != cond->m_query.m_keyinst->m_iid)
+          abort ();
+      }
       if (cond->m_query.m_filter)
       {
         /* invalid samples don't get the attributes zero'd out in the result, though the keys are guaranteed to be set; maybe I should change that and guarantee that the fields are 0 ... */
@@ -569,6 +586,15 @@ static dds_entity_t readcond_wrapper (dds_entity_t reader, uint32_t mask, dds_qu
   return dds_create_readcondition (reader, mask);
 }
 
+static dds_entity_t keycond_wrapper (dds_entity_t reader, uint32_t mask, dds_querycondition_filter_fn filter)
+{
+  /* cycles through the key values so that there are several conditions for each instance */
+  static int32_t keyval = 0;
+  RhcTypes_T d = { keyval++ % N_KEYVALS, "A", 0, 0, "" };
+  (void) filter;
+  return dds_create_querycondition_key (reader, mask, &d);
+}
+
 static struct ddsi_domaingv *get_gv (dds_entity_t e)
 {
   struct ddsi_domaingv *gv;
@@ -588,10 +614,23 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
 #ifdef DDS_HAS_DEADLINE_MISSED
   dds_qset_deadline (qos, rand_deadline());
 #endif
-  /* two identical readers because we need 63 conditions while we can currently only attach 32 a single reader */
-  dds_entity_t rd[] = { dds_create_reader (pp, tp, qos, NULL), dds_create_reader (pp, tp, qos, NULL) };
+  dds_qos_t *qos_ordered = dds_create_qos ();
+  dds_copy_qos (qos_ordered, qos);
+  dds_qset_presentation (qos_ordered, DDS_PRESENTATION_TOPIC, false, true);
+  dds_qos_t *qos_last1 = dds_create_qos ();
+  dds_copy_qos (qos_last1, qos);
+  dds_qset_history (qos_last1, DDS_HISTORY_KEEP_LAST, 1);
+  /* two identical readers, one with two conditions for every possible state mask so that query conditions
+     no longer fit in a single word, and one with a condition for every mask, plus one that presents the
+     samples in order of reception (it gets no conditions attached) and a KEEP_LAST(1) one (with a couple
+     of read conditions of its own) */
+  dds_entity_t rd[] = { dds_create_reader (pp, tp, qos, NULL), dds_create_reader (pp, tp, qos, NULL), dds_create_reader (pp, tp, qos_ordered, NULL), dds_create_reader (pp, tp, qos_last1, NULL) };
   const size_t nrd = sizeof (rd) / sizeof (rd[0]);
+  dds_delete_qos (qos_last1);
+  dds_delete_qos (qos_ordered);
   dds_delete_qos (qos);
+  if (dds_create_readcondition (rd[3], DDS_ANY_STATE) <= 0 || dds_create_readcondition (rd[3], DDS_NOT_READ_SAMPLE_STATE | DDS_ANY_VIEW_STATE | DDS_ANY_INSTANCE_STATE) <= 0)
+    abort ();
   struct dds_rhc *rhc[sizeof (rd) / sizeof (rd[0])];
   for (size_t i = 0; i < sizeof (rd) / sizeof (rd[0]); i++)
   {
@@ -625,34 +664,38 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
     DDS_ALIVE_INSTANCE_STATE | DDS_NOT_ALIVE_NO_WRITERS_INSTANCE_STATE | DDS_NOT_ALIVE_DISPOSED_INSTANCE_STATE
   };
   const int nitab = (int) (sizeof (itab) / sizeof (itab[0]));
-  const int nconds = nstab * nvtab * nitab;
 
   dds_entity_t gdcond = dds_create_guardcondition (pp);
   dds_entity_t waitset = dds_create_waitset(pp);
   dds_waitset_attach(waitset, gdcond, 888);
 
-  /* create a conditions for every possible state mask */
-  assert (nconds == 63);
-  dds_entity_t conds[63];
-  dds_readcond *rhcconds[63];
+  /* create conditions for every possible state mask: 2x on rd[0], 1x on rd[1]; query conditions get
+     allocated consecutive indices, which means that the ones on rd[1] have the same filter as those with
+     the same index on rd[0] (and hence reading rd[0] using a condition of rd[1] and vice versa makes sense) */
+  assert (nstab * nvtab * nitab == 63);
+  uint32_t masks[63];
   {
-    int ci = 0;
+    int mi = 0;
     for (int s = 0; s < nstab; s++)
       for (int v = 0; v < nvtab; v++)
         for (int i = 0; i < nitab; i++)
-        {
-          assert (ci / 32 < (int) (sizeof (rd) / sizeof (rd[0])));
-          conds[ci] = create_cond (rd[ci / 32], stab[s] | vtab[v] | itab[i], ((ci % 2) == 0) ? filter0 : filter1);
-          if (conds[ci] <= 0) abort ();
-          rhcconds[ci] = get_condaddr (conds[ci]);
-          if (print) {
-            char buf[18];
-            snprintf (buf, sizeof (buf), "conds[%d]", ci);
-            print_cond_w_addr (buf, conds[ci]);
-          }
-          dds_waitset_attach(waitset, conds[ci], ci);
-          ci++;
-        }
+          masks[mi++] = stab[s] | vtab[v] | itab[i];
+  }
+  const int nconds = 3 * 63;
+  dds_entity_t conds[3 * 63];
+  dds_readcond *rhcconds[3 * 63];
+  for (int ci = 0; ci < nconds; ci++)
+  {
+    const int j = (ci < 2 * 63) ? ci : ci - 2 * 63;
+    conds[ci] = create_cond (rd[ci < 2 * 63 ? 0 : 1], masks[j % 63], ((j % 2) == 0) ? filter0 : filter1);
+    if (conds[ci] <= 0) abort ();
+    rhcconds[ci] = get_condaddr (conds[ci]);
+    if (print) {
+      char buf[18];
+      snprintf (buf, sizeof (buf), "conds[%d]", ci);
+      print_cond_w_addr (buf, conds[ci]);
+    }
+    dds_waitset_attach(waitset, conds[ci], ci);
   }
 
   /* simply sanity check on the guard condition and waitset triggering */
@@ -896,6 +939,145 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
     fwr (wr[i]);
 }
 
+struct concurrent_arg {
+  struct ddsi_domaingv *gv;
+  struct dds_rhc *rhc;
+  bool take;
+  bool ordered_access;
+  uint32_t seed;
+  ddsrt_atomic_uint32_t *stop;
+  uint32_t nvalid;
+  uint32_t ninvalid;
+};
+
+static uint32_t concurrent_reader (void *varg)
+{
+  /* Reads or takes in batches of random size while the main thread is storing
+     data, checking that the samples of an instance (or of all instances, for
+     ordered access) are always returned in the order they were written and
+     that the samples are consistent with the sample info.  The RHC checks its own counts and conditions on every
+     operation when built with assertions enabled. */
+  struct concurrent_arg * const arg = varg;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  dds_sample_info_t iseq[MAX_HIST_DEPTH * N_KEYVALS];
+  RhcTypes_T mseq[sizeof (iseq) / sizeof (iseq[0])];
+  void *ptrs[sizeof (iseq) / sizeof (iseq[0])];
+  int32_t lastx[N_KEYVALS], lastx_all = 0;
+  ddsrt_prng_t rng;
+  memset (mseq, 0, sizeof (mseq));
+  for (size_t i = 0; i < sizeof (iseq) / sizeof (iseq[0]); i++)
+    ptrs[i] = &mseq[i];
+  for (int k = 0; k < N_KEYVALS; k++)
+    lastx[k] = 0;
+  ddsrt_prng_init_simple (&rng, arg->seed);
+  arg->nvalid = arg->ninvalid = 0;
+  while (!ddsrt_atomic_ld32 (arg->stop))
+  {
+    const uint32_t max = 1 + ddsrt_prng_random (&rng) % (uint32_t) (sizeof (iseq) / sizeof (iseq[0]));
+    thread_state_awake (ts1, arg->gv);
+    const int32_t n = (arg->take ? dds_rhc_take : dds_rhc_read) (arg->rhc, true, ptrs, iseq, max, 0, 0, NULL);
+    thread_state_asleep (ts1);
+    if (n < 0 || (uint32_t) n > max)
+    {
+      printf ("concurrent %s: unexpected result %"PRId32"\n", arg->take ? "take" : "read", n);
+      abort ();
+    }
+    int32_t prevx[N_KEYVALS], prevx_all = 0;
+    for (int k = 0; k < N_KEYVALS; k++)
+      prevx[k] = 0;
+    for (int32_t i = 0; i < n; i++)
+    {
+      const int32_t k = mseq[i].k;
+      if (k < 0 || k >= N_KEYVALS || !iseq[i].instance_handle)
+      {
+        printf ("concurrent %s: invalid key %"PRId32" or handle\n", arg->take ? "take" : "read", k);
+        abort ();
+      }
+      if (!iseq[i].valid_data)
+      {
+        arg->ninvalid++;
+        continue;
+      }
+      /* within a single result the samples of an instance are in write order;
+         successive takes must never return an older sample than before */
+      if (mseq[i].x <= prevx[k] || (arg->take && mseq[i].x <= lastx[k]))
+      {
+        printf ("concurrent %s: key %"PRId32" seq %"PRId32" after %"PRId32"/%"PRId32"\n", arg->take ? "take" : "read", k, mseq[i].x, prevx[k], lastx[k]);
+        abort ();
+      }
+      if (arg->ordered_access && (mseq[i].x <= prevx_all || (arg->take && mseq[i].x <= lastx_all)))
+      {
+        printf ("concurrent %s: seq %"PRId32" after %"PRId32"/%"PRId32"\n", arg->take ? "take" : "read", mseq[i].x, prevx_all, lastx_all);
+        abort ();
+      }
+      prevx[k] = lastx[k] = prevx_all = lastx_all = mseq[i].x;
+      arg->nvalid++;
+    }
+  }
+  for (size_t i = 0; i < sizeof (iseq) / sizeof (iseq[0]); i++)
+    RhcTypes_T_free (&mseq[i], DDS_FREE_CONTENTS);
+  return 0;
+}
+
+static void test_concurrent (struct ddsi_domaingv *gv, const int count, bool ordered_access, bool print)
+{
+  /* Stores data in a KEEP_ALL reader history cache while other threads
+     concurrently take and read from it, then unregisters all instances
+     and verifies that every sample was taken exactly once. */
+  struct ddsi_tkmap *tkmap = gv->m_tkmap;
+  struct dds_rhc *rhc = mkrhc (gv, NULL, DDS_HISTORY_KEEP_ALL, 1, DDS_DESTINATIONORDER_BY_RECEPTION_TIMESTAMP, ordered_access);
+  struct proxy_writer *wr = mkwr (0);
+  ddsrt_atomic_uint32_t stop = DDSRT_ATOMIC_UINT32_INIT (0);
+  struct concurrent_arg args[] = {
+    { gv, rhc, true, ordered_access, ddsrt_prng_random (&prng), &stop, 0, 0 },
+    { gv, rhc, true, ordered_access, ddsrt_prng_random (&prng), &stop, 0, 0 },
+    { gv, rhc, false, ordered_access, ddsrt_prng_random (&prng), &stop, 0, 0 }
+  };
+  const size_t nargs = sizeof (args) / sizeof (args[0]);
+  ddsrt_thread_t tids[sizeof (args) / sizeof (args[0])];
+  ddsrt_threadattr_t tattr;
+  ddsrt_threadattr_init (&tattr);
+  for (size_t i = 0; i < nargs; i++)
+    if (ddsrt_thread_create (&tids[i], "conc", &tattr, concurrent_reader, &args[i]) != DDS_RETCODE_OK)
+      abort ();
+
+  /* never print the stores: interleaved with the readers it is meaningless */
+  for (int i = 0; i < count; i++)
+    (void) store (tkmap, rhc, wr, mksample ((int32_t) (ddsrt_prng_random (&prng) % N_KEYVALS), 0), false, false);
+  for (int32_t k = 0; k < N_KEYVALS; k++)
+    (void) store (tkmap, rhc, wr, mkkeysample (k, NN_STATUSINFO_UNREGISTER), false, false);
+
+  ddsrt_atomic_st32 (&stop, 1);
+  uint32_t nvalid = 0;
+  for (size_t i = 0; i < nargs; i++)
+  {
+    ddsrt_thread_join (tids[i], NULL);
+    if (args[i].take)
+      nvalid += args[i].nvalid;
+  }
+
+  /* take whatever remains: after that, all instances are empty and have no
+     registrations anymore, so the RHC must be empty */
+  int32_t n;
+  thread_state_awake_domain_ok (lookup_thread_state ());
+  while ((n = dds_rhc_take (rhc, true, rres_ptrs, rres_iseq, (uint32_t) (sizeof (rres_iseq) / sizeof (rres_iseq[0])), 0, 0, NULL)) > 0)
+  {
+    for (int32_t i = 0; i < n; i++)
+      if (rres_iseq[i].valid_data)
+        nvalid++;
+  }
+  thread_state_asleep (lookup_thread_state ());
+  if (n != 0 || nvalid != (uint32_t) count)
+  {
+    printf ("concurrent: took %"PRIu32" of %d samples (last take %"PRId32")\n", nvalid, count, n);
+    abort ();
+  }
+  if (print)
+    printf ("concurrent: taken %"PRIu32"+%"PRIu32" read %"PRIu32"\n", args[0].nvalid, args[1].nvalid, args[2].nvalid);
+  frhc (rhc);
+  fwr (wr);
+}
+
 int main (int argc, char **argv)
 {
   dds_entity_t pp = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
@@ -954,7 +1136,7 @@ int main (int argc, char **argv)
     struct ddsi_tkmap *tkmap = gv->m_tkmap;
     if (print)
       printf ("************* 0 *************\n");
-    struct dds_rhc *rhc = mkrhc (gv, NULL, DDS_HISTORY_KEEP_LAST, 1, DDS_DESTINATIONORDER_BY_SOURCE_TIMESTAMP);
+    struct dds_rhc *rhc = mkrhc (gv, NULL, DDS_HISTORY_KEEP_LAST, 1, DDS_DESTINATIONORDER_BY_SOURCE_TIMESTAMP, false);
     struct proxy_writer *wr0 = mkwr (1);
     struct proxy_writer *wr1 = mkwr (1);
     uint64_t iid0, iid1, iid_t;
@@ -1029,7 +1211,7 @@ int main (int argc, char **argv)
     struct ddsi_tkmap *tkmap = gv->m_tkmap;
     if (print)
       printf ("************* 1 *************\n");
-    struct dds_rhc *rhc = mkrhc (gv, NULL, DDS_HISTORY_KEEP_LAST, 4, DDS_DESTINATIONORDER_BY_SOURCE_TIMESTAMP);
+    struct dds_rhc *rhc = mkrhc (gv, NULL, DDS_HISTORY_KEEP_LAST, 4, DDS_DESTINATIONORDER_BY_SOURCE_TIMESTAMP, false);
     struct proxy_writer *wr[] = { mkwr (0), mkwr (0), mkwr (0) };
     uint64_t iid0, iid_t;
     int nregs = 3, isreg[] = { 1, 1, 1 };
@@ -1100,7 +1282,8 @@ int main (int argc, char **argv)
     } zztab[] = {
       { readcond_wrapper, 0, 0 },
       { dds_create_querycondition, qcpred_key, qcpred_attr2 },
-      { dds_create_querycondition, qcpred_attr2, qcpred_attr3 }
+      { dds_create_querycondition, qcpred_attr2, qcpred_attr3 },
+      { keycond_wrapper, 0, 0 }
     };
     for (int zz = 0; zz < (int) (sizeof (zztab) / sizeof (zztab[0])); zz++)
       if (zz + 2 >= first)
@@ -1111,6 +1294,20 @@ int main (int argc, char **argv)
       }
   }
 
+  if (6 >= first)
+  {
+    if (print)
+      printf ("************* 6 *************\n");
+    test_concurrent (get_gv (pp), count, false, print);
+  }
+
+  if (7 >= first)
+  {
+    if (print)
+      printf ("************* 7 *************\n");
+    test_concurrent (get_gv (pp), count, true, print);
+  }
+
   ddsrt_cond_destroy (&wait_gc_cycle_cond);
   ddsrt_mutex_destroy (&wait_gc_cycle_lock);
 
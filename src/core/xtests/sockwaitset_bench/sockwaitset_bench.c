@@ -0,0 +1,200 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/cdtors.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds/ddsi/q_sockwaitset.h"
+
+/* Measures the time it takes for a datagram sent to one of N sockets in a
+   socket waitset to be reported by os_sockWaitsetWait/NextEvent, for
+   increasing N.  Sending and waiting is done by the same thread, so this
+   measures the cost of the system calls and the waitset administration and
+   not that of waking up a thread. */
+
+struct bench_conn {
+  struct ddsi_tran_conn c;
+  ddsrt_socket_t sock;
+  struct sockaddr_in addr;
+};
+
+static ddsrt_socket_t bench_conn_handle (ddsi_tran_base_t base)
+{
+  return ((struct bench_conn *) base)->sock;
+}
+
+static struct bench_conn *bench_conn_new (void)
+{
+  struct bench_conn *bc = ddsrt_malloc (sizeof (*bc));
+  socklen_t addrlen = sizeof (bc->addr);
+  memset (bc, 0, sizeof (*bc));
+  bc->c.m_base.m_handle_fn = bench_conn_handle;
+  bc->c.m_connless = true;
+  memset (&bc->addr, 0, sizeof (bc->addr));
+  bc->addr.sin_family = AF_INET;
+  bc->addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if (ddsrt_socket (&bc->sock, AF_INET, SOCK_DGRAM, 0) != DDS_RETCODE_OK ||
+      ddsrt_bind (bc->sock, (struct sockaddr *) &bc->addr, sizeof (bc->addr)) != DDS_RETCODE_OK ||
+      ddsrt_getsockname (bc->sock, (struct sockaddr *) &bc->addr, &addrlen) != DDS_RETCODE_OK)
+  {
+    fprintf (stderr, "failed to create socket (out of file descriptors?)\n");
+    exit (2);
+  }
+  return bc;
+}
+
+static void bench_conn_free (struct bench_conn *bc)
+{
+  ddsrt_close (bc->sock);
+  ddsrt_free (bc);
+}
+
+static int cmp_int64 (const void *va, const void *vb)
+{
+  const int64_t *a = va, *b = vb;
+  return (*a == *b) ? 0 : (*a < *b) ? -1 : 1;
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [-n MAXSOCKETS] [-i ITERATIONS]\n", argv0);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  uint32_t maxsocks = 1000, niters = 10000;
+  int opt;
+  while ((opt = getopt (argc, argv, "n:i:")) != EOF)
+  {
+    switch (opt)
+    {
+      case 'n': maxsocks = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'i': niters = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (maxsocks == 0 || niters == 0)
+    usage (argv[0]);
+
+  ddsrt_init ();
+  os_sockWaitset ws;
+  if ((ws = os_sockWaitsetNew ()) == NULL)
+  {
+    fprintf (stderr, "os_sockWaitsetNew failed\n");
+    return 1;
+  }
+  ddsrt_socket_t txsock;
+  if (ddsrt_socket (&txsock, AF_INET, SOCK_DGRAM, 0) != DDS_RETCODE_OK)
+  {
+    fprintf (stderr, "failed to create transmit socket\n");
+    return 1;
+  }
+
+  struct bench_conn **conns = ddsrt_malloc (maxsocks * sizeof (*conns));
+  int64_t *lat = ddsrt_malloc (niters * sizeof (*lat));
+  uint32_t nsocks = 0;
+  int errors = 0;
+  printf ("%8s %10s %10s %10s\n", "sockets", "mean[us]", "median[us]", "p99[us]");
+  for (uint32_t n = 1; errors == 0; n *= 2)
+  {
+    if (n > maxsocks)
+      n = maxsocks;
+    for (; nsocks < n; nsocks++)
+    {
+      conns[nsocks] = bench_conn_new ();
+      if (os_sockWaitsetAdd (ws, &conns[nsocks]->c) != 1)
+      {
+        fprintf (stderr, "os_sockWaitsetAdd failed\n");
+        return 1;
+      }
+    }
+
+    int64_t sum = 0;
+    for (uint32_t i = 0; i < niters && errors == 0; i++)
+    {
+      const uint32_t k = ddsrt_random () % nsocks;
+      const unsigned char msg = (unsigned char) i;
+      ddsrt_iovec_t iov = { .iov_base = (void *) &msg, .iov_len = 1 };
+      ddsrt_msghdr_t mhdr;
+      ssize_t sent, rcvd;
+      unsigned char buf[16];
+      os_sockWaitsetCtx ctx;
+      ddsi_tran_conn_t conn;
+      int idx;
+
+      memset (&mhdr, 0, sizeof (mhdr));
+      mhdr.msg_name = &conns[k]->addr;
+      mhdr.msg_namelen = (socklen_t) sizeof (conns[k]->addr);
+      mhdr.msg_iov = &iov;
+      mhdr.msg_iovlen = 1;
+
+      const ddsrt_mtime_t t0 = ddsrt_time_monotonic ();
+      if (ddsrt_sendmsg (txsock, &mhdr, 0, &sent) != DDS_RETCODE_OK)
+      {
+        fprintf (stderr, "send failed\n");
+        errors++;
+        break;
+      }
+      while ((ctx = os_sockWaitsetWait (ws)) == NULL || (idx = os_sockWaitsetNextEvent (ctx, &conn)) < 0)
+        ;
+      const ddsrt_mtime_t t1 = ddsrt_time_monotonic ();
+      lat[i] = t1.v - t0.v;
+      sum += lat[i];
+
+      if ((uint32_t) idx != k || conn != &conns[k]->c)
+      {
+        fprintf (stderr, "event on wrong socket (%d, expected %"PRIu32")\n", idx, k);
+        errors++;
+      }
+      if (ddsrt_recv (conns[k]->sock, buf, sizeof (buf), 0, &rcvd) != DDS_RETCODE_OK || rcvd != 1 || buf[0] != msg)
+      {
+        fprintf (stderr, "receive failed\n");
+        errors++;
+      }
+      if (os_sockWaitsetNextEvent (ctx, &conn) >= 0)
+      {
+        fprintf (stderr, "spurious event\n");
+        errors++;
+      }
+    }
+    if (errors == 0)
+    {
+      qsort (lat, niters, sizeof (*lat), cmp_int64);
+      printf ("%8"PRIu32" %10.2f %10.2f %10.2f\n", nsocks,
+              (double) sum / niters / 1e3, (double) lat[niters / 2] / 1e3, (double) lat[niters - 1 - niters / 100] / 1e3);
+      fflush (stdout);
+    }
+    if (n == maxsocks)
+      break;
+  }
+
+  for (uint32_t i = 0; i < nsocks; i++)
+  {
+    os_sockWaitsetRemove (ws, &conns[i]->c);
+    bench_conn_free (conns[i]);
+  }
+  ddsrt_close (txsock);
+  os_sockWaitsetFree (ws);
+  ddsrt_free (lat);
+  ddsrt_free (conns);
+  ddsrt_fini ();
+  return errors ? 1 : 0;
+}
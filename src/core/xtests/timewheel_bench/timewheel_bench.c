@@ -0,0 +1,190 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/fibheap.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/timewheel.h"
+
+/* Compares the fibonacci heap with the timing wheel for timer populations of
+   increasing size: the cost of inserting the timers, of renewing random timers
+   (which is what happens to deadlines and leases all the time) and of expiring
+   all of them by stepping time forward in increments of 1ms.  Timers are
+   spread uniformly over the next 10s.  The fibheap does not support increasing
+   a key, so a renewal there is a delete followed by an insert, which is also
+   what the users of the fibheap did. */
+
+#define SPREAD DDS_SECS (10)
+#define STEP DDS_MSECS (1)
+
+struct timer {
+  ddsrt_fibheap_node_t fhnode;
+  ddsrt_timewheel_node_t twnode;
+  int64_t t;
+};
+
+static int compare_timer (const void *va, const void *vb)
+{
+  const struct timer *a = va;
+  const struct timer *b = vb;
+  return (a->t == b->t) ? 0 : (a->t < b->t) ? -1 : 1;
+}
+
+static const ddsrt_fibheap_def_t timer_fhdef = DDSRT_FIBHEAPDEF_INITIALIZER (offsetof (struct timer, fhnode), compare_timer);
+
+struct result {
+  double insert, renew, expire;
+};
+
+static int64_t rand_expiry (ddsrt_prng_t *prng, int64_t tnow)
+{
+  return tnow + STEP + (int64_t) (ddsrt_prng_random (prng) % (uint32_t) (SPREAD / 1000)) * 1000;
+}
+
+static struct result run_fibheap (struct timer *ts, uint32_t n, uint32_t seed, uint64_t *sum)
+{
+  ddsrt_prng_t prng;
+  ddsrt_fibheap_t fh;
+  struct result r;
+  int64_t tnow = DDS_SECS (1000);
+  ddsrt_prng_init_simple (&prng, seed);
+  ddsrt_fibheap_init (&timer_fhdef, &fh);
+
+  ddsrt_mtime_t t0 = ddsrt_time_monotonic ();
+  for (uint32_t i = 0; i < n; i++)
+  {
+    ts[i].t = rand_expiry (&prng, tnow);
+    ddsrt_fibheap_insert (&timer_fhdef, &fh, &ts[i]);
+  }
+  ddsrt_mtime_t t1 = ddsrt_time_monotonic ();
+  r.insert = (double) (t1.v - t0.v) / n;
+
+  t0 = ddsrt_time_monotonic ();
+  for (uint32_t i = 0; i < n; i++)
+  {
+    struct timer *t = &ts[ddsrt_prng_random (&prng) % n];
+    ddsrt_fibheap_delete (&timer_fhdef, &fh, t);
+    t->t = rand_expiry (&prng, tnow);
+    ddsrt_fibheap_insert (&timer_fhdef, &fh, t);
+  }
+  t1 = ddsrt_time_monotonic ();
+  r.renew = (double) (t1.v - t0.v) / n;
+
+  t0 = ddsrt_time_monotonic ();
+  struct timer *t;
+  while (ddsrt_fibheap_min (&timer_fhdef, &fh) != NULL)
+  {
+    while ((t = ddsrt_fibheap_min (&timer_fhdef, &fh)) != NULL && t->t <= tnow)
+    {
+      ddsrt_fibheap_extract_min (&timer_fhdef, &fh);
+      *sum += (uint64_t) t->t;
+    }
+    tnow += STEP;
+  }
+  t1 = ddsrt_time_monotonic ();
+  r.expire = (double) (t1.v - t0.v) / n;
+  return r;
+}
+
+static struct result run_timewheel (struct timer *ts, uint32_t n, uint32_t seed, uint64_t *sum)
+{
+  ddsrt_prng_t prng;
+  ddsrt_timewheel_t tw;
+  struct result r;
+  int64_t tnow = DDS_SECS (1000);
+  ddsrt_prng_init_simple (&prng, seed);
+  ddsrt_timewheel_init (&tw);
+
+  ddsrt_mtime_t t0 = ddsrt_time_monotonic ();
+  for (uint32_t i = 0; i < n; i++)
+  {
+    ts[i].t = rand_expiry (&prng, tnow);
+    ddsrt_timewheel_insert (&tw, &ts[i].twnode, ts[i].t);
+  }
+  ddsrt_mtime_t t1 = ddsrt_time_monotonic ();
+  r.insert = (double) (t1.v - t0.v) / n;
+
+  t0 = ddsrt_time_monotonic ();
+  for (uint32_t i = 0; i < n; i++)
+  {
+    struct timer *t = &ts[ddsrt_prng_random (&prng) % n];
+    t->t = rand_expiry (&prng, tnow);
+    ddsrt_timewheel_update (&tw, &t->twnode, t->t);
+  }
+  t1 = ddsrt_time_monotonic ();
+  r.renew = (double) (t1.v - t0.v) / n;
+
+  t0 = ddsrt_time_monotonic ();
+  while (!ddsrt_timewheel_isempty (&tw))
+  {
+    ddsrt_timewheel_node_t *twn;
+    while ((twn = ddsrt_timewheel_next_expired (&tw, tnow)) != NULL)
+    {
+      ddsrt_timewheel_delete (&tw, twn);
+      *sum += (uint64_t) DDSRT_FROM_TIMEWHEEL (struct timer, twnode, twn)->t;
+    }
+    tnow += STEP;
+  }
+  t1 = ddsrt_time_monotonic ();
+  r.expire = (double) (t1.v - t0.v) / n;
+  ddsrt_timewheel_fini (&tw);
+  return r;
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [-s SEED] [-n MAXTIMERS]\n", argv0);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  uint32_t seed = 1, maxn = 1000000;
+  int opt;
+  while ((opt = getopt (argc, argv, "s:n:")) != EOF)
+  {
+    switch (opt)
+    {
+      case 's': seed = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'n': maxn = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (maxn < 1)
+    usage (argv[0]);
+
+  struct timer *ts = ddsrt_malloc (maxn * sizeof (*ts));
+  uint64_t sum_fh = 0, sum_tw = 0;
+  printf ("%8s %10s %10s %10s %10s %10s %10s\n", "timers", "fh-ins[ns]", "fh-ren[ns]", "fh-exp[ns]", "tw-ins[ns]", "tw-ren[ns]", "tw-exp[ns]");
+  for (uint32_t n = (maxn < 1000) ? maxn : 1000; n <= maxn; n *= 10)
+  {
+    const struct result fh = run_fibheap (ts, n, seed, &sum_fh);
+    const struct result tw = run_timewheel (ts, n, seed, &sum_tw);
+    printf ("%8"PRIu32" %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", n, fh.insert, fh.renew, fh.expire, tw.insert, tw.renew, tw.expire);
+  }
+  ddsrt_free (ts);
+  /* same timers, so both must have expired the same ones */
+  if (sum_fh != sum_tw)
+  {
+    fprintf (stderr, "checksum mismatch: %"PRIu64" vs %"PRIu64"\n", sum_fh, sum_tw);
+    return 1;
+  }
+  printf ("(checksum %"PRIu64")\n", sum_tw);
+  return 0;
+}
@@ -94,6 +94,31 @@ ddsrt_sendmsg(
   int flags,
   ssize_t *sent);
 
+#if DDSRT_HAVE_SENDMMSG
+/**
+ * @brief Send up to @p vlen datagrams in a single call.
+ *
+ * @param[in]     sock    Socket to send on.
+ * @param[in,out] msgvec  Array of @p vlen message headers, on return the
+ *                        msg_len field of the first @p sent entries is set
+ *                        to the number of bytes sent.
+ * @param[in]     vlen    Number of entries in @p msgvec.
+ * @param[in]     flags   Flags as for ddsrt_sendmsg.
+ * @param[out]    sent    Number of datagrams sent, which may be less than
+ *                        @p vlen.
+ *
+ * @returns A dds_return_t indicating success or failure, failure means
+ *          the first datagram could not be sent.
+ */
+DDS_EXPORT dds_return_t
+ddsrt_sendmmsg(
+  ddsrt_socket_t sock,
+  ddsrt_mmsghdr_t *msgvec,
+  uint32_t vlen,
+  int flags,
+  uint32_t *sent);
+#endif
+
 DDS_EXPORT dds_return_t
 ddsrt_recv(
   ddsrt_socket_t sock,
@@ -109,6 +134,32 @@ ddsrt_recvmsg(
   int flags,
   ssize_t *rcvd);
 
+#if DDSRT_HAVE_RECVMMSG
+/**
+ * @brief Receive up to @p vlen datagrams in a single call.
+ *
+ * Blocks until at least one datagram is available, then returns whatever
+ * else is immediately available without blocking again.
+ *
+ * @param[in]     sock    Socket to receive from.
+ * @param[in,out] msgvec  Array of @p vlen message headers, on return the
+ *                        msg_len field of the first @p rcvd entries is set
+ *                        to the number of bytes received.
+ * @param[in]     vlen    Number of entries in @p msgvec.
+ * @param[in]     flags   Flags as for ddsrt_recvmsg.
+ * @param[out]    rcvd    Number of datagrams received.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ */
+DDS_EXPORT dds_return_t
+ddsrt_recvmmsg(
+  ddsrt_socket_t sock,
+  ddsrt_mmsghdr_t *msgvec,
+  uint32_t vlen,
+  int flags,
+  uint32_t *rcvd);
+#endif
+
 DDS_EXPORT dds_return_t
 ddsrt_getsockopt(
   ddsrt_socket_t sock,
@@ -76,6 +76,21 @@ typedef struct msghdr ddsrt_msghdr_t;
 # define DDSRT_MSGHDR_FLAGS 1
 #endif
 
+#if defined(__linux) && !LWIP_SOCKET
+# define DDSRT_HAVE_RECVMMSG 1
+# define DDSRT_HAVE_SENDMMSG 1
+#else
+# define DDSRT_HAVE_RECVMMSG 0
+# define DDSRT_HAVE_SENDMMSG 0
+#endif
+
+/* Layout-compatible with Linux' struct mmsghdr, but usable without
+   _GNU_SOURCE */
+typedef struct ddsrt_mmsghdr {
+  ddsrt_msghdr_t msg_hdr;
+  unsigned int msg_len;
+} ddsrt_mmsghdr_t;
+
 #if defined(__cplusplus)
 }
 #endif
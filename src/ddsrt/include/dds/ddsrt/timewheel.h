@@ -0,0 +1,76 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSRT_TIMEWHEEL_H
+#define DDSRT_TIMEWHEEL_H
+
+/* Hierarchical timing wheel for large numbers of timers with O(1) insert and
+   delete.  Times are in nanoseconds, the wheel has a resolution of 2^20ns
+   (about 1ms): expiry is always exact, but the "next expiry" is only a lower
+   bound that gets more precise as time advances, so that users of the wheel
+   should expect to be woken up early occasionally.
+
+   The wheel does no locking and does not itself keep track of time: time only
+   advances in ddsrt_timewheel_next_expired.  The slot array is allocated on
+   first insert, so an unused wheel costs only the size of ddsrt_timewheel_t. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "dds/export.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#define DDSRT_TIMEWHEEL_LEVELS 6
+
+#define DDSRT_FROM_TIMEWHEEL(typ_, member_, twn_) ((typ_ *) ((char *) (twn_) - offsetof (typ_, member_)))
+
+typedef struct ddsrt_timewheel_node {
+  struct ddsrt_timewheel_node *next, **pprev;
+  int64_t t;
+  uint32_t slot;
+} ddsrt_timewheel_node_t;
+
+typedef struct ddsrt_timewheel {
+  ddsrt_timewheel_node_t **slots;
+  uint64_t occupied[DDSRT_TIMEWHEEL_LEVELS];
+  uint64_t cur;
+  uint32_t count;
+} ddsrt_timewheel_t;
+
+DDS_EXPORT void ddsrt_timewheel_init (ddsrt_timewheel_t *tw);
+DDS_EXPORT void ddsrt_timewheel_fini (ddsrt_timewheel_t *tw);
+DDS_EXPORT bool ddsrt_timewheel_isempty (const ddsrt_timewheel_t *tw);
+
+/* Node must not be in the wheel, t may be in the past */
+DDS_EXPORT void ddsrt_timewheel_insert (ddsrt_timewheel_t *tw, ddsrt_timewheel_node_t *node, int64_t t);
+DDS_EXPORT void ddsrt_timewheel_delete (ddsrt_timewheel_t *tw, ddsrt_timewheel_node_t *node);
+
+/* Moves a node in the wheel to a new expiry time, equivalent to delete +
+   insert */
+DDS_EXPORT void ddsrt_timewheel_update (ddsrt_timewheel_t *tw, ddsrt_timewheel_node_t *node, int64_t t);
+
+/* Advances the wheel to tnow and returns a node with t <= tnow, or NULL if
+   there is none; the node remains in the wheel.  Multiple expired nodes are
+   returned in no particular order. */
+DDS_EXPORT ddsrt_timewheel_node_t *ddsrt_timewheel_next_expired (ddsrt_timewheel_t *tw, int64_t tnow);
+
+/* Lower bound on the earliest expiry time in the wheel, INT64_MAX if the wheel
+   is empty.  Exact for nodes that expire within the current tick. */
+DDS_EXPORT int64_t ddsrt_timewheel_next_time (const ddsrt_timewheel_t *tw);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSRT_TIMEWHEEL_H */
@@ -0,0 +1,239 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/timewheel.h"
+
+/* A node with expiry tick T is stored relative to the current tick C:
+
+   - if T < C, it is in the "due" list;
+   - otherwise, it is at the level L of the most significant group of
+     TW_BITS bits in which T and C differ (0 if T = C), in the slot indexed by
+     that group of bits of T;
+   - if T and C differ above the highest level, it is in the "overflow" list.
+
+   This means all nodes at level L share the bits above L with the current
+   tick and are later than any node at a lower level.  When the current tick
+   advances, the slots at each level that the current tick passed are emptied
+   and their nodes reinserted, which moves them to a lower level, the due list
+   or, at level 0, keeps them in the current slot.  A node gets moved at most
+   once per level. */
+
+#define TW_SHIFT 20
+#define TW_BITS 6
+#define TW_SLOTS (1u << TW_BITS)
+#define TW_WHEEL_SLOTS (DDSRT_TIMEWHEEL_LEVELS * TW_SLOTS)
+#define TW_SLOT_DUE TW_WHEEL_SLOTS
+#define TW_SLOT_OVERFLOW (TW_WHEEL_SLOTS + 1)
+#define TW_NSLOTS (TW_WHEEL_SLOTS + 2)
+#define TW_SLOT_NONE UINT32_MAX
+
+static uint64_t tick_from_time (int64_t t)
+{
+  return (t <= 0) ? 0 : (uint64_t) t >> TW_SHIFT;
+}
+
+static uint32_t lowest_bit (uint64_t x)
+{
+  assert (x != 0);
+#if defined (__GNUC__)
+  return (uint32_t) __builtin_ctzll (x);
+#else
+  uint32_t n = 0;
+  while (!(x & 1))
+  {
+    x >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+static uint32_t slot_for_tick (const ddsrt_timewheel_t *tw, uint64_t tick)
+{
+  if (tick < tw->cur)
+    return TW_SLOT_DUE;
+  const uint64_t x = tick ^ tw->cur;
+  uint32_t level = 0;
+  while (level < DDSRT_TIMEWHEEL_LEVELS && (x >> (TW_BITS * (level + 1))) != 0)
+    level++;
+  if (level == DDSRT_TIMEWHEEL_LEVELS)
+    return TW_SLOT_OVERFLOW;
+  return level * TW_SLOTS + (uint32_t) ((tick >> (TW_BITS * level)) & (TW_SLOTS - 1));
+}
+
+static void link_node (ddsrt_timewheel_t *tw, ddsrt_timewheel_node_t *node)
+{
+  const uint32_t slot = slot_for_tick (tw, tick_from_time (node->t));
+  ddsrt_timewheel_node_t **head = &tw->slots[slot];
+  node->slot = slot;
+  if ((node->next = *head) != NULL)
+    node->next->pprev = &node->next;
+  node->pprev = head;
+  *head = node;
+  if (slot < TW_WHEEL_SLOTS)
+    tw->occupied[slot / TW_SLOTS] |= (uint64_t) 1 << (slot % TW_SLOTS);
+}
+
+static void unlink_node (ddsrt_timewheel_t *tw, ddsrt_timewheel_node_t *node)
+{
+  assert (node->slot < TW_NSLOTS);
+  if ((*node->pprev = node->next) != NULL)
+    node->next->pprev = node->pprev;
+  if (node->slot < TW_WHEEL_SLOTS && tw->slots[node->slot] == NULL)
+    tw->occupied[node->slot / TW_SLOTS] &= ~((uint64_t) 1 << (node->slot % TW_SLOTS));
+}
+
+static void take_slot (ddsrt_timewheel_t *tw, uint32_t slot, ddsrt_timewheel_node_t **moved)
+{
+  ddsrt_timewheel_node_t *n = tw->slots[slot];
+  tw->slots[slot] = NULL;
+  while (n != NULL)
+  {
+    ddsrt_timewheel_node_t * const next = n->next;
+    n->next = *moved;
+    *moved = n;
+    n = next;
+  }
+}
+
+static void advance (ddsrt_timewheel_t *tw, uint64_t tick)
+{
+  if (tick <= tw->cur)
+    return;
+  ddsrt_timewheel_node_t *moved = NULL;
+  if ((tw->cur >> (TW_BITS * DDSRT_TIMEWHEEL_LEVELS)) != (tick >> (TW_BITS * DDSRT_TIMEWHEEL_LEVELS)))
+    take_slot (tw, TW_SLOT_OVERFLOW, &moved);
+  for (uint32_t level = 0; level < DDSRT_TIMEWHEEL_LEVELS; level++)
+  {
+    const uint32_t sh = TW_BITS * level;
+    uint64_t mask;
+    if ((tw->cur >> (sh + TW_BITS)) != (tick >> (sh + TW_BITS)))
+      mask = ~(uint64_t) 0;
+    else
+    {
+      /* slots from current to new index, inclusive: the current one because
+         at level 0 it holds the nodes expiring in the current tick */
+      const uint32_t lo = (uint32_t) ((tw->cur >> sh) & (TW_SLOTS - 1));
+      const uint32_t hi = (uint32_t) ((tick >> sh) & (TW_SLOTS - 1));
+      assert (lo <= hi);
+      mask = ((hi == TW_SLOTS - 1) ? ~(uint64_t) 0 : (((uint64_t) 1 << (hi + 1)) - 1)) & ~(((uint64_t) 1 << lo) - 1);
+    }
+    mask &= tw->occupied[level];
+    tw->occupied[level] &= ~mask;
+    while (mask)
+    {
+      take_slot (tw, level * TW_SLOTS + lowest_bit (mask), &moved);
+      mask &= mask - 1;
+    }
+  }
+  tw->cur = tick;
+  while (moved != NULL)
+  {
+    ddsrt_timewheel_node_t * const n = moved;
+    moved = n->next;
+    link_node (tw, n);
+  }
+}
+
+void ddsrt_timewheel_init (ddsrt_timewheel_t *tw)
+{
+  memset (tw, 0, sizeof (*tw));
+}
+
+void ddsrt_timewheel_fini (ddsrt_timewheel_t *tw)
+{
+  assert (tw->count == 0);
+  ddsrt_free (tw->slots);
+}
+
+bool ddsrt_timewheel_isempty (const ddsrt_timewheel_t *tw)
+{
+  return tw->count == 0;
+}
+
+void ddsrt_timewheel_insert (ddsrt_timewheel_t *tw, ddsrt_timewheel_node_t *node, int64_t t)
+{
+  if (tw->slots == NULL)
+    tw->slots = ddsrt_calloc (TW_NSLOTS, sizeof (*tw->slots));
+  node->t = t;
+  link_node (tw, node);
+  tw->count++;
+}
+
+void ddsrt_timewheel_delete (ddsrt_timewheel_t *tw, ddsrt_timewheel_node_t *node)
+{
+  assert (tw->count > 0);
+  unlink_node (tw, node);
+  node->slot = TW_SLOT_NONE;
+  tw->count--;
+}
+
+void ddsrt_timewheel_update (ddsrt_timewheel_t *tw, ddsrt_timewheel_node_t *node, int64_t t)
+{
+  unlink_node (tw, node);
+  node->t = t;
+  link_node (tw, node);
+}
+
+ddsrt_timewheel_node_t *ddsrt_timewheel_next_expired (ddsrt_timewheel_t *tw, int64_t tnow)
+{
+  if (tw->count == 0)
+    return NULL;
+  advance (tw, tick_from_time (tnow));
+  /* Nodes in the due list and the current slot can only be later than tnow if
+     the wheel has already been advanced beyond tnow by an earlier call, else
+     the first node in the due list is expired */
+  ddsrt_timewheel_node_t *n;
+  for (n = tw->slots[TW_SLOT_DUE]; n != NULL; n = n->next)
+    if (n->t <= tnow)
+      return n;
+  for (n = tw->slots[tw->cur & (TW_SLOTS - 1)]; n != NULL; n = n->next)
+    if (n->t <= tnow)
+      return n;
+  return NULL;
+}
+
+int64_t ddsrt_timewheel_next_time (const ddsrt_timewheel_t *tw)
+{
+  const ddsrt_timewheel_node_t *n;
+  int64_t tmin = INT64_MAX;
+  if (tw->count == 0)
+    return INT64_MAX;
+  if (tw->slots[TW_SLOT_DUE] != NULL || tw->slots[tw->cur & (TW_SLOTS - 1)] != NULL)
+  {
+    for (n = tw->slots[TW_SLOT_DUE]; n != NULL; n = n->next)
+      if (n->t < tmin)
+        tmin = n->t;
+    for (n = tw->slots[tw->cur & (TW_SLOTS - 1)]; n != NULL; n = n->next)
+      if (n->t < tmin)
+        tmin = n->t;
+    return tmin;
+  }
+  for (uint32_t level = 0; level < DDSRT_TIMEWHEEL_LEVELS; level++)
+  {
+    if (tw->occupied[level])
+    {
+      /* start of the earliest occupied slot */
+      const uint32_t sh = TW_BITS * level;
+      const uint64_t tick = ((tw->cur >> (sh + TW_BITS)) << (sh + TW_BITS)) | ((uint64_t) lowest_bit (tw->occupied[level]) << sh);
+      return (int64_t) (tick << TW_SHIFT);
+    }
+  }
+  /* only the overflow list: the next time the bits above the highest level
+     change (which is so far in the future it may well not be representable) */
+  const uint64_t tick = ((tw->cur >> (TW_BITS * DDSRT_TIMEWHEEL_LEVELS)) + 1) << (TW_BITS * DDSRT_TIMEWHEEL_LEVELS);
+  return (tick > ((uint64_t) INT64_MAX >> TW_SHIFT)) ? INT64_MAX : (int64_t) (tick << TW_SHIFT);
+}
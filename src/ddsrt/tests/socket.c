@@ -168,6 +168,111 @@ CU_Test(ddsrt_sockets, gethostname)
   CU_ASSERT_EQUAL(rc, DDS_RETCODE_NOT_ENOUGH_SPACE);
 }
 
+CU_Test(ddsrt_sockets, recvmmsg, .init=setup, .fini=teardown)
+{
+#if DDSRT_HAVE_RECVMMSG
+  dds_return_t rc;
+  ddsrt_socket_t rsock, ssock;
+  struct sockaddr_in addr = ipv4_loopback;
+  socklen_t addrlen = sizeof(addr);
+  char bufs[4][16];
+  ddsrt_iovec_t iovs[4];
+  ddsrt_mmsghdr_t msgs[4];
+  uint32_t n = 0;
+  ssize_t sent;
+
+  rc = ddsrt_socket(&rsock, AF_INET, SOCK_DGRAM, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_bind(rsock, (struct sockaddr *)&addr, sizeof(addr));
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_getsockname(rsock, (struct sockaddr *)&addr, &addrlen);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_socket(&ssock, AF_INET, SOCK_DGRAM, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  for (int i = 0; i < 3; i++) {
+    char c = (char)('a' + i);
+    ddsrt_iovec_t iov = { .iov_base = &c, .iov_len = 1 };
+    ddsrt_msghdr_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    rc = ddsrt_sendmsg(ssock, &msg, 0, &sent);
+    CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  }
+
+  memset(msgs, 0, sizeof(msgs));
+  for (int i = 0; i < 4; i++) {
+    iovs[i].iov_base = bufs[i];
+    iovs[i].iov_len = sizeof(bufs[i]);
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  rc = ddsrt_recvmmsg(rsock, msgs, 4, 0, &n);
+  CU_ASSERT_EQUAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(n, 3);
+  for (uint32_t i = 0; i < n; i++) {
+    CU_ASSERT_EQUAL(msgs[i].msg_len, 1);
+    CU_ASSERT_EQUAL(bufs[i][0], (char)('a' + i));
+  }
+  (void)ddsrt_close(ssock);
+  (void)ddsrt_close(rsock);
+#else
+  CU_PASS("recvmmsg is not supported");
+#endif
+}
+
+CU_Test(ddsrt_sockets, sendmmsg, .init=setup, .fini=teardown)
+{
+#if DDSRT_HAVE_SENDMMSG
+  dds_return_t rc;
+  ddsrt_socket_t rsock, ssock;
+  struct sockaddr_in addr = ipv4_loopback;
+  socklen_t addrlen = sizeof(addr);
+  char bufs[3];
+  ddsrt_iovec_t iovs[3];
+  ddsrt_mmsghdr_t msgs[3];
+  uint32_t n = 0;
+
+  rc = ddsrt_socket(&rsock, AF_INET, SOCK_DGRAM, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_bind(rsock, (struct sockaddr *)&addr, sizeof(addr));
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_getsockname(rsock, (struct sockaddr *)&addr, &addrlen);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_socket(&ssock, AF_INET, SOCK_DGRAM, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+
+  memset(msgs, 0, sizeof(msgs));
+  for (int i = 0; i < 3; i++) {
+    bufs[i] = (char)('a' + i);
+    iovs[i].iov_base = &bufs[i];
+    iovs[i].iov_len = 1;
+    msgs[i].msg_hdr.msg_name = &addr;
+    msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  rc = ddsrt_sendmmsg(ssock, msgs, 3, 0, &n);
+  CU_ASSERT_EQUAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(n, 3);
+
+  for (int i = 0; i < 3; i++) {
+    char buf[16];
+    ssize_t rcvd;
+    rc = ddsrt_recv(rsock, buf, sizeof(buf), 0, &rcvd);
+    CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(rcvd, 1);
+    CU_ASSERT_EQUAL(buf[0], (char)('a' + i));
+  }
+  (void)ddsrt_close(ssock);
+  (void)ddsrt_close(rsock);
+#else
+  CU_PASS("sendmmsg is not supported");
+#endif
+}
+
 #if DDSRT_HAVE_DNS
 static void gethostbyname_test(char *name, int af, dds_return_t exp)
 {
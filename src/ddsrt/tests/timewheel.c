@@ -0,0 +1,144 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include "CUnit/Test.h"
+
+#include "dds/ddsrt/random.h"
+#include "dds/ddsrt/timewheel.h"
+
+#define NNODES 1000
+
+struct elem {
+  ddsrt_timewheel_node_t twn;
+  bool inwheel;
+  int64_t t;
+};
+
+static struct elem elems[NNODES];
+
+static int64_t ref_min (void)
+{
+  int64_t m = INT64_MAX;
+  for (int i = 0; i < NNODES; i++)
+    if (elems[i].inwheel && elems[i].t < m)
+      m = elems[i].t;
+  return m;
+}
+
+static int64_t rand_offset (ddsrt_prng_t *prng)
+{
+  /* mix of timers in the current tick, in the next few ms, seconds, hours
+     and beyond the range of the wheel */
+  switch (ddsrt_prng_random (prng) % 6)
+  {
+    case 0: return (int64_t) (ddsrt_prng_random (prng) % 1000000);
+    case 1: return (int64_t) (ddsrt_prng_random (prng) % 100000000);
+    case 2: return (int64_t) (ddsrt_prng_random (prng) % 10000) * 1000000;
+    case 3: return (int64_t) (ddsrt_prng_random (prng) % 100000) * 100000000;
+    case 4: return (int64_t) ddsrt_prng_random (prng) << 30;
+    default: return -(int64_t) (ddsrt_prng_random (prng) % 10000000);
+  }
+}
+
+static void check_expired (ddsrt_timewheel_t *tw, int64_t tnow)
+{
+  ddsrt_timewheel_node_t *n;
+  while ((n = ddsrt_timewheel_next_expired (tw, tnow)) != NULL)
+  {
+    struct elem *e = DDSRT_FROM_TIMEWHEEL (struct elem, twn, n);
+    CU_ASSERT_FATAL (e->inwheel);
+    CU_ASSERT_FATAL (e->t <= tnow);
+    ddsrt_timewheel_delete (tw, n);
+    e->inwheel = false;
+  }
+  for (int i = 0; i < NNODES; i++)
+    CU_ASSERT_FATAL (!elems[i].inwheel || elems[i].t > tnow);
+  const int64_t tnext = ddsrt_timewheel_next_time (tw);
+  CU_ASSERT_FATAL (tnext <= ref_min ());
+  CU_ASSERT_FATAL (tnext > tnow || ddsrt_timewheel_isempty (tw));
+}
+
+CU_Test (ddsrt_timewheel, random)
+{
+  ddsrt_prng_t prng;
+  ddsrt_prng_init_simple (&prng, 1);
+  ddsrt_timewheel_t tw;
+  ddsrt_timewheel_init (&tw);
+  CU_ASSERT_FATAL (ddsrt_timewheel_isempty (&tw));
+  CU_ASSERT_FATAL (ddsrt_timewheel_next_time (&tw) == INT64_MAX);
+  CU_ASSERT_FATAL (ddsrt_timewheel_next_expired (&tw, INT64_MAX) == NULL);
+
+  int64_t tnow = 1000000000;
+  for (int iter = 0; iter < 100000; iter++)
+  {
+    struct elem *e = &elems[ddsrt_prng_random (&prng) % NNODES];
+    switch (ddsrt_prng_random (&prng) % 4)
+    {
+      case 0:
+        if (!e->inwheel)
+        {
+          e->t = tnow + rand_offset (&prng);
+          ddsrt_timewheel_insert (&tw, &e->twn, e->t);
+          e->inwheel = true;
+        }
+        break;
+      case 1:
+        if (e->inwheel)
+        {
+          ddsrt_timewheel_delete (&tw, &e->twn);
+          e->inwheel = false;
+        }
+        break;
+      case 2:
+        if (e->inwheel)
+        {
+          e->t = tnow + rand_offset (&prng);
+          ddsrt_timewheel_update (&tw, &e->twn, e->t);
+        }
+        break;
+      case 3:
+        /* either step a little or jump to (just past) the next expiry */
+        if (ddsrt_prng_random (&prng) % 2)
+          tnow += rand_offset (&prng) & INT64_C (0xffffffffff);
+        else if (!ddsrt_timewheel_isempty (&tw) && ref_min () - tnow < INT64_C (10000000000000))
+          tnow = ref_min ();
+        check_expired (&tw, tnow);
+        break;
+    }
+  }
+  check_expired (&tw, INT64_MAX);
+  CU_ASSERT_FATAL (ddsrt_timewheel_isempty (&tw));
+  ddsrt_timewheel_fini (&tw);
+}
+
+CU_Test (ddsrt_timewheel, backwards)
+{
+  /* users may query with an earlier time than a previous call, that must not
+     result in early expiry */
+  ddsrt_timewheel_t tw;
+  ddsrt_timewheel_init (&tw);
+  for (int i = 0; i < 10; i++)
+  {
+    elems[i].t = INT64_C (1000000000) + i * INT64_C (1000000);
+    elems[i].inwheel = true;
+    ddsrt_timewheel_insert (&tw, &elems[i].twn, elems[i].t);
+  }
+  CU_ASSERT_FATAL (ddsrt_timewheel_next_expired (&tw, INT64_C (2000000000)) != NULL);
+  CU_ASSERT_FATAL (ddsrt_timewheel_next_expired (&tw, INT64_C (999999999)) == NULL);
+  check_expired (&tw, INT64_C (1004500000));
+  CU_ASSERT_FATAL (ddsrt_timewheel_next_time (&tw) == INT64_C (1005000000));
+  check_expired (&tw, INT64_MAX);
+  ddsrt_timewheel_fini (&tw);
+}
@@ -58,6 +58,7 @@ int main(int argc, char **argv)
     os.m_index = 0;
     os.m_size = 0;
     os.m_xcdr_version = CDR_ENC_VERSION_2;
+    os.m_extrefs = NULL;
     dds_stream_write_sample (&os, msg_wr, &sertype);
     printf("cdr write complete\n");
 